@@ -96,21 +96,26 @@ main(int           const argc,
   //int * requestsForMultiRpc = malloc(sizeof(int));
   int requestsForMultiRpc = atoi(argv[1]);
 
-  // in one single multi rpc call, how many requests we need to send
-  // each server will get one request, so it is equal to number of server
-  //int * requestsRequired = malloc(sizeof(int));
-  int requestsRequired = multiServerInfo.numberOfServer;
+  // each server gets one request, with its own parameters
+  xmlrpc_value ** paramArrays = malloc(sizeof(xmlrpc_value *) *
+                                       multiServerInfo.numberOfServer);
+  int i;
+  for (i = 0; i < multiServerInfo.numberOfServer; ++i) {
+    paramArrays[i] = xmlrpc_build_value(&env, "(ii)",
+                                       (xmlrpc_int32) 5, (xmlrpc_int32) 7);
+    die_if_fault_occurred(&env);
+  }
+
+  // wait for all of the servers to answer
+  unsigned int requestsRequired = 0;
 
   int counter;
 
   for (counter = 0; counter < (requestsForMultiRpc); ++counter)
     {
-      // requestsRequired shows how many threads need to be created in 
-      // the belowing function
-      multirpc_globalclient_asynch(&multiServerInfo, methodName, 
-				   handle_sample_add_response, NULL, 
-				   requestsRequired, "(ii)", 
-				   (xmlrpc_int32) 5, (xmlrpc_int32) 7);
+      multirpc_globalclient_asynch(&env, &multiServerInfo, methodName,
+                                   paramArrays, handle_sample_add_response, NULL,
+                                   requestsRequired);
       die_if_fault_occurred(&env);
       
       printf("RPCs all requested.  Waiting for & handling responses...\n");
@@ -125,9 +130,13 @@ main(int           const argc,
       printf("All RPCs finished.\n");
       
       printf("Just finished %d th. Multi-RPC call to %d servers\n", 
-	     (counter+1), (requestsRequired));
+	     (counter+1), multiServerInfo.numberOfServer);
     }
 
+  for (i = 0; i < multiServerInfo.numberOfServer; ++i)
+    xmlrpc_DECREF(paramArrays[i]);
+  free(paramArrays);
+
   xmlrpc_client_cleanup();
 
   return 0;
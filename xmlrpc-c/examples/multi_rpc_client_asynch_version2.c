@@ -91,22 +91,29 @@ main(int           const argc,
   //int * requestsForMultiRpc = malloc(sizeof(int));
   int requestsForMultiRpc = atoi(argv[1]);
 
-  // in one single multi rpc call, how many requests we need to send
-  // each server will get one request, so it is equal to number of server
-  //int * requestsRequired = malloc(sizeof(int));
-  int requestsRequired = multiServerInfo.numberOfServer;
+  // each server gets one request, with its own parameters
+  xmlrpc_value ** paramArrays = malloc(sizeof(xmlrpc_value *) *
+                                       multiServerInfo.numberOfServer);
+  int i;
+  for (i = 0; i < multiServerInfo.numberOfServer; ++i) {
+    paramArrays[i] = xmlrpc_build_value(&env, "(si)",
+                                       "Hello", (xmlrpc_int32) (i + 1));
+    die_if_fault_occurred(&env);
+  }
+
+  // wait for all of the servers to answer
+  unsigned int requestsRequired = 0;
 
   int counter;
 
   for (counter = 0; counter < (requestsForMultiRpc); ++counter)
     {
-      // requestsRequired shows how many threads need to be created in 
-      // the belowing function
-      multirpc_globalclient_asynch(&multiServerInfo, methodName, 
-				   handle_hello_server_response, 
-				   requestsRequired);
+      multirpc_globalclient_asynch(&env, &multiServerInfo, methodName,
+                                   paramArrays, handle_hello_server_response, NULL,
+                                   requestsRequired);
+      die_if_fault_occurred(&env);
       
-      printf("Multi RPC has been done %d time. Waiting..\n", counter+1);
+      printf("Multi RPC has been done %d time.\n", counter+1);
       
       // xmlrpc_client_event_loop_finish_asynch();
       
@@ -114,6 +121,10 @@ main(int           const argc,
 
   // sleep(10);
 
+  for (i = 0; i < multiServerInfo.numberOfServer; ++i)
+    xmlrpc_DECREF(paramArrays[i]);
+  free(paramArrays);
+
   xmlrpc_env_clean(&env);
 
   xmlrpc_client_cleanup();
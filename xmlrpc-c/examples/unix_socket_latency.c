@@ -0,0 +1,248 @@
+/* A program that compares the time it takes to do an RPC over a Unix domain
+   socket with the time it takes to do the same RPC over TCP to the loopback
+   address.
+
+   For each kind of socket, the program forks a child that runs an Abyss
+   XML-RPC server listening on it, then does a series of "sample.add" RPCs
+   over a persistent connection and reports the average latency.
+
+   Example:
+
+   $ ./unix_socket_latency 20000
+
+   The argument is the number of RPCs to do each way (default 10000).
+
+   This needs a libcurl new enough (7.40) to have CURLOPT_UNIX_SOCKET_PATH.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <xmlrpc-c/base.h>
+#include <xmlrpc-c/client.h>
+#include <xmlrpc-c/server.h>
+#include <xmlrpc-c/server_abyss.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define NAME "Xmlrpc-c Unix socket latency test"
+#define VERSION "1.0"
+
+#define TCP_PORT 8765
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static xmlrpc_value *
+sample_add(xmlrpc_env *   const envP,
+           xmlrpc_value * const paramArrayP,
+           void *         const serverInfo,
+           void *         const channelInfo) {
+
+    xmlrpc_int32 x, y;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(ii)", &x, &y);
+    if (envP->fault_occurred)
+        return NULL;
+    else
+        return xmlrpc_build_value(envP, "i", x + y);
+}
+
+
+
+static void
+runServer(const struct sockaddr * const sockAddrP,
+          socklen_t               const sockAddrLen) {
+/*----------------------------------------------------------------------------
+   Run an XML-RPC server on the socket address *sockAddrP forever.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_method_info3 const methodInfo = {
+        /* .methodName     = */ "sample.add",
+        /* .methodFunction = */ &sample_add,
+    };
+    xmlrpc_server_abyss_parms serverparm;
+    xmlrpc_registry * registryP;
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    dieIfFaultOccurred(&env);
+
+    xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+    dieIfFaultOccurred(&env);
+
+    memset(&serverparm, 0, sizeof(serverparm));
+    serverparm.config_file_name = NULL;
+    serverparm.registryP        = registryP;
+    serverparm.log_file_name    = NULL;
+    serverparm.sockaddr_p       = sockAddrP;
+    serverparm.sockaddrlen      = sockAddrLen;
+
+    xmlrpc_server_abyss(&env, &serverparm, XMLRPC_APSIZE(sockaddrlen));
+    dieIfFaultOccurred(&env);
+
+    exit(0);
+}
+
+
+
+static pid_t
+startServer(const struct sockaddr * const sockAddrP,
+            socklen_t               const sockAddrLen) {
+
+    pid_t const pid = fork();
+
+    if (pid < 0) {
+        fprintf(stderr, "fork() failed\n");
+        exit(1);
+    } else if (pid == 0)
+        runServer(sockAddrP, sockAddrLen);
+
+    /* Give the server a moment to start listening */
+    sleep(1);
+
+    return pid;
+}
+
+
+
+static double
+timeRpcs(const char * const unixSocketPath,
+         const char * const serverUrl,
+         unsigned int const rpcCt) {
+/*----------------------------------------------------------------------------
+   Do 'rpcCt' RPCs to the server at 'serverUrl' and return the average
+   time per RPC in microseconds.  If 'unixSocketPath' is non-null, connect
+   through the Unix domain socket by that name.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    struct xmlrpc_curl_xportparms curlParms;
+    struct xmlrpc_clientparms clientParms;
+    xmlrpc_client * clientP;
+    struct timeval start, end;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    memset(&curlParms, 0, sizeof(curlParms));
+    curlParms.unix_socket_path = unixSocketPath;
+
+    clientParms.transport          = "curl";
+    clientParms.transportparmsP    = &curlParms;
+    clientParms.transportparm_size = XMLRPC_CXPSIZE(unix_socket_path);
+
+    xmlrpc_client_create(&env, XMLRPC_CLIENT_NO_FLAGS, NAME, VERSION,
+                         &clientParms, XMLRPC_CPSIZE(transportparm_size),
+                         &clientP);
+    dieIfFaultOccurred(&env);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < rpcCt; ++i) {
+        xmlrpc_value * resultP;
+
+        xmlrpc_client_call2f(&env, clientP, serverUrl, "sample.add",
+                             &resultP, "(ii)",
+                             (xmlrpc_int32) i, (xmlrpc_int32) 1);
+        dieIfFaultOccurred(&env);
+
+        xmlrpc_DECREF(resultP);
+    }
+
+    gettimeofday(&end, NULL);
+
+    xmlrpc_client_destroy(clientP);
+    xmlrpc_env_clean(&env);
+
+    return ((end.tv_sec - start.tv_sec) * 1e6 +
+            (end.tv_usec - start.tv_usec)) / rpcCt;
+}
+
+
+
+static void
+stopServer(pid_t const pid) {
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    unsigned int const rpcCt = argc-1 >= 1 ? atoi(argv[1]) : 10000;
+
+    struct sockaddr_in tcpAddr;
+    struct sockaddr_un localAddr;
+    char tcpUrl[64];
+    double tcpLatency, localLatency;
+    xmlrpc_env env;
+    pid_t pid;
+
+    if (rpcCt == 0) {
+        fprintf(stderr, "The number of RPCs must be positive\n");
+        exit(1);
+    }
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    dieIfFaultOccurred(&env);
+
+    memset(&tcpAddr, 0, sizeof(tcpAddr));
+    tcpAddr.sin_family      = AF_INET;
+    tcpAddr.sin_port        = htons(TCP_PORT);
+    tcpAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    memset(&localAddr, 0, sizeof(localAddr));
+    localAddr.sun_family = AF_UNIX;
+    snprintf(localAddr.sun_path, sizeof(localAddr.sun_path),
+             "/tmp/unix_socket_latency.%u", (unsigned)getpid());
+
+    sprintf(tcpUrl, "http://127.0.0.1:%u/RPC2", TCP_PORT);
+
+    pid = startServer((const struct sockaddr *)&tcpAddr, sizeof(tcpAddr));
+    tcpLatency = timeRpcs(NULL, tcpUrl, rpcCt);
+    stopServer(pid);
+
+    pid = startServer((const struct sockaddr *)&localAddr, sizeof(localAddr));
+    localLatency = timeRpcs(localAddr.sun_path, "http://localhost/RPC2",
+                            rpcCt);
+    stopServer(pid);
+
+    /* The server was killed, so it didn't get to remove its socket */
+    unlink(localAddr.sun_path);
+
+    printf("%u RPCs each way\n", rpcCt);
+    printf("TCP loopback:      %8.1f microseconds per RPC\n", tcpLatency);
+    printf("Unix domain:       %8.1f microseconds per RPC\n", localLatency);
+
+    xmlrpc_client_teardown_global_const();
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
@@ -252,6 +252,68 @@ void
 ServerSetMaxConnBacklog(TServer *    const serverP,
                         unsigned int const maxConnBacklog);
 
+#define HAVE_SERVER_SET_SHED 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetShedThreshold(TServer *    const serverP,
+                       unsigned int const shedThreshold);
+
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetShedMaxWait(TServer *    const serverP,
+                     unsigned int const shedMaxWaitMs);
+
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetShedRetryAfter(TServer *    const serverP,
+                        unsigned int const retryAfter);
+
+#define HAVE_SERVER_SET_WORKER_PROCESSES 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetWorkerProcesses(TServer *    const serverP,
+                         unsigned int const workerProcessCt);
+
+/* With worker processes (ServerSetWorkerProcesses), these statistics are
+   the totals for all the workers, as of their latest reports, except that
+   the average service time is the average of the workers' averages.
+*/
+typedef struct {
+    unsigned int connAcceptedCt;
+        /* Connections the server has accepted and served (or is serving) */
+    unsigned int connShedCt;
+        /* Connections the server has refused with a 503 response because
+           it was overloaded
+        */
+    unsigned int connInProgressCt;
+        /* Connections being served, as of when the server last accepted
+           a connection
+        */
+    unsigned int avgServiceTimeMs;
+        /* Recent average time to process one HTTP request */
+    unsigned int readTimeoutCt;
+        /* Connections the server gave up on because the client took too
+           long to send a request (ServerSetTimeout)
+        */
+    unsigned int idleTimeoutCt;
+        /* Persistent connections the server closed because the client
+           didn't send another request in time (ServerSetKeepaliveTimeout)
+        */
+    unsigned int writeTimeoutCt;
+        /* Connections the server gave up on because the client didn't take
+           a response in time (ServerSetTimeout)
+        */
+    /* Where the server's threads are really processes (fork), it never
+       learns of timeouts or service times, and doesn't time out writes.
+    */
+} TServerStats;
+
+#define HAVE_SERVER_GET_STATS 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerGetStats(TServer *      const serverP,
+               TServerStats * const statsP);
+
 XMLRPC_ABYSS_EXPORTED
 void
 ServerInit2(TServer *     const serverP,
@@ -456,6 +518,27 @@ XMLRPC_ABYSS_EXPORTED
 void *
 SessionGetDefaultHandlerCtx(TSession * const sessionP);
 
+XMLRPC_ABYSS_EXPORTED
+void
+SessionSetHandlerData(TSession * const sessionP,
+                      void *     const handlerData);
+
+XMLRPC_ABYSS_EXPORTED
+void *
+SessionGetHandlerData(TSession * const sessionP);
+
+XMLRPC_ABYSS_EXPORTED
+abyss_bool
+SessionPeerGone(TSession * const sessionP);
+
+XMLRPC_ABYSS_EXPORTED
+abyss_bool
+SessionDeferResponse(TSession * const sessionP);
+
+XMLRPC_ABYSS_EXPORTED
+void
+SessionDeferredResponseDone(TSession * const sessionP);
+
 XMLRPC_ABYSS_EXPORTED
 char *
 RequestHeaderValue(TSession *   const sessionP,
@@ -21,6 +21,49 @@ ChanSwitchOpensslCreateFd(int            const fd,
                           TChanSwitch ** const chanSwitchPP,
                           const char **  const errorP);
 
+struct abyss_openssl_session_parms {
+    unsigned int cacheSize;
+        /* Maximum number of sessions the server remembers so clients can
+           resume them by session ID.  0 means don't remember any.
+        */
+    unsigned int timeout;
+        /* Seconds after which a session may no longer be resumed.
+           0 means the OpenSSL default (300).
+        */
+    abyss_bool tickets;
+        /* Issue session tickets (RFC 5077), with which a client can resume
+           a session without the server remembering it.
+        */
+};
+
+struct abyss_openssl_session_stats {
+    unsigned long handshakes;
+        /* Handshakes completed, full or abbreviated */
+    unsigned long hits;
+        /* Handshakes that resumed a session (abbreviated) */
+    unsigned long misses;
+        /* Clients that asked to resume a session we didn't have */
+    unsigned long timeouts;
+        /* Clients that asked to resume a session that had expired */
+    unsigned long cacheFull;
+        /* Sessions we could not remember because the cache was full */
+    unsigned long cached;
+        /* Sessions in the cache now */
+};
+
+void
+ChanSwitchOpensslCreateCtx(
+    unsigned short                             const portNumber,
+    SSL_CTX *                                  const sslCtxP,
+    const struct abyss_openssl_session_parms * const sessParmsP,
+    TChanSwitch **                             const chanSwitchPP,
+    const char **                              const errorP);
+
+void
+ChanSwitchOpensslGetSessionStats(
+    TChanSwitch *                        const chanSwitchP,
+    struct abyss_openssl_session_stats * const statsP);
+
 void
 ChannelOpensslCreateSsl(SSL *                            const sslP,
                         TChannel **                      const channelPP,
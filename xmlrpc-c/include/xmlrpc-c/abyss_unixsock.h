@@ -30,6 +30,36 @@ ChanSwitchUnixCreateFd(int            const fd,
                        TChanSwitch ** const chanSwitchPP,
                        const char **  const errorP);
 
+void
+ChanSwitchUnixCreateLocal(const char *   const path,
+                          TChanSwitch ** const chanSwitchPP,
+                          const char **  const errorP);
+
+/* The io_uring channel switch is like the Unix one above, except that it
+   and the channels it makes do their I/O through a Linux io_uring.  Where
+   io_uring is not available, it uses epoll instead, and on a system other
+   than Linux it is just the Unix channel switch.
+*/
+void
+ChanSwitchUringCreate(unsigned short const portNumber,
+                      TChanSwitch ** const chanSwitchPP,
+                      const char **  const errorP);
+
+void
+ChanSwitchUringCreate2(int                     const protocolFamily,
+                       const struct sockaddr * const sockAddrP,
+                       socklen_t               const sockAddrLen,
+                       TChanSwitch **          const chanSwitchPP,
+                       const char **           const errorP);
+
+void
+ChanSwitchUringCreateFd(int            const fd,
+                        TChanSwitch ** const chanSwitchPP,
+                        const char **  const errorP);
+
+abyss_bool
+ChanSwitchUringUsesUring(TChanSwitch * const chanSwitchP);
+
 void
 ChannelUnixCreateFd(int                           const fd,
                     TChannel **                   const channelPP,
@@ -685,6 +685,74 @@ xmlrpc_decompose_value_va(xmlrpc_env *   const envP,
                           const char *   const format,
                           va_list        const args);
 
+/* Compiled format strings.  A program that builds or decomposes values
+   with the same format string over and over can compile it once with
+   xmlrpc_build_plan_create() or xmlrpc_decomp_plan_create() and then use
+   the plan with xmlrpc_build_value_plan() or xmlrpc_decompose_value_plan()
+   instead of parsing the format string on every call.  A plan is
+   immutable, so threads may share it.
+
+   (If the program called xmlrpc_init(), xmlrpc_build_value() and
+   xmlrpc_decompose_value() cache the plans for the format strings they
+   see, so a program gets most of the benefit without doing this).
+*/
+
+typedef struct xmlrpc_build_plan xmlrpc_build_plan;
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_build_plan_create(xmlrpc_env *               const envP,
+                         const char *               const format,
+                         const xmlrpc_build_plan ** const planPP);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_build_plan_destroy(const xmlrpc_build_plan * const planP);
+
+XMLRPC_LIB_EXPORTED
+const char *
+xmlrpc_build_plan_tail(const xmlrpc_build_plan * const planP,
+                       const char *              const format);
+
+XMLRPC_LIB_EXPORTED
+xmlrpc_value *
+xmlrpc_build_value_plan(xmlrpc_env *              const envP,
+                        const xmlrpc_build_plan * const planP,
+                        ...);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_build_value_plan_va(xmlrpc_env *              const envP,
+                           const xmlrpc_build_plan * const planP,
+                           va_list                   const args,
+                           xmlrpc_value **           const valPP);
+
+typedef struct xmlrpc_decomp_plan xmlrpc_decomp_plan;
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_decomp_plan_create(xmlrpc_env *                const envP,
+                          const char *                const format,
+                          const xmlrpc_decomp_plan ** const planPP);
+
+XMLRPC_LIB_EXPORTED
+void
+xmlrpc_decomp_plan_destroy(const xmlrpc_decomp_plan * const planP);
+
+XMLRPC_LIB_EXPORTED
+void 
+xmlrpc_decompose_value_plan(xmlrpc_env *               const envP,
+                            xmlrpc_value *             const valueP,
+                            const xmlrpc_decomp_plan * const planP,
+                            ...);
+
+XMLRPC_LIB_EXPORTED
+void 
+xmlrpc_decompose_value_plan_va(xmlrpc_env *               const envP,
+                               xmlrpc_value *             const valueP,
+                               const xmlrpc_decomp_plan * const planP,
+                               va_list                    const args);
+
 /* xmlrpc_parse_value... is the same as xmlrpc_decompose_value... except
    that it doesn't do proper memory management -- it returns xmlrpc_value's
    without incrementing the reference count and returns pointers to data
@@ -152,6 +152,22 @@ XMLRPC_LIBINT_EXPORTED
 void
 xmlrpc_destroyArrayContents(xmlrpc_value * const arrayP);
 
+/* These set up and tear down the format plan caches behind
+   xmlrpc_build_value() and xmlrpc_decompose_value().  xmlrpc_init() and
+   xmlrpc_term() call them.
+*/
+void
+xmlrpc_buildInit(xmlrpc_env * const envP);
+
+void
+xmlrpc_buildTerm(void);
+
+void
+xmlrpc_decomposeInit(xmlrpc_env * const envP);
+
+void
+xmlrpc_decomposeTerm(void);
+
 /*----------------------------------------------------------------------------
    The following are for use by the legacy xmlrpc_parse_value().  They don't
    do proper memory management, so they aren't appropriate for general use,
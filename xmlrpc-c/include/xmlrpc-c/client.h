@@ -125,6 +125,11 @@ struct xmlrpc_curl_xportparms {
     const char * proxy_userpwd;
     xmlrpc_bool  gssapi_delegation;
     const char * referer;
+    const char * unix_socket_path;
+        /* Connect to the server via the Unix domain socket with this file
+           system name instead of via TCP.  The server URL still supplies
+           the path and Host: header.  NULL means use TCP.
+        */
 };
 
 
@@ -214,30 +219,6 @@ typedef void xmlrpc_response_handler(const char *   serverUrl,
 
 
 
-  /*=========================================================================                                                                   \
-                                                                                                                                               
-   data structure for thread using for multi-rpc asynch call                                                                                  \
-   each thread will call xmlrpc_client_start_rpcf()                                                                                            
-   so the struct should contain the following param                                                                                            
-   =========================================================================*/
-  typedef struct asynch_thread_param {
-
-    xmlrpc_env * envP;
-    xmlrpc_client * clientP;
-
-    multi_server_info_t * multiServerInfo;
-
-    xmlrpc_response_handler * responseHandler;
-
-    pthread_t tid; // thread ID                                                                                                                  
-    int requestID; // indicating this thread is for which server                                                                                 
-
-    char * methodName;
-
-  }asynch_thread_param_t;
-
-
-
 /*=========================================================================
    xmlrpc_server_info
 ===========================================================================
@@ -416,6 +397,76 @@ xmlrpc_client_start_rpc(xmlrpc_env *               const envP,
                         xmlrpc_response_handler          responseHandler,
                         void *                     const userData);
 
+struct xmlrpc_fanout_call {
+    /* One of the RPCs of a fan-out; see xmlrpc_client_fanout() */
+    const xmlrpc_server_info * serverInfoP;
+    xmlrpc_value *             paramArrayP;
+};
+
+XMLRPC_CLIENT_EXPORTED
+void
+xmlrpc_client_fanout(xmlrpc_env *                      const envP,
+                     struct xmlrpc_client *            const clientP,
+                     const char *                      const methodName,
+                     const struct xmlrpc_fanout_call * const callArray,
+                     unsigned int                      const callCt,
+                     unsigned int                      const requiredCt,
+                     xmlrpc_response_handler                 responseHandler,
+                     void *                            const userHandle);
+
+typedef enum {
+    /* How many RPCs of an xmlrpc_client_multirpc() must succeed */
+    xmlrpc_multirpc_all,
+    xmlrpc_multirpc_first,
+    xmlrpc_multirpc_majority,
+    xmlrpc_multirpc_quorum
+} xmlrpc_multirpc_completion;
+
+struct xmlrpc_multirpc_policy {
+    xmlrpc_multirpc_completion completion;
+    unsigned int quorum;
+        /* The number of RPCs that must succeed, for
+           xmlrpc_multirpc_quorum
+        */
+    unsigned int timeout;
+        /* Milliseconds after which to give up on the RPCs that haven't
+           completed, and go with what we have.  Zero means never.
+        */
+};
+
+struct xmlrpc_multirpc_reply {
+    const char *   serverUrl;
+    xmlrpc_bool    arrived;
+        /* The RPC completed before xmlrpc_client_multirpc() stopped
+           waiting for it.  If not, the other members are meaningless.
+        */
+    xmlrpc_env     fault;
+        /* How the RPC failed, if it did */
+    xmlrpc_value * resultP;
+        /* The RPC's result, if it succeeded */
+};
+
+typedef void xmlrpc_multirpc_handler(
+    const char *                         methodName,
+    xmlrpc_value *                       paramArray,
+    void *                               userHandle,
+    const struct xmlrpc_multirpc_reply * replyArray,
+    unsigned int                         serverCt,
+    xmlrpc_bool                          satisfied);
+
+XMLRPC_CLIENT_EXPORTED
+void
+xmlrpc_client_multirpc(
+    xmlrpc_env *                          const envP,
+    struct xmlrpc_client *                const clientP,
+    const xmlrpc_server_info * const *    const serverInfoArray,
+    unsigned int                          const serverCt,
+    const char *                          const methodName,
+    xmlrpc_value *                        const paramArrayP,
+    const struct xmlrpc_multirpc_policy * const policyP,
+    xmlrpc_multirpc_handler                     handler,
+    void *                                const userHandle);
+
 XMLRPC_CLIENT_EXPORTED
 void 
 xmlrpc_client_start_rpcf(xmlrpc_env *    const envP,
@@ -103,10 +103,23 @@ for multi-rpc asynch global client
 ==========================================================================*/
 XMLRPC_CLIENT_EXPORTED
 void
-multirpc_global_client_asynch(multi_server_info_t *        multiServerInfo,
-			      const char *           const methodName, 
-			      xmlrpc_response_handler responseHandler, 
-			      int                          requestsRequired);
+multirpc_globalclient_asynch(xmlrpc_env *                const envP,
+                             const multi_server_info_t * const multiServerInfoP,
+                             const char *                const methodName,
+                             xmlrpc_value *              const paramArrayP[],
+                             xmlrpc_response_handler           responseHandler,
+                             void *                      const userData,
+                             unsigned int                const requestsRequired);
+
+XMLRPC_CLIENT_EXPORTED
+void
+multirpc_globalclient(xmlrpc_env *                          const envP,
+                      const multi_server_info_t *           const multiServerInfoP,
+                      const char *                          const methodName,
+                      xmlrpc_value *                        const paramArrayP,
+                      const struct xmlrpc_multirpc_policy * const policyP,
+                      xmlrpc_multirpc_handler                     handler,
+                      void *                                const userData);
 
 
 
@@ -0,0 +1,40 @@
+#ifndef CONDITION_H_INCLUDED
+#define CONDITION_H_INCLUDED
+
+#include "lock.h"
+
+/* A condition is something threads wait for, under a lock.  A thread
+   holding the lock checks whether what it needs has happened and if not,
+   waits on the condition, which releases the lock for the duration of the
+   wait.  A thread that makes something happen signals the condition
+   while holding the lock.
+
+   A wait can end without a signal, so a waiter must check again after
+   every wait.
+
+   The lock must be one from xmlrpc_lock_create(), because a condition
+   works only with the platform's own lock.
+*/
+
+typedef struct condition condition;
+
+typedef void conditionWaitFn(condition *, lock *);
+typedef void conditionTimedWaitFn(condition *, lock *, unsigned int);
+typedef void conditionSignalFn(condition *);
+typedef void conditionDestroyFn(condition *);
+
+struct condition {
+    void * implementationP;
+    conditionWaitFn * wait;
+    conditionTimedWaitFn * timedWait;
+        /* Like 'wait', but wait no more than the given number of
+           milliseconds.
+        */
+    conditionSignalFn * signal;
+        /* Wake up one waiting thread */
+    conditionSignalFn * broadcast;
+        /* Wake up every waiting thread */
+    conditionDestroyFn * destroy;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef CONDITION_WINDOWS_H_INCLUDED
+#define CONDITION_WINDOWS_H_INCLUDED
+
+#include "condition.h"
+
+/*
+  XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
+  libxmlrpc_util.
+
+  XMLRPC_BUILDING_UTIL says this compilation is part of libxmlrpc_util, as
+  opposed to something that _uses_ libxmlrpc_util.
+*/
+#ifdef XMLRPC_BUILDING_UTIL
+#define XMLRPC_UTIL_EXPORTED XMLRPC_DLLEXPORT
+#else
+#define XMLRPC_UTIL_EXPORTED
+#endif
+
+XMLRPC_UTIL_EXPORTED
+condition *
+xmlrpc_condition_create_windows(void);
+
+#endif
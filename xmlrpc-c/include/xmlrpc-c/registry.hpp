@@ -36,11 +36,33 @@ class XMLRPC_SERVERPP_EXPORTED callInfo {
    call information to provide might use this.  Servers that do have call
    information to provide define a derived class of this that contains
    information pertinent to that kind of server.
+
+   It does say, if the server knows, how long the caller will wait for the
+   result and whether it has given up: a method that might run long should
+   check cancelled() now and then and quit if so.
 -----------------------------------------------------------------------------*/
 public:
     virtual ~callInfo();  // This makes it polymorphic
 
     callInfo();
+
+    callInfo(xmlrpc_call_ctl * const callCtlP);
+
+    bool
+    cancelled() const;
+        // The caller no longer wants the result: its deadline has passed or
+        // it has gone away.
+
+    bool
+    hasDeadline() const;
+
+    double
+    timeLeft() const;
+        // Seconds until the deadline.  Valid only if hasDeadline().
+
+    xmlrpc_call_ctl * callCtlP;
+        // The call control the server passes to the registry; NULL if the
+        // server doesn't know when the caller stops waiting.
 };
 
 class XMLRPC_SERVERPP_EXPORTED method : public girmem::autoObject {
@@ -126,6 +148,55 @@ public:
 
 };
 
+class XMLRPC_SERVERPP_EXPORTED completion {
+/*----------------------------------------------------------------------------
+   The means by which an asynchronous method completes a call.
+
+   You may copy it and use it in any thread, but you must complete the
+   call exactly once, by calling complete() or fail() on one copy.
+-----------------------------------------------------------------------------*/
+public:
+    completion(xmlrpc_call_completion * const c_completionP);
+
+    void
+    complete(xmlrpc_c::value const& result) const;
+
+    void
+    fail(xmlrpc_c::fault const& fault) const;
+
+private:
+    xmlrpc_call_completion * c_completionP;
+};
+
+class XMLRPC_SERVERPP_EXPORTED asyncMethod : public method {
+/*----------------------------------------------------------------------------
+   An XML-RPC method that need not have the result of a call when its
+   execute() method returns.
+
+   This base class is abstract.  Define a useful method with this as a
+   base class, with an execute() method that starts the call and arranges
+   for something, in any thread, to complete it later through
+   'completion'.  'paramList' and '*callInfoP' remain valid until then.
+
+   If execute() throws an error, it must not have completed the call or
+   arranged for anything to; the registry completes the call with a
+   fault.
+-----------------------------------------------------------------------------*/
+public:
+    asyncMethod();
+
+    virtual ~asyncMethod();
+
+    virtual void
+    execute(xmlrpc_c::paramList        const& paramList,
+            const xmlrpc_c::callInfo * const  callInfoP,
+            xmlrpc_c::completion       const& completion) = 0;
+
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            xmlrpc_c::value *   const  resultP);
+};
+
 class XMLRPC_SERVERPP_EXPORTED methodPtr : public girmem::autoObjectPtr {
 
 public:
@@ -197,6 +268,42 @@ public:
 
     void
     setDialect(xmlrpc_dialect const dialect);
+
+    void
+    setMethodLimits(std::string                 const& name,
+                    struct xmlrpc_method_limits const& limits);
+
+    void
+    setMaxConcurrent(unsigned int const maxConcurrent);
+
+    struct xmlrpc_method_queue_stats
+    methodQueueStats(std::string const& name) const;
+
+    void
+    setParallelMulticall(unsigned int const threadCt,
+                         unsigned int const maxPerCall);
+
+    void
+    setMethodParallelSafe(std::string const& name,
+                          bool        const  safe);
+
+    void
+    setMethodCheckSignature(std::string const& name,
+                            bool        const  check);
+
+    void
+    setMethodCoalescing(std::string const& name,
+                        bool        const  coalesce);
+
+    void
+    setMethodCache(std::string                      const& name,
+                   struct xmlrpc_method_cache_parms const& parms);
+
+    struct xmlrpc_method_cache_stats
+    methodCacheStats(std::string const& name) const;
+
+    struct xmlrpc_method_stats
+    methodStats(std::string const& name) const;
     
     void
     processCall(std::string   const& callXml,
@@ -206,6 +313,26 @@ public:
     processCall(std::string                const& callXml,
                 const xmlrpc_c::callInfo * const callInfoP,
                 std::string *              const  responseXmlP) const;
+
+    class XMLRPC_SERVERPP_EXPORTED responder {
+    /*------------------------------------------------------------------------
+       What a server gives processCallAsync() to receive the response.
+       processCallAsync() calls exactly one of its methods, exactly once,
+       maybe before it returns, maybe later in another thread.
+    ------------------------------------------------------------------------*/
+    public:
+        virtual ~responder();
+        virtual void
+        respond(std::string const& responseXml) = 0;
+        virtual void
+        fail(std::string const& reason) = 0;
+            // There is no response; we couldn't execute the call.
+    };
+
+    void
+    processCallAsync(std::string                const& callXml,
+                     const xmlrpc_c::callInfo * const  callInfoP,
+                     responder *                const  responderP) const;
         
     size_t
     maxStackSize() const;
@@ -76,6 +76,10 @@ XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_disable_introspection(xmlrpc_registry * const registryP);
 
+/* Add all the methods before the server starts processing calls: adding
+   a method is not safe while another thread may be looking one up.
+*/
+
 XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_add_method(xmlrpc_env *      const envP,
@@ -122,6 +126,46 @@ xmlrpc_registry_add_method3(
     xmlrpc_registry *                  const registryP,
     const struct xmlrpc_method_info3 * const infoP);
 
+/* An asynchronous method doesn't have to have the result of a call when
+   its method function returns.  It reports the result later, from any
+   thread, by completing the call with the handle the registry passes to
+   the method function.
+*/
+typedef struct xmlrpc_call_completion xmlrpc_call_completion;
+
+typedef void
+(*xmlrpc_async_method)(xmlrpc_value *           const paramArrayP,
+                       void *                   const serverInfo,
+                       void *                   const callInfo,
+                       xmlrpc_call_completion * const completionP);
+
+struct xmlrpc_async_method_info {
+    const char *        methodName;
+    xmlrpc_async_method methodFunction;
+    void *              serverInfo;
+    size_t              stackSize;
+    const char *        signatureString;
+    const char *        help;
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_add_async_method(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_async_method_info * const infoP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_call_complete(xmlrpc_call_completion * const completionP,
+                     xmlrpc_value *           const resultP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_call_fail(xmlrpc_call_completion * const completionP,
+                 int                      const faultCode,
+                 const char *             const faultString);
+
 XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_set_default_method(xmlrpc_env *          const envP,
@@ -154,10 +198,309 @@ xmlrpc_registry_set_dialect(xmlrpc_env *      const envP,
                             xmlrpc_registry * const registryP,
                             xmlrpc_dialect    const dialect);
 
+/* Concurrency limits.  A call that would exceed a limit waits in its
+   method's priority lane until the method can run; when a call finishes,
+   the slot it frees goes to the oldest waiting call in the highest lane
+   that can use it.  Only calls of registered methods are subject to
+   limits, and the system methods (system.*) don't count against the
+   registry-wide limit.
+*/
+
+typedef enum {
+    xmlrpc_priority_high,
+    xmlrpc_priority_normal,
+    xmlrpc_priority_low
+} xmlrpc_priority;
+
+struct xmlrpc_method_limits {
+    unsigned int    maxConcurrent;
+        /* Maximum number of calls of the method that may execute at
+           once.  Zero means no limit.
+        */
+    unsigned int    maxQueued;
+        /* Maximum number of calls of the method that may wait to
+           execute.  A call beyond that fails immediately with
+           XMLRPC_LIMIT_EXCEEDED_ERROR.  Zero means never wait.
+        */
+    unsigned int    queueTimeoutMs;
+        /* How long a call may wait to execute before it fails with
+           XMLRPC_TIMEOUT_ERROR.  Zero means indefinitely.
+        */
+    xmlrpc_priority priority;
+        /* The lane in which calls of the method wait */
+};
+
+struct xmlrpc_method_queue_stats {
+    unsigned int  runningCt;
+        /* Calls of the method executing now */
+    unsigned int  queuedCt;
+        /* Calls of the method waiting now */
+    unsigned long admittedCt;
+        /* Calls allowed to execute, whether right away or after waiting */
+    unsigned long waitedCt;
+        /* Calls that had to wait before executing */
+    unsigned long rejectedCt;
+        /* Calls that failed because too many were waiting already */
+    unsigned long timedOutCt;
+        /* Calls that failed because they waited too long or were
+           cancelled while waiting (see xmlrpc_call_ctl)
+        */
+    double        waitTimeTotal;
+        /* Seconds that all the 'waitedCt' calls waited, altogether */
+    double        waitTimeMax;
+        /* Seconds that the call that waited longest waited */
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_limits(
+    xmlrpc_env *                        const envP,
+    xmlrpc_registry *                   const registryP,
+    const char *                        const methodName,
+    const struct xmlrpc_method_limits * const limitsP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_max_concurrent(xmlrpc_registry * const registryP,
+                                   unsigned int      const maxConcurrent);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_method_queue_stats(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const char *                       const methodName,
+    struct xmlrpc_method_queue_stats * const statsP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_parallel_multicall(xmlrpc_env *      const envP,
+                                       xmlrpc_registry * const registryP,
+                                       unsigned int      const threadCt,
+                                       unsigned int      const maxPerCall);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_parallel_safe(xmlrpc_env *      const envP,
+                                         xmlrpc_registry * const registryP,
+                                         const char *      const methodName,
+                                         xmlrpc_bool       const safe);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_check_signature(xmlrpc_env *      const envP,
+                                           xmlrpc_registry * const registryP,
+                                           const char *      const methodName,
+                                           xmlrpc_bool       const check);
+
+/* With coalescing, a call that arrives while an identical one (same
+   method, same parameters) is executing waits for that one and shares its
+   result or fault.  If the executing call fails before it gets to execute
+   -- its deadline passes, its client disconnects, or the method's limits
+   refuse it -- a waiting call executes in its place.  Calls through
+   xmlrpc_registry_process_call_async() of a method with an asynchronous
+   method function never coalesce; each executes on its own.
+*/
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_coalescing(xmlrpc_env *      const envP,
+                                      xmlrpc_registry * const registryP,
+                                      const char *      const methodName,
+                                      xmlrpc_bool       const coalesce);
+
+/* A method whose result depends only on its parameters may have the
+   registry cache its responses.  A call with the same parameters as a
+   cached one gets the cached response, without the method executing and
+   without the preinvoke function or any limits of the method applying.
+   Only successful responses get cached, and not those to calls made
+   through system.multicall.  Set the cache before the registry serves
+   calls; setting it again empties it and starts its statistics over.
+*/
+
+struct xmlrpc_method_cache_parms {
+    unsigned int ttlMs;
+        /* How long a cached response stays valid, in milliseconds.  Zero
+           means forever.
+        */
+    unsigned int maxEntries;
+        /* Maximum number of responses in the cache; when it is full, the
+           least recently used one goes.  Zero means no caching.
+        */
+    size_t       maxBytes;
+        /* Maximum memory the cached responses may use.  Zero means no
+           limit.
+        */
+};
+
+struct xmlrpc_method_cache_stats {
+    unsigned long hitCt;
+        /* Calls that got a cached response */
+    unsigned long missCt;
+        /* Calls for which there was no valid cached response */
+    unsigned long expiredCt;
+        /* Cached responses discarded for being too old */
+    unsigned long evictedCt;
+        /* Cached responses discarded to make room for newer ones */
+    unsigned int  entryCt;
+        /* Responses in the cache now */
+    size_t        byteCt;
+        /* Memory the responses in the cache use now */
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_set_method_cache(
+    xmlrpc_env *                             const envP,
+    xmlrpc_registry *                        const registryP,
+    const char *                             const methodName,
+    const struct xmlrpc_method_cache_parms * const parmsP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_method_cache_stats(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const char *                       const methodName,
+    struct xmlrpc_method_cache_stats * const statsP);
+
+/* The registry keeps statistics on the calls of each method: how many
+   there have been, how many failed, how many are executing now, and the
+   distribution of the time spent parsing each call, executing it, and
+   serializing its response.  The system.stats method reports them too.
+*/
+
+struct xmlrpc_latency_stats {
+    unsigned long count;
+        /* Number of times measured */
+    double        totalTime;
+        /* Seconds, all the times together */
+    double        maxTime;
+        /* Seconds, the longest time */
+    double        p50Time;
+    double        p90Time;
+    double        p99Time;
+        /* Seconds, percentiles of the times.  These are accurate to
+           within 1/8 of the value.
+        */
+};
+
+struct xmlrpc_method_stats {
+    unsigned long callCt;
+        /* Calls of the method that have finished executing.  Calls
+           answered from the method's result cache don't execute.
+        */
+    unsigned long faultCt;
+        /* Those of 'callCt' that failed */
+    unsigned int  inFlightCt;
+        /* Calls of the method executing now */
+    struct xmlrpc_latency_stats parse;
+        /* Time to parse the call XML */
+    struct xmlrpc_latency_stats execute;
+        /* Time from dispatching the call to having its result, including
+           waiting for concurrency limits
+        */
+    struct xmlrpc_latency_stats serialize;
+        /* Time to make the response XML */
+};
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_get_method_stats(xmlrpc_env *                 const envP,
+                                 xmlrpc_registry *            const registryP,
+                                 const char *                 const methodName,
+                                 struct xmlrpc_method_stats * const statsP);
+
+struct xmlrpc_call_times {
+    double parseTime;
+    double executeTime;
+    double serializeTime;
+        /* Seconds */
+};
+
+/* For a server that executes calls of some methods itself, without the
+   registry -- the C++ registry does this -- so the method statistics
+   still count them.  Get the method once with xmlrpc_registry_find_method()
+   and bracket the execution of each call with
+   xmlrpc_registry_native_call_begin() and xmlrpc_registry_native_call_end().
+   The method stays valid as long as the registry.
+*/
+struct xmlrpc_methodInfo;
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_find_method(xmlrpc_env *                const envP,
+                            xmlrpc_registry *           const registryP,
+                            const char *                const methodName,
+                            struct xmlrpc_methodInfo ** const methodPP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_native_call_begin(struct xmlrpc_methodInfo * const methodP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_native_call_end(
+    struct xmlrpc_methodInfo *       const methodP,
+    const struct xmlrpc_call_times * const timesP,
+    xmlrpc_bool                      const failed);
+
 /*----------------------------------------------------------------------------
    Lower interface -- services to be used by an HTTP request handler
 -----------------------------------------------------------------------------*/
                     
+/* A call control says how long the caller of an RPC will wait for its
+   result and whether it has given up.  A server that knows that passes it
+   to xmlrpc_registry_process_call3(), which won't start executing the call
+   after the caller stopped waiting; a method that might run long checks
+   xmlrpc_call_cancelled() now and then.
+*/
+
+typedef xmlrpc_bool xmlrpc_peer_gone_fn(void * const context);
+
+typedef struct {
+    double deadline;
+        /* When, in seconds since the epoch, the caller stops waiting for
+           the result.  Zero means it never does.
+        */
+    xmlrpc_peer_gone_fn * peerGone;
+        /* Function that tells whether the caller has gone away (e.g.
+           closed the connection), called with argument 'peerGoneContext'.
+           NULL means there is no way to tell.
+        */
+    void * peerGoneContext;
+    xmlrpc_bool cancelled;
+        /* The call has been cancelled.  Use xmlrpc_call_cancelled() to find
+           out whether it should be.
+        */
+} xmlrpc_call_ctl;
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_call_ctl_init(xmlrpc_call_ctl * const ctlP,
+                     unsigned int      const timeoutMs);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_call_cancel(xmlrpc_call_ctl * const ctlP);
+
+XMLRPC_SERVER_EXPORTED
+xmlrpc_bool
+xmlrpc_call_cancelled(xmlrpc_call_ctl * const ctlP);
+
+XMLRPC_SERVER_EXPORTED
+double
+xmlrpc_call_time_left(const xmlrpc_call_ctl * const ctlP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_call3(xmlrpc_env *        const envP,
+                              xmlrpc_registry *   const registryP,
+                              const char *        const xmlData,
+                              size_t              const xmlLen,
+                              void *              const callInfo,
+                              xmlrpc_call_ctl *   const ctlP,
+                              xmlrpc_mem_block ** const outputPP);
+
 XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
@@ -167,6 +510,44 @@ xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
                               void *              const callInfo,
                               xmlrpc_mem_block ** const outputPP);
 
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_parsed_call(
+    xmlrpc_env *        const envP,
+    xmlrpc_registry *   const registryP,
+    const char *        const methodName,
+    xmlrpc_value *      const paramArrayP,
+    void *              const callInfo,
+    xmlrpc_call_ctl *   const ctlP,
+    double              const parseTime,
+    xmlrpc_mem_block ** const responseXmlPP);
+
+typedef void xmlrpc_response_fn(void *             const context,
+                                const xmlrpc_env * const faultP,
+                                xmlrpc_mem_block * const responseXmlP);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_call_async(xmlrpc_registry *    const registryP,
+                                   const char *         const xmlData,
+                                   size_t               const xmlLen,
+                                   void *               const callInfo,
+                                   xmlrpc_call_ctl *    const ctlP,
+                                   xmlrpc_response_fn * const responseFn,
+                                   void *               const context);
+
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_process_parsed_call_async(
+    xmlrpc_registry *    const registryP,
+    const char *         const methodName,
+    xmlrpc_value *       const paramArrayP,
+    void *               const callInfo,
+    xmlrpc_call_ctl *    const ctlP,
+    double               const parseTime,
+    xmlrpc_response_fn * const responseFn,
+    void *               const context);
+
 XMLRPC_SERVER_EXPORTED
 xmlrpc_mem_block *
 xmlrpc_registry_process_call(xmlrpc_env *      const envP,
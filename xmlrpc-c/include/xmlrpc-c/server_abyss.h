@@ -100,6 +100,24 @@ typedef struct {
     socklen_t         sockaddrlen;
     unsigned int      max_conn;
     unsigned int      max_conn_backlog;
+    xmlrpc_bool       use_io_uring;
+        /* Do socket I/O through io_uring (Linux), falling back to epoll
+           where the kernel doesn't have it.  No effect on a Unix domain
+           socket or on Windows.
+        */
+    unsigned int      worker_processes;
+        /* Run the server in this many pre-forked worker processes, all
+           accepting connections on the same listening socket, and
+           supervise them.  Zero means serve in the calling process.
+           No effect on Windows.
+        */
+    unsigned int      call_timeout_ms;
+        /* Give up on a call that hasn't started executing this many
+           milliseconds after it arrived, and tell the method how long it
+           has (see xmlrpc_server_abyss_call_ctl()).  A client may ask for
+           less with an X-RPC-Deadline HTTP header.  Zero means no limit
+           but what the client asks for.
+        */
 } xmlrpc_server_abyss_parms;
 
 
@@ -188,6 +206,23 @@ xmlrpc_call_processor(xmlrpc_env *        const envP,
                       TSession *          const abyssSessionP,
                       xmlrpc_mem_block ** const responseXmlPP);
 
+/* An asynchronous call processor may finish the call after it returns,
+   from any thread, by calling responseFn(responseContext, ...) with the
+   response (see xmlrpc_registry_process_call_async()).  The handler
+   doesn't hold a thread for the call meanwhile, if the Abyss server can
+   do without one (see SessionDeferResponse()).  'abyssSessionP' and
+   'callCtlP' stay valid until the processor calls the response function;
+   'callXml' only until the processor returns.
+*/
+typedef void
+xmlrpc_call_processor_async(void *               const processorArg,
+                            const char *         const callXml,
+                            size_t               const callXmlLen,
+                            TSession *           const abyssSessionP,
+                            xmlrpc_call_ctl *    const callCtlP,
+                            xmlrpc_response_fn * const responseFn,
+                            void *               const responseContext);
+
 typedef struct {
     xmlrpc_call_processor * xml_processor;
     void *                  xml_processor_arg;
@@ -198,6 +233,13 @@ typedef struct {
         /* NULL means don't answer HTTP access control query */
     xmlrpc_bool             access_ctl_expires;
     unsigned int            access_ctl_max_age;
+    unsigned int            call_timeout_ms;
+        /* Same as in xmlrpc_server_abyss_parms */
+    xmlrpc_call_processor_async * xml_processor_async;
+        /* NULL means there isn't one.  Otherwise, the handler processes
+           calls with this instead of 'xml_processor', with the same
+           'xml_processor_arg'.
+        */
 } xmlrpc_server_abyss_handler_parms;
 
 #define XMLRPC_AHPSIZE(MBRNAME) \
@@ -252,6 +294,15 @@ XMLRPC_SERVER_ABYSS_EXPORTED
 void
 xmlrpc_server_abyss_set_default_handler(TServer * const serverP);
 
+/* The call control (deadline, whether the client is still there) of the
+   call the Xmlrpc-c handler is processing on an Abyss session.  NULL if it
+   isn't processing one.  The callInfo argument of a method of a registry
+   served by the handler is such a session.
+*/
+XMLRPC_SERVER_ABYSS_EXPORTED
+xmlrpc_call_ctl *
+xmlrpc_server_abyss_call_ctl(TSession * const abyssSessionP);
+
 /*=========================================================================
 **  Handy Abyss Extensions
 **=======================================================================*/
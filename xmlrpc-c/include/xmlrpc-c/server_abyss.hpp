@@ -73,6 +73,10 @@ public:
         constrOpt & logFileName       (std::string    const& arg);
         constrOpt & serverOwnsSignals (bool           const& arg);
         constrOpt & expectSigchld     (bool           const& arg);
+        constrOpt & unixSocketPath    (std::string    const& arg);
+        constrOpt & useIoUring        (bool           const& arg);
+        constrOpt & workerProcesses   (unsigned int   const& arg);
+        constrOpt & callTimeout       (unsigned int   const& arg);
 
     private:
         struct constrOpt_impl * implP;
@@ -7,6 +7,10 @@
 #include "xmlrpc-c/util.h"
 #include "int.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*
   XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
   libxmlrpc_util.
@@ -50,4 +54,8 @@ void
 xmlrpc_gmtime(time_t      const datetime,
               struct tm * const resultP);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
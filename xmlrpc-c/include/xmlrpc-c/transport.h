@@ -72,6 +72,30 @@ typedef void (*xmlrpc_transport_set_interrupt)(
     struct xmlrpc_client_transport * const clientTransportP,
     int *                            const interruptP);
 
+typedef void (*xmlrpc_transport_finish_until)(
+    struct xmlrpc_client_transport * const clientTransportP,
+    xmlrpc_timeoutType               const timeoutType,
+    xmlrpc_timeout                   const timeout,
+    const int *                      const doneP);
+    /* Same as finish_asynch, except return as soon as *doneP is nonzero
+       (which an RPC's completion function may make it), leaving the other
+       RPCs in progress.
+    */
+
+typedef void (*xmlrpc_transport_send_request_cancelable)(
+    xmlrpc_env *                     const envP, 
+    struct xmlrpc_client_transport * const clientTransportP,
+    const xmlrpc_server_info *       const serverP,
+    xmlrpc_mem_block *               const xmlP,
+    xmlrpc_transport_asynch_complete       complete,
+    xmlrpc_transport_progress              progress,
+    const int *                      const cancelP,
+    struct xmlrpc_call_info *        const callInfoP);
+    /* Same as send_request, except that once *cancelP is nonzero, the
+       transport gives up on the RPC and completes it with a failure the
+       next time it works on it (e.g. in finish_until).
+    */
+
 struct xmlrpc_client_transport_ops {
 
     xmlrpc_transport_setup         setup_global_const;
@@ -82,6 +106,14 @@ struct xmlrpc_client_transport_ops {
     xmlrpc_transport_call          call;
     xmlrpc_transport_finish_asynch finish_asynch;
     xmlrpc_transport_set_interrupt set_interrupt;
+    xmlrpc_transport_finish_until  finish_until;
+        /* NULL means the transport can't; the client then waits for all
+           RPCs with finish_asynch.
+        */
+    xmlrpc_transport_send_request_cancelable send_request_cancelable;
+        /* NULL means the transport can't; the client then lets the RPC
+           run to completion.
+        */
 };
 
 extern int xmlrpc_trace_transport;
@@ -0,0 +1,69 @@
+#ifndef WORKPOOL_INT_H_INCLUDED
+#define WORKPOOL_INT_H_INCLUDED
+
+#include "xmlrpc-c/c_util.h"
+#include "xmlrpc-c/util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
+  libxmlrpc_util.
+
+  XMLRPC_BUILDING_UTIL says this compilation is part of libxmlrpc_util, as
+  opposed to something that _uses_ libxmlrpc_util.
+*/
+#ifdef XMLRPC_BUILDING_UTIL
+#define XMLRPC_UTIL_EXPORTED XMLRPC_DLLEXPORT
+#else
+#define XMLRPC_UTIL_EXPORTED
+#endif
+
+/* A work pool is a fixed set of threads that run jobs from a queue, in the
+   order they were submitted.
+*/
+
+struct xmlrpc_workpool;
+
+typedef void xmlrpc_workpoolFn(void * arg);
+
+typedef struct xmlrpc_workpoolJob {
+/*----------------------------------------------------------------------------
+   A job in a work pool's queue.  The submitter owns the memory; the pool
+   uses it from xmlrpc_workpoolSubmit() until the job starts running or
+   xmlrpc_workpoolCancel() removes it.  The members are for the pool's use.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_workpoolJob * nextP;
+    xmlrpc_workpoolFn * fn;
+    void * arg;
+} xmlrpc_workpoolJob;
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_workpoolCreate(xmlrpc_env *              const envP,
+                      unsigned int              const threadCt,
+                      struct xmlrpc_workpool ** const poolPP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_workpoolDestroy(struct xmlrpc_workpool * const poolP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_workpoolSubmit(struct xmlrpc_workpool * const poolP,
+                      xmlrpc_workpoolJob *     const jobP,
+                      xmlrpc_workpoolFn *      const fn,
+                      void *                   const arg);
+
+XMLRPC_UTIL_EXPORTED
+int
+xmlrpc_workpoolCancel(struct xmlrpc_workpool * const poolP,
+                      xmlrpc_workpoolJob *     const jobP);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -139,6 +139,39 @@ ChannelWrite(TChannel *            const channelP,
 
 
 
+void
+ChannelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   Write the segments iov[] to the channel, in order, as if by successive
+   ChannelWrite()s.  But where the implementation can do it, write them all
+   with a single system call (or a single record, for a channel that has
+   records), which saves system calls and keeps the segments together on the
+   wire.
+-----------------------------------------------------------------------------*/
+    if (ChannelTraceIsActive)
+        fprintf(stderr, "Writing %u segments to channel %p\n",
+                iovCt, channelP);
+
+    if (channelP->vtbl.writev)
+        (*channelP->vtbl.writev)(channelP, iov, iovCt, failedP);
+    else {
+        unsigned int i;
+        bool failed;
+
+        for (i = 0, failed = FALSE; i < iovCt && !failed; ++i) {
+            if (iov[i].len > 0)
+                (*channelP->vtbl.write)(channelP, iov[i].base, iov[i].len,
+                                        &failed);
+        }
+        *failedP = failed;
+    }
+}
+
+
+
 void
 ChannelRead(TChannel *      const channelP, 
             unsigned char * const buffer, 
@@ -188,6 +221,42 @@ ChannelInterrupt(TChannel * const channelP) {
 
 
 
+void
+ChannelAbort(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   Make any I/O in progress on the channel, in any thread, and any I/O
+   anyone does on it later, stop promptly -- a read or write fails and a
+   wait returns as if interrupted.  This is for giving up on a channel
+   whose partner has stopped cooperating, e.g. stopped reading what we
+   send.
+-----------------------------------------------------------------------------*/
+    if (ChannelTraceIsActive)
+        fprintf(stderr, "Aborting channel I/O\n");
+
+    if (channelP->vtbl.abort)
+        (*channelP->vtbl.abort)(channelP);
+    else
+        (*channelP->vtbl.interrupt)(channelP);
+}
+
+
+
+bool
+ChannelPeerGone(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   Tell whether the partner has gone away -- closed or reset its end of
+   the channel -- without reading anything from the channel.  It is for
+   noticing while we are busy producing a response that nobody is left to
+   receive it.
+
+   A false answer is not a promise: an implementation that cannot tell
+   always says false.
+-----------------------------------------------------------------------------*/
+    return channelP->vtbl.peerGone && (*channelP->vtbl.peerGone)(channelP);
+}
+
+
+
 void
 ChannelFormatPeerInfo(TChannel *    const channelP,
                       const char ** const peerStringP) {
@@ -195,3 +264,40 @@ ChannelFormatPeerInfo(TChannel *    const channelP,
     (*channelP->vtbl.formatPeerInfo)(channelP, peerStringP);
 }
 
+
+
+
+bool
+ChannelCanSendFile(TChannel * const channelP) {
+
+    return channelP->vtbl.sendFile != NULL;
+}
+
+
+
+void
+ChannelSendFile(TChannel *            const channelP,
+                const unsigned char * const prefix,
+                uint32_t              const prefixLen,
+                int                   const fd,
+                uint64_t              const start,
+                uint64_t              const len,
+                bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   Write the 'prefixLen' bytes at 'prefix', followed by 'len' bytes of the
+   open file 'fd' starting at offset 'start', to the channel.  Do it without
+   copying the file contents through user space where the implementation
+   can, and without using or changing the file's current offset, so
+   multiple threads may send from the same open file at once.
+
+   Valid only if ChannelCanSendFile() says so.
+-----------------------------------------------------------------------------*/
+    if (ChannelTraceIsActive)
+        fprintf(stderr, "Sending %u + %" PRIu64 " bytes from file %d "
+                "to channel %p\n", prefixLen, len, fd, channelP);
+
+    assert(channelP->vtbl.sendFile);
+
+    (*channelP->vtbl.sendFile)(channelP, prefix, prefixLen,
+                               fd, start, len, failedP);
+}
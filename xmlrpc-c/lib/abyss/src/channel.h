@@ -29,6 +29,19 @@ typedef void ChannelWriteImpl(TChannel *            const channelP,
                               uint32_t              const len,
                               bool *                const failedP);
 
+typedef struct {
+/*----------------------------------------------------------------------------
+   One segment of a gather write (ChannelWritev()).
+-----------------------------------------------------------------------------*/
+    const unsigned char * base;
+    uint32_t              len;
+} TChannelIoVec;
+
+typedef void ChannelWritevImpl(TChannel *            const channelP,
+                               const TChannelIoVec * const iov,
+                               unsigned int          const iovCt,
+                               bool *                const failedP);
+
 typedef void ChannelReadImpl(TChannel *      const channelP,
                              unsigned char * const buffer,
                              uint32_t        const len,
@@ -50,13 +63,41 @@ typedef void ChannelInterruptImpl(TChannel * const channelP);
 typedef void ChannelFormatPeerInfoImpl(TChannel *    const channelP,
                                        const char ** const peerStringP);
 
+typedef void ChannelSendFileImpl(TChannel *            const channelP,
+                                 const unsigned char * const prefix,
+                                 uint32_t              const prefixLen,
+                                 int                   const fd,
+                                 uint64_t              const start,
+                                 uint64_t              const len,
+                                 bool *                const failedP);
+
+typedef void ChannelAbortImpl(TChannel * const channelP);
+
+typedef bool ChannelPeerGoneImpl(TChannel * const channelP);
+
 struct TChannelVtbl {
     ChannelDestroyImpl            * destroy;
     ChannelWriteImpl              * write;
+    ChannelWritevImpl             * writev;
+        /* NULL means the implementation can't do a gather write;
+           ChannelWritev() then writes the segments one at a time.
+        */
     ChannelReadImpl               * read;
     ChannelWaitImpl               * wait;
     ChannelInterruptImpl          * interrupt;
     ChannelFormatPeerInfoImpl     * formatPeerInfo;
+    ChannelSendFileImpl           * sendFile;
+        /* NULL means the implementation can't send straight from a file;
+           the user must read the file and write what it reads.
+        */
+    ChannelAbortImpl              * abort;
+        /* NULL means the implementation can't stop I/O in progress;
+           ChannelAbort() then just interrupts waits.
+        */
+    ChannelPeerGoneImpl           * peerGone;
+        /* NULL means the implementation can't tell whether the partner
+           has gone away; ChannelPeerGone() then always says it hasn't.
+        */
 };
 
 struct _TChannel {
@@ -86,6 +127,12 @@ ChannelWrite(TChannel *            const channelP,
              uint32_t              const len,
              bool *                const failedP);
 
+void
+ChannelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              bool *                const failedP);
+
 void
 ChannelRead(TChannel *      const channelP, 
             unsigned char * const buffer, 
@@ -105,8 +152,26 @@ ChannelWait(TChannel * const channelP,
 void
 ChannelInterrupt(TChannel * const channelP);
 
+void
+ChannelAbort(TChannel * const channelP);
+
+bool
+ChannelPeerGone(TChannel * const channelP);
+
 void
 ChannelFormatPeerInfo(TChannel *    const channelP,
                       const char ** const peerStringP);
 
+bool
+ChannelCanSendFile(TChannel * const channelP);
+
+void
+ChannelSendFile(TChannel *            const channelP,
+                const unsigned char * const prefix,
+                uint32_t              const prefixLen,
+                int                   const fd,
+                uint64_t              const start,
+                uint64_t              const len,
+                bool *                const failedP);
+
 #endif
@@ -7,11 +7,13 @@
 #include <ctype.h>
 #include <assert.h>
 
+#include "c_util.h"
 #include "bool.h"
 #include "mallocvar.h"
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/lock_platform.h"
 #include "xmlrpc-c/abyss.h"
 #include "channel.h"
 #include "server.h"
@@ -38,7 +40,19 @@ connJob(void * const userHandle) {
 
     (connectionP->job)(connectionP);
 
-    connectionP->finished = TRUE;
+    if (connectionP->deferLockP) {
+        /* The job left a response for someone else to finish.  Whichever
+           of us is last finishes the connection.
+        */
+        connectionP->deferLockP->acquire(connectionP->deferLockP);
+        connectionP->jobDone = TRUE;
+        connectionP->jobFinishes = !connectionP->responsePending;
+        connectionP->deferLockP->release(connectionP->deferLockP);
+    } else
+        connectionP->jobFinishes = TRUE;
+
+    if (connectionP->jobFinishes)
+        connectionP->finished = TRUE;
         /* Note that if we are running in a forked process, setting
            connectionP->finished has no effect, because it's just our own
            copy of *connectionP.  In this case, Parent must update his own
@@ -83,7 +97,8 @@ threadDone(void * const userHandle) {
 
     TConn * const connectionP = userHandle;
     
-    connDone(connectionP);
+    if (connectionP->jobFinishes)
+        connDone(connectionP);
 }
 
 
@@ -172,9 +187,18 @@ ConnCreate(TConn **            const connectionPP,
         connectionP->finished     = FALSE;
         connectionP->job          = job;
         connectionP->done         = done;
+        connectionP->responseDeferred = FALSE;
+        connectionP->deferLockP   = NULL;
+        connectionP->jobFinishes  = TRUE;
         connectionP->inbytes      = 0;
         connectionP->outbytes     = 0;
+        connectionP->deferredOutput      = NULL;
+        connectionP->deferredOutputSize  = 0;
+        connectionP->deferredOutputAlloc = 0;
         connectionP->trace        = getenv("ABYSS_TRACE_CONN");
+        connectionP->timersP      = serverP->srvP->connTimersP;
+
+        ConnTimerInit(&connectionP->timer, channelP);
 
         makeThread(connectionP, foregroundBackground, useSigchld,
                    jobStackSize, errorP);
@@ -222,11 +246,98 @@ ConnWaitAndRelease(TConn * const connectionP) {
         assert(connectionP->threadP);
         ThreadWaitAndRelease(connectionP->threadP);
     }
+    if (connectionP->deferredOutput)
+        free(connectionP->deferredOutput);
+    if (connectionP->deferLockP)
+        connectionP->deferLockP->destroy(connectionP->deferLockP);
+
     free(connectionP);
 }
 
 
 
+bool
+ConnDeferResponse(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Let the job hand the response to its current request to someone else,
+   who sends it from any thread and then calls ConnDeferredResponseDone().
+   The job must not do anything more with the connection; it just returns,
+   and its thread exits.  The connection stays open until the response is
+   finished.
+
+   Return false, and don't defer anything, if we can't do that: the job
+   doesn't run in a thread of its own (it runs in Caller's, or in a forked
+   process), so nothing would be freed by it, or we can't get a lock.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    assert(!connectionP->responseDeferred);
+
+    if (!connectionP->hasOwnThread || ThreadForks())
+        retval = FALSE;
+    else {
+        connectionP->deferLockP = xmlrpc_lock_create();
+
+        if (connectionP->deferLockP) {
+            connectionP->responsePending  = TRUE;
+            connectionP->jobDone          = FALSE;
+            connectionP->responseDeferred = TRUE;
+            retval = TRUE;
+        } else
+            retval = FALSE;
+    }
+    return retval;
+}
+
+
+
+void
+ConnDeferredResponseDone(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   The response the job deferred with ConnDeferResponse() has been sent.
+
+   If the job has already returned, finish the connection.  The server may
+   free it as soon as we do that, so we do it last.
+-----------------------------------------------------------------------------*/
+    bool jobDone;
+
+    assert(connectionP->deferLockP);
+
+    connectionP->deferLockP->acquire(connectionP->deferLockP);
+    connectionP->responsePending = FALSE;
+    jobDone = connectionP->jobDone;
+    connectionP->deferLockP->release(connectionP->deferLockP);
+
+    if (jobDone) {
+        if (connectionP->done)
+            connectionP->done(connectionP);
+
+        connectionP->finished = TRUE;
+    }
+}
+
+
+
+bool
+ConnIsParked(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   The connection's job has returned, leaving a deferred response
+   outstanding, so the connection has no thread working on it.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    if (connectionP->deferLockP) {
+        connectionP->deferLockP->acquire(connectionP->deferLockP);
+        retval = connectionP->jobDone && connectionP->responsePending;
+        connectionP->deferLockP->release(connectionP->deferLockP);
+    } else
+        retval = FALSE;
+
+    return retval;
+}
+
+
+
 bool
 ConnKill(TConn * const connectionP) {
     connectionP->finished = TRUE;
@@ -254,6 +365,35 @@ ConnReadInit(TConn * const connectionP) {
 
 
 
+bool
+ConnHasBufferedRequest(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Return true iff the connection's read buffer already contains at least
+   the beginning of another HTTP request, beyond what the user has consumed.
+   That's the case when the client pipelines requests: it sends the next
+   request without waiting for the response to the previous one, so the
+   next request arrives in the same read as the tail of the previous one.
+
+   Empty lines (which RFC 2616 Section 4.1 says we must ignore before a
+   request line) don't count as the beginning of a request.
+-----------------------------------------------------------------------------*/
+    uint32_t i;
+    bool found;
+
+    for (i = connectionP->bufferpos, found = FALSE;
+         i < connectionP->buffersize && !found;
+         ++i) {
+
+        char const c = connectionP->buffer.t[i];
+
+        if (c != CR && c != LF)
+            found = TRUE;
+    }
+    return found;
+}
+
+
+
 static void
 traceReadTimeout(TConn *  const connectionP,
                  uint32_t const timeout) {
@@ -434,12 +574,58 @@ dealWithReadEof(bool *        const eofP,
 
 
 
+static void
+countTimeout(TConn *          const connectionP,
+             TConnTimerReason const reason) {
+
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    srvP->statsLockP->acquire(srvP->statsLockP);
+    ++srvP->connTimeoutCt[reason];
+    srvP->statsLockP->release(srvP->statsLockP);
+}
+
+
+
+static void
+startTimer(TConn *          const connectionP,
+           TConnTimerReason const reason,
+           uint32_t         const timeoutMs) {
+
+    if (connectionP->timersP)
+        ConnTimerStart(connectionP->timersP, &connectionP->timer,
+                       reason, timeoutMs);
+}
+
+
+
+static bool
+stopTimer(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Stop the timer startTimer() started, and return whether it expired.
+-----------------------------------------------------------------------------*/
+    bool expired;
+
+    if (connectionP->timersP) {
+        expired = ConnTimerStop(connectionP->timersP, &connectionP->timer);
+
+        if (expired)
+            countTimeout(connectionP, connectionP->timer.reason);
+    } else
+        expired = FALSE;
+
+    return expired;
+}
+
+
+
 void
-ConnRead(TConn *       const connectionP,
-         uint32_t      const timeout,
-         bool *        const eofP,
-         bool *        const timedOutP,
-         const char ** const errorP) {
+ConnRead(TConn *          const connectionP,
+         uint32_t         const timeout,
+         TConnTimerReason const reason,
+         bool *           const eofP,
+         bool *           const timedOutP,
+         const char **    const errorP) {
 /*----------------------------------------------------------------------------
    Read some stuff on connection *connectionP from the channel.  Read it into
    the connection's buffer.
@@ -447,7 +633,11 @@ ConnRead(TConn *       const connectionP,
    Don't wait more than 'timeout' seconds for data to arrive.  If no data has
    arrived by then and 'timedOutP' is null, fail.  If 'timedOut' is non-null,
    return as *timedOutP whether 'timeout' seconds passed without any data
-   arriving.
+   arriving.  'reason' is what the wait is for, which determines how we
+   count it if it times out (see ServerGetStats()).
+
+   Where the connection has timers, a timer ends the wait; otherwise, we
+   time the wait ourselves.
 
    Also, stop waiting upon any interruption and treat it the same as a
    timeout.  An interruption is either a signal received (and caught) at
@@ -469,16 +659,26 @@ ConnRead(TConn *       const connectionP,
 
         bool readyForRead;
         bool failed;
-            
+        bool expired;
+
+        startTimer(connectionP, reason, timeoutMs);
+
         ChannelWait(connectionP->channelP, waitForRead, waitForWrite,
-                    timeoutMs, &readyForRead, NULL, &failed);
-            
+                    connectionP->timersP ? TIME_INFINITE : timeoutMs,
+                    &readyForRead, NULL, &failed);
+
+        expired = stopTimer(connectionP);
+
+        if (!connectionP->timersP && !failed && !readyForRead &&
+            !connectionP->server->srvP->terminationRequested)
+            countTimeout(connectionP, reason);
+
         if (failed)
             xmlrpc_asprintf(errorP,
                             "Wait for stuff to arrive from client failed.");
         else {
             bool eof;
-            if (readyForRead) {
+            if (readyForRead && !expired) {
                 readFromChannel(connectionP, &eof, errorP);
             } else {
                 /* Wait was interrupted, either by our requested timeout,
@@ -489,7 +689,8 @@ ConnRead(TConn *       const connectionP,
                 eof = FALSE;
             }
             if (!*errorP)
-                dealWithReadTimeout(timedOutP, !readyForRead, timeout, errorP);
+                dealWithReadTimeout(timedOutP, !readyForRead || expired,
+                                    timeout, errorP);
             if (!*errorP)
                 dealWithReadEof(eofP, eof, errorP);
         }
@@ -497,21 +698,213 @@ ConnRead(TConn *       const connectionP,
 }
 
 
-            
+
+static void
+startWriteTimer(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Limit the time the next write to the channel may take, which is the
+   same as the time we wait for a read.  If the client doesn't take what we
+   send by then, we give up on the connection.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    startTimer(connectionP, CONNTIMER_WRITE, srvP->timeout * 1000);
+}
+
+
+
+static void
+writeToChannel(TConn *      const connectionP,
+               const void * const buffer,
+               uint32_t     const size,
+               bool *       const failedP) {
+
+    startWriteTimer(connectionP);
+
+    ChannelWrite(connectionP->channelP, buffer, size, failedP);
+
+    if (stopTimer(connectionP))
+        *failedP = TRUE;
+}
+
+
+
+static void
+writevToChannel(TConn *               const connectionP,
+                const TChannelIoVec * const iov,
+                unsigned int          const iovCt,
+                bool *                const failedP) {
+
+    startWriteTimer(connectionP);
+
+    ChannelWritev(connectionP->channelP, iov, iovCt, failedP);
+
+    if (stopTimer(connectionP))
+        *failedP = TRUE;
+}
+
+
+
 bool
 ConnWrite(TConn *      const connectionP,
           const void * const buffer,
           uint32_t     const size) {
+/*----------------------------------------------------------------------------
+   Write 'buffer' to the connection, preceded by any data held by a previous
+   ConnWriteDeferred().  We write both in a single channel operation.
+-----------------------------------------------------------------------------*/
+    bool failed;
+
+    if (connectionP->deferredOutputSize > 0) {
+        TChannelIoVec iov[2];
+
+        iov[0].base = connectionP->deferredOutput;
+        iov[0].len  = connectionP->deferredOutputSize;
+        iov[1].base = buffer;
+        iov[1].len  = size;
+
+        writevToChannel(connectionP, iov, ARRAY_SIZE(iov), &failed);
+
+        traceChannelWrite(connectionP,
+                          (const char *)connectionP->deferredOutput,
+                          connectionP->deferredOutputSize, failed);
+        traceChannelWrite(connectionP, buffer, size, failed);
 
+        if (!failed)
+            connectionP->outbytes += connectionP->deferredOutputSize + size;
+
+        connectionP->deferredOutputSize = 0;
+    } else {
+        writeToChannel(connectionP, buffer, size, &failed);
+
+        traceChannelWrite(connectionP, buffer, size, failed);
+
+        if (!failed)
+            connectionP->outbytes += size;
+    }
+    return !failed;
+}
+
+
+
+bool
+ConnWriteDeferred(TConn *      const connectionP,
+                  const void * const buffer,
+                  uint32_t     const size) {
+/*----------------------------------------------------------------------------
+   Arrange for 'buffer' to be written to the connection along with
+   whatever gets written next, by ConnWrite() or ConnFlush().  We copy
+   'buffer'.
+
+   This is for pieces of a response that are not worth a system call (or
+   TLS record, or TCP segment) of their own, such as the lines of an HTTP
+   response header: they go out together with the body that follows them.
+
+   If we can't get memory to hold the data, we just write it now.
+-----------------------------------------------------------------------------*/
+    uint32_t const newSize = connectionP->deferredOutputSize + size;
+
+    bool retval;
+
+    if (newSize > connectionP->deferredOutputAlloc) {
+        uint32_t const newAlloc =
+            MAX(newSize, MAX(connectionP->deferredOutputAlloc * 2, 1024));
+        unsigned char * const newBuffer =
+            realloc(connectionP->deferredOutput, newAlloc);
+
+        if (newBuffer) {
+            connectionP->deferredOutput      = newBuffer;
+            connectionP->deferredOutputAlloc = newAlloc;
+        }
+    }
+    if (newSize > connectionP->deferredOutputAlloc)
+        retval = ConnWrite(connectionP, buffer, size);
+    else {
+        memcpy(connectionP->deferredOutput + connectionP->deferredOutputSize,
+               buffer, size);
+        connectionP->deferredOutputSize = newSize;
+        retval = TRUE;
+    }
+    return retval;
+}
+
+
+
+bool
+ConnFlush(TConn * const connectionP) {
+/*----------------------------------------------------------------------------
+   Write any data held by ConnWriteDeferred() to the connection now.
+-----------------------------------------------------------------------------*/
+    bool failed;
+
+    if (connectionP->deferredOutputSize > 0) {
+        writeToChannel(connectionP, connectionP->deferredOutput,
+                       connectionP->deferredOutputSize, &failed);
+
+        traceChannelWrite(connectionP,
+                          (const char *)connectionP->deferredOutput,
+                          connectionP->deferredOutputSize, failed);
+
+        if (!failed)
+            connectionP->outbytes += connectionP->deferredOutputSize;
+
+        connectionP->deferredOutputSize = 0;
+    } else
+        failed = FALSE;
+
+    return !failed;
+}
+
+
+
+#define SEND_FILE_CHUNK (1024 * 1024)
+    /* We send a file this much at a time, so that the write timeout is
+       for sending this much, not the whole file.
+    */
+
+static bool
+sendFromFile(TConn *       const connectionP,
+             const TFile * const fileP,
+             uint64_t      const start,
+             uint64_t      const len) {
+/*----------------------------------------------------------------------------
+   Send the part of the file straight from the file to the channel,
+   preceded by any data held by a previous ConnWriteDeferred().
+-----------------------------------------------------------------------------*/
+    uint64_t bytesSent;
     bool failed;
 
-    ChannelWrite(connectionP->channelP, buffer, size, &failed);
+    for (bytesSent = 0, failed = FALSE;
+         (bytesSent < len || connectionP->deferredOutputSize > 0) && !failed;
+        ) {
+        uint64_t const chunkLen = MIN(len - bytesSent, SEND_FILE_CHUNK);
+
+        startWriteTimer(connectionP);
+
+        ChannelSendFile(connectionP->channelP,
+                        connectionP->deferredOutput,
+                        connectionP->deferredOutputSize,
+                        fileP->fd, start + bytesSent, chunkLen, &failed);
+
+        if (stopTimer(connectionP))
+            failed = TRUE;
+
+        traceChannelWrite(connectionP,
+                          (const char *)connectionP->deferredOutput,
+                          connectionP->deferredOutputSize, failed);
 
-    traceChannelWrite(connectionP, buffer, size, failed);
+        if (connectionP->trace)
+            fprintf(stderr, "%s %" PRIu64 " BYTES OF FILE\n",
+                    failed ? "FAILED TO WRITE TO CHANNEL" : "WROTE TO CHANNEL",
+                    chunkLen);
 
-    if (!failed)
-        connectionP->outbytes += size;
+        if (!failed)
+            connectionP->outbytes += connectionP->deferredOutputSize + chunkLen;
 
+        connectionP->deferredOutputSize = 0;
+
+        bytesSent += chunkLen;
+    }
     return !failed;
 }
 
@@ -532,27 +925,32 @@ ConnWriteFromFile(TConn *       const connectionP,
    Meter the reading so as not to read more than 'rate' bytes per second.
 
    Use the 'bufferSize' bytes at 'buffer' as an internal buffer for this.
+
+   Where the channel can send straight from a file and we aren't metering,
+   we don't use the buffer at all.
+
+   We don't use or change the file offset, so Caller may have multiple
+   threads sending from the same open file.
 -----------------------------------------------------------------------------*/
-    bool retval;
-    uint32_t waittime;
-    bool success;
-    uint32_t readChunkSize;
+    uint64_t const totalBytesToRead = last - start + 1;
 
-    if (rate > 0) {
-        readChunkSize = MIN(buffersize, rate);  /* One second's worth */
-        waittime = (1000 * buffersize) / rate;
-    } else {
-        readChunkSize = buffersize;
-        waittime = 0;
-    }
+    bool retval;
 
-    success = FileSeek(fileP, start, SEEK_SET);
-    if (!success)
-        retval = FALSE;
+    if (rate == 0 && ChannelCanSendFile(connectionP->channelP))
+        retval = sendFromFile(connectionP, fileP, start, totalBytesToRead);
     else {
-        uint64_t const totalBytesToRead = last - start + 1;
+        uint32_t waittime;
+        uint32_t readChunkSize;
         uint64_t bytesread;
 
+        if (rate > 0) {
+            readChunkSize = MIN(buffersize, rate);  /* One second's worth */
+            waittime = (1000 * buffersize) / rate;
+        } else {
+            readChunkSize = buffersize;
+            waittime = 0;
+        }
+
         bytesread = 0;  /* initial value */
 
         while (bytesread < totalBytesToRead) {
@@ -560,16 +958,17 @@ ConnWriteFromFile(TConn *       const connectionP,
             uint64_t const bytesToRead64 = MIN(readChunkSize, bytesLeft);
             uint32_t const bytesToRead   = (uint32_t)bytesToRead64;
             
-            uint32_t bytesReadThisTime;
+            int32_t bytesReadThisTime;
 
             assert(bytesToRead == bytesToRead64); /* readChunkSize is uint32 */
 
-            bytesReadThisTime = FileRead(fileP, buffer, bytesToRead);
-            bytesread += bytesReadThisTime;
+            bytesReadThisTime = FileReadAt(fileP, buffer, bytesToRead,
+                                           start + bytesread);
             
-            if (bytesReadThisTime > 0)
+            if (bytesReadThisTime > 0) {
+                bytesread += bytesReadThisTime;
                 ConnWrite(connectionP, buffer, bytesReadThisTime);
-            else
+            } else
                 break;
             
             if (waittime > 0)
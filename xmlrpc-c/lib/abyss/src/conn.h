@@ -3,7 +3,9 @@
 
 #include "bool.h"
 #include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/lock.h"
 #include "thread.h"
+#include "conntimer.h"
 
 struct TFile;
 
@@ -52,6 +54,43 @@ struct _TConn {
            is done with the connection, exits.
         */
     TThreadDoneFn * done;
+    bool responseDeferred;
+        /* The job has handed the response to its current request to
+           someone else to finish (see ConnDeferResponse()).  Set and read
+           only by the job.
+        */
+    lock * deferLockP;
+        /* Lock for 'responsePending' and 'jobDone'.  NULL unless the job
+           has deferred a response.
+        */
+    bool responsePending;
+        /* A deferred response isn't finished yet */
+    bool jobDone;
+        /* The job has returned */
+    bool jobFinishes;
+        /* When the job returned, the deferred response was already
+           finished, so it is up to the job's thread to finish the
+           connection.  Set and read only by that thread.
+        */
+    unsigned char * deferredOutput;
+        /* Data to be written to the channel ahead of whatever is written
+           next (see ConnWriteDeferred()).  Malloc'ed.  NULL if we haven't
+           needed any yet.
+        */
+    uint32_t deferredOutputSize;
+        /* Number of bytes at 'deferredOutput' */
+    uint32_t deferredOutputAlloc;
+        /* Size of the memory allocated for 'deferredOutput' */
+    TConnTimers * timersP;
+        /* The server's connection timers, which enforce our read, idle,
+           and write timeouts.  NULL if there aren't any; then we enforce
+           read and idle timeouts by timing our waits, and don't time out
+           writes.
+        */
+    TConnTimer timer;
+        /* Our timer in 'timersP'.  Meaningful only if 'timersP' is
+           non-null.
+        */
     union {
         unsigned char b[BUFFER_SIZE];  /* Just bytes */
         char          t[BUFFER_SIZE];  /* Taken as text */
@@ -85,21 +124,42 @@ ConnKill(TConn * const connectionP);
 void
 ConnWaitAndRelease(TConn * const connectionP);
 
+bool
+ConnDeferResponse(TConn * const connectionP);
+
+void
+ConnDeferredResponseDone(TConn * const connectionP);
+
+bool
+ConnIsParked(TConn * const connectionP);
+
 bool
 ConnWrite(TConn *      const connectionP,
           const void * const buffer,
           uint32_t     const size);
 
+bool
+ConnWriteDeferred(TConn *      const connectionP,
+                  const void * const buffer,
+                  uint32_t     const size);
+
+bool
+ConnFlush(TConn * const connectionP);
+
 void
-ConnRead(TConn *       const connectionP,
-         uint32_t      const timeout,
-         bool *        const eofP,
-         bool *        const timedOutP,
-         const char ** const errorP);
+ConnRead(TConn *          const connectionP,
+         uint32_t         const timeout,
+         TConnTimerReason const reason,
+         bool *           const eofP,
+         bool *           const timedOutP,
+         const char **    const errorP);
 
 void
 ConnReadInit(TConn * const connectionP);
 
+bool
+ConnHasBufferedRequest(TConn * const connectionP);
+
 bool
 ConnWriteFromFile(TConn *              const connectionP,
                   const struct TFile * const fileP,
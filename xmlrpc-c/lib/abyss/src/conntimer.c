@@ -0,0 +1,230 @@
+/*=============================================================================
+                                 conntimer.c
+===============================================================================
+  Timeouts for all of a server's connections, from one timer wheel.
+  See conntimer.h.
+=============================================================================*/
+
+#include <stdlib.h>
+
+#include "c_util.h"
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+#include "thread.h"
+#include "channel.h"
+#include "timerwheel.h"
+
+#include "conntimer.h"
+
+#define TICK_MS 100
+    /* Resolution of the timers.  Our thread wakes up this often. */
+
+struct TConnTimers {
+    lock * lockP;
+        /* Protects everything below, and every TConnTimer in the wheel */
+    TTimerWheel * wheelP;
+    uint64_t now;
+        /* Ticks since we started.  We count them ourselves rather than
+           read a clock, so setting the clock doesn't affect timeouts.
+        */
+    bool stopRequested;
+    TThread * threadP;
+        /* The thread that advances the wheel */
+};
+
+
+
+static TThreadProc tickThread;
+
+static void
+tickThread(void * const userHandle) {
+
+    TConnTimers * const timersP = userHandle;
+
+    bool stopRequested;
+
+    for (stopRequested = FALSE; !stopRequested; ) {
+        xmlrpc_millisecond_sleep(TICK_MS);
+
+        timersP->lockP->acquire(timersP->lockP);
+
+        ++timersP->now;
+        TimerWheelAdvance(timersP->wheelP, timersP->now);
+
+        stopRequested = timersP->stopRequested;
+
+        timersP->lockP->release(timersP->lockP);
+    }
+}
+
+
+
+static TThreadDoneFn tickThreadDone;
+
+static void
+tickThreadDone(void * const userHandle ATTR_UNUSED) {
+
+    /* There's nothing to clean up */
+}
+
+
+
+void
+ConnTimersCreate(TConnTimers ** const timersPP,
+                 const char **  const errorP) {
+
+    TConnTimers * timersP;
+
+    MALLOCVAR(timersP);
+
+    if (timersP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                        "connection timers");
+    else {
+        timersP->now           = 0;
+        timersP->stopRequested = FALSE;
+
+        TimerWheelCreate(timersP->now, &timersP->wheelP, errorP);
+
+        if (!*errorP) {
+            timersP->lockP = xmlrpc_lock_create();
+
+            if (timersP->lockP == NULL)
+                xmlrpc_asprintf(errorP, "Unable to create a lock for "
+                                "connection timers");
+            else {
+                const char * error;
+
+                ThreadCreate(&timersP->threadP, timersP,
+                             &tickThread, &tickThreadDone,
+                             FALSE, 16 * 1024, &error);
+
+                if (error) {
+                    xmlrpc_asprintf(errorP, "Unable to create a thread to "
+                                    "run connection timers.  %s", error);
+                    xmlrpc_strfree(error);
+                } else {
+                    ThreadRun(timersP->threadP);
+
+                    *timersPP = timersP;
+                    *errorP = NULL;
+                }
+                if (*errorP)
+                    timersP->lockP->destroy(timersP->lockP);
+            }
+            if (*errorP)
+                TimerWheelDestroy(timersP->wheelP);
+        }
+        if (*errorP)
+            free(timersP);
+    }
+}
+
+
+
+void
+ConnTimersDestroy(TConnTimers * const timersP) {
+/*----------------------------------------------------------------------------
+   No timer may be running.
+-----------------------------------------------------------------------------*/
+    timersP->lockP->acquire(timersP->lockP);
+    timersP->stopRequested = TRUE;
+    timersP->lockP->release(timersP->lockP);
+
+    ThreadWaitAndRelease(timersP->threadP);
+
+    timersP->lockP->destroy(timersP->lockP);
+
+    TimerWheelDestroy(timersP->wheelP);
+
+    free(timersP);
+}
+
+
+
+void
+ConnTimerInit(TConnTimer * const timerP,
+              TChannel *   const channelP) {
+
+    TimerInit(&timerP->timer);
+
+    timerP->channelP = channelP;
+    timerP->expired  = FALSE;
+}
+
+
+
+static TTimerFn expire;
+
+static void
+expire(TTimer * const timerP ATTR_UNUSED,
+       void *   const userHandle) {
+/*----------------------------------------------------------------------------
+   The timer function for a connection timer.
+
+   A thread waiting to read wakes up on a channel interrupt.  A thread
+   writing doesn't wait that way, so we stop the channel's I/O altogether.
+   Either way, the connection is finished.
+-----------------------------------------------------------------------------*/
+    TConnTimer * const connTimerP = userHandle;
+
+    connTimerP->expired = TRUE;
+
+    if (connTimerP->reason == CONNTIMER_WRITE)
+        ChannelAbort(connTimerP->channelP);
+    else
+        ChannelInterrupt(connTimerP->channelP);
+}
+
+
+
+void
+ConnTimerStart(TConnTimers *    const timersP,
+               TConnTimer *     const timerP,
+               TConnTimerReason const reason,
+               uint32_t         const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Start the connection's timer to expire in 'timeoutMs' milliseconds (or
+   a little later), because of 'reason'.  The timer isn't running.
+-----------------------------------------------------------------------------*/
+    timersP->lockP->acquire(timersP->lockP);
+
+    timerP->reason  = reason;
+    timerP->expired = FALSE;
+
+    TimerWheelStart(timersP->wheelP, &timerP->timer,
+                    timersP->now + (timeoutMs + TICK_MS - 1) / TICK_MS + 1,
+                    &expire, timerP);
+
+    timersP->lockP->release(timersP->lockP);
+}
+
+
+
+bool
+ConnTimerStop(TConnTimers * const timersP,
+              TConnTimer *  const timerP) {
+/*----------------------------------------------------------------------------
+   Stop the connection's timer.  Return true iff it had already expired.
+
+   Once we return, the timer's expiry can't do anything to the connection
+   any more, so Caller may destroy its channel.
+-----------------------------------------------------------------------------*/
+    bool expired;
+
+    timersP->lockP->acquire(timersP->lockP);
+
+    TimerWheelStop(timersP->wheelP, &timerP->timer);
+
+    expired = timerP->expired;
+
+    timersP->lockP->release(timersP->lockP);
+
+    return expired;
+}
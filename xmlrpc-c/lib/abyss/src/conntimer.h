@@ -0,0 +1,62 @@
+#ifndef CONNTIMER_H_INCLUDED
+#define CONNTIMER_H_INCLUDED
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/abyss.h"
+#include "timerwheel.h"
+
+/* Connection timers enforce a server's I/O timeouts for all its
+   connections from one place: a timer wheel that a thread of its own
+   advances.  When a connection's timer expires, we wake up the thread that
+   is waiting on the connection's channel (see ConnRead()).
+
+   This works only where connections are served by threads, not processes,
+   of the process that owns the timers.
+*/
+
+typedef enum {
+    CONNTIMER_READ,
+        /* Receiving a request: HTTP header or body */
+    CONNTIMER_IDLE,
+        /* Waiting for the next request on a persistent connection */
+    CONNTIMER_WRITE
+        /* Sending a response */
+} TConnTimerReason;
+
+#define CONNTIMER_REASON_CT 3
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A connection's timer.  Initialize with ConnTimerInit().
+-----------------------------------------------------------------------------*/
+    TTimer timer;
+    TChannel * channelP;
+    TConnTimerReason reason;
+    bool expired;
+} TConnTimer;
+
+typedef struct TConnTimers TConnTimers;
+
+void
+ConnTimersCreate(TConnTimers ** const timersPP,
+                 const char **  const errorP);
+
+void
+ConnTimersDestroy(TConnTimers * const timersP);
+
+void
+ConnTimerInit(TConnTimer * const timerP,
+              TChannel *   const channelP);
+
+void
+ConnTimerStart(TConnTimers *    const timersP,
+               TConnTimer *     const timerP,
+               TConnTimerReason const reason,
+               uint32_t         const timeoutMs);
+
+bool
+ConnTimerStop(TConnTimers * const timersP,
+              TConnTimer *  const timerP);
+
+#endif
@@ -148,6 +148,12 @@ ListRemove(TList * const sl) {
 bool
 ListAddFromString(TList *      const list,
                   const char * const stringArg) {
+/*----------------------------------------------------------------------------
+   Add to 'list' each of the comma-separated tokens in 'stringArg'.
+
+   We add malloc'ed copies of the tokens, so 'list' should be an auto-free
+   list (ListInitAutoFree()).
+-----------------------------------------------------------------------------*/
 
     bool retval;
     
@@ -183,11 +189,17 @@ ListAddFromString(TList *      const list,
                         *p = '\0';
                     
                     if (t[0] != '\0') {
+                        char * const token = strdup(t);
+
                         bool added;
-                        added = ListAdd(list, (void*)t);
+
+                        added = token && ListAdd(list, token);
                         
-                        if (!added)
+                        if (!added) {
+                            if (token)
+                                free(token);
                             error = TRUE;
+                        }
                     }
                 }
             }
@@ -404,12 +416,59 @@ void TableInit(TTable * const t)
 {
     t->item=NULL;
     t->size=t->maxsize=0;
+    t->poolP=NULL;
 }
 
+
+
+void
+TableInitPool(TTable * const t,
+              TPool *  const poolP) {
+/*----------------------------------------------------------------------------
+   Initialize a table whose storage all comes from pool 'poolP'.  Adding
+   to it does not call malloc() and TableFree() does not call free();
+   the memory goes away when the owner of the pool frees or resets it.
+-----------------------------------------------------------------------------*/
+    TableInit(t);
+
+    t->poolP = poolP;
+}
+
+
+
+static char *
+tableStrdup(TTable *     const t,
+            const char * const string) {
+
+    if (t->poolP)
+        return (char *)PoolStrdup(t->poolP, string);
+    else
+        return strdup(string);
+}
+
+
+
+static void
+tableStrfree(TTable * const t,
+             char *   const string) {
+
+    if (!t->poolP)
+        free(string);
+}
+
+
+
 void TableFree(TTable * const t)
 {
     uint16_t i;
 
+    if (t->poolP)
+    {
+        /* The pool owner reclaims the memory */
+        TableInitPool(t, t->poolP);
+        return;
+    }
+
     if (t->item)
     {
         if (t->size)
@@ -459,12 +518,12 @@ TableAddReplace(TTable *     const t,
 
     if (TableFindIndex(t,name,&i))
     {
-        free(t->item[i].value);
+        tableStrfree(t,t->item[i].value);
         if (value)
-            t->item[i].value=strdup(value);
+            t->item[i].value=tableStrdup(t,value);
         else
         {
-            free(t->item[i].name);
+            tableStrfree(t,t->item[i].name);
             if (--t->size>0)
                 t->item[i]=t->item[t->size];
         };
@@ -487,7 +546,14 @@ TableAdd(TTable *     const t,
         
         t->maxsize+=16;
 
-        newitem=(TTableItem *)realloc(t->item,(t->maxsize)*sizeof(TTableItem));
+        if (t->poolP) {
+            /* The old array stays in the pool until the pool is reset */
+            newitem=PoolAlloc(t->poolP,(t->maxsize)*sizeof(TTableItem));
+            if (newitem && t->size>0)
+                memcpy(newitem,t->item,t->size*sizeof(TTableItem));
+        } else
+            newitem=(TTableItem *)realloc(t->item,
+                                          (t->maxsize)*sizeof(TTableItem));
         if (newitem)
             t->item=newitem;
         else {
@@ -496,8 +562,8 @@ TableAdd(TTable *     const t,
         }
     }
 
-    t->item[t->size].name=strdup(name);
-    t->item[t->size].value=strdup(value);
+    t->item[t->size].name=tableStrdup(t,name);
+    t->item[t->size].value=tableStrdup(t,value);
     t->item[t->size].hash=Hash16(name);
 
     ++t->size;
@@ -528,7 +594,10 @@ PoolZoneAlloc(uint32_t const zonesize) {
 
     TPoolZone * poolZoneP;
     
-    MALLOCARRAY(poolZoneP, zonesize);
+    /* 'data' is the last member, so the zone's data area is whatever
+       follows the fixed part.
+    */
+    poolZoneP = malloc(sizeof(TPoolZone) + zonesize);
     if (poolZoneP) {
         poolZoneP->pos    = &poolZoneP->data[0];
         poolZoneP->maxpos = poolZoneP->pos + zonesize;
@@ -582,6 +651,12 @@ PoolAlloc(TPool *  const poolP,
 /*----------------------------------------------------------------------------
    Allocate a block of size 'size' from pool 'poolP'.
 -----------------------------------------------------------------------------*/
+    /* We keep every block aligned for any type, so the pool can hold
+       structures (e.g. a TTable's item array) as well as strings.
+    */
+    uint32_t const alignedSize =
+        (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
     void * retval;
 
     if (size == 0)
@@ -592,11 +667,11 @@ PoolAlloc(TPool *  const poolP,
             TPoolZone * const curPoolZoneP = poolP->currentzone;
 
 
-            if (curPoolZoneP->pos + size < curPoolZoneP->maxpos) {
+            if (curPoolZoneP->pos + alignedSize < curPoolZoneP->maxpos) {
                 retval = curPoolZoneP->pos;
-                curPoolZoneP->pos += size;
+                curPoolZoneP->pos += alignedSize;
             } else {
-                uint32_t const zonesize = MAX(size, poolP->zonesize);
+                uint32_t const zonesize = MAX(alignedSize, poolP->zonesize);
 
                 TPoolZone * const newPoolZoneP = PoolZoneAlloc(zonesize);
                 if (newPoolZoneP) {
@@ -605,7 +680,7 @@ PoolAlloc(TPool *  const poolP,
                     curPoolZoneP->next = newPoolZoneP;
                     poolP->currentzone = newPoolZoneP;
                     retval= newPoolZoneP->data;
-                    newPoolZoneP->pos = newPoolZoneP->data + size;
+                    newPoolZoneP->pos = newPoolZoneP->data + alignedSize;
                 } else
                     retval = NULL;
             }
@@ -661,6 +736,37 @@ PoolFree(TPool * const poolP) {
 
 
 
+void
+PoolReset(TPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Make all the memory of pool 'poolP' available for allocation again, as if
+   the pool were newly created.  Every block previously allocated from it
+   becomes invalid.
+
+   We keep the first zone, so a pool that is reset after each use (e.g. once
+   per HTTP request on a keepalive connection) normally does no malloc() or
+   free() at all after the first use.
+-----------------------------------------------------------------------------*/
+    TPoolZone * const firstZoneP = poolP->firstzone;
+
+    TPoolZone * poolZoneP;
+    TPoolZone * nextPoolZoneP;
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    for (poolZoneP = firstZoneP->next; poolZoneP; poolZoneP = nextPoolZoneP) {
+        nextPoolZoneP = poolZoneP->next;
+        PoolZoneFree(poolZoneP);
+    }
+    firstZoneP->next   = NULL;
+    firstZoneP->pos    = &firstZoneP->data[0];
+    poolP->currentzone = firstZoneP;
+
+    poolP->lockP->release(poolP->lockP);
+}
+
+
+
 const char *
 PoolStrdup(TPool *      const poolP,
            const char * const origString) {
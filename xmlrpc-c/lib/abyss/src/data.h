@@ -104,15 +104,25 @@ typedef struct
     uint16_t hash;
 } TTableItem;
 
+struct _TPool;
+
 typedef struct
 {
     TTableItem *item;
     uint16_t size,maxsize;
+    struct _TPool * poolP;
+        /* The pool from which the item array and the name and value
+           strings come.  NULL means they are individually malloc'ed.
+        */
 } TTable;
 
 void
 TableInit(TTable * const t);
 
+void
+TableInitPool(TTable *        const t,
+              struct _TPool * const poolP);
+
 void
 TableFree(TTable * const t);
 
@@ -149,7 +159,7 @@ typedef struct _TPoolZone {
     char data[1];
 } TPoolZone;
 
-typedef struct {
+typedef struct _TPool {
     TPoolZone * firstzone;
     TPoolZone * currentzone;
     uint32_t zonesize;
@@ -163,6 +173,9 @@ PoolCreate(TPool *  const poolP,
 void
 PoolFree(TPool * const poolP);
 
+void
+PoolReset(TPool * const poolP);
+
 void *
 PoolAlloc(TPool *  const poolP,
           uint32_t const size);
@@ -51,6 +51,7 @@
 
 #if MSVCRT
   #include <io.h>
+  #include <windows.h>
   typedef __int64 readwriterc_t;
 #else
   #include <unistd.h>
@@ -177,6 +178,39 @@ FileRead(const TFile * const fileP,
 
 
 
+int32_t
+FileReadAt(const TFile * const fileP,
+           void *        const buffer,
+           uint32_t      const len,
+           uint64_t      const pos) {
+/*----------------------------------------------------------------------------
+   Read from offset 'pos' of the file, without using or changing the file
+   offset.  So threads can read the same open file at once.
+-----------------------------------------------------------------------------*/
+#if MSVCRT
+    HANDLE const fileHandle = (HANDLE)_get_osfhandle(fileP->fd);
+
+    OVERLAPPED overlapped;
+    DWORD bytesRead;
+    int32_t retval;
+
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset     = (DWORD)pos;
+    overlapped.OffsetHigh = (DWORD)(pos >> 32);
+
+    if (ReadFile(fileHandle, buffer, len, &bytesRead, &overlapped))
+        retval = bytesRead;
+    else
+        retval = GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+
+    return retval;
+#else
+    return pread(fileP->fd, buffer, len, pos);
+#endif
+}
+
+
+
 bool
 FileSeek(const TFile * const fileP,
          uint64_t      const pos,
@@ -239,6 +273,22 @@ FileStat(const char * const filename,
 
 
 
+bool
+FileFstat(const TFile * const fileP,
+          TFileStat *   const filestat) {
+
+    int rc;
+
+#if MSVCRT
+    rc = _fstati64(fileP->fd, filestat);
+#else
+    rc = fstat(fileP->fd, filestat);
+#endif
+    return (rc >= 0);
+}
+
+
+
 static void
 fileFindFirstWin(TFileFind *  const filefindP ATTR_UNUSED,
                  const char * const path,
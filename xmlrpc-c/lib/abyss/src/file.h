@@ -101,6 +101,12 @@ FileRead(const TFile * const fileP,
          void *        const buffer,
          uint32_t      const len);
 
+int32_t
+FileReadAt(const TFile * const fileP,
+           void *        const buffer,
+           uint32_t      const len,
+           uint64_t      const pos);
+
 bool
 FileSeek(const TFile * const fileP,
          uint64_t      const pos,
@@ -113,6 +119,10 @@ bool
 FileStat(const char * const filename,
          TFileStat *  const filestat);
 
+bool
+FileFstat(const TFile * const fileP,
+          TFileStat *   const filestat);
+
 bool
 FileFindFirst(TFileFind ** const filefind,
               const char * const path,
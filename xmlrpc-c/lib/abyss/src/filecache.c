@@ -0,0 +1,493 @@
+/*=============================================================================
+                                 filecache.c
+===============================================================================
+  A cache of open files and what we know about them, for the built-in
+  request handler.  See filecache.h.
+=============================================================================*/
+
+#define _XOPEN_SOURCE 600  /* Make sure strdup() is in <string.h> */
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+#include "file.h"
+#include "date.h"
+
+#include "filecache.h"
+
+#define BUCKET_CT 64
+    /* Number of hash chains.  Must be a power of 2 */
+
+#define MAX_ENTRY_CT 64
+    /* The most files we keep open */
+
+#define VALID_SECONDS 1
+    /* How long we trust a cached file without checking that the file by
+       that name is still the same one.
+    */
+
+struct fileCacheEntry {
+    TCachedFile file;
+        /* What the user sees.  Must be first: we convert a pointer to it
+           to a pointer to the entry.
+        */
+    const char * fileName;
+    uint32_t hash;
+    TFileStat fileStat;
+        /* Status of the file when we opened it */
+    time_t validated;
+        /* When we last confirmed that 'fileName' names this file */
+    unsigned int refCt;
+        /* Number of users holding the entry */
+    bool inCache;
+        /* The entry is in the cache's hash table and LRU list.  When this
+           is false and 'refCt' is zero, nothing refers to the entry.
+        */
+    struct fileCacheEntry * nextP;
+        /* Next entry in the hash chain */
+    struct fileCacheEntry * newerP;
+    struct fileCacheEntry * olderP;
+        /* Neighbors in the least recently used list */
+};
+
+struct TFileCache {
+    lock * lockP;
+    unsigned int entryCt;
+    struct fileCacheEntry * newestP;
+    struct fileCacheEntry * oldestP;
+    struct fileCacheEntry * bucket[BUCKET_CT];
+};
+
+
+
+static uint32_t
+hashFileName(const char * const fileName) {
+
+    /* This is the Bernstein hash, as in xmlrpc_struct.c */
+
+    uint32_t hash;
+    const char * p;
+
+    for (hash = 0, p = &fileName[0]; *p; ++p)
+        hash = hash + *p + (hash << 5);
+
+    return hash;
+}
+
+
+
+void
+FileCacheCreate(TFileCache ** const cachePP,
+                const char ** const errorP) {
+
+    TFileCache * cacheP;
+
+    MALLOCVAR(cacheP);
+
+    if (cacheP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate a file cache");
+    else {
+        cacheP->lockP = xmlrpc_lock_create();
+
+        if (cacheP->lockP == NULL)
+            xmlrpc_asprintf(errorP, "Unable to create lock for file cache");
+        else {
+            unsigned int i;
+
+            cacheP->entryCt = 0;
+            cacheP->newestP = NULL;
+            cacheP->oldestP = NULL;
+
+            for (i = 0; i < BUCKET_CT; ++i)
+                cacheP->bucket[i] = NULL;
+
+            *errorP = NULL;
+            *cachePP = cacheP;
+        }
+        if (*errorP)
+            free(cacheP);
+    }
+}
+
+
+
+static void
+destroyEntry(struct fileCacheEntry * const entryP) {
+
+    FileClose(entryP->file.fileP);
+    xmlrpc_strfree(entryP->file.mediatype);
+    if (entryP->file.lastModified)
+        xmlrpc_strfree(entryP->file.lastModified);
+    xmlrpc_strfree(entryP->fileName);
+    free(entryP);
+}
+
+
+
+void
+FileCacheDestroy(TFileCache * const cacheP) {
+/*----------------------------------------------------------------------------
+   Nobody may be holding a file from the cache.
+-----------------------------------------------------------------------------*/
+    struct fileCacheEntry * entryP;
+    struct fileCacheEntry * olderP;
+
+    for (entryP = cacheP->newestP; entryP; entryP = olderP) {
+        olderP = entryP->olderP;
+        destroyEntry(entryP);
+    }
+    cacheP->lockP->destroy(cacheP->lockP);
+
+    free(cacheP);
+}
+
+
+
+static struct fileCacheEntry *
+findEntry(const TFileCache * const cacheP,
+          const char *       const fileName,
+          uint32_t           const hash) {
+/*----------------------------------------------------------------------------
+   Caller must hold the cache lock.
+-----------------------------------------------------------------------------*/
+    struct fileCacheEntry * entryP;
+
+    for (entryP = cacheP->bucket[hash & (BUCKET_CT-1)];
+         entryP && !(entryP->hash == hash && xmlrpc_streq(entryP->fileName,
+                                                          fileName));
+         entryP = entryP->nextP);
+
+    return entryP;
+}
+
+
+
+static void
+linkNewest(TFileCache *            const cacheP,
+           struct fileCacheEntry * const entryP) {
+
+    entryP->newerP = NULL;
+    entryP->olderP = cacheP->newestP;
+
+    if (cacheP->newestP)
+        cacheP->newestP->newerP = entryP;
+    else
+        cacheP->oldestP = entryP;
+
+    cacheP->newestP = entryP;
+}
+
+
+
+static void
+unlinkLru(TFileCache *            const cacheP,
+          struct fileCacheEntry * const entryP) {
+
+    if (entryP->newerP)
+        entryP->newerP->olderP = entryP->olderP;
+    else
+        cacheP->newestP = entryP->olderP;
+
+    if (entryP->olderP)
+        entryP->olderP->newerP = entryP->newerP;
+    else
+        cacheP->oldestP = entryP->newerP;
+}
+
+
+
+static void
+removeEntry(TFileCache *            const cacheP,
+            struct fileCacheEntry * const entryP,
+            bool *                  const unusedP) {
+/*----------------------------------------------------------------------------
+   Take *entryP out of the cache.  Return as *unusedP whether nobody holds
+   it any more, in which case Caller must destroy it.
+
+   Caller must hold the cache lock.
+-----------------------------------------------------------------------------*/
+    struct fileCacheEntry ** pP;
+
+    for (pP = &cacheP->bucket[entryP->hash & (BUCKET_CT-1)];
+         *pP != entryP;
+         pP = &(*pP)->nextP);
+
+    *pP = entryP->nextP;
+
+    unlinkLru(cacheP, entryP);
+
+    --cacheP->entryCt;
+
+    entryP->inCache = FALSE;
+
+    *unusedP = (entryP->refCt == 0);
+}
+
+
+
+static bool
+isSameFile(const TFileStat * const oldP,
+           const TFileStat * const newP) {
+
+    return
+        newP->st_dev   == oldP->st_dev   &&
+        newP->st_ino   == oldP->st_ino   &&
+        newP->st_size  == oldP->st_size  &&
+        newP->st_mtime == oldP->st_mtime;
+}
+
+
+
+static void
+revalidate(TFileCache *            const cacheP,
+           struct fileCacheEntry * const entryP,
+           time_t                  const now,
+           bool *                  const validP) {
+/*----------------------------------------------------------------------------
+   Check that the file named entryP->fileName is still the one we have open,
+   and if it isn't, take it out of the cache.
+
+   Caller holds *entryP, but not the cache lock.
+-----------------------------------------------------------------------------*/
+    TFileStat fileStat;
+
+    *validP =
+        FileStat(entryP->fileName, &fileStat) &&
+        isSameFile(&entryP->fileStat, &fileStat);
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    if (*validP)
+        entryP->validated = now;
+    else if (entryP->inCache) {
+        bool unused;
+
+        removeEntry(cacheP, entryP, &unused);
+
+        /* Caller still holds the entry, so it isn't unused */
+    }
+    cacheP->lockP->release(cacheP->lockP);
+}
+
+
+
+const TCachedFile *
+FileCacheLookup(TFileCache * const cacheP,
+                const char * const fileName) {
+/*----------------------------------------------------------------------------
+   The cached file named 'fileName', if we have it and it is still the file
+   by that name; NULL otherwise.
+
+   Caller must release the file with FileCacheRelease().
+-----------------------------------------------------------------------------*/
+    uint32_t const hash = hashFileName(fileName);
+    time_t   const now  = time(NULL);
+
+    struct fileCacheEntry * entryP;
+    bool mustRevalidate;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    entryP = findEntry(cacheP, fileName, hash);
+
+    if (entryP) {
+        ++entryP->refCt;
+
+        unlinkLru(cacheP, entryP);
+        linkNewest(cacheP, entryP);
+
+        mustRevalidate =
+            now < entryP->validated ||
+            now - entryP->validated >= VALID_SECONDS;
+    } else
+        mustRevalidate = FALSE;
+
+    cacheP->lockP->release(cacheP->lockP);
+
+    if (mustRevalidate) {
+        bool valid;
+
+        revalidate(cacheP, entryP, now, &valid);
+
+        if (!valid) {
+            FileCacheRelease(cacheP, &entryP->file);
+            entryP = NULL;
+        }
+    }
+    return entryP ? &entryP->file : NULL;
+}
+
+
+
+static void
+createEntry(const char *             const fileName,
+            MIMEType *               const mimeTypeP,
+            struct fileCacheEntry ** const entryPP) {
+/*----------------------------------------------------------------------------
+   Open the file named 'fileName' and make a cache entry for it, held by
+   the caller.
+
+   If we fail, return NULL with 'errno' telling why, as far as we know.
+-----------------------------------------------------------------------------*/
+    struct fileCacheEntry * entryP;
+
+    MALLOCVAR(entryP);
+
+    if (entryP == NULL)
+        errno = ENOMEM;
+    else {
+        bool success;
+
+        success = FileOpen(&entryP->file.fileP, fileName,
+                           O_BINARY | O_RDONLY);
+        if (success) {
+            success = FileFstat(entryP->file.fileP, &entryP->fileStat);
+
+            if (success) {
+                entryP->fileName = strdup(fileName);
+                entryP->file.mediatype =
+                    strdup(MIMETypeGuessFromFile2(mimeTypeP, fileName));
+
+                if (entryP->fileName && entryP->file.mediatype) {
+                    entryP->file.size    = entryP->fileStat.st_size;
+                    entryP->file.modTime = entryP->fileStat.st_mtime;
+                    DateToString(entryP->file.modTime,
+                                 &entryP->file.lastModified);
+                    entryP->hash      = hashFileName(fileName);
+                    entryP->validated = time(NULL);
+                    entryP->refCt     = 1;
+                    entryP->inCache   = FALSE;
+                } else {
+                    if (entryP->fileName)
+                        xmlrpc_strfree(entryP->fileName);
+                    if (entryP->file.mediatype)
+                        xmlrpc_strfree(entryP->file.mediatype);
+                    errno = ENOMEM;
+                    success = FALSE;
+                }
+            }
+            if (!success) {
+                int const savedErrno = errno;
+                FileClose(entryP->file.fileP);
+                errno = savedErrno;
+            }
+        }
+        if (!success) {
+            free(entryP);
+            entryP = NULL;
+        }
+    }
+    *entryPP = entryP;
+}
+
+
+
+static void
+addEntry(TFileCache *             const cacheP,
+         struct fileCacheEntry *  const entryP,
+         struct fileCacheEntry ** const evictedPP) {
+/*----------------------------------------------------------------------------
+   Put *entryP in the cache, unless another thread beat us to it.
+
+   If that pushes out an entry nobody holds, return it as *evictedPP for
+   Caller to destroy; otherwise return NULL.
+
+   Caller must hold the cache lock.
+-----------------------------------------------------------------------------*/
+    *evictedPP = NULL;
+
+    if (!findEntry(cacheP, entryP->fileName, entryP->hash)) {
+        struct fileCacheEntry ** const bucketP =
+            &cacheP->bucket[entryP->hash & (BUCKET_CT-1)];
+
+        if (cacheP->entryCt >= MAX_ENTRY_CT) {
+            struct fileCacheEntry * const oldestP = cacheP->oldestP;
+
+            bool unused;
+
+            removeEntry(cacheP, oldestP, &unused);
+
+            if (unused)
+                *evictedPP = oldestP;
+        }
+        entryP->nextP = *bucketP;
+        *bucketP = entryP;
+        linkNewest(cacheP, entryP);
+        entryP->inCache = TRUE;
+        ++cacheP->entryCt;
+    }
+}
+
+
+
+const TCachedFile *
+FileCacheOpen(TFileCache * const cacheP,
+              const char * const fileName,
+              MIMEType *   const mimeTypeP) {
+/*----------------------------------------------------------------------------
+   Open the file named 'fileName' and add it to the cache.  Use MIME type
+   object *mimeTypeP to determine its media type.
+
+   This is for a file FileCacheLookup() doesn't find.  We cache only regular
+   files, so if the file is something else, we give it to Caller just the
+   same, but it won't be in the cache.
+
+   Caller must release the file with FileCacheRelease().
+
+   If we can't open the file, return NULL, with 'errno' telling why.
+-----------------------------------------------------------------------------*/
+    struct fileCacheEntry * entryP;
+
+    createEntry(fileName, mimeTypeP, &entryP);
+
+    if (entryP &&
+        (entryP->fileStat.st_mode & S_IFMT) == S_IFREG) {
+        struct fileCacheEntry * evictedP;
+
+        cacheP->lockP->acquire(cacheP->lockP);
+
+        addEntry(cacheP, entryP, &evictedP);
+
+        cacheP->lockP->release(cacheP->lockP);
+
+        if (evictedP)
+            destroyEntry(evictedP);
+    }
+    return entryP ? &entryP->file : NULL;
+}
+
+
+
+void
+FileCacheRelease(TFileCache *        const cacheP,
+                 const TCachedFile * const cachedFileP) {
+/*----------------------------------------------------------------------------
+   Stop holding a file we got from FileCacheLookup() or FileCacheOpen().
+-----------------------------------------------------------------------------*/
+    struct fileCacheEntry * const entryP =
+        (struct fileCacheEntry *)cachedFileP;
+
+    bool unused;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    --entryP->refCt;
+
+    unused = (entryP->refCt == 0 && !entryP->inCache);
+
+    cacheP->lockP->release(cacheP->lockP);
+
+    if (unused)
+        destroyEntry(entryP);
+}
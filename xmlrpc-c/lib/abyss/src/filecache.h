@@ -0,0 +1,58 @@
+#ifndef FILECACHE_H_INCLUDED
+#define FILECACHE_H_INCLUDED
+
+#include <time.h>
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/abyss.h"
+#include "file.h"
+
+/* A file cache holds open files the built-in request handler has served
+   recently, along with what it learned about them: size, modification
+   time, media type, and the modification time formatted for an HTTP
+   Last-Modified header.  That lets the handler serve a popular file without
+   opening it, stat'ing it, or guessing its media type every time.
+
+   A cached file stays valid for as long as stat() of its name says it is
+   the same file (device, inode, size, and modification time) it was when
+   we opened it.  We check that at most once a second per file, so a file
+   that gets replaced may get served in its old form for up to a second.
+
+   The cache has a fixed capacity; when it is full, we close the least
+   recently used file.  Cached files are shared among threads, so a user
+   must read them only by offset (FileReadAt(), ChannelSendFile()).
+*/
+
+typedef struct {
+    TFile *      fileP;
+    uint64_t     size;
+    time_t       modTime;
+    const char * mediatype;
+    const char * lastModified;
+        /* 'modTime' as an HTTP date.  NULL if we couldn't format it */
+} TCachedFile;
+
+typedef struct TFileCache TFileCache;
+
+void
+FileCacheCreate(TFileCache ** const cachePP,
+                const char ** const errorP);
+
+void
+FileCacheDestroy(TFileCache * const cacheP);
+
+const TCachedFile *
+FileCacheLookup(TFileCache * const cacheP,
+                const char * const fileName);
+
+const TCachedFile *
+FileCacheOpen(TFileCache * const cacheP,
+              const char * const fileName,
+              MIMEType *   const mimeTypeP);
+
+void
+FileCacheRelease(TFileCache *        const cacheP,
+                 const TCachedFile * const cachedFileP);
+
+#endif
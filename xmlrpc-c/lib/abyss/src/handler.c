@@ -33,6 +33,7 @@
 #include "trace.h"
 #include "session.h"
 #include "file.h"
+#include "filecache.h"
 #include "conn.h"
 #include "http.h"
 #include "date.h"
@@ -47,6 +48,8 @@ struct BIHandler {
     TList defaultFileNames;
     MIMEType * mimeTypeP;
         /* NULL means to use the global MIMEType object */
+    TFileCache * fileCacheP;
+        /* Files we have served recently */
 };
 
 
@@ -59,9 +62,19 @@ HandlerCreate(void) {
     MALLOCVAR(handlerP);
 
     if (handlerP) {
-        handlerP->filesPath = strdup(DEFAULT_DOCS);
-        ListInitAutoFree(&handlerP->defaultFileNames);
-        handlerP->mimeTypeP = NULL;
+        const char * error;
+
+        FileCacheCreate(&handlerP->fileCacheP, &error);
+
+        if (error) {
+            xmlrpc_strfree(error);
+            free(handlerP);
+            handlerP = NULL;
+        } else {
+            handlerP->filesPath = strdup(DEFAULT_DOCS);
+            ListInitAutoFree(&handlerP->defaultFileNames);
+            handlerP->mimeTypeP = NULL;
+        }
     }
     return handlerP;
 }
@@ -75,6 +88,8 @@ HandlerDestroy(BIHandler * const handlerP) {
 
     xmlrpc_strfree(handlerP->filesPath);
 
+    FileCacheDestroy(handlerP->fileCacheP);
+
     free(handlerP);
 }
 
@@ -418,6 +433,21 @@ addLastModifiedHeader(TSession * const sessionP,
     
 
 
+static void
+addCachedLastModifiedHeader(TSession *          const sessionP,
+                            const TCachedFile * const cachedFileP) {
+/*----------------------------------------------------------------------------
+   Same as addLastModifiedHeader(), but use the formatted modification time
+   from the file cache when we can.
+-----------------------------------------------------------------------------*/
+    if (cachedFileP->lastModified && cachedFileP->modTime <= sessionP->date)
+        ResponseAddField(sessionP, "Last-Modified", cachedFileP->lastModified);
+    else
+        addLastModifiedHeader(sessionP, cachedFileP->modTime);
+}
+
+
+
 static void
 handleDirectory(TSession *   const sessionP,
                 const char * const dirName,
@@ -553,14 +583,11 @@ sendBody(TSession *      const sessionP,
 
 
 static void
-sendFileAsResponse(TSession *   const sessionP,
-                   TFile *      const fileP,
-                   const char * const fileName,
-                   time_t       const fileModTime,
-                   MIMEType *   const mimeTypeP) {
+sendFileAsResponse(TSession *          const sessionP,
+                   const TCachedFile * const cachedFileP) {
 
-    uint64_t const filesize = FileSize(fileP);
-    const char * const mediatype = MIMETypeGuessFromFile2(mimeTypeP, fileName);
+    uint64_t     const filesize  = cachedFileP->size;
+    const char * const mediatype = cachedFileP->mediatype;
 
     uint64_t start;  /* Defined only if session has one range */
     uint64_t end;    /* Defined only if session has one range */
@@ -602,40 +629,48 @@ sendFileAsResponse(TSession *   const sessionP,
         ResponseContentType(sessionP, mediatype);
     }
     
-    addLastModifiedHeader(sessionP, fileModTime);
+    addCachedLastModifiedHeader(sessionP, cachedFileP);
 
     ResponseWriteStart(sessionP);
 
     if (sessionP->requestInfo.method != m_head)
-        sendBody(sessionP, fileP, filesize, mediatype, start, end);
+        sendBody(sessionP, cachedFileP->fileP, filesize, mediatype,
+                 start, end);
 }        
 
 
 
+static void
+handleCachedFile(TSession *          const sessionP,
+                 const TCachedFile * const cachedFileP) {
+
+    if (notRecentlyModified(sessionP, cachedFileP->modTime)) {
+        ResponseStatus(sessionP, 304);
+        ResponseWriteStart(sessionP);
+    } else
+        sendFileAsResponse(sessionP, cachedFileP);
+}
+
+
+
 static void
 handleFile(TSession *   const sessionP,
+           TFileCache * const fileCacheP,
            const char * const fileName,
-           time_t       const fileModTime,
            MIMEType *   const mimeTypeP) {
 /*----------------------------------------------------------------------------
    This is an HTTP request handler for a GET.  It does the classic
    web server thing: send the file named in the URL to the client.
 -----------------------------------------------------------------------------*/
-    TFile * fileP;
-    bool success;
+    const TCachedFile * cachedFileP;
     
-    success = FileOpen(&fileP, fileName, O_BINARY | O_RDONLY);
-    if (!success)
+    cachedFileP = FileCacheOpen(fileCacheP, fileName, mimeTypeP);
+    if (!cachedFileP)
         ResponseStatusErrno(sessionP);
     else {
-        if (notRecentlyModified(sessionP, fileModTime)) {
-            ResponseStatus(sessionP, 304);
-            ResponseWriteStart(sessionP);
-        } else
-            sendFileAsResponse(sessionP, fileP,
-                               fileName, fileModTime, mimeTypeP);
+        handleCachedFile(sessionP, cachedFileP);
 
-        FileClose(fileP);
+        FileCacheRelease(fileCacheP, cachedFileP);
     }
 }
 
@@ -701,6 +736,18 @@ HandlerDefaultBuiltin(TSession * const sessionP) {
 
     convertToNativeFileName(z);
 
+    {
+        const TCachedFile * const cachedFileP =
+            FileCacheLookup(handlerP->fileCacheP, z);
+
+        if (cachedFileP) {
+            /* We served this file recently and it hasn't changed since */
+            handleCachedFile(sessionP, cachedFileP);
+            FileCacheRelease(handlerP->fileCacheP, cachedFileP);
+            return TRUE;
+        }
+    }
+
     if (!FileStat(z, &fs)) {
         ResponseStatusErrno(sessionP);
         return TRUE;
@@ -731,7 +778,7 @@ HandlerDefaultBuiltin(TSession * const sessionP) {
                 strcat(z, (handlerP->defaultFileNames.item[i]));
                 if (FileStat(z, &fs)) {
                     if (!(fs.st_mode & S_IFDIR))
-                        handleFile(sessionP, z, fs.st_mtime,
+                        handleFile(sessionP, handlerP->fileCacheP, z,
                                    handlerP->mimeTypeP);
                 }
             }
@@ -745,7 +792,7 @@ HandlerDefaultBuiltin(TSession * const sessionP) {
         }
         handleDirectory(sessionP, z, fs.st_mtime, handlerP->mimeTypeP);
     } else
-        handleFile(sessionP, z, fs.st_mtime, handlerP->mimeTypeP);
+        handleFile(sessionP, handlerP->fileCacheP, z, handlerP->mimeTypeP);
 
     return TRUE;
 }
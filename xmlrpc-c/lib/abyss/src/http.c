@@ -38,6 +38,7 @@
 
 static void
 initRequestInfo(TRequestInfo * const requestInfoP,
+                TPool *        const poolP,
                 httpVersion    const httpVersion,
                 const char *   const requestLine,
                 TMethod        const httpMethod,
@@ -49,16 +50,18 @@ initRequestInfo(TRequestInfo * const requestInfoP,
   Set up the request info structure.  For information that is
   controlled by the header, use the defaults -- I.e. the value that
   applies if the request contains no applicable header field.
+
+  The strings we put in the structure are in pool 'poolP'.
 -----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_PTR_OK(requestLine);
     XMLRPC_ASSERT_PTR_OK(path);
 
-    requestInfoP->requestline = xmlrpc_strdupsol(requestLine);
+    requestInfoP->requestline = PoolStrdup(poolP, requestLine);
     requestInfoP->method      = httpMethod;
-    requestInfoP->host        = xmlrpc_strdupnull(host);
+    requestInfoP->host        = host;
     requestInfoP->port        = port;
-    requestInfoP->uri         = strdup(path);
-    requestInfoP->query       = xmlrpc_strdupnull(query);
+    requestInfoP->uri         = path;
+    requestInfoP->query       = query;
     requestInfoP->from        = NULL;
     requestInfoP->useragent   = NULL;
     requestInfoP->referer     = NULL;
@@ -73,30 +76,27 @@ initRequestInfo(TRequestInfo * const requestInfoP,
 
 
 
-static void
-freeRequestInfo(TRequestInfo * const requestInfoP) {
-
-    xmlrpc_strfreenull(requestInfoP->host);
-
-    xmlrpc_strfreenull(requestInfoP->user);
-
-    xmlrpc_strfree(requestInfoP->uri);
-
-    xmlrpc_strfree(requestInfoP->requestline);
-}
-
-
-
 void
 RequestInit(TSession * const sessionP,
-            TConn *    const connectionP) {
+            TConn *    const connectionP,
+            TPool *    const poolP) {
+/*----------------------------------------------------------------------------
+   Initialize the session *sessionP for a new request on connection
+   *connectionP.
 
+   The request info strings and the request and response header tables of
+   the session live in pool 'poolP', which the caller provides.  The caller
+   must keep the pool until after RequestFree() and may then reset it for
+   the next request.
+-----------------------------------------------------------------------------*/
     sessionP->validRequest = false;  /* Don't have valid request yet */
 
     time(&sessionP->date);
 
     sessionP->connP = connectionP;
 
+    sessionP->poolP = poolP;
+
     sessionP->responseStarted = FALSE;
 
     sessionP->chunkedwrite = FALSE;
@@ -104,10 +104,17 @@ RequestInit(TSession * const sessionP,
 
     sessionP->continueRequired = FALSE;
 
-    ListInit(&sessionP->cookies);
-    ListInit(&sessionP->ranges);
-    TableInit(&sessionP->requestHeaderFields);
-    TableInit(&sessionP->responseHeaderFields);
+    sessionP->handlerData = NULL;
+
+    ListInitAutoFree(&sessionP->cookies);
+    ListInitAutoFree(&sessionP->ranges);
+    TableInitPool(&sessionP->requestHeaderFields,  poolP);
+    TableInitPool(&sessionP->responseHeaderFields, poolP);
+    {
+        unsigned int i;
+        for (i = 0; i < KNOWN_HDR_CT; ++i)
+            sessionP->knownHeaderValue[i] = NULL;
+    }
 
     sessionP->status = 0;  /* No status from handler yet */
 
@@ -119,9 +126,9 @@ RequestInit(TSession * const sessionP,
 void
 RequestFree(TSession * const sessionP) {
 
-    if (sessionP->validRequest)
-        freeRequestInfo(&sessionP->requestInfo);
-
+    /* The request info strings and the header tables are in the session's
+       pool, which belongs to our caller.
+    */
     ListFree(&sessionP->cookies);
     ListFree(&sessionP->ranges);
     TableFree(&sessionP->requestHeaderFields);
@@ -139,16 +146,16 @@ firstLfPos(TConn * const connectionP,
    LF (linefeed aka newline) character in the buffer at or after 'lineStart'.
 
    If there is no LF in the buffer at or after 'lineStart', return NULL.
+
+   We use memchr() because the C library's version compares a machine word
+   or vector register at a time, which is much faster than our own loop
+   over a large header.
 -----------------------------------------------------------------------------*/
     const char * const bufferEnd =
         connectionP->buffer.t + connectionP->buffersize;
 
-    char * p;
-
-    for (p = lineStart; p < bufferEnd && *p != LF; ++p);
-
-    if (p < bufferEnd)
-        return p;
+    if (lineStart < bufferEnd)
+        return memchr(lineStart, LF, bufferEnd - lineStart);
     else
         return NULL;
 }
@@ -168,24 +175,39 @@ getLineInBuffer(TConn * const connectionP,
 
    Read the channel until we get a full line, except fail if we don't get
    one by 'deadline'.
+
+   When we have to read more, we search only the newly read data for the
+   end of the line; the part of the line already in the buffer has no LF.
 -----------------------------------------------------------------------------*/
     bool error;
     char * lfPos;
+    char * scanStart;
+        /* Where in the buffer the line end may be; everything from
+           'lineStart' up to here is known to have no LF.
+        */
 
     assert(lineStart <= connectionP->buffer.t + connectionP->buffersize);
 
     error = FALSE;  /* initial value */
     lfPos = NULL;  /* initial value */
+    scanStart = lineStart;  /* initial value */
 
     while (!error && !lfPos) {
         int const timeLeft = (int)(deadline - time(NULL));
         if (timeLeft <= 0)
             error = TRUE;
         else {
-            lfPos = firstLfPos(connectionP, lineStart);
+            lfPos = firstLfPos(connectionP, scanStart);
             if (!lfPos) {
                 const char * readError;
-                ConnRead(connectionP, timeLeft, NULL, NULL, &readError);
+
+                /* ConnRead() adds to the end of the buffer; it doesn't move
+                   what's already there.
+                */
+                scanStart = connectionP->buffer.t + connectionP->buffersize;
+
+                ConnRead(connectionP, timeLeft, CONNTIMER_READ, NULL, NULL,
+                         &readError);
                 if (readError) {
                     error = TRUE;
                     xmlrpc_strfree(readError);
@@ -485,7 +507,8 @@ hexDigitValue(char           const digit,
 
 
 static void
-unescapeUri(const char *  const uriComponent,
+unescapeUri(TPool *       const poolP,
+            const char *  const uriComponent,
             const char ** const unescapedP,
             const char ** const errorP) {
 /*----------------------------------------------------------------------------
@@ -493,11 +516,11 @@ unescapeUri(const char *  const uriComponent,
    have %HH encoding, especially of characters that are delimiters within
    a URI like slash and colon.
 
-   Return the unescaped version as *unescapedP in newly malloced storage.
+   Return the unescaped version as *unescapedP in pool 'poolP'.
 -----------------------------------------------------------------------------*/
     char * buffer;
 
-    buffer = strdup(uriComponent);
+    buffer = (char *)PoolStrdup(poolP, uriComponent);
 
     if (!buffer)
         xmlrpc_asprintf(errorP, "Couldn't get memory for URI unescape buffer");
@@ -531,9 +554,7 @@ unescapeUri(const char *  const uriComponent,
         }
         *dst = '\0';
 
-        if (*errorP)
-            xmlrpc_strfree(buffer);
-        else
+        if (!*errorP)
             *unescapedP = buffer;
     }
 }
@@ -541,21 +562,22 @@ unescapeUri(const char *  const uriComponent,
 
 
 static void
-parseHostPort(const char *     const hostport,
+parseHostPort(TPool *          const poolP,
+              const char *     const hostport,
               const char **    const hostP,
               unsigned short * const portP,
               const char **    const errorP) {
 /*----------------------------------------------------------------------------
    Parse a 'hostport', a string in the form www.acme.com:8080 .
 
-   Return the host name part (www.acme.com) as *hostP (in newly
-   malloced storage), and the port part (8080) as *portP.
+   Return the host name part (www.acme.com) as *hostP (in pool 'poolP'),
+   and the port part (8080) as *portP.
 
    Default the port to 80 if 'hostport' doesn't have the port part.
 -----------------------------------------------------------------------------*/
     char * buffer;
 
-    buffer = strdup(hostport);
+    buffer = (char *)PoolStrdup(poolP, hostport);
 
     if (!buffer)
         xmlrpc_asprintf(errorP, "Couldn't get memory for host/port buffer");
@@ -582,33 +604,33 @@ parseHostPort(const char *     const hostport,
                                 "non-numeric for the port number after the "
                                 "colon in '%s'", hostport);
             } else {
-                *hostP = xmlrpc_strdupsol(buffer);
+                *hostP = buffer;
                 *portP = port;
                 *errorP = NULL;
             }
         } else {
-            *hostP  = xmlrpc_strdupsol(buffer);
+            *hostP  = buffer;
             *portP  = 80;
             *errorP = NULL;
         }
-        free(buffer);
     }
 }
 
 
 
 static void
-splitUriQuery(const char *  const requestUri,
+splitUriQuery(TPool *       const poolP,
+              const char *  const requestUri,
               const char ** const queryP,
               const char ** const noQueryP,
               const char ** const errorP) {
 /*----------------------------------------------------------------------------
    Split 'requestUri' at the question mark, returning the stuff after
-   as *queryP and the stuff before as *noQueryP.
+   as *queryP and the stuff before as *noQueryP, both in pool 'poolP'.
 -----------------------------------------------------------------------------*/
     char * buffer;
 
-    buffer = strdup(requestUri);
+    buffer = (char *)PoolStrdup(poolP, requestUri);
 
     if (!buffer)
         xmlrpc_asprintf(errorP, "Couldn't get memory for URI buffer");
@@ -617,7 +639,7 @@ splitUriQuery(const char *  const requestUri,
             
         if (qmark) {
             *qmark = '\0';
-            *queryP = xmlrpc_strdupsol(qmark + 1);
+            *queryP = qmark + 1;
         } else
             *queryP = NULL;
 
@@ -629,7 +651,8 @@ splitUriQuery(const char *  const requestUri,
 
 
 static void
-parseHttpHostPortPath(const char *    const hostportpath,
+parseHttpHostPortPath(TPool *         const poolP,
+                      const char *    const hostportpath,
                       const char **   const hostP,
                       unsigned short* const portP,
                       const char **   const pathP,
@@ -639,7 +662,7 @@ parseHttpHostPortPath(const char *    const hostportpath,
 
     char * buffer;
 
-    buffer = strdup(hostportpath);
+    buffer = (char *)PoolStrdup(poolP, hostportpath);
 
     if (!buffer)
         xmlrpc_asprintf(errorP,
@@ -650,11 +673,12 @@ parseHttpHostPortPath(const char *    const hostportpath,
         char * hostport;
                 
         if (slashPos) {
-            path = xmlrpc_strdupsol(slashPos); /* Includes the initial slash */
+            /* Includes the initial slash */
+            path = PoolStrdup(poolP, slashPos);
 
             *slashPos = '\0';  /* NUL termination for hostport */
         } else
-            path = strdup("*");
+            path = "*";
 
         hostport = buffer;
 
@@ -662,21 +686,18 @@ parseHttpHostPortPath(const char *    const hostportpath,
            any %HH encoding, as the RFC says may be there.  We ignore that
            remote possibility out of laziness.
         */
-        parseHostPort(hostport, hostP, portP, errorP);
+        parseHostPort(poolP, hostport, hostP, portP, errorP);
 
-        if (*errorP)
-            xmlrpc_strfree(path);
-        else
+        if (!*errorP)
             *pathP = path;
-
-        free(buffer);
     }
 }
 
 
 
 static void
-unescapeHostPathQuery(const char *  const host,
+unescapeHostPathQuery(TPool *       const poolP,
+                      const char *  const host,
                       const char *  const path,
                       const char *  const query,
                       const char ** const hostP,
@@ -687,26 +708,25 @@ unescapeHostPathQuery(const char *  const host,
    Unescape each of the four components of a URI.
 
    Each may be NULL, in which case we return NULL.
+
+   We return the unescaped components in pool 'poolP'.
 -----------------------------------------------------------------------------*/
     if (host)
-        unescapeUri(host, hostP, errorP);
-    else
+        unescapeUri(poolP, host, hostP, errorP);
+    else {
         *hostP = NULL;
+        *errorP = NULL;
+    }
     if (!*errorP) {
         if (path)
-            unescapeUri(path, pathP, errorP);
+            unescapeUri(poolP, path, pathP, errorP);
         else
             *pathP = NULL;
         if (!*errorP) {
             if (query)
-                unescapeUri(query, queryP, errorP);
+                unescapeUri(poolP, query, queryP, errorP);
             else
                 *queryP = NULL;
-            if (*errorP)
-                xmlrpc_strfree(*pathP);
-        } else {
-            if (*hostP)
-                xmlrpc_strfree(*hostP);
         }
     }
 }
@@ -714,7 +734,8 @@ unescapeHostPathQuery(const char *  const host,
 
 
 static void
-parseRequestUri(char *           const requestUri,
+parseRequestUri(TPool *          const poolP,
+                char *           const requestUri,
                 const char **    const hostP,
                 unsigned short * const portP,
                 const char **    const pathP,
@@ -737,7 +758,7 @@ parseRequestUri(char *           const requestUri,
   Return as *queryP the "parm" in the above example.  If it doesn't
   exist, return *queryP == NULL.
 
-  Return strings in newly malloc'ed storage.
+  Return strings in pool 'poolP'.
 
   We can return syntactically invalid entities, e.g. a host name that
   contains "<", if 'requestUri' is similarly invalid.  We should fix that
@@ -753,42 +774,34 @@ parseRequestUri(char *           const requestUri,
     const char * host;
     unsigned short port;
 
-    splitUriQuery(requestUri, &query, &requestUriNoQuery, errorP);
+    splitUriQuery(poolP, requestUri, &query, &requestUriNoQuery, errorP);
     if (!*errorP) {
         if (requestUriNoQuery[0] == '/') {
             host = NULL;
-            path = xmlrpc_strdupsol(requestUriNoQuery);
+            path = requestUriNoQuery;
             port = 80;
             *errorP = NULL;
         } else {
             if (!xmlrpc_strneq(requestUriNoQuery, "http://", 7))
                 xmlrpc_asprintf(errorP, "Scheme is not http://");
             else
-                parseHttpHostPortPath(&requestUriNoQuery[7],
+                parseHttpHostPortPath(poolP, &requestUriNoQuery[7],
                                       &host, &port, &path, errorP);
         }
 
         if (!*errorP) {
             *portP = port;
-            unescapeHostPathQuery(host, path, query,
+            unescapeHostPathQuery(poolP, host, path, query,
                                   hostP, pathP, queryP, errorP);
-
-            if (host)
-                xmlrpc_strfree(host);
-            if (path)
-                xmlrpc_strfree(path);
         }
-
-        if (query)
-            xmlrpc_strfree(query);
-        xmlrpc_strfree(requestUriNoQuery);
     }
 }
 
 
 
 static void
-parseRequestLine(char *           const requestLine,
+parseRequestLine(TPool *          const poolP,
+                 char *           const requestLine,
                  TMethod *        const httpMethodP,
                  httpVersion *    const httpVersionP,
                  const char **    const hostP,
@@ -799,6 +812,8 @@ parseRequestLine(char *           const requestLine,
                  uint16_t *       const httpErrorCodeP) {
 /*----------------------------------------------------------------------------
    Modifies *requestLine!
+
+   We return strings in pool 'poolP'.
 -----------------------------------------------------------------------------*/
     const char * httpMethodName;
     char * p;
@@ -844,7 +859,8 @@ parseRequestLine(char *           const requestLine,
             const char * query;
             const char * error;
 
-            parseRequestUri(requestUri, &host, &port, &path, &query, &error);
+            parseRequestUri(poolP, requestUri,
+                            &host, &port, &path, &query, &error);
 
             if (error) {
                 *httpErrorCodeP = 400;  /* Bad Request */
@@ -875,11 +891,6 @@ parseRequestLine(char *           const requestLine,
                     *httpErrorCodeP = 0;  /* no error */
                     *moreLinesP = FALSE;
                 }
-                if (*httpErrorCodeP) {
-                    xmlrpc_strfree(host);
-                    xmlrpc_strfree(path);
-                    xmlrpc_strfree(query);
-                }
                 *hostP = host;
                 *portP = port;
                 *pathP = path;
@@ -893,18 +904,62 @@ parseRequestLine(char *           const requestLine,
 
 static void
 strtolower(char * const s) {
+/*----------------------------------------------------------------------------
+   Lower-case the ASCII string 's' in place.
 
+   An HTTP field name is ASCII, so we don't need the locale-dependent
+   tolower(), which costs a function call per character.
+-----------------------------------------------------------------------------*/
     char * t;
 
-    t = &s[0];
-    while (*t) {
-        *t = tolower(*t);
-        ++t;
+    for (t = &s[0]; *t; ++t) {
+        if ((unsigned char)(*t - 'A') <= 'Z' - 'A')
+            *t += 'a' - 'A';
     }
 }
 
 
 
+static int
+knownHeaderIndex(const char * const fieldName) {
+/*----------------------------------------------------------------------------
+   Return the index in a session's 'knownHeaderValue' of the field named
+   'fieldName' (lower case), or -1 if it isn't one of the known fields.
+
+   We look at the length first, so most field names cost at most one
+   string comparison.
+-----------------------------------------------------------------------------*/
+    int retval;
+
+    switch (strlen(fieldName)) {
+    case 4:
+        retval = xmlrpc_streq(fieldName, "host") ?
+            KNOWN_HDR_HOST : -1;
+        break;
+    case 10:
+        retval = xmlrpc_streq(fieldName, "connection") ?
+            KNOWN_HDR_CONNECTION : -1;
+        break;
+    case 12:
+        retval = xmlrpc_streq(fieldName, "content-type") ?
+            KNOWN_HDR_CONTENT_TYPE : -1;
+        break;
+    case 13:
+        retval = xmlrpc_streq(fieldName, "authorization") ?
+            KNOWN_HDR_AUTHORIZATION : -1;
+        break;
+    case 14:
+        retval = xmlrpc_streq(fieldName, "content-length") ?
+            KNOWN_HDR_CONTENT_LENGTH : -1;
+        break;
+    default:
+        retval = -1;
+    }
+    return retval;
+}
+
+
+
 static void
 getFieldNameToken(char **       const pP,
                   char **       const fieldNameP,
@@ -965,11 +1020,8 @@ processField(const char *  const fieldName,
         else
             sessionP->requestInfo.keepalive = FALSE;
     } else if (xmlrpc_streq(fieldName, "host")) {
-        if (sessionP->requestInfo.host) {
-            xmlrpc_strfree(sessionP->requestInfo.host);
-            sessionP->requestInfo.host = NULL;
-        }
-        parseHostPort(fieldValue, &sessionP->requestInfo.host,
+        sessionP->requestInfo.host = NULL;
+        parseHostPort(sessionP->poolP, fieldValue, &sessionP->requestInfo.host,
                       &sessionP->requestInfo.port, errorP);
     } else if (xmlrpc_streq(fieldName, "from"))
         sessionP->requestInfo.from = fieldValue;
@@ -1004,6 +1056,28 @@ processField(const char *  const fieldName,
 
 
 
+static void
+addRequestHeaderField(TSession *   const sessionP,
+                      const char * const fieldName,
+                      const char * const fieldValue) {
+/*----------------------------------------------------------------------------
+   Add the field 'fieldName' (lower case) with value 'fieldValue' to the
+   request header table of session *sessionP, and index it if it is a known
+   field and the first of its name.
+-----------------------------------------------------------------------------*/
+    TTable * const tableP = &sessionP->requestHeaderFields;
+
+    if (TableAdd(tableP, fieldName, fieldValue)) {
+        int const knownIdx = knownHeaderIndex(fieldName);
+
+        if (knownIdx >= 0 && !sessionP->knownHeaderValue[knownIdx])
+            sessionP->knownHeaderValue[knownIdx] =
+                tableP->item[tableP->size-1].value;
+    }
+}
+
+
+
 static void
 readAndProcessHeaderFields(TSession *    const sessionP,
                            time_t        const deadline,
@@ -1049,8 +1123,7 @@ readAndProcessHeaderFields(TSession *    const sessionP,
                     
                     fieldValue = p;
 
-                    TableAdd(&sessionP->requestHeaderFields,
-                             fieldName, fieldValue);
+                    addRequestHeaderField(sessionP, fieldName, fieldValue);
                     
                     processField(fieldName, fieldValue, sessionP, errorP,
                                  httpErrorCodeP);
@@ -1094,7 +1167,7 @@ RequestRead(TSession *    const sessionP,
         unsigned short port;
         bool moreFields;
 
-        parseRequestLine(requestLine, &httpMethod, &sessionP->version,
+        parseRequestLine(sessionP->poolP, requestLine, &httpMethod, &sessionP->version,
                          &host, &port, &path, &query,
                          &moreFields, &httpErrorCode);
 
@@ -1103,7 +1176,8 @@ RequestRead(TSession *    const sessionP,
                             "'%s'", requestLine);
             *httpErrorCodeP = httpErrorCode;
         } else {
-            initRequestInfo(&sessionP->requestInfo, sessionP->version,
+            initRequestInfo(&sessionP->requestInfo, sessionP->poolP,
+                            sessionP->version,
                             requestLine,
                             httpMethod, host, port, path, query);
 
@@ -1115,10 +1189,6 @@ RequestRead(TSession *    const sessionP,
 
             if (!*errorP)
                 sessionP->validRequest = true;
-
-            xmlrpc_strfreenull(host);
-            xmlrpc_strfree(path);
-            xmlrpc_strfreenull(query);
         }
     }
 }
@@ -1128,8 +1198,19 @@ RequestRead(TSession *    const sessionP,
 char *
 RequestHeaderValue(TSession *   const sessionP,
                    const char * const name) {
+/*----------------------------------------------------------------------------
+   Return the value of the first request header field named 'name' (lower
+   case), or NULL if there is none.
 
-    return (TableFind(&sessionP->requestHeaderFields, name));
+   We find the fields Abyss and its handlers ask about on every request
+   (Content-Length, Host, etc.) without a table search.
+-----------------------------------------------------------------------------*/
+    int const knownIdx = knownHeaderIndex(name);
+
+    if (knownIdx >= 0)
+        return (char *)sessionP->knownHeaderValue[knownIdx];
+    else
+        return (TableFind(&sessionP->requestHeaderFields, name));
 }
 
 
@@ -1227,7 +1308,8 @@ RequestAuth(TSession *   const sessionP,
                 xmlrpc_strfree(userPass);
 
                 if (xmlrpc_streq(authHdrPtr, userPassEncoded)) {
-                    sessionP->requestInfo.user = xmlrpc_strdupsol(user);
+                    sessionP->requestInfo.user =
+                        PoolStrdup(sessionP->poolP, user);
                     authorized = TRUE;
                 } else
                     authorized = FALSE;
@@ -1383,12 +1465,15 @@ HTTPWriteBodyChunk(TSession *   const sessionP,
 
         sprintf(chunkHeader, "%x\r\n", len);
 
-        succeeded =
-            ConnWrite(sessionP->connP, chunkHeader, strlen(chunkHeader));
+        /* The chunk header goes out in the same write as the chunk data, and
+           the CRLF that ends the chunk goes out with whatever is next.
+        */
+        succeeded = ConnWriteDeferred(sessionP->connP,
+                                      chunkHeader, strlen(chunkHeader));
         if (succeeded) {
             succeeded = ConnWrite(sessionP->connP, buffer, len);
             if (succeeded)
-                succeeded = ConnWrite(sessionP->connP, "\r\n", 2);
+                succeeded = ConnWriteDeferred(sessionP->connP, "\r\n", 2);
         }
     } else
         succeeded = ConnWrite(sessionP->connP, buffer, len);
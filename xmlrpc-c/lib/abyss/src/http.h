@@ -4,6 +4,7 @@
 #include <sys/types.h>
 
 #include "bool.h"
+#include "data.h"
 #include "conn.h"
 
 /*********************************************************************
@@ -20,7 +21,11 @@ RequestRead(TSession *    const sessionP,
             const char ** const errorP,
             uint16_t *    const httpErrorCodeP);
 
-void RequestInit(TSession * const r,TConn * const c);
+void
+RequestInit(TSession * const sessionP,
+            TConn *    const connectionP,
+            TPool *    const poolP);
+
 void RequestFree(TSession * const r);
 
 bool
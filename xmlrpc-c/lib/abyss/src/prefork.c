@@ -0,0 +1,524 @@
+/*=============================================================================
+                                 prefork.c
+===============================================================================
+  A pool of long-lived worker processes, supervised by the process that
+  created it.  See prefork.h.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef __linux__
+  #include <sys/prctl.h>
+#endif
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/abyss.h"
+#include "trace.h"
+
+#include "prefork.h"
+
+#define SUPERVISE_INTERVAL_MS 1000
+    /* How often the supervisor looks at its termination flag, even if
+       nothing happens.  A signal wakes it sooner.
+    */
+
+#define MIN_WORKER_LIFE 1
+    /* A worker that dies sooner than this many seconds after we start it
+       is probably going to do the same thing again, so we wait this long
+       before replacing it.
+    */
+
+struct worker {
+    pid_t pid;
+        /* Process ID of the worker; zero if there isn't one right now */
+    int statsFd;
+        /* Read end of the pipe over which the worker reports statistics.
+           Meaningful only if 'pid' is nonzero.
+        */
+    time_t startTime;
+        /* When we started the worker */
+    time_t restartTime;
+        /* When to start a replacement.  Meaningful only if 'pid' is zero */
+    TWorkerStats stats;
+        /* The worker's latest report */
+};
+
+struct TPrefork {
+    unsigned int workerCt;
+    struct worker * workers;
+        /* Array of 'workerCt' */
+    lock * lockP;
+        /* Protects the statistics, which the supervisor updates and
+           anybody may read
+        */
+    TWorkerStats retired;
+        /* What workers that are gone did.  Only the counts are meaningful.
+        */
+    bool isWorker;
+        /* This is a copy of the pool in a worker process */
+    int reportFd;
+        /* Write end of this worker's statistics pipe.  Meaningful only if
+           'isWorker'.
+        */
+};
+
+
+
+void
+PreforkCreate(unsigned int  const workerCt,
+              TPrefork **   const preforkPP,
+              const char ** const errorP) {
+
+    TPrefork * preforkP;
+
+    MALLOCVAR(preforkP);
+
+    if (preforkP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate a prefork pool");
+    else {
+        MALLOCARRAY(preforkP->workers, workerCt);
+
+        if (preforkP->workers == NULL)
+            xmlrpc_asprintf(errorP, "Unable to allocate a table of %u "
+                            "worker processes", workerCt);
+        else {
+            preforkP->lockP = xmlrpc_lock_create();
+
+            if (preforkP->lockP == NULL)
+                xmlrpc_asprintf(errorP, "Unable to create a lock for "
+                                "prefork pool");
+            else {
+                unsigned int i;
+
+                for (i = 0; i < workerCt; ++i) {
+                    preforkP->workers[i].pid         = 0;
+                    preforkP->workers[i].restartTime = 0;
+                }
+                preforkP->workerCt          = workerCt;
+                memset(&preforkP->retired, 0, sizeof(preforkP->retired));
+                preforkP->isWorker          = FALSE;
+
+                *errorP = NULL;
+                *preforkPP = preforkP;
+            }
+            if (*errorP)
+                free(preforkP->workers);
+        }
+        if (*errorP)
+            free(preforkP);
+    }
+}
+
+
+
+void
+PreforkDestroy(TPrefork * const preforkP) {
+/*----------------------------------------------------------------------------
+   The pool must not be running.
+-----------------------------------------------------------------------------*/
+    preforkP->lockP->destroy(preforkP->lockP);
+
+    free(preforkP->workers);
+
+    free(preforkP);
+}
+
+
+
+static void
+runWorker(TPrefork *   const preforkP,
+          int          const reportFd,
+          pid_t        const supervisorPid,
+          TWorkerJob * const job,
+          void *       const userHandle) {
+/*----------------------------------------------------------------------------
+   Be a worker process: do the job, then exit.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    /* The other workers' pipes are none of our business */
+    for (i = 0; i < preforkP->workerCt; ++i) {
+        if (preforkP->workers[i].pid != 0)
+            close(preforkP->workers[i].statsFd);
+    }
+    preforkP->isWorker = TRUE;
+    preforkP->reportFd = reportFd;
+
+    /* A worker that can't report must not stall, and a program the
+       worker execs must not keep the pipe open after the worker dies.
+    */
+    fcntl(reportFd, F_SETFL, fcntl(reportFd, F_GETFL) | O_NONBLOCK);
+    fcntl(reportFd, F_SETFD, FD_CLOEXEC);
+
+#ifdef __linux__
+    /* If the supervisor dies without stopping us, stop anyway, as if it
+       had.
+    */
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    if (getppid() == supervisorPid)
+        job(userHandle);
+
+    exit(0);
+}
+
+
+
+static ssize_t
+takeReports(TPrefork *      const preforkP,
+            struct worker * const workerP) {
+/*----------------------------------------------------------------------------
+   Read what is in the worker's pipe and remember the latest report.
+   Return what read() returned.
+
+   A report is smaller than PIPE_BUF, so the pipe holds only whole reports
+   and we read only whole reports.
+-----------------------------------------------------------------------------*/
+    TWorkerStats report[16];
+    ssize_t rc;
+
+    rc = read(workerP->statsFd, report, sizeof(report));
+
+    if (rc >= (ssize_t)sizeof(report[0])) {
+        /* Only the latest one matters */
+        preforkP->lockP->acquire(preforkP->lockP);
+        workerP->stats = report[rc / sizeof(report[0]) - 1];
+        preforkP->lockP->release(preforkP->lockP);
+    }
+    return rc;
+}
+
+
+
+static void
+startWorker(TPrefork *    const preforkP,
+            unsigned int  const slot,
+            TWorkerJob *  const job,
+            void *        const userHandle,
+            const char ** const errorP) {
+
+    struct worker * const workerP = &preforkP->workers[slot];
+
+    int pipeFd[2];
+    int rc;
+
+    rc = pipe(pipeFd);
+
+    if (rc != 0)
+        xmlrpc_asprintf(errorP, "pipe() failed, errno=%d (%s)",
+                        errno, strerror(errno));
+    else {
+        pid_t const supervisorPid = getpid();
+
+        pid_t pid;
+
+        pid = fork();
+
+        if (pid < 0) {
+            xmlrpc_asprintf(errorP, "fork() failed, errno=%d (%s)",
+                            errno, strerror(errno));
+            close(pipeFd[0]);
+            close(pipeFd[1]);
+        } else if (pid == 0) {
+            close(pipeFd[0]);
+            runWorker(preforkP, pipeFd[1], supervisorPid, job, userHandle);
+        } else {
+            close(pipeFd[1]);
+
+            /* We read only what is there; see takeReports() */
+            fcntl(pipeFd[0], F_SETFL, fcntl(pipeFd[0], F_GETFL) | O_NONBLOCK);
+
+            preforkP->lockP->acquire(preforkP->lockP);
+
+            workerP->pid       = pid;
+            workerP->statsFd   = pipeFd[0];
+            workerP->startTime = time(NULL);
+            memset(&workerP->stats, 0, sizeof(workerP->stats));
+
+            preforkP->lockP->release(preforkP->lockP);
+
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
+static void
+reapWorker(TPrefork *   const preforkP,
+           unsigned int const slot,
+           bool         const expected) {
+/*----------------------------------------------------------------------------
+   Clean up after worker 'slot', which has exited or is about to.
+-----------------------------------------------------------------------------*/
+    struct worker * const workerP = &preforkP->workers[slot];
+    time_t const now = time(NULL);
+
+    int status;
+    pid_t rc;
+
+    do
+        rc = waitpid(workerP->pid, &status, 0);
+    while (rc < 0 && errno == EINTR);
+
+    if (!expected) {
+        /* If rc < 0, someone else (e.g. a SIGCHLD handler) reaped the
+           process, so we don't know how it died.
+        */
+        if (rc == workerP->pid && WIFSIGNALED(status))
+            TraceMsg("Abyss worker process %d was killed by signal %d.  "
+                     "Replacing it", (int)workerP->pid, WTERMSIG(status));
+        else if (rc == workerP->pid)
+            TraceMsg("Abyss worker process %d exited with status %d.  "
+                     "Replacing it", (int)workerP->pid, WEXITSTATUS(status));
+        else
+            TraceMsg("Abyss worker process %d is gone.  Replacing it",
+                     (int)workerP->pid);
+    }
+    /* Take the worker's last words */
+    while (takeReports(preforkP, workerP) > 0);
+
+    close(workerP->statsFd);
+
+    preforkP->lockP->acquire(preforkP->lockP);
+
+    preforkP->retired.connAcceptedCt += workerP->stats.connAcceptedCt;
+    preforkP->retired.connShedCt     += workerP->stats.connShedCt;
+    preforkP->retired.readTimeoutCt  += workerP->stats.readTimeoutCt;
+    preforkP->retired.idleTimeoutCt  += workerP->stats.idleTimeoutCt;
+    preforkP->retired.writeTimeoutCt += workerP->stats.writeTimeoutCt;
+    workerP->pid = 0;
+
+    preforkP->lockP->release(preforkP->lockP);
+
+    if (now >= workerP->startTime && now - workerP->startTime < MIN_WORKER_LIFE)
+        workerP->restartTime = workerP->startTime + MIN_WORKER_LIFE;
+    else
+        workerP->restartTime = now;
+}
+
+
+
+static void
+readReports(TPrefork *   const preforkP,
+            unsigned int const slot) {
+/*----------------------------------------------------------------------------
+   Take in what worker 'slot' has reported.  If it has exited (its end of
+   the pipe is closed), clean up after it.
+-----------------------------------------------------------------------------*/
+    ssize_t rc;
+
+    rc = takeReports(preforkP, &preforkP->workers[slot]);
+
+    if (rc == 0 || (rc < 0 && errno != EINTR && errno != EAGAIN))
+        reapWorker(preforkP, slot, FALSE);
+}
+
+
+
+static void
+startDueWorkers(TPrefork *   const preforkP,
+                TWorkerJob * const job,
+                void *       const userHandle) {
+/*----------------------------------------------------------------------------
+   Start a worker in every empty slot whose time has come.  If we can't,
+   we try again later; we don't give up on the pool.
+-----------------------------------------------------------------------------*/
+    time_t const now = time(NULL);
+
+    unsigned int i;
+
+    for (i = 0; i < preforkP->workerCt; ++i) {
+        struct worker * const workerP = &preforkP->workers[i];
+
+        if (workerP->pid == 0 && now >= workerP->restartTime) {
+            const char * error;
+
+            startWorker(preforkP, i, job, userHandle, &error);
+
+            if (error) {
+                TraceMsg("Failed to start Abyss worker process.  %s", error);
+                xmlrpc_strfree(error);
+                workerP->restartTime = now + MIN_WORKER_LIFE;
+            }
+        }
+    }
+}
+
+
+
+static void
+supervise(TPrefork *   const preforkP,
+          TWorkerJob * const job,
+          void *       const userHandle,
+          const bool * const terminationRequestedP) {
+
+    struct pollfd * pollfds;
+
+    MALLOCARRAY(pollfds, preforkP->workerCt);
+
+    if (pollfds == NULL)
+        abort();
+
+    while (!*terminationRequestedP) {
+        unsigned int i;
+        int rc;
+
+        startDueWorkers(preforkP, job, userHandle);
+
+        for (i = 0; i < preforkP->workerCt; ++i) {
+            const struct worker * const workerP = &preforkP->workers[i];
+
+            /* poll() ignores a negative file descriptor */
+            pollfds[i].fd     = workerP->pid != 0 ? workerP->statsFd : -1;
+            pollfds[i].events = POLLIN;
+        }
+        rc = poll(pollfds, preforkP->workerCt, SUPERVISE_INTERVAL_MS);
+
+        if (rc > 0) {
+            for (i = 0; i < preforkP->workerCt; ++i) {
+                if (pollfds[i].fd >= 0 && pollfds[i].revents != 0)
+                    readReports(preforkP, i);
+            }
+        }
+    }
+    free(pollfds);
+}
+
+
+
+static void
+stopWorkers(TPrefork * const preforkP) {
+/*----------------------------------------------------------------------------
+   Tell every worker to finish what it's doing and exit, and wait for them
+   all to do so.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < preforkP->workerCt; ++i) {
+        if (preforkP->workers[i].pid != 0)
+            kill(preforkP->workers[i].pid, SIGTERM);
+    }
+    for (i = 0; i < preforkP->workerCt; ++i) {
+        if (preforkP->workers[i].pid != 0)
+            reapWorker(preforkP, i, TRUE);
+    }
+}
+
+
+
+void
+PreforkRun(TPrefork *    const preforkP,
+           TWorkerJob *  const job,
+           void *        const userHandle,
+           const bool *  const terminationRequestedP,
+           const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Start the workers, each doing job(userHandle), then supervise them until
+   *terminationRequestedP becomes true.  Then send each worker a SIGTERM
+   signal and wait for them all to exit.
+
+   A worker must respond to SIGTERM by finishing its job promptly; when the
+   job returns, the worker exits.
+
+   We fail only if we can't start a single worker; once the pool is
+   running, we replace workers that die, or keep trying to.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    startWorker(preforkP, 0, job, userHandle, errorP);
+
+    if (!*errorP) {
+        supervise(preforkP, job, userHandle, terminationRequestedP);
+
+        stopWorkers(preforkP);
+    }
+    for (i = 0; i < preforkP->workerCt; ++i)
+        preforkP->workers[i].restartTime = 0;
+}
+
+
+
+bool
+PreforkIsWorker(const TPrefork * const preforkP) {
+
+    return preforkP->isWorker;
+}
+
+
+
+void
+PreforkReportStats(TPrefork *           const preforkP,
+                   const TWorkerStats * const statsP) {
+/*----------------------------------------------------------------------------
+   Tell the supervisor the worker's current statistics.  If the pipe is
+   full, the report is lost, which is fine because another will follow.
+-----------------------------------------------------------------------------*/
+    if (preforkP->isWorker) {
+        ssize_t rc;
+
+        rc = write(preforkP->reportFd, statsP, sizeof(*statsP));
+
+        if (rc < 0) {
+            /* Never mind */
+        }
+    }
+}
+
+
+
+void
+PreforkGetStats(TPrefork *     const preforkP,
+                TWorkerStats * const statsP) {
+/*----------------------------------------------------------------------------
+   The totals of the latest reports of all the workers, plus the counts
+   of workers that are gone.  The average service time is the average
+   over the workers that have one.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+    unsigned int timedCt;
+    uint64_t serviceTimeTotal;
+
+    preforkP->lockP->acquire(preforkP->lockP);
+
+    *statsP = preforkP->retired;
+
+    for (i = 0, timedCt = 0, serviceTimeTotal = 0;
+         i < preforkP->workerCt;
+         ++i) {
+        const struct worker * const workerP = &preforkP->workers[i];
+
+        if (workerP->pid != 0) {
+            statsP->connAcceptedCt   += workerP->stats.connAcceptedCt;
+            statsP->connShedCt       += workerP->stats.connShedCt;
+            statsP->connInProgressCt += workerP->stats.connInProgressCt;
+            statsP->readTimeoutCt    += workerP->stats.readTimeoutCt;
+            statsP->idleTimeoutCt    += workerP->stats.idleTimeoutCt;
+            statsP->writeTimeoutCt   += workerP->stats.writeTimeoutCt;
+
+            if (workerP->stats.avgServiceTimeUs > 0) {
+                serviceTimeTotal += workerP->stats.avgServiceTimeUs;
+                ++timedCt;
+            }
+        }
+    }
+    preforkP->lockP->release(preforkP->lockP);
+
+    statsP->avgServiceTimeUs =
+        timedCt > 0 ? (uint32_t)(serviceTimeTotal / timedCt) : 0;
+}
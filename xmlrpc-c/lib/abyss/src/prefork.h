@@ -0,0 +1,54 @@
+#ifndef PREFORK_H_INCLUDED
+#define PREFORK_H_INCLUDED
+
+#include "bool.h"
+#include "int.h"
+
+/* A prefork pool is a fixed number of long-lived worker processes, each
+   running the same job -- for Abyss, an accept loop on a listening socket
+   they all inherited.  The process that creates the pool supervises it:
+   it replaces any worker that dies, and collects the statistics the
+   workers report over a pipe.
+*/
+
+typedef struct {
+    uint32_t connAcceptedCt;
+    uint32_t connShedCt;
+    uint32_t connInProgressCt;
+    uint32_t avgServiceTimeUs;
+    uint32_t readTimeoutCt;
+    uint32_t idleTimeoutCt;
+    uint32_t writeTimeoutCt;
+} TWorkerStats;
+
+typedef void TWorkerJob(void * const userHandle);
+
+typedef struct TPrefork TPrefork;
+
+void
+PreforkCreate(unsigned int  const workerCt,
+              TPrefork **   const preforkPP,
+              const char ** const errorP);
+
+void
+PreforkDestroy(TPrefork * const preforkP);
+
+void
+PreforkRun(TPrefork *    const preforkP,
+           TWorkerJob *  const job,
+           void *        const userHandle,
+           const bool *  const terminationRequestedP,
+           const char ** const errorP);
+
+bool
+PreforkIsWorker(const TPrefork * const preforkP);
+
+void
+PreforkReportStats(TPrefork *           const preforkP,
+                   const TWorkerStats * const statsP);
+
+void
+PreforkGetStats(TPrefork *     const preforkP,
+                TWorkerStats * const statsP);
+
+#endif
@@ -186,16 +186,14 @@ addConnectionHeaderFld(TSession * const sessionP) {
     struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
 
     if (HTTPKeepalive(sessionP)) {
-        const char * keepaliveValue;
+        char keepaliveValue[64];
         
         ResponseAddField(sessionP, "Connection", "Keep-Alive");
 
-        xmlrpc_asprintf(&keepaliveValue, "timeout=%u, max=%u",
-                        srvP->keepalivetimeout, srvP->keepalivemaxconn);
+        snprintf(keepaliveValue, sizeof(keepaliveValue), "timeout=%u, max=%u",
+                 srvP->keepalivetimeout, srvP->keepalivemaxconn);
 
         ResponseAddField(sessionP, "Keep-Alive", keepaliveValue);
-
-        xmlrpc_strfree(keepaliveValue);
     } else
         ResponseAddField(sessionP, "Connection", "close");
 }
@@ -222,13 +220,7 @@ addDateHeaderFld(TSession * const sessionP) {
 static void
 addServerHeaderFld(TSession * const sessionP) {
 
-    const char * serverValue;
-
-    xmlrpc_asprintf(&serverValue, "Xmlrpc-c_Abyss/%s", XMLRPC_C_VERSION);
-
-    ResponseAddField(sessionP, "Server", serverValue);
-
-    xmlrpc_strfree(serverValue);
+    ResponseAddField(sessionP, "Server", "Xmlrpc-c_Abyss/" XMLRPC_C_VERSION);
 }
 
 
@@ -257,32 +249,22 @@ trailingWsPos(const char * const arg) {
 
 
 
-static const char *
-formatFieldValue(const char * const unformatted) {
+static void
+sendFieldValue(TConn *      const connP,
+               const char * const unformatted) {
 /*----------------------------------------------------------------------------
-   Return the string of characters that goes after the colon on the
+   Send the string of characters that goes after the colon on the
    HTTP header field line, given that 'unformatted' is its basic value.
 -----------------------------------------------------------------------------*/
-    const char * retval;
-
     /* An HTTP header field value may not have leading or trailing white
        space.
     */
-    char * buffer;
-
-    buffer = malloc(strlen(unformatted) + 1);
-
-    if (buffer == NULL)
-        retval = xmlrpc_strnomemval();
-    else {
-        unsigned int const lead  = leadingWsCt(unformatted);
-        unsigned int const trail = trailingWsPos(unformatted);
-        assert(trail >= lead);
-        strncpy(buffer, &unformatted[lead], trail - lead);
-        buffer[trail - lead] = '\0';
-        retval = buffer;
-    }
-    return retval;
+    unsigned int const lead  = leadingWsCt(unformatted);
+    unsigned int const trail = trailingWsPos(unformatted);
+
+    assert(trail >= lead);
+
+    ConnWriteDeferred(connP, &unformatted[lead], trail - lead);
 }
 
 
@@ -295,6 +277,9 @@ sendHeader(TConn * const connP,
 
    Don't include the blank line that separates the header from the body.
 
+   We don't actually send anything; we leave it to go out with whatever
+   the connection writes next (ConnWriteDeferred()).
+
    fields[] contains syntactically valid HTTP header field names and values.
    But to the extent that int contains undefined field names or semantically
    invalid values, the header we send is invalid.
@@ -303,14 +288,11 @@ sendHeader(TConn * const connP,
 
     for (i = 0; i < fields.size; ++i) {
         TTableItem * const fieldP = &fields.item[i];
-        const char * const fieldValue = formatFieldValue(fieldP->value);
 
-        const char * line;
-
-        xmlrpc_asprintf(&line, "%s: %s\r\n", fieldP->name, fieldValue);
-        ConnWrite(connP, line, strlen(line));
-        xmlrpc_strfree(line);
-        xmlrpc_strfree(fieldValue);
+        ConnWriteDeferred(connP, fieldP->name, strlen(fieldP->name));
+        ConnWriteDeferred(connP, ": ", 2);
+        sendFieldValue(connP, fieldP->value);
+        ConnWriteDeferred(connP, "\r\n", 2);
     }
 }
 
@@ -322,6 +304,12 @@ ResponseWriteStart(TSession * const sessionP) {
    (i.e. Abyss session).
 
    As part of this, send the entire HTTP header for the response.
+
+   We don't write the header to the connection immediately.  It goes out
+   with the first part of the body (or at the end of the session if there
+   is no body), in a single write.  That saves a system call per response,
+   and keeps a small response in a single TCP segment, which matters
+   because the connection has Nagle's algorithm turned off.
 -----------------------------------------------------------------------------*/
     struct _TServer * const srvP = ConnServer(sessionP->connP)->srvP;
 
@@ -341,7 +329,7 @@ ResponseWriteStart(TSession * const sessionP) {
         const char * const reason = HTTPReasonByStatus(sessionP->status);
         const char * line;
         xmlrpc_asprintf(&line,"HTTP/1.1 %u %s\r\n", sessionP->status, reason);
-        ConnWrite(sessionP->connP, line, strlen(line));
+        ConnWriteDeferred(sessionP->connP, line, strlen(line));
         xmlrpc_strfree(line);
     }
 
@@ -361,7 +349,7 @@ ResponseWriteStart(TSession * const sessionP) {
     */
     sendHeader(sessionP->connP, sessionP->responseHeaderFields);
 
-    ConnWrite(sessionP->connP, "\r\n", 2);  
+    ConnWriteDeferred(sessionP->connP, "\r\n", 2);
 }
 
 
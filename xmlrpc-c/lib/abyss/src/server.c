@@ -11,6 +11,8 @@
 #include <errno.h>
 #ifndef _WIN32
   #include <grp.h>
+  #include <signal.h>
+  #include <unistd.h>
 #endif
 
 #include "xmlrpc_config.h"
@@ -19,6 +21,7 @@
 #include "mallocvar.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/lock.h"
 #include "xmlrpc-c/lock_platform.h"
 
@@ -38,6 +41,9 @@
 #endif
 #include "http.h"
 #include "handler.h"
+#ifndef _WIN32
+  #include "prefork.h"
+#endif
 
 #include "server.h"
 
@@ -53,6 +59,20 @@ struct uriHandler {
 
 
 
+static bool
+isSupervisor(struct _TServer * const srvP) {
+/*----------------------------------------------------------------------------
+   This process is supervising worker processes that run the server.
+-----------------------------------------------------------------------------*/
+#ifdef _WIN32
+    return FALSE;
+#else
+    return srvP->preforkP && !PreforkIsWorker(srvP->preforkP);
+#endif
+}
+
+
+
 void
 ServerTerminate(TServer * const serverP) {
 
@@ -60,7 +80,11 @@ ServerTerminate(TServer * const serverP) {
 
     srvP->terminationRequested = true;
 
-    if (srvP->chanSwitchP)
+    /* A supervisor's channel switch is really the workers' (they inherited
+       it), so interrupting it would interrupt them.  The supervisor
+       notices the termination request on its own and stops the workers.
+    */
+    if (srvP->chanSwitchP && !isSupervisor(srvP))
         ChanSwitchInterrupt(srvP->chanSwitchP);
 }
 
@@ -215,10 +239,16 @@ createServer(struct _TServer ** const srvPP,
 
         if (!*errorP) {
             srvP->builtinHandlerP = HandlerCreate();
+            srvP->statsLockP = xmlrpc_lock_create();
             if (!srvP->builtinHandlerP)
                 xmlrpc_asprintf(errorP, "Unable to allocate space for "
                                 "builtin handler descriptor");
+            else if (!srvP->statsLockP)
+                xmlrpc_asprintf(errorP, "Unable to create the lock for "
+                                "server statistics");
             else {
+                unsigned int i;
+
                 srvP->defaultHandler   = HandlerDefaultBuiltin;
                 srvP->defaultHandlerContext = srvP->builtinHandlerP;
 
@@ -232,6 +262,18 @@ createServer(struct _TServer ** const srvPP,
                 srvP->uriHandlerStackSize = 0;
                 srvP->maxConn          = 15;
                 srvP->maxConnBacklog   = 15;
+                srvP->shedThreshold    = 0;
+                srvP->shedMaxWaitMs    = 0;
+                srvP->shedRetryAfter   = 1;
+                srvP->connAcceptedCt   = 0;
+                srvP->connShedCt       = 0;
+                srvP->connInProgressCt = 0;
+                srvP->avgServiceTimeUs = 0;
+                srvP->connTimersP      = NULL;
+                for (i = 0; i < CONNTIMER_REASON_CT; ++i)
+                    srvP->connTimeoutCt[i] = 0;
+                srvP->workerProcessCt  = 0;
+                srvP->preforkP         = NULL;
             
                 initUnixStuff(srvP);
 
@@ -240,9 +282,12 @@ createServer(struct _TServer ** const srvPP,
                 srvP->logfileisopen = FALSE;
                 
                 *errorP = NULL;
-
-                if (*errorP)
+            }
+            if (*errorP) {
+                if (srvP->builtinHandlerP)
                     HandlerDestroy(srvP->builtinHandlerP);
+                if (srvP->statsLockP)
+                    srvP->statsLockP->destroy(srvP->statsLockP);
             }
         }        
         if (*errorP)
@@ -486,6 +531,11 @@ ServerFree(TServer * const serverP) {
     ListFree(&srvP->handlers);
 
     HandlerDestroy(srvP->builtinHandlerP);
+
+    if (srvP->connTimersP)
+        ConnTimersDestroy(srvP->connTimersP);
+
+    srvP->statsLockP->destroy(srvP->statsLockP);
     
     logClose(srvP);
 
@@ -598,6 +648,119 @@ ServerSetMaxConnBacklog(TServer *    const serverP,
 
 
 
+void
+ServerSetShedThreshold(TServer *    const serverP,
+                       unsigned int const shedThreshold) {
+
+    serverP->srvP->shedThreshold = shedThreshold;
+}
+
+
+
+void
+ServerSetShedMaxWait(TServer *    const serverP,
+                     unsigned int const shedMaxWaitMs) {
+
+    serverP->srvP->shedMaxWaitMs = shedMaxWaitMs;
+}
+
+
+
+void
+ServerSetShedRetryAfter(TServer *    const serverP,
+                        unsigned int const retryAfter) {
+
+    serverP->srvP->shedRetryAfter = retryAfter;
+}
+
+
+
+void
+ServerSetWorkerProcesses(TServer *    const serverP,
+                         unsigned int const workerProcessCt) {
+/*----------------------------------------------------------------------------
+   Make ServerRun() run 'workerProcessCt' worker processes, each of which
+   accepts connections on the server's listening socket and serves them
+   the same way ServerRun() would if there were no workers.  The process
+   that calls ServerRun() supervises the workers; it replaces any that
+   die, and ServerGetStats() in it reports for all the workers.
+
+   Zero means no worker processes.  This has no effect on Windows.
+-----------------------------------------------------------------------------*/
+    serverP->srvP->workerProcessCt = workerProcessCt;
+}
+
+
+
+void
+ServerGetStats(TServer *      const serverP,
+               TServerStats * const statsP) {
+
+    struct _TServer * const srvP = serverP->srvP;
+
+    srvP->statsLockP->acquire(srvP->statsLockP);
+
+#ifndef _WIN32
+    if (isSupervisor(srvP)) {
+        TWorkerStats workerStats;
+
+        PreforkGetStats(srvP->preforkP, &workerStats);
+
+        statsP->connAcceptedCt   = workerStats.connAcceptedCt;
+        statsP->connShedCt       = workerStats.connShedCt;
+        statsP->connInProgressCt = workerStats.connInProgressCt;
+        statsP->avgServiceTimeMs = workerStats.avgServiceTimeUs / 1000;
+        statsP->readTimeoutCt    = workerStats.readTimeoutCt;
+        statsP->idleTimeoutCt    = workerStats.idleTimeoutCt;
+        statsP->writeTimeoutCt   = workerStats.writeTimeoutCt;
+    } else
+#endif
+    {
+        statsP->connAcceptedCt   = srvP->connAcceptedCt;
+        statsP->connShedCt       = srvP->connShedCt;
+        statsP->connInProgressCt = srvP->connInProgressCt;
+        statsP->avgServiceTimeMs = srvP->avgServiceTimeUs / 1000;
+        statsP->readTimeoutCt    = srvP->connTimeoutCt[CONNTIMER_READ];
+        statsP->idleTimeoutCt    = srvP->connTimeoutCt[CONNTIMER_IDLE];
+        statsP->writeTimeoutCt   = srvP->connTimeoutCt[CONNTIMER_WRITE];
+    }
+    srvP->statsLockP->release(srvP->statsLockP);
+}
+
+
+
+static void
+recordServiceTime(struct _TServer *       const srvP,
+                  const xmlrpc_timespec * const startP) {
+/*----------------------------------------------------------------------------
+   Fold the time since *startP, which is the service time of one request,
+   into the server's recent average.
+-----------------------------------------------------------------------------*/
+    xmlrpc_timespec now;
+    int64_t elapsedUs;
+
+    xmlrpc_gettimeofday(&now);
+
+    elapsedUs = ((int64_t)now.tv_sec - startP->tv_sec) * 1000000 +
+        ((int64_t)now.tv_nsec - startP->tv_nsec) / 1000;
+
+    if (elapsedUs >= 0) {
+        uint32_t const sampleUs = (uint32_t)MIN(elapsedUs, 0x7fffffff);
+
+        srvP->statsLockP->acquire(srvP->statsLockP);
+
+        /* Each new sample has a weight of 1/8 */
+        if (sampleUs >= srvP->avgServiceTimeUs)
+            srvP->avgServiceTimeUs += (sampleUs - srvP->avgServiceTimeUs) / 8;
+        else
+            srvP->avgServiceTimeUs -= (srvP->avgServiceTimeUs - sampleUs) / 8;
+
+        srvP->statsLockP->release(srvP->statsLockP);
+    }
+}
+
+
+
 static URIHandler2
 makeUriHandler2(const struct uriHandler * const handlerP) {
 
@@ -671,11 +834,41 @@ handleReqInvalidURI(TSession * const sessionP) {
 
 
 
+static void
+finishResponse(TSession * const sessionP,
+               bool *     const keepAliveP) {
+/*----------------------------------------------------------------------------
+   Finish the response to the request of session *sessionP, after the
+   handler is done with it, and release the session's request storage.
+-----------------------------------------------------------------------------*/
+    assert(sessionP->status != 0);
+
+    if (sessionP->responseStarted)
+        HTTPWriteEndChunk(sessionP);
+    else
+        ResponseError(sessionP);
+
+    /* Send whatever of the response is still held for coalescing, e.g. the
+       header of a response with no body.
+    */
+    ConnFlush(sessionP->connP);
+
+    *keepAliveP = HTTPKeepalive(sessionP);
+
+    SessionLog(sessionP);
+
+    RequestFree(sessionP);
+}
+
+
+
 static void
 processRequestFromClient(TConn *  const connectionP,
+                         TPool *  const poolP,
                          bool     const lastReqOnConn,
                          uint32_t const timeout,
-                         bool *   const keepAliveP) {
+                         bool *   const keepAliveP,
+                         bool *   const deferredP) {
 /*----------------------------------------------------------------------------
    Get and execute one HTTP request from client connection *connectionP,
    through the connection buffer.  I.e. Some of the request may already be in
@@ -699,46 +892,118 @@ processRequestFromClient(TConn *  const connectionP,
    (GET, POST, etc) and URL etc, and that response may be either to
    execute the request and send the response or refuse the request and let
    us call the next one in the list.
+
+   We allocate the session and its per-request storage from pool 'poolP'.
+   It is all garbage when we return -- unless the handler deferred the
+   response (SessionDeferResponse()), which we return as *deferredP.  Then
+   the session and the pool belong to whoever finishes the response, and
+   Caller must not touch them or the connection again.
 -----------------------------------------------------------------------------*/
-    TSession session;
+    TSession * sessionP;
     const char * error;
     uint16_t httpErrorCode;
 
-    RequestInit(&session, connectionP);
+    sessionP = PoolAlloc(poolP, sizeof(*sessionP));
 
-    session.serverDeniesKeepalive = lastReqOnConn;
+    if (!sessionP) {
+        TraceMsg("Unable to allocate memory for an Abyss session");
+        *keepAliveP = FALSE;
+        *deferredP  = FALSE;
+    } else {
+        RequestInit(sessionP, connectionP, poolP);
+
+        sessionP->serverDeniesKeepalive = lastReqOnConn;
         
-    RequestRead(&session, timeout, &error, &httpErrorCode);
+        RequestRead(sessionP, timeout, &error, &httpErrorCode);
 
-    if (error) {
-        ResponseStatus(&session, httpErrorCode);
-        ResponseError2(&session, error);
-        xmlrpc_strfree(error);
-    } else {
-        if (session.version.major >= 2)
-            handleReqTooNewHttpVersion(&session);
-        else if (!RequestValidURI(&session))
-            handleReqInvalidURI(&session);
-        else
-            runUserHandler(&session, connectionP->server->srvP);
+        if (error) {
+            ResponseStatus(sessionP, httpErrorCode);
+            ResponseError2(sessionP, error);
+            xmlrpc_strfree(error);
+        } else {
+            if (sessionP->version.major >= 2)
+                handleReqTooNewHttpVersion(sessionP);
+            else if (!RequestValidURI(sessionP))
+                handleReqInvalidURI(sessionP);
+            else
+                runUserHandler(sessionP, connectionP->server->srvP);
+        }
+
+        /* The session may be gone already if the handler deferred the
+           response, so we ask the connection.
+        */
+        *deferredP = connectionP->responseDeferred;
+
+        if (!*deferredP)
+            finishResponse(sessionP, keepAliveP);
     }
+}
 
-    assert(session.status != 0);
 
-    if (session.responseStarted)
-        HTTPWriteEndChunk(&session);
-    else
-        ResponseError(&session);
 
-    *keepAliveP = HTTPKeepalive(&session);
+abyss_bool
+SessionDeferResponse(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Let the request handler return without having finished the response,
+   freeing the connection's thread for other work.  Any thread may then
+   finish the response with the usual Response* functions, and must then
+   call SessionDeferredResponseDone().  The session stays valid until
+   then.
+
+   The handler must return right after this, reporting the request as
+   handled, and must not touch the session again from its own thread: the
+   response may finish before it returns.  The server closes the
+   connection after the response.
+
+   Return false, and defer nothing, if the server can't do this, e.g.
+   because it doesn't run each connection in a thread of its own.  The
+   handler must finish the response itself then.
+-----------------------------------------------------------------------------*/
+    abyss_bool retval;
+
+    if (ConnDeferResponse(sessionP->connP)) {
+        /* Nobody reads another request from the connection after this
+           one, so it must not promise the client otherwise.
+        */
+        sessionP->serverDeniesKeepalive = TRUE;
+        retval = TRUE;
+    } else
+        retval = FALSE;
+
+    return retval;
+}
+
 
-    SessionLog(&session);
 
-    RequestFree(&session);
+void
+SessionDeferredResponseDone(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Finish the response SessionDeferResponse() deferred, close the
+   connection, and destroy the session.
+-----------------------------------------------------------------------------*/
+    TConn * const connectionP = sessionP->connP;
+    TPool * const poolP       = sessionP->poolP;
+
+    bool keepalive;
+
+    assert(connectionP->responseDeferred);
+
+    finishResponse(sessionP, &keepalive);
+
+    PoolFree(poolP);
+    free(poolP);
+
+    ConnDeferredResponseDone(connectionP);
 }
 
 
 
+/* This is the size of each chunk of memory in the pool from which we
+   allocate per-request storage.  It is enough for the header of a typical
+   request and response, so usually the pool never grows past one chunk.
+*/
+#define SESSION_POOL_ZONE_SIZE 4096
+
 static TThreadProc serverFunc;
 
 static void
@@ -746,6 +1011,18 @@ serverFunc(void * const userHandle) {
 /*----------------------------------------------------------------------------
    Do server stuff on one connection.  At its simplest, this means do
    one HTTP request.  But with keepalive, it can be many requests.
+
+   The client may pipeline requests (HTTP 1.1 Section 8.1.2.2), i.e. send
+   several before reading any response.  We process them one at a time, in
+   the order received, so the responses go out in the same order.  Every
+   pipelined request counts toward the server's keepalive maximum; once we
+   reach it, we close the connection and the client must resend whatever
+   requests it had queued behind the last one we answered.
+
+   All the requests on the connection share one memory pool for their
+   per-request storage (header fields, URI components, etc.).  We reset it
+   after each request rather than free it, so a steady stream of requests
+   on a keepalive connection needs very few heap operations.
 -----------------------------------------------------------------------------*/
     TConn *           const connectionP = userHandle;
     struct _TServer * const srvP = connectionP->server->srvP;
@@ -754,24 +1031,54 @@ serverFunc(void * const userHandle) {
         /* Number of requests we've handled so far on this connection */
     bool connectionDone;
         /* No more need for this HTTP connection */
+    TPool * sessionPoolP;
+        /* NULL if we don't have one: we couldn't create it, or we gave it
+           away with a deferred response.
+        */
 
     trace(srvP, "Thread starting to handle requests on a new connection.  "
           "PID = %d", getpid());
 
     requestCount = 0;
-    connectionDone = FALSE;
+
+    MALLOCVAR(sessionPoolP);
+
+    if (sessionPoolP && !PoolCreate(sessionPoolP, SESSION_POOL_ZONE_SIZE)) {
+        free(sessionPoolP);
+        sessionPoolP = NULL;
+    }
+    if (!sessionPoolP) {
+        TraceMsg("Unable to allocate the memory pool for requests on "
+                 "an Abyss connection");
+        connectionDone = TRUE;
+    } else
+        connectionDone = FALSE;
 
     while (!connectionDone) {
         bool timedOut, eof;
         const char * readError;
         
-        /* Wait for and get beginning (at least ) of next request.  We do
-           this separately from getting the rest of the request because we
-           treat dead time between requests differently from dead time in
-           the middle of a request.
-        */
-        ConnRead(connectionP, srvP->keepalivetimeout,
-                 &timedOut, &eof, &readError);
+        if (ConnHasBufferedRequest(connectionP)) {
+            /* The client pipelined this request behind the previous one, so
+               we already have the beginning of it in the connection buffer.
+               Waiting for more data here would stall the pipeline until the
+               client sends something else or the keepalive timeout expires.
+            */
+            timedOut  = FALSE;
+            eof       = FALSE;
+            readError = NULL;
+
+            trace(srvP, "Next HTTP request is already in the buffer "
+                  "(pipelined)");
+        } else {
+            /* Wait for and get beginning (at least ) of next request.  We do
+               this separately from getting the rest of the request because
+               we treat dead time between requests differently from dead
+               time in the middle of a request.
+            */
+            ConnRead(connectionP, srvP->keepalivetimeout, CONNTIMER_IDLE,
+                     &eof, &timedOut, &readError);
+        }
 
         if (srvP->terminationRequested) {
             connectionDone = TRUE;
@@ -788,25 +1095,49 @@ serverFunc(void * const userHandle) {
                 requestCount + 1 >= srvP->keepalivemaxconn;
 
             bool keepalive;
+            bool deferred;
+            xmlrpc_timespec startTime;
 
             trace(srvP, "HTTP request %u at least partially received.  "
                   "Receiving the rest and processing", requestCount);
-            
-            processRequestFromClient(connectionP, lastReqOnConn, srvP->timeout,
-                                     &keepalive);
 
-            trace(srvP, "Done processing the HTTP request.  Keepalive = %s",
-                  keepalive ? "YES" : "NO");
+            xmlrpc_gettimeofday(&startTime);
             
-            ++requestCount;
+            processRequestFromClient(connectionP, sessionPoolP,
+                                     lastReqOnConn, srvP->timeout,
+                                     &keepalive, &deferred);
 
-            if (!keepalive)
+            if (deferred) {
+                /* Whoever finishes the response owns the pool and the
+                   connection now.  We're done with both.
+                */
+                trace(srvP, "Handler deferred the response.  Leaving the "
+                      "connection to it");
+                sessionPoolP = NULL;
                 connectionDone = TRUE;
+            } else {
+                PoolReset(sessionPoolP);
+
+                recordServiceTime(srvP, &startTime);
+
+                trace(srvP, "Done processing the HTTP request.  "
+                      "Keepalive = %s", keepalive ? "YES" : "NO");
             
-            /**************** Must adjust the read buffer *****************/
-            ConnReadInit(connectionP);
+                ++requestCount;
+
+                if (!keepalive)
+                    connectionDone = TRUE;
+            
+                /************** Must adjust the read buffer ***************/
+                ConnReadInit(connectionP);
+            }
         }
     }
+    if (sessionPoolP) {
+        PoolFree(sessionPoolP);
+        free(sessionPoolP);
+    }
+
     trace(srvP, "PID %d done with connection", getpid());
 }
 
@@ -1046,13 +1377,37 @@ waitForNoConnections(outstandingConnList * const outstandingConnListP) {
 
 
 
+static unsigned int
+busyConnCount(outstandingConnList * const listP) {
+/*----------------------------------------------------------------------------
+   The number of connections in the list that have a thread working on
+   them.  The others are waiting for a deferred response (see
+   SessionDeferResponse()), so don't use up any of the server's capacity
+   but a socket.
+-----------------------------------------------------------------------------*/
+    unsigned int count;
+    TConn * connP;
+
+    for (connP = listP->firstP, count = 0;
+         connP;
+         connP = connP->nextOutstandingP) {
+
+        if (!ConnIsParked(connP))
+            ++count;
+    }
+    return count;
+}
+
+
+
 static void
 waitForConnectionCapacity(outstandingConnList * const outstandingConnListP,
                           unsigned int          const maxConn) {
 /*----------------------------------------------------------------------------
-   Wait until there are fewer than 'maxConn' connections in progress.
+   Wait until there are fewer than 'maxConn' connections in progress, not
+   counting ones that are just waiting for a deferred response.
 -----------------------------------------------------------------------------*/
-    while (outstandingConnListP->count >= maxConn) {
+    while (busyConnCount(outstandingConnListP) >= maxConn) {
         freeFinishedConns(outstandingConnListP);
         if (outstandingConnListP->firstP)
             waitForConnectionFreed(outstandingConnListP);
@@ -1126,20 +1481,117 @@ destroyChannel(void * const userHandle) {
 
 
 
+static bool
+shouldShed(struct _TServer * const srvP,
+           unsigned int      const connInProgressCt) {
+/*----------------------------------------------------------------------------
+   Return true iff the server is too busy to take on another connection,
+   given that 'connInProgressCt' connections are in progress now, so
+   it should refuse it rather than make the client wait.
+
+   A connection that is just waiting for a deferred response doesn't count
+   as in progress.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    if (srvP->shedThreshold > 0 && connInProgressCt >= srvP->shedThreshold)
+        retval = TRUE;
+    else if (srvP->shedMaxWaitMs > 0 && connInProgressCt >= srvP->maxConn) {
+        uint32_t avgServiceTimeUs;
+
+        srvP->statsLockP->acquire(srvP->statsLockP);
+        avgServiceTimeUs = srvP->avgServiceTimeUs;
+        srvP->statsLockP->release(srvP->statsLockP);
+
+        retval = avgServiceTimeUs / 1000 > srvP->shedMaxWaitMs;
+    } else
+        retval = FALSE;
+
+    return retval;
+}
+
+
+
 static void
-processNewChannel(TServer *             const serverP,
-                  TChannel *            const channelP,
-                  void *                const channelInfoP,
-                  outstandingConnList * const outstandingConnListP,
-                  const char **         const errorP) {
+shedChannel(struct _TServer * const srvP,
+            TChannel *        const channelP) {
+/*----------------------------------------------------------------------------
+   Refuse the connection on channel *channelP because the server is
+   overloaded: send a 503 (Service Unavailable) response, telling the client
+   when to try again, without reading the request or creating a connection
+   thread.
+
+   This runs in the thread that accepts connections, so it must not wait
+   on the client.
+-----------------------------------------------------------------------------*/
+    const char * response;
+    bool failed;
+
+    xmlrpc_asprintf(&response,
+                    "HTTP/1.1 503 %s\r\n"
+                    "Retry-After: %u\r\n"
+                    "Connection: close\r\n"
+                    "Content-Length: 0\r\n"
+                    "\r\n",
+                    HTTPReasonByStatus(503), srvP->shedRetryAfter);
+
+    ChannelWrite(channelP, (const unsigned char *)response, strlen(response),
+                 &failed);
+
+    xmlrpc_strfree(response);
+
+    {
+        /* If we close the channel with the client's request unread, the OS
+           may reset the connection, and the client might never see our
+           response.  So read whatever of the request is there already.
+        */
+        bool readyToRead;
+        bool failed;
+
+        ChannelWait(channelP, TRUE, FALSE, 0, &readyToRead, NULL, &failed);
+
+        if (!failed && readyToRead) {
+            unsigned char buffer[4096];
+            uint32_t bytesRead;
+            bool readFailed;
+
+            ChannelRead(channelP, buffer, sizeof(buffer),
+                        &bytesRead, &readFailed);
+        }
+    }
+    srvP->statsLockP->acquire(srvP->statsLockP);
+    ++srvP->connShedCt;
+    srvP->statsLockP->release(srvP->statsLockP);
+
+    trace(srvP, "Refused a new connection with 503 because the server is "
+          "overloaded");
+}
+
+
+
+static void
+updateConnInProgressCt(struct _TServer * const srvP,
+                       unsigned int      const connInProgressCt) {
+
+    srvP->statsLockP->acquire(srvP->statsLockP);
+    srvP->connInProgressCt = connInProgressCt;
+    srvP->statsLockP->release(srvP->statsLockP);
+}
+
+
+
+static void
+serveNewChannel(TServer *             const serverP,
+                TChannel *            const channelP,
+                void *                const channelInfoP,
+                outstandingConnList * const outstandingConnListP,
+                const char **         const errorP) {
 
     struct _TServer * const srvP = serverP->srvP;
                       
     TConn * connectionP;
     const char * error;
 
-    freeFinishedConns(outstandingConnListP);
-            
     trace(srvP, "Waiting for there to be fewer than the maximum "
           "%u sessions in progress",
           srvP->maxConn);
@@ -1154,6 +1606,12 @@ processNewChannel(TServer *             const serverP,
                &error);
     if (!error) {
         addToOutstandingConnList(outstandingConnListP, connectionP);
+
+        srvP->statsLockP->acquire(srvP->statsLockP);
+        ++srvP->connAcceptedCt;
+        srvP->connInProgressCt = outstandingConnListP->count;
+        srvP->statsLockP->release(srvP->statsLockP);
+
         ConnProcess(connectionP);
         /* When connection is done (which could be later, courtesy of a
            background thread), destroyChannel() will destroy *channelP.
@@ -1168,6 +1626,37 @@ processNewChannel(TServer *             const serverP,
 
 
 
+static void
+processNewChannel(TServer *             const serverP,
+                  TChannel *            const channelP,
+                  void *                const channelInfoP,
+                  outstandingConnList * const outstandingConnListP,
+                  bool *                const shedP,
+                  const char **         const errorP) {
+/*----------------------------------------------------------------------------
+   Serve the new connection on *channelP, or if the server is overloaded,
+   refuse it.  Return *shedP == true iff we refused it, in which case the
+   caller still owns *channelP.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    freeFinishedConns(outstandingConnListP);
+
+    updateConnInProgressCt(srvP, outstandingConnListP->count);
+
+    if (shouldShed(srvP, busyConnCount(outstandingConnListP))) {
+        shedChannel(srvP, channelP);
+        *shedP  = TRUE;
+        *errorP = NULL;
+    } else {
+        *shedP = FALSE;
+        serveNewChannel(serverP, channelP, channelInfoP,
+                        outstandingConnListP, errorP);
+    }
+}
+
+
+
 static void
 acceptAndProcessNextConnection(
     TServer *             const serverP,
@@ -1192,13 +1681,18 @@ acceptAndProcessNextConnection(
     } else {
         if (channelP) {
             const char * error;
+            bool shed;
 
             trace(srvP, "Got a new channel from channel switch");
 
             processNewChannel(serverP, channelP, channelInfoP,
-                              outstandingConnListP, &error);
+                              outstandingConnListP, &shed, &error);
 
-            if (error) {
+            if (shed) {
+                ChannelDestroy(channelP);
+                free(channelInfoP);
+                *errorP = NULL;
+            } else if (error) {
                 xmlrpc_asprintf(errorP, "Failed to use new channel %lx",
                                 (unsigned long) channelP);
                 ChannelDestroy(channelP);
@@ -1219,6 +1713,55 @@ acceptAndProcessNextConnection(
 
 
 
+static void
+createConnTimers(struct _TServer * const srvP) {
+/*----------------------------------------------------------------------------
+   Set up the timers that enforce I/O timeouts for the connections we are
+   about to accept.  If we can't, connections time their own waits.
+-----------------------------------------------------------------------------*/
+    const char * error;
+
+    ConnTimersCreate(&srvP->connTimersP, &error);
+
+    if (error) {
+        TraceMsg("Unable to set up connection timers.  Each connection "
+                 "will enforce its own timeouts.  %s", error);
+        xmlrpc_strfree(error);
+        srvP->connTimersP = NULL;
+    }
+}
+
+
+
+static void
+reportWorkerStats(struct _TServer * const srvP) {
+/*----------------------------------------------------------------------------
+   If this process is a worker process, tell the supervisor its current
+   statistics.
+-----------------------------------------------------------------------------*/
+#ifndef _WIN32
+    if (srvP->preforkP && PreforkIsWorker(srvP->preforkP)) {
+        TWorkerStats stats;
+
+        srvP->statsLockP->acquire(srvP->statsLockP);
+
+        stats.connAcceptedCt   = srvP->connAcceptedCt;
+        stats.connShedCt       = srvP->connShedCt;
+        stats.connInProgressCt = srvP->connInProgressCt;
+        stats.avgServiceTimeUs = srvP->avgServiceTimeUs;
+        stats.readTimeoutCt    = srvP->connTimeoutCt[CONNTIMER_READ];
+        stats.idleTimeoutCt    = srvP->connTimeoutCt[CONNTIMER_IDLE];
+        stats.writeTimeoutCt   = srvP->connTimeoutCt[CONNTIMER_WRITE];
+
+        srvP->statsLockP->release(srvP->statsLockP);
+
+        PreforkReportStats(srvP->preforkP, &stats);
+    }
+#endif
+}
+
+
+
 static void 
 serverRun2(TServer *     const serverP,
            const char ** const errorP) {
@@ -1228,13 +1771,19 @@ serverRun2(TServer *     const serverP,
 
     createOutstandingConnList(&outstandingConnListP);
 
+    if (!srvP->connTimersP && !ThreadForks())
+        createConnTimers(srvP);
+
     *errorP = NULL;  /* initial value */
 
     trace(srvP, "Starting main connection accepting loop");
     
-    while (!srvP->terminationRequested && !*errorP)
+    while (!srvP->terminationRequested && !*errorP) {
         acceptAndProcessNextConnection(serverP, outstandingConnListP, errorP);
 
+        reportWorkerStats(srvP);
+    }
+
     trace(srvP, "Main connection accepting loop is done");
 
     if (!*errorP) {
@@ -1254,6 +1803,127 @@ serverRun2(TServer *     const serverP,
 
 
 
+#ifndef _WIN32
+
+static TServer * workerServerP;
+    /* The server a worker process runs, for its SIGTERM handler */
+
+
+
+static void
+terminateWorker(int const signalClass ATTR_UNUSED) {
+
+    ServerTerminate(workerServerP);
+}
+
+
+
+static TWorkerJob workerMain;
+
+static void
+workerMain(void * const userHandle) {
+/*----------------------------------------------------------------------------
+   The life of a worker process: run the server until the supervisor sends
+   SIGTERM.
+-----------------------------------------------------------------------------*/
+    TServer * const serverP = userHandle;
+    struct _TServer * const srvP = serverP->srvP;
+
+    struct sigaction sa;
+    sigset_t termSet;
+    const char * error;
+
+    /* No SA_RESTART, so the signal interrupts a wait in accept() too */
+    workerServerP = serverP;
+    sa.sa_handler = &terminateWorker;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGTERM, &sa, NULL);
+
+    sigemptyset(&termSet);
+    sigaddset(&termSet, SIGTERM);
+    sigprocmask(SIG_UNBLOCK, &termSet, NULL);
+
+    serverRun2(serverP, &error);
+
+    if (error) {
+        TraceMsg("Abyss worker process %d failed.  %s", (int)getpid(), error);
+        xmlrpc_strfree(error);
+    }
+    reportWorkerStats(srvP);
+}
+
+
+
+static void
+setPrefork(struct _TServer * const srvP,
+           TPrefork *        const preforkP) {
+
+    srvP->statsLockP->acquire(srvP->statsLockP);
+    srvP->preforkP = preforkP;
+    srvP->statsLockP->release(srvP->statsLockP);
+}
+
+
+
+static void
+keepWorkerStats(struct _TServer * const srvP,
+                TPrefork *        const preforkP) {
+/*----------------------------------------------------------------------------
+   Add what the workers, all gone now, did to the server's own
+   statistics, so ServerGetStats() reports it after ServerRun() returns.
+-----------------------------------------------------------------------------*/
+    TWorkerStats workerStats;
+
+    PreforkGetStats(preforkP, &workerStats);
+
+    srvP->statsLockP->acquire(srvP->statsLockP);
+    srvP->connAcceptedCt  += workerStats.connAcceptedCt;
+    srvP->connShedCt      += workerStats.connShedCt;
+    srvP->connInProgressCt = 0;
+    srvP->connTimeoutCt[CONNTIMER_READ]  += workerStats.readTimeoutCt;
+    srvP->connTimeoutCt[CONNTIMER_IDLE]  += workerStats.idleTimeoutCt;
+    srvP->connTimeoutCt[CONNTIMER_WRITE] += workerStats.writeTimeoutCt;
+    srvP->statsLockP->release(srvP->statsLockP);
+}
+
+
+
+static void
+runWorkerProcesses(TServer *     const serverP,
+                   const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Run the server in worker processes and supervise them until someone
+   requests termination.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    TPrefork * preforkP;
+
+    PreforkCreate(srvP->workerProcessCt, &preforkP, errorP);
+
+    if (!*errorP) {
+        trace(srvP, "Starting %u worker processes", srvP->workerProcessCt);
+
+        setPrefork(srvP, preforkP);
+
+        PreforkRun(preforkP, &workerMain, serverP,
+                   &srvP->terminationRequested, errorP);
+
+        trace(srvP, "All worker processes have exited");
+
+        keepWorkerStats(srvP, preforkP);
+
+        setPrefork(srvP, NULL);
+
+        PreforkDestroy(preforkP);
+    }
+}
+
+#endif  /* _WIN32 */
+
+
+
 void 
 ServerRun(TServer * const serverP) {
 
@@ -1268,7 +1938,12 @@ ServerRun(TServer * const serverP) {
     else {
         const char * error;
 
-        serverRun2(serverP, &error);
+#ifndef _WIN32
+        if (srvP->workerProcessCt > 0)
+            runWorkerProcesses(serverP, &error);
+        else
+#endif
+            serverRun2(serverP, &error);
 
         if (error) {
             TraceMsg("Server failed.  %s", error);
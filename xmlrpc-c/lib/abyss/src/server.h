@@ -8,8 +8,10 @@
 #include "xmlrpc-c/abyss.h"
 
 #include "data.h"
+#include "conntimer.h"
 
 struct TFile;
+struct TPrefork;
 
 struct _TServer {
     bool traceIsActive;
@@ -63,6 +65,43 @@ struct _TServer {
            connections on the server's behalf and holds them waiting for the
            server to accept them from the OS.
         */
+    uint32_t shedThreshold;
+        /* Server refuses a new connection with a quick 503 (Service
+           Unavailable) response, without running any handler, if there
+           are already this many connections in progress.  Zero means
+           no limit.
+        */
+    uint32_t shedMaxWaitMs;
+        /* Server refuses a new connection as for 'shedThreshold' if it
+           would have to wait for a connection to finish before serving it
+           (there are already 'maxConn' connections) and the recent average
+           service time of a request is longer than this many milliseconds.
+           Zero means the server always waits.
+        */
+    uint32_t shedRetryAfter;
+        /* The value of the Retry-After header field (seconds) of the
+           response to a refused connection.
+        */
+    lock * statsLockP;
+        /* Protects the statistics below, which connection threads update */
+    uint32_t connAcceptedCt;
+    uint32_t connShedCt;
+    uint32_t connInProgressCt;
+    uint32_t avgServiceTimeUs;
+        /* Exponentially weighted moving average of the time to process a
+           request, in microseconds.  When threads are processes (fork),
+           the server never sees the times, so this stays zero.
+        */
+    uint32_t connTimeoutCt[CONNTIMER_REASON_CT];
+        /* Number of times a connection timed out, by reason.  Like
+           'avgServiceTimeUs', this stays zero when threads are processes.
+        */
+    TConnTimers * connTimersP;
+        /* The timers that enforce I/O timeouts for all connections.  NULL
+           if we don't have them (yet), in which case each connection times
+           its own waits.  We create them when we first accept connections,
+           unless threads are processes.
+        */
     TList handlers;
         /* Ordered list of HTTP request handlers.  For each HTTP request,
            Server calls each one in order until one reports that it handled
@@ -95,6 +134,16 @@ struct _TServer {
            of the function itself, not the stack size for the thread
            that runs it.
         */
+    unsigned int workerProcessCt;
+        /* ServerRun() runs this many worker processes, each accepting and
+           serving connections, and supervises them.  Zero means it accepts
+           and serves connections in the process that calls it.
+        */
+    struct TPrefork * preforkP;
+        /* The pool of worker processes while ServerRun() is running it;
+           NULL otherwise.  Protected by 'statsLockP'.  A worker process has
+           a copy of this too, which it uses to report its statistics.
+        */
 #ifndef _WIN32
     uid_t uid;
     gid_t gid;
@@ -9,6 +9,7 @@
 #include "xmlrpc-c/abyss.h"
 #include "server.h"
 #include "http.h"
+#include "channel.h"
 #include "conn.h"
 
 #include "session.h"
@@ -46,7 +47,8 @@ SessionRefillBuffer(TSession * const sessionP) {
            somebody to keep a connection alive nearly indefinitely.  But it's
            hard to do anything intelligent here without very complicated code.
         */
-        ConnRead(sessionP->connP, srvP->timeout, NULL, NULL, &readError);	
+        ConnRead(sessionP->connP, srvP->timeout, CONNTIMER_READ,
+                 NULL, NULL, &readError);	
         if (readError) {
             failed = TRUE;
             xmlrpc_strfree(readError);
@@ -161,3 +163,36 @@ SessionGetDefaultHandlerCtx(TSession * const sessionP) {
 
     return srvP->defaultHandlerContext;
 }
+
+
+
+void
+SessionSetHandlerData(TSession * const sessionP,
+                      void *     const handlerData) {
+/*----------------------------------------------------------------------------
+   Attach 'handlerData' to the session, for retrieval by
+   SessionGetHandlerData().  Abyss does nothing else with it; it is for a
+   request handler to pass information to code it calls that sees only the
+   session.
+-----------------------------------------------------------------------------*/
+    sessionP->handlerData = handlerData;
+}
+
+
+
+void *
+SessionGetHandlerData(TSession * const sessionP) {
+
+    return sessionP->handlerData;
+}
+
+
+
+abyss_bool
+SessionPeerGone(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Tell whether the client has gone away, e.g. given up waiting for the
+   response and closed the connection.  False if we can't tell.
+-----------------------------------------------------------------------------*/
+    return ChannelPeerGone(sessionP->connP->channelP);
+}
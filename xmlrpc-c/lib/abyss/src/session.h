@@ -11,6 +11,18 @@ typedef struct {
     uint8_t minor;
 } httpVersion;
 
+/* The request header fields we look up so often that we index them
+   directly instead of searching 'requestHeaderFields'.
+*/
+enum knownHeaderField {
+    KNOWN_HDR_CONTENT_LENGTH,
+    KNOWN_HDR_CONTENT_TYPE,
+    KNOWN_HDR_CONNECTION,
+    KNOWN_HDR_HOST,
+    KNOWN_HDR_AUTHORIZATION,
+    KNOWN_HDR_CT  /* Number of known fields; not a field */
+};
+
 struct _TSession {
     bool validRequest;
         /* Client has sent, and server has recognized, a valid HTTP request.
@@ -49,6 +61,12 @@ struct _TSession {
 
     struct _TConn * connP;
 
+    TPool * poolP;
+        /* Storage for the strings in 'requestInfo' and the request and
+           response header tables.  It belongs to the server thread
+           processing the connection, which resets it between requests.
+        */
+
     httpVersion version;
 
     TTable requestHeaderFields;
@@ -57,6 +75,13 @@ struct _TSession {
            the field.
         */
 
+    const char * knownHeaderValue[KNOWN_HDR_CT];
+        /* knownHeaderValue[KNOWN_HDR_HOST], for example, is the value of the
+           first Host field of the request header -- the same string
+           'requestHeaderFields' has for it.  NULL if the request has no such
+           field.
+        */
+
     TTable responseHeaderFields;
         /* All the fields of the header of the HTTP response.
            This gets successively computed; at any moment, it is the list of
@@ -80,6 +105,12 @@ struct _TSession {
         /* This client must receive 100 (continue) status before it will
            send more of the body of the request.
         */
+
+    void * handlerData;
+        /* Whatever the handler that is serving the request wants to
+           attach to the session for code it calls, e.g. the deadline of
+           the call the request carries.  NULL when the session is new.
+        */
 };
 
 
@@ -5,8 +5,8 @@
   for an SSL (Secure Sockets Layer) connection based on an OpenSSL
   connection object -- what you create with SSL_new().
 
-  This is just a template for future development.  It does not function
-  (or even compile) today.
+  This is not part of the normal build, because it makes the Abyss library
+  depend on OpenSSL.  To build it in, make with ENABLE_ABYSS_OPENSSL=yes.
 
 =============================================================================*/
 
@@ -25,6 +25,8 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -38,13 +40,17 @@
 #include "chanswitch.h"
 #include "channel.h"
 #include "socket.h"
+#include "socket_unix.h"
 #include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/abyss_opensslsock.h"
 
-#include "socket_openssl.h"
 
+#define HANDSHAKE_TIMEOUT_MS 15000
+    /* How long a client has to complete the TLS handshake */
 
 
-struct channelOpenSsl {
+
+struct channelOpenssl {
 /*----------------------------------------------------------------------------
    The properties/state of a TChannel unique to the OpenSSL variety.
 -----------------------------------------------------------------------------*/
@@ -56,6 +62,14 @@ struct channelOpenSsl {
         /* The SSL connection belongs to the user; we did not create
            it.
         */
+    bool handshakeDone;
+        /* We have done the server side of the TLS handshake, or don't need
+           to.  For a connection we accept, we do it on the first read or
+           write, i.e. in the thread that serves the connection rather than
+           the one that accepts connections, so a client that is slow to
+           shake hands holds up only itself.
+        */
+    bool handshakeFailed;
 };
 
 
@@ -88,6 +102,12 @@ connected(int const fd) {
 
 
 
+void
+SocketOpensslInit(const char ** const errorP);
+
+void
+SocketOpenSslTerm(void);
+
 void
 SocketOpensslInit(const char ** const errorP) {
 
@@ -105,7 +125,7 @@ SocketOpensslInit(const char ** const errorP) {
 void
 SocketOpenSslTerm(void) {
 
-	ERR_free_string();
+	ERR_free_strings();
 
 }
 
@@ -115,6 +135,103 @@ SocketOpenSslTerm(void) {
       TChannel
 =============================================================================*/
 
+static void
+setNonBlocking(int  const fd,
+               bool const nonBlocking) {
+
+    int const flags = fcntl(fd, F_GETFL);
+
+    if (flags >= 0)
+        fcntl(fd, F_SETFL,
+              nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+}
+
+
+
+static void
+acceptHandshake(SSL *         const sslP,
+                unsigned int  const timeoutMs,
+                const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Do the server side of the TLS handshake on SSL connection *sslP, but
+   fail if the client hasn't completed it within 'timeoutMs' milliseconds.
+
+   If the client offers a session ID or ticket for a session in the SSL
+   context's cache, this is an abbreviated handshake that skips the public
+   key operations.
+-----------------------------------------------------------------------------*/
+    int const fd = SSL_get_fd(sslP);
+    time_t const deadline = time(NULL) + (timeoutMs + 999) / 1000;
+
+    bool done;
+
+    /* We can't tell SSL_accept() how long to wait, so we make the socket
+       non-blocking and do the waiting ourselves.
+    */
+    setNonBlocking(fd, TRUE);
+
+    for (done = FALSE, *errorP = NULL; !done && !*errorP; ) {
+        int const rc = SSL_accept(sslP);
+
+        if (rc == 1)
+            done = TRUE;
+        else {
+            int const sslError = SSL_get_error(sslP, rc);
+
+            if (sslError == SSL_ERROR_WANT_READ ||
+                sslError == SSL_ERROR_WANT_WRITE) {
+                int const timeLeft = (int)(deadline - time(NULL));
+
+                if (timeLeft <= 0)
+                    xmlrpc_asprintf(errorP, "Client did not complete the "
+                                    "TLS handshake within %u ms", timeoutMs);
+                else {
+                    struct pollfd pollfd;
+
+                    pollfd.fd     = fd;
+                    pollfd.events =
+                        sslError == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+
+                    poll(&pollfd, 1, timeLeft * 1000);
+                }
+            } else
+                xmlrpc_asprintf(errorP, "TLS handshake with client failed.  "
+                                "SSL_accept() failed with %d", sslError);
+        }
+    }
+    setNonBlocking(fd, FALSE);
+
+    if (!*errorP && ChannelTraceIsActive)
+        fprintf(stderr, "Abyss OpenSSL: %s handshake\n",
+                SSL_session_reused(sslP) ?
+                "abbreviated (resumed session)" : "full");
+}
+
+
+
+static bool
+handshakeOk(struct channelOpenssl * const channelOpensslP) {
+/*----------------------------------------------------------------------------
+   Make sure the channel's TLS handshake is done, doing it if necessary.
+   Return false if it failed (now or earlier).
+-----------------------------------------------------------------------------*/
+    if (!channelOpensslP->handshakeDone && !channelOpensslP->handshakeFailed) {
+        const char * error;
+
+        acceptHandshake(channelOpensslP->sslP, HANDSHAKE_TIMEOUT_MS, &error);
+
+        if (error) {
+            if (ChannelTraceIsActive)
+                fprintf(stderr, "Abyss OpenSSL: %s\n", error);
+            xmlrpc_strfree(error);
+            channelOpensslP->handshakeFailed = TRUE;
+        } else
+            channelOpensslP->handshakeDone = TRUE;
+    }
+    return channelOpensslP->handshakeDone;
+}
+
+
 static ChannelDestroyImpl channelDestroy;
 
 static void
@@ -122,9 +239,17 @@ channelDestroy(TChannel * const channelP) {
 
     struct channelOpenssl * const channelOpensslP = channelP->implP;
 
-    if (!socketUnixP->userSuppliedConn)
-        SSL_shutdown(channelOpensslP->sslP);
+    if (!channelOpensslP->userSuppliedConn) {
+        int const fd = SSL_get_fd(channelOpensslP->sslP);
 
+        /* A clean shutdown is what keeps the session resumable; OpenSSL
+           drops a session from the cache if the connection just stops.
+        */
+        if (channelOpensslP->handshakeDone)
+            SSL_shutdown(channelOpensslP->sslP);
+        SSL_free(channelOpensslP->sslP);
+        close(fd);
+    }
     free(channelOpensslP);
 }
 
@@ -145,21 +270,21 @@ channelWrite(TChannel *            const channelP,
 
     assert(sizeof(int) >= sizeof(len));
 
-    for (bytesLeft = len, error = FALSE;
+    for (bytesLeft = len, error = !handshakeOk(channelOpensslP);
          bytesLeft > 0 && !error;
         ) {
-        int const maxSend = (int)(-1) >> 1;
+        int const maxSend = (int)((unsigned int)(-1) >> 1);
 
         int rc;
         
-        rc = SSL_write(channelOpensslP->ssl, &buffer[len-bytesLeft],
+        rc = SSL_write(channelOpensslP->sslP, &buffer[len-bytesLeft],
                        MIN(maxSend, bytesLeft));
 
         if (ChannelTraceIsActive) {
             if (rc <= 0)
                 fprintf(stderr,
-                        "Abyss socket: SSL_write() failed.  rc=%d (%s)",
-                        rc, SSL_get_error(rc));
+                        "Abyss socket: SSL_write() failed.  rc=%d (%d)",
+                        rc, SSL_get_error(channelOpensslP->sslP, rc));
             else
                 fprintf(stderr, "Abyss socket: sent %u bytes: '%.*s'\n",
                         rc, rc, &buffer[len-bytesLeft]);
@@ -175,7 +300,56 @@ channelWrite(TChannel *            const channelP,
 
 
 
-ChannelReadImpl channelRead;
+static ChannelWritevImpl channelWritev;
+
+static void
+channelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              bool *                const failedP) {
+/*----------------------------------------------------------------------------
+  Each SSL_write() makes at least one TLS record, with its own header and
+  MAC, and typically its own TCP segment.  So rather than write the segments
+  separately, we copy them into one buffer and write that, so that e.g. an
+  HTTP response header and a small body go out as a single record.
+
+  If we can't get memory for the buffer, we write the segments separately.
+-----------------------------------------------------------------------------*/
+    size_t totalLen;
+    unsigned char * buffer;
+    unsigned int i;
+
+    for (i = 0, totalLen = 0; i < iovCt; ++i)
+        totalLen += iov[i].len;
+
+    if ((size_t)(uint32_t)totalLen == totalLen)
+        MALLOCARRAY(buffer, totalLen);
+    else
+        buffer = NULL;
+
+    if (buffer) {
+        size_t cursor;
+
+        for (i = 0, cursor = 0; i < iovCt; ++i) {
+            memcpy(&buffer[cursor], iov[i].base, iov[i].len);
+            cursor += iov[i].len;
+        }
+        channelWrite(channelP, buffer, totalLen, failedP);
+
+        free(buffer);
+    } else {
+        bool failed;
+
+        for (i = 0, failed = FALSE; i < iovCt && !failed; ++i)
+            channelWrite(channelP, iov[i].base, iov[i].len, &failed);
+
+        *failedP = failed;
+    }
+}
+
+
+
+static ChannelReadImpl channelRead;
 
 static void
 channelRead(TChannel *      const channelP, 
@@ -187,14 +361,19 @@ channelRead(TChannel *      const channelP,
     struct channelOpenssl * const channelOpensslP = channelP->implP;
 
     int rc;
-    rc = SSL_read(channelOpensslP->sslP, buf, len);
+
+    if (!handshakeOk(channelOpensslP))
+        rc = -1;
+    else
+        rc = SSL_read(channelOpensslP->sslP, buffer,
+                      MIN(bufferSize, (uint32_t)((int)(-1) >> 1)));
 
     if (rc < 0) {
         *failedP = TRUE;
-        if (ChannelTraceIsActive)
+        if (ChannelTraceIsActive && channelOpensslP->handshakeDone)
             fprintf(stderr, "Failed to receive data from OpenSSL connection.  "
-                    "SSL_read() failed with rc %d (%s)\n",
-                    rc, SSL_get_error(rc));
+                    "SSL_read() failed with rc %d (%d)\n",
+                    rc, SSL_get_error(channelOpensslP->sslP, rc));
     } else {
         *failedP = FALSE;
         *bytesReceivedP = rc;
@@ -210,10 +389,10 @@ channelRead(TChannel *      const channelP,
 static ChannelWaitImpl channelWait;
 
 static void
-channelWait(TChannel * const channelP,
+channelWait(TChannel * const channelP      ATTR_UNUSED,
             bool       const waitForRead,
             bool       const waitForWrite,
-            uint32_t   const timeoutMs,
+            uint32_t   const timeoutMs     ATTR_UNUSED,
             bool *     const readyToReadP,
             bool *     const readyToWriteP,
             bool *     const failedP) {
@@ -225,7 +404,12 @@ channelWait(TChannel * const channelP,
   how yet.  Instead, we return immediately and hope that if Caller
   subsequently does a read or write, it blocks until it can do its thing.
 -----------------------------------------------------------------------------*/
-
+    if (readyToReadP)
+        *readyToReadP = waitForRead;
+    if (readyToWriteP)
+        *readyToWriteP = waitForWrite;
+    if (failedP)
+        *failedP = FALSE;
 }
 
 
@@ -233,7 +417,7 @@ channelWait(TChannel * const channelP,
 static ChannelInterruptImpl channelInterrupt;
 
 static void
-channelInterrupt(TChannel * const channelP) {
+channelInterrupt(TChannel * const channelP ATTR_UNUSED) {
 /*----------------------------------------------------------------------------
   Interrupt any waiting that a thread might be doing in channelWait()
   now or in the future.
@@ -244,20 +428,37 @@ channelInterrupt(TChannel * const channelP) {
 
 
 
+static ChannelFormatPeerInfoImpl channelFormatPeerInfo;
+
+static void
+channelFormatPeerInfo(TChannel *    const channelP,
+                      const char ** const peerStringP) {
+
+    struct channelOpenssl * const channelOpensslP = channelP->implP;
+
+    SocketUnixFormatPeerInfo(SSL_get_fd(channelOpensslP->sslP), peerStringP);
+}
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
+    &channelWritev,
     &channelRead,
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    NULL,  /* No sendfile; the user reads the file and writes it */
+    NULL,  /* No abort; ChannelAbort() just interrupts waits */
+    NULL,  /* Can't tell whether the partner has gone away */
 };
 
 
 
 static void
 makeChannelInfo(struct abyss_openssl_chaninfo ** const channelInfoPP,
-                SSL *                            const sslP,
+                SSL *                            const sslP ATTR_UNUSED,
                 const char **                    const errorP) {
 
     struct abyss_openssl_chaninfo * channelInfoP;
@@ -291,9 +492,14 @@ makeChannelFromSsl(SSL *         const sslP,
     else {
         TChannel * channelP;
         
-        channelOpensslP->sslP = sslP;
-        channelOpensslP->userSuppliedSsl = TRUE;
-        
+        channelOpensslP->sslP             = sslP;
+        channelOpensslP->userSuppliedConn = TRUE;
+        channelOpensslP->handshakeDone    = TRUE;
+            /* If the user hasn't done it, OpenSSL does it implicitly on
+               the first read or write.
+            */
+        channelOpensslP->handshakeFailed  = FALSE;
+
         /* This should be ok as far as I can tell */
         ChannelCreate(&channelVtbl, channelOpensslP, &channelP);
         
@@ -321,7 +527,7 @@ ChannelOpensslCreateSsl(SSL *                            const sslP,
 
     makeChannelInfo(channelInfoPP, sslP, errorP);
     if (!*errorP) {
-        makeChannelFromSsl(ssl, channelPP, errorP);
+        makeChannelFromSsl(sslP, channelPP, errorP);
         
         if (*errorP) {
             free(*channelInfoPP);
@@ -352,15 +558,18 @@ struct opensslSwitch {
         /* The file descriptor and associated POSIX socket belong to the
            user; we did not create it.
         */
+    SSL_CTX * sslCtxP;
+        /* The OpenSSL context from which we make the SSL connection for
+           each accepted connection.  It holds the server's certificate and
+           its session cache.  It belongs to the user.  NULL means we
+           don't have one, so can't make connections.
+        */
 };
 
 
 
 static SwitchDestroyImpl chanSwitchDestroy;
 
-static void
-chanSwitchDestroy(TChanSwitch * const chanSwitchP) {
-
 static void
 chanSwitchDestroy(TChanSwitch * const chanSwitchP) {
 
@@ -403,6 +612,39 @@ chanSwitchListen(TChanSwitch * const chanSwitchP,
 
 
 
+static void
+acceptSsl(SSL_CTX *     const sslCtxP,
+          int           const acceptedFd,
+          SSL **        const sslPP,
+          const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Make an OpenSSL connection out of the just-accepted socket 'acceptedFd'.
+
+   We don't do the TLS handshake here; that waits for the first read or
+   write on the channel (see handshakeOk()), which happens in the thread
+   that serves the connection.  A client that connects and then says
+   nothing therefore doesn't keep us from accepting other connections.
+-----------------------------------------------------------------------------*/
+    if (!sslCtxP)
+        xmlrpc_asprintf(errorP, "Channel switch has no OpenSSL context.  "
+                        "Create it with ChanSwitchOpensslCreateCtx()");
+    else {
+        SSL * const sslP = SSL_new(sslCtxP);
+
+        if (!sslP)
+            xmlrpc_asprintf(errorP, "SSL_new() failed");
+        else {
+            SSL_set_fd(sslP, acceptedFd);
+            SSL_set_accept_state(sslP);
+
+            *sslPP = sslP;
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
 static SwitchAcceptImpl  chanSwitchAccept;
 
 static void
@@ -444,28 +686,42 @@ chanSwitchAccept(TChanSwitch * const chanSwitchP,
             if (!opensslChannelP)
                 xmlrpc_asprintf(errorP, "Unable to allocate memory");
             else {
-                struct abyss_openssl_chaninfo * channelInfoP;
-                
-                openChannelP->userSuppliedFd = FALSE;
-                TODO("turn connected socket 'acceptedFd' into an OpenSSL "
-                     "connection opensslChannelP->sslP");
-
-                makeChannelInfo(&channelInfoP, peerAddr, size, errorP);
-                if (!*errorP) {
-                    *channelInfoPP = channelInfoP;
-
-                    ChannelCreate(&channelVtbl, opensslChannelP, &channelP);
-                    if (!channelP)
-                        xmlrpc_asprintf(errorP,
-                                        "Failed to create TChannel object.");
-                    else
-                        *errorP = NULL;
-
-                    if (*errorP)
-                        free(channelInfoP);
-                }
-                if (*errorP)
+                const char * sslError;
+
+                opensslChannelP->userSuppliedConn = FALSE;
+                opensslChannelP->handshakeDone    = FALSE;
+                opensslChannelP->handshakeFailed  = FALSE;
+
+                acceptSsl(listenSocketP->sslCtxP, acceptedFd,
+                          &opensslChannelP->sslP, &sslError);
+
+                if (sslError) {
+                    *errorP = sslError;
                     free(opensslChannelP);
+                } else {
+                    struct abyss_openssl_chaninfo * channelInfoP;
+
+                    makeChannelInfo(&channelInfoP, opensslChannelP->sslP,
+                                    errorP);
+                    if (!*errorP) {
+                        *channelInfoPP = channelInfoP;
+
+                        ChannelCreate(&channelVtbl, opensslChannelP,
+                                      &channelP);
+                        if (!channelP)
+                            xmlrpc_asprintf(errorP, "Failed to create "
+                                            "TChannel object.");
+                        else
+                            *errorP = NULL;
+
+                        if (*errorP)
+                            free(channelInfoP);
+                    }
+                    if (*errorP) {
+                        SSL_free(opensslChannelP->sslP);
+                        free(opensslChannelP);
+                    }
+                }
             }
             if (*errorP)
                 close(acceptedFd);
@@ -483,7 +739,7 @@ chanSwitchAccept(TChanSwitch * const chanSwitchP,
 static SwitchInterruptImpl chanSwitchInterrupt;
 
 static void
-chanSwitchInterrupt(TChanSwitch * const chanSwitchP) {
+chanSwitchInterrupt(TChanSwitch * const chanSwitchP ATTR_UNUSED) {
 /*----------------------------------------------------------------------------
   Interrupt any waiting that a thread might be doing in chanSwitchAccept()
   now or in the future.
@@ -500,6 +756,7 @@ static struct TChanSwitchVtbl const chanSwitchVtbl = {
     &chanSwitchDestroy,
     &chanSwitchListen,
     &chanSwitchAccept,
+    &chanSwitchInterrupt,
 };
 
 
@@ -579,6 +836,7 @@ ChanSwitchOpensslCreate(unsigned short const portNumber,
         else {
             opensslSwitchP->fd = rc;
             opensslSwitchP->userSuppliedFd = FALSE;
+            opensslSwitchP->sslCtxP = NULL;
 
             setSocketOptions(opensslSwitchP->fd, errorP);
             if (!*errorP) {
@@ -623,6 +881,7 @@ ChanSwitchOpensslCreateFd(int            const fd,
 
             opensslSwitchP->fd = fd;
             opensslSwitchP->userSuppliedFd = TRUE;
+            opensslSwitchP->sslCtxP = NULL;
             
             ChanSwitchCreate(&chanSwitchVtbl, opensslSwitchP, &chanSwitchP);
 
@@ -638,3 +897,113 @@ ChanSwitchOpensslCreateFd(int            const fd,
         }
     }
 }
+
+
+
+static void
+setupSessionCache(SSL_CTX *                                  const sslCtxP,
+                  const struct abyss_openssl_session_parms * const parmsP,
+                  const char **                              const errorP) {
+/*----------------------------------------------------------------------------
+   Set up *sslCtxP to let clients resume earlier TLS sessions per *parmsP.
+
+   A resumed session needs an abbreviated handshake, with no certificate
+   exchange or public key operations, which is most of the CPU time of a
+   new connection.  There are two ways a client can resume: present a
+   session ID that is in our cache, or present a session ticket, which is
+   the session state we encrypted and gave to it.  The latter works even
+   if the client's reconnection goes to a different server process.
+-----------------------------------------------------------------------------*/
+    static unsigned char const sessionIdContext[] = "abyss";
+        /* OpenSSL won't resume a session it can't tell came from the same
+           kind of server, so we must name one.
+        */
+    int rc;
+
+    if (parmsP->cacheSize > 0) {
+        SSL_CTX_set_session_cache_mode(sslCtxP, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(sslCtxP, parmsP->cacheSize);
+    } else
+        SSL_CTX_set_session_cache_mode(sslCtxP, SSL_SESS_CACHE_OFF);
+
+    if (parmsP->timeout > 0)
+        SSL_CTX_set_timeout(sslCtxP, parmsP->timeout);
+
+    if (parmsP->tickets)
+        SSL_CTX_clear_options(sslCtxP, SSL_OP_NO_TICKET);
+    else
+        SSL_CTX_set_options(sslCtxP, SSL_OP_NO_TICKET);
+
+    rc = SSL_CTX_set_session_id_context(sslCtxP, sessionIdContext,
+                                        sizeof(sessionIdContext) - 1);
+
+    if (rc != 1)
+        xmlrpc_asprintf(errorP, "SSL_CTX_set_session_id_context() failed");
+    else
+        *errorP = NULL;
+}
+
+
+
+void
+ChanSwitchOpensslCreateCtx(
+    unsigned short                             const portNumber,
+    SSL_CTX *                                  const sslCtxP,
+    const struct abyss_openssl_session_parms * const sessParmsP,
+    TChanSwitch **                             const chanSwitchPP,
+    const char **                              const errorP) {
+/*----------------------------------------------------------------------------
+   Same as ChanSwitchOpensslCreate(), except the channel switch makes
+   TLS connections from OpenSSL context *sslCtxP, and we set up that
+   context's session resumption per *sessParmsP.
+
+   *sslCtxP, with the server's certificate and key already loaded, belongs
+   to Caller, who must not destroy it before the channel switch.
+-----------------------------------------------------------------------------*/
+    setupSessionCache(sslCtxP, sessParmsP, errorP);
+
+    if (!*errorP) {
+        ChanSwitchOpensslCreate(portNumber, chanSwitchPP, errorP);
+
+        if (!*errorP) {
+            struct opensslSwitch * const opensslSwitchP =
+                (*chanSwitchPP)->implP;
+
+            opensslSwitchP->sslCtxP = sslCtxP;
+        }
+    }
+}
+
+
+
+void
+ChanSwitchOpensslGetSessionStats(
+    TChanSwitch *                        const chanSwitchP,
+    struct abyss_openssl_session_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Report how well session resumption is working for the connections
+   accepted through OpenSSL channel switch *chanSwitchP.
+
+   These are the counters of the switch's OpenSSL context, so if the
+   context is shared, they include the other users' connections.
+-----------------------------------------------------------------------------*/
+    struct opensslSwitch * const opensslSwitchP = chanSwitchP->implP;
+
+    SSL_CTX * const sslCtxP = opensslSwitchP->sslCtxP;
+
+    if (sslCtxP) {
+        statsP->handshakes = SSL_CTX_sess_accept_good(sslCtxP);
+        statsP->hits       = SSL_CTX_sess_hits(sslCtxP);
+        statsP->misses     = SSL_CTX_sess_misses(sslCtxP);
+        statsP->timeouts   = SSL_CTX_sess_timeouts(sslCtxP);
+        statsP->cacheFull  = SSL_CTX_sess_cache_full(sslCtxP);
+        statsP->cached     = SSL_CTX_sess_number(sslCtxP);
+    } else {
+        statsP->handshakes = 0;
+        statsP->hits       = 0;
+        statsP->misses     = 0;
+        statsP->timeouts   = 0;
+        statsP->cacheFull  = 0;
+        statsP->cached     = 0;
+    }
+}
@@ -8,6 +8,9 @@
 
 #include "xmlrpc_config.h"
 
+#define _FILE_OFFSET_BITS 64
+    /* Tell GNU libc to make off_t 64 bits, for sendfile() and pread() */
+
 #include <stdlib.h>
 #include <assert.h>
 #include <sys/types.h>
@@ -16,7 +19,10 @@
 #include <poll.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
@@ -26,6 +32,13 @@
 #if HAVE_SYS_FILIO_H
   #include <sys/filio.h>
 #endif
+#ifdef __linux__
+  #include <sys/sendfile.h>
+#endif
+
+#ifndef MSG_MORE
+  #define MSG_MORE 0
+#endif
 
 #include "c_util.h"
 #include "int.h"
@@ -95,6 +108,11 @@ struct socketUnix {
         /* The file descriptor and associated POSIX socket belong to the
            user; we did not create it.
         */
+    const char * localPath;
+        /* The file system name of the Unix domain socket, which we created
+           and must remove when we destroy the socket.  NULL if there is no
+           such name (including every TChannel).
+        */
     interruptPipe interruptPipe;
 };
 
@@ -213,6 +231,98 @@ channelWrite(TChannel *            const channelP,
 
 
 
+static void
+traceWritev(ssize_t               const rc,
+            const TChannelIoVec * const iov,
+            unsigned int          const iovCt) {
+
+    if (rc < 0)
+        fprintf(stderr, "Abyss channel: writev() failed.  errno=%d (%s)",
+                errno, strerror(errno));
+    else if (rc == 0)
+        fprintf(stderr, "Abyss channel: writev() failed.  "
+                "Socket closed.\n");
+    else {
+        fprintf(stderr, "Abyss channel: sent %u bytes from %u segments\n",
+                (unsigned)rc, iovCt);
+        if (iovCt > 0)
+            fprintf(stderr, "Abyss channel: first segment: '%.*s'\n",
+                    (int)(MIN(iov[0].len, 4096)), iov[0].base);
+    }
+}
+
+
+
+static ChannelWritevImpl channelWritev;
+
+static void
+channelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   Write all of iov[] with as few writev() calls as possible -- usually one.
+   The kernel may send less than we ask, in which case we resume where it
+   left off, possibly in the middle of a segment.
+-----------------------------------------------------------------------------*/
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    unsigned int segment;
+        /* Index in iov[] of the first segment not yet completely sent */
+    uint32_t segmentSent;
+        /* Number of bytes of iov[segment] already sent */
+    bool error;
+
+    for (segment = 0, segmentSent = 0, error = FALSE;
+         segment < iovCt && !error;
+        ) {
+        struct iovec vec[16];
+        unsigned int vecCt;
+        ssize_t rc;
+
+        for (vecCt = 0;
+             vecCt < ARRAY_SIZE(vec) && segment + vecCt < iovCt;
+             ++vecCt) {
+            const TChannelIoVec * const segP = &iov[segment + vecCt];
+            uint32_t const skip = vecCt == 0 ? segmentSent : 0;
+
+            vec[vecCt].iov_base = (void *)(segP->base + skip);
+            vec[vecCt].iov_len  = segP->len - skip;
+        }
+        rc = writev(socketUnixP->fd, vec, vecCt);
+
+        if (ChannelTraceIsActive)
+            traceWritev(rc, &iov[segment], vecCt);
+
+        if (rc < 0)
+            error = TRUE;
+        else {
+            size_t bytesLeft;
+
+            /* Advance past what got sent.  Note that this also skips any
+               empty segments, so a return of zero from writev() means
+               the connection is closed only if there was something to send.
+            */
+            for (bytesLeft = rc;
+                 segment < iovCt && bytesLeft >= iov[segment].len - segmentSent;
+                ) {
+                bytesLeft -= iov[segment].len - segmentSent;
+                ++segment;
+                segmentSent = 0;
+            }
+            if (segment < iovCt)
+                segmentSent += bytesLeft;
+
+            if (rc == 0 && segment < iovCt)
+                /* Connection closed */
+                error = TRUE;
+        }
+    }
+    *failedP = error;
+}
+
+
+
 static ChannelReadImpl channelRead;
 
 static void
@@ -460,21 +570,19 @@ formatPeerInfoInet6(const struct sockaddr_in6 * const sockaddrIn6P,
 
 
 
-static ChannelFormatPeerInfoImpl channelFormatPeerInfo;
-
-static void
-channelFormatPeerInfo(TChannel *    const channelP,
-                      const char ** const peerStringP) {
-
-    struct socketUnix * const socketUnixP = channelP->implP;
-
+void
+SocketUnixFormatPeerInfo(int           const fd,
+                         const char ** const peerStringP) {
+/*----------------------------------------------------------------------------
+   Describe the peer of connected socket 'fd' in text, for messages.
+-----------------------------------------------------------------------------*/
     struct sockaddr sockaddr;
     socklen_t sockaddrLen;
     int rc;
 
     sockaddrLen = sizeof(sockaddr);
     
-    rc = getpeername(socketUnixP->fd, &sockaddr, &sockaddrLen);
+    rc = getpeername(fd, &sockaddr, &sockaddrLen);
     
     if (rc < 0)
         xmlrpc_asprintf(peerStringP, "?? getpeername() failed.  errno=%d (%s)",
@@ -491,6 +599,12 @@ channelFormatPeerInfo(TChannel *    const channelP,
                                 sockaddrLen,
                                 peerStringP);
             break;
+        case AF_UNIX:
+            /* A Unix domain client normally has no name, and the name of
+               the server end is the same for every connection.
+            */
+            xmlrpc_asprintf(peerStringP, "[local]");
+            break;
         default:
             xmlrpc_asprintf(peerStringP, "??? AF=%u", sockaddr.sa_family);
         }
@@ -499,13 +613,252 @@ channelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+static ChannelFormatPeerInfoImpl channelFormatPeerInfo;
+
+static void
+channelFormatPeerInfo(TChannel *    const channelP,
+                      const char ** const peerStringP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    SocketUnixFormatPeerInfo(socketUnixP->fd, peerStringP);
+}
+
+
+
+static void
+sendAll(int                   const sockFd,
+        const unsigned char * const buffer,
+        size_t                const len,
+        int                   const flags,
+        bool *                const failedP) {
+
+    size_t bytesLeft;
+    bool error;
+
+    for (bytesLeft = len, error = FALSE; bytesLeft > 0 && !error; ) {
+        ssize_t rc;
+
+        rc = send(sockFd, &buffer[len-bytesLeft], bytesLeft, flags);
+
+        if (rc <= 0)
+            /* 0 means connection closed; < 0 means severe error */
+            error = TRUE;
+        else
+            bytesLeft -= rc;
+    }
+    *failedP = error;
+}
+
+
+
+static void
+sendFileZeroCopy(int        const sockFd,
+                 int        const fileFd,
+                 uint64_t   const start,
+                 uint64_t   const len,
+                 uint64_t * const sentP,
+                 bool *     const failedP) {
+/*----------------------------------------------------------------------------
+   Send as much as we can of the 'len' bytes of file 'fileFd' at offset
+   'start' with sendfile(), and return as *sentP how much that is.
+
+   Less than 'len' without failure means sendfile() can't handle this file
+   (e.g. it is on a filesystem that doesn't support it).
+-----------------------------------------------------------------------------*/
+#ifdef __linux__
+    uint64_t sent;
+    bool error;
+    bool unsupported;
+
+    for (sent = 0, error = FALSE, unsupported = FALSE;
+         sent < len && !error && !unsupported;
+        ) {
+        size_t const maxSend = 1 << 30;
+        off_t offset = start + sent;
+        ssize_t rc;
+
+        rc = sendfile(sockFd, fileFd, &offset, MIN(maxSend, len - sent));
+
+        if (ChannelTraceIsActive) {
+            if (rc < 0)
+                fprintf(stderr, "Abyss channel: sendfile() failed.  "
+                        "errno=%d (%s)\n", errno, strerror(errno));
+            else
+                fprintf(stderr, "Abyss channel: sent %u bytes from file\n",
+                        (unsigned)rc);
+        }
+        if (rc < 0) {
+            if (errno == EINVAL || errno == ENOSYS)
+                unsupported = TRUE;
+            else
+                error = TRUE;
+        } else if (rc == 0)
+            /* The file is shorter than we thought */
+            error = TRUE;
+        else
+            sent += rc;
+    }
+    *sentP    = sent;
+    *failedP  = error;
+#else
+    *sentP   = 0;
+    *failedP = FALSE;
+#endif
+}
+
+
+
+static void
+sendFileByCopy(int      const sockFd,
+               int      const fileFd,
+               uint64_t const start,
+               uint64_t const len,
+               bool *   const failedP) {
+
+    uint64_t sent;
+    bool error;
+
+    for (sent = 0, error = FALSE; sent < len && !error; ) {
+        unsigned char buffer[16384];
+        ssize_t rc;
+
+        rc = pread(fileFd, buffer, MIN(sizeof(buffer), len - sent),
+                   start + sent);
+
+        if (rc <= 0)
+            error = TRUE;
+        else {
+            sendAll(sockFd, buffer, rc, 0, &error);
+            sent += rc;
+        }
+    }
+    *failedP = error;
+}
+
+
+
+void
+SocketUnixSendFile(int                   const sockFd,
+                   const unsigned char * const prefix,
+                   uint32_t              const prefixLen,
+                   int                   const fileFd,
+                   uint64_t              const start,
+                   uint64_t              const len,
+                   bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   Send the 'prefixLen' bytes at 'prefix', then 'len' bytes of open file
+   'fileFd' from offset 'start', on stream socket 'sockFd'.
+
+   Where the system has sendfile(), the file contents go from the kernel's
+   file cache to the socket without passing through our memory.  Otherwise,
+   we read the file a piece at a time and send what we read.  Either way, we
+   leave the file offset alone.
+-----------------------------------------------------------------------------*/
+    bool error;
+
+    if (prefixLen > 0)
+        /* MSG_MORE lets the prefix (typically an HTTP header) share a TCP
+           segment with the start of the file.
+        */
+        sendAll(sockFd, prefix, prefixLen, len > 0 ? MSG_MORE : 0, &error);
+    else
+        error = FALSE;
+
+    if (!error) {
+        uint64_t sent;
+
+        sendFileZeroCopy(sockFd, fileFd, start, len, &sent, &error);
+
+        if (!error && sent < len)
+            sendFileByCopy(sockFd, fileFd, start + sent, len - sent, &error);
+    }
+    *failedP = error;
+}
+
+
+
+static ChannelSendFileImpl channelSendFile;
+
+static void
+channelSendFile(TChannel *            const channelP,
+                const unsigned char * const prefix,
+                uint32_t              const prefixLen,
+                int                   const fd,
+                uint64_t              const start,
+                uint64_t              const len,
+                bool *                const failedP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    SocketUnixSendFile(socketUnixP->fd, prefix, prefixLen,
+                       fd, start, len, failedP);
+}
+
+
+
+static ChannelAbortImpl channelAbort;
+
+static void
+channelAbort(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   Shutting down the socket makes a send() or recv() blocked in another
+   thread return, and any later one fail.
+-----------------------------------------------------------------------------*/
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    shutdown(socketUnixP->fd, SHUT_RDWR);
+
+    channelInterrupt(channelP);
+}
+
+
+
+static ChannelPeerGoneImpl channelPeerGone;
+
+static bool
+channelPeerGone(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   The partner is gone if the socket has an error (e.g. the partner reset
+   the connection) or has hung up in both directions.
+
+   End of file alone doesn't count: a client may shut down its sending side
+   as soon as it has sent its request and still read the response.
+-----------------------------------------------------------------------------*/
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    struct pollfd pollfds[1];
+    bool gone;
+    int rc;
+
+    pollfds[0].fd      = socketUnixP->fd;
+    pollfds[0].events  = 0;  /* Error and hangup get reported anyway */
+    pollfds[0].revents = 0;
+
+    rc = poll(pollfds, ARRAY_SIZE(pollfds), 0);
+
+    gone = rc > 0 && (pollfds[0].revents & (POLLERR | POLLHUP | POLLNVAL));
+
+    if (ChannelTraceIsActive && gone)
+        fprintf(stderr, "Partner of channel on fd %d has gone away\n",
+                socketUnixP->fd);
+
+    return gone;
+}
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
+    &channelWritev,
     &channelRead,
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    &channelSendFile,
+    &channelAbort,
+    &channelPeerGone,
 };
 
 
@@ -550,6 +903,7 @@ makeChannelFromFd(int           const fd,
         
         socketUnixP->fd = fd;
         socketUnixP->userSuppliedFd = TRUE;
+        socketUnixP->localPath = NULL;
 
         initInterruptPipe(&socketUnixP->interruptPipe, errorP);
 
@@ -623,6 +977,10 @@ chanSwitchDestroy(TChanSwitch * const chanSwitchP) {
     if (!socketUnixP->userSuppliedFd)
         close(socketUnixP->fd);
 
+    if (socketUnixP->localPath) {
+        unlink(socketUnixP->localPath);
+        xmlrpc_strfree(socketUnixP->localPath);
+    }
     free(socketUnixP);
 }
 
@@ -641,10 +999,12 @@ chanSwitchListen(TChanSwitch * const chanSwitchP,
 
     int rc;
 
-    /* Disable the Nagle algorithm to make persistant connections faster */
-
-    setsockopt(socketUnixP->fd, IPPROTO_TCP, TCP_NODELAY,
-               &minus1, sizeof(minus1));
+    /* Disable the Nagle algorithm to make persistant connections faster.
+       A Unix domain socket has no Nagle algorithm.
+    */
+    if (!socketUnixP->localPath)
+        setsockopt(socketUnixP->fd, IPPROTO_TCP, TCP_NODELAY,
+                   &minus1, sizeof(minus1));
 
     rc = listen(socketUnixP->fd, backlog);
 
@@ -731,6 +1091,7 @@ createChannelForAccept(int             const acceptedFd,
         else {
             acceptedSocketP->fd = acceptedFd;
             acceptedSocketP->userSuppliedFd = FALSE;
+            acceptedSocketP->localPath = NULL;
 
             initInterruptPipe(&acceptedSocketP->interruptPipe, errorP);
 
@@ -847,8 +1208,14 @@ static struct TChanSwitchVtbl const chanSwitchVtbl = {
 static void
 createChanSwitch(int            const fd,
                  bool           const userSuppliedFd,
+                 const char *   const localPath,
                  TChanSwitch ** const chanSwitchPP,
                  const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   'localPath' is the file system name of the Unix domain socket 'fd', which
+   the channel switch is to remove when it is destroyed.  NULL if none.
+   We make our own copy of it.
+-----------------------------------------------------------------------------*/
 
     struct socketUnix * socketUnixP;
 
@@ -867,8 +1234,13 @@ createChanSwitch(int            const fd,
 
         socketUnixP->fd = fd;
         socketUnixP->userSuppliedFd = userSuppliedFd;
-            
-        initInterruptPipe(&socketUnixP->interruptPipe, errorP);
+        socketUnixP->localPath = xmlrpc_strdupnull(localPath);
+
+        if (localPath && !socketUnixP->localPath)
+            xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                            "socket name");
+        else
+            initInterruptPipe(&socketUnixP->interruptPipe, errorP);
 
         if (!*errorP) {
             ChanSwitchCreate(&chanSwitchVtbl, socketUnixP, &chanSwitchP);
@@ -883,8 +1255,10 @@ createChanSwitch(int            const fd,
                 *errorP = NULL;
             }
         }
-        if (*errorP)
+        if (*errorP) {
+            xmlrpc_strfreenull(socketUnixP->localPath);
             free(socketUnixP);
+        }
     }
 }
 
@@ -1032,7 +1406,8 @@ switchCreateIpV4Port(unsigned short          const portNumber,
 
             if (!*errorP) {
                 bool const userSupplied = false;
-                createChanSwitch(socketFd, userSupplied, chanSwitchPP, errorP);
+                createChanSwitch(socketFd, userSupplied, NULL,
+                                 chanSwitchPP, errorP);
             }
         }
         if (*errorP)
@@ -1063,7 +1438,8 @@ switchCreateIpV6Port(unsigned short          const portNumber,
 
             if (!*errorP) {
                 bool const userSupplied = false;
-                createChanSwitch(socketFd, userSupplied, chanSwitchPP, errorP);
+                createChanSwitch(socketFd, userSupplied, NULL,
+                                 chanSwitchPP, errorP);
             }
         }
         if (*errorP)
@@ -1108,7 +1484,8 @@ ChanSwitchUnixCreate2(int                     const protocolFamily,
 
             if (!*errorP) {
                 bool const userSupplied = false;
-                createChanSwitch(socketFd, userSupplied, chanSwitchPP, errorP);
+                createChanSwitch(socketFd, userSupplied, NULL,
+                                 chanSwitchPP, errorP);
             }
         }
         if (*errorP)
@@ -1140,7 +1517,143 @@ ChanSwitchUnixCreateFd(int            const fd,
                         "state.", fd);
     else {
         bool const userSupplied = true;
-        createChanSwitch(fd, userSupplied, chanSwitchPP, errorP);
+        createChanSwitch(fd, userSupplied, NULL, chanSwitchPP, errorP);
+    }
+}
+
+
+
+static void
+checkSocketIsStale(const char *  const path,
+                   const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Fail unless the Unix domain socket named 'path' is stale, i.e. nobody is
+   listening on it.  We find out by trying to connect to it.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(PF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+        xmlrpc_asprintf(errorP, "Unable to create a socket to check whether "
+                        "'%s' is in use.  socket() failed with errno %d (%s)",
+                        path, errno, strerror(errno));
+    else {
+        struct sockaddr_un name;
+        int rc;
+
+        memset(&name, 0, sizeof(name));
+        name.sun_family = AF_UNIX;
+        strcpy(name.sun_path, path);
+
+        rc = connect(fd, (struct sockaddr *)&name, sizeof(name));
+
+        if (rc == 0)
+            xmlrpc_asprintf(errorP, "Address in use: a server is listening "
+                            "on socket '%s'", path);
+        else if (errno == ECONNREFUSED || errno == ENOENT)
+            *errorP = NULL;
+        else
+            xmlrpc_asprintf(errorP, "Unable to tell whether socket '%s' is "
+                            "in use.  connect() failed with errno %d (%s)",
+                            path, errno, strerror(errno));
+        close(fd);
+    }
+}
+
+
+
+static void
+removeStaleSocket(const char *  const path,
+                  const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Remove the Unix domain socket named 'path', left over from an earlier
+   server, so we can bind a new one to that name.  Fail if 'path' names
+   something other than a socket or a server is still listening on it.  Do
+   nothing if it doesn't exist.
+-----------------------------------------------------------------------------*/
+    struct stat statBuf;
+    int rc;
+
+    rc = lstat(path, &statBuf);
+
+    if (rc != 0) {
+        if (errno == ENOENT)
+            *errorP = NULL;
+        else
+            xmlrpc_asprintf(errorP, "Unable to examine '%s'.  "
+                            "lstat() failed with errno %d (%s)",
+                            path, errno, strerror(errno));
+    } else {
+        if (!S_ISSOCK(statBuf.st_mode))
+            xmlrpc_asprintf(errorP, "'%s' exists and is not a socket",
+                            path);
+        else {
+            checkSocketIsStale(path, errorP);
+
+            if (!*errorP) {
+                rc = unlink(path);
+
+                if (rc != 0)
+                    xmlrpc_asprintf(errorP, "Unable to remove old socket "
+                                    "'%s'.  unlink() failed with errno %d (%s)",
+                                    path, errno, strerror(errno));
+            }
+        }
+    }
+}
+
+
+
+void
+ChanSwitchUnixCreateLocal(const char *   const path,
+                          TChanSwitch ** const chanSwitchPP,
+                          const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Create a POSIX-socket-based channel switch for a Unix domain (AF_UNIX)
+   endpoint with file system name 'path'.
+
+   If there is already a socket by that name (presumably left by a server
+   that died), we replace it.  We remove the socket from the file system
+   when the channel switch is destroyed.
+
+   A Unix domain socket avoids the TCP/IP stack, so it is the fastest way
+   for a client on the same system to reach the server.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_un name;
+
+    if (strlen(path) >= sizeof(name.sun_path))
+        xmlrpc_asprintf(errorP, "Socket name '%s' is too long.  "
+                        "Maximum is %u characters",
+                        path, (unsigned)sizeof(name.sun_path) - 1);
+    else {
+        removeStaleSocket(path, errorP);
+
+        if (!*errorP) {
+            int rc;
+            rc = socket(PF_UNIX, SOCK_STREAM, 0);
+            if (rc < 0)
+                xmlrpc_asprintf(errorP, "socket() failed with errno %d (%s)",
+                                errno, strerror(errno));
+            else {
+                int const socketFd = rc;
+
+                memset(&name, 0, sizeof(name));
+                name.sun_family = AF_UNIX;
+                strcpy(name.sun_path, path);
+
+                bindSocketToPort(socketFd, (struct sockaddr *)&name,
+                                 sizeof(name), errorP);
+
+                if (!*errorP) {
+                    bool const userSupplied = false;
+                    createChanSwitch(socketFd, userSupplied, path,
+                                     chanSwitchPP, errorP);
+                    if (*errorP)
+                        unlink(path);
+                }
+                if (*errorP)
+                    close(socketFd);
+            }
+        }
     }
 }
 
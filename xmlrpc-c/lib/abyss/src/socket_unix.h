@@ -3,6 +3,8 @@
 
 #include <sys/socket.h>
 
+#include "bool.h"
+#include "int.h"
 #include <xmlrpc-c/abyss.h>
 
 void
@@ -11,4 +13,17 @@ SocketUnixInit(const char ** const errorP);
 void
 SocketUnixTerm(void);
 
+void
+SocketUnixFormatPeerInfo(int           const fd,
+                         const char ** const peerStringP);
+
+void
+SocketUnixSendFile(int                   const sockFd,
+                   const unsigned char * const prefix,
+                   uint32_t              const prefixLen,
+                   int                   const fileFd,
+                   uint64_t              const start,
+                   uint64_t              const len,
+                   bool *                const failedP);
+
 #endif
@@ -0,0 +1,1962 @@
+/*=============================================================================
+                                 socket_uring.c
+===============================================================================
+  This is an implementation of TChanSwitch and TChannel for a POSIX stream
+  socket, like the one in socket_unix.c, except that it does its I/O through
+  a Linux io_uring instead of with a system call per operation.
+
+  The channel switch accepts connections with a multishot accept, so a single
+  submission keeps delivering connections until we destroy the switch.
+
+  A channel has its own small ring.  That fits the way Abyss works a
+  connection -- one thread or process doing blocking calls -- and means a
+  channel works the same whether the server forks or makes threads.  Every
+  channel operation submits its entries and waits for their completion in a
+  single io_uring_enter().  A read goes into a buffer registered with the
+  ring, so the kernel does not have to map the caller's buffer for every
+  read.  A write of a response header and body is one IORING_OP_WRITEV.
+
+  When the running kernel does not have io_uring, or it lacks something we
+  need, or it is disabled, we use ordinary system calls and epoll instead.
+  Environment variable ABYSS_DISABLE_IO_URING forces that.
+
+  On a system other than Linux, the constructors just make an ordinary Unix
+  channel switch.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+
+#ifdef __linux__
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <poll.h>
+  #if defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+      #include <linux/io_uring.h>
+    #endif
+  #endif
+  #if defined(IORING_FEAT_FAST_POLL) && defined(__NR_io_uring_setup)
+    #define HAVE_IO_URING 1
+  #endif
+#endif
+
+#ifndef HAVE_IO_URING
+  #define HAVE_IO_URING 0
+#endif
+
+#include "c_util.h"
+#include "int.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "mallocvar.h"
+#include "trace.h"
+#include "chanswitch.h"
+#include "channel.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "socket_unix.h"
+
+
+#ifdef __linux__
+
+#define CHANNEL_RING_ENTRIES 8
+    /* Size of a channel's submission queue.  A channel operation never has
+       more than 6 entries in flight.
+    */
+#define SWITCH_RING_ENTRIES 16
+    /* Size of a channel switch's submission queue.  The completion queue is
+       twice as big, which bounds how many accepted connections one
+       io_uring_enter() can deliver.
+    */
+#define ACCEPT_QUEUE_SIZE (2 * SWITCH_RING_ENTRIES)
+
+#define READ_BUFFER_SIZE 4096
+    /* Size of a channel's registered read buffer.  Abyss never reads more
+       than what is left of a connection buffer (BUFFER_SIZE in conn.h) at a
+       time; a bigger read just returns less than the caller asked for.
+    */
+
+
+#if HAVE_IO_URING
+
+static bool
+uringDisabled(void) {
+/*----------------------------------------------------------------------------
+   The user asked us not to use io_uring even if the kernel has it.
+-----------------------------------------------------------------------------*/
+    return !!getenv("ABYSS_DISABLE_IO_URING");
+}
+
+
+
+/*=============================================================================
+      The io_uring instance, through raw system calls
+=============================================================================*/
+
+struct uring {
+    int fd;
+    unsigned int   sqEntries;
+    unsigned int * sqHeadP;
+    unsigned int * sqTailP;
+    unsigned int   sqMask;
+    unsigned int * sqArray;
+    struct io_uring_sqe * sqes;
+    unsigned int   sqeTail;
+        /* Tail of the submission queue including entries we have filled in
+           but not yet told the kernel about
+        */
+    unsigned int   submittedTail;
+        /* Tail of the submission queue as the kernel has consumed it */
+    unsigned int * cqHeadP;
+    unsigned int * cqTailP;
+    unsigned int   cqMask;
+    struct io_uring_cqe * cqes;
+    void * sqRingMem;
+    size_t sqRingSize;
+    void * cqRingMem;
+    size_t cqRingSize;
+    size_t sqesSize;
+};
+
+
+
+static void
+mapRing(struct uring *                 const ringP,
+        const struct io_uring_params * const paramsP,
+        const char **                  const errorP) {
+
+    ringP->sqRingSize = paramsP->sq_off.array +
+        paramsP->sq_entries * sizeof(unsigned int);
+    ringP->cqRingSize = paramsP->cq_off.cqes +
+        paramsP->cq_entries * sizeof(struct io_uring_cqe);
+    ringP->sqesSize = paramsP->sq_entries * sizeof(struct io_uring_sqe);
+
+    ringP->sqRingMem = mmap(NULL, ringP->sqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ringP->fd,
+                            IORING_OFF_SQ_RING);
+    if (ringP->sqRingMem == MAP_FAILED)
+        xmlrpc_asprintf(errorP, "Failed to map io_uring submission queue.  "
+                        "errno=%d (%s)", errno, strerror(errno));
+    else {
+        ringP->cqRingMem = mmap(NULL, ringP->cqRingSize,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ringP->fd,
+                                IORING_OFF_CQ_RING);
+        if (ringP->cqRingMem == MAP_FAILED)
+            xmlrpc_asprintf(errorP, "Failed to map io_uring completion "
+                            "queue.  errno=%d (%s)", errno, strerror(errno));
+        else {
+            ringP->sqes = mmap(NULL, ringP->sqesSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ringP->fd,
+                               IORING_OFF_SQES);
+            if (ringP->sqes == MAP_FAILED)
+                xmlrpc_asprintf(errorP, "Failed to map io_uring submission "
+                                "queue entries.  errno=%d (%s)",
+                                errno, strerror(errno));
+            else {
+                char * const sq = ringP->sqRingMem;
+                char * const cq = ringP->cqRingMem;
+
+                ringP->sqEntries = paramsP->sq_entries;
+                ringP->sqHeadP   = (unsigned int *)(sq + paramsP->sq_off.head);
+                ringP->sqTailP   = (unsigned int *)(sq + paramsP->sq_off.tail);
+                ringP->sqMask    =
+                    *(unsigned int *)(sq + paramsP->sq_off.ring_mask);
+                ringP->sqArray   =
+                    (unsigned int *)(sq + paramsP->sq_off.array);
+                ringP->sqeTail   = *ringP->sqTailP;
+                ringP->submittedTail = ringP->sqeTail;
+
+                ringP->cqHeadP   = (unsigned int *)(cq + paramsP->cq_off.head);
+                ringP->cqTailP   = (unsigned int *)(cq + paramsP->cq_off.tail);
+                ringP->cqMask    =
+                    *(unsigned int *)(cq + paramsP->cq_off.ring_mask);
+                ringP->cqes      =
+                    (struct io_uring_cqe *)(cq + paramsP->cq_off.cqes);
+
+                *errorP = NULL;
+            }
+            if (*errorP)
+                munmap(ringP->cqRingMem, ringP->cqRingSize);
+        }
+        if (*errorP)
+            munmap(ringP->sqRingMem, ringP->sqRingSize);
+    }
+}
+
+
+
+static void
+uringInit(struct uring * const ringP,
+          unsigned int   const entries,
+          const char **  const errorP) {
+
+    struct io_uring_params params;
+    long rc;
+
+    memset(&params, 0, sizeof(params));
+
+    rc = syscall(__NR_io_uring_setup, entries, &params);
+
+    if (rc < 0)
+        xmlrpc_asprintf(errorP, "io_uring_setup() failed.  errno=%d (%s)",
+                        errno, strerror(errno));
+    else {
+        ringP->fd = rc;
+
+        /* Without fast poll, the kernel does every socket operation that
+           can't complete immediately in a worker thread, which would make
+           this slower than plain system calls.
+        */
+        if (!(params.features & IORING_FEAT_FAST_POLL))
+            xmlrpc_asprintf(errorP, "Kernel's io_uring is too old "
+                            "(has no fast poll)");
+        else
+            mapRing(ringP, &params, errorP);
+
+        if (*errorP)
+            close(ringP->fd);
+    }
+}
+
+
+
+static void
+uringTerm(struct uring * const ringP) {
+
+    munmap(ringP->sqes, ringP->sqesSize);
+    munmap(ringP->cqRingMem, ringP->cqRingSize);
+    munmap(ringP->sqRingMem, ringP->sqRingSize);
+    close(ringP->fd);
+}
+
+
+
+static bool
+uringHasOps(const struct uring * const ringP) {
+/*----------------------------------------------------------------------------
+   The kernel supports all the io_uring operations we use.
+-----------------------------------------------------------------------------*/
+    static unsigned char const neededOps[] = {
+        IORING_OP_ACCEPT, IORING_OP_READ_FIXED, IORING_OP_RECV,
+        IORING_OP_WRITEV, IORING_OP_POLL_ADD, IORING_OP_TIMEOUT,
+        IORING_OP_ASYNC_CANCEL
+    };
+    unsigned int const opCt = 256;
+
+    struct io_uring_probe * probeP;
+    bool retval;
+
+    probeP = calloc(1, sizeof(*probeP) + opCt * sizeof(probeP->ops[0]));
+
+    if (!probeP)
+        retval = FALSE;
+    else {
+        long rc;
+
+        rc = syscall(__NR_io_uring_register, ringP->fd, IORING_REGISTER_PROBE,
+                     probeP, opCt);
+
+        if (rc < 0)
+            retval = FALSE;
+        else {
+            unsigned int i;
+
+            for (i = 0, retval = TRUE; i < ARRAY_SIZE(neededOps); ++i) {
+                unsigned int const op = neededOps[i];
+
+                if (op > probeP->last_op ||
+                    !(probeP->ops[op].flags & IO_URING_OP_SUPPORTED))
+                    retval = FALSE;
+            }
+        }
+        free(probeP);
+    }
+    return retval;
+}
+
+
+
+static struct io_uring_sqe *
+uringNewSqe(struct uring * const ringP) {
+/*----------------------------------------------------------------------------
+   The next free submission queue entry, cleared.  NULL if the queue is full.
+-----------------------------------------------------------------------------*/
+    unsigned int const head = __atomic_load_n(ringP->sqHeadP, __ATOMIC_ACQUIRE);
+
+    struct io_uring_sqe * sqeP;
+
+    if (ringP->sqeTail - head >= ringP->sqEntries)
+        sqeP = NULL;
+    else {
+        unsigned int const index = ringP->sqeTail & ringP->sqMask;
+
+        sqeP = &ringP->sqes[index];
+        memset(sqeP, 0, sizeof(*sqeP));
+        ringP->sqArray[index] = index;
+        ++ringP->sqeTail;
+    }
+    return sqeP;
+}
+
+
+
+static void
+uringEnter(struct uring * const ringP,
+           bool           const wait,
+           bool *         const interruptedP,
+           const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Submit all the entries we have filled in and, if 'wait' is true, wait
+   for at least one completion.
+
+   Return *interruptedP true if a signal interrupted the wait.
+-----------------------------------------------------------------------------*/
+    unsigned int const toSubmit = ringP->sqeTail - ringP->submittedTail;
+
+    long rc;
+
+    __atomic_store_n(ringP->sqTailP, ringP->sqeTail, __ATOMIC_RELEASE);
+
+    rc = syscall(__NR_io_uring_enter, ringP->fd, toSubmit, wait ? 1 : 0,
+                 wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+    if (rc < 0) {
+        if (errno == EINTR) {
+            *interruptedP = TRUE;
+            *errorP = NULL;
+        } else
+            xmlrpc_asprintf(errorP, "io_uring_enter() failed.  errno=%d (%s)",
+                            errno, strerror(errno));
+    } else {
+        ringP->submittedTail += rc;
+        *interruptedP = FALSE;
+        *errorP = NULL;
+    }
+}
+
+
+
+static bool
+uringNextCqe(struct uring *        const ringP,
+             struct io_uring_cqe * const cqeP) {
+/*----------------------------------------------------------------------------
+   Take the next completion off the completion queue, if there is one.
+-----------------------------------------------------------------------------*/
+    unsigned int const head = *ringP->cqHeadP;
+    unsigned int const tail = __atomic_load_n(ringP->cqTailP, __ATOMIC_ACQUIRE);
+
+    bool retval;
+
+    if (head == tail)
+        retval = FALSE;
+    else {
+        *cqeP = ringP->cqes[head & ringP->cqMask];
+
+        __atomic_store_n(ringP->cqHeadP, head + 1, __ATOMIC_RELEASE);
+
+        retval = TRUE;
+    }
+    return retval;
+}
+
+
+
+static void
+prepCancel(struct io_uring_sqe * const sqeP,
+           uint64_t              const target,
+           uint64_t              const userData) {
+
+    sqeP->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqeP->fd        = -1;
+    sqeP->addr      = target;
+    sqeP->user_data = userData;
+}
+
+#endif  /* HAVE_IO_URING */
+
+
+
+static int
+newEventFd(const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   An eventfd to use to interrupt waits.  Once something writes to it, it
+   stays readable forever, because we never read it.
+-----------------------------------------------------------------------------*/
+    int rc;
+
+    rc = eventfd(0, EFD_CLOEXEC);
+
+    if (rc < 0)
+        xmlrpc_asprintf(errorP, "Unable to create an eventfd to use to "
+                        "interrupt waits.  eventfd() failed with "
+                        "errno %d (%s)", errno, strerror(errno));
+    else
+        *errorP = NULL;
+
+    return rc;
+}
+
+
+
+static void
+signalEventFd(int const eventFd) {
+
+    uint64_t const one = 1;
+
+    write(eventFd, &one, sizeof(one));
+}
+
+
+
+static int
+newEpoll(int           const fd1,
+         uint32_t      const events1,
+         int           const fd2,
+         const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   An epoll instance watching 'fd1' for 'events1' and 'fd2' for readability.
+-----------------------------------------------------------------------------*/
+    int epollFd;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epollFd < 0)
+        xmlrpc_asprintf(errorP, "epoll_create1() failed.  errno=%d (%s)",
+                        errno, strerror(errno));
+    else {
+        struct epoll_event event;
+        int rc;
+
+        memset(&event, 0, sizeof(event));
+        event.events  = events1;
+        event.data.fd = fd1;
+
+        rc = epoll_ctl(epollFd, EPOLL_CTL_ADD, fd1, &event);
+
+        if (rc == 0) {
+            event.events  = EPOLLIN;
+            event.data.fd = fd2;
+
+            rc = epoll_ctl(epollFd, EPOLL_CTL_ADD, fd2, &event);
+        }
+        if (rc < 0) {
+            xmlrpc_asprintf(errorP, "epoll_ctl() failed.  errno=%d (%s)",
+                            errno, strerror(errno));
+            close(epollFd);
+        } else
+            *errorP = NULL;
+    }
+    return epollFd;
+}
+
+
+
+/*=============================================================================
+      TChannel
+=============================================================================*/
+
+struct channelUring {
+/*----------------------------------------------------------------------------
+   The properties/state of a TChannel unique to the io_uring variety.
+-----------------------------------------------------------------------------*/
+    int fd;
+        /* File descriptor of the connected socket */
+    int interruptFd;
+        /* eventfd that becomes readable when someone interrupts us */
+    bool haveRing;
+        /* We do our I/O through 'ring'.  Otherwise, we use system calls
+           and 'epollFd'.
+        */
+#if HAVE_IO_URING
+    struct uring ring;
+    unsigned char * readBuffer;
+        /* Buffer registered with 'ring' (fixed buffer 0) for reads.  NULL
+           if we couldn't register one, in which case we read directly into
+           the caller's buffer.
+        */
+    uint64_t opSeq;
+        /* Sequence number of the current operation.  It is in the high bits
+           of the user data of each entry we submit, so a completion left
+           over from an earlier operation can't be taken for one of the
+           current operation.
+        */
+#endif
+    int epollFd;
+        /* epoll instance watching 'fd' and 'interruptFd'.  Meaningful only
+           if we have no ring.
+        */
+};
+
+
+
+static void
+channelDestroy(TChannel * const channelP) {
+
+    struct channelUring * const chanP = channelP->implP;
+
+#if HAVE_IO_URING
+    if (chanP->haveRing) {
+        uringTerm(&chanP->ring);
+        if (chanP->readBuffer)
+            free(chanP->readBuffer);
+    }
+#endif
+    if (!chanP->haveRing)
+        close(chanP->epollFd);
+
+    close(chanP->interruptFd);
+    close(chanP->fd);
+
+    free(chanP);
+}
+
+
+
+#if HAVE_IO_URING
+
+enum opTag {
+    /* Identifies the submission to which a completion belongs; it is the
+       low bits of the user data.
+    */
+    TAG_IO, TAG_POLL, TAG_INTERRUPT, TAG_TIMEOUT, TAG_CANCEL, TAG_CT
+};
+
+
+
+static uint64_t
+userData(struct channelUring * const chanP,
+         enum opTag            const tag) {
+
+    return (chanP->opSeq << 8) | tag;
+}
+
+
+
+static bool
+cqeIsCurrent(const struct channelUring * const chanP,
+             const struct io_uring_cqe * const cqeP,
+             enum opTag *                const tagP) {
+
+    bool const retval = (cqeP->user_data >> 8) == chanP->opSeq &&
+        (cqeP->user_data & 0xff) < TAG_CT;
+
+    if (retval)
+        *tagP = cqeP->user_data & 0xff;
+
+    return retval;
+}
+
+
+
+static void
+ringDoIo(struct channelUring * const chanP,
+         int *                 const resultP,
+         const char **         const errorP) {
+/*----------------------------------------------------------------------------
+   Submit the I/O entry that Caller has filled in (the one tagged TAG_IO of
+   the current operation) and wait for it to complete.
+
+   We don't give up when a signal interrupts the wait, because the I/O
+   would still be in progress; we just wait some more.
+-----------------------------------------------------------------------------*/
+    bool done;
+
+    for (done = FALSE, *errorP = NULL; !done && !*errorP; ) {
+        bool interrupted;
+
+        uringEnter(&chanP->ring, TRUE, &interrupted, errorP);
+
+        if (!*errorP) {
+            struct io_uring_cqe cqe;
+
+            while (!done && uringNextCqe(&chanP->ring, &cqe)) {
+                enum opTag tag;
+
+                if (cqeIsCurrent(chanP, &cqe, &tag) && tag == TAG_IO) {
+                    *resultP = cqe.res;
+                    done = TRUE;
+                }
+            }
+        }
+    }
+    ++chanP->opSeq;
+}
+
+
+
+static void
+ringWritev(struct channelUring * const chanP,
+           const struct iovec *  const vec,
+           unsigned int          const vecCt,
+           ssize_t *             const rcP) {
+/*----------------------------------------------------------------------------
+   Like writev(): return the number of bytes written as *rcP, or -1 with
+   errno set.
+-----------------------------------------------------------------------------*/
+    struct io_uring_sqe * const sqeP = uringNewSqe(&chanP->ring);
+
+    const char * error;
+    int result;
+
+    assert(sqeP);  /* Every operation completes before the next starts */
+
+    sqeP->opcode    = IORING_OP_WRITEV;
+    sqeP->fd        = chanP->fd;
+    sqeP->addr      = (uintptr_t)vec;
+    sqeP->len       = vecCt;
+    sqeP->user_data = userData(chanP, TAG_IO);
+
+    ringDoIo(chanP, &result, &error);
+
+    if (error) {
+        if (ChannelTraceIsActive)
+            fprintf(stderr, "Abyss channel: %s\n", error);
+        xmlrpc_strfree(error);
+        errno = EIO;
+        *rcP = -1;
+    } else if (result < 0) {
+        errno = -result;
+        *rcP = -1;
+    } else
+        *rcP = result;
+}
+
+
+
+static void
+ringRead(struct channelUring * const chanP,
+         unsigned char *       const buffer,
+         uint32_t              const bufferSize,
+         ssize_t *             const rcP) {
+/*----------------------------------------------------------------------------
+   Like recv(): return the number of bytes read as *rcP, or -1 with errno
+   set.
+-----------------------------------------------------------------------------*/
+    struct io_uring_sqe * const sqeP = uringNewSqe(&chanP->ring);
+
+    const char * error;
+    int result;
+
+    assert(sqeP);
+
+    sqeP->fd        = chanP->fd;
+    sqeP->user_data = userData(chanP, TAG_IO);
+
+    if (chanP->readBuffer) {
+        sqeP->opcode    = IORING_OP_READ_FIXED;
+        sqeP->addr      = (uintptr_t)chanP->readBuffer;
+        sqeP->len       = MIN(bufferSize, READ_BUFFER_SIZE);
+        sqeP->buf_index = 0;
+    } else {
+        sqeP->opcode    = IORING_OP_RECV;
+        sqeP->addr      = (uintptr_t)buffer;
+        sqeP->len       = bufferSize;
+    }
+    ringDoIo(chanP, &result, &error);
+
+    if (error) {
+        if (ChannelTraceIsActive)
+            fprintf(stderr, "Abyss channel: %s\n", error);
+        xmlrpc_strfree(error);
+        errno = EIO;
+        *rcP = -1;
+    } else if (result < 0) {
+        errno = -result;
+        *rcP = -1;
+    } else {
+        if (chanP->readBuffer)
+            memcpy(buffer, chanP->readBuffer, result);
+        *rcP = result;
+    }
+}
+
+
+
+static void
+ringWait(struct channelUring * const chanP,
+         short                 const events,
+         uint32_t              const timeoutMs,
+         bool *                const readyToReadP,
+         bool *                const readyToWriteP,
+         bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   channelWait() for a channel with a ring.
+
+   We submit a poll of the socket, a poll of the interrupt eventfd, and
+   (unless the wait is infinite) a timeout all at once.  When the first of
+   them completes, we cancel the others and collect all their completions,
+   so the ring is empty again when we return.
+-----------------------------------------------------------------------------*/
+    struct __kernel_timespec timeout;
+    bool pending[TAG_CT];
+        /* pending[tag] means the entry with that tag has not completed */
+    unsigned int pendingCt;
+        /* Number of entries, including cancels, not completed */
+    bool decided;
+        /* We have stopped waiting and are just cleaning up */
+    bool canceled;
+        /* We have submitted cancels for the entries still pending */
+    bool readyToRead, readyToWrite, failed;
+    struct io_uring_sqe * sqeP;
+    unsigned int tag;
+
+    for (tag = 0; tag < TAG_CT; ++tag)
+        pending[tag] = FALSE;
+
+    sqeP = uringNewSqe(&chanP->ring);
+    sqeP->opcode      = IORING_OP_POLL_ADD;
+    sqeP->fd          = chanP->fd;
+    sqeP->poll_events = events;
+    sqeP->user_data   = userData(chanP, TAG_POLL);
+    pending[TAG_POLL] = TRUE;
+
+    sqeP = uringNewSqe(&chanP->ring);
+    sqeP->opcode      = IORING_OP_POLL_ADD;
+    sqeP->fd          = chanP->interruptFd;
+    sqeP->poll_events = POLLIN;
+    sqeP->user_data   = userData(chanP, TAG_INTERRUPT);
+    pending[TAG_INTERRUPT] = TRUE;
+
+    if (timeoutMs != TIME_INFINITE) {
+        timeout.tv_sec  = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000;
+
+        sqeP = uringNewSqe(&chanP->ring);
+        sqeP->opcode    = IORING_OP_TIMEOUT;
+        sqeP->fd        = -1;
+        sqeP->addr      = (uintptr_t)&timeout;
+        sqeP->len       = 1;
+        sqeP->user_data = userData(chanP, TAG_TIMEOUT);
+        pending[TAG_TIMEOUT] = TRUE;
+    }
+    pendingCt = pending[TAG_TIMEOUT] ? 3 : 2;
+
+    readyToRead = readyToWrite = failed = decided = canceled = FALSE;
+
+    while (pendingCt > 0) {
+        const char * error;
+        bool interrupted;
+        struct io_uring_cqe cqe;
+
+        uringEnter(&chanP->ring, TRUE, &interrupted, &error);
+
+        if (error) {
+            /* The ring is unusable; we can't even clean up */
+            if (ChannelTraceIsActive)
+                fprintf(stderr, "Abyss channel: %s\n", error);
+            xmlrpc_strfree(error);
+            failed = TRUE;
+            break;
+        }
+        if (interrupted)
+            /* Same as poll() getting EINTR: not ready, not failed */
+            decided = TRUE;
+
+        while (uringNextCqe(&chanP->ring, &cqe)) {
+            enum opTag cqeTag;
+
+            if (cqeIsCurrent(chanP, &cqe, &cqeTag)) {
+                --pendingCt;
+                pending[cqeTag] = FALSE;
+
+                if (cqeTag == TAG_POLL) {
+                    if (cqe.res >= 0) {
+                        readyToRead  = !!(cqe.res & POLLIN);
+                        readyToWrite = !!(cqe.res & POLLOUT);
+                    } else if (cqe.res != -ECANCELED)
+                        failed = TRUE;
+                }
+                if (cqeTag != TAG_CANCEL)
+                    decided = TRUE;
+            }
+        }
+        if (decided && !canceled) {
+            for (tag = TAG_POLL; tag <= TAG_TIMEOUT; ++tag) {
+                if (pending[tag]) {
+                    prepCancel(uringNewSqe(&chanP->ring),
+                               userData(chanP, tag),
+                               userData(chanP, TAG_CANCEL));
+                    ++pendingCt;
+                }
+            }
+            canceled = TRUE;
+        }
+    }
+    ++chanP->opSeq;
+
+    if (failedP)
+        *failedP       = failed;
+    if (readyToReadP)
+        *readyToReadP  = readyToRead;
+    if (readyToWriteP)
+        *readyToWriteP = readyToWrite;
+}
+
+#endif  /* HAVE_IO_URING */
+
+
+
+static void
+doWritev(struct channelUring * const chanP,
+         const struct iovec *  const vec,
+         unsigned int          const vecCt,
+         ssize_t *             const rcP) {
+
+#if HAVE_IO_URING
+    if (chanP->haveRing)
+        ringWritev(chanP, vec, vecCt, rcP);
+    else
+#endif
+        *rcP = writev(chanP->fd, vec, vecCt);
+}
+
+
+
+static ChannelWritevImpl channelWritev;
+
+static void
+channelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   Write all of iov[], usually as a single submission (or writev()).  The
+   kernel may send less than we ask, in which case we resume where it left
+   off, possibly in the middle of a segment.
+-----------------------------------------------------------------------------*/
+    struct channelUring * const chanP = channelP->implP;
+
+    unsigned int segment;
+        /* Index in iov[] of the first segment not yet completely sent */
+    uint32_t segmentSent;
+        /* Number of bytes of iov[segment] already sent */
+    bool error;
+
+    for (segment = 0, segmentSent = 0, error = FALSE;
+         segment < iovCt && !error;
+        ) {
+        struct iovec vec[16];
+        unsigned int vecCt;
+        ssize_t rc;
+
+        for (vecCt = 0;
+             vecCt < ARRAY_SIZE(vec) && segment + vecCt < iovCt;
+             ++vecCt) {
+            const TChannelIoVec * const segP = &iov[segment + vecCt];
+            uint32_t const skip = vecCt == 0 ? segmentSent : 0;
+
+            vec[vecCt].iov_base = (void *)(segP->base + skip);
+            vec[vecCt].iov_len  = segP->len - skip;
+        }
+        doWritev(chanP, vec, vecCt, &rc);
+
+        if (ChannelTraceIsActive) {
+            if (rc < 0)
+                fprintf(stderr, "Abyss channel: write failed.  "
+                        "errno=%d (%s)\n", errno, strerror(errno));
+            else
+                fprintf(stderr, "Abyss channel: sent %u bytes from "
+                        "%u segments\n", (unsigned)rc, vecCt);
+        }
+        if (rc < 0)
+            error = TRUE;
+        else {
+            size_t bytesLeft;
+
+            /* Advance past what got sent; see socket_unix.c */
+            for (bytesLeft = rc;
+                 segment < iovCt && bytesLeft >= iov[segment].len - segmentSent;
+                ) {
+                bytesLeft -= iov[segment].len - segmentSent;
+                ++segment;
+                segmentSent = 0;
+            }
+            if (segment < iovCt)
+                segmentSent += bytesLeft;
+
+            if (rc == 0 && segment < iovCt)
+                /* Connection closed */
+                error = TRUE;
+        }
+    }
+    *failedP = error;
+}
+
+
+
+static ChannelWriteImpl channelWrite;
+
+static void
+channelWrite(TChannel *            const channelP,
+             const unsigned char * const buffer,
+             uint32_t              const len,
+             bool *                const failedP) {
+
+    TChannelIoVec iov[1];
+
+    iov[0].base = buffer;
+    iov[0].len  = len;
+
+    channelWritev(channelP, iov, 1, failedP);
+}
+
+
+
+static ChannelReadImpl channelRead;
+
+static void
+channelRead(TChannel *      const channelP,
+            unsigned char * const buffer,
+            uint32_t        const bufferSize,
+            uint32_t *      const bytesReceivedP,
+            bool *          const failedP) {
+
+    struct channelUring * const chanP = channelP->implP;
+
+    ssize_t rc;
+
+#if HAVE_IO_URING
+    if (chanP->haveRing)
+        ringRead(chanP, buffer, bufferSize, &rc);
+    else
+#endif
+        rc = recv(chanP->fd, buffer, bufferSize, 0);
+
+    if (rc < 0) {
+        *failedP = TRUE;
+        if (ChannelTraceIsActive)
+            fprintf(stderr, "Abyss channel: "
+                    "Failed to receive data from socket.  "
+                    "errno %d (%s)\n", errno, strerror(errno));
+    } else {
+        *failedP = FALSE;
+        *bytesReceivedP = rc;
+
+        if (ChannelTraceIsActive)
+            fprintf(stderr, "Abyss channel: read %u bytes: '%.*s'\n",
+                    *bytesReceivedP, (int)(*bytesReceivedP), buffer);
+    }
+}
+
+
+
+static void
+epollWait(struct channelUring * const chanP,
+          uint32_t              const events,
+          uint32_t              const timeoutMs,
+          bool *                const readyToReadP,
+          bool *                const readyToWriteP,
+          bool *                const failedP) {
+
+    struct epoll_event event;
+    int rc;
+
+    memset(&event, 0, sizeof(event));
+    event.events  = events;
+    event.data.fd = chanP->fd;
+
+    rc = epoll_ctl(chanP->epollFd, EPOLL_CTL_MOD, chanP->fd, &event);
+
+    if (rc < 0)
+        *failedP = TRUE;
+    else {
+        struct epoll_event ready[2];
+
+        *readyToReadP  = FALSE;
+        *readyToWriteP = FALSE;
+
+        rc = epoll_wait(chanP->epollFd, ready, ARRAY_SIZE(ready),
+                        timeoutMs == TIME_INFINITE ? -1 : (int)timeoutMs);
+
+        if (rc < 0)
+            *failedP = (errno != EINTR);
+        else {
+            unsigned int i;
+
+            for (i = 0; i < (unsigned)rc; ++i) {
+                if (ready[i].data.fd == chanP->fd) {
+                    *readyToReadP  = !!(ready[i].events & EPOLLIN);
+                    *readyToWriteP = !!(ready[i].events & EPOLLOUT);
+                }
+            }
+            *failedP = FALSE;
+        }
+    }
+}
+
+
+
+static ChannelWaitImpl channelWait;
+
+static void
+channelWait(TChannel * const channelP,
+            bool       const waitForRead,
+            bool       const waitForWrite,
+            uint32_t   const timeoutMs,
+            bool *     const readyToReadP,
+            bool *     const readyToWriteP,
+            bool *     const failedP) {
+/*----------------------------------------------------------------------------
+   Same as for socket_unix.c, including that we return early, neither ready
+   nor failed, when a signal interrupts the wait.
+-----------------------------------------------------------------------------*/
+    struct channelUring * const chanP = channelP->implP;
+
+    bool readyToRead, readyToWrite, failed;
+
+#if HAVE_IO_URING
+    if (chanP->haveRing)
+        ringWait(chanP,
+                 (waitForRead ? POLLIN : 0) | (waitForWrite ? POLLOUT : 0),
+                 timeoutMs, &readyToRead, &readyToWrite, &failed);
+    else
+#endif
+        epollWait(chanP,
+                  (waitForRead ? EPOLLIN : 0) | (waitForWrite ? EPOLLOUT : 0),
+                  timeoutMs, &readyToRead, &readyToWrite, &failed);
+
+    if (failed) {
+        readyToRead  = FALSE;
+        readyToWrite = FALSE;
+    }
+    if (failedP)
+        *failedP       = failed;
+    if (readyToReadP)
+        *readyToReadP  = readyToRead;
+    if (readyToWriteP)
+        *readyToWriteP = readyToWrite;
+}
+
+
+
+static ChannelInterruptImpl channelInterrupt;
+
+static void
+channelInterrupt(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+  Interrupt any waiting that a thread might be doing in channelWait()
+  now or in the future.
+-----------------------------------------------------------------------------*/
+    struct channelUring * const chanP = channelP->implP;
+
+    signalEventFd(chanP->interruptFd);
+}
+
+
+
+static ChannelFormatPeerInfoImpl channelFormatPeerInfo;
+
+static void
+channelFormatPeerInfo(TChannel *    const channelP,
+                      const char ** const peerStringP) {
+
+    struct channelUring * const chanP = channelP->implP;
+
+    SocketUnixFormatPeerInfo(chanP->fd, peerStringP);
+}
+
+
+
+static ChannelSendFileImpl channelSendFile;
+
+static void
+channelSendFile(TChannel *            const channelP,
+                const unsigned char * const prefix,
+                uint32_t              const prefixLen,
+                int                   const fd,
+                uint64_t              const start,
+                uint64_t              const len,
+                bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   The ring has no sendfile operation (a splice through a pipe is the
+   nearest thing), and sendfile() on a blocking socket already does what we
+   want without the copy, so we just use it.
+-----------------------------------------------------------------------------*/
+    struct channelUring * const chanP = channelP->implP;
+
+    SocketUnixSendFile(chanP->fd, prefix, prefixLen, fd, start, len, failedP);
+}
+
+
+
+static ChannelAbortImpl channelAbort;
+
+static void
+channelAbort(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   Shutting down the socket completes any receive or send in progress,
+   whether in the ring or in the kernel's socket calls, and makes any later
+   one fail.
+-----------------------------------------------------------------------------*/
+    struct channelUring * const chanP = channelP->implP;
+
+    shutdown(chanP->fd, SHUT_RDWR);
+
+    signalEventFd(chanP->interruptFd);
+}
+
+
+
+static struct TChannelVtbl const channelVtbl = {
+    &channelDestroy,
+    &channelWrite,
+    &channelWritev,
+    &channelRead,
+    &channelWait,
+    &channelInterrupt,
+    &channelFormatPeerInfo,
+    &channelSendFile,
+    &channelAbort,    NULL,  /* Can't tell whether the partner has gone away */
+};
+
+
+
+#if HAVE_IO_URING
+
+static void
+registerReadBuffer(struct channelUring * const chanP) {
+/*----------------------------------------------------------------------------
+   Register a read buffer with the channel's ring if we can.  Registered
+   buffers count against the process' locked memory limit, so this can
+   fail when there are many connections; then we just do without.
+-----------------------------------------------------------------------------*/
+    chanP->readBuffer = malloc(READ_BUFFER_SIZE);
+
+    if (chanP->readBuffer) {
+        struct iovec iov;
+        long rc;
+
+        iov.iov_base = chanP->readBuffer;
+        iov.iov_len  = READ_BUFFER_SIZE;
+
+        rc = syscall(__NR_io_uring_register, chanP->ring.fd,
+                     IORING_REGISTER_BUFFERS, &iov, 1);
+
+        if (rc < 0) {
+            if (ChannelTraceIsActive)
+                fprintf(stderr, "Abyss channel: could not register read "
+                        "buffer.  errno=%d (%s)\n", errno, strerror(errno));
+            free(chanP->readBuffer);
+            chanP->readBuffer = NULL;
+        }
+    }
+}
+
+#endif
+
+
+
+static void
+createChannel(int             const fd,
+              bool            const tryRing,
+              TChannel **     const channelPP,
+              const char **   const errorP) {
+/*----------------------------------------------------------------------------
+   Make a channel for connected socket 'fd'.  If 'tryRing', do its I/O
+   through a ring of its own if we can make one; otherwise, or if we can't,
+   use system calls.
+-----------------------------------------------------------------------------*/
+    struct channelUring * chanP;
+
+    MALLOCVAR(chanP);
+
+    if (!chanP)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for io_uring "
+                        "channel descriptor");
+    else {
+        chanP->fd = fd;
+        chanP->interruptFd = newEventFd(errorP);
+
+        if (!*errorP) {
+            chanP->haveRing = FALSE;
+#if HAVE_IO_URING
+            if (tryRing) {
+                const char * ringError;
+
+                uringInit(&chanP->ring, CHANNEL_RING_ENTRIES, &ringError);
+
+                if (ringError) {
+                    if (ChannelTraceIsActive)
+                        fprintf(stderr, "Abyss channel: using system calls "
+                                "because we could not set up an io_uring.  "
+                                "%s\n", ringError);
+                    xmlrpc_strfree(ringError);
+                } else {
+                    chanP->haveRing = TRUE;
+                    chanP->opSeq = 0;
+                    registerReadBuffer(chanP);
+                }
+            }
+#endif
+            if (!chanP->haveRing)
+                chanP->epollFd = newEpoll(fd, 0, chanP->interruptFd, errorP);
+
+            if (!*errorP) {
+                TChannel * channelP;
+
+                ChannelCreate(&channelVtbl, chanP, &channelP);
+
+                if (!channelP)
+                    xmlrpc_asprintf(errorP, "Failed to create TChannel "
+                                    "object.");
+                else {
+                    *channelPP = channelP;
+                    *errorP = NULL;
+                }
+                if (*errorP) {
+#if HAVE_IO_URING
+                    if (chanP->haveRing) {
+                        uringTerm(&chanP->ring);
+                        if (chanP->readBuffer)
+                            free(chanP->readBuffer);
+                    }
+#endif
+                    if (!chanP->haveRing)
+                        close(chanP->epollFd);
+                }
+            }
+            if (*errorP)
+                close(chanP->interruptFd);
+        }
+        if (*errorP)
+            free(chanP);
+    }
+}
+
+
+
+static void
+createChannelForAccept(int             const acceptedFd,
+                       bool            const tryRing,
+                       TChannel **     const channelPP,
+                       void **         const channelInfoPP,
+                       const char **   const errorP) {
+/*----------------------------------------------------------------------------
+   Make a channel and channel info, the same as the Unix channel switch
+   makes, for socket 'acceptedFd' just accepted.
+-----------------------------------------------------------------------------*/
+    struct abyss_unix_chaninfo * channelInfoP;
+
+    MALLOCVAR(channelInfoP);
+
+    if (!channelInfoP)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory");
+    else {
+        socklen_t peerAddrLen;
+        int rc;
+
+        peerAddrLen = sizeof(channelInfoP->peerAddr);
+
+        rc = getpeername(acceptedFd, &channelInfoP->peerAddr, &peerAddrLen);
+
+        if (rc < 0)
+            xmlrpc_asprintf(errorP, "getpeername() failed on accepted "
+                            "socket.  errno=%d (%s)", errno, strerror(errno));
+        else {
+            channelInfoP->peerAddrLen = peerAddrLen;
+
+            createChannel(acceptedFd, tryRing, channelPP, errorP);
+
+            if (!*errorP)
+                *channelInfoPP = channelInfoP;
+        }
+        if (*errorP)
+            free(channelInfoP);
+    }
+}
+
+
+
+/*=============================================================================
+      TChanSwitch
+=============================================================================*/
+
+struct chanSwitchUring {
+/*----------------------------------------------------------------------------
+   The properties/state of a TChanSwitch unique to the io_uring variety.
+-----------------------------------------------------------------------------*/
+    int fd;
+        /* File descriptor of the listening socket */
+    bool userSuppliedFd;
+        /* The socket belongs to the user; we did not create it */
+    int interruptFd;
+        /* eventfd that becomes readable when someone interrupts us */
+    bool interrupted;
+        /* We have seen 'interruptFd' become readable */
+    bool haveRing;
+        /* We accept through 'ring'.  Otherwise, we use accept() and
+           'epollFd'.
+        */
+#if HAVE_IO_URING
+    struct uring ring;
+    bool acceptArmed;
+        /* There is an accept in the ring, so connections may arrive on the
+           completion queue.
+        */
+    bool interruptArmed;
+        /* There is a poll of 'interruptFd' in the ring */
+    bool multishot;
+        /* The kernel does multishot accept, so an accept submission stays
+           armed after it delivers a connection.
+        */
+    int acceptedFd[ACCEPT_QUEUE_SIZE];
+        /* Connections the kernel has accepted that we have not made into
+           channels yet.  A circular queue.
+        */
+    unsigned int acceptedHead;
+    unsigned int acceptedCt;
+    pid_t ringPid;
+        /* The process that set up 'ring'.  A child process that inherits
+           the switch (a pre-fork worker) shares the ring's memory with that
+           process, so must set up its own before using it.
+        */
+#endif
+    int epollFd;
+        /* epoll instance watching 'fd' and 'interruptFd'.  Meaningful only
+           if we have no ring.
+        */
+};
+
+enum switchTag {SWTAG_ACCEPT = 1, SWTAG_INTERRUPT, SWTAG_CANCEL};
+
+
+
+#if HAVE_IO_URING
+
+static void
+drainAcceptQueue(struct chanSwitchUring * const switchP) {
+
+    for (; switchP->acceptedCt > 0; --switchP->acceptedCt) {
+        close(switchP->acceptedFd[switchP->acceptedHead]);
+        switchP->acceptedHead =
+            (switchP->acceptedHead + 1) % ACCEPT_QUEUE_SIZE;
+    }
+}
+
+
+
+static void
+reapSwitchCqes(struct chanSwitchUring * const switchP,
+               const char **            const errorP) {
+/*----------------------------------------------------------------------------
+   Process whatever completions are on the channel switch's completion
+   queue, as long as we have room to hold accepted connections.
+-----------------------------------------------------------------------------*/
+    struct io_uring_cqe cqe;
+
+    *errorP = NULL;
+
+    while (switchP->acceptedCt < ACCEPT_QUEUE_SIZE && !*errorP &&
+           uringNextCqe(&switchP->ring, &cqe)) {
+        switch (cqe.user_data) {
+        case SWTAG_ACCEPT: {
+#ifdef IORING_CQE_F_MORE
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+                switchP->acceptArmed = FALSE;
+#else
+            switchP->acceptArmed = FALSE;
+#endif
+            if (cqe.res >= 0) {
+                unsigned int const tail =
+                    (switchP->acceptedHead + switchP->acceptedCt) %
+                    ACCEPT_QUEUE_SIZE;
+                switchP->acceptedFd[tail] = cqe.res;
+                ++switchP->acceptedCt;
+            } else if (cqe.res == -EINVAL && switchP->multishot) {
+                /* Kernel too old for multishot accept */
+                switchP->multishot = FALSE;
+            } else if (cqe.res == -ECANCELED || cqe.res == -ECONNABORTED ||
+                       cqe.res == -EINTR) {
+                /* Just try again */
+            } else
+                xmlrpc_asprintf(errorP, "accept failed, errno = %d (%s)",
+                                -cqe.res, strerror(-cqe.res));
+        } break;
+        case SWTAG_INTERRUPT:
+            switchP->interruptArmed = FALSE;
+            if (cqe.res >= 0)
+                switchP->interrupted = TRUE;
+            break;
+        default:
+            /* A cancel; nothing to do */
+            break;
+        }
+    }
+}
+
+
+
+static void
+armSwitchRing(struct chanSwitchUring * const switchP) {
+
+    if (!switchP->acceptArmed) {
+        struct io_uring_sqe * const sqeP = uringNewSqe(&switchP->ring);
+
+        if (sqeP) {
+            sqeP->opcode    = IORING_OP_ACCEPT;
+            sqeP->fd        = switchP->fd;
+            sqeP->user_data = SWTAG_ACCEPT;
+#ifdef IORING_ACCEPT_MULTISHOT
+            if (switchP->multishot)
+                sqeP->ioprio = IORING_ACCEPT_MULTISHOT;
+#endif
+            switchP->acceptArmed = TRUE;
+        }
+    }
+    if (!switchP->interruptArmed) {
+        struct io_uring_sqe * const sqeP = uringNewSqe(&switchP->ring);
+
+        if (sqeP) {
+            sqeP->opcode      = IORING_OP_POLL_ADD;
+            sqeP->fd          = switchP->interruptFd;
+            sqeP->poll_events = POLLIN;
+            sqeP->user_data   = SWTAG_INTERRUPT;
+
+            switchP->interruptArmed = TRUE;
+        }
+    }
+}
+
+
+
+static void
+ringAccept(struct chanSwitchUring * const switchP,
+           int *                    const acceptedFdP,
+           bool *                   const interruptedP,
+           const char **            const errorP) {
+/*----------------------------------------------------------------------------
+   Get the next connection the ring accepts, waiting for one if necessary.
+-----------------------------------------------------------------------------*/
+    bool gotOne;
+
+    for (gotOne = FALSE, *interruptedP = FALSE, *errorP = NULL;
+         !gotOne && !*interruptedP && !*errorP; ) {
+
+        if (switchP->acceptedCt > 0) {
+            *acceptedFdP = switchP->acceptedFd[switchP->acceptedHead];
+            switchP->acceptedHead =
+                (switchP->acceptedHead + 1) % ACCEPT_QUEUE_SIZE;
+            --switchP->acceptedCt;
+            gotOne = TRUE;
+        } else if (switchP->interrupted)
+            *interruptedP = TRUE;
+        else {
+            armSwitchRing(switchP);
+
+            uringEnter(&switchP->ring, TRUE, interruptedP, errorP);
+
+            if (!*errorP)
+                reapSwitchCqes(switchP, errorP);
+        }
+    }
+}
+
+
+
+static void
+ringStopAccepting(struct chanSwitchUring * const switchP) {
+/*----------------------------------------------------------------------------
+   Cancel the accept and wait for its last completion, so the kernel can't
+   accept a connection we'd never hear about.  Close any connection it
+   accepted that we haven't made a channel for.
+-----------------------------------------------------------------------------*/
+    if (switchP->acceptArmed) {
+        struct io_uring_sqe * sqeP;
+
+        sqeP = uringNewSqe(&switchP->ring);
+        if (sqeP) {
+            const char * error;
+
+            prepCancel(sqeP, SWTAG_ACCEPT, SWTAG_CANCEL);
+
+            for (error = NULL; switchP->acceptArmed && !error; ) {
+                bool interrupted;
+
+                drainAcceptQueue(switchP);
+
+                uringEnter(&switchP->ring, TRUE, &interrupted, &error);
+                if (!error)
+                    reapSwitchCqes(switchP, &error);
+            }
+            if (error)
+                xmlrpc_strfree(error);
+        }
+    }
+    drainAcceptQueue(switchP);
+}
+
+#endif  /* HAVE_IO_URING */
+
+
+
+static SwitchDestroyImpl chanSwitchDestroy;
+
+static void
+chanSwitchDestroy(TChanSwitch * const chanSwitchP) {
+
+    struct chanSwitchUring * const switchP = chanSwitchP->implP;
+
+#if HAVE_IO_URING
+    if (switchP->haveRing) {
+        ringStopAccepting(switchP);
+        uringTerm(&switchP->ring);
+    }
+#endif
+    if (!switchP->haveRing)
+        close(switchP->epollFd);
+
+    close(switchP->interruptFd);
+
+    if (!switchP->userSuppliedFd)
+        close(switchP->fd);
+
+    free(switchP);
+}
+
+
+
+static SwitchListenImpl chanSwitchListen;
+
+static void
+chanSwitchListen(TChanSwitch * const chanSwitchP,
+                 uint32_t      const backlog,
+                 const char ** const errorP) {
+
+    struct chanSwitchUring * const switchP = chanSwitchP->implP;
+
+    int32_t const minus1 = -1;
+
+    int rc;
+
+    /* Disable the Nagle algorithm to make persistant connections faster.
+       This fails harmlessly on a Unix domain socket.
+    */
+    setsockopt(switchP->fd, IPPROTO_TCP, TCP_NODELAY,
+               &minus1, sizeof(minus1));
+
+    rc = listen(switchP->fd, backlog);
+
+    if (rc == -1)
+        xmlrpc_asprintf(errorP, "listen() failed with errno %d (%s)",
+                        errno, strerror(errno));
+    else
+        *errorP = NULL;
+}
+
+
+
+static void
+epollAccept(struct chanSwitchUring * const switchP,
+            int *                    const acceptedFdP,
+            bool *                   const interruptedP,
+            const char **            const errorP) {
+
+    struct epoll_event ready[2];
+    int rc;
+
+    rc = epoll_wait(switchP->epollFd, ready, ARRAY_SIZE(ready), -1);
+
+    *interruptedP = FALSE;
+    *errorP = NULL;
+
+    if (rc < 0) {
+        if (errno == EINTR)
+            *interruptedP = TRUE;
+        else
+            xmlrpc_asprintf(errorP, "epoll_wait() failed, errno = %d (%s)",
+                            errno, strerror(errno));
+    } else {
+        bool connectionReady;
+        unsigned int i;
+
+        for (i = 0, connectionReady = FALSE; i < (unsigned)rc; ++i) {
+            if (ready[i].data.fd == switchP->interruptFd)
+                switchP->interrupted = TRUE;
+            else
+                connectionReady = TRUE;
+        }
+        if (switchP->interrupted || !connectionReady)
+            *interruptedP = TRUE;
+        else {
+            rc = accept(switchP->fd, NULL, NULL);
+
+            if (rc >= 0)
+                *acceptedFdP = rc;
+            else if (errno == EINTR)
+                *interruptedP = TRUE;
+            else
+                xmlrpc_asprintf(errorP, "accept() failed, errno = %d (%s)",
+                                errno, strerror(errno));
+        }
+    }
+}
+
+
+
+static void
+setupSwitchIo(struct chanSwitchUring * const switchP,
+              const char **            const errorP) {
+/*----------------------------------------------------------------------------
+   Set up the ring through which the channel switch will accept connections
+   or, if we can't use io_uring, the epoll instance.
+-----------------------------------------------------------------------------*/
+    switchP->haveRing = FALSE;
+
+#if HAVE_IO_URING
+    if (!uringDisabled()) {
+        const char * ringError;
+
+        uringInit(&switchP->ring, SWITCH_RING_ENTRIES, &ringError);
+
+        if (!ringError && !uringHasOps(&switchP->ring)) {
+            uringTerm(&switchP->ring);
+            xmlrpc_asprintf(&ringError, "Kernel's io_uring lacks operations "
+                            "we need");
+        }
+        if (ringError) {
+            if (SwitchTraceIsActive)
+                fprintf(stderr, "Abyss channel switch: using epoll because "
+                        "we can't use io_uring.  %s\n", ringError);
+            xmlrpc_strfree(ringError);
+        } else {
+            switchP->haveRing       = TRUE;
+            switchP->acceptArmed    = FALSE;
+            switchP->interruptArmed = FALSE;
+            switchP->multishot      = TRUE;
+            switchP->acceptedHead   = 0;
+            switchP->acceptedCt     = 0;
+            switchP->ringPid        = getpid();
+        }
+    }
+#endif
+    if (switchP->haveRing)
+        *errorP = NULL;
+    else
+        switchP->epollFd = newEpoll(switchP->fd, EPOLLIN,
+                                    switchP->interruptFd, errorP);
+}
+
+
+
+#if HAVE_IO_URING
+
+static void
+leaveInheritedRing(struct chanSwitchUring * const switchP,
+                   const char **            const errorP) {
+/*----------------------------------------------------------------------------
+   We are a child of the process that set up the switch's ring.  Give up
+   our share of that ring, without disturbing the parent's use of it, and
+   set up our own.
+-----------------------------------------------------------------------------*/
+    /* Our copies of connections the parent accepted; the parent serves
+       them.
+    */
+    drainAcceptQueue(switchP);
+
+    uringTerm(&switchP->ring);
+
+    setupSwitchIo(switchP, errorP);
+}
+
+#endif
+
+
+
+static SwitchAcceptImpl chanSwitchAccept;
+
+static void
+chanSwitchAccept(TChanSwitch * const chanSwitchP,
+                 TChannel **   const channelPP,
+                 void **       const channelInfoPP,
+                 const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Accept a connection via the channel switch *chanSwitchP.  Return as
+   *channelPP the channel for the accepted connection.
+
+   If no connection is waiting at *chanSwitchP, wait until one is.
+
+   If we receive a signal while waiting, or someone interrupts the switch,
+   return immediately with *channelPP == NULL.
+-----------------------------------------------------------------------------*/
+    struct chanSwitchUring * const switchP = chanSwitchP->implP;
+
+    bool interrupted;
+    TChannel * channelP;
+
+    interrupted = FALSE; /* Haven't been interrupted yet */
+    channelP    = NULL;  /* No connection yet */
+    *errorP     = NULL;  /* No error yet */
+
+#if HAVE_IO_URING
+    if (switchP->haveRing && switchP->ringPid != getpid())
+        leaveInheritedRing(switchP, errorP);
+#endif
+
+    while (!channelP && !*errorP && !interrupted) {
+        int acceptedFd;
+
+#if HAVE_IO_URING
+        if (switchP->haveRing)
+            ringAccept(switchP, &acceptedFd, &interrupted, errorP);
+        else
+#endif
+            epollAccept(switchP, &acceptedFd, &interrupted, errorP);
+
+        if (!*errorP && !interrupted) {
+            createChannelForAccept(acceptedFd, switchP->haveRing,
+                                   &channelP, channelInfoPP, errorP);
+
+            if (*errorP)
+                close(acceptedFd);
+        }
+    }
+    *channelPP = channelP;
+}
+
+
+
+static SwitchInterruptImpl chanSwitchInterrupt;
+
+static void
+chanSwitchInterrupt(TChanSwitch * const chanSwitchP) {
+/*----------------------------------------------------------------------------
+  Interrupt any waiting that a thread might be doing in chanSwitchAccept()
+  now or in the future.
+-----------------------------------------------------------------------------*/
+    struct chanSwitchUring * const switchP = chanSwitchP->implP;
+
+    signalEventFd(switchP->interruptFd);
+}
+
+
+
+static struct TChanSwitchVtbl const chanSwitchVtbl = {
+    &chanSwitchDestroy,
+    &chanSwitchListen,
+    &chanSwitchAccept,
+    &chanSwitchInterrupt,
+};
+
+
+
+static void
+createChanSwitch(int            const fd,
+                 bool           const userSuppliedFd,
+                 TChanSwitch ** const chanSwitchPP,
+                 const char **  const errorP) {
+
+    struct chanSwitchUring * switchP;
+
+    if (SwitchTraceIsActive)
+        fprintf(stderr, "Creating io_uring listen-socket based "
+                "channel switch\n");
+
+    MALLOCVAR(switchP);
+
+    if (switchP == NULL)
+        xmlrpc_asprintf(errorP, "unable to allocate memory for io_uring "
+                        "channel switch descriptor.");
+    else {
+        switchP->fd             = fd;
+        switchP->userSuppliedFd = userSuppliedFd;
+        switchP->interrupted    = FALSE;
+        switchP->interruptFd    = newEventFd(errorP);
+
+        if (!*errorP) {
+            setupSwitchIo(switchP, errorP);
+
+            if (!*errorP) {
+                TChanSwitch * chanSwitchP;
+
+                ChanSwitchCreate(&chanSwitchVtbl, switchP, &chanSwitchP);
+
+                if (chanSwitchP == NULL)
+                    xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                                    "channel switch descriptor");
+                else {
+                    *chanSwitchPP = chanSwitchP;
+                    *errorP = NULL;
+                }
+                if (*errorP) {
+#if HAVE_IO_URING
+                    if (switchP->haveRing)
+                        uringTerm(&switchP->ring);
+#endif
+                    if (!switchP->haveRing)
+                        close(switchP->epollFd);
+                }
+            }
+            if (*errorP)
+                close(switchP->interruptFd);
+        }
+        if (*errorP)
+            free(switchP);
+    }
+}
+
+
+
+static void
+createBoundSocket(int                     const protocolFamily,
+                  const struct sockaddr * const sockAddrP,
+                  socklen_t               const sockAddrLen,
+                  int *                   const fdP,
+                  const char **           const errorP) {
+
+    int rc;
+
+    rc = socket(protocolFamily, SOCK_STREAM, 0);
+
+    if (rc < 0)
+        xmlrpc_asprintf(errorP, "socket() failed with errno %d (%s)",
+                        errno, strerror(errno));
+    else {
+        int const fd = rc;
+        int32_t const one = 1;
+
+        rc = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (rc < 0)
+            xmlrpc_asprintf(errorP, "Failed to set socket options.  "
+                            "setsockopt() failed with errno %d (%s)",
+                            errno, strerror(errno));
+        else {
+            rc = bind(fd, sockAddrP, sockAddrLen);
+
+            if (rc < 0)
+                xmlrpc_asprintf(errorP, "Unable to bind socket "
+                                "to the socket address.  "
+                                "bind() failed with errno %d (%s)",
+                                errno, strerror(errno));
+            else {
+                *fdP = fd;
+                *errorP = NULL;
+            }
+        }
+        if (*errorP)
+            close(fd);
+    }
+}
+
+
+
+void
+ChanSwitchUringCreate2(int                     const protocolFamily,
+                       const struct sockaddr * const sockAddrP,
+                       socklen_t               const sockAddrLen,
+                       TChanSwitch **          const chanSwitchPP,
+                       const char **           const errorP) {
+/*----------------------------------------------------------------------------
+   Create a channel switch, like ChanSwitchUnixCreate2(), that does its work
+   through io_uring if the kernel lets it, and epoll otherwise.
+-----------------------------------------------------------------------------*/
+    int fd;
+
+    createBoundSocket(protocolFamily, sockAddrP, sockAddrLen, &fd, errorP);
+
+    if (!*errorP) {
+        bool const userSupplied = FALSE;
+
+        createChanSwitch(fd, userSupplied, chanSwitchPP, errorP);
+
+        if (*errorP)
+            close(fd);
+    }
+}
+
+
+
+void
+ChanSwitchUringCreateFd(int            const fd,
+                        TChanSwitch ** const chanSwitchPP,
+                        const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Like ChanSwitchUnixCreateFd(), for the io_uring variety.
+-----------------------------------------------------------------------------*/
+    bool const userSupplied = TRUE;
+
+    createChanSwitch(fd, userSupplied, chanSwitchPP, errorP);
+}
+
+
+
+abyss_bool
+ChanSwitchUringUsesUring(TChanSwitch * const chanSwitchP) {
+/*----------------------------------------------------------------------------
+   The channel switch, which must be one of ours, and the channels it makes
+   do their I/O through io_uring, as opposed to having fallen back to epoll.
+-----------------------------------------------------------------------------*/
+    struct chanSwitchUring * const switchP = chanSwitchP->implP;
+
+    return switchP->haveRing;
+}
+
+
+
+#else  /* __linux__ */
+
+void
+ChanSwitchUringCreate2(int                     const protocolFamily,
+                       const struct sockaddr * const sockAddrP,
+                       socklen_t               const sockAddrLen,
+                       TChanSwitch **          const chanSwitchPP,
+                       const char **           const errorP) {
+
+    ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen,
+                          chanSwitchPP, errorP);
+}
+
+
+
+void
+ChanSwitchUringCreateFd(int            const fd,
+                        TChanSwitch ** const chanSwitchPP,
+                        const char **  const errorP) {
+
+    ChanSwitchUnixCreateFd(fd, chanSwitchPP, errorP);
+}
+
+
+
+abyss_bool
+ChanSwitchUringUsesUring(TChanSwitch * const chanSwitchP) {
+
+    return FALSE;
+}
+
+#endif  /* __linux__ */
+
+
+
+void
+ChanSwitchUringCreate(unsigned short const portNumber,
+                      TChanSwitch ** const chanSwitchPP,
+                      const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Like ChanSwitchUnixCreate(), for the io_uring variety.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_in sockAddr;
+
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.sin_family      = AF_INET;
+    sockAddr.sin_port        = htons(portNumber);
+    sockAddr.sin_addr.s_addr = INADDR_ANY;
+
+    ChanSwitchUringCreate2(PF_INET, (const struct sockaddr *)&sockAddr,
+                           sizeof(sockAddr), chanSwitchPP, errorP);
+}
@@ -560,10 +560,13 @@ channelFormatPeerInfo(TChannel *    const channelP,
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
+    NULL,  /* No gather write; ChannelWritev() uses channelWrite() */
     &channelRead,
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    NULL,  /* No sendfile; the user reads the file and writes it */
+    NULL,  /* No abort; ChannelAbort() just interrupts waits */    NULL,  /* Can't tell whether the partner has gone away */
 };
 
 
@@ -0,0 +1,265 @@
+/*=============================================================================
+                                 timerwheel.c
+===============================================================================
+  A hierarchical timer wheel.  See timerwheel.h.
+=============================================================================*/
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+
+#include "timerwheel.h"
+
+#define SLOT_BITS 6
+#define SLOT_CT (1 << SLOT_BITS)
+#define SLOT_MASK (SLOT_CT - 1)
+#define LEVEL_CT 4
+
+#define MAX_DELTA ((((uint64_t)1) << (SLOT_BITS * LEVEL_CT)) - 1)
+    /* The farthest in the future we can place a timer.  A timer that
+       expires later than this just gets placed again when we get there.
+    */
+
+struct TTimerWheel {
+    uint64_t current;
+        /* The latest tick we have processed */
+    unsigned int runningCt;
+        /* Number of timers in the wheel */
+    TTimer slot[LEVEL_CT][SLOT_CT];
+        /* Each is the head of a circular list of timers.  Slot 's' of
+           level 'l' has the timers that expire in the block of ticks whose
+           number, in units of SLOT_CT^l ticks, is 's' modulo SLOT_CT.
+        */
+};
+
+
+
+void
+TimerWheelCreate(uint64_t       const now,
+                 TTimerWheel ** const wheelPP,
+                 const char **  const errorP) {
+
+    TTimerWheel * wheelP;
+
+    MALLOCVAR(wheelP);
+
+    if (wheelP == NULL)
+        xmlrpc_asprintf(errorP, "Unable to allocate memory for a timer wheel");
+    else {
+        unsigned int level;
+
+        for (level = 0; level < LEVEL_CT; ++level) {
+            unsigned int i;
+
+            for (i = 0; i < SLOT_CT; ++i) {
+                TTimer * const headP = &wheelP->slot[level][i];
+
+                headP->nextP = headP;
+                headP->prevP = headP;
+            }
+        }
+        wheelP->current   = now;
+        wheelP->runningCt = 0;
+
+        *wheelPP = wheelP;
+        *errorP = NULL;
+    }
+}
+
+
+
+void
+TimerWheelDestroy(TTimerWheel * const wheelP) {
+/*----------------------------------------------------------------------------
+   Any timers still in the wheel just stop existing; we don't touch them.
+-----------------------------------------------------------------------------*/
+    free(wheelP);
+}
+
+
+
+void
+TimerInit(TTimer * const timerP) {
+
+    timerP->nextP = NULL;
+    timerP->prevP = NULL;
+}
+
+
+
+bool
+TimerIsRunning(const TTimer * const timerP) {
+
+    return timerP->nextP != NULL;
+}
+
+
+
+static void
+linkTimer(TTimer * const headP,
+          TTimer * const timerP) {
+
+    timerP->prevP = headP->prevP;
+    timerP->nextP = headP;
+    headP->prevP->nextP = timerP;
+    headP->prevP = timerP;
+}
+
+
+
+static void
+unlinkTimer(TTimer * const timerP) {
+
+    timerP->prevP->nextP = timerP->nextP;
+    timerP->nextP->prevP = timerP->prevP;
+    timerP->nextP = NULL;
+    timerP->prevP = NULL;
+}
+
+
+
+static void
+placeTimer(TTimerWheel * const wheelP,
+           TTimer *      const timerP) {
+/*----------------------------------------------------------------------------
+   Put the timer in the slot for its expiry.  Its expiry is no earlier than
+   the current tick.  If it is the current tick, it goes in the slot we are
+   about to process (see TimerWheelAdvance()).
+-----------------------------------------------------------------------------*/
+    uint64_t const delta = MIN(timerP->expiry - wheelP->current, MAX_DELTA);
+    uint64_t const slotTick = wheelP->current + delta;
+
+    unsigned int level;
+
+    for (level = 0;
+         level < LEVEL_CT - 1 &&
+             delta >= ((uint64_t)1) << (SLOT_BITS * (level + 1));
+         ++level);
+
+    linkTimer(&wheelP->slot[level][(slotTick >> (SLOT_BITS * level)) &
+                                   SLOT_MASK],
+              timerP);
+}
+
+
+
+void
+TimerWheelStart(TTimerWheel * const wheelP,
+                TTimer *      const timerP,
+                uint64_t      const expiry,
+                TTimerFn *    const fn,
+                void *        const userHandle) {
+/*----------------------------------------------------------------------------
+   Start timer *timerP, which isn't running, to expire at tick 'expiry'.
+   When it does, we call fn(timerP, userHandle).
+
+   If 'expiry' has already passed, the timer expires at the next tick.
+-----------------------------------------------------------------------------*/
+    timerP->expiry     = MAX(expiry, wheelP->current + 1);
+    timerP->fn         = fn;
+    timerP->userHandle = userHandle;
+
+    placeTimer(wheelP, timerP);
+
+    ++wheelP->runningCt;
+}
+
+
+
+void
+TimerWheelStop(TTimerWheel * const wheelP,
+               TTimer *      const timerP) {
+/*----------------------------------------------------------------------------
+   Stop timer *timerP if it is running.  If it isn't (e.g. because it has
+   expired), do nothing.
+-----------------------------------------------------------------------------*/
+    if (TimerIsRunning(timerP)) {
+        unlinkTimer(timerP);
+        --wheelP->runningCt;
+    }
+}
+
+
+
+static void
+cascade(TTimerWheel * const wheelP,
+        unsigned int  const level,
+        unsigned int  const slot) {
+/*----------------------------------------------------------------------------
+   Move the timers in the slot to where they belong now that the current
+   tick is the first of the slot's block.  That's always a lower level.
+-----------------------------------------------------------------------------*/
+    TTimer * const headP = &wheelP->slot[level][slot];
+
+    while (headP->nextP != headP) {
+        TTimer * const timerP = headP->nextP;
+
+        unlinkTimer(timerP);
+        placeTimer(wheelP, timerP);
+    }
+}
+
+
+
+static void
+expireSlot(TTimerWheel * const wheelP,
+           unsigned int  const slot) {
+/*----------------------------------------------------------------------------
+   Expire the timers in level 0 slot 'slot'.  A timer function may start
+   and stop timers, but can't start one in this slot because it's too late
+   for that.
+-----------------------------------------------------------------------------*/
+    TTimer * const headP = &wheelP->slot[0][slot];
+
+    while (headP->nextP != headP) {
+        TTimer * const timerP = headP->nextP;
+
+        unlinkTimer(timerP);
+        --wheelP->runningCt;
+
+        timerP->fn(timerP, timerP->userHandle);
+    }
+}
+
+
+
+void
+TimerWheelAdvance(TTimerWheel * const wheelP,
+                  uint64_t      const now) {
+/*----------------------------------------------------------------------------
+   Process every tick up through 'now': expire every timer whose tick
+   that is.
+-----------------------------------------------------------------------------*/
+    while (wheelP->current < now) {
+        if (wheelP->runningCt == 0)
+            /* Nothing to do for any tick */
+            wheelP->current = now;
+        else {
+            uint64_t const tick = ++wheelP->current;
+
+            unsigned int level;
+
+            for (level = 1;
+                 level < LEVEL_CT &&
+                     (tick & ((((uint64_t)1) << (SLOT_BITS * level)) - 1))
+                     == 0;
+                 ++level)
+                cascade(wheelP, level,
+                        (tick >> (SLOT_BITS * level)) & SLOT_MASK);
+
+            expireSlot(wheelP, tick & SLOT_MASK);
+        }
+    }
+}
+
+
+
+uint64_t
+TimerWheelNow(const TTimerWheel * const wheelP) {
+
+    return wheelP->current;
+}
@@ -0,0 +1,74 @@
+#ifndef TIMERWHEEL_H_INCLUDED
+#define TIMERWHEEL_H_INCLUDED
+
+#include "bool.h"
+#include "int.h"
+
+/* A timer wheel keeps any number of timers, each to expire at a certain
+   tick, and calls each one's function when the wheel advances past that
+   tick.  Starting and stopping a timer take constant time, and so does
+   expiring one, amortized.
+
+   The wheel is hierarchical: a level of slots for each of the next 64
+   ticks, another for each of the next 64 blocks of 64 ticks, and so on.
+   As time reaches a block, we move its timers down a level.
+
+   What a tick is, and what advances the wheel, are up to the user.  The
+   wheel is not thread-safe; the user must serialize all calls for a wheel.
+*/
+
+typedef struct TTimer TTimer;
+
+typedef void TTimerFn(TTimer * const timerP,
+                      void *   const userHandle);
+
+struct TTimer {
+/*----------------------------------------------------------------------------
+   The user allocates this and initializes it with TimerInit(); its
+   contents belong to the wheel.
+-----------------------------------------------------------------------------*/
+    TTimer * nextP;
+    TTimer * prevP;
+        /* Links in the list of a wheel slot.  NULL if the timer isn't
+           running.
+        */
+    uint64_t expiry;
+    TTimerFn * fn;
+    void * userHandle;
+};
+
+typedef struct TTimerWheel TTimerWheel;
+
+void
+TimerWheelCreate(uint64_t       const now,
+                 TTimerWheel ** const wheelPP,
+                 const char **  const errorP);
+
+void
+TimerWheelDestroy(TTimerWheel * const wheelP);
+
+void
+TimerInit(TTimer * const timerP);
+
+bool
+TimerIsRunning(const TTimer * const timerP);
+
+void
+TimerWheelStart(TTimerWheel * const wheelP,
+                TTimer *      const timerP,
+                uint64_t      const expiry,
+                TTimerFn *    const fn,
+                void *        const userHandle);
+
+void
+TimerWheelStop(TTimerWheel * const wheelP,
+               TTimer *      const timerP);
+
+void
+TimerWheelAdvance(TTimerWheel * const wheelP,
+                  uint64_t      const now);
+
+uint64_t
+TimerWheelNow(const TTimerWheel * const wheelP);
+
+#endif
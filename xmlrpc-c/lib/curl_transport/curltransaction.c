@@ -556,6 +556,34 @@ requestGssapiDelegation(CURL * const curlSessionP ATTR_UNUSED,
 
 
 
+static void
+setUnixSocketPath(xmlrpc_env * const envP,
+                  CURL *       const curlSessionP ATTR_UNUSED,
+                  const char * const path) {
+/*----------------------------------------------------------------------------
+   Set up the Curl session *curlSessionP to connect to the server through the
+   Unix domain socket named 'path' instead of through TCP.
+-----------------------------------------------------------------------------*/
+#if HAVE_CURL_UNIX_SOCKETS
+    CURLcode rc;
+
+    rc = curl_easy_setopt(curlSessionP, CURLOPT_UNIX_SOCKET_PATH, path);
+
+    if (rc != CURLE_OK)
+        xmlrpc_faultf(envP, "Cannot honor 'unix_socket_path' "
+                      "Curl transport option.  "
+                      "The libcurl to which we are linked is not "
+                      "capable of using Unix domain sockets");
+#else
+    xmlrpc_faultf(envP, "Cannot honor 'unix_socket_path' Curl transport "
+                  "option ('%s').  "
+                  "This version of libcurl is not capable of using Unix "
+                  "domain sockets", path);
+#endif
+}
+
+
+
 static void
 setupCurlSession(xmlrpc_env *               const envP,
                  curlTransaction *          const transP,
@@ -707,6 +735,9 @@ setupCurlSession(xmlrpc_env *               const envP,
                               "capable of delegating GSSAPI credentials");
         }
 
+        if (!envP->fault_occurred && curlSetupP->unixSocketPath)
+            setUnixSocketPath(envP, curlSessionP, curlSetupP->unixSocketPath);
+
         if (!envP->fault_occurred) {
             const char * authHdrValue;
                 /* NULL means we don't have to construct an explicit
@@ -88,6 +88,11 @@ struct curlSetup {
     unsigned int timeout;
         /* 0 = no Curl timeout.  This is in milliseconds. */
 
+    const char * unixSocketPath;
+        /* Connect via the Unix domain socket by this name instead of TCP.
+           NULL means TCP.  This is Curl's CURLOPT_UNIX_SOCKET_PATH.
+        */
+
     bool verbose;
 };
 
@@ -14,6 +14,17 @@
   #define HAVE_CURL_STRERROR 0
 #endif
 
+#if CMAJOR > 7 || (CMAJOR == 7 && CMINOR >= 23)
+  #define HAVE_CURL_SHARE_SSL_SESSION 1
+#else
+  #define HAVE_CURL_SHARE_SSL_SESSION 0
+#endif
+#if CMAJOR > 7 || (CMAJOR == 7 && CMINOR >= 40)
+  #define HAVE_CURL_UNIX_SOCKETS 1
+#else
+  #define HAVE_CURL_UNIX_SOCKETS 0
+#endif
+
 #ifdef CURLGSSAPI_DELEGATION_FLAG
 #define HAVE_CURL_GSSAPI_DELEGATION 1
 #else
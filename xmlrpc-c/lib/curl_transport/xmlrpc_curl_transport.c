@@ -196,6 +196,22 @@ struct xmlrpc_client_transport {
            and consequently does not share things such as persistent
            connections and cookies with any other RPC.
         */
+    CURLSH * curlShareP;
+        /* A Curl share object through which all the Curl sessions of this
+           transport (the synchronous one and every asynchronous RPC's)
+           share TLS sessions, so that a new connection to a server we have
+           talked to before can resume the TLS session with an abbreviated
+           handshake instead of doing a full one.
+
+           NULL means we don't share (libcurl too old).
+
+           This is constant (the handle, not the object).
+        */
+    lock * curlShareLockP;
+        /* The lock the share object uses to serialize access from the
+           Curl sessions that share it, which may be running in different
+           threads.
+        */
     lock * syncCurlSessionLockP;
         /* Hold this lock while accessing or using *syncCurlSessionP.
            You're using the session from the time you set any
@@ -285,6 +301,12 @@ struct rpc {
         */
     struct xmlrpc_call_info * callInfoP;
         /* User's identifier for this RPC */
+    const int * cancelP;
+        /* Pointer to a value that user sets to nonzero to indicate he no
+           longer wants this RPC, so we should abort it.
+
+           NULL means none -- the RPC runs to completion.
+        */
 };
 
 
@@ -597,14 +619,18 @@ finishCurlMulti(xmlrpc_env *       const envP,
                 curlMulti *        const curlMultiP,
                 xmlrpc_timeoutType const timeoutType,
                 xmlrpc_timespec    const deadline,
-                int *              const interruptP) {
+                int *              const interruptP,
+                const int *        const doneP) {
 /*----------------------------------------------------------------------------
    Prosecute all the Curl transactions under the control of
    *curlMultiP.  E.g. send data if server is ready to take it, get
    data if server has sent some, wind up the transaction if it is
    done.
 
-   Don't return until all the Curl transactions are done or we time out.
+   Don't return until all the Curl transactions are done or we time out,
+   or, if 'doneP' is non-null, *doneP is nonzero.  A transaction's finish
+   routine typically is what makes it so; we look after every round of
+   work.
 
    if 'interruptP' is non-null, it points to a value which is normally zero,
    but is nonzero when Caller wants us to abort all the transactions and
@@ -638,7 +664,8 @@ finishCurlMulti(xmlrpc_env *       const envP,
     timedOut = false;
     curlCalledSinceInterrupt = false;
     
-    while (rpcStillRunning && !timedOut && !envP->fault_occurred) {
+    while (rpcStillRunning && !timedOut && !envP->fault_occurred &&
+           !(doneP && *doneP)) {
 
         if (interruptP && !curlCalledSinceInterrupt) {
             waitForWorkInt(envP, curlMultiP, timeoutType, deadline,
@@ -906,6 +933,14 @@ getXportParms(xmlrpc_env *                          const envP,
     else
         curlSetupP->referer = strdup(curlXportParmsP->referer);
 
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(unix_socket_path))
+        curlSetupP->unixSocketPath = NULL;
+    else if (curlXportParmsP->unix_socket_path == NULL)
+        curlSetupP->unixSocketPath = NULL;
+    else
+        curlSetupP->unixSocketPath =
+            strdup(curlXportParmsP->unix_socket_path);
+
     getTimeoutParm(envP, curlXportParmsP, parmSize, &curlSetupP->timeout);
 }
 
@@ -950,12 +985,105 @@ freeXportParms(const struct xmlrpc_client_transport * const transportP) {
         xmlrpc_strfree(curlSetupP->proxyUserPwd);
     if (curlSetupP->referer)
         xmlrpc_strfree(curlSetupP->referer);
+    if (curlSetupP->unixSocketPath)
+        xmlrpc_strfree(curlSetupP->unixSocketPath);
+}
+
+
+
+static void
+lockCurlShare(CURL *           const curlSessionP ATTR_UNUSED,
+              curl_lock_data   const data ATTR_UNUSED,
+              curl_lock_access const access ATTR_UNUSED,
+              void *           const userptr) {
+
+    lock * const lockP = userptr;
+
+    lockP->acquire(lockP);
+}
+
+
+
+static void
+unlockCurlShare(CURL *         const curlSessionP ATTR_UNUSED,
+                curl_lock_data const data ATTR_UNUSED,
+                void *         const userptr) {
+
+    lock * const lockP = userptr;
+
+    lockP->release(lockP);
+}
+
+
+
+static void
+makeCurlShare(xmlrpc_env *                     const envP ATTR_UNUSED,
+              struct xmlrpc_client_transport * const transportP) {
+/*----------------------------------------------------------------------------
+   Create the Curl share object through which the transport's Curl
+   sessions share TLS sessions.
+
+   With a libcurl that can't share TLS sessions, we make no share object;
+   each Curl session then does a full TLS handshake on its first connection.
+-----------------------------------------------------------------------------*/
+#if HAVE_CURL_SHARE_SSL_SESSION
+    transportP->curlShareLockP = xmlrpc_lock_create();
+
+    if (transportP->curlShareLockP == NULL)
+        xmlrpc_faultf(envP, "Unable to create lock for Curl share object");
+    else {
+        CURLSH * const curlShareP = curl_share_init();
+
+        if (curlShareP == NULL)
+            xmlrpc_faultf(envP, "Could not create Curl share object.  "
+                          "curl_share_init() failed.");
+        else {
+            curl_share_setopt(curlShareP, CURLSHOPT_LOCKFUNC, lockCurlShare);
+            curl_share_setopt(curlShareP, CURLSHOPT_UNLOCKFUNC,
+                              unlockCurlShare);
+            curl_share_setopt(curlShareP, CURLSHOPT_USERDATA,
+                              transportP->curlShareLockP);
+            curl_share_setopt(curlShareP, CURLSHOPT_SHARE,
+                              CURL_LOCK_DATA_SSL_SESSION);
+
+            transportP->curlShareP = curlShareP;
+        }
+        if (envP->fault_occurred)
+            transportP->curlShareLockP->destroy(transportP->curlShareLockP);
+    }
+#else
+    transportP->curlShareP     = NULL;
+    transportP->curlShareLockP = NULL;
+#endif
+}
+
+
+
+static void
+unmakeCurlShare(struct xmlrpc_client_transport * const transportP) {
+
+    if (transportP->curlShareP) {
+        curl_share_cleanup(transportP->curlShareP);
+
+        transportP->curlShareLockP->destroy(transportP->curlShareLockP);
+    }
+}
+
+
+
+static void
+useCurlShare(CURL *   const curlSessionP,
+             CURLSH * const curlShareP) {
+
+    if (curlShareP)
+        curl_easy_setopt(curlSessionP, CURLOPT_SHARE, curlShareP);
 }
 
 
 
 static void
 createSyncCurlSession(xmlrpc_env * const envP,
+                      CURLSH *     const curlShareP,
                       CURL **      const curlSessionPP) {
 /*----------------------------------------------------------------------------
    Create a Curl session to be used for multiple serial transactions.
@@ -992,6 +1120,8 @@ createSyncCurlSession(xmlrpc_env * const envP,
         */
         curl_easy_setopt(curlSessionP, CURLOPT_COOKIEFILE, "");
 
+        useCurlShare(curlSessionP, curlShareP);
+
         *curlSessionPP = curlSessionP;
     }
 }
@@ -1015,7 +1145,8 @@ makeSyncCurlSession(xmlrpc_env *                     const envP,
         xmlrpc_faultf(envP, "Unable to create lock for "
                       "synchronous Curl session.");
     else {
-        createSyncCurlSession(envP, &transportP->syncCurlSessionP);
+        createSyncCurlSession(envP, transportP->curlShareP,
+                              &transportP->syncCurlSessionP);
 
         if (!envP->fault_occurred) {
             /* We'll need a multi manager to actually execute this session: */
@@ -1082,8 +1213,14 @@ create(xmlrpc_env *                      const envP,
             getXportParms(envP, curlXportParmsP, parm_size, transportP);
             
             if (!envP->fault_occurred) {
-                makeSyncCurlSession(envP, transportP);
-                
+                makeCurlShare(envP, transportP);
+
+                if (!envP->fault_occurred) {
+                    makeSyncCurlSession(envP, transportP);
+
+                    if (envP->fault_occurred)
+                        unmakeCurlShare(transportP);
+                }
                 if (envP->fault_occurred)
                     freeXportParms(transportP);
             }
@@ -1159,6 +1296,9 @@ destroy(struct xmlrpc_client_transport * const clientTransportP) {
 
     curlMulti_destroy(clientTransportP->asyncCurlMultiP);
 
+    unmakeCurlShare(clientTransportP);
+        /* Every Curl session that used the share object is gone now */
+
     freeXportParms(clientTransportP);
 
     free(clientTransportP);
@@ -1182,7 +1322,8 @@ performCurlTransaction(xmlrpc_env *      const envP,
     if (!envP->fault_occurred) {
         xmlrpc_timespec const dummy = {0,0};
 
-        finishCurlMulti(envP, curlMultiP, timeout_no, dummy, interruptP);
+        finishCurlMulti(envP, curlMultiP, timeout_no, dummy, interruptP,
+                        NULL);
 
         /* Failure here just means something screwy in the multi
            manager; any failure of the HTTP transaction would have been
@@ -1242,6 +1383,7 @@ createRpc(xmlrpc_env *                     const envP,
           xmlrpc_mem_block *               const responseXmlP,
           xmlrpc_transport_asynch_complete       complete, 
           xmlrpc_transport_progress              progress,
+          const int *                      const cancelP,
           struct xmlrpc_call_info *        const callInfoP,
           rpc **                           const rpcPP) {
 
@@ -1253,7 +1395,7 @@ createRpc(xmlrpc_env *                     const envP,
     else {
         curlt_progressFn * curlProgressFn;
 
-        if (progress || clientTransportP->interruptP)
+        if (progress || clientTransportP->interruptP || cancelP)
             curlProgressFn = &curlTransactionProgress;
         else {
             /* There's nothing for curlTransactionProgress() to do, so save
@@ -1267,6 +1409,7 @@ createRpc(xmlrpc_env *                     const envP,
         rpcP->complete     = complete;
         rpcP->progress     = progress;
         rpcP->responseXmlP = responseXmlP;
+        rpcP->cancelP      = cancelP;
 	/*
 #ifdef DEBUG
 	printf("%s calling creatRPC()\n", callInfoP->completionArgs.serverUrl);
@@ -1390,7 +1533,8 @@ curlTransactionProgress(void * const context,
    Additionally, the curlTransaction gives us the opportunity to tell it
    to abort the transaction, which we do if the user has set his
    "interrupt" flag (which he registered with the transport when he
-   created it).
+   created it) or the RPC's "cancel" flag (which he registered when he
+   started the RPC).
 -----------------------------------------------------------------------------*/
     rpc * const rpcP = context;
     struct xmlrpc_client_transport * const transportP = rpcP->transportP;
@@ -1419,18 +1563,25 @@ curlTransactionProgress(void * const context,
         *abortP = *transportP->interruptP;
     } else
         *abortP = false;
+
+    if (rpcP->cancelP && *rpcP->cancelP) {
+        trace("RPC is cancelled; directing libcurl to abort the transaction");
+        *abortP = true;
+    }
 }
 
 
 
 static void 
-sendRequest(xmlrpc_env *                     const envP, 
-            struct xmlrpc_client_transport * const clientTransportP,
-            const xmlrpc_server_info *       const serverP,
-            xmlrpc_mem_block *               const callXmlP,
-            xmlrpc_transport_asynch_complete       complete,
-            xmlrpc_transport_progress              progress,
-            struct xmlrpc_call_info *        const callInfoP) {
+sendRequestCancelable(
+    xmlrpc_env *                     const envP, 
+    struct xmlrpc_client_transport * const clientTransportP,
+    const xmlrpc_server_info *       const serverP,
+    xmlrpc_mem_block *               const callXmlP,
+    xmlrpc_transport_asynch_complete       complete,
+    xmlrpc_transport_progress              progress,
+    const int *                      const cancelP,
+    struct xmlrpc_call_info *        const callInfoP) {
 /*----------------------------------------------------------------------------
    Initiate an XML-RPC rpc asynchronously.  Don't wait for it to go to
    the server.
@@ -1438,7 +1589,11 @@ sendRequest(xmlrpc_env *                     const envP,
    Unless we return failure, we arrange to have complete() called when
    the rpc completes.
 
-   This does the 'send_request' operation for a Curl client transport.
+   If 'cancelP' is non-null, we abort the rpc (it completes with a failure)
+   once *cancelP is nonzero.
+
+   This does the 'send_request_cancelable' operation for a Curl client
+   transport.
 -----------------------------------------------------------------------------*/
     rpc * rpcP;
     xmlrpc_mem_block * responseXmlP;
@@ -1451,6 +1606,8 @@ sendRequest(xmlrpc_env *                     const envP,
             xmlrpc_faultf(envP, "Could not create Curl session.  "
                           "curl_easy_init() failed.");
         else {
+            useCurlShare(curlSessionP, clientTransportP->curlShareP);
+
 	  /*
 #ifdef DEBUG
 	  printf("%s calling send_request()\n", callInfoP->completionArgs.serverUrl);
@@ -1462,7 +1619,7 @@ sendRequest(xmlrpc_env *                     const envP,
 #endif    
 
 	  createRpc(envP, clientTransportP, curlSessionP, serverP,
-		    callXmlP, responseXmlP, complete, progress, callInfoP,
+		    callXmlP, responseXmlP, complete, progress, cancelP, callInfoP,
 		    &rpcP);
             
             if (!envP->fault_occurred) {
@@ -1487,20 +1644,42 @@ sendRequest(xmlrpc_env *                     const envP,
 
 
 static void 
-finishAsynch(
+sendRequest(xmlrpc_env *                     const envP, 
+            struct xmlrpc_client_transport * const clientTransportP,
+            const xmlrpc_server_info *       const serverP,
+            xmlrpc_mem_block *               const callXmlP,
+            xmlrpc_transport_asynch_complete       complete,
+            xmlrpc_transport_progress              progress,
+            struct xmlrpc_call_info *        const callInfoP) {
+/*----------------------------------------------------------------------------
+   This does the 'send_request' operation for a Curl client transport.
+-----------------------------------------------------------------------------*/
+    sendRequestCancelable(envP, clientTransportP, serverP, callXmlP,
+                          complete, progress, NULL, callInfoP);
+}
+
+
+
+static void 
+finishUntil(
     struct xmlrpc_client_transport * const clientTransportP,
     xmlrpc_timeoutType               const timeoutType,
-    xmlrpc_timeout                   const timeout) {
+    xmlrpc_timeout                   const timeout,
+    const int *                      const doneP) {
 /*----------------------------------------------------------------------------
    Wait for the Curl multi manager to finish the Curl transactions for
    all outstanding RPCs and destroy those RPCs.
 
+   But if 'doneP' is non-null, stop as soon as *doneP is nonzero, leaving
+   the rest of the RPCs in progress.  An RPC completion function sets it;
+   it is how a caller waits for just some of the RPCs.
+
    But give up if a) too much time passes as defined by 'timeoutType'
    and 'timeout'; or b) the transport client requests interruption
    (i.e. the transport's interrupt flag becomes nonzero).  Normally, a
    signal must get our attention for us to notice the interrupt flag.
 
-   This does the 'finish_asynch' operation for a Curl client transport.
+   This does the 'finish_until' operation for a Curl client transport.
 
    It would be cool to replace this with something analogous to the
    Curl asynchronous interface: Have something like curl_multi_fdset()
@@ -1520,6 +1699,8 @@ finishAsynch(
     xmlrpc_timespec waitTimeoutTime;
         /* The datetime after which we should quit waiting */
 
+    bool rpcStillRunning;
+
     xmlrpc_env_init(&env);
     
     if (timeoutType == timeout_yes) {
@@ -1528,9 +1709,16 @@ finishAsynch(
         addMilliseconds(waitStartTime, timeout, &waitTimeoutTime);
     }
 
-    finishCurlMulti(&env, clientTransportP->asyncCurlMultiP,
-                    timeoutType, waitTimeoutTime,
-                    clientTransportP->interruptP);
+    /* The user may have cancelled RPCs since we last worked on them, and
+       nothing may happen on their connections to end a wait.  So we do
+       whatever work there is first; that is what aborts them.
+    */
+    doCurlWork(&env, clientTransportP->asyncCurlMultiP, &rpcStillRunning);
+
+    if (!env.fault_occurred && rpcStillRunning)
+        finishCurlMulti(&env, clientTransportP->asyncCurlMultiP,
+                        timeoutType, waitTimeoutTime,
+                        clientTransportP->interruptP, doneP);
 
     /* If the above fails, it is catastrophic, because it means there is
        no way to complete outstanding Curl transactions and RPCs, and
@@ -1561,6 +1749,19 @@ finishAsynch(
 
 
 
+static void 
+finishAsynch(
+    struct xmlrpc_client_transport * const clientTransportP,
+    xmlrpc_timeoutType               const timeoutType,
+    xmlrpc_timeout                   const timeout) {
+/*----------------------------------------------------------------------------
+   This does the 'finish_asynch' operation for a Curl client transport.
+-----------------------------------------------------------------------------*/
+    finishUntil(clientTransportP, timeoutType, timeout, NULL);
+}
+
+
+
 static void
 call(xmlrpc_env *                     const envP,
      struct xmlrpc_client_transport * const clientTransportP,
@@ -1585,7 +1786,7 @@ call(xmlrpc_env *                     const envP,
         createRpc(envP, clientTransportP, clientTransportP->syncCurlSessionP,
                   serverP,
                   callXmlP, responseXmlP,
-                  NULL, NULL, NULL,
+                  NULL, NULL, NULL, NULL,
                   &rpcP);
 
         if (!envP->fault_occurred) {
@@ -1646,4 +1847,6 @@ struct xmlrpc_client_transport_ops xmlrpc_curl_transport_ops = {
     &call,
     &finishAsynch,
     &setInterrupt,
+    &finishUntil,
+    &sendRequestCancelable,
 };
@@ -0,0 +1,38 @@
+/*=============================================================================
+                              condition_platform
+===============================================================================
+
+  This module provides condition (thread wait) services appropriate for
+  the platform for which Xmlrpc-c is being built.  I.e. services chosen by
+  the build configuration.  They go with the locks of lock_platform.
+
+============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include "xmlrpc-c/condition_platform.h"
+
+#if HAVE_PTHREAD
+#include "xmlrpc-c/condition_pthread.h"
+#endif
+
+#if HAVE_WINDOWS_THREAD
+#include "xmlrpc-c/condition_windows.h"
+#endif
+
+struct condition *
+xmlrpc_condition_create(void) {
+
+#if HAVE_PTHREAD
+    return xmlrpc_condition_create_pthread();
+#elif HAVE_WINDOWS_THREAD
+    return xmlrpc_condition_create_windows();
+#else
+  #error "You don't have any thread facility.  (According to "
+  #error "HAVE_PTHREAD and HAVE_WINDOWS_THREAD macros defined in "
+  #error "xmlrpc_config.h)"
+#endif
+
+}
+
+
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "mallocvar.h"
+
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/condition.h"
+
+#include "xmlrpc-c/condition_pthread.h"
+
+/* The lock a caller passes us is from xmlrpc_lock_create_pthread(), so
+   its implementation is a pthread mutex.
+*/
+
+static conditionWaitFn waitCondition;
+
+static void
+waitCondition(struct condition * const conditionP,
+              struct lock *      const lockP) {
+
+    pthread_cond_t * const condP = conditionP->implementationP;
+
+    pthread_cond_wait(condP, lockP->implementationP);
+}
+
+
+
+static conditionTimedWaitFn timedWaitCondition;
+
+static void
+timedWaitCondition(struct condition * const conditionP,
+                   struct lock *      const lockP,
+                   unsigned int       const timeoutMs) {
+
+    pthread_cond_t * const condP = conditionP->implementationP;
+
+    struct timeval now;
+    struct timespec deadline;
+
+    gettimeofday(&now, NULL);
+
+    deadline.tv_sec  = now.tv_sec + timeoutMs / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000 + (timeoutMs % 1000) * 1000000;
+
+    if (deadline.tv_nsec >= 1000000000) {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(condP, lockP->implementationP, &deadline);
+}
+
+
+
+static conditionSignalFn signalCondition;
+
+static void
+signalCondition(struct condition * const conditionP) {
+
+    pthread_cond_t * const condP = conditionP->implementationP;
+
+    pthread_cond_signal(condP);
+}
+
+
+
+static conditionSignalFn broadcastCondition;
+
+static void
+broadcastCondition(struct condition * const conditionP) {
+
+    pthread_cond_t * const condP = conditionP->implementationP;
+
+    pthread_cond_broadcast(condP);
+}
+
+
+
+static conditionDestroyFn destroyCondition;
+
+static void
+destroyCondition(struct condition * const conditionP) {
+
+    pthread_cond_t * const condP = conditionP->implementationP;
+
+    pthread_cond_destroy(condP);
+
+    free(condP);
+
+    free(conditionP);
+}
+
+
+
+struct condition *
+xmlrpc_condition_create_pthread(void) {
+
+    struct condition * conditionP;
+
+    MALLOCVAR(conditionP);
+
+    if (conditionP) {
+        pthread_cond_t * condP;
+
+        MALLOCVAR(condP);
+
+        if (condP) {
+            pthread_cond_init(condP, NULL);
+
+            conditionP->implementationP = condP;
+            conditionP->wait      = &waitCondition;
+            conditionP->timedWait = &timedWaitCondition;
+            conditionP->signal    = &signalCondition;
+            conditionP->broadcast = &broadcastCondition;
+            conditionP->destroy   = &destroyCondition;
+        } else {
+            free(conditionP);
+            conditionP = NULL;
+        }
+    }
+    return conditionP;
+}
+
+
+
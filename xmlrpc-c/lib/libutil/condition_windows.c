@@ -0,0 +1,117 @@
+#include "xmlrpc_config.h"
+
+/* We define WIN32_WIN_LEAN_AND_MEAN to make <windows.h> contain less
+   junk; nothing in Xmlrpc-c needs that stuff.  One significant thing it cuts
+   out is <winsock.h>, which would conflict with the <winsock2.h> that our
+   includer might use.
+*/
+#define WIN32_WIN_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "mallocvar.h"
+
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/condition.h"
+
+#include "xmlrpc-c/condition_windows.h"
+
+/* The lock a caller passes us is from xmlrpc_lock_create_windows(), so
+   its implementation is a critical section.
+*/
+
+static conditionWaitFn waitCondition;
+
+static void
+waitCondition(struct condition * const conditionP,
+              struct lock *      const lockP) {
+
+    CONDITION_VARIABLE * const condP = conditionP->implementationP;
+
+    SleepConditionVariableCS(condP, lockP->implementationP, INFINITE);
+}
+
+
+
+static conditionTimedWaitFn timedWaitCondition;
+
+static void
+timedWaitCondition(struct condition * const conditionP,
+                   struct lock *      const lockP,
+                   unsigned int       const timeoutMs) {
+
+    CONDITION_VARIABLE * const condP = conditionP->implementationP;
+
+    SleepConditionVariableCS(condP, lockP->implementationP, timeoutMs);
+}
+
+
+
+static conditionSignalFn signalCondition;
+
+static void
+signalCondition(struct condition * const conditionP) {
+
+    CONDITION_VARIABLE * const condP = conditionP->implementationP;
+
+    WakeConditionVariable(condP);
+}
+
+
+
+static conditionSignalFn broadcastCondition;
+
+static void
+broadcastCondition(struct condition * const conditionP) {
+
+    CONDITION_VARIABLE * const condP = conditionP->implementationP;
+
+    WakeAllConditionVariable(condP);
+}
+
+
+
+static conditionDestroyFn destroyCondition;
+
+static void
+destroyCondition(struct condition * const conditionP) {
+
+    /* A Windows condition variable needs no cleanup */
+
+    free(conditionP->implementationP);
+
+    free(conditionP);
+}
+
+
+
+struct condition *
+xmlrpc_condition_create_windows(void) {
+
+    struct condition * conditionP;
+
+    MALLOCVAR(conditionP);
+
+    if (conditionP) {
+        CONDITION_VARIABLE * condP;
+
+        MALLOCVAR(condP);
+
+        if (condP) {
+            InitializeConditionVariable(condP);
+
+            conditionP->implementationP = condP;
+            conditionP->wait      = &waitCondition;
+            conditionP->timedWait = &timedWaitCondition;
+            conditionP->signal    = &signalCondition;
+            conditionP->broadcast = &broadcastCondition;
+            conditionP->destroy   = &destroyCondition;
+        } else {
+            free(conditionP);
+            conditionP = NULL;
+        }
+    }
+    return conditionP;
+}
+
+
+
@@ -0,0 +1,302 @@
+/*=============================================================================
+                                  workpool
+===============================================================================
+  A fixed set of threads that run jobs from a queue.  See workpool_int.h.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#if HAVE_PTHREAD
+#  include <pthread.h>
+#elif HAVE_WINDOWS_THREAD
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  include <process.h>
+#endif
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition.h"
+#include "xmlrpc-c/condition_platform.h"
+
+#include "xmlrpc-c/workpool_int.h"
+
+#if HAVE_PTHREAD
+typedef pthread_t threadHandle;
+#elif HAVE_WINDOWS_THREAD
+typedef HANDLE threadHandle;
+#endif
+
+struct xmlrpc_workpool {
+    lock * lockP;
+        /* Protects everything below */
+    condition * workP;
+        /* Signalled when there is a job in the queue or the pool is
+           terminating
+        */
+    xmlrpc_workpoolJob * headP;
+        /* The job that has been waiting longest */
+    xmlrpc_workpoolJob ** tailPP;
+        /* Where to link the next job submitted */
+    bool terminating;
+        /* Threads should exit instead of waiting for more jobs */
+    unsigned int threadCt;
+        /* Number of entries in 'thread' */
+    threadHandle * thread;
+};
+
+
+
+static void
+runJobs(struct xmlrpc_workpool * const poolP) {
+/*----------------------------------------------------------------------------
+   The life of a pool thread: run jobs from the queue until the pool
+   terminates.
+-----------------------------------------------------------------------------*/
+    poolP->lockP->acquire(poolP->lockP);
+
+    while (!poolP->terminating) {
+        xmlrpc_workpoolJob * const jobP = poolP->headP;
+
+        if (jobP) {
+            poolP->headP = jobP->nextP;
+            if (!poolP->headP)
+                poolP->tailPP = &poolP->headP;
+
+            poolP->lockP->release(poolP->lockP);
+
+            jobP->fn(jobP->arg);
+
+            poolP->lockP->acquire(poolP->lockP);
+        } else
+            poolP->workP->wait(poolP->workP, poolP->lockP);
+    }
+    poolP->lockP->release(poolP->lockP);
+}
+
+
+
+#if HAVE_PTHREAD
+static void *
+poolThread(void * const arg) {
+
+    runJobs(arg);
+
+    return NULL;
+}
+#elif HAVE_WINDOWS_THREAD
+static unsigned int WINAPI
+poolThread(void * const arg) {
+
+    runJobs(arg);
+
+    return 0;
+}
+#endif
+
+
+
+static void
+startThread(xmlrpc_env *             const envP,
+            struct xmlrpc_workpool * const poolP,
+            threadHandle *           const threadP) {
+
+#if HAVE_PTHREAD
+    int rc;
+
+    rc = pthread_create(threadP, NULL, &poolThread, poolP);
+
+    if (rc != 0)
+        xmlrpc_faultf(envP, "pthread_create() failed with errno %d", rc);
+#elif HAVE_WINDOWS_THREAD
+    *threadP = (HANDLE)_beginthreadex(NULL, 0, &poolThread, poolP, 0, NULL);
+
+    if (*threadP == NULL)
+        xmlrpc_faultf(envP, "_beginthreadex() failed");
+#endif
+}
+
+
+
+static void
+waitForThread(threadHandle const thread) {
+
+#if HAVE_PTHREAD
+    pthread_join(thread, NULL);
+#elif HAVE_WINDOWS_THREAD
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#endif
+}
+
+
+
+static void
+stopThreads(struct xmlrpc_workpool * const poolP) {
+
+    unsigned int i;
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    poolP->terminating = true;
+    poolP->workP->broadcast(poolP->workP);
+
+    poolP->lockP->release(poolP->lockP);
+
+    for (i = 0; i < poolP->threadCt; ++i)
+        waitForThread(poolP->thread[i]);
+}
+
+
+
+static void
+startThreads(xmlrpc_env *             const envP,
+             struct xmlrpc_workpool * const poolP,
+             unsigned int             const threadCt) {
+
+    MALLOCARRAY(poolP->thread, threadCt);
+
+    if (poolP->thread == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for %u threads",
+                      threadCt);
+    else {
+        for (poolP->threadCt = 0;
+             poolP->threadCt < threadCt && !envP->fault_occurred; ) {
+
+            startThread(envP, poolP, &poolP->thread[poolP->threadCt]);
+
+            if (!envP->fault_occurred)
+                ++poolP->threadCt;
+        }
+        if (envP->fault_occurred) {
+            stopThreads(poolP);
+            free(poolP->thread);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_workpoolCreate(xmlrpc_env *              const envP,
+                      unsigned int              const threadCt,
+                      struct xmlrpc_workpool ** const poolPP) {
+/*----------------------------------------------------------------------------
+   Create a work pool of 'threadCt' threads, all waiting for jobs.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_workpool * poolP;
+
+    MALLOCVAR(poolP);
+
+    if (poolP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for work pool");
+    else {
+        poolP->lockP = xmlrpc_lock_create();
+
+        if (poolP->lockP == NULL)
+            xmlrpc_faultf(envP, "Unable to create lock for work pool");
+        else {
+            poolP->workP = xmlrpc_condition_create();
+
+            if (poolP->workP == NULL)
+                xmlrpc_faultf(envP, "Unable to create condition for "
+                              "work pool");
+            else {
+                poolP->headP       = NULL;
+                poolP->tailPP      = &poolP->headP;
+                poolP->terminating = false;
+
+                startThreads(envP, poolP, threadCt);
+
+                if (envP->fault_occurred)
+                    poolP->workP->destroy(poolP->workP);
+            }
+            if (envP->fault_occurred)
+                poolP->lockP->destroy(poolP->lockP);
+        }
+        if (envP->fault_occurred)
+            free(poolP);
+        else
+            *poolPP = poolP;
+    }
+}
+
+
+
+void
+xmlrpc_workpoolDestroy(struct xmlrpc_workpool * const poolP) {
+/*----------------------------------------------------------------------------
+   Wait for jobs that are running to finish, then destroy the pool.  Jobs
+   still in the queue never run.
+-----------------------------------------------------------------------------*/
+    stopThreads(poolP);
+
+    free(poolP->thread);
+    poolP->workP->destroy(poolP->workP);
+    poolP->lockP->destroy(poolP->lockP);
+
+    free(poolP);
+}
+
+
+
+void
+xmlrpc_workpoolSubmit(struct xmlrpc_workpool * const poolP,
+                      xmlrpc_workpoolJob *     const jobP,
+                      xmlrpc_workpoolFn *      const fn,
+                      void *                   const arg) {
+/*----------------------------------------------------------------------------
+   Queue a job to call fn(arg) in one of the pool's threads.
+-----------------------------------------------------------------------------*/
+    jobP->nextP = NULL;
+    jobP->fn    = fn;
+    jobP->arg   = arg;
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    *poolP->tailPP = jobP;
+    poolP->tailPP  = &jobP->nextP;
+
+    poolP->workP->signal(poolP->workP);
+
+    poolP->lockP->release(poolP->lockP);
+}
+
+
+
+int
+xmlrpc_workpoolCancel(struct xmlrpc_workpool * const poolP,
+                      xmlrpc_workpoolJob *     const jobP) {
+/*----------------------------------------------------------------------------
+   Remove job *jobP from the queue if it is still there.
+
+   Return true iff we did, which means it will never run.  False means
+   it has started running (and may have finished).
+-----------------------------------------------------------------------------*/
+    xmlrpc_workpoolJob ** jobPP;
+    bool found;
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    for (jobPP = &poolP->headP; *jobPP && *jobPP != jobP;
+         jobPP = &(*jobPP)->nextP);
+
+    found = (*jobPP == jobP);
+
+    if (found) {
+        *jobPP = jobP->nextP;
+
+        if (!jobP->nextP)
+            poolP->tailPP = jobPP;
+    }
+    poolP->lockP->release(poolP->lockP);
+
+    return found;
+}
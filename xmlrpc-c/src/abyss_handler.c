@@ -25,8 +25,13 @@
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
+#include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition.h"
+#include "xmlrpc-c/condition_platform.h"
 
 #include "abyss_handler.h"
 
@@ -307,6 +312,97 @@ processContentLength(TSession *    const httpRequestP,
 
 
 
+static unsigned int
+clientTimeoutMs(TSession *   const abyssSessionP,
+                const char * const trace) {
+/*----------------------------------------------------------------------------
+   How long, in milliseconds, the client says it will wait for the result of
+   the call, per its X-RPC-Deadline HTTP header (a number of seconds, with a
+   fraction if it likes).  Zero if it doesn't say.
+
+   We ignore a header we don't understand; the client does not get any less
+   of a response for a bad hint.
+-----------------------------------------------------------------------------*/
+    const char * const deadline =
+        RequestHeaderValue(abyssSessionP, "x-rpc-deadline");
+
+    unsigned int retval;
+
+    if (deadline == NULL || deadline[0] == '\0')
+        retval = 0;
+    else {
+        double seconds;
+        char * tail;
+
+        seconds = strtod(deadline, &tail);
+
+        if (*tail != '\0' || !(seconds > 0.0) || seconds > 86400.0) {
+            if (trace)
+                fprintf(stderr, "Ignoring invalid X-RPC-Deadline HTTP "
+                        "header value '%s'\n", deadline);
+            retval = 0;
+        } else
+            retval = MAX(1, (unsigned int)(seconds * 1000.0 + 0.5));
+    }
+    return retval;
+}
+
+
+
+static xmlrpc_bool
+sessionPeerGone(void * const context) {
+
+    TSession * const abyssSessionP = context;
+
+    return !!SessionPeerGone(abyssSessionP);
+}
+
+
+
+static void
+initCallCtl(xmlrpc_call_ctl * const ctlP,
+            TSession *        const abyssSessionP,
+            unsigned int      const defaultTimeoutMs,
+            const char *      const trace) {
+/*----------------------------------------------------------------------------
+   Set up *ctlP to control the call the request of session 'abyssSessionP'
+   carries: it has to finish by the sooner of what the client asks for and
+   'defaultTimeoutMs', and it is cancelled if the client goes away.
+-----------------------------------------------------------------------------*/
+    unsigned int const clientMs = clientTimeoutMs(abyssSessionP, trace);
+
+    unsigned int timeoutMs;
+
+    if (clientMs == 0)
+        timeoutMs = defaultTimeoutMs;
+    else if (defaultTimeoutMs == 0)
+        timeoutMs = clientMs;
+    else
+        timeoutMs = MIN(clientMs, defaultTimeoutMs);
+
+    if (trace && timeoutMs > 0)
+        fprintf(stderr, "Call must finish within %u ms\n", timeoutMs);
+
+    xmlrpc_call_ctl_init(ctlP, timeoutMs);
+
+    ctlP->peerGone        = &sessionPeerGone;
+    ctlP->peerGoneContext = abyssSessionP;
+}
+
+
+
+xmlrpc_call_ctl *
+xmlrpc_server_abyss_call_ctl(TSession * const abyssSessionP) {
+/*----------------------------------------------------------------------------
+   The call control (deadline and cancellation) of the XML-RPC call the
+   Xmlrpc-c request handler is processing on session 'abyssSessionP'; NULL
+   if it isn't processing one.
+-----------------------------------------------------------------------------*/
+    return SessionGetHandlerData(abyssSessionP);
+}
+
+
+
 static void
 traceHandlerCalled(TSession * const abyssSessionP) {
     
@@ -341,13 +437,275 @@ traceHandlerCalled(TSession * const abyssSessionP) {
 
 
 
+static void
+sendFault(TSession *         const abyssSessionP,
+          const xmlrpc_env * const faultP) {
+/*----------------------------------------------------------------------------
+   Send the HTTP error response for an RPC we couldn't process, as
+   described by *faultP.
+-----------------------------------------------------------------------------*/
+    uint16_t httpResponseStatus;
+
+    if (faultP->fault_code == XMLRPC_TIMEOUT_ERROR)
+        httpResponseStatus = 408;  /* Request Timeout */
+    else
+        httpResponseStatus = 500;  /* Internal Server Error */
+
+    sendError(abyssSessionP, httpResponseStatus, faultP->fault_string);
+}
+
+
+
+static void
+sendOutput(TSession *         const abyssSessionP,
+           xmlrpc_mem_block * const output,
+           bool               const wantChunk,
+           ResponseAccessCtl  const accessControl) {
+/*----------------------------------------------------------------------------
+   Send XML-RPC response 'output' as the HTTP response.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    sendResponse(&env, abyssSessionP,
+                 XMLRPC_MEMBLOCK_CONTENTS(char, output),
+                 XMLRPC_MEMBLOCK_SIZE(char, output),
+                 wantChunk, accessControl);
+
+    if (env.fault_occurred)
+        sendFault(abyssSessionP, &env);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   An RPC we are processing with an asynchronous call processor
+-----------------------------------------------------------------------------*/
+    TSession * abyssSessionP;
+    xmlrpc_call_ctl callCtl;
+    bool wantChunk;
+    ResponseAccessCtl accessControl;
+    lock * lockP;
+    condition * responseInP;
+        /* Signalled when the processor reports the response, for the
+           handler if it is waiting for it.
+        */
+    bool deferred;
+        /* The handler has returned, leaving it to the processor's response
+           function to send the response.
+        */
+    bool responseIn;
+        /* The processor has reported the response */
+    xmlrpc_env fault;
+        /* How the processor failed to make a response, if it did */
+    xmlrpc_mem_block * output;
+        /* The response XML, if the processor made a response */
+} asyncRpc;
+
+
+
+static void
+destroyAsyncRpc(asyncRpc * const rpcP) {
+
+    xmlrpc_env_clean(&rpcP->fault);
+    rpcP->responseInP->destroy(rpcP->responseInP);
+    rpcP->lockP->destroy(rpcP->lockP);
+    free(rpcP);
+}
+
+
+
+static void
+sendAsyncResult(asyncRpc * const rpcP) {
+
+    if (rpcP->fault.fault_occurred)
+        sendFault(rpcP->abyssSessionP, &rpcP->fault);
+    else {
+        sendOutput(rpcP->abyssSessionP, rpcP->output,
+                   rpcP->wantChunk, rpcP->accessControl);
+
+        XMLRPC_MEMBLOCK_FREE(char, rpcP->output);
+    }
+}
+
+
+
+static xmlrpc_response_fn asyncRpcResponse;
+
+static void
+asyncRpcResponse(void *             const context,
+                 const xmlrpc_env * const faultP,
+                 xmlrpc_mem_block * const output) {
+/*----------------------------------------------------------------------------
+   This is the response function for an asynchronous call processor.
+
+   If the handler is still there, we give it the response to send.
+   Otherwise, we send it and finish the session.
+-----------------------------------------------------------------------------*/
+    asyncRpc * const rpcP = context;
+
+    bool deferred;
+
+    rpcP->lockP->acquire(rpcP->lockP);
+
+    if (faultP->fault_occurred)
+        xmlrpc_env_set_fault(&rpcP->fault,
+                             faultP->fault_code, faultP->fault_string);
+    else
+        rpcP->output = output;
+
+    rpcP->responseIn = true;
+
+    deferred = rpcP->deferred;
+
+    if (!deferred)
+        rpcP->responseInP->signal(rpcP->responseInP);
+
+    rpcP->lockP->release(rpcP->lockP);
+
+    if (deferred) {
+        TSession * const abyssSessionP = rpcP->abyssSessionP;
+
+        sendAsyncResult(rpcP);
+
+        SessionSetHandlerData(abyssSessionP, NULL);
+
+        destroyAsyncRpc(rpcP);
+
+        SessionDeferredResponseDone(abyssSessionP);
+    }
+}
+
+
+
+static void
+createAsyncRpc(xmlrpc_env *      const envP,
+               TSession *        const abyssSessionP,
+               bool              const wantChunk,
+               ResponseAccessCtl const accessControl,
+               unsigned int      const callTimeoutMs,
+               const char *      const trace,
+               asyncRpc **       const rpcPP) {
+
+    asyncRpc * rpcP;
+
+    MALLOCVAR(rpcP);
+
+    if (rpcP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for RPC");
+    else {
+        rpcP->lockP = xmlrpc_lock_create();
+
+        if (rpcP->lockP == NULL)
+            xmlrpc_faultf(envP, "Unable to create lock for RPC");
+        else {
+            rpcP->responseInP = xmlrpc_condition_create();
+
+            if (rpcP->responseInP == NULL)
+                xmlrpc_faultf(envP, "Unable to create condition for RPC");
+            else {
+                rpcP->abyssSessionP = abyssSessionP;
+                rpcP->wantChunk     = wantChunk;
+                rpcP->accessControl = accessControl;
+                rpcP->deferred      = false;
+                rpcP->responseIn    = false;
+                xmlrpc_env_init(&rpcP->fault);
+
+                initCallCtl(&rpcP->callCtl, abyssSessionP, callTimeoutMs,
+                            trace);
+
+                *rpcPP = rpcP;
+            }
+            if (envP->fault_occurred)
+                rpcP->lockP->destroy(rpcP->lockP);
+        }
+        if (envP->fault_occurred)
+            free(rpcP);
+    }
+}
+
+
+
+static void
+processCallAsync(xmlrpc_env *                const envP,
+                 TSession *                  const abyssSessionP,
+                 xmlrpc_mem_block *          const body,
+                 xmlrpc_call_processor_async       xmlProcessorAsync,
+                 void *                      const xmlProcessorArg,
+                 bool                        const wantChunk,
+                 ResponseAccessCtl           const accessControl,
+                 unsigned int                const callTimeoutMs,
+                 const char *                const trace) {
+/*----------------------------------------------------------------------------
+   Process the RPC whose XML is 'body' with asynchronous call processor
+   'xmlProcessorAsync' and send the response.
+
+   If the processor hasn't responded by the time it returns, we defer the
+   response, so the connection's thread is free while the call executes,
+   and the processor's response function sends the response.  If Abyss
+   can't defer a response, we wait for it.
+-----------------------------------------------------------------------------*/
+    asyncRpc * rpcP;
+
+    createAsyncRpc(envP, abyssSessionP, wantChunk, accessControl,
+                   callTimeoutMs, trace, &rpcP);
+
+    if (!envP->fault_occurred) {
+        bool deferred;
+
+        SessionSetHandlerData(abyssSessionP, &rpcP->callCtl);
+
+        xmlProcessorAsync(xmlProcessorArg,
+                          XMLRPC_MEMBLOCK_CONTENTS(char, body),
+                          XMLRPC_MEMBLOCK_SIZE(char, body),
+                          abyssSessionP, &rpcP->callCtl,
+                          &asyncRpcResponse, rpcP);
+
+        rpcP->lockP->acquire(rpcP->lockP);
+
+        if (!rpcP->responseIn) {
+            if (SessionDeferResponse(abyssSessionP)) {
+                if (trace)
+                    fprintf(stderr, "Call is pending.  Deferring the "
+                            "response\n");
+                rpcP->deferred = true;
+            } else {
+                while (!rpcP->responseIn)
+                    rpcP->responseInP->wait(rpcP->responseInP, rpcP->lockP);
+            }
+        }
+        deferred = rpcP->deferred;
+
+        rpcP->lockP->release(rpcP->lockP);
+
+        /* If we deferred the response, *rpcP and the session may be gone
+           already.
+        */
+        if (!deferred) {
+            SessionSetHandlerData(abyssSessionP, NULL);
+
+            sendAsyncResult(rpcP);
+
+            destroyAsyncRpc(rpcP);
+        }
+    }
+}
+
+
+
 static void
 processCall(TSession *            const abyssSessionP,
             size_t                const contentSize,
             xmlrpc_call_processor       xmlProcessor,
+            xmlrpc_call_processor_async xmlProcessorAsync,
             void *                const xmlProcessorArg,
             bool                  const wantChunk,
             ResponseAccessCtl     const accessControl,
+            unsigned int          const callTimeoutMs,
             const char *          const trace) {
 /*----------------------------------------------------------------------------
    Handle an RPC request.  This is an HTTP request that has the proper form
@@ -357,6 +715,13 @@ processCall(TSession *            const abyssSessionP,
    'abyssSessionP'.
 
    Its content length is 'contentSize' bytes.
+
+   We process the call with 'xmlProcessorAsync' if there is one, and
+   otherwise with 'xmlProcessor'.
+
+   While the processor runs, the call control for the call is available
+   from the session via xmlrpc_server_abyss_call_ctl().  'callTimeoutMs' is
+   the deadline it has if the client doesn't ask for a sooner one.
 -----------------------------------------------------------------------------*/
     xmlrpc_env env;
 
@@ -375,36 +740,42 @@ processCall(TSession *            const abyssSessionP,
         /* Read XML data off the wire. */
         getBody(&env, abyssSessionP, contentSize, trace, &body);
         if (!env.fault_occurred) {
-            xmlrpc_mem_block * output;
-
-            /* Process the RPC. */
-            xmlProcessor(
-                &env, xmlProcessorArg,
-                XMLRPC_MEMBLOCK_CONTENTS(char, body),
-                XMLRPC_MEMBLOCK_SIZE(char, body),
-                abyssSessionP,
-                &output);
-            if (!env.fault_occurred) {
-                /* Send out the result. */
-                sendResponse(&env, abyssSessionP, 
-                             XMLRPC_MEMBLOCK_CONTENTS(char, output),
-                             XMLRPC_MEMBLOCK_SIZE(char, output),
-                             wantChunk, accessControl);
+            if (xmlProcessorAsync)
+                processCallAsync(&env, abyssSessionP, body,
+                                 xmlProcessorAsync, xmlProcessorArg,
+                                 wantChunk, accessControl, callTimeoutMs,
+                                 trace);
+            else {
+                xmlrpc_call_ctl callCtl;
+                xmlrpc_mem_block * output;
+
+                initCallCtl(&callCtl, abyssSessionP, callTimeoutMs, trace);
+
+                SessionSetHandlerData(abyssSessionP, &callCtl);
+
+                /* Process the RPC. */
+                xmlProcessor(
+                    &env, xmlProcessorArg,
+                    XMLRPC_MEMBLOCK_CONTENTS(char, body),
+                    XMLRPC_MEMBLOCK_SIZE(char, body),
+                    abyssSessionP,
+                    &output);
+
+                SessionSetHandlerData(abyssSessionP, NULL);
+
+                if (!env.fault_occurred) {
+                    /* Send out the result. */
+                    sendOutput(abyssSessionP, output,
+                               wantChunk, accessControl);
                 
-                XMLRPC_MEMBLOCK_FREE(char, output);
+                    XMLRPC_MEMBLOCK_FREE(char, output);
+                }
             }
             XMLRPC_MEMBLOCK_FREE(char, body);
         }
     }
-    if (env.fault_occurred) {
-        uint16_t httpResponseStatus;
-        if (env.fault_code == XMLRPC_TIMEOUT_ERROR)
-            httpResponseStatus = 408;  /* Request Timeout */
-        else
-            httpResponseStatus = 500;  /* Internal Server Error */
-
-        sendError(abyssSessionP, httpResponseStatus, env.fault_string);
-    }
+    if (env.fault_occurred)
+        sendFault(abyssSessionP, &env);
 
     xmlrpc_env_clean(&env);
 }
@@ -454,9 +825,11 @@ static void
 handleXmlRpcCallReq(TSession *           const abyssSessionP,
                     const TRequestInfo * const requestInfoP ATTR_UNUSED,
                     xmlrpc_call_processor      xmlProcessor,
+                    xmlrpc_call_processor_async xmlProcessorAsync,
                     void *               const xmlProcessorArg,
                     bool                 const wantChunk,
-                    ResponseAccessCtl    const accessControl) {
+                    ResponseAccessCtl    const accessControl,
+                    unsigned int         const callTimeoutMs) {
 /*----------------------------------------------------------------------------
    Handle the HTTP request described by *requestInfoP, which arrived over
    Abyss HTTP session *abyssSessionP, which is an XML-RPC call
@@ -496,8 +869,8 @@ handleXmlRpcCallReq(TSession *           const abyssSessionP,
                           "XML-RPC call.");
             else
                 processCall(abyssSessionP, contentSize,
-                            xmlProcessor, xmlProcessorArg,
-                            wantChunk, accessControl,
+                            xmlProcessor, xmlProcessorAsync, xmlProcessorArg,
+                            wantChunk, accessControl, callTimeoutMs,
                             trace_abyss);
         }
     }
@@ -561,9 +934,11 @@ xmlrpc_handleIfXmlrpcReq(void *        const handlerArg,
         case m_post:
             handleXmlRpcCallReq(abyssSessionP, requestInfoP,
                                 uriHandlerXmlrpcP->xmlProcessor,
+                                uriHandlerXmlrpcP->xmlProcessorAsync,
                                 uriHandlerXmlrpcP->xmlProcessorArg,
                                 uriHandlerXmlrpcP->chunkResponse,
-                                uriHandlerXmlrpcP->accessControl);
+                                uriHandlerXmlrpcP->accessControl,
+                                uriHandlerXmlrpcP->callTimeoutMs);
             break;
         case m_options:
             handleXmlRpcOptionsReq(abyssSessionP,
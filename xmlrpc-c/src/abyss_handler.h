@@ -15,8 +15,16 @@ struct uriHandlerXmlrpc {
     bool                    chunkResponse;
         /* The handler should chunk its response whenever possible */
     xmlrpc_call_processor * xmlProcessor;
+    xmlrpc_call_processor_async * xmlProcessorAsync;
+        /* If non-null, we process calls with this instead of
+           'xmlProcessor'.
+        */
     void *                  xmlProcessorArg;
     ResponseAccessCtl       accessControl;
+    unsigned int            callTimeoutMs;
+        /* How long we let a call run if the client doesn't say how long
+           it will wait for the result.  Zero means forever.
+        */
 };
 
 
@@ -0,0 +1,447 @@
+/*=============================================================================
+                                 admission
+===============================================================================
+  Admission control for method calls: concurrency limits and priority
+  lanes.  See admission.h.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition.h"
+#include "xmlrpc-c/condition_platform.h"
+
+#include "admission.h"
+
+#define LANE_CT 3
+    /* One for each value of xmlrpc_priority */
+
+typedef struct waiter {
+/*----------------------------------------------------------------------------
+   A call waiting to execute.  It lives on the stack of the thread that
+   is making the call.
+-----------------------------------------------------------------------------*/
+    struct waiter * nextP;
+    xmlrpc_admissionMethod * methodP;
+    bool admitted;
+        /* We have let the call execute, so it isn't in a lane anymore */
+} waiter;
+
+typedef struct {
+    waiter * headP;
+        /* The call that has waited longest */
+    waiter ** tailPP;
+        /* Where to link the next call to wait */
+} lane;
+
+struct xmlrpc_admission {
+    lock * lockP;
+        /* Protects everything below and every xmlrpc_admissionMethod */
+    condition * admittedP;
+        /* Signalled when we let waiting calls execute */
+    unsigned int maxConcurrent;
+        /* Registry-wide limit on executing calls.  Zero means none. */
+    unsigned int runningCt;
+        /* Executing calls that count against 'maxConcurrent' */
+    lane lane[LANE_CT];
+        /* Indexed by xmlrpc_priority */
+};
+
+
+
+void
+xmlrpc_admissionCreate(xmlrpc_env *               const envP,
+                       struct xmlrpc_admission ** const admissionPP) {
+
+    struct xmlrpc_admission * admissionP;
+
+    MALLOCVAR(admissionP);
+
+    if (admissionP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for admission "
+                      "control");
+    else {
+        admissionP->lockP = xmlrpc_lock_create();
+
+        if (admissionP->lockP == NULL)
+            xmlrpc_faultf(envP, "Unable to create lock for admission "
+                          "control");
+        else {
+            admissionP->admittedP = xmlrpc_condition_create();
+
+            if (admissionP->admittedP == NULL)
+                xmlrpc_faultf(envP, "Unable to create condition for "
+                              "admission control");
+            else {
+                unsigned int i;
+
+                for (i = 0; i < LANE_CT; ++i) {
+                    admissionP->lane[i].headP  = NULL;
+                    admissionP->lane[i].tailPP = &admissionP->lane[i].headP;
+                }
+                admissionP->maxConcurrent = 0;
+                admissionP->runningCt     = 0;
+
+                *admissionPP = admissionP;
+            }
+            if (envP->fault_occurred)
+                admissionP->lockP->destroy(admissionP->lockP);
+        }
+        if (envP->fault_occurred)
+            free(admissionP);
+    }
+}
+
+
+
+void
+xmlrpc_admissionDestroy(struct xmlrpc_admission * const admissionP) {
+/*----------------------------------------------------------------------------
+   No call may be executing or waiting.
+-----------------------------------------------------------------------------*/
+    admissionP->admittedP->destroy(admissionP->admittedP);
+    admissionP->lockP->destroy(admissionP->lockP);
+
+    free(admissionP);
+}
+
+
+
+void
+xmlrpc_admissionMethodInit(xmlrpc_admissionMethod * const methodP) {
+
+    methodP->limited               = false;
+    methodP->limits.maxConcurrent  = 0;
+    methodP->limits.maxQueued      = 0;
+    methodP->limits.queueTimeoutMs = 0;
+    methodP->limits.priority       = xmlrpc_priority_normal;
+    methodP->exempt                = false;
+
+    methodP->stats.runningCt     = 0;
+    methodP->stats.queuedCt      = 0;
+    methodP->stats.admittedCt    = 0;
+    methodP->stats.waitedCt      = 0;
+    methodP->stats.rejectedCt    = 0;
+    methodP->stats.timedOutCt    = 0;
+    methodP->stats.waitTimeTotal = 0.0;
+    methodP->stats.waitTimeMax   = 0.0;
+}
+
+
+
+static bool
+canRun(const struct xmlrpc_admission * const admissionP,
+       const xmlrpc_admissionMethod *  const methodP) {
+
+    bool const methodHasRoom =
+        !methodP->limited ||
+        methodP->limits.maxConcurrent == 0 ||
+        methodP->stats.runningCt < methodP->limits.maxConcurrent;
+
+    bool const registryHasRoom =
+        methodP->exempt ||
+        admissionP->maxConcurrent == 0 ||
+        admissionP->runningCt < admissionP->maxConcurrent;
+
+    return methodHasRoom && registryHasRoom;
+}
+
+
+
+static void
+admit(struct xmlrpc_admission * const admissionP,
+      xmlrpc_admissionMethod *  const methodP) {
+
+    ++methodP->stats.runningCt;
+    ++methodP->stats.admittedCt;
+
+    if (!methodP->exempt)
+        ++admissionP->runningCt;
+}
+
+
+
+static void
+admitWaiters(struct xmlrpc_admission * const admissionP) {
+/*----------------------------------------------------------------------------
+   Let every waiting call that can execute now do so, highest lane first
+   and longest waiting first within a lane.
+-----------------------------------------------------------------------------*/
+    bool admittedAny;
+    unsigned int i;
+
+    for (i = 0, admittedAny = false; i < LANE_CT; ++i) {
+        lane * const laneP = &admissionP->lane[i];
+
+        waiter ** waiterPP;
+
+        for (waiterPP = &laneP->headP; *waiterPP; ) {
+            waiter * const waiterP = *waiterPP;
+
+            if (canRun(admissionP, waiterP->methodP)) {
+                *waiterPP = waiterP->nextP;
+
+                --waiterP->methodP->stats.queuedCt;
+                admit(admissionP, waiterP->methodP);
+                waiterP->admitted = true;
+                admittedAny = true;
+            } else
+                waiterPP = &waiterP->nextP;
+        }
+        laneP->tailPP = waiterPP;
+    }
+    if (admittedAny)
+        admissionP->admittedP->broadcast(admissionP->admittedP);
+}
+
+
+
+void
+xmlrpc_admissionSetLimits(struct xmlrpc_admission *           const admissionP,
+                          xmlrpc_admissionMethod *            const methodP,
+                          const struct xmlrpc_method_limits * const limitsP) {
+/*----------------------------------------------------------------------------
+   Calls that are waiting already stay in the lane they are in.
+-----------------------------------------------------------------------------*/
+    admissionP->lockP->acquire(admissionP->lockP);
+
+    methodP->limited = true;
+    methodP->limits  = *limitsP;
+
+    admitWaiters(admissionP);
+
+    admissionP->lockP->release(admissionP->lockP);
+}
+
+
+
+void
+xmlrpc_admissionSetMaxConcurrent(struct xmlrpc_admission * const admissionP,
+                                 unsigned int              const maxConcurrent) {
+
+    admissionP->lockP->acquire(admissionP->lockP);
+
+    admissionP->maxConcurrent = maxConcurrent;
+
+    admitWaiters(admissionP);
+
+    admissionP->lockP->release(admissionP->lockP);
+}
+
+
+
+static double
+secondsSince(xmlrpc_timespec const start) {
+
+    xmlrpc_timespec now;
+
+    xmlrpc_gettimeofday(&now);
+
+    return (double)now.tv_sec - start.tv_sec +
+        ((double)now.tv_nsec - start.tv_nsec) / 1E9;
+}
+
+
+
+static void
+unlinkWaiter(lane *   const laneP,
+             waiter * const waiterP) {
+
+    waiter ** waiterPP;
+
+    for (waiterPP = &laneP->headP; *waiterPP != waiterP;
+         waiterPP = &(*waiterPP)->nextP);
+
+    *waiterPP = waiterP->nextP;
+
+    if (!waiterP->nextP)
+        laneP->tailPP = waiterPP;
+}
+
+
+
+#define CANCEL_POLL_MS 1000
+    /* How often a waiting call checks whether its caller has gone away */
+
+
+
+static void
+waitForAdmission(xmlrpc_env *              const envP,
+                 struct xmlrpc_admission * const admissionP,
+                 xmlrpc_admissionMethod *  const methodP,
+                 const char *              const methodName,
+                 xmlrpc_call_ctl *         const ctlP) {
+/*----------------------------------------------------------------------------
+   Wait in the method's lane until admitWaiters() lets the call execute,
+   the method's queue timeout passes, or the call is cancelled (per *ctlP;
+   NULL means it can't be).
+
+   We hold the lock.
+-----------------------------------------------------------------------------*/
+    unsigned int const timeoutMs =
+        methodP->limited ? methodP->limits.queueTimeoutMs : 0;
+    lane * const laneP =
+        &admissionP->lane[methodP->limited ? methodP->limits.priority :
+                          xmlrpc_priority_normal];
+
+    xmlrpc_timespec startTime;
+    waiter me;
+    bool timedOut;
+    bool cancelled;
+    double waitTime;
+
+    xmlrpc_gettimeofday(&startTime);
+
+    me.nextP    = NULL;
+    me.methodP  = methodP;
+    me.admitted = false;
+
+    *laneP->tailPP = &me;
+    laneP->tailPP  = &me.nextP;
+    ++methodP->stats.queuedCt;
+
+    for (timedOut = false, cancelled = false, waitTime = 0.0;
+         !me.admitted && !timedOut && !cancelled; ) {
+
+        double timeLeft;
+            /* Seconds we may wait before we have to look again; negative
+               means forever
+            */
+
+        timeLeft = timeoutMs > 0 ? timeoutMs / 1000.0 - waitTime : -1.0;
+
+        if (ctlP && ctlP->deadline != 0.0) {
+            double const deadlineLeft = xmlrpc_call_time_left(ctlP);
+            if (timeLeft < 0 || deadlineLeft < timeLeft)
+                timeLeft = deadlineLeft;
+        }
+        if (ctlP && ctlP->peerGone &&
+            (timeLeft < 0 || timeLeft > CANCEL_POLL_MS / 1000.0))
+            timeLeft = CANCEL_POLL_MS / 1000.0;
+
+        if (timeLeft < 0)
+            admissionP->admittedP->wait(admissionP->admittedP,
+                                        admissionP->lockP);
+        else if (timeLeft > 0)
+            admissionP->admittedP->timedWait(
+                admissionP->admittedP, admissionP->lockP,
+                (unsigned int)(timeLeft * 1000) + 1);
+
+        waitTime = secondsSince(startTime);
+
+        if (!me.admitted) {
+            timedOut = timeoutMs > 0 && waitTime >= timeoutMs / 1000.0;
+            cancelled = xmlrpc_call_cancelled(ctlP);
+        }
+    }
+    if (me.admitted) {
+        ++methodP->stats.waitedCt;
+        methodP->stats.waitTimeTotal += waitTime;
+        if (waitTime > methodP->stats.waitTimeMax)
+            methodP->stats.waitTimeMax = waitTime;
+    } else {
+        unlinkWaiter(laneP, &me);
+        --methodP->stats.queuedCt;
+        ++methodP->stats.timedOutCt;
+
+        if (timedOut)
+            xmlrpc_env_set_fault_formatted(
+                envP, XMLRPC_TIMEOUT_ERROR,
+                "Call of method '%s' waited %u milliseconds to execute, "
+                "which is the limit", methodName, timeoutMs);
+        else
+            xmlrpc_env_set_fault_formatted(
+                envP, XMLRPC_TIMEOUT_ERROR,
+                "Call of method '%s' was cancelled while waiting to "
+                "execute", methodName);
+    }
+}
+
+
+
+void
+xmlrpc_admissionEnter(xmlrpc_env *              const envP,
+                      struct xmlrpc_admission * const admissionP,
+                      xmlrpc_admissionMethod *  const methodP,
+                      const char *              const methodName,
+                      xmlrpc_call_ctl *         const ctlP,
+                      bool *                    const admittedP) {
+/*----------------------------------------------------------------------------
+   Get permission for a call of method *methodP to execute, waiting for
+   it if necessary.  Fail if we can't get it, including when the call is
+   cancelled (per *ctlP) while it waits.
+
+   Return *admittedP true iff the call counts as executing, so Caller must
+   call xmlrpc_admissionLeave() when it is done.  When the method isn't
+   subject to any limit, it doesn't.
+-----------------------------------------------------------------------------*/
+    if (!methodP->limited &&
+        (methodP->exempt || admissionP->maxConcurrent == 0)) {
+        /* Nothing to control; don't bother with the lock */
+        *admittedP = false;
+    } else {
+        admissionP->lockP->acquire(admissionP->lockP);
+
+        if (canRun(admissionP, methodP))
+            admit(admissionP, methodP);
+        else if (methodP->limited &&
+                 methodP->stats.queuedCt >= methodP->limits.maxQueued) {
+            ++methodP->stats.rejectedCt;
+
+            xmlrpc_env_set_fault_formatted(
+                envP, XMLRPC_LIMIT_EXCEEDED_ERROR,
+                "Method '%s' is busy: %u calls of it are executing and "
+                "%u are waiting to execute, which is the limit",
+                methodName, methodP->stats.runningCt,
+                methodP->stats.queuedCt);
+        } else
+            waitForAdmission(envP, admissionP, methodP, methodName, ctlP);
+
+        admissionP->lockP->release(admissionP->lockP);
+
+        *admittedP = !envP->fault_occurred;
+    }
+}
+
+
+
+void
+xmlrpc_admissionLeave(struct xmlrpc_admission * const admissionP,
+                      xmlrpc_admissionMethod *  const methodP) {
+/*----------------------------------------------------------------------------
+   A call xmlrpc_admissionEnter() admitted is done executing.
+-----------------------------------------------------------------------------*/
+    admissionP->lockP->acquire(admissionP->lockP);
+
+    --methodP->stats.runningCt;
+
+    if (!methodP->exempt)
+        --admissionP->runningCt;
+
+    admitWaiters(admissionP);
+
+    admissionP->lockP->release(admissionP->lockP);
+}
+
+
+
+void
+xmlrpc_admissionGetStats(struct xmlrpc_admission *          const admissionP,
+                         const xmlrpc_admissionMethod *     const methodP,
+                         struct xmlrpc_method_queue_stats * const statsP) {
+
+    admissionP->lockP->acquire(admissionP->lockP);
+
+    *statsP = methodP->stats;
+
+    admissionP->lockP->release(admissionP->lockP);
+}
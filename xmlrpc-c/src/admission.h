@@ -0,0 +1,66 @@
+#ifndef ADMISSION_H_INCLUDED
+#define ADMISSION_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/server.h"
+
+/* Admission control decides when a call of a method may execute, according
+   to the concurrency limits of the method and of the registry (see
+   xmlrpc_registry_set_method_limits()).  A registry has one admission
+   control object; each of its methods has an xmlrpc_admissionMethod.
+*/
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   What admission control knows about one method.  The admission control
+   object's lock protects all of it.
+-----------------------------------------------------------------------------*/
+    bool limited;
+        /* The method has limits of its own, 'limits' */
+    struct xmlrpc_method_limits limits;
+    bool exempt;
+        /* The method's calls don't count against the registry-wide limit */
+    struct xmlrpc_method_queue_stats stats;
+        /* Includes the current number of executing and waiting calls */
+} xmlrpc_admissionMethod;
+
+struct xmlrpc_admission;
+
+void
+xmlrpc_admissionCreate(xmlrpc_env *               const envP,
+                       struct xmlrpc_admission ** const admissionPP);
+
+void
+xmlrpc_admissionDestroy(struct xmlrpc_admission * const admissionP);
+
+void
+xmlrpc_admissionMethodInit(xmlrpc_admissionMethod * const methodP);
+
+void
+xmlrpc_admissionSetLimits(struct xmlrpc_admission *           const admissionP,
+                          xmlrpc_admissionMethod *            const methodP,
+                          const struct xmlrpc_method_limits * const limitsP);
+
+void
+xmlrpc_admissionSetMaxConcurrent(struct xmlrpc_admission * const admissionP,
+                                 unsigned int              const maxConcurrent);
+
+void
+xmlrpc_admissionEnter(xmlrpc_env *              const envP,
+                      struct xmlrpc_admission * const admissionP,
+                      xmlrpc_admissionMethod *  const methodP,
+                      const char *              const methodName,
+                      xmlrpc_call_ctl *         const ctlP,
+                      bool *                    const admittedP);
+
+void
+xmlrpc_admissionLeave(struct xmlrpc_admission * const admissionP,
+                      xmlrpc_admissionMethod *  const methodP);
+
+void
+xmlrpc_admissionGetStats(struct xmlrpc_admission *          const admissionP,
+                         const xmlrpc_admissionMethod *     const methodP,
+                         struct xmlrpc_method_queue_stats * const statsP);
+
+#endif
@@ -1,4 +1,5 @@
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/xmlparser.h"
 
 
@@ -27,8 +28,22 @@ xmlrpc_init(xmlrpc_env * const envP) {
     
     if (globallyInitialized == 0) {
         xml_init(envP);  /* Initialize the XML parser library */
+
+        if (!envP->fault_occurred) {
+            xmlrpc_buildInit(envP);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_decomposeInit(envP);
+
+                if (envP->fault_occurred)
+                    xmlrpc_buildTerm();
+            }
+            if (envP->fault_occurred)
+                xml_term();
+        }
     }
-    ++globallyInitialized;
+    if (!envP->fault_occurred)
+        ++globallyInitialized;
 }
 
 
@@ -45,6 +60,8 @@ xmlrpc_term(void) {
     --globallyInitialized;
 
     if (globallyInitialized == 0) {
+        xmlrpc_decomposeTerm();
+        xmlrpc_buildTerm();
         xml_term();
     }
 }
@@ -0,0 +1,96 @@
+/*=============================================================================
+                                  call_ctl
+===============================================================================
+  Deadlines and cancellation of calls being processed by a server.  See
+  xmlrpc_call_ctl in server.h.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+
+#include "bool.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+
+
+static double
+now(void) {
+
+    xmlrpc_timespec tod;
+
+    xmlrpc_gettimeofday(&tod);
+
+    return tod.tv_sec + tod.tv_nsec / 1E9;
+}
+
+
+
+void
+xmlrpc_call_ctl_init(xmlrpc_call_ctl * const ctlP,
+                     unsigned int      const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Set up *ctlP for a call whose caller waits 'timeoutMs' milliseconds from
+   now for the result.  Zero means it waits forever.
+
+   There is no way to tell whether the caller goes away; Caller may set
+   ctlP->peerGone to provide one.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(ctlP);
+
+    ctlP->deadline        = timeoutMs > 0 ? now() + timeoutMs / 1000.0 : 0.0;
+    ctlP->peerGone        = NULL;
+    ctlP->peerGoneContext = NULL;
+    ctlP->cancelled       = false;
+}
+
+
+
+void
+xmlrpc_call_cancel(xmlrpc_call_ctl * const ctlP) {
+/*----------------------------------------------------------------------------
+   Cancel the call: nobody wants its result anymore.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(ctlP);
+
+    ctlP->cancelled = true;
+}
+
+
+
+xmlrpc_bool
+xmlrpc_call_cancelled(xmlrpc_call_ctl * const ctlP) {
+/*----------------------------------------------------------------------------
+   Tell whether the call is cancelled: someone cancelled it, its deadline
+   has passed, or its caller has gone away.  The latter two cancel it.
+
+   'ctlP' NULL means the call has no control, so is never cancelled.
+-----------------------------------------------------------------------------*/
+    if (ctlP && !ctlP->cancelled) {
+        if (ctlP->deadline != 0.0 && now() >= ctlP->deadline)
+            ctlP->cancelled = true;
+        else if (ctlP->peerGone && ctlP->peerGone(ctlP->peerGoneContext))
+            ctlP->cancelled = true;
+    }
+    return ctlP && ctlP->cancelled;
+}
+
+
+
+double
+xmlrpc_call_time_left(const xmlrpc_call_ctl * const ctlP) {
+/*----------------------------------------------------------------------------
+   The number of seconds until the call's deadline; zero if it has passed.
+
+   The call must have a deadline.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(ctlP);
+    XMLRPC_ASSERT(ctlP->deadline != 0.0);
+
+    return MAX(0.0, ctlP->deadline - now());
+}
@@ -0,0 +1,358 @@
+/*=============================================================================
+                                  coalesce
+===============================================================================
+  Sharing of one execution among concurrent, identical calls of a method.
+  See coalesce.h.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition.h"
+#include "xmlrpc-c/condition_platform.h"
+
+#include "result_cache.h"
+#include "coalesce.h"
+
+typedef struct flight {
+/*----------------------------------------------------------------------------
+   A call that is executing, and the identical calls waiting for it
+-----------------------------------------------------------------------------*/
+    struct flight * nextP;
+        /* Next call in the coalescer's list of executing calls */
+    xmlrpc_resultCacheKey key;
+        /* Identifies the call's parameters */
+    unsigned int userCt;
+        /* Number of threads using this structure: the one executing the
+           call and the ones waiting for it.  The last one to finish
+           with it destroys it.
+        */
+    bool done;
+        /* The call has finished; 'fault' and 'resultP' tell how */
+    bool abandoned;
+        /* The executing call failed without executing, for reasons of its
+           own, and a waiting one must execute instead.
+        */
+    xmlrpc_env fault;
+    xmlrpc_value * resultP;
+        /* Our reference to the call's result, if it succeeded */
+} flight;
+
+struct xmlrpc_coalescer {
+    lock * lockP;
+        /* Protects everything below, and the flights */
+    condition * landedP;
+        /* Signalled when any call finishes or is abandoned */
+    flight * flightsP;
+        /* The calls that are executing now */
+};
+
+
+
+void
+xmlrpc_coalescerCreate(xmlrpc_env *               const envP,
+                       struct xmlrpc_coalescer ** const coalescerPP) {
+
+    struct xmlrpc_coalescer * coalescerP;
+
+    MALLOCVAR(coalescerP);
+
+    if (coalescerP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for coalescer");
+    else {
+        coalescerP->lockP = xmlrpc_lock_create();
+
+        if (coalescerP->lockP == NULL)
+            xmlrpc_faultf(envP, "Unable to create lock for coalescer");
+        else {
+            coalescerP->landedP = xmlrpc_condition_create();
+
+            if (coalescerP->landedP == NULL)
+                xmlrpc_faultf(envP, "Unable to create condition for "
+                              "coalescer");
+            else {
+                coalescerP->flightsP = NULL;
+
+                *coalescerPP = coalescerP;
+            }
+            if (envP->fault_occurred)
+                coalescerP->lockP->destroy(coalescerP->lockP);
+        }
+        if (envP->fault_occurred)
+            free(coalescerP);
+    }
+}
+
+
+
+void
+xmlrpc_coalescerDestroy(struct xmlrpc_coalescer * const coalescerP) {
+/*----------------------------------------------------------------------------
+   Destroy a coalescer.  No calls may be executing through it.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(coalescerP->flightsP == NULL);
+
+    coalescerP->landedP->destroy(coalescerP->landedP);
+    coalescerP->lockP->destroy(coalescerP->lockP);
+
+    free(coalescerP);
+}
+
+
+
+static flight *
+findFlight(struct xmlrpc_coalescer *     const coalescerP,
+           const xmlrpc_resultCacheKey * const keyP) {
+
+    const char * const keyBytes = XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP);
+    size_t const keySize = XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP);
+
+    flight * flightP;
+
+    for (flightP = coalescerP->flightsP;
+         flightP &&
+             !(flightP->key.hash == keyP->hash &&
+               XMLRPC_MEMBLOCK_SIZE(char, flightP->key.bytesP) == keySize &&
+               memcmp(XMLRPC_MEMBLOCK_CONTENTS(char, flightP->key.bytesP),
+                      keyBytes, keySize) == 0);
+         flightP = flightP->nextP);
+
+    return flightP;
+}
+
+
+
+static void
+unlinkFlight(struct xmlrpc_coalescer * const coalescerP,
+             flight *                  const flightP) {
+
+    flight ** flightPP;
+
+    for (flightPP = &coalescerP->flightsP; *flightPP != flightP;
+         flightPP = &(*flightPP)->nextP);
+
+    *flightPP = flightP->nextP;
+}
+
+
+
+static void
+releaseFlight(flight * const flightP) {
+/*----------------------------------------------------------------------------
+   Stop using *flightP.  Caller holds the coalescer's lock.
+-----------------------------------------------------------------------------*/
+    --flightP->userCt;
+
+    if (flightP->userCt == 0) {
+        if (!flightP->fault.fault_occurred)
+            xmlrpc_DECREF(flightP->resultP);
+        xmlrpc_env_clean(&flightP->fault);
+        xmlrpc_resultCacheKeyClean(&flightP->key);
+        free(flightP);
+    }
+}
+
+
+
+static void
+takeOutcome(xmlrpc_env *    const envP,
+            const flight *  const flightP,
+            xmlrpc_value ** const resultPP) {
+
+    if (flightP->fault.fault_occurred)
+        xmlrpc_env_set_fault(envP, flightP->fault.fault_code,
+                             flightP->fault.fault_string);
+    else {
+        xmlrpc_INCREF(flightP->resultP);
+        *resultPP = flightP->resultP;
+    }
+}
+
+
+
+static void
+runFlight(xmlrpc_env *              const envP,
+          struct xmlrpc_coalescer * const coalescerP,
+          flight *                  const flightP,
+          xmlrpc_coalescerFn *      const fn,
+          void *                    const arg,
+          xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Execute the call *flightP as fn(arg) on behalf of ourselves and everyone
+   waiting for it.  Caller holds the coalescer's lock, which we release
+   while the call executes, and is one of *flightP's users.
+
+   If fn(arg) fails without executing, the failure is ours alone: we return
+   it, but leave the flight to a waiting call, if there is one.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_value * resultP;
+    bool executed;
+
+    xmlrpc_env_init(&env);
+
+    coalescerP->lockP->release(coalescerP->lockP);
+
+    fn(&env, arg, &resultP, &executed);
+
+    coalescerP->lockP->acquire(coalescerP->lockP);
+
+    if (!executed && flightP->userCt > 1) {
+        XMLRPC_ASSERT(env.fault_occurred);
+
+        flightP->abandoned = true;
+
+        coalescerP->landedP->broadcast(coalescerP->landedP);
+
+        xmlrpc_env_set_fault(envP, env.fault_code, env.fault_string);
+    } else {
+        /* Calls that arrive from now on execute on their own */
+        unlinkFlight(coalescerP, flightP);
+
+        if (env.fault_occurred)
+            xmlrpc_env_set_fault(&flightP->fault,
+                                 env.fault_code, env.fault_string);
+        else
+            flightP->resultP = resultP;
+
+        flightP->done = true;
+
+        coalescerP->landedP->broadcast(coalescerP->landedP);
+
+        takeOutcome(envP, flightP, resultPP);
+    }
+    xmlrpc_env_clean(&env);
+
+    releaseFlight(flightP);
+}
+
+
+
+static void
+waitForFlight(xmlrpc_env *              const envP,
+              struct xmlrpc_coalescer * const coalescerP,
+              flight *                  const flightP,
+              xmlrpc_coalescerFn *      const fn,
+              void *                    const arg,
+              xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Wait for the executing call *flightP to finish and return its result.
+   If it is abandoned before it finishes, execute it ourselves as fn(arg).
+   Caller holds the coalescer's lock.
+-----------------------------------------------------------------------------*/
+    ++flightP->userCt;
+
+    while (!flightP->done && !flightP->abandoned)
+        coalescerP->landedP->wait(coalescerP->landedP, coalescerP->lockP);
+
+    if (flightP->done) {
+        takeOutcome(envP, flightP, resultPP);
+
+        releaseFlight(flightP);
+    } else {
+        /* We take over from the call that abandoned it */
+        flightP->abandoned = false;
+
+        runFlight(envP, coalescerP, flightP, fn, arg, resultPP);
+    }
+}
+
+
+
+static void
+executeFlight(xmlrpc_env *              const envP,
+              struct xmlrpc_coalescer * const coalescerP,
+              xmlrpc_resultCacheKey *   const keyP,
+              xmlrpc_coalescerFn *      const fn,
+              void *                    const arg,
+              xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Execute the call with key *keyP as fn(arg) on behalf of ourselves and
+   any identical calls that arrive before it finishes.  Caller holds the
+   coalescer's lock, which we release while the call executes.
+
+   We take ownership of *keyP.
+-----------------------------------------------------------------------------*/
+    flight * flightP;
+
+    MALLOCVAR(flightP);
+
+    if (flightP == NULL) {
+        bool executed;
+
+        xmlrpc_resultCacheKeyClean(keyP);
+
+        coalescerP->lockP->release(coalescerP->lockP);
+
+        fn(envP, arg, resultPP, &executed);
+
+        coalescerP->lockP->acquire(coalescerP->lockP);
+    } else {
+        flightP->key       = *keyP;
+        flightP->userCt    = 1;
+        flightP->done      = false;
+        flightP->abandoned = false;
+        xmlrpc_env_init(&flightP->fault);
+
+        flightP->nextP = coalescerP->flightsP;
+        coalescerP->flightsP = flightP;
+
+        runFlight(envP, coalescerP, flightP, fn, arg, resultPP);
+    }
+}
+
+
+
+void
+xmlrpc_coalescerCall(xmlrpc_env *              const envP,
+                     struct xmlrpc_coalescer * const coalescerP,
+                     xmlrpc_value *            const paramArrayP,
+                     xmlrpc_coalescerFn *      const fn,
+                     void *                    const arg,
+                     xmlrpc_value **           const resultPP) {
+/*----------------------------------------------------------------------------
+   Execute a call with parameters *paramArrayP as fn(arg), unless an
+   identical call is already executing, in which case wait for that one
+   and return its result or fault.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_resultCacheKey key;
+
+    xmlrpc_env_init(&env);
+
+    /* The key's dialect is irrelevant; all calls here use the same one */
+    xmlrpc_resultCacheMakeKey(&env, paramArrayP, xmlrpc_dialect_i8, &key);
+
+    if (env.fault_occurred) {
+        /* Parameters we can't compare; the call executes on its own */
+        bool executed;
+
+        fn(envP, arg, resultPP, &executed);
+    } else {
+        flight * flightP;
+
+        coalescerP->lockP->acquire(coalescerP->lockP);
+
+        flightP = findFlight(coalescerP, &key);
+
+        if (flightP) {
+            xmlrpc_resultCacheKeyClean(&key);
+
+            waitForFlight(envP, coalescerP, flightP, fn, arg, resultPP);
+        } else
+            executeFlight(envP, coalescerP, &key, fn, arg, resultPP);
+
+        coalescerP->lockP->release(coalescerP->lockP);
+    }
+    xmlrpc_env_clean(&env);
+}
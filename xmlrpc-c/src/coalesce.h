@@ -0,0 +1,41 @@
+#ifndef COALESCE_H_INCLUDED
+#define COALESCE_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/base.h"
+
+/* A coalescer makes concurrent, identical calls of one method share one
+   execution (see xmlrpc_registry_set_method_coalescing()).  While a call
+   is executing, a call with the same parameters waits for it and gets
+   its result, or its fault, instead of executing again.
+
+   A call can fail without executing, for reasons that belong to it rather
+   than to the parameters -- its own deadline, its caller disconnecting,
+   admission control refusing it.  The function reports that with
+   *executedP false, and then one of the waiting calls executes instead.
+*/
+
+struct xmlrpc_coalescer;
+
+typedef void xmlrpc_coalescerFn(xmlrpc_env *    const envP,
+                                void *          const arg,
+                                xmlrpc_value ** const resultPP,
+                                bool *          const executedP);
+
+void
+xmlrpc_coalescerCreate(xmlrpc_env *               const envP,
+                       struct xmlrpc_coalescer ** const coalescerPP);
+
+void
+xmlrpc_coalescerDestroy(struct xmlrpc_coalescer * const coalescerP);
+
+void
+xmlrpc_coalescerCall(xmlrpc_env *              const envP,
+                     struct xmlrpc_coalescer * const coalescerP,
+                     xmlrpc_value *            const paramArrayP,
+                     xmlrpc_coalescerFn *      const fn,
+                     void *                    const arg,
+                     xmlrpc_value **           const resultPP);
+
+#endif
@@ -159,6 +159,7 @@ struct clientXmlTransport_curl::constrOpt_impl {
         std::string  proxy_userpwd;
         xmlrpc_httpproxytype proxy_type;
         bool         gssapi_delegation;
+        std::string  unix_socket_path;
     } value;
     struct {
         bool network_interface;
@@ -188,6 +189,7 @@ struct clientXmlTransport_curl::constrOpt_impl {
         bool proxy_userpwd;
         bool proxy_type;
         bool gssapi_delegation;
+        bool unix_socket_path;
     } present;
 };
 
@@ -220,6 +222,7 @@ clientXmlTransport_curl::constrOpt_impl::constrOpt_impl() {
     present.proxy_userpwd     = false;
     present.proxy_type        = false;
     present.gssapi_delegation = false;
+    present.unix_socket_path  = false;
 }
 
 
@@ -259,6 +262,7 @@ DEFINE_OPTION_SETTER(proxy_auth, unsigned int);
 DEFINE_OPTION_SETTER(proxy_userpwd, string);
 DEFINE_OPTION_SETTER(proxy_type, xmlrpc_httpproxytype);
 DEFINE_OPTION_SETTER(gssapi_delegation, bool);
+DEFINE_OPTION_SETTER(unix_socket_path, string);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -345,6 +349,8 @@ clientXmlTransport_curl::initialize(constrOpt const& optExt) {
         opt.value.proxy_type                : XMLRPC_HTTPPROXY_HTTP;
     transportParms.gssapi_delegation = opt.present.gssapi_delegation ?
         opt.value.gssapi_delegation         : false;
+    transportParms.unix_socket_path  = opt.present.unix_socket_path ?
+        opt.value.unix_socket_path.c_str()  : NULL;
 
     this->c_transportOpsP = &xmlrpc_curl_transport_ops;
 
@@ -352,7 +358,7 @@ clientXmlTransport_curl::initialize(constrOpt const& optExt) {
 
     xmlrpc_curl_transport_ops.create(
         &env.env_c, 0, "", "",
-        &transportParms, XMLRPC_CXPSIZE(gssapi_delegation),
+        &transportParms, XMLRPC_CXPSIZE(unix_socket_path),
         &this->c_transportP);
 
     if (env.env_c.fault_occurred)
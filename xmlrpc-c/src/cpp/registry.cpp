@@ -2,6 +2,9 @@
 #include <string>
 #include <memory>
 #include <algorithm>
+#include <map>
+
+#include "xmlrpc_config.h"
 
 #include "xmlrpc-c/girerr.hpp"
 using girerr::throwf;
@@ -9,6 +12,9 @@ using girerr::throwf;
 using girmem::autoObject;
 using girmem::autoObjectPtr;
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/base.hpp"
 #include "env_wrap.hpp"
 
@@ -18,7 +24,7 @@ using namespace std;
 using namespace xmlrpc_c;
 
 
-callInfo::callInfo() {
+callInfo::callInfo() : callCtlP(NULL) {
 
     // Even though this is the builtin default default constructor, we need
     // this because some compilers won't use the builtin default to construct
@@ -26,9 +32,41 @@ callInfo::callInfo() {
 }
 
 
+
+callInfo::callInfo(xmlrpc_call_ctl * const callCtlP) : callCtlP(callCtlP) {}
+
+
+
 callInfo::~callInfo() {}
 
 
+
+bool
+callInfo::cancelled() const {
+
+    return xmlrpc_call_cancelled(this->callCtlP);
+}
+
+
+
+bool
+callInfo::hasDeadline() const {
+
+    return this->callCtlP && this->callCtlP->deadline != 0.0;
+}
+
+
+
+double
+callInfo::timeLeft() const {
+
+    if (!this->hasDeadline())
+        throwf("Call has no deadline");
+
+    return xmlrpc_call_time_left(this->callCtlP);
+}
+
+
 namespace {
 
 void
@@ -88,6 +126,47 @@ method2::execute(xmlrpc_c::paramList const& paramList,
 
 
 
+completion::completion(xmlrpc_call_completion * const c_completionP) :
+    c_completionP(c_completionP) {}
+
+
+
+void
+completion::complete(value const& result) const {
+
+    xmlrpc_call_complete(this->c_completionP, result.cValue());
+}
+
+
+
+void
+completion::fail(fault const& fault) const {
+
+    xmlrpc_call_fail(this->c_completionP, fault.getCode(),
+                     fault.getDescription().c_str());
+}
+
+
+
+asyncMethod::asyncMethod() {}
+
+
+
+asyncMethod::~asyncMethod() {}
+
+
+
+void
+asyncMethod::execute(xmlrpc_c::paramList const&,
+                     xmlrpc_c::value *   const) {
+/*----------------------------------------------------------------------------
+   The registry never calls this; it calls the asynchronous execute().
+-----------------------------------------------------------------------------*/
+    throwf("Asynchronous method called synchronously");
+}
+
+
+
 defaultMethod::~defaultMethod() {}
 
 
@@ -119,17 +198,70 @@ defaultMethodPtr::get() const {
 
 
 
+struct registeredMethod {
+/*----------------------------------------------------------------------------
+   A method in the registry, with what we need to know to execute a call
+   of it.  We figure that out once, when the method is added, rather than
+   on every call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_c::methodPtr methodP;
+        // This maintains a reference to the method object so that it
+        // continues to exist.
+
+    xmlrpc_c::method * plainMethodP;
+        // The method object
+
+    xmlrpc_c::method2 * method2P;
+        // The method object, if it is a 'method2'.  NULL otherwise.
+
+    xmlrpc_c::asyncMethod * asyncMethodP;
+        // The method object, if it is an 'asyncMethod'.  NULL otherwise.
+
+    bool native;
+        // We execute calls of this method ourselves, without going through
+        // the C registry.  We don't for an asynchronous method or one that
+        // uses something only the C registry implements: concurrency
+        // limits, response caching, call coalescing, or signature checking.
+
+    struct xmlrpc_methodInfo * c_methodP;
+        // The C registry's record of the method, in whose statistics we
+        // count the calls we execute ourselves.
+
+    registeredMethod(xmlrpc_c::methodPtr const& methodP);
+};
+
+
+
+registeredMethod::registeredMethod(methodPtr const& methodP) :
+    methodP(methodP),
+    plainMethodP(dynamic_cast<method *>(methodP.get())),
+    method2P(dynamic_cast<method2 *>(methodP.get())),
+    asyncMethodP(dynamic_cast<asyncMethod *>(methodP.get())),
+    native(!this->asyncMethodP),
+    c_methodP(NULL) {}
+
+
+
 struct registry_impl {
 
     xmlrpc_registry * c_registryP;
         // Pointer to the C registry object we use to implement this
         // object.
 
-    std::list<xmlrpc_c::methodPtr> methodList;
-        // This is a list of all the method objects (actually, pointers
-        // to them).  But since the real registry is the C registry object,
-        // all this list is for is to maintain references to the objects
-        // to which the C registry points so that they continue to exist.
+    typedef std::map<std::string, registeredMethod> methodMap;
+
+    methodMap methods;
+        // All the methods, by name.  The C registry has them too, with
+        // a pointer to the entry here as the method data.  We execute
+        // the 'native' ones without it when we can.
+
+    bool nativeDispatch;
+        // We may execute calls of 'native' methods ourselves.  False when
+        // there is a limit on the number of calls of all methods together,
+        // which only the C registry enforces.
+
+    xmlrpc_dialect dialect;
+        // The dialect in which we generate responses
 
     xmlrpc_c::defaultMethodPtr defaultMethodP;
         // The real identifier of the default method is the C registry
@@ -140,11 +272,16 @@ struct registry_impl {
     registry_impl();
 
     ~registry_impl();
+
+    void
+    setNotNative(std::string const& name);
 };
 
 
 
-registry_impl::registry_impl() {
+registry_impl::registry_impl() :
+    nativeDispatch(true),
+    dialect(xmlrpc_dialect_i8) {
 
     env_wrap env;
 
@@ -161,6 +298,20 @@ registry_impl::~registry_impl() {
 }
 
 
+void
+registry_impl::setNotNative(string const& name) {
+/*----------------------------------------------------------------------------
+   Leave calls of method 'name' to the C registry from now on, because it
+   uses something only the C registry implements.
+-----------------------------------------------------------------------------*/
+    methodMap::iterator const p(this->methods.find(name));
+
+    if (p != this->methods.end())
+        p->second.native = false;
+}
+
+
+
 registry::registry() {
 
     this->implP = new registry_impl();
@@ -237,6 +388,50 @@ pListFromXmlrpcArray(xmlrpc_value * const arrayP) {
 
 
 
+static void
+executeMethod(registeredMethod const& method,
+              paramList        const& paramList,
+              const callInfo * const  callInfoP,
+              xmlrpc_env *     const  faultP,
+              value *          const  resultP) {
+/*----------------------------------------------------------------------------
+   Execute a call of synchronous method 'method'.
+
+   Return the result as *resultP, or the failure as *faultP.  Since a C
+   caller can't take an exception, we catch anything the method's execute()
+   method throws and make it a failure too.
+-----------------------------------------------------------------------------*/
+    try {
+        try {
+            if (method.method2P)
+                method.method2P->execute(paramList, callInfoP, resultP);
+            else 
+                method.plainMethodP->execute(paramList, resultP);
+        } catch (xmlrpc_c::fault const& fault) {
+            xmlrpc_env_set_fault(faultP, fault.getCode(), 
+                                 fault.getDescription().c_str()); 
+        }
+        if (!faultP->fault_occurred && !resultP->isInstantiated())
+            throwf("Xmlrpc-c user's xmlrpc_c::method object's "
+                   "'execute method' failed to set the RPC result "
+                   "value.");
+    } catch (exception const& e) {
+        xmlrpc_faultf(faultP, "Unexpected error executing code for "
+                      "particular method, detected by Xmlrpc-c "
+                      "method registry code.  Method did not "
+                      "fail; rather, it did not complete at all.  %s",
+                      e.what());
+    } catch (...) {
+        xmlrpc_env_set_fault(faultP, XMLRPC_INTERNAL_ERROR,
+                             "Unexpected error executing code for "
+                             "particular method, detected by Xmlrpc-c "
+                             "method registry code.  Method did not "
+                             "fail; rather, it did not complete at all.");
+    }
+}
+
+
+
 static xmlrpc_value *
 c_executeMethod(xmlrpc_env *   const envP,
                 xmlrpc_value * const paramArrayP,
@@ -246,65 +441,81 @@ c_executeMethod(xmlrpc_env *   const envP,
    This is a function designed to be called via a C registry to
    execute an XML-RPC method, but use a C++ method object to do the
    work.  You register this function as the method function and a
-   pointer to the C++ method object as the method data in the C
-   registry.
+   pointer to the 'registeredMethod' for the C++ method object as the
+   method data in the C registry.
 
-   If we had a pure C++ registry, this would be unnecessary.
-
-   Since we can't throw an error back to the C code, we catch anything
-   the XML-RPC method's execute() method throws, and any error we
-   encounter in processing the result it returns, and turn it into an
-   XML-RPC method failure.  This will cause a leak if the execute()
-   method actually created a result, since it will not get destroyed.
+   The registry executes calls of most methods without this (see
+   processCallNative()); we're for the ones it leaves to the C registry.
 
    This function is of type 'xmlrpc_method2'.
 -----------------------------------------------------------------------------*/
-    method * const methodP(static_cast<method *>(methodPtr));
-    paramList const paramList(pListFromXmlrpcArray(paramArrayP));
+    registeredMethod * const methodP(
+        static_cast<registeredMethod *>(methodPtr));
     callInfo * const callInfoP(static_cast<callInfo *>(callInfoPtr));
 
     xmlrpc_value * retval;
     retval = NULL; // silence used-before-set warning
 
     try {
+        paramList const paramList(pListFromXmlrpcArray(paramArrayP));
         value result;
 
-        try {
-            method2 * const method2P(dynamic_cast<method2 *>(methodP));
-            if (method2P)
-                method2P->execute(paramList, callInfoP, &result);
-            else 
-                methodP->execute(paramList, &result);
-        } catch (xmlrpc_c::fault const& fault) {
-            xmlrpc_env_set_fault(envP, fault.getCode(), 
-                                 fault.getDescription().c_str()); 
-        }
-        if (!envP->fault_occurred) {
-            if (result.isInstantiated())
-                retval = result.cValue();
-            else
-                throwf("Xmlrpc-c user's xmlrpc_c::method object's "
-                       "'execute method' failed to set the RPC result "
-                       "value.");
-        }
+        executeMethod(*methodP, paramList, callInfoP, envP, &result);
+
+        if (!envP->fault_occurred)
+            retval = result.cValue();
     } catch (exception const& e) {
         xmlrpc_faultf(envP, "Unexpected error executing code for "
                       "particular method, detected by Xmlrpc-c "
-                      "method registry code.  Method did not "
-                      "fail; rather, it did not complete at all.  %s",
-                      e.what());
-    } catch (...) {
-        xmlrpc_env_set_fault(envP, XMLRPC_INTERNAL_ERROR,
-                             "Unexpected error executing code for "
-                             "particular method, detected by Xmlrpc-c "
-                             "method registry code.  Method did not "
-                             "fail; rather, it did not complete at all.");
+                      "method registry code.  %s", e.what());
     }
     return retval;
 }
  
 
 
+static void
+c_executeAsyncMethod(xmlrpc_value *           const paramArrayP,
+                     void *                   const methodPtr,
+                     void *                   const callInfoPtr,
+                     xmlrpc_call_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   Like c_executeMethod(), but for an asynchronous method ('asyncMethod').
+
+   This function is of type 'xmlrpc_async_method'.
+-----------------------------------------------------------------------------*/
+    asyncMethod * const methodP(
+        static_cast<registeredMethod *>(methodPtr)->asyncMethodP);
+    callInfo * const callInfoP(static_cast<callInfo *>(callInfoPtr));
+
+    assert(methodP);
+
+    try {
+        paramList const paramList(pListFromXmlrpcArray(paramArrayP));
+
+        methodP->execute(paramList, callInfoP, completion(completionP));
+
+    } catch (xmlrpc_c::fault const& fault) {
+        xmlrpc_call_fail(completionP, fault.getCode(), 
+                         fault.getDescription().c_str()); 
+    } catch (exception const& e) {
+        string const msg(string(
+            "Unexpected error executing code for particular method, "
+            "detected by Xmlrpc-c method registry code.  Method did not "
+            "fail; rather, it did not complete at all.  ") + e.what());
+
+        xmlrpc_call_fail(completionP, XMLRPC_INTERNAL_ERROR, msg.c_str());
+    } catch (...) {
+        xmlrpc_call_fail(completionP, XMLRPC_INTERNAL_ERROR,
+                         "Unexpected error executing code for "
+                         "particular method, detected by Xmlrpc-c "
+                         "method registry code.  Method did not "
+                         "fail; rather, it did not complete at all.");
+    }
+}
+
+
+
 static xmlrpc_value *
 c_executeDefaultMethod(xmlrpc_env *   const envP,
                        const char *   const , // host
@@ -372,22 +583,52 @@ void
 registry::addMethod(string    const name,
                     methodPtr const methodP) {
 
-    this->implP->methodList.push_back(methodP);
+    pair<registry_impl::methodMap::iterator, bool> const inserted(
+        this->implP->methods.insert(
+            registry_impl::methodMap::value_type(
+                name, registeredMethod(methodP))));
 
-    struct xmlrpc_method_info3 methodInfo;
-    env_wrap env;
+    if (!inserted.second)
+        throwf("Method named '%s' already registered", name.c_str());
+
+    registeredMethod * const registeredP(&inserted.first->second);
 
-    methodInfo.methodName      = name.c_str();
-    methodInfo.methodFunction  = &c_executeMethod;
-    methodInfo.serverInfo      = methodP.get();
-    methodInfo.stackSize       = 0;
+    env_wrap env;
     string const signatureString(methodP->signature());
-    methodInfo.signatureString = signatureString.c_str();
     string const help(methodP->help());
-    methodInfo.help            = help.c_str();
+
+    if (registeredP->asyncMethodP) {
+        struct xmlrpc_async_method_info methodInfo;
+
+        methodInfo.methodName      = name.c_str();
+        methodInfo.methodFunction  = &c_executeAsyncMethod;
+        methodInfo.serverInfo      = registeredP;
+        methodInfo.stackSize       = 0;
+        methodInfo.signatureString = signatureString.c_str();
+        methodInfo.help            = help.c_str();
+
+        xmlrpc_registry_add_async_method(&env.env_c,
+                                         this->implP->c_registryP,
+                                         &methodInfo);
+    } else {
+        struct xmlrpc_method_info3 methodInfo;
+
+        methodInfo.methodName      = name.c_str();
+        methodInfo.methodFunction  = &c_executeMethod;
+        methodInfo.serverInfo      = registeredP;
+        methodInfo.stackSize       = 0;
+        methodInfo.signatureString = signatureString.c_str();
+        methodInfo.help            = help.c_str();
     
-	xmlrpc_registry_add_method3(&env.env_c, this->implP->c_registryP,
-                                &methodInfo);
+        xmlrpc_registry_add_method3(&env.env_c, this->implP->c_registryP,
+                                    &methodInfo);
+    }
+    if (!env.env_c.fault_occurred)
+        xmlrpc_registry_find_method(&env.env_c, this->implP->c_registryP,
+                                    name.c_str(), &registeredP->c_methodP);
+
+    if (env.env_c.fault_occurred)
+        this->implP->methods.erase(inserted.first);
 
     throwIfError(env);
 }
@@ -460,53 +701,498 @@ registry::setDialect(xmlrpc_dialect const dialect) {
     xmlrpc_registry_set_dialect(&env.env_c, this->implP->c_registryP, dialect);
 
     throwIfError(env);
+
+    this->implP->dialect = dialect;
 }
 
 
 
 void
-registry::processCall(string           const& callXml,
-                      const callInfo * const  callInfoP,
-                      string *         const  responseXmlP) const {
+registry::setMethodLimits(string                      const& name,
+                          struct xmlrpc_method_limits const& limits) {
 /*----------------------------------------------------------------------------
-   Process an XML-RPC call whose XML is 'callXml'.
+   Set concurrency limits for calls of method 'name'.  See
+   xmlrpc_registry_set_method_limits().
+-----------------------------------------------------------------------------*/
+    env_wrap env;
 
-   Return the response XML as *responseXmlP.
+    xmlrpc_registry_set_method_limits(&env.env_c, this->implP->c_registryP,
+                                      name.c_str(), &limits);
 
-   If we are unable to execute the call, we throw an error.  But if
-   the call executes and the method merely fails in an XML-RPC sense, we
-   don't.  In that case, *responseXmlP indicates the failure.
+    throwIfError(env);
+
+    this->implP->setNotNative(name);
+}
+
+
+
+void
+registry::setMaxConcurrent(unsigned int const maxConcurrent) {
+
+    xmlrpc_registry_set_max_concurrent(this->implP->c_registryP,
+                                       maxConcurrent);
+
+    this->implP->nativeDispatch = (maxConcurrent == 0);
+}
+
+
+
+struct xmlrpc_method_queue_stats
+registry::methodQueueStats(string const& name) const {
+
+    env_wrap env;
+    struct xmlrpc_method_queue_stats stats;
+
+    xmlrpc_registry_get_method_queue_stats(
+        &env.env_c, this->implP->c_registryP, name.c_str(), &stats);
+
+    throwIfError(env);
+
+    return stats;
+}
+
+
+
+void
+registry::setParallelMulticall(unsigned int const threadCt,
+                               unsigned int const maxPerCall) {
+/*----------------------------------------------------------------------------
+   Execute the parallel-safe calls of a system.multicall concurrently.  See
+   xmlrpc_registry_set_parallel_multicall().
 -----------------------------------------------------------------------------*/
     env_wrap env;
-    xmlrpc_mem_block * response;
 
-    // For the pure C++ version, this will have to parse 'callXml'
-    // into a method name and parameters, look up the method name in
-    // the registry, call the method's execute() method, then marshall
-    // the result into XML and return it as *responseXmlP.  It will
-    // also have to execute system methods (e.g. introspection)
-    // itself.  This will be more or less like what
-    // xmlrpc_registry_process_call() does.
+    xmlrpc_registry_set_parallel_multicall(
+        &env.env_c, this->implP->c_registryP, threadCt, maxPerCall);
 
-    xmlrpc_registry_process_call2(
-        &env.env_c, this->implP->c_registryP,
-        callXml.c_str(), callXml.length(),
-        const_cast<callInfo *>(callInfoP),
-        &response);
+    throwIfError(env);
+}
+
+
+
+void
+registry::setMethodParallelSafe(string const& name,
+                                bool   const  safe) {
+
+    env_wrap env;
+
+    xmlrpc_registry_set_method_parallel_safe(
+        &env.env_c, this->implP->c_registryP, name.c_str(), safe);
+
+    throwIfError(env);
+}
+
+
+
+void
+registry::setMethodCheckSignature(string const& name,
+                                  bool   const  check) {
+/*----------------------------------------------------------------------------
+   Make the registry reject calls of method 'name' whose parameters don't
+   match its signature.  See xmlrpc_registry_set_method_check_signature().
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+
+    xmlrpc_registry_set_method_check_signature(
+        &env.env_c, this->implP->c_registryP, name.c_str(), check);
+
+    throwIfError(env);
+
+    this->implP->setNotNative(name);
+}
+
+
+
+void
+registry::setMethodCoalescing(string const& name,
+                              bool   const  coalesce) {
+/*----------------------------------------------------------------------------
+   Make identical concurrent calls of method 'name' share one execution.
+   See xmlrpc_registry_set_method_coalescing().
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+
+    xmlrpc_registry_set_method_coalescing(
+        &env.env_c, this->implP->c_registryP, name.c_str(), coalesce);
+
+    throwIfError(env);
+
+    this->implP->setNotNative(name);
+}
+
+
+
+void
+registry::setMethodCache(string                           const& name,
+                         struct xmlrpc_method_cache_parms const& parms) {
+/*----------------------------------------------------------------------------
+   Cache the responses of method 'name'.  See
+   xmlrpc_registry_set_method_cache().
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+
+    xmlrpc_registry_set_method_cache(&env.env_c, this->implP->c_registryP,
+                                     name.c_str(), &parms);
+
+    throwIfError(env);
+
+    this->implP->setNotNative(name);
+}
+
+
+
+struct xmlrpc_method_cache_stats
+registry::methodCacheStats(string const& name) const {
+
+    env_wrap env;
+    struct xmlrpc_method_cache_stats stats;
+
+    xmlrpc_registry_get_method_cache_stats(
+        &env.env_c, this->implP->c_registryP, name.c_str(), &stats);
 
     throwIfError(env);
 
-    *responseXmlP = string(XMLRPC_MEMBLOCK_CONTENTS(char, response),
-                           XMLRPC_MEMBLOCK_SIZE(char, response));
+    return stats;
+}
+
+
+
+struct xmlrpc_method_stats
+registry::methodStats(string const& name) const {
+/*----------------------------------------------------------------------------
+   Return statistics on the calls of method 'name'.  See
+   xmlrpc_registry_get_method_stats().
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+    struct xmlrpc_method_stats stats;
+
+    xmlrpc_registry_get_method_stats(
+        &env.env_c, this->implP->c_registryP, name.c_str(), &stats);
+
+    throwIfError(env);
+
+    return stats;
+}
+
+
+
+namespace {
+
+class parsedCall {
+/*----------------------------------------------------------------------------
+   A call, as parsed by the C library
+-----------------------------------------------------------------------------*/
+public:
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+
+    parsedCall(env_wrap & env,
+               string const& callXml) {
+
+        xmlrpc_parse_call(&env.env_c, callXml.c_str(), callXml.size(),
+                          &this->methodName, &this->paramArrayP);
+        this->parsed = !env.env_c.fault_occurred;
+    }
+
+    ~parsedCall() {
+        if (this->parsed) {
+            xmlrpc_strfree(this->methodName);
+            xmlrpc_DECREF(this->paramArrayP);
+        }
+    }
+
+private:
+    bool parsed;
+};
+
+
+
+double
+secondsSince(xmlrpc_timespec const& start) {
+
+    xmlrpc_timespec now;
+
+    xmlrpc_gettimeofday(&now);
+
+    double const seconds((double)now.tv_sec - start.tv_sec +
+                         ((double)now.tv_nsec - start.tv_nsec) / 1E9);
+
+    // The clock may have been set back
+    return seconds < 0 ? 0 : seconds;
+}
+
+
+
+void
+makeResponse(xmlrpc_dialect     const  dialect,
+             xmlrpc_env         const& fault,
+             value              const& result,
+             string *           const  responseXmlP) {
+/*----------------------------------------------------------------------------
+   Make the XML of the response to a call that ended in fault 'fault' or,
+   if that isn't a failure, returned 'result'.
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+    xmlrpc_mem_block * const responseP(
+        XMLRPC_MEMBLOCK_NEW(char, &env.env_c, 0));
+
+    throwIfError(env);
+
+    if (fault.fault_occurred)
+        xmlrpc_serialize_fault(&env.env_c, responseP, &fault);
+    else {
+        xmlrpc_value * const c_resultP(result.cValue());
+
+        xmlrpc_serialize_response2(&env.env_c, responseP, c_resultP, dialect);
+
+        xmlrpc_DECREF(c_resultP);
+    }
+    if (!env.env_c.fault_occurred) {
+        xmlrpc_traceXml("XML-RPC RESPONSE",
+                        XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                        XMLRPC_MEMBLOCK_SIZE(char, responseP));
+
+        *responseXmlP = string(XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                               XMLRPC_MEMBLOCK_SIZE(char, responseP));
+    }
+    xmlrpc_mem_block_free(responseP);
+
+    throwIfError(env);
+}
+
+
+
+void
+executeNative(registry_impl    const& impl,
+              registeredMethod const& method,
+              parsedCall       const& call,
+              const callInfo * const  callInfoP,
+              double           const  parseTime,
+              string *         const  responseXmlP) {
+/*----------------------------------------------------------------------------
+   Execute call 'call' of method 'method' and make the response, all
+   without the C registry -- just telling it when the call starts and how
+   long it took, for the method statistics.
+
+   If the call is already cancelled (see callInfo::cancelled()), don't
+   execute it; respond with a timeout fault as the C registry would.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_call_times times;
+    xmlrpc_timespec startTime;
+    env_wrap fault;
+    value result;
+
+    times.parseTime = parseTime;
+
+    xmlrpc_registry_native_call_begin(method.c_methodP);
+
+    xmlrpc_gettimeofday(&startTime);
+
+    if (callInfoP && callInfoP->cancelled())
+        xmlrpc_env_set_fault_formatted(
+            &fault.env_c, XMLRPC_TIMEOUT_ERROR,
+            "Call of method '%s' was cancelled before it executed.  "
+            "Its deadline passed or its caller went away", call.methodName);
+    else
+        executeMethod(method, pListFromXmlrpcArray(call.paramArrayP),
+                      callInfoP, &fault.env_c, &result);
+
+    times.executeTime = secondsSince(startTime);
+
+    xmlrpc_gettimeofday(&startTime);
+
+    try {
+        makeResponse(impl.dialect, fault.env_c, result, responseXmlP);
+    } catch (...) {
+        times.serializeTime = secondsSince(startTime);
+
+        xmlrpc_registry_native_call_end(method.c_methodP, &times, true);
+
+        throw;
+    }
+    times.serializeTime = secondsSince(startTime);
+
+    xmlrpc_registry_native_call_end(method.c_methodP, &times,
+                                    fault.env_c.fault_occurred);
+}
+
+
+
+void
+makeParseFaultResponse(registry_impl const& impl,
+                       env_wrap      const& parseEnv,
+                       string *      const  responseXmlP) {
+/*----------------------------------------------------------------------------
+   Make the response to a call whose XML we couldn't parse, for reason
+   'parseEnv'.
+-----------------------------------------------------------------------------*/
+    env_wrap fault;
+
+    xmlrpc_env_set_fault_formatted(
+        &fault.env_c, XMLRPC_PARSE_ERROR,
+        "Call XML not a proper XML-RPC call.  %s",
+        parseEnv.env_c.fault_string);
+
+    makeResponse(impl.dialect, fault.env_c, value(), responseXmlP);
+}
+
+
+
+void
+processCallNative(registry_impl    const& impl,
+                  string           const& callXml,
+                  const callInfo * const  callInfoP,
+                  string *         const  responseXmlP) {
+/*----------------------------------------------------------------------------
+   Process an XML-RPC call whose XML is 'callXml', executing it ourselves
+   if it is a call of a 'native' method, and having the C registry do
+   it otherwise.
+
+   This saves, for the typical call, the C registry's method lookup and
+   its trampoline to the method object.
+-----------------------------------------------------------------------------*/
+    xmlrpc_traceXml("XML-RPC CALL", callXml.c_str(), callXml.size());
+
+    xmlrpc_timespec startTime;
+
+    xmlrpc_gettimeofday(&startTime);
+
+    env_wrap parseEnv;
+    parsedCall const call(parseEnv, callXml);
+
+    if (parseEnv.env_c.fault_occurred)
+        makeParseFaultResponse(impl, parseEnv, responseXmlP);
+    else {
+        double const parseTime(secondsSince(startTime));
+
+        registry_impl::methodMap::const_iterator const p(
+            impl.methods.find(call.methodName));
+
+        if (impl.nativeDispatch && p != impl.methods.end() &&
+            p->second.native)
+            executeNative(impl, p->second, call, callInfoP, parseTime,
+                          responseXmlP);
+        else {
+            env_wrap env;
+            xmlrpc_mem_block * response;
+
+            xmlrpc_registry_process_parsed_call(
+                &env.env_c, impl.c_registryP,
+                call.methodName, call.paramArrayP,
+                const_cast<callInfo *>(callInfoP),
+                callInfoP ? callInfoP->callCtlP : NULL, parseTime,
+                &response);
+
+            throwIfError(env);
+
+            *responseXmlP = string(XMLRPC_MEMBLOCK_CONTENTS(char, response),
+                                   XMLRPC_MEMBLOCK_SIZE(char, response));
     
-    xmlrpc_mem_block_free(response);
+            xmlrpc_mem_block_free(response);
+        }
+    }
 }
 
 
 
+xmlrpc_response_fn respondAsync;
+
 void
-registry::processCall(string   const& callXml,
-                      string * const  responseXmlP) const {
+respondAsync(void *             const context,
+             const xmlrpc_env * const faultP,
+             xmlrpc_mem_block * const responseXmlP) {
+/*----------------------------------------------------------------------------
+   This is the response function for a call processCallNativeAsync() leaves
+   to the C registry.
+-----------------------------------------------------------------------------*/
+    registry::responder * const responderP(
+        static_cast<registry::responder *>(context));
+
+    if (faultP->fault_occurred)
+        responderP->fail(faultP->fault_string);
+    else {
+        string const responseXml(
+            XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+            XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+
+        xmlrpc_mem_block_free(responseXmlP);
+
+        responderP->respond(responseXml);
+    }
+}
+
+
+
+void
+processCallNativeAsync(registry_impl         const& impl,
+                       string                const& callXml,
+                       const callInfo *      const  callInfoP,
+                       registry::responder * const  responderP) {
+/*----------------------------------------------------------------------------
+   Like processCallNative(), but instead of returning the response, give it
+   to *responderP.  For an asynchronous method, that may be after we
+   return, from another thread.
+-----------------------------------------------------------------------------*/
+    xmlrpc_traceXml("XML-RPC CALL", callXml.c_str(), callXml.size());
+
+    xmlrpc_timespec startTime;
+
+    xmlrpc_gettimeofday(&startTime);
+
+    env_wrap parseEnv;
+    parsedCall const call(parseEnv, callXml);
+
+    double const parseTime(secondsSince(startTime));
+
+    const registeredMethod * nativeMethodP;
+        // The method, if we execute the call ourselves
+
+    nativeMethodP = NULL;  // initial value
+
+    if (!parseEnv.env_c.fault_occurred && impl.nativeDispatch) {
+        registry_impl::methodMap::const_iterator const p(
+            impl.methods.find(call.methodName));
+
+        if (p != impl.methods.end() && p->second.native)
+            nativeMethodP = &p->second;
+    }
+
+    if (!parseEnv.env_c.fault_occurred && !nativeMethodP) {
+        // The C registry executes the call, maybe asynchronously
+        xmlrpc_registry_process_parsed_call_async(
+            impl.c_registryP,
+            call.methodName, call.paramArrayP,
+            const_cast<callInfo *>(callInfoP),
+            callInfoP ? callInfoP->callCtlP : NULL, parseTime,
+            &respondAsync, responderP);
+    } else {
+        string responseXml;
+        bool failed;
+
+        try {
+            if (parseEnv.env_c.fault_occurred)
+                makeParseFaultResponse(impl, parseEnv, &responseXml);
+            else
+                executeNative(impl, *nativeMethodP, call, callInfoP,
+                              parseTime, &responseXml);
+            failed = false;
+        } catch (exception const& e) {
+            responderP->fail(e.what());
+            failed = true;
+        }
+        if (!failed)
+            responderP->respond(responseXml);
+    }
+}
+
+} // namespace
+
+
+
+void
+registry::processCall(string           const& callXml,
+                      const callInfo * const  callInfoP,
+                      string *         const  responseXmlP) const {
 /*----------------------------------------------------------------------------
    Process an XML-RPC call whose XML is 'callXml'.
 
@@ -516,31 +1202,44 @@ registry::processCall(string   const& callXml,
    the call executes and the method merely fails in an XML-RPC sense, we
    don't.  In that case, *responseXmlP indicates the failure.
 -----------------------------------------------------------------------------*/
-    env_wrap env;
-    xmlrpc_mem_block * output;
+    processCallNative(*this->implP, callXml, callInfoP, responseXmlP);
+}
 
-    // For the pure C++ version, this will have to parse 'callXml'
-    // into a method name and parameters, look up the method name in
-    // the registry, call the method's execute() method, then marshall
-    // the result into XML and return it as *responseXmlP.  It will
-    // also have to execute system methods (e.g. introspection)
-    // itself.  This will be more or less like what
-    // xmlrpc_registry_process_call() does.
 
-    output = xmlrpc_registry_process_call(
-        &env.env_c, this->implP->c_registryP, NULL,
-        callXml.c_str(), callXml.length());
 
-    throwIfError(env);
+void
+registry::processCall(string   const& callXml,
+                      string * const  responseXmlP) const {
+/*----------------------------------------------------------------------------
+   Same as above, but with no call information.
+-----------------------------------------------------------------------------*/
+    processCallNative(*this->implP, callXml, NULL, responseXmlP);
+}
 
-    *responseXmlP = string(XMLRPC_MEMBLOCK_CONTENTS(char, output),
-                           XMLRPC_MEMBLOCK_SIZE(char, output));
-    
-    xmlrpc_mem_block_free(output);
+
+
+void
+registry::processCallAsync(string           const& callXml,
+                           const callInfo * const  callInfoP,
+                           responder *      const  responderP) const {
+/*----------------------------------------------------------------------------
+   Process an XML-RPC call whose XML is 'callXml' and give the response XML
+   to *responderP.
+
+   If the call is of an asynchronous method (see 'asyncMethod'), that may
+   be after we return, from another thread, so a server does not have to
+   dedicate a thread to the call.  *callInfoP and *responderP must remain
+   valid until then.
+-----------------------------------------------------------------------------*/
+    processCallNativeAsync(*this->implP, callXml, callInfoP, responderP);
 }
 
 
 
+registry::responder::~responder() {}
+
+
+
 #define PROCESS_CALL_STACK_SIZE 256
     // This is our liberal estimate of how much stack space
     // registry::processCall() needs, not counting what
@@ -169,6 +169,7 @@ public:
 callInfo_serverAbyss::callInfo_serverAbyss(
     serverAbyss * const serverAbyssP,
     TSession *    const abyssSessionP) :
+    callInfo(xmlrpc_server_abyss_call_ctl(abyssSessionP)),
     serverAbyssP(serverAbyssP), abyssSessionP(abyssSessionP) {}
 
 
@@ -197,6 +198,10 @@ struct serverAbyss::constrOpt_impl {
         std::string    logFileName;
         bool           serverOwnsSignals;
         bool           expectSigchld;
+        std::string    unixSocketPath;
+        bool           useIoUring;
+        unsigned int   workerProcesses;
+        unsigned int   callTimeout;
     } value;
     struct {
         bool registryPtr;
@@ -218,6 +223,10 @@ struct serverAbyss::constrOpt_impl {
         bool logFileName;
         bool serverOwnsSignals;
         bool expectSigchld;
+        bool unixSocketPath;
+        bool useIoUring;
+        bool workerProcesses;
+        bool callTimeout;
     } present;
 };
 
@@ -243,6 +252,10 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     present.sockAddrLen       = false;
     present.serverOwnsSignals = false;
     present.expectSigchld     = false;
+    present.unixSocketPath    = false;
+    present.useIoUring        = false;
+    present.workerProcesses   = false;
+    present.callTimeout       = false;
     
     // Set default values
     value.dontAdvertise     = false;
@@ -250,6 +263,8 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     value.chunkResponse     = false;
     value.serverOwnsSignals = true;
     value.expectSigchld     = false;
+    value.useIoUring        = false;
+    value.callTimeout       = 0;
 }
 
 
@@ -281,6 +296,10 @@ DEFINE_OPTION_SETTER(sockAddrLen,       socklen_t);
 DEFINE_OPTION_SETTER(logFileName,       string);
 DEFINE_OPTION_SETTER(serverOwnsSignals, bool);
 DEFINE_OPTION_SETTER(expectSigchld,     bool);
+DEFINE_OPTION_SETTER(unixSocketPath,    string);
+DEFINE_OPTION_SETTER(useIoUring,        bool);
+DEFINE_OPTION_SETTER(workerProcesses,   unsigned int);
+DEFINE_OPTION_SETTER(callTimeout,       unsigned int);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -397,14 +416,180 @@ processXmlrpcCall(xmlrpc_env *        const envP,
 
 
 
+class abyssResponder : public registry::responder {
+/*----------------------------------------------------------------------------
+   The receiver of the response to a call the Xmlrpc-c Abyss HTTP request
+   handler gave us, with the call information for the call.  It passes the
+   response to the handler's response function and destroys itself.
+-----------------------------------------------------------------------------*/
+public:
+    abyssResponder(callInfo *           const callInfoP,
+                   xmlrpc_response_fn * const responseFn,
+                   void *               const responseContext) :
+        callInfoP(callInfoP),
+        responseFn(responseFn),
+        responseContext(responseContext) {}
+
+    ~abyssResponder() {
+        delete this->callInfoP;
+    }
+
+    void
+    respond(string const& responseXml);
+
+    void
+    fail(string const& reason);
+
+    callInfo * const callInfoP;
+        // We own this
+
+private:
+    xmlrpc_response_fn * const responseFn;
+    void * const responseContext;
+
+    void
+    finish(xmlrpc_env const& fault,
+           xmlrpc_mem_block * const responseXmlP);
+};
+
+
+
+void
+abyssResponder::finish(xmlrpc_env         const& fault,
+                       xmlrpc_mem_block * const  responseXmlP) {
+
+    xmlrpc_response_fn * const responseFn(this->responseFn);
+    void * const responseContext(this->responseContext);
+
+    // The response function may end the HTTP session, which makes our
+    // call information invalid, so we go first.
+
+    delete this;
+
+    responseFn(responseContext, &fault, responseXmlP);
+}
+
+
+
+void
+abyssResponder::respond(string const& responseXml) {
+
+    env_wrap env;
+    xmlrpc_mem_block * responseMbP;
+
+    responseMbP = XMLRPC_MEMBLOCK_NEW(char, &env.env_c, 0);
+
+    if (!env.env_c.fault_occurred) {
+        XMLRPC_MEMBLOCK_APPEND(char, &env.env_c, responseMbP,
+                               responseXml.c_str(), responseXml.length());
+
+        if (env.env_c.fault_occurred)
+            XMLRPC_MEMBLOCK_FREE(char, responseMbP);
+    }
+    this->finish(env.env_c, env.env_c.fault_occurred ? NULL : responseMbP);
+}
+
+
+
+void
+abyssResponder::fail(string const& reason) {
+
+    env_wrap fault;
+
+    xmlrpc_env_set_fault(&fault.env_c, XMLRPC_INTERNAL_ERROR, reason.c_str());
+
+    this->finish(fault.env_c, NULL);
+}
+
+
+
+static void
+processCallAsync(const registry *     const registryP,
+                 const char *         const callXml,
+                 size_t               const callXmlLen,
+                 callInfo *           const callInfoP,
+                 xmlrpc_response_fn * const responseFn,
+                 void *               const responseContext) {
+/*----------------------------------------------------------------------------
+   Process the call 'callXml'/'callXmlLen' with registry *registryP, giving
+   the response to responseFn(responseContext, ...), maybe after we return.
+
+   We take ownership of *callInfoP.  Null 'callInfoP' means Caller couldn't
+   allocate it.
+-----------------------------------------------------------------------------*/
+    abyssResponder * responderP;
+
+    if (callInfoP) {
+        try {
+            responderP = new abyssResponder(callInfoP, responseFn,
+                                            responseContext);
+        } catch (exception const&) {
+            delete callInfoP;
+            responderP = NULL;
+        }
+    } else
+        responderP = NULL;
+
+    if (responderP) {
+        try {
+            string const call(callXml, callXmlLen);
+
+            registryP->processCallAsync(call, callInfoP, responderP);
+        } catch (exception const& e) {
+            // The registry didn't take the call, so *responderP is ours
+            responderP->fail(e.what());
+        }
+    } else {
+        env_wrap fault;
+
+        xmlrpc_faultf(&fault.env_c, "Unable to allocate memory for call");
+
+        responseFn(responseContext, &fault.env_c, NULL);
+    }
+}
+
+
+
+static xmlrpc_call_processor_async processXmlrpcCallAsync;
+
+static void
+processXmlrpcCallAsync(void *               const arg,
+                       const char *         const callXml,
+                       size_t               const callXmlLen,
+                       TSession *           const abyssSessionP,
+                       xmlrpc_call_ctl *    const,
+                       xmlrpc_response_fn * const responseFn,
+                       void *               const responseContext) {
+/*----------------------------------------------------------------------------
+   Like processXmlrpcCall(), but we may finish the call after we return,
+   giving the response to responseFn(responseContext, ...).
+-----------------------------------------------------------------------------*/
+    serverAbyss_impl * const implP(
+        static_cast<serverAbyss_impl *>(arg));
+
+    callInfo * callInfoP;
+
+    try {
+        callInfoP = new callInfo_serverAbyss(implP->serverAbyssP,
+                                             abyssSessionP);
+    } catch (exception const&) {
+        callInfoP = NULL;
+    }
+    processCallAsync(implP->registryP, callXml, callXmlLen, callInfoP,
+                     responseFn, responseContext);
+}
+
+
+
 static void
 validateListenOptions(serverAbyss::constrOpt_impl const& opt) {
     
     if ((opt.present.portNumber ? 1 : 0) +
         (opt.present.socketFd ? 1 : 0) +
-        (opt.present.sockAddrP ? 1 : 0) > 1)
+        (opt.present.sockAddrP ? 1 : 0) +
+        (opt.present.unixSocketPath ? 1 : 0) > 1)
         throwf("You can specify at most one of portNumber, socketFd, "
-               "and sockAddrP options");
+               "sockAddrP, and unixSocketPath options");
 
     if (opt.present.sockAddrP && !opt.present.sockAddrLen)
         throwf("You must specify the sockAddrLen option when you "
@@ -440,7 +625,8 @@ createServerFromSwitch(TServer *     const serverP,
 
 
 static TChanSwitch *
-newChanSwitchOsSocket(int const socketFd) {
+newChanSwitchOsSocket(int  const socketFd,
+                      bool const useIoUring) {
 
     TChanSwitch * chanSwitchP;
     const char * error;
@@ -448,7 +634,10 @@ newChanSwitchOsSocket(int const socketFd) {
 #ifdef WIN32
     ChanSwitchWinCreateWinsock(socketFd, &chanSwitchP, &error);
 #else
-    ChanSwitchUnixCreateFd(socketFd, &chanSwitchP, &error);
+    if (useIoUring)
+        ChanSwitchUringCreateFd(socketFd, &chanSwitchP, &error);
+    else
+        ChanSwitchUnixCreateFd(socketFd, &chanSwitchP, &error);
 #endif
 
     if (error) {
@@ -467,6 +656,7 @@ static void
 chanSwitchCreateSockAddr(int                     const protocolFamily,
                          const struct sockaddr * const sockAddrP,
                          socklen_t               const sockAddrLen,
+                         bool                    const useIoUring,
                          TChanSwitch **          const chanSwitchPP) {
 
     const char * error;
@@ -475,8 +665,12 @@ chanSwitchCreateSockAddr(int                     const protocolFamily,
     ChanSwitchWinCreate2(protocolFamily, sockAddrP, sockAddrLen, 
                           chanSwitchPP, &error);
 #else
-    ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen, 
-                          chanSwitchPP, &error);
+    if (useIoUring)
+        ChanSwitchUringCreate2(protocolFamily, sockAddrP, sockAddrLen,
+                               chanSwitchPP, &error);
+    else
+        ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen, 
+                              chanSwitchPP, &error);
 #endif
     if (error) {
         string const errorS(error);
@@ -489,7 +683,8 @@ chanSwitchCreateSockAddr(int                     const protocolFamily,
 
 
 static TChanSwitch *
-newChanSwitchSockAddr(SockAddr const& sockAddr) {
+newChanSwitchSockAddr(SockAddr const& sockAddr,
+                      bool     const  useIoUring) {
     
     int protocolFamily;
 
@@ -510,7 +705,7 @@ newChanSwitchSockAddr(SockAddr const& sockAddr) {
 
     chanSwitchCreateSockAddr(protocolFamily,
                              sockAddr.sockAddrP, sockAddr.sockAddrLen,
-                             &chanSwitchP);
+                             useIoUring, &chanSwitchP);
 
     return chanSwitchP;
 }
@@ -518,7 +713,8 @@ newChanSwitchSockAddr(SockAddr const& sockAddr) {
 
 
 static TChanSwitch *
-newChanSwitchIpV4Port(unsigned int const portNumber) {
+newChanSwitchIpV4Port(unsigned int const portNumber,
+                      bool         const useIoUring) {
     
     struct sockaddr_in sockAddr;
 
@@ -529,7 +725,7 @@ newChanSwitchIpV4Port(unsigned int const portNumber) {
     TChanSwitch * chanSwitchP;
 
     chanSwitchCreateSockAddr(PF_INET, (const struct sockaddr *)&sockAddr,
-                             sizeof(sockAddr),
+                             sizeof(sockAddr), useIoUring,
                              &chanSwitchP);
 
     return chanSwitchP;
@@ -537,6 +733,32 @@ newChanSwitchIpV4Port(unsigned int const portNumber) {
 
 
 
+static TChanSwitch *
+newChanSwitchLocal(string const& path) {
+
+    TChanSwitch * chanSwitchP;
+
+#ifdef WIN32
+    throwf("Unix domain sockets (unixSocketPath option) are not available "
+           "on Windows");
+#else
+    const char * error;
+
+    ChanSwitchUnixCreateLocal(path.c_str(), &chanSwitchP, &error);
+
+    if (error) {
+        string const errorS(error);
+        xmlrpc_strfree(error);
+
+        throwf("Abyss failed to create a channel switch for Unix domain "
+               "socket '%s'.  %s", path.c_str(), errorS.c_str());
+    }
+#endif
+    return chanSwitchP;
+}
+
+
+
 static void
 createServerBare(bool           const  logFileNameGiven,
                  string         const& logFileName,
@@ -546,20 +768,26 @@ createServerBare(bool           const  logFileNameGiven,
                  unsigned int   const  portNumber,
                  bool           const  sockAddrPGiven,
                  SockAddr       const& sockAddr,
+                 bool           const  unixSocketPathGiven,
+                 string         const& unixSocketPath,
+                 bool           const  useIoUring,
                  TServer *      const  serverP,
                  TChanSwitch ** const  chanSwitchPP) {
 
     const char * const serverName("XmlRpcServer");
 
-    if (socketFdGiven || sockAddrPGiven || portNumberGiven) {
+    if (socketFdGiven || sockAddrPGiven || portNumberGiven ||
+        unixSocketPathGiven) {
 
         TChanSwitch * const chanSwitchP(
             socketFdGiven ?
-                newChanSwitchOsSocket(socketFd) : 
+                newChanSwitchOsSocket(socketFd, useIoUring) : 
             sockAddrPGiven ? 
-                newChanSwitchSockAddr(sockAddr) :
+                newChanSwitchSockAddr(sockAddr, useIoUring) :
             portNumberGiven ?
-                newChanSwitchIpV4Port(portNumber) :
+                newChanSwitchIpV4Port(portNumber, useIoUring) :
+            unixSocketPathGiven ?
+                newChanSwitchLocal(unixSocketPath) :
                 NULL);
 
         assert(chanSwitchP);
@@ -611,6 +839,8 @@ setAdditionalServerParms(TServer *                   const  serverP,
     ServerSetAdvertise(serverP, !opt.value.dontAdvertise);
     if (opt.value.expectSigchld)
         ServerUseSigchld(serverP);
+    if (opt.present.workerProcesses)
+        ServerSetWorkerProcesses(serverP, opt.value.workerProcesses);
 }
 
 
@@ -624,7 +854,8 @@ setHttpReqHandlers(TServer *    const  serverP,
                    bool         const  doHttpAccessControl,
                    string       const& allowOrigin,
                    bool         const  accessCtlExpires,
-                   unsigned int const  accessCtlMaxAge) {
+                   unsigned int const  accessCtlMaxAge,
+                   unsigned int const  callTimeoutMs) {
 
     env_wrap env;
     xmlrpc_server_abyss_handler_parms parms;
@@ -637,10 +868,12 @@ setHttpReqHandlers(TServer *    const  serverP,
     parms.allow_origin = doHttpAccessControl ? allowOrigin.c_str() : NULL;
     parms.access_ctl_expires = accessCtlExpires;
     parms.access_ctl_max_age = accessCtlMaxAge;
+    parms.call_timeout_ms = callTimeoutMs;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
     xmlrpc_server_abyss_set_handler3(
         &env.env_c, serverP,
-        &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &parms, XMLRPC_AHPSIZE(xml_processor_async));
     
     if (env.env_c.fault_occurred)
         throwf("Failed to register the HTTP handler for XML-RPC "
@@ -667,6 +900,8 @@ createServer(serverAbyss::constrOpt_impl const& opt,
                      opt.present.portNumber,  opt.value.portNumber,
                      opt.present.sockAddrP,
                      SockAddr(opt.value.sockAddrP, opt.value.sockAddrLen),
+                     opt.present.unixSocketPath, opt.value.unixSocketPath,
+                     opt.value.useIoUring,
                      serverP, chanSwitchPP);
     
     try {
@@ -680,10 +915,11 @@ createServer(serverAbyss::constrOpt_impl const& opt,
                            opt.present.allowOrigin,
                            opt.value.allowOrigin,
                            opt.present.accessCtlMaxAge,
-                           opt.value.accessCtlMaxAge);
+                           opt.value.accessCtlMaxAge,
+                           opt.value.callTimeout);
 
         if (opt.present.portNumber || opt.present.socketFd ||
-            opt.present.sockAddrP)
+            opt.present.sockAddrP || opt.present.unixSocketPath)
             ServerInit(serverP);
     } catch (...) {
         ServerFree(serverP);
@@ -919,6 +1155,7 @@ serverAbyss::terminate() {
 
 
 callInfo_abyss::callInfo_abyss(TSession * const abyssSessionP) :
+    callInfo(xmlrpc_server_abyss_call_ctl(abyssSessionP)),
     abyssSessionP(abyssSessionP) {}
 
 
@@ -968,17 +1205,63 @@ processXmlrpcCall2(xmlrpc_env *        const envP,
 
 
 
+static xmlrpc_call_processor_async processXmlrpcCallAsync2;
+
+static void
+processXmlrpcCallAsync2(void *               const arg,
+                        const char *         const callXml,
+                        size_t               const callXmlLen,
+                        TSession *           const abyssSessionP,
+                        xmlrpc_call_ctl *    const,
+                        xmlrpc_response_fn * const responseFn,
+                        void *               const responseContext) {
+/*----------------------------------------------------------------------------
+   Like processXmlrpcCall2(), but we may finish the call after we return,
+   giving the response to responseFn(responseContext, ...).
+-----------------------------------------------------------------------------*/
+    const registry * const registryP(static_cast<registry *>(arg));
+
+    callInfo * callInfoP;
+
+    try {
+        callInfoP = new callInfo_abyss(abyssSessionP);
+    } catch (exception const&) {
+        callInfoP = NULL;
+    }
+    processCallAsync(registryP, callXml, callXmlLen, callInfoP,
+                     responseFn, responseContext);
+}
+
+
+
 static void
 setHandlers(TServer * const  serverP,
             string    const& uriPath,
             registry  const& registry) {
 
-    xmlrpc_server_abyss_set_handler2(
-        serverP, uriPath.c_str(),
-        processXmlrpcCall2,
-        const_cast<xmlrpc_c::registry *>(&registry),
-        registry.maxStackSize(),
-        false);
+    env_wrap env;
+    xmlrpc_server_abyss_handler_parms parms;
+
+    parms.xml_processor = &processXmlrpcCall2;
+    parms.xml_processor_arg = const_cast<xmlrpc_c::registry *>(&registry);
+    parms.xml_processor_max_stack = registry.maxStackSize();
+    parms.uri_path = uriPath.c_str();
+    parms.chunk_response = false;
+    parms.allow_origin = NULL;
+    parms.access_ctl_expires = false;
+    parms.access_ctl_max_age = 0;
+    parms.call_timeout_ms = 0;
+    parms.xml_processor_async = &processXmlrpcCallAsync2;
+
+    xmlrpc_server_abyss_set_handler3(
+        &env.env_c, serverP,
+        &parms, XMLRPC_AHPSIZE(xml_processor_async));
+
+    if (env.env_c.fault_occurred)
+        throwf("Failed to register the HTTP handler for XML-RPC "
+               "with the underlying Abyss HTTP server.  "
+               "xmlrpc_server_abyss_set_handler3() failed with:  %s",
+               env.env_c.fault_string);
 
     xmlrpc_server_abyss_set_default_handler(serverP);
 }
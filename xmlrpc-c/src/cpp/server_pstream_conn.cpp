@@ -26,6 +26,8 @@
 
 #include "xmlrpc-c/girerr.hpp"
 using girerr::throwf;
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition_platform.h"
 #include "xmlrpc-c/packetsocket.hpp"
 
 #include "xmlrpc-c/server_pstream.hpp"
@@ -108,6 +110,21 @@ struct serverPstreamConn_impl {
     processRecdPacket(packetPtr  const callPacketP,
                       callInfo * const callInfoP);
 
+    void
+    sendResponse(string const& responseXml);
+
+    void
+    finishCall(string const& failure);
+
+    bool
+    callIsPending();
+
+    void
+    waitForResponse();
+
+    void
+    checkResponse();
+
     // 'registryP' is what we actually use; 'registryHolder' just holds a
     // reference to 'registryP' so the registry doesn't disappear while
     // this server exists.  But note that if the creator doesn't supply
@@ -121,6 +138,20 @@ struct serverPstreamConn_impl {
     packetSocket * packetSocketP;
         // The packet socket over which we received RPCs.
         // This is permanently connected to our fixed client.
+
+    lock * lockP;
+        // Protects 'callPending' and 'failure'
+    condition * responseSentP;
+        // Signalled when 'callPending' goes false
+    bool callPending;
+        // We have given an RPC to the registry and not yet sent its
+        // response.  We don't read the next RPC until we have, so the
+        // client gets its responses in order.  An asynchronous method may
+        // send the response from another thread, after runOnceNoWait()
+        // has returned.
+    string failure;
+        // Why we failed to respond to the last RPC; null string if we
+        // didn't.
 };
 
 
@@ -131,12 +162,35 @@ serverPstreamConn_impl::serverPstreamConn_impl(
     this->establishRegistry(opt);
 
     this->establishPacketSocket(opt);
+
+    this->lockP = xmlrpc_lock_create();
+
+    if (this->lockP)
+        this->responseSentP = xmlrpc_condition_create();
+    else
+        this->responseSentP = NULL;
+
+    if (!this->responseSentP) {
+        if (this->lockP)
+            this->lockP->destroy(this->lockP);
+        delete(this->packetSocketP);
+        throwf("Failed to create the lock and condition for tracking "
+               "the RPC in progress");
+    }
+    this->callPending = false;
 }
 
 
 
 serverPstreamConn_impl::~serverPstreamConn_impl() {
 
+    // An asynchronous method may still be working on the last RPC, and
+    // will send its response through our packet socket.
+    this->waitForResponse();
+
+    this->responseSentP->destroy(this->responseSentP);
+    this->lockP->destroy(this->lockP);
+
     delete(this->packetSocketP);
 }
 
@@ -199,21 +253,125 @@ serverPstreamConn::~serverPstreamConn() {
 
 
 
-static void
-processCall(const registry * const  registryP,
-            packetPtr        const& callPacketP,
-            callInfo *       const  callInfoP,
-            packetPtr *      const  responsePacketPP) {
+class pstreamResponder : public registry::responder {
+/*----------------------------------------------------------------------------
+   Receiver of the response to the RPC a pstream connection server has in
+   progress.  It deletes itself when it gets it.
+-----------------------------------------------------------------------------*/
+public:
+    pstreamResponder(serverPstreamConn_impl * const implP) :
+        implP(implP) {}
 
-    string const callXml(reinterpret_cast<char *>(callPacketP->getBytes()),
-                         callPacketP->getLength());
+    void
+    respond(string const& responseXml) {
+
+        serverPstreamConn_impl * const implP(this->implP);
+
+        delete(this);
+
+        implP->sendResponse(responseXml);
+    }
+
+    void
+    fail(string const& reason) {
+
+        serverPstreamConn_impl * const implP(this->implP);
+
+        delete(this);
+
+        implP->finishCall("Error executing received packet as an "
+                          "XML-RPC RPC.  " + reason);
+    }
+
+private:
+    serverPstreamConn_impl * const implP;
+};
+
+
+
+void
+serverPstreamConn_impl::sendResponse(string const& responseXml) {
+/*----------------------------------------------------------------------------
+   Send the response to the RPC in progress and finish it.
+
+   We may run in any thread.
+-----------------------------------------------------------------------------*/
+    string failure;
+
+    try {
+        packetPtr const responsePacketP(
+            new packet(responseXml.c_str(), responseXml.length()));
+
+        this->packetSocketP->writeWait(responsePacketP);
+    } catch (exception const& e) {
+        failure = string("Failed to write the response to the packet "
+                         "socket.  ") + e.what();
+    }
+    this->finishCall(failure);
+}
+
+
+
+void
+serverPstreamConn_impl::finishCall(string const& failure) {
+/*----------------------------------------------------------------------------
+   Note that the RPC in progress is finished, having failed for reason
+   'failure' unless that is a null string.
+-----------------------------------------------------------------------------*/
+    this->lockP->acquire(this->lockP);
+
+    this->failure = failure;
+    this->callPending = false;
+
+    this->responseSentP->signal(this->responseSentP);
 
-    string responseXml;
+    this->lockP->release(this->lockP);
+}
+
+
+
+bool
+serverPstreamConn_impl::callIsPending() {
+
+    this->lockP->acquire(this->lockP);
+
+    bool const retval(this->callPending);
+
+    this->lockP->release(this->lockP);
+
+    return retval;
+}
+
+
+
+void
+serverPstreamConn_impl::waitForResponse() {
+/*----------------------------------------------------------------------------
+   Wait until we have responded to the RPC in progress, if any.
+-----------------------------------------------------------------------------*/
+    this->lockP->acquire(this->lockP);
+
+    while (this->callPending)
+        this->responseSentP->wait(this->responseSentP, this->lockP);
+
+    this->lockP->release(this->lockP);
+}
+
+
+
+void
+serverPstreamConn_impl::checkResponse() {
+/*----------------------------------------------------------------------------
+   Throw an error if we failed to respond to the last RPC.  There must not
+   be one in progress.
+-----------------------------------------------------------------------------*/
+    if (!this->failure.empty()) {
+        string const failure(this->failure);
 
-    registryP->processCall(callXml, callInfoP, &responseXml);
+        this->failure.clear();
 
-    *responsePacketPP = packetPtr(new packet(responseXml.c_str(),
-                                             responseXml.length()));
+        throwf("%s", failure.c_str());
+    }
 }
 
 
@@ -221,20 +379,29 @@ processCall(const registry * const  registryP,
 void
 serverPstreamConn_impl::processRecdPacket(packetPtr  const callPacketP,
                                           callInfo * const callInfoP) {
-    
-    packetPtr responsePacketP;
+/*----------------------------------------------------------------------------
+   Start executing the RPC in packet *callPacketP.
+
+   The response may not be sent by the time we return; if it is an
+   asynchronous method, it gets sent when the method completes the call,
+   and *callInfoP must remain valid until then.
+-----------------------------------------------------------------------------*/
+    string const callXml(reinterpret_cast<char *>(callPacketP->getBytes()),
+                         callPacketP->getLength());
+
+    pstreamResponder * const responderP(new pstreamResponder(this));
+
+    this->callPending = true;
+
     try {
-        processCall(this->registryP, callPacketP, callInfoP, &responsePacketP);
+        this->registryP->processCallAsync(callXml, callInfoP, responderP);
     } catch (exception const& e) {
+        // The registry didn't take the call, so *responderP is still ours
+        delete(responderP);
+        this->callPending = false;
         throwf("Error executing received packet as an XML-RPC RPC.  %s",
                e.what());
     }
-    try {
-        this->packetSocketP->writeWait(responsePacketP);
-    } catch (exception const& e) {
-        throwf("Failed to write the response to the packet socket.  %s",
-               e.what());
-    }
 }
 
 
@@ -247,7 +414,14 @@ serverPstreamConn::runOnce(callInfo *           const callInfoP,
    Get and execute one RPC from the client.
 
    Unless *interruptP gets set nonzero first.
+
+   If runOnceNoWait() left an RPC in progress, we wait for it to finish
+   first.  We don't return until we have sent the response to the one we
+   execute.
 -----------------------------------------------------------------------------*/
+    this->implP->waitForResponse();
+    this->implP->checkResponse();
+
     bool gotPacket;
     packetPtr callPacketP;
 
@@ -258,8 +432,12 @@ serverPstreamConn::runOnce(callInfo *           const callInfoP,
         throwf("Error reading a packet from the packet socket.  %s",
                e.what());
     }
-    if (gotPacket)
+    if (gotPacket) {
         this->implP->processRecdPacket(callPacketP, callInfoP);
+
+        this->implP->waitForResponse();
+        this->implP->checkResponse();
+    }
 }
 
 
@@ -293,18 +471,37 @@ serverPstreamConn::runOnceNoWait(callInfo * const callInfoP,
    Get and execute one RPC from the client, unless none has been
    received yet.  Return as *didOneP whether or not one has been
    received.  Unless didOneP is NULL.
+
+   If the RPC is of an asynchronous method, we return without waiting for
+   the method to finish the call; the response goes to the client when it
+   does, and *callInfoP must remain valid until then.  Until then, we don't
+   get another RPC from the client: we just return *didOneP false.
 -----------------------------------------------------------------------------*/
     bool gotPacket;
-    packetPtr callPacketP;
 
-    try {
-        this->implP->packetSocketP->read(eofP, &gotPacket, &callPacketP);
-    } catch (exception const& e) {
-        throwf("Error reading a packet from the packet socket.  %s",
-               e.what());
+    if (this->implP->callIsPending()) {
+        *eofP = false;
+        gotPacket = false;
+    } else {
+        this->implP->checkResponse();
+
+        packetPtr callPacketP;
+
+        try {
+            this->implP->packetSocketP->read(eofP, &gotPacket, &callPacketP);
+        } catch (exception const& e) {
+            throwf("Error reading a packet from the packet socket.  %s",
+                   e.what());
+        }
+        if (gotPacket) {
+            this->implP->processRecdPacket(callPacketP, callInfoP);
+
+            // A synchronous method has already responded; its failure
+            // is this call's.
+            if (!this->implP->callIsPending())
+                this->implP->checkResponse();
+        }
     }
-    if (gotPacket)
-        this->implP->processRecdPacket(callPacketP, callInfoP);
 
     if (didOneP)
         *didOneP = gotPacket;
@@ -34,6 +34,9 @@ signatureDestroy(struct xmlrpc_signature * const signatureP) {
     if (signatureP->argList)
         free((void*)signatureP->argList);
 
+    if (signatureP->argTypeList)
+        free(signatureP->argTypeList);
+
     free(signatureP);
 }
 
@@ -66,6 +69,31 @@ translateTypeSpecifierToName(xmlrpc_env *  const envP,
                 
 
 
+static xmlrpc_type
+typeOfSpecifier(char const typeSpecifier) {
+/*----------------------------------------------------------------------------
+   The type of value that type specifier 'typeSpecifier' means.  The
+   specifier is one translateTypeSpecifierToName() accepts.
+-----------------------------------------------------------------------------*/
+    switch (typeSpecifier) {
+    case 'i': return XMLRPC_TYPE_INT;
+    case 'b': return XMLRPC_TYPE_BOOL;
+    case 'd': return XMLRPC_TYPE_DOUBLE;
+    case 's': return XMLRPC_TYPE_STRING;
+    case '8': return XMLRPC_TYPE_DATETIME;
+    case '6': return XMLRPC_TYPE_BASE64;
+    case 'S': return XMLRPC_TYPE_STRUCT;
+    case 'A': return XMLRPC_TYPE_ARRAY;
+    case 'n': return XMLRPC_TYPE_NIL;
+    case 'I': return XMLRPC_TYPE_I8;
+    default:
+        assert(false);
+        return XMLRPC_TYPE_DEAD;
+    }
+}
+
+
+
 #if defined(_MSC_VER)
 /* MSVC 8 complains that const char ** is incompatible with void * in the
    REALLOCARRAY.  It's not.
@@ -81,11 +109,14 @@ makeRoomInArgList(xmlrpc_env *              const envP,
 
     if (signatureP->argListSpace < minArgCount) {
         REALLOCARRAY(signatureP->argList, minArgCount);
-        if (signatureP->argList == NULL) {
+        if (signatureP->argList)
+            REALLOCARRAY(signatureP->argTypeList, minArgCount);
+        if (signatureP->argList == NULL || signatureP->argTypeList == NULL) {
             xmlrpc_faultf(envP, "Couldn't get memory for a argument list for "
                           "a method signature with %u arguments", minArgCount);
             signatureP->argListSpace = 0;
-        }
+        } else
+            signatureP->argListSpace = minArgCount;
     }
 }
 
@@ -110,11 +141,14 @@ parseArgumentTypeSpecifiers(xmlrpc_env *              const envP,
         translateTypeSpecifierToName(envP, *cursorP, &typeName);
 
         if (!envP->fault_occurred) {
-            ++cursorP;
-
             makeRoomInArgList(envP, signatureP, signatureP->argCount + 1);
 
-            signatureP->argList[signatureP->argCount++] = typeName;
+            if (!envP->fault_occurred) {
+                signatureP->argTypeList[signatureP->argCount] =
+                    typeOfSpecifier(*cursorP);
+                signatureP->argList[signatureP->argCount++] = typeName;
+            }
+            ++cursorP;
         }
     }
     if (!envP->fault_occurred) {
@@ -123,8 +157,10 @@ parseArgumentTypeSpecifiers(xmlrpc_env *              const envP,
             ++cursorP;  /* Move past the signature and comma */
         }
     }
-    if (envP->fault_occurred) 
+    if (envP->fault_occurred) {
         free((void*)signatureP->argList);
+        free(signatureP->argTypeList);
+    }
 
     *nextPP = cursorP;
 }
@@ -156,6 +192,7 @@ parseOneSignature(xmlrpc_env *               const envP,
 
         signatureP->argListSpace = 0;  /* Start with no argument space */
         signatureP->argList = NULL;   /* Nothing allocated yet */
+        signatureP->argTypeList = NULL;
         signatureP->argCount = 0;  /* Start with no arguments */
 
         cursorP = startP;  /* start at the beginning */
@@ -306,6 +343,7 @@ void
 xmlrpc_methodCreate(xmlrpc_env *           const envP,
                     xmlrpc_method1               methodFnType1,
                     xmlrpc_method2               methodFnType2,
+                    xmlrpc_async_method          methodFnAsync,
                     void *                 const userData,
                     const char *           const signatureString,
                     const char *           const helpText,
@@ -324,12 +362,25 @@ xmlrpc_methodCreate(xmlrpc_env *           const envP,
     else {
         methodP->methodFnType1  = methodFnType1;
         methodP->methodFnType2  = methodFnType2;
+        methodP->methodFnAsync  = methodFnAsync;
         methodP->userData       = userData;
         methodP->helpText       = xmlrpc_strdupsol(helpText);
         methodP->stackSize      = stackSize;
+        methodP->parallelSafe   = false;
+        methodP->resultCacheP   = NULL;
+        methodP->coalescerP     = NULL;
+        methodP->checkSignature = false;
+
+        xmlrpc_admissionMethodInit(&methodP->admission);
 
         makeSignatureList(envP, signatureString, &methodP->signatureListP);
 
+        if (!envP->fault_occurred) {
+            xmlrpc_methodStatsInit(envP, &methodP->stats);
+
+            if (envP->fault_occurred)
+                signatureListDestroy(methodP->signatureListP);
+        }
         if (envP->fault_occurred) {
             xmlrpc_strfree(methodP->helpText);
             free(methodP);
@@ -346,6 +397,14 @@ xmlrpc_methodDestroy(xmlrpc_methodInfo * const methodP) {
     
     signatureListDestroy(methodP->signatureListP);
 
+    if (methodP->resultCacheP)
+        xmlrpc_resultCacheDestroy(methodP->resultCacheP);
+
+    if (methodP->coalescerP)
+        xmlrpc_coalescerDestroy(methodP->coalescerP);
+
+    xmlrpc_methodStatsTerm(&methodP->stats);
+
     xmlrpc_strfree(methodP->helpText);
 
     free(methodP);
@@ -353,6 +412,121 @@ xmlrpc_methodDestroy(xmlrpc_methodInfo * const methodP) {
 
 
 
+static bool
+paramsMatchSignature(xmlrpc_value **                 const params,
+                     unsigned int                    const paramCt,
+                     const struct xmlrpc_signature * const signatureP) {
+
+    bool match;
+    unsigned int i;
+
+    for (i = 0, match = (paramCt == signatureP->argCount);
+         i < paramCt && match;
+         ++i)
+        match = (params[i]->_type == signatureP->argTypeList[i]);
+
+    return match;
+}
+
+
+
+static void
+describeMismatch(xmlrpc_env *                    const envP,
+                 const char *                    const methodName,
+                 xmlrpc_value **                 const params,
+                 unsigned int                    const paramCt,
+                 const struct xmlrpc_signature * const signatureP) {
+/*----------------------------------------------------------------------------
+   Fail because the parameters don't match the method's only signature,
+   saying where they first differ.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0;
+         i < paramCt && i < signatureP->argCount &&
+             params[i]->_type == signatureP->argTypeList[i];
+         ++i);
+
+    if (i < paramCt && i < signatureP->argCount)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_TYPE_ERROR,
+            "Parameter %u of method '%s' must be of type %s.  "
+            "It is of type %s",
+            i, methodName, signatureP->argList[i],
+            xmlrpc_type_name(params[i]->_type));
+    else
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_INDEX_ERROR,
+            "Method '%s' takes %u parameters.  You supplied %u",
+            methodName, signatureP->argCount, paramCt);
+}
+
+
+
+void
+xmlrpc_methodCheckParams(xmlrpc_env *              const envP,
+                         const xmlrpc_methodInfo * const methodP,
+                         const char *              const methodName,
+                         xmlrpc_value *            const paramArrayP) {
+/*----------------------------------------------------------------------------
+   Fail if the parameters *paramArrayP of a call of method *methodP match
+   none of its signatures.  A method with no signatures takes anything.
+-----------------------------------------------------------------------------*/
+    const struct xmlrpc_signature * const firstSignatureP =
+        methodP->signatureListP->firstSignatureP;
+
+    if (firstSignatureP) {
+        unsigned int const paramCt =
+            XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, &paramArrayP->_block);
+        xmlrpc_value ** const params =
+            XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, &paramArrayP->_block);
+
+        const struct xmlrpc_signature * signatureP;
+
+        for (signatureP = firstSignatureP;
+             signatureP && !paramsMatchSignature(params, paramCt, signatureP);
+             signatureP = signatureP->nextP);
+
+        if (!signatureP) {
+            if (!firstSignatureP->nextP)
+                describeMismatch(envP, methodName, params, paramCt,
+                                 firstSignatureP);
+            else
+                xmlrpc_env_set_fault_formatted(
+                    envP, XMLRPC_TYPE_ERROR,
+                    "The %u parameters of this call of method '%s' do not "
+                    "match any of its signatures.  "
+                    "See system.methodSignature",
+                    paramCt, methodName);
+        }
+    }
+}
+
+
+
+#define INITIAL_BUCKET_CT 64
+    /* Number of hash table buckets in a new method list.  Must be a power
+       of 2.
+    */
+
+
+
+static uint32_t
+hashMethodName(const char * const methodName) {
+
+    /* This is the Bernstein hash, as in xmlrpc_struct.c */
+
+    uint32_t hash;
+    const char * p;
+
+    for (hash = 0, p = &methodName[0]; *p; ++p)
+        hash = hash + *p + (hash << 5);
+
+    return hash;
+}
+
+
+
 void
 xmlrpc_methodListCreate(xmlrpc_env *         const envP,
                         xmlrpc_methodList ** const methodListPP) {
@@ -366,10 +540,26 @@ xmlrpc_methodListCreate(xmlrpc_env *         const envP,
     if (methodListP == NULL)
         xmlrpc_faultf(envP, "Couldn't allocate method list descriptor");
     else {
-        methodListP->firstMethodP = NULL;
-        methodListP->lastMethodP = NULL;
+        MALLOCARRAY(methodListP->bucket, INITIAL_BUCKET_CT);
+
+        if (methodListP->bucket == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate method hash table");
+        else {
+            unsigned int i;
+
+            for (i = 0; i < INITIAL_BUCKET_CT; ++i)
+                methodListP->bucket[i] = NULL;
+
+            methodListP->bucketCt = INITIAL_BUCKET_CT;
+            methodListP->methodCt = 0;
 
-        *methodListPP = methodListP;
+            methodListP->firstMethodP = NULL;
+            methodListP->lastMethodP = NULL;
+
+            *methodListPP = methodListP;
+        }
+        if (envP->fault_occurred)
+            free(methodListP);
     }
 }
 
@@ -389,32 +579,77 @@ xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP) {
         free(p);
     }
 
+    free(methodListP->bucket);
+
     free(methodListP);
 }
 
 
 
+static void
+addToBucket(xmlrpc_methodNode ** const bucket,
+            unsigned int         const bucketCt,
+            xmlrpc_methodNode *  const methodNodeP) {
+
+    xmlrpc_methodNode ** const headPP =
+        &bucket[methodNodeP->hash & (bucketCt - 1)];
+
+    methodNodeP->hashNextP = *headPP;
+    *headPP = methodNodeP;
+}
+
+
+
+static void
+growHashTable(xmlrpc_methodList * const methodListP) {
+/*----------------------------------------------------------------------------
+   Double the number of buckets in the method list's hash table.
+
+   If we can't get the memory, we just leave the table as it is; it still
+   works, just slower.
+
+   We free the old buckets in place, so no lookup may be running; see
+   xmlrpc_methodList.
+-----------------------------------------------------------------------------*/
+    unsigned int const newBucketCt = methodListP->bucketCt * 2;
+
+    xmlrpc_methodNode ** newBucket;
+
+    MALLOCARRAY(newBucket, newBucketCt);
+
+    if (newBucket) {
+        xmlrpc_methodNode * p;
+        unsigned int i;
+
+        for (i = 0; i < newBucketCt; ++i)
+            newBucket[i] = NULL;
+
+        for (p = methodListP->firstMethodP; p; p = p->nextP)
+            addToBucket(newBucket, newBucketCt, p);
+
+        free(methodListP->bucket);
+
+        methodListP->bucket   = newBucket;
+        methodListP->bucketCt = newBucketCt;
+    }
+}
+
+
+
 void
 xmlrpc_methodListLookupByName(xmlrpc_methodList *  const methodListP,
                               const char *         const methodName,
                               xmlrpc_methodInfo ** const methodPP) {
 
-
-    /* We do a simple linear lookup along a linked list.
-       If speed is important, we can make this a binary tree instead.
-    */
+    uint32_t const hash = hashMethodName(methodName);
 
     xmlrpc_methodNode * p;
-    xmlrpc_methodInfo * methodP;
 
-    for (p = methodListP->firstMethodP, methodP = NULL;
-         p && !methodP;
-         p = p->nextP) {
+    for (p = methodListP->bucket[hash & (methodListP->bucketCt - 1)];
+         p && !(p->hash == hash && xmlrpc_streq(p->methodName, methodName));
+         p = p->hashNextP);
 
-        if (xmlrpc_streq(p->methodName, methodName))
-            methodP = p->methodP;
-    }
-    *methodPP = methodP;
+    *methodPP = p ? p->methodP : NULL;
 }
 
 
@@ -443,6 +678,7 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
             xmlrpc_faultf(envP, "Couldn't allocate method node");
         else {
             methodNodeP->methodName = strdup(methodName);
+            methodNodeP->hash = hashMethodName(methodName);
             methodNodeP->methodP = methodP;
             methodNodeP->nextP = NULL;
             
@@ -453,7 +689,14 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
                 methodListP->lastMethodP->nextP = methodNodeP;
 
             methodListP->lastMethodP = methodNodeP;
+
+            addToBucket(methodListP->bucket, methodListP->bucketCt,
+                        methodNodeP);
+
+            ++methodListP->methodCt;
+
+            if (methodListP->methodCt > methodListP->bucketCt)
+                growHashTable(methodListP);
         }
     }
 }
-
@@ -1,7 +1,12 @@
 #ifndef METHOD_H_INCLUDED
 #define METHOD_H_INCLUDED
 
+#include "int.h"
 #include "xmlrpc-c/base.h"
+#include "admission.h"
+#include "result_cache.h"
+#include "coalesce.h"
+#include "method_stats.h"
 
 struct xmlrpc_signature {
     struct xmlrpc_signature * nextP;
@@ -21,6 +26,11 @@ struct xmlrpc_signature {
 
            The strings are constants, not malloc'ed.
         */
+    xmlrpc_type * argTypeList;
+        /* Array of size 'argCount'.  argTypeList[i] is the type of
+           argument i, i.e. the same thing as argList[i] in the form
+           we check parameters against.  Same allocated size as 'argList'.
+        */
 };
 
 typedef struct xmlrpc_signatureList {
@@ -48,21 +58,36 @@ struct xmlrpc_registry {
            that function, passed to it as argument.
         */
     xmlrpc_dialect dialect;
+    struct xmlrpc_admission * admissionP;
+        /* Decides when calls may execute, according to concurrency
+           limits
+        */
+    struct xmlrpc_workpool * multicallPoolP;
+        /* Threads that execute the parallel-safe calls of a
+           system.multicall.  NULL means system.multicall executes its
+           calls one at a time, in order.
+        */
+    unsigned int multicallMaxPerCall;
+        /* Maximum number of 'multicallPoolP' threads one system.multicall
+           uses at once.  Zero means no limit other than the pool size.
+        */
 };
 
-typedef struct {
+typedef struct xmlrpc_methodInfo {
 /*----------------------------------------------------------------------------
    Everything a registry knows about one XML-RPC method
 -----------------------------------------------------------------------------*/
-    /* One of the methodTypeX fields is NULL and the other isn't.
-       (The reason there are two is backward compatibility.  Old
-       programs set up the registry with Type 1; modern ones set it up
-       with Type 2.
+    /* Exactly one of the methodFnX fields is non-NULL.
+       (The reason there are two synchronous types is backward
+       compatibility.  Old programs set up the registry with Type 1;
+       modern ones set it up with Type 2.
     */
     xmlrpc_method1 methodFnType1;
         /* The method function, if it's type 1.  Null if it's not */
     xmlrpc_method2 methodFnType2;
         /* The method function, if it's type 2.  Null if it's not */
+    xmlrpc_async_method methodFnAsync;
+        /* The method function, if it's asynchronous.  Null if it's not */
     void * userData;
         /* Passed to method function */
     size_t stackSize;
@@ -76,23 +101,70 @@ typedef struct {
         */
     const char * helpText;
         /* Stuff returned by system method system.methodHelp */
+    xmlrpc_admissionMethod admission;
+        /* The method's concurrency limits and how its calls are doing
+           against them
+        */
+    bool parallelSafe;
+        /* A call of the method may execute at the same time as other calls
+           in the same system.multicall, in any order relative to them.
+           I.e. the method has no side effects another call could see.
+        */
+    struct xmlrpc_resultCache * resultCacheP;
+        /* Responses to recent calls of the method, for reuse by later
+           calls with the same parameters.  NULL if the method's responses
+           have never been cached.
+        */
+    struct xmlrpc_coalescer * coalescerP;
+        /* Makes identical concurrent calls of the method share one
+           execution.  NULL if each call executes on its own.
+        */
+    xmlrpc_methodStats stats;
+        /* How calls of the method have gone */
+    bool checkSignature;
+        /* The registry rejects a call whose parameters don't match any of
+           the method's signatures, without calling the method function.
+        */
 } xmlrpc_methodInfo;
 
 typedef struct xmlrpc_methodNode {
     struct xmlrpc_methodNode * nextP;
+        /* Next method in the order they were added */
+    struct xmlrpc_methodNode * hashNextP;
+        /* Next method in the same hash table bucket */
+    uint32_t hash;
+        /* Hash of 'methodName' */
     const char * methodName;
     xmlrpc_methodInfo * methodP;
 } xmlrpc_methodNode;
 
 typedef struct xmlrpc_methodList {
+    /* There is no locking.  Lookups may run concurrently with each other,
+       but not with an add: adding may grow the hash table, which frees the
+       old bucket array and relinks the chains.  So all methods must be
+       added before the server starts processing calls (which is what
+       xmlrpc_registry_add_method() and friends require).
+    */
     xmlrpc_methodNode * firstMethodP;
     xmlrpc_methodNode * lastMethodP;
+        /* The methods, in the order they were added.  That's the order
+           in which system.listMethods lists them.
+        */
+    xmlrpc_methodNode ** bucket;
+        /* A hash table of the same methods, keyed by name, with
+           'bucketCt' buckets.  We grow it as methods are added, to keep
+           the average chain short.
+        */
+    unsigned int bucketCt;
+        /* Number of buckets.  A power of 2. */
+    unsigned int methodCt;
 } xmlrpc_methodList;
 
 void
 xmlrpc_methodCreate(xmlrpc_env *           const envP,
                     xmlrpc_method1               methodFnType1,
                     xmlrpc_method2               methodFnType2,
+                    xmlrpc_async_method          methodFnAsync,
                     void *                 const userData,
                     const char *           const signatureString,
                     const char *           const helpText,
@@ -102,6 +174,12 @@ xmlrpc_methodCreate(xmlrpc_env *           const envP,
 void
 xmlrpc_methodDestroy(xmlrpc_methodInfo * const methodP);
 
+void
+xmlrpc_methodCheckParams(xmlrpc_env *              const envP,
+                         const xmlrpc_methodInfo * const methodP,
+                         const char *              const methodName,
+                         xmlrpc_value *            const paramArrayP);
+
 void
 xmlrpc_methodListCreate(xmlrpc_env *         const envP,
                         xmlrpc_methodList ** const methodListPP);
@@ -0,0 +1,331 @@
+/*=============================================================================
+                                method_stats
+===============================================================================
+  Statistics on the calls of a method.  See method_stats.h.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <string.h>
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+
+#include "method_stats.h"
+
+#define SUB_BUCKET_BITS 3
+    /* Each power of two is divided into 2^SUB_BUCKET_BITS buckets */
+#define SUB_BUCKET_CT (1 << SUB_BUCKET_BITS)
+#define LINEAR_CT (2 * SUB_BUCKET_CT)
+    /* Times less than this many microseconds each have their own bucket */
+#define MAX_EXPONENT 31
+    /* Times of 2^(MAX_EXPONENT+1) microseconds or more count as the
+       largest time with this exponent
+    */
+
+
+
+void
+xmlrpc_methodStatsInit(xmlrpc_env *         const envP,
+                       xmlrpc_methodStats * const statsP) {
+
+    statsP->lockP = xmlrpc_lock_create();
+
+    if (statsP->lockP == NULL)
+        xmlrpc_faultf(envP, "Unable to create lock for method statistics");
+    else {
+        unsigned int i;
+
+        statsP->callCt     = 0;
+        statsP->faultCt    = 0;
+        statsP->inFlightCt = 0;
+
+        for (i = 0; i < XMLRPC_PHASE_CT; ++i) {
+            xmlrpc_latencyHistogram * const histP = &statsP->latency[i];
+
+            memset(histP->bucket, 0, sizeof(histP->bucket));
+            histP->count   = 0;
+            histP->totalUs = 0;
+            histP->maxUs   = 0;
+        }
+    }
+}
+
+
+
+void
+xmlrpc_methodStatsTerm(xmlrpc_methodStats * const statsP) {
+
+    statsP->lockP->destroy(statsP->lockP);
+}
+
+
+
+static unsigned int
+bucketIndex(uint64_t const us) {
+/*----------------------------------------------------------------------------
+   The histogram bucket for a time of 'us' microseconds
+-----------------------------------------------------------------------------*/
+    unsigned int retval;
+
+    if (us < LINEAR_CT)
+        retval = (unsigned int)us;
+    else {
+        uint64_t const maxUs = ((uint64_t)1 << (MAX_EXPONENT + 1)) - 1;
+        uint64_t const v = us > maxUs ? maxUs : us;
+
+        unsigned int exponent;
+
+        for (exponent = SUB_BUCKET_BITS + 1; (v >> (exponent + 1)) > 0;
+             ++exponent);
+
+        retval = LINEAR_CT +
+            (exponent - (SUB_BUCKET_BITS + 1)) * SUB_BUCKET_CT +
+            (unsigned int)((v >> (exponent - SUB_BUCKET_BITS)) &
+                           (SUB_BUCKET_CT - 1));
+    }
+    return retval;
+}
+
+
+
+static uint64_t
+bucketHighUs(unsigned int const index) {
+/*----------------------------------------------------------------------------
+   The largest time, in microseconds, that counts in bucket 'index'
+-----------------------------------------------------------------------------*/
+    uint64_t retval;
+
+    if (index < LINEAR_CT)
+        retval = index;
+    else {
+        unsigned int const exponent =
+            (index - LINEAR_CT) / SUB_BUCKET_CT + SUB_BUCKET_BITS + 1;
+        unsigned int const sub = (index - LINEAR_CT) % SUB_BUCKET_CT;
+        unsigned int const shift = exponent - SUB_BUCKET_BITS;
+
+        retval = ((uint64_t)(SUB_BUCKET_CT + sub + 1) << shift) - 1;
+    }
+    return retval;
+}
+
+
+
+static uint64_t
+usSince(xmlrpc_timespec const start) {
+
+    xmlrpc_timespec now;
+    int64_t us;
+
+    xmlrpc_gettimeofday(&now);
+
+    us = ((int64_t)now.tv_sec - start.tv_sec) * 1000000 +
+        ((int64_t)now.tv_nsec - start.tv_nsec) / 1000;
+
+    /* The clock may have been set back */
+    return us < 0 ? 0 : (uint64_t)us;
+}
+
+
+
+static void
+addToHistogram(xmlrpc_latencyHistogram * const histP,
+               uint64_t                  const us) {
+
+    ++histP->bucket[bucketIndex(us)];
+    ++histP->count;
+    histP->totalUs += us;
+    if (us > histP->maxUs)
+        histP->maxUs = us;
+}
+
+
+
+void
+xmlrpc_methodStatsCallBegin(xmlrpc_methodStats * const statsP,
+                            xmlrpc_timespec *    const startTimeP) {
+/*----------------------------------------------------------------------------
+   Note that a call of the method is starting to execute, and return the
+   time it starts, for xmlrpc_methodStatsCallEnd().
+-----------------------------------------------------------------------------*/
+    xmlrpc_gettimeofday(startTimeP);
+
+    statsP->lockP->acquire(statsP->lockP);
+
+    ++statsP->inFlightCt;
+
+    statsP->lockP->release(statsP->lockP);
+}
+
+
+
+void
+xmlrpc_methodStatsCallEnd(xmlrpc_methodStats * const statsP,
+                          xmlrpc_timespec      const startTime,
+                          bool                 const failed) {
+/*----------------------------------------------------------------------------
+   Note that a call of the method that started at 'startTime' has
+   finished executing.
+-----------------------------------------------------------------------------*/
+    uint64_t const us = usSince(startTime);
+
+    statsP->lockP->acquire(statsP->lockP);
+
+    --statsP->inFlightCt;
+    ++statsP->callCt;
+    if (failed)
+        ++statsP->faultCt;
+
+    addToHistogram(&statsP->latency[xmlrpc_phase_execute], us);
+
+    statsP->lockP->release(statsP->lockP);
+}
+
+
+
+void
+xmlrpc_methodStatsRecord(xmlrpc_methodStats * const statsP,
+                         xmlrpc_callPhase     const phase,
+                         xmlrpc_timespec      const startTime) {
+/*----------------------------------------------------------------------------
+   Note that phase 'phase' of a call, which started at 'startTime', is
+   over.
+-----------------------------------------------------------------------------*/
+    uint64_t const us = usSince(startTime);
+
+    statsP->lockP->acquire(statsP->lockP);
+
+    addToHistogram(&statsP->latency[phase], us);
+
+    statsP->lockP->release(statsP->lockP);
+}
+
+
+
+static uint64_t
+usFromSeconds(double const seconds) {
+
+    return seconds > 0 ? (uint64_t)(seconds * 1E6 + 0.5) : 0;
+}
+
+
+
+void
+xmlrpc_methodStatsRecordTime(xmlrpc_methodStats * const statsP,
+                             xmlrpc_callPhase     const phase,
+                             double               const seconds) {
+/*----------------------------------------------------------------------------
+   Like xmlrpc_methodStatsRecord(), but for a phase that took 'seconds'
+   seconds.
+-----------------------------------------------------------------------------*/
+    uint64_t const us = usFromSeconds(seconds);
+
+    statsP->lockP->acquire(statsP->lockP);
+
+    addToHistogram(&statsP->latency[phase], us);
+
+    statsP->lockP->release(statsP->lockP);
+}
+
+
+
+void
+xmlrpc_methodStatsAddCall(xmlrpc_methodStats * const statsP,
+                          const double *       const phaseTime,
+                          bool                 const failed) {
+/*----------------------------------------------------------------------------
+   Note that a call of the method, which someone other than the registry
+   executed, is over.  The caller noted its start with
+   xmlrpc_methodStatsCallBegin().  phaseTime[] is the time in seconds of
+   each phase of it, indexed by xmlrpc_callPhase.
+-----------------------------------------------------------------------------*/
+    uint64_t us[XMLRPC_PHASE_CT];
+    unsigned int phase;
+
+    for (phase = 0; phase < XMLRPC_PHASE_CT; ++phase)
+        us[phase] = usFromSeconds(phaseTime[phase]);
+
+    statsP->lockP->acquire(statsP->lockP);
+
+    --statsP->inFlightCt;
+    ++statsP->callCt;
+    if (failed)
+        ++statsP->faultCt;
+
+    for (phase = 0; phase < XMLRPC_PHASE_CT; ++phase)
+        addToHistogram(&statsP->latency[phase], us[phase]);
+
+    statsP->lockP->release(statsP->lockP);
+}
+
+
+
+static double
+percentile(const xmlrpc_latencyHistogram * const histP,
+           double                          const fraction) {
+/*----------------------------------------------------------------------------
+   The time, in seconds, below which 'fraction' of the times in the
+   histogram fall.  We report the top of the bucket the percentile is in,
+   but no more than the largest time.
+-----------------------------------------------------------------------------*/
+    double retval;
+
+    if (histP->count == 0)
+        retval = 0.0;
+    else {
+        unsigned long const rank = (unsigned long)(fraction * histP->count);
+        unsigned long seen;
+        unsigned int i;
+        uint64_t us;
+
+        for (i = 0, seen = 0; i < XMLRPC_LATENCY_BUCKET_CT - 1; ++i) {
+            seen += histP->bucket[i];
+            if (seen > rank)
+                break;
+        }
+        us = bucketHighUs(i);
+
+        retval = (us > histP->maxUs ? histP->maxUs : us) / 1E6;
+    }
+    return retval;
+}
+
+
+
+static void
+readHistogram(const xmlrpc_latencyHistogram * const histP,
+              struct xmlrpc_latency_stats *   const resultP) {
+
+    resultP->count     = histP->count;
+    resultP->totalTime = histP->totalUs / 1E6;
+    resultP->maxTime   = histP->maxUs / 1E6;
+    resultP->p50Time   = percentile(histP, 0.50);
+    resultP->p90Time   = percentile(histP, 0.90);
+    resultP->p99Time   = percentile(histP, 0.99);
+}
+
+
+
+void
+xmlrpc_methodStatsRead(xmlrpc_methodStats *         const statsP,
+                       struct xmlrpc_method_stats * const resultP) {
+
+    statsP->lockP->acquire(statsP->lockP);
+
+    resultP->callCt     = statsP->callCt;
+    resultP->faultCt    = statsP->faultCt;
+    resultP->inFlightCt = statsP->inFlightCt;
+
+    readHistogram(&statsP->latency[xmlrpc_phase_parse],     &resultP->parse);
+    readHistogram(&statsP->latency[xmlrpc_phase_execute],   &resultP->execute);
+    readHistogram(&statsP->latency[xmlrpc_phase_serialize],
+                  &resultP->serialize);
+
+    statsP->lockP->release(statsP->lockP);
+}
@@ -0,0 +1,85 @@
+#ifndef METHOD_STATS_H_INCLUDED
+#define METHOD_STATS_H_INCLUDED
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/server.h"
+
+/* The statistics the registry keeps on the calls of one method (see
+   xmlrpc_registry_get_method_stats()).
+*/
+
+typedef enum {
+    xmlrpc_phase_parse,
+    xmlrpc_phase_execute,
+    xmlrpc_phase_serialize
+} xmlrpc_callPhase;
+
+#define XMLRPC_PHASE_CT 3
+
+#define XMLRPC_LATENCY_BUCKET_CT 240
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A histogram of times, in microseconds.  The buckets are one microsecond
+   wide up to 16 microseconds; after that, each power of two is divided into
+   8 equal buckets, so a bucket is never wider than 1/8 of the times in it.
+   Times of more than about 71 minutes count in the last bucket.
+-----------------------------------------------------------------------------*/
+    uint32_t bucket[XMLRPC_LATENCY_BUCKET_CT];
+    unsigned long count;
+    uint64_t totalUs;
+    uint64_t maxUs;
+} xmlrpc_latencyHistogram;
+
+typedef struct {
+    lock * lockP;
+        /* Protects everything below.  We hold it only to add to the
+           counts, never while a call executes.
+        */
+    unsigned long callCt;
+    unsigned long faultCt;
+    unsigned int inFlightCt;
+    xmlrpc_latencyHistogram latency[XMLRPC_PHASE_CT];
+        /* Indexed by xmlrpc_callPhase */
+} xmlrpc_methodStats;
+
+void
+xmlrpc_methodStatsInit(xmlrpc_env *         const envP,
+                       xmlrpc_methodStats * const statsP);
+
+void
+xmlrpc_methodStatsTerm(xmlrpc_methodStats * const statsP);
+
+void
+xmlrpc_methodStatsCallBegin(xmlrpc_methodStats * const statsP,
+                            xmlrpc_timespec *    const startTimeP);
+
+void
+xmlrpc_methodStatsCallEnd(xmlrpc_methodStats * const statsP,
+                          xmlrpc_timespec      const startTime,
+                          bool                 const failed);
+
+void
+xmlrpc_methodStatsRecord(xmlrpc_methodStats * const statsP,
+                         xmlrpc_callPhase     const phase,
+                         xmlrpc_timespec      const startTime);
+
+void
+xmlrpc_methodStatsRecordTime(xmlrpc_methodStats * const statsP,
+                             xmlrpc_callPhase     const phase,
+                             double               const seconds);
+
+void
+xmlrpc_methodStatsAddCall(xmlrpc_methodStats * const statsP,
+                          const double *       const phaseTime,
+                          bool                 const failed);
+
+void
+xmlrpc_methodStatsRead(xmlrpc_methodStats *         const statsP,
+                       struct xmlrpc_method_stats * const resultP);
+
+#endif
@@ -1,17 +1,9 @@
 #include "xmlrpc_config.h"
 
 #include <stdlib.h>
-#include <assert.h>
-#include <ctype.h>
 #include <string.h>
 
-#if HAVE_REGEX
-#include <sys/types.h>  /* Missing from regex.h in GNU libc */
-#include <regex.h>
-#endif
-
 #include "bool.h"
-#include "c_util.h"
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/base_int.h"
@@ -20,370 +12,213 @@
 
 
 
-#if HAVE_REGEX
-
-static unsigned int
-digitStringValue(const char * const string,
-                 regmatch_t   const match) {
+static bool
+isDigit(char const c) {
 /*----------------------------------------------------------------------------
-   Return the numerical value of the decimal whole number substring of
-   'string' identified by 'match'.  E.g. if 'string' is 'abc34d' and
-   'match' says start at 3 and end at 5, we return 34.
+   The decimal digits of an ISO 8601 datetime are ASCII regardless of
+   locale, so we don't use isdigit().
 -----------------------------------------------------------------------------*/
-    unsigned int i;
-    unsigned int accum;
-
-    assert(match.rm_so >= 0);
-    assert(match.rm_eo >= 0);
-
-    for (i = match.rm_so, accum = 0; i < (unsigned)match.rm_eo; ++i) {
-        accum *= 10;
-        assert(isdigit(string[i]));
-        accum += string[i] - '0';
-    }
-    return accum;
+    return (c >= '0' && c <= '9');
 }
-#endif  /* HAVE_REGEX */
 
 
 
-#if HAVE_REGEX
-
-static unsigned int
-digitStringMillionths(const char * const string,
-                      regmatch_t   const match) {
+static bool
+parseDigits(const char **  const pP,
+            unsigned int   const digitCt,
+            unsigned int * const valueP) {
 /*----------------------------------------------------------------------------
-   Return the number of millionths represented by the digits after the
-   decimal point in a decimal string, where thse digits are the substring
-   of 'string' identified by 'match'.  E.g. if the substring is
-   34, we return 340,000.
+   Parse exactly 'digitCt' decimal digits at *pP as a whole number; advance
+   *pP past them.
+
+   Return false (and leave *pP alone) if there aren't 'digitCt' digits
+   there.
 -----------------------------------------------------------------------------*/
+    const char * const start = *pP;
+
     unsigned int i;
     unsigned int accum;
 
-    assert(match.rm_so >= 0);
-    assert(match.rm_eo >= 0);
+    for (i = 0, accum = 0; i < digitCt && isDigit(start[i]); ++i)
+        accum = accum * 10 + (start[i] - '0');
 
-    for (i = match.rm_so, accum = 0; i < (unsigned)match.rm_so+6; ++i) {
-        accum *= 10;
-        if (i < (unsigned)match.rm_eo) {
-            assert(isdigit(string[i]));
-            accum += string[i] - '0';
-        }
+    if (i == digitCt) {
+        *valueP = accum;
+        *pP = &start[digitCt];
     }
-    return accum;
-}
-#endif /* HAVE_REGEX */
-
-
-#if HAVE_REGEX
-
-static void 
-subParseDtRegex_standard(regmatch_t *      const matches,
-                         const char *      const datetimeString,
-                         xmlrpc_datetime * const dtP) {
-
-    dtP->Y = digitStringValue(datetimeString, matches[1]);
-    dtP->M = digitStringValue(datetimeString, matches[2]);
-    dtP->D = digitStringValue(datetimeString, matches[3]);
-    dtP->h = digitStringValue(datetimeString, matches[4]);
-    dtP->m = digitStringValue(datetimeString, matches[5]);
-    dtP->s = digitStringValue(datetimeString, matches[6]);
-    
-    if (matches[7].rm_so == -1)
-        dtP->u = 0;
-    else
-        dtP->u = digitStringMillionths(datetimeString, matches[7]);
+    return (i == digitCt);
 }
 
 
 
-static void 
-subParseDtRegex_standardtzd(regmatch_t *      const matches,
-                            const char *      const datetimeString,
-                            xmlrpc_datetime * const dtP) {
+static void
+skipOptional(const char ** const pP,
+             char          const c) {
 
-    dtP->Y = digitStringValue(datetimeString, matches[1]);
-    dtP->M = digitStringValue(datetimeString, matches[2]);
-    dtP->D = digitStringValue(datetimeString, matches[3]);
-    dtP->h = digitStringValue(datetimeString, matches[4]);
-    dtP->m = digitStringValue(datetimeString, matches[5]);
-    dtP->s = digitStringValue(datetimeString, matches[6]);
-    dtP->u = 0;
+    if (**pP == c)
+        ++*pP;
 }
 
-#endif  /* HAVE_REGEX */
-
-
-#if HAVE_REGEX
-
-typedef  void (*regparsefunc_t)(regmatch_t *      const matches,
-                                const char *      const datetimeString,
-                                xmlrpc_datetime * const dtP);
-
-
-struct regexParser {
-    const char * const regex;
-    regparsefunc_t func; 
-};
 
-static const struct regexParser iso8601Regex[]
-
-    /* Each entry of this table is instructions for recognizing and parsing
-       some form of a "dateTime.iso8601" XML element.
-
-       (Note that we recognize far more than just the XML-RPC standard
-       dateTime.iso8601).
-    */
-
-    = {
-           {
-               /* Examples:
-                  YYYYMMDD[T]HHMMSS
-                  YYYY-MM-DD[T]HH:MM:SS
-                  YYYY-MM-DD[T]HH:MM:SS.ssss
-               */
-
-               "^([0-9]{4})\\-?([0-9]{2})\\-?([0-9]{2})T"
-               "([0-9]{2}):?([0-9]{2}):?([0-9]{2})\\.?([0-9]+)?$",
-               subParseDtRegex_standard
-           },
-           
-           { 
-               /* Examples:
-                  YYYYMMDD[T]HHMMSS[Z]
-                  YYYYMMDD[T]HHMMSS[+-]hh
-                  YYYYMMDD[T]HHMMSS[+-]hhmm
-               */
-
-               "^([0-9]{4})\\-?([0-9]{2})\\-?([0-9]{2})T"
-               "([0-9]{2}):?([0-9]{2}):?([0-9]{2})[Z\\+\\-]([0-9]{2,4})?$",
-               subParseDtRegex_standardtzd
-           },
-           { NULL, NULL }
-    };
-#endif  /* HAVE_REGEX */
 
+static bool
+parseDateAndTime(const char **     const pP,
+                 xmlrpc_datetime * const dtP) {
+/*----------------------------------------------------------------------------
+   Parse the part of a datetime string that every form we recognize has,
+   e.g. "19980717T14:08:55" or "1998-07-17t140855", at *pP.  Advance *pP
+   past it.
 
+   Return false if it isn't there.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    bool valid;
+    unsigned int Y, M, D, h, m, s;
 
-#if HAVE_REGEX
-static void
-parseDtRegex(xmlrpc_env *      const envP,
-             const char *      const datetimeString,
-             xmlrpc_datetime * const dtP) {
+    p = *pP;
 
-    unsigned int i;
-    const struct regexParser * parserP;
-        /* The parser that matches 'datetimeString'.  Null if no match yet
-           found.
-        */
-    regmatch_t matches[1024];
-
-    for (i = 0, parserP = NULL; iso8601Regex[i].regex && !parserP; ++i) {
-        const struct regexParser * const thisParserP = &iso8601Regex[i];
-
-        regex_t re;
-        int status;
-
-        status = regcomp(&re, thisParserP->regex, REG_ICASE | REG_EXTENDED);
-
-        /* Our regex is valid, so it must have compiled: */
-        assert(status == 0);
-        {
-            int status;
-    
-            status = regexec(&re, datetimeString, ARRAY_SIZE(matches), 
-                             matches, 0);
-    
-            if (status == 0) {
-                assert(matches[0].rm_so != -1);  /* Match of whole regex */
-                
-                parserP = thisParserP;
-            }
-            regfree(&re);
-        }
+    valid = parseDigits(&p, 4, &Y);
+    if (valid) {
+        skipOptional(&p, '-');
+        valid = parseDigits(&p, 2, &M);
     }
-
-    if (parserP) {
-        parserP->func(matches, datetimeString, dtP);
-    } else {
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR,
-            "value '%s' is not of any form we recognize "
-            "for a <dateTime.iso8601> element",
-            datetimeString);
+    if (valid) {
+        skipOptional(&p, '-');
+        valid = parseDigits(&p, 2, &D);
     }
-
+    if (valid) {
+        if (*p == 'T' || *p == 't')
+            ++p;
+        else
+            valid = false;
+    }
+    if (valid)
+        valid = parseDigits(&p, 2, &h);
+    if (valid) {
+        skipOptional(&p, ':');
+        valid = parseDigits(&p, 2, &m);
+    }
+    if (valid) {
+        skipOptional(&p, ':');
+        valid = parseDigits(&p, 2, &s);
+    }
+    if (valid) {
+        dtP->Y = Y;
+        dtP->M = M;
+        dtP->D = D;
+        dtP->h = h;
+        dtP->m = m;
+        dtP->s = s;
+
+        *pP = p;
+    }
+    return valid;
 }
-#endif  /* HAVE_REGEX */
-
-
-
-static __inline__ void
-parseDtNoRegex(xmlrpc_env *      const envP,
-               const char *      const datetimeString,
-               xmlrpc_datetime * const dtP) {
-
-    unsigned int const dtStrlen = strlen(datetimeString);
 
-    char year[4+1];
-    char month[2+1];
-    char day[2+1];
-    char hour[2+1];
-    char minute[2+1];
-    char second[2+1];
 
-    if (dtStrlen < 17 || dtStrlen == 18 || dtStrlen > 24)
-        xmlrpc_faultf(envP, "could not parse date, size incompatible: '%d'",
-                      dtStrlen);
-    else {
-        year[0]   = datetimeString[ 0];
-        year[1]   = datetimeString[ 1];
-        year[2]   = datetimeString[ 2];
-        year[3]   = datetimeString[ 3];
-        year[4]   = '\0';
 
-        month[0]  = datetimeString[ 4];
-        month[1]  = datetimeString[ 5];
-        month[2]  = '\0';
-
-        day[0]    = datetimeString[ 6];
-        day[1]    = datetimeString[ 7];
-        day[2]    = '\0';
-
-        assert(datetimeString[ 8] == 'T');
-
-        hour[0]   = datetimeString[ 9];
-        hour[1]   = datetimeString[10];
-        hour[2]   = '\0';
+static bool
+parseFractionalSeconds(const char *   const fraction,
+                       unsigned int * const microsecondsP) {
+/*----------------------------------------------------------------------------
+   Parse the end of a datetime string that follows the seconds, when that
+   is not a time zone designator: an optional decimal point and optional
+   digits, e.g. ".123456" or "5" or "" or ".".
 
-        assert(datetimeString[11] == ':');
+   Return as *microsecondsP the value of the digits as a fraction of a
+   second, in millionths, e.g. 340000 for "34".  Digits past the sixth
+   don't count.
 
-        minute[0] = datetimeString[12];
-        minute[1] = datetimeString[13];
-        minute[2] = '\0';
+   Return false if 'fraction' is not of that form.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    unsigned int digitCt;
+    unsigned int accum;
 
-        assert(datetimeString[14] == ':');
+    p = fraction;
 
-        second[0] = datetimeString[15];
-        second[1] = datetimeString[16];
-        second[2] = '\0';
+    skipOptional(&p, '.');
 
-        if (dtStrlen > 17) {
-            unsigned int const pad = 24 - dtStrlen;
-            unsigned int i;
+    for (digitCt = 0, accum = 0; isDigit(*p); ++p, ++digitCt) {
+        if (digitCt < 6)
+            accum = accum * 10 + (*p - '0');
+    }
+    for (; digitCt < 6; ++digitCt)
+        accum *= 10;
 
-            dtP->u = atoi(&datetimeString[18]);
-            for (i = 0; i < pad; ++i)
-                dtP->u *= 10;
-        } else
-            dtP->u = 0;
+    *microsecondsP = accum;
 
-        dtP->Y = atoi(year);
-        dtP->M = atoi(month);
-        dtP->D = atoi(day);
-        dtP->h = atoi(hour);
-        dtP->m = atoi(minute);
-        dtP->s = atoi(second);
-    }
+    return (*p == '\0');
 }
 
 
 
-static void
-validateFirst17(xmlrpc_env * const envP,
-                const char * const dt) {
+static bool
+isTimeZoneDesignator(const char * const tzd) {
 /*----------------------------------------------------------------------------
-   Assuming 'dt' is at least 17 characters long, validate that the first
-   17 characters are a valid XML-RPC datetime, e.g.
-   "20080628T16:35:02"
+   Return true iff 'tzd' is a time zone designator we recognize: "Z", or a
+   sign followed by 2 to 4 digits, e.g. "+05" or "-0530".  The sign
+   alone is OK too.  We ignore the time zone when we parse the datetime.
 -----------------------------------------------------------------------------*/
-    unsigned int i;
+    bool retval;
 
-    for (i = 0; i < 8 && !envP->fault_occurred; ++i)
-        if (!isdigit(dt[i]))
-            xmlrpc_env_set_fault_formatted(
-                envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[i]);
+    if (tzd[0] == 'Z' || tzd[0] == 'z' || tzd[0] == '+' || tzd[0] == '-') {
+        unsigned int digitCt;
 
-    if (dt[8] != 'T')
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "9th character is '%c', not 'T'",
-            dt[8]);
-    if (!isdigit(dt[9]))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[9]);
-    if (!isdigit(dt[10]))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[10]);
-    if (dt[11] != ':')
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a colon: '%c'", dt[11]);
-    if (!isdigit(dt[12]))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[12]);
-    if (!isdigit(dt[13]))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[13]);
-    if (dt[14] != ':')
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a colon: '%c'", dt[14]);
-    if (!isdigit(dt[15]))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[15]);
-    if (!isdigit(dt[16]))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, "Not a digit: '%c'", dt[16]);
+        for (digitCt = 0; isDigit(tzd[1 + digitCt]); ++digitCt);
+
+        retval = tzd[1 + digitCt] == '\0' &&
+            (digitCt == 0 || (digitCt >= 2 && digitCt <= 4));
+    } else
+        retval = false;
+
+    return retval;
 }
 
 
 
 static void
-validateFractionalSeconds(xmlrpc_env * const envP,
-                          const char * const dt) {
+parseDt(xmlrpc_env *      const envP,
+        const char *      const datetimeString,
+        xmlrpc_datetime * const dtP) {
 /*----------------------------------------------------------------------------
-   Validate the fractional seconds part of the XML-RPC datetime string
-   'dt', if any.  That's the decimal point and everything following
-   it.
+   Parse 'datetimeString' in any of the forms we recognize for a
+   "dateTime.iso8601" XML element.  (Note that we recognize far more than
+   just the XML-RPC standard dateTime.iso8601).  Examples:
+
+     YYYYMMDDTHHMMSS
+     YYYY-MM-DDTHH:MM:SS
+     YYYY-MM-DDTHH:MM:SS.ssss
+     YYYYMMDDTHHMMSSZ
+     YYYYMMDDTHHMMSS+hh
+     YYYYMMDDTHHMMSS-hhmm
+
+   Each dash and colon is optional independently of the others, and the
+   'T' and 'Z' may be lower case.  There may be fractional seconds or a
+   time zone designator, but not both.
+
+   We do not allocate any memory or look at the locale, and we look at
+   each character only once.
 -----------------------------------------------------------------------------*/
-    if (strlen(dt) > 17) {
-        if (dt[17] != '.') {
-            xmlrpc_env_set_fault_formatted(
-                envP, XMLRPC_PARSE_ERROR,
-                "'%c' where only a period is valid", dt[17]);
-        } else {
-            if (dt[18] == '\0')
-                xmlrpc_env_set_fault_formatted(
-                    envP, XMLRPC_PARSE_ERROR, "Nothing after decimal point");
-            else {
-                unsigned int i;
-                for (i = 18; dt[i] != '\0' && !envP->fault_occurred; ++i) {
-                    if (!isdigit(dt[i]))
-                        xmlrpc_env_set_fault_formatted(
-                            envP, XMLRPC_PARSE_ERROR,
-                            "Non-digit in fractional seconds: '%c'", dt[i]);
-                }
-            }
-        }
-    }
-}
-
+    const char * p;
+    bool valid;
 
+    p = datetimeString;
 
-static __inline__ void
-validateFormatNoRegex(xmlrpc_env * const envP,
-                      const char * const dt) {
+    valid = parseDateAndTime(&p, dtP);
 
-    if (strlen(dt) < 17)
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR, 
-            "Invalid length of %u of datetime.  "
-            "Must be at least 17 characters",
-            (unsigned)strlen(dt));
-    else {
-        validateFirst17(envP, dt);
-
-        validateFractionalSeconds(envP, dt);
+    if (valid) {
+        if (isTimeZoneDesignator(p))
+            dtP->u = 0;
+        else
+            valid = parseFractionalSeconds(p, &dtP->u);
     }
+    if (!valid)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_PARSE_ERROR,
+            "value '%s' is not of any form we recognize "
+            "for a <dateTime.iso8601> element",
+            datetimeString);
 }
 
 
@@ -449,14 +284,7 @@ xmlrpc_parseDatetime(xmlrpc_env *    const envP,
 -----------------------------------------------------------------------------*/
     xmlrpc_datetime dt;
 
-#if HAVE_REGEX
-    parseDtRegex(envP, datetimeString, &dt);
-#else
-    /* Note: validation is not as strong without regex */
-    validateFormatNoRegex(envP, datetimeString);
-    if (!envP->fault_occurred)
-        parseDtNoRegex(envP, datetimeString, &dt);
-#endif
+    parseDt(envP, datetimeString, &dt);
 
     if (!envP->fault_occurred) {
         validateXmlrpcDatetimeSome(envP, dt);
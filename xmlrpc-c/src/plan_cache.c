@@ -0,0 +1,220 @@
+/*=============================================================================
+                                 plan_cache
+===============================================================================
+  A cache of compiled format string plans, keyed by the text of the format
+  string.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#define _XOPEN_SOURCE 600  /* Make sure strdup() is in <string.h> */
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "int.h"
+
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+
+#include "plan_cache.h"
+
+#define BUCKET_CT 128
+    /* Number of hash chains.  Must be a power of 2 */
+
+#define MAX_ENTRY_CT 512
+    /* The most plans we will hold.  Programs use a fixed, small set of
+       format strings, so this is only a defense against one that builds
+       format strings on the fly.
+    */
+
+struct planCacheEntry {
+    struct planCacheEntry * nextP;
+    uint32_t hash;
+    const char * format;
+        /* malloc'ed copy of the format string */
+    const void * planP;
+};
+
+struct planCache {
+    lock * lockP;
+    planCacheDestroyFn * destroy;
+    unsigned int entryCt;
+    struct planCacheEntry * bucket[BUCKET_CT];
+};
+
+
+
+static uint32_t
+hashFormat(const char * const format) {
+
+    /* This is the Bernstein hash, as in xmlrpc_struct.c */
+
+    uint32_t hash;
+    const char * p;
+
+    for (hash = 0, p = &format[0]; *p; ++p)
+        hash = hash + *p + (hash << 5);
+
+    return hash;
+}
+
+
+
+void
+xmlrpc_planCacheCreate(xmlrpc_env *         const envP,
+                       planCacheDestroyFn * const destroy,
+                       struct planCache **  const cachePP) {
+
+    struct planCache * cacheP;
+
+    MALLOCVAR(cacheP);
+
+    if (cacheP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate a format plan cache");
+    else {
+        cacheP->lockP = xmlrpc_lock_create();
+
+        if (cacheP->lockP == NULL)
+            xmlrpc_faultf(envP, "Unable to create lock for format "
+                          "plan cache");
+        else {
+            unsigned int i;
+
+            cacheP->destroy = destroy;
+            cacheP->entryCt = 0;
+
+            for (i = 0; i < BUCKET_CT; ++i)
+                cacheP->bucket[i] = NULL;
+
+            *cachePP = cacheP;
+        }
+        if (envP->fault_occurred)
+            free(cacheP);
+    }
+}
+
+
+
+void
+xmlrpc_planCacheDestroy(struct planCache * const cacheP) {
+
+    unsigned int i;
+
+    for (i = 0; i < BUCKET_CT; ++i) {
+        struct planCacheEntry * entryP;
+        struct planCacheEntry * nextP;
+
+        for (entryP = cacheP->bucket[i]; entryP; entryP = nextP) {
+            nextP = entryP->nextP;
+
+            cacheP->destroy(entryP->planP);
+            xmlrpc_strfree(entryP->format);
+            free(entryP);
+        }
+    }
+    cacheP->lockP->destroy(cacheP->lockP);
+
+    free(cacheP);
+}
+
+
+
+static struct planCacheEntry *
+findEntry(const struct planCache * const cacheP,
+          const char *             const format,
+          uint32_t                 const hash) {
+/*----------------------------------------------------------------------------
+   Caller must hold the cache lock.
+-----------------------------------------------------------------------------*/
+    struct planCacheEntry * entryP;
+
+    for (entryP = cacheP->bucket[hash & (BUCKET_CT-1)];
+         entryP && !(entryP->hash == hash && xmlrpc_streq(entryP->format,
+                                                          format));
+         entryP = entryP->nextP);
+
+    return entryP;
+}
+
+
+
+const void *
+xmlrpc_planCacheGet(struct planCache * const cacheP,
+                    const char *       const format) {
+/*----------------------------------------------------------------------------
+   The plan cached for format string 'format'; NULL if there isn't one.
+-----------------------------------------------------------------------------*/
+    uint32_t const hash = hashFormat(format);
+
+    const struct planCacheEntry * entryP;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    entryP = findEntry(cacheP, format, hash);
+
+    cacheP->lockP->release(cacheP->lockP);
+
+    return entryP ? entryP->planP : NULL;
+}
+
+
+
+bool
+xmlrpc_planCacheAdd(struct planCache * const cacheP,
+                    const char *       const format,
+                    const void *       const planP) {
+/*----------------------------------------------------------------------------
+   Add *planP to the cache as the plan for format string 'format'.
+
+   Return true iff the cache took the plan, in which case the cache now
+   owns it.  We decline it if the cache is full or another thread got a plan
+   for 'format' in first.  Caller still owns a declined plan.
+-----------------------------------------------------------------------------*/
+    uint32_t const hash = hashFormat(format);
+
+    bool retval;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    if (cacheP->entryCt >= MAX_ENTRY_CT)
+        retval = false;
+    else if (findEntry(cacheP, format, hash))
+        retval = false;
+    else {
+        struct planCacheEntry * entryP;
+
+        MALLOCVAR(entryP);
+
+        if (entryP == NULL)
+            retval = false;
+        else {
+            entryP->format = strdup(format);
+
+            if (entryP->format == NULL) {
+                free(entryP);
+                retval = false;
+            } else {
+                struct planCacheEntry ** const bucketP =
+                    &cacheP->bucket[hash & (BUCKET_CT-1)];
+
+                entryP->hash  = hash;
+                entryP->planP = planP;
+                entryP->nextP = *bucketP;
+                *bucketP = entryP;
+                ++cacheP->entryCt;
+
+                retval = true;
+            }
+        }
+    }
+    cacheP->lockP->release(cacheP->lockP);
+
+    return retval;
+}
@@ -0,0 +1,38 @@
+#ifndef PLAN_CACHE_H_INCLUDED
+#define PLAN_CACHE_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/util.h"
+
+/* A plan cache maps a format string (e.g. "{s:i,s:(ii),*}") to a compiled,
+   immutable plan for that format string.  xmlrpc_decompose_value() and
+   xmlrpc_build_value() use one so they don't have to parse the same
+   constant format string on every call.
+
+   Entries are never removed while the cache exists, so a plan obtained
+   from the cache stays valid until the cache is destroyed.  The cache has
+   a fixed capacity; once it is full, it simply declines new plans.
+*/
+
+typedef void planCacheDestroyFn(const void * planP);
+
+struct planCache;
+
+void
+xmlrpc_planCacheCreate(xmlrpc_env *         const envP,
+                       planCacheDestroyFn * const destroy,
+                       struct planCache **  const cachePP);
+
+void
+xmlrpc_planCacheDestroy(struct planCache * const cacheP);
+
+const void *
+xmlrpc_planCacheGet(struct planCache * const cacheP,
+                    const char *       const format);
+
+bool
+xmlrpc_planCacheAdd(struct planCache * const cacheP,
+                    const char *       const format,
+                    const void *       const planP);
+
+#endif
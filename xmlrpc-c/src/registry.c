@@ -22,9 +22,16 @@
 #include "mallocvar.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/workpool_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition.h"
+#include "xmlrpc-c/condition_platform.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "method.h"
+#include "admission.h"
 #include "system_method.h"
 #include "version.h"
 
@@ -66,11 +73,22 @@ xmlrpc_registry_new(xmlrpc_env * const envP) {
         registryP->preinvokeFunction     = NULL;
         registryP->shutdownServerFn      = NULL;
         registryP->dialect               = xmlrpc_dialect_i8;
+        registryP->multicallPoolP        = NULL;
+        registryP->multicallMaxPerCall   = 0;
 
         xmlrpc_methodListCreate(envP, &registryP->methodListP);
-        if (!envP->fault_occurred)
-            xmlrpc_installSystemMethods(envP, registryP);
+        if (!envP->fault_occurred) {
+            xmlrpc_admissionCreate(envP, &registryP->admissionP);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_installSystemMethods(envP, registryP);
 
+                if (envP->fault_occurred)
+                    xmlrpc_admissionDestroy(registryP->admissionP);
+            }
+            if (envP->fault_occurred)
+                xmlrpc_methodListDestroy(registryP->methodListP);
+        }
         if (envP->fault_occurred)
             free(registryP);
     }
@@ -84,6 +102,11 @@ xmlrpc_registry_free(xmlrpc_registry * const registryP) {
 
     XMLRPC_ASSERT_PTR_OK(registryP);
 
+    if (registryP->multicallPoolP)
+        xmlrpc_workpoolDestroy(registryP->multicallPoolP);
+
+    xmlrpc_admissionDestroy(registryP->admissionP);
+
     xmlrpc_methodListDestroy(registryP->methodListP);
 
     free(registryP);
@@ -97,6 +120,7 @@ registryAddMethod(xmlrpc_env *      const envP,
                   const char *      const methodName,
                   xmlrpc_method1          method1,
                   xmlrpc_method2          method2,
+                  xmlrpc_async_method     methodAsync,
                   const char *      const signatureString,
                   const char *      const help,
                   void *            const userData,
@@ -110,9 +134,9 @@ registryAddMethod(xmlrpc_env *      const envP,
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT_PTR_OK(registryP);
     XMLRPC_ASSERT_PTR_OK(methodName);
-    XMLRPC_ASSERT(method1 != NULL || method2 != NULL);
+    XMLRPC_ASSERT(method1 != NULL || method2 != NULL || methodAsync != NULL);
 
-    xmlrpc_methodCreate(envP, method1, method2, userData,
+    xmlrpc_methodCreate(envP, method1, method2, methodAsync, userData,
                         signatureString, helpString, stackSize, &methodP);
 
     if (!envP->fault_occurred) {
@@ -139,7 +163,7 @@ xmlrpc_registry_add_method_w_doc(
 
     XMLRPC_ASSERT(host == NULL);
 
-    registryAddMethod(envP, registryP, methodName, method, NULL,
+    registryAddMethod(envP, registryP, methodName, method, NULL, NULL,
                       signatureString, help, serverInfo, 0);
 }
 
@@ -169,7 +193,7 @@ xmlrpc_registry_add_method2(xmlrpc_env *      const envP,
                             const char *      const help,
                             void *            const serverInfo) {
 
-    registryAddMethod(envP, registryP, methodName, NULL, method,
+    registryAddMethod(envP, registryP, methodName, NULL, method, NULL,
                       signatureString, help, serverInfo, 0);
 }
 
@@ -182,6 +206,28 @@ xmlrpc_registry_add_method3(
     const struct xmlrpc_method_info3 * const infoP) {
 
     registryAddMethod(envP, registryP, infoP->methodName, NULL,
+                      infoP->methodFunction, NULL,
+                      infoP->signatureString, infoP->help, infoP->serverInfo,
+                      infoP->stackSize);
+}
+
+
+
+void
+xmlrpc_registry_add_async_method(
+    xmlrpc_env *                            const envP,
+    xmlrpc_registry *                       const registryP,
+    const struct xmlrpc_async_method_info * const infoP) {
+/*----------------------------------------------------------------------------
+   Add an asynchronous method.  Its method function starts the call and
+   may return before the call is complete; whatever completes the call
+   calls xmlrpc_call_complete() or xmlrpc_call_fail() on the completion
+   handle the method function gets, exactly once.
+
+   The parameter array and call information the method function gets
+   remain valid until then.
+-----------------------------------------------------------------------------*/
+    registryAddMethod(envP, registryP, infoP->methodName, NULL, NULL,
                       infoP->methodFunction,
                       infoP->signatureString, infoP->help, infoP->serverInfo,
                       infoP->stackSize);
@@ -296,164 +342,1427 @@ xmlrpc_registry_set_dialect(xmlrpc_env *      const envP,
 
 
 static void
-callNamedMethod(xmlrpc_env *        const envP,
-                xmlrpc_methodInfo * const methodP,
-                xmlrpc_value *      const paramArrayP,
-                void *              const callInfoP,
-                xmlrpc_value **     const resultPP) {
+lookUpMethod(xmlrpc_env *         const envP,
+             xmlrpc_registry *    const registryP,
+             const char *         const methodName,
+             xmlrpc_methodInfo ** const methodPP) {
+
+    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                  methodPP);
+
+    if (!*methodPP)
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+            "Method '%s' not defined", methodName);
+}
 
-    if (methodP->methodFnType2)
-        *resultPP =
-            methodP->methodFnType2(envP, paramArrayP,
-                                   methodP->userData, callInfoP);
+
+
+void
+xmlrpc_registry_set_method_limits(
+    xmlrpc_env *                        const envP,
+    xmlrpc_registry *                   const registryP,
+    const char *                        const methodName,
+    const struct xmlrpc_method_limits * const limitsP) {
+/*----------------------------------------------------------------------------
+   Set concurrency limits for calls of method 'methodName'.
+
+   Calls that are already waiting to execute stay in the priority lane
+   they are in.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(limitsP);
+
+    if (limitsP->priority != xmlrpc_priority_high &&
+        limitsP->priority != xmlrpc_priority_normal &&
+        limitsP->priority != xmlrpc_priority_low)
+        xmlrpc_faultf(envP, "Invalid priority -- not of type "
+                      "xmlrpc_priority.  Numerical value is %u",
+                      limitsP->priority);
     else {
-        assert(methodP->methodFnType1);
-        *resultPP =
-            methodP->methodFnType1(envP, paramArrayP, methodP->userData);
+        xmlrpc_methodInfo * methodP;
+
+        lookUpMethod(envP, registryP, methodName, &methodP);
+
+        if (!envP->fault_occurred)
+            xmlrpc_admissionSetLimits(registryP->admissionP,
+                                      &methodP->admission, limitsP);
     }
 }
 
 
 
 void
-xmlrpc_dispatchCall(xmlrpc_env *      const envP, 
-                    xmlrpc_registry * const registryP,
-                    const char *      const methodName, 
-                    xmlrpc_value *    const paramArrayP,
-                    void *            const callInfoP,
-                    xmlrpc_value **   const resultPP) {
+xmlrpc_registry_set_max_concurrent(xmlrpc_registry * const registryP,
+                                   unsigned int      const maxConcurrent) {
+/*----------------------------------------------------------------------------
+   Limit the number of calls, of all methods together, that may execute at
+   once.  Zero means no limit.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(registryP);
 
-    if (registryP->preinvokeFunction)
-        registryP->preinvokeFunction(envP, methodName, paramArrayP,
-                                     registryP->preinvokeUserData);
+    xmlrpc_admissionSetMaxConcurrent(registryP->admissionP, maxConcurrent);
+}
 
-    if (!envP->fault_occurred) {
-        xmlrpc_methodInfo * methodP;
 
-        xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
-                                      &methodP);
 
-        if (methodP)
-            callNamedMethod(envP, methodP, paramArrayP, callInfoP, resultPP);
-        else {
-            if (registryP->defaultMethodFunction)
-                *resultPP = registryP->defaultMethodFunction(
-                    envP, callInfoP, methodName, paramArrayP,
-                    registryP->defaultMethodUserData);
-            else {
-                /* No matching method, and no default. */
-                xmlrpc_env_set_fault_formatted(
-                    envP, XMLRPC_NO_SUCH_METHOD_ERROR,
-                    "Method '%s' not defined", methodName);
-            } 
-        }
-    }
-    /* For backward compatibility, for sloppy users: */
-    if (envP->fault_occurred)
-        *resultPP = NULL;
+void
+xmlrpc_registry_get_method_queue_stats(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const char *                       const methodName,
+    struct xmlrpc_method_queue_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return statistics on how calls of method 'methodName' have fared
+   against concurrency limits.  Only calls that were subject to a limit
+   count.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    lookUpMethod(envP, registryP, methodName, &methodP);
+
+    if (!envP->fault_occurred)
+        xmlrpc_admissionGetStats(registryP->admissionP, &methodP->admission,
+                                 statsP);
 }
 
 
 
-/*=========================================================================
-**  xmlrpc_registry_process_call
-**=========================================================================
-**
-*/
+void
+xmlrpc_registry_set_parallel_multicall(xmlrpc_env *      const envP,
+                                       xmlrpc_registry * const registryP,
+                                       unsigned int      const threadCt,
+                                       unsigned int      const maxPerCall) {
+/*----------------------------------------------------------------------------
+   Make system.multicall execute the calls in it that are of parallel-safe
+   methods (see xmlrpc_registry_set_method_parallel_safe()) concurrently,
+   in a pool of 'threadCt' threads.  One system.multicall executes no more
+   than 'maxPerCall' calls at once (zero means no limit of its own).
 
-static void
-serializeFault(xmlrpc_env *       const envP,
-               xmlrpc_env         const fault,
-               xmlrpc_mem_block * const responseXmlP) {
+   The other calls in a system.multicall still execute one at a time, in
+   order, and the results are in the order of the calls regardless.
 
-    xmlrpc_env env;
+   'threadCt' zero means system.multicall executes all its calls one at a
+   time, in order, which is the default.
 
-    xmlrpc_env_init(&env);
+   Don't do this while the registry is processing a call.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_workpool * poolP;
 
-    xmlrpc_serialize_fault(&env, responseXmlP, &fault);
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
 
-    if (env.fault_occurred)
-        xmlrpc_faultf(envP,
-                      "Executed XML-RPC method completely and it "
-                      "generated a fault response, but we failed "
-                      "to encode that fault response as XML-RPC "
-                      "so we could send it to the client.  %s",
-                      env.fault_string);
+    if (threadCt > 0)
+        xmlrpc_workpoolCreate(envP, threadCt, &poolP);
+    else
+        poolP = NULL;
 
-    xmlrpc_env_clean(&env);
+    if (!envP->fault_occurred) {
+        if (registryP->multicallPoolP)
+            xmlrpc_workpoolDestroy(registryP->multicallPoolP);
+
+        registryP->multicallPoolP      = poolP;
+        registryP->multicallMaxPerCall = maxPerCall;
+    }
 }
 
 
 
 void
-xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
-                              xmlrpc_registry *   const registryP,
-                              const char *        const callXml,
-                              size_t              const callXmlLen,
-                              void *              const callInfo,
-                              xmlrpc_mem_block ** const responseXmlPP) {
+xmlrpc_registry_set_method_parallel_safe(xmlrpc_env *      const envP,
+                                         xmlrpc_registry * const registryP,
+                                         const char *      const methodName,
+                                         xmlrpc_bool       const safe) {
+/*----------------------------------------------------------------------------
+   Declare whether a call of method 'methodName' may execute concurrently
+   with, and in any order relative to, the other calls in the same
+   system.multicall.  That is true of a method that has no side effects
+   those calls could see.  By default, it is false.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
 
-    xmlrpc_mem_block * responseXmlP;
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    lookUpMethod(envP, registryP, methodName, &methodP);
+
+    if (!envP->fault_occurred)
+        methodP->parallelSafe = !!safe;
+}
+
+
+
+void
+xmlrpc_registry_set_method_check_signature(xmlrpc_env *      const envP,
+                                           xmlrpc_registry * const registryP,
+                                           const char *      const methodName,
+                                           xmlrpc_bool       const check) {
+/*----------------------------------------------------------------------------
+   Declare whether the registry should reject a call of method
+   'methodName' whose parameters don't match any of the signatures the
+   method was registered with.  If it does, the method function can rely
+   on the number and types of its parameters.  By default, it does not.
+
+   A method registered without signatures accepts any parameters either
+   way.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
 
     XMLRPC_ASSERT_ENV_OK(envP);
-    XMLRPC_ASSERT_PTR_OK(callXml);
-    
-    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+    XMLRPC_ASSERT_PTR_OK(registryP);
 
-    /* Allocate our output buffer.
-    ** If this fails, we need to die in a special fashion. */
-    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
-    if (!envP->fault_occurred) {
-        const char * methodName;
-        xmlrpc_value * paramArrayP;
-        xmlrpc_env fault;
-        xmlrpc_env parseEnv;
+    lookUpMethod(envP, registryP, methodName, &methodP);
 
-        xmlrpc_env_init(&fault);
-        xmlrpc_env_init(&parseEnv);
+    if (!envP->fault_occurred)
+        methodP->checkSignature = !!check;
+}
 
-        xmlrpc_parse_call(&parseEnv, callXml, callXmlLen, 
-                          &methodName, &paramArrayP);
 
-        if (parseEnv.fault_occurred)
-            xmlrpc_env_set_fault_formatted(
-                &fault, XMLRPC_PARSE_ERROR,
-                "Call XML not a proper XML-RPC call.  %s",
-                parseEnv.fault_string);
-        else {
-            xmlrpc_value * resultP;
-            
-            xmlrpc_dispatchCall(&fault, registryP, methodName, paramArrayP,
-                                callInfo, &resultP);
 
-            if (!fault.fault_occurred) {
-                xmlrpc_serialize_response2(envP, responseXmlP,
-                                           resultP, registryP->dialect);
+void
+xmlrpc_registry_set_method_coalescing(xmlrpc_env *      const envP,
+                                      xmlrpc_registry * const registryP,
+                                      const char *      const methodName,
+                                      xmlrpc_bool       const coalesce) {
+/*----------------------------------------------------------------------------
+   Declare whether a call of method 'methodName' that arrives while an
+   identical one (same parameters) is executing should wait for that one
+   and share its result or fault, instead of executing itself.  By
+   default, it does not.
+
+   Every call still goes through the preinvoke function, but only the
+   executing one is subject to the method's concurrency limits, and the
+   method function sees only its call information.  Calls of an
+   asynchronous method through xmlrpc_registry_process_call_async()
+   don't coalesce.
+
+   Don't do this while the registry is processing a call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    lookUpMethod(envP, registryP, methodName, &methodP);
 
-                xmlrpc_DECREF(resultP);
-            } 
-            xmlrpc_strfree(methodName);
-            xmlrpc_DECREF(paramArrayP);
+    if (!envP->fault_occurred) {
+        if (coalesce && !methodP->coalescerP)
+            xmlrpc_coalescerCreate(envP, &methodP->coalescerP);
+        else if (!coalesce && methodP->coalescerP) {
+            xmlrpc_coalescerDestroy(methodP->coalescerP);
+            methodP->coalescerP = NULL;
         }
-        if (!envP->fault_occurred && fault.fault_occurred)
-            serializeFault(envP, fault, responseXmlP);
+    }
+}
 
-        xmlrpc_env_clean(&parseEnv);
-        xmlrpc_env_clean(&fault);
 
-        if (envP->fault_occurred)
-            XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+
+void
+xmlrpc_registry_set_method_cache(
+    xmlrpc_env *                             const envP,
+    xmlrpc_registry *                        const registryP,
+    const char *                             const methodName,
+    const struct xmlrpc_method_cache_parms * const parmsP) {
+/*----------------------------------------------------------------------------
+   Cache the responses of method 'methodName' as described by *parmsP,
+   so that a call with the same parameters as a recent one gets the same
+   response without the method executing.  That is right only for a
+   method whose result depends on nothing but its parameters.
+
+   If the method already has a cache, this empties it and starts its
+   statistics over.
+
+   Don't do this while the registry is processing a call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(parmsP);
+
+    lookUpMethod(envP, registryP, methodName, &methodP);
+
+    if (!envP->fault_occurred) {
+        if (methodP->resultCacheP)
+            xmlrpc_resultCacheSetParms(methodP->resultCacheP, parmsP);
+        else
+            xmlrpc_resultCacheCreate(envP, parmsP, &methodP->resultCacheP);
+    }
+}
+
+
+
+void
+xmlrpc_registry_get_method_cache_stats(
+    xmlrpc_env *                       const envP,
+    xmlrpc_registry *                  const registryP,
+    const char *                       const methodName,
+    struct xmlrpc_method_cache_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return statistics on how the cache of responses of method 'methodName'
+   has done.  They are all zero if the method's responses have never
+   been cached.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    lookUpMethod(envP, registryP, methodName, &methodP);
+
+    if (!envP->fault_occurred) {
+        if (methodP->resultCacheP)
+            xmlrpc_resultCacheGetStats(methodP->resultCacheP, statsP);
         else {
-            *responseXmlPP = responseXmlP;
-            xmlrpc_traceXml("XML-RPC RESPONSE", 
-                            XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
-                            XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+            statsP->hitCt     = 0;
+            statsP->missCt    = 0;
+            statsP->expiredCt = 0;
+            statsP->evictedCt = 0;
+            statsP->entryCt   = 0;
+            statsP->byteCt    = 0;
         }
     }
 }
 
 
 
+void
+xmlrpc_registry_get_method_stats(xmlrpc_env *                 const envP,
+                                 xmlrpc_registry *            const registryP,
+                                 const char *                 const methodName,
+                                 struct xmlrpc_method_stats * const statsP) {
+/*----------------------------------------------------------------------------
+   Return statistics on the calls of method 'methodName' since it was
+   registered.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+    XMLRPC_ASSERT_PTR_OK(statsP);
+
+    lookUpMethod(envP, registryP, methodName, &methodP);
+
+    if (!envP->fault_occurred)
+        xmlrpc_methodStatsRead(&methodP->stats, statsP);
+}
+
+
+
+typedef void callDoneFn(void *             const context,
+                        const xmlrpc_env * const faultP,
+                        xmlrpc_value *     const resultP);
+
+struct xmlrpc_call_completion {
+/*----------------------------------------------------------------------------
+   A call of an asynchronous method that has started, but not completed
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * registryP;
+    xmlrpc_methodInfo * methodP;
+    bool admitted;
+        /* Admission control let the call execute, so must hear when it
+           is done.
+        */
+    callDoneFn * doneFn;
+    void * doneContext;
+        /* We call doneFn(doneContext, ...) when the call completes */
+    bool timed;
+        /* We record the call in the method's statistics when it
+           completes, as having started at 'startTime'.
+        */
+    xmlrpc_timespec startTime;
+};
+
+
+
+static void
+startAsyncCall(xmlrpc_env *        const envP,
+               xmlrpc_registry *   const registryP,
+               xmlrpc_methodInfo * const methodP,
+               bool                const admitted,
+               xmlrpc_value *      const paramArrayP,
+               void *              const callInfoP,
+               const xmlrpc_timespec * const startTimeP,
+               callDoneFn *        const doneFn,
+               void *              const doneContext) {
+/*----------------------------------------------------------------------------
+   Call the method function of asynchronous method *methodP.  When the
+   call completes, which may be before we return, we call
+   doneFn(doneContext, ...).  Unless we fail.
+
+   If 'startTimeP' is non-NULL, we record the call in the method's
+   statistics as having started at *startTimeP when it completes.
+-----------------------------------------------------------------------------*/
+    xmlrpc_call_completion * completionP;
+
+    MALLOCVAR(completionP);
+
+    if (completionP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for call completion");
+    else {
+        completionP->registryP   = registryP;
+        completionP->methodP     = methodP;
+        completionP->admitted    = admitted;
+        completionP->doneFn      = doneFn;
+        completionP->doneContext = doneContext;
+        completionP->timed       = !!startTimeP;
+        if (startTimeP)
+            completionP->startTime = *startTimeP;
+
+        methodP->methodFnAsync(paramArrayP, methodP->userData, callInfoP,
+                               completionP);
+    }
+}
+
+
+
+static void
+finishCall(xmlrpc_call_completion * const completionP,
+           const xmlrpc_env *       const faultP,
+           xmlrpc_value *           const resultP) {
+
+    if (completionP->admitted)
+        xmlrpc_admissionLeave(completionP->registryP->admissionP,
+                              &completionP->methodP->admission);
+
+    if (completionP->timed)
+        xmlrpc_methodStatsCallEnd(&completionP->methodP->stats,
+                                  completionP->startTime,
+                                  faultP->fault_occurred);
+
+    completionP->doneFn(completionP->doneContext, faultP, resultP);
+
+    free(completionP);
+}
+
+
+
+void
+xmlrpc_call_complete(xmlrpc_call_completion * const completionP,
+                     xmlrpc_value *           const resultP) {
+/*----------------------------------------------------------------------------
+   Complete a call of an asynchronous method successfully, with result
+   *resultP.  We take over Caller's reference to *resultP.
+
+   *completionP is invalid after this.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+
+    XMLRPC_ASSERT_PTR_OK(completionP);
+    XMLRPC_ASSERT_VALUE_OK(resultP);
+
+    xmlrpc_env_init(&env);
+
+    finishCall(completionP, &env, resultP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+void
+xmlrpc_call_fail(xmlrpc_call_completion * const completionP,
+                 int                      const faultCode,
+                 const char *             const faultString) {
+/*----------------------------------------------------------------------------
+   Complete a call of an asynchronous method with a fault.
+
+   *completionP is invalid after this.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+
+    XMLRPC_ASSERT_PTR_OK(completionP);
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_env_set_fault(&env, faultCode, faultString);
+
+    finishCall(completionP, &env, NULL);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A call of an asynchronous method that a thread is waiting for
+-----------------------------------------------------------------------------*/
+    lock * lockP;
+    condition * doneP;
+        /* Signalled when the call completes */
+    bool done;
+    xmlrpc_env fault;
+        /* How the call failed, if it did */
+    xmlrpc_value * resultP;
+        /* The call's result, if it succeeded */
+} syncCall;
+
+
+
+static callDoneFn syncCallDone;
+
+static void
+syncCallDone(void *             const context,
+             const xmlrpc_env * const faultP,
+             xmlrpc_value *     const resultP) {
+
+    syncCall * const callP = context;
+
+    callP->lockP->acquire(callP->lockP);
+
+    if (faultP->fault_occurred)
+        xmlrpc_env_set_fault(&callP->fault,
+                             faultP->fault_code, faultP->fault_string);
+    else
+        callP->resultP = resultP;
+
+    callP->done = true;
+
+    callP->doneP->signal(callP->doneP);
+
+    callP->lockP->release(callP->lockP);
+}
+
+
+
+static void
+callAsyncMethodAndWait(xmlrpc_env *        const envP,
+                       xmlrpc_methodInfo * const methodP,
+                       xmlrpc_value *      const paramArrayP,
+                       void *              const callInfoP,
+                       xmlrpc_value **     const resultPP) {
+/*----------------------------------------------------------------------------
+   Call asynchronous method *methodP and wait for the call to complete.
+-----------------------------------------------------------------------------*/
+    syncCall call;
+
+    call.lockP = xmlrpc_lock_create();
+
+    if (call.lockP == NULL)
+        xmlrpc_faultf(envP, "Unable to create lock for call");
+    else {
+        call.doneP = xmlrpc_condition_create();
+
+        if (call.doneP == NULL)
+            xmlrpc_faultf(envP, "Unable to create condition for call");
+        else {
+            call.done = false;
+            xmlrpc_env_init(&call.fault);
+
+            startAsyncCall(envP, NULL, methodP, false, paramArrayP,
+                           callInfoP, NULL, &syncCallDone, &call);
+
+            if (!envP->fault_occurred) {
+                call.lockP->acquire(call.lockP);
+
+                while (!call.done)
+                    call.doneP->wait(call.doneP, call.lockP);
+
+                call.lockP->release(call.lockP);
+
+                if (call.fault.fault_occurred)
+                    xmlrpc_env_set_fault(envP, call.fault.fault_code,
+                                         call.fault.fault_string);
+                else
+                    *resultPP = call.resultP;
+            }
+            xmlrpc_env_clean(&call.fault);
+
+            call.doneP->destroy(call.doneP);
+        }
+        call.lockP->destroy(call.lockP);
+    }
+}
+
+
+
+static void
+callNamedMethod(xmlrpc_env *        const envP,
+                xmlrpc_methodInfo * const methodP,
+                xmlrpc_value *      const paramArrayP,
+                void *              const callInfoP,
+                xmlrpc_value **     const resultPP) {
+
+    if (methodP->methodFnAsync)
+        callAsyncMethodAndWait(envP, methodP, paramArrayP, callInfoP,
+                               resultPP);
+    else if (methodP->methodFnType2)
+        *resultPP =
+            methodP->methodFnType2(envP, paramArrayP,
+                                   methodP->userData, callInfoP);
+    else {
+        assert(methodP->methodFnType1);
+        *resultPP =
+            methodP->methodFnType1(envP, paramArrayP, methodP->userData);
+    }
+}
+
+
+
+static void
+failIfCancelled(xmlrpc_env *      const envP,
+                xmlrpc_call_ctl * const ctlP,
+                const char *      const methodName) {
+
+    if (xmlrpc_call_cancelled(ctlP))
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_TIMEOUT_ERROR,
+            "Call of method '%s' was cancelled before it executed.  Its "
+            "deadline passed or its caller went away", methodName);
+}
+
+
+
+static void
+executeMethod(xmlrpc_env *        const envP,
+              xmlrpc_registry *   const registryP,
+              xmlrpc_methodInfo * const methodP,
+              const char *        const methodName,
+              xmlrpc_value *      const paramArrayP,
+              void *              const callInfoP,
+              xmlrpc_call_ctl *   const ctlP,
+              xmlrpc_value **     const resultPP,
+              bool *              const executedP) {
+/*----------------------------------------------------------------------------
+   Execute a call of method *methodP, subject to its concurrency limits,
+   unless the call is cancelled (per *ctlP) before it gets to execute.
+
+   Return *executedP false if the call failed without executing: admission
+   control refused it, or it was cancelled.
+-----------------------------------------------------------------------------*/
+    bool admitted;
+
+    *executedP = false;  /* initial value */
+
+    xmlrpc_admissionEnter(envP, registryP->admissionP,
+                          &methodP->admission, methodName, ctlP, &admitted);
+
+    if (!envP->fault_occurred) {
+        failIfCancelled(envP, ctlP, methodName);
+
+        if (!envP->fault_occurred) {
+            callNamedMethod(envP, methodP, paramArrayP, callInfoP, resultPP);
+
+            *executedP = true;
+        }
+
+        if (admitted)
+            xmlrpc_admissionLeave(registryP->admissionP,
+                                  &methodP->admission);
+    }
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A call for a coalescer to execute
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * registryP;
+    xmlrpc_methodInfo * methodP;
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    void * callInfoP;
+    xmlrpc_call_ctl * ctlP;
+} methodCall;
+
+
+
+static xmlrpc_coalescerFn executeMethodCall;
+
+static void
+executeMethodCall(xmlrpc_env *    const envP,
+                  void *          const arg,
+                  xmlrpc_value ** const resultPP,
+                  bool *          const executedP) {
+
+    methodCall * const callP = arg;
+
+    executeMethod(envP, callP->registryP, callP->methodP, callP->methodName,
+                  callP->paramArrayP, callP->callInfoP, callP->ctlP,
+                  resultPP, executedP);
+}
+
+
+
+void
+xmlrpc_dispatchCall(xmlrpc_env *      const envP, 
+                    xmlrpc_registry * const registryP,
+                    const char *      const methodName, 
+                    xmlrpc_value *    const paramArrayP,
+                    void *            const callInfoP,
+                    xmlrpc_call_ctl * const ctlP,
+                    xmlrpc_value **   const resultPP) {
+/*----------------------------------------------------------------------------
+   Execute a call of method 'methodName'.
+
+   'ctlP' is the call control, which may cancel the call before it
+   executes.  NULL means nothing does.
+-----------------------------------------------------------------------------*/
+    if (registryP->preinvokeFunction)
+        registryP->preinvokeFunction(envP, methodName, paramArrayP,
+                                     registryP->preinvokeUserData);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_methodInfo * methodP;
+
+        xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                      &methodP);
+
+        if (methodP) {
+            xmlrpc_timespec startTime;
+
+            xmlrpc_methodStatsCallBegin(&methodP->stats, &startTime);
+
+            if (methodP->checkSignature)
+                xmlrpc_methodCheckParams(envP, methodP, methodName,
+                                         paramArrayP);
+
+            if (envP->fault_occurred) {
+                /* Parameters the method doesn't take */
+            } else if (methodP->coalescerP) {
+                methodCall call;
+
+                call.registryP   = registryP;
+                call.methodP     = methodP;
+                call.methodName  = methodName;
+                call.paramArrayP = paramArrayP;
+                call.callInfoP   = callInfoP;
+                call.ctlP        = ctlP;
+
+                xmlrpc_coalescerCall(envP, methodP->coalescerP, paramArrayP,
+                                     &executeMethodCall, &call, resultPP);
+            } else {
+                bool executed;
+
+                executeMethod(envP, registryP, methodP, methodName,
+                              paramArrayP, callInfoP, ctlP, resultPP,
+                              &executed);
+            }
+
+            xmlrpc_methodStatsCallEnd(&methodP->stats, startTime,
+                                      envP->fault_occurred);
+        } else {
+            if (registryP->defaultMethodFunction)
+                *resultPP = registryP->defaultMethodFunction(
+                    envP, callInfoP, methodName, paramArrayP,
+                    registryP->defaultMethodUserData);
+            else {
+                /* No matching method, and no default. */
+                xmlrpc_env_set_fault_formatted(
+                    envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+                    "Method '%s' not defined", methodName);
+            } 
+        }
+    }
+    /* For backward compatibility, for sloppy users: */
+    if (envP->fault_occurred)
+        *resultPP = NULL;
+}
+
+
+
+static void
+dispatchCallAsync(xmlrpc_registry * const registryP,
+                  const char *      const methodName, 
+                  xmlrpc_value *    const paramArrayP,
+                  void *            const callInfoP,
+                  xmlrpc_call_ctl * const ctlP,
+                  callDoneFn *      const doneFn,
+                  void *            const doneContext) {
+/*----------------------------------------------------------------------------
+   Like xmlrpc_dispatchCall(), but instead of returning the result, call
+   doneFn(doneContext, ...) with it.  If the method is asynchronous, that
+   may be after we return, in another thread.  Until then, Caller must
+   keep the parameter array, call information, and call control.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_methodInfo * methodP;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                  &methodP);
+
+    if (methodP && methodP->methodFnAsync) {
+        if (registryP->preinvokeFunction)
+            registryP->preinvokeFunction(&env, methodName, paramArrayP,
+                                         registryP->preinvokeUserData);
+
+        if (!env.fault_occurred) {
+            xmlrpc_timespec startTime;
+            bool admitted;
+
+            xmlrpc_methodStatsCallBegin(&methodP->stats, &startTime);
+
+            if (methodP->checkSignature)
+                xmlrpc_methodCheckParams(&env, methodP, methodName,
+                                         paramArrayP);
+
+            if (!env.fault_occurred)
+                xmlrpc_admissionEnter(&env, registryP->admissionP,
+                                      &methodP->admission, methodName, ctlP,
+                                      &admitted);
+
+            if (!env.fault_occurred) {
+                failIfCancelled(&env, ctlP, methodName);
+
+                if (!env.fault_occurred)
+                    startAsyncCall(&env, registryP, methodP, admitted,
+                                   paramArrayP, callInfoP, &startTime,
+                                   doneFn, doneContext);
+
+                if (env.fault_occurred && admitted)
+                    xmlrpc_admissionLeave(registryP->admissionP,
+                                          &methodP->admission);
+            }
+            if (env.fault_occurred)
+                xmlrpc_methodStatsCallEnd(&methodP->stats, startTime, true);
+        }
+        if (env.fault_occurred)
+            doneFn(doneContext, &env, NULL);
+    } else {
+        xmlrpc_value * resultP;
+
+        xmlrpc_dispatchCall(&env, registryP, methodName, paramArrayP,
+                            callInfoP, ctlP, &resultP);
+
+        doneFn(doneContext, &env, resultP);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
+/*=========================================================================
+**  xmlrpc_registry_process_call
+**=========================================================================
+**
+*/
+
+static void
+serializeFault(xmlrpc_env *       const envP,
+               xmlrpc_env         const fault,
+               xmlrpc_mem_block * const responseXmlP) {
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_serialize_fault(&env, responseXmlP, &fault);
+
+    if (env.fault_occurred)
+        xmlrpc_faultf(envP,
+                      "Executed XML-RPC method completely and it "
+                      "generated a fault response, but we failed "
+                      "to encode that fault response as XML-RPC "
+                      "so we could send it to the client.  %s",
+                      env.fault_string);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+makeResponse(xmlrpc_env *        const envP,
+             xmlrpc_registry *   const registryP,
+             const xmlrpc_env *  const faultP,
+             xmlrpc_value *      const resultP,
+             xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Make the XML of the response to a call that ended in fault *faultP or,
+   if that isn't a failure, returned *resultP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * responseXmlP;
+
+    responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+    if (!envP->fault_occurred) {
+        if (faultP->fault_occurred)
+            serializeFault(envP, *faultP, responseXmlP);
+        else
+            xmlrpc_serialize_response2(envP, responseXmlP,
+                                       resultP, registryP->dialect);
+
+        if (envP->fault_occurred)
+            XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
+        else {
+            *responseXmlPP = responseXmlP;
+            xmlrpc_traceXml("XML-RPC RESPONSE", 
+                            XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                            XMLRPC_MEMBLOCK_SIZE(char, responseXmlP));
+        }
+    }
+}
+
+
+
+static void
+setParseFault(xmlrpc_env *       const faultP,
+              const xmlrpc_env * const parseEnvP) {
+
+    xmlrpc_env_set_fault_formatted(
+        faultP, XMLRPC_PARSE_ERROR,
+        "Call XML not a proper XML-RPC call.  %s",
+        parseEnvP->fault_string);
+}
+
+
+
+static void
+recordPhase(xmlrpc_registry * const registryP,
+            const char *      const methodName,
+            xmlrpc_callPhase  const phase,
+            xmlrpc_timespec   const startTime) {
+/*----------------------------------------------------------------------------
+   Record in the statistics of method 'methodName', if there is such a
+   method, that phase 'phase' of a call of it, which started at
+   'startTime', is over.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                  &methodP);
+
+    if (methodP)
+        xmlrpc_methodStatsRecord(&methodP->stats, phase, startTime);
+}
+
+
+
+static void
+lookUpCachedResponse(xmlrpc_registry *            const registryP,
+                     const char *                 const methodName,
+                     xmlrpc_value *               const paramArrayP,
+                     struct xmlrpc_resultCache ** const cachePP,
+                     xmlrpc_resultCacheKey *      const keyP,
+                     xmlrpc_mem_block **          const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Find the cached response to a call of method 'methodName' with
+   parameters *paramArrayP.  Return it as *responseXmlPP, or NULL if
+   there isn't one.
+
+   If there isn't one but the response belongs in the cache once we have
+   it, return the cache as *cachePP and the call's key in it as *keyP;
+   else return *cachePP == NULL.  The caller must clean *keyP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    *cachePP       = NULL;
+    *responseXmlPP = NULL;
+
+    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                  &methodP);
+
+    if (methodP && xmlrpc_resultCacheEnabled(methodP->resultCacheP)) {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        xmlrpc_resultCacheMakeKey(&env, paramArrayP, registryP->dialect,
+                                  keyP);
+
+        if (!env.fault_occurred) {
+            xmlrpc_resultCacheLookup(&env, methodP->resultCacheP, keyP,
+                                     responseXmlPP);
+
+            if (!env.fault_occurred && !*responseXmlPP)
+                *cachePP = methodP->resultCacheP;
+            else
+                xmlrpc_resultCacheKeyClean(keyP);
+        }
+        /* A failure means merely that we execute the method */
+
+        if (*responseXmlPP)
+            xmlrpc_traceXml("XML-RPC RESPONSE (CACHED)",
+                            XMLRPC_MEMBLOCK_CONTENTS(char, *responseXmlPP),
+                            XMLRPC_MEMBLOCK_SIZE(char, *responseXmlPP));
+
+        xmlrpc_env_clean(&env);
+    }
+}
+
+
+
+static void
+cacheResponse(struct xmlrpc_resultCache * const cacheP,
+              xmlrpc_resultCacheKey *     const keyP,
+              const xmlrpc_env *          const faultP,
+              const xmlrpc_env *          const responseEnvP,
+              xmlrpc_mem_block *          const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Having missed in cache 'cacheP' (which may be NULL, meaning there is
+   nothing to do), record the response to the call with key *keyP,
+   if it is a success.
+-----------------------------------------------------------------------------*/
+    if (cacheP) {
+        if (!faultP->fault_occurred && !responseEnvP->fault_occurred)
+            xmlrpc_resultCacheStore(cacheP, keyP, responseXmlP);
+
+        xmlrpc_resultCacheKeyClean(keyP);
+    }
+}
+
+
+
+static void
+processParsedCall(xmlrpc_env *        const envP,
+                  xmlrpc_registry *   const registryP,
+                  const char *        const methodName,
+                  xmlrpc_value *      const paramArrayP,
+                  void *              const callInfo,
+                  xmlrpc_call_ctl *   const ctlP,
+                  xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Do everything xmlrpc_registry_process_call3() does after parsing the
+   call.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_resultCache * cacheP;
+    xmlrpc_resultCacheKey cacheKey;
+    xmlrpc_mem_block * cachedXmlP;
+
+    lookUpCachedResponse(registryP, methodName, paramArrayP,
+                         &cacheP, &cacheKey, &cachedXmlP);
+
+    if (cachedXmlP)
+        *responseXmlPP = cachedXmlP;
+    else {
+        xmlrpc_env fault;
+        xmlrpc_value * resultP;
+        xmlrpc_timespec startTime;
+
+        xmlrpc_env_init(&fault);
+
+        xmlrpc_dispatchCall(&fault, registryP, methodName, paramArrayP,
+                            callInfo, ctlP, &resultP);
+
+        xmlrpc_gettimeofday(&startTime);
+
+        makeResponse(envP, registryP, &fault, resultP, responseXmlPP);
+
+        recordPhase(registryP, methodName, xmlrpc_phase_serialize,
+                    startTime);
+
+        cacheResponse(cacheP, &cacheKey, &fault, envP,
+                      envP->fault_occurred ? NULL : *responseXmlPP);
+
+        if (!fault.fault_occurred)
+            xmlrpc_DECREF(resultP);
+
+        xmlrpc_env_clean(&fault);
+    }
+}
+
+
+
+void
+xmlrpc_registry_process_call3(xmlrpc_env *        const envP,
+                              xmlrpc_registry *   const registryP,
+                              const char *        const callXml,
+                              size_t              const callXmlLen,
+                              void *              const callInfo,
+                              xmlrpc_call_ctl *   const ctlP,
+                              xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Process the call whose XML is 'callXml'/'callXmlLen' and return the XML
+   of the response as *responseXmlPP.
+
+   'callInfo' is the transport's information about the call, for the
+   method.  'ctlP' is the call control: we don't start executing the call
+   after it says the call is cancelled, e.g. because its deadline passed
+   while it waited for a concurrency limit.  NULL means nothing cancels
+   the call.
+-----------------------------------------------------------------------------*/
+
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_env parseEnv;
+    xmlrpc_timespec startTime;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(callXml);
+    
+    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+
+    xmlrpc_env_init(&parseEnv);
+
+    xmlrpc_gettimeofday(&startTime);
+
+    xmlrpc_parse_call(&parseEnv, callXml, callXmlLen, 
+                      &methodName, &paramArrayP);
+
+    if (parseEnv.fault_occurred) {
+        xmlrpc_env fault;
+
+        xmlrpc_env_init(&fault);
+
+        setParseFault(&fault, &parseEnv);
+
+        makeResponse(envP, registryP, &fault, NULL, responseXmlPP);
+
+        xmlrpc_env_clean(&fault);
+    } else {
+        recordPhase(registryP, methodName, xmlrpc_phase_parse, startTime);
+
+        processParsedCall(envP, registryP, methodName, paramArrayP, callInfo,
+                          ctlP, responseXmlPP);
+
+        xmlrpc_strfree(methodName);
+        xmlrpc_DECREF(paramArrayP);
+    }
+    xmlrpc_env_clean(&parseEnv);
+}
+
+
+
+void
+xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
+                              xmlrpc_registry *   const registryP,
+                              const char *        const callXml,
+                              size_t              const callXmlLen,
+                              void *              const callInfo,
+                              xmlrpc_mem_block ** const responseXmlPP) {
+
+    xmlrpc_registry_process_call3(envP, registryP, callXml, callXmlLen,
+                                  callInfo, NULL, responseXmlPP);
+}
+
+
+
+void
+xmlrpc_registry_process_parsed_call(
+    xmlrpc_env *        const envP,
+    xmlrpc_registry *   const registryP,
+    const char *        const methodName,
+    xmlrpc_value *      const paramArrayP,
+    void *              const callInfo,
+    xmlrpc_call_ctl *   const ctlP,
+    double              const parseTime,
+    xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Like xmlrpc_registry_process_call3(), but for a call the caller has
+   already parsed, in 'parseTime' seconds.  This is for a caller that
+   parses the call so it can execute some methods itself (see
+   xmlrpc_registry_record_call()).
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodInfo * methodP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+    XMLRPC_ASSERT_ARRAY_OK(paramArrayP);
+
+    xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                  &methodP);
+
+    if (methodP)
+        xmlrpc_methodStatsRecordTime(&methodP->stats, xmlrpc_phase_parse,
+                                     parseTime);
+
+    processParsedCall(envP, registryP, methodName, paramArrayP, callInfo,
+                      ctlP, responseXmlPP);
+}
+
+
+
+void
+xmlrpc_registry_find_method(xmlrpc_env *                const envP,
+                            xmlrpc_registry *           const registryP,
+                            const char *                const methodName,
+                            struct xmlrpc_methodInfo ** const methodPP) {
+/*----------------------------------------------------------------------------
+   Return the registry's record of method 'methodName', for a caller that
+   executes calls of it itself to pass to
+   xmlrpc_registry_native_call_begin() and xmlrpc_registry_native_call_end().
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    lookUpMethod(envP, registryP, methodName, methodPP);
+}
+
+
+
+void
+xmlrpc_registry_native_call_begin(xmlrpc_methodInfo * const methodP) {
+/*----------------------------------------------------------------------------
+   Note in the statistics of method *methodP that a call of it that the
+   caller executes itself instead of having the registry do it is starting.
+-----------------------------------------------------------------------------*/
+    xmlrpc_timespec startTime;
+
+    XMLRPC_ASSERT_PTR_OK(methodP);
+
+    xmlrpc_methodStatsCallBegin(&methodP->stats, &startTime);
+}
+
+
+
+void
+xmlrpc_registry_native_call_end(
+    xmlrpc_methodInfo *              const methodP,
+    const struct xmlrpc_call_times * const timesP,
+    xmlrpc_bool                      const failed) {
+/*----------------------------------------------------------------------------
+   Note in the statistics of method *methodP that a call of it that began
+   with xmlrpc_registry_native_call_begin() is over.  *timesP is how long
+   each phase of the call took.
+-----------------------------------------------------------------------------*/
+    double phaseTime[XMLRPC_PHASE_CT];
+
+    XMLRPC_ASSERT_PTR_OK(methodP);
+    XMLRPC_ASSERT_PTR_OK(timesP);
+
+    phaseTime[xmlrpc_phase_parse]     = timesP->parseTime;
+    phaseTime[xmlrpc_phase_execute]   = timesP->executeTime;
+    phaseTime[xmlrpc_phase_serialize] = timesP->serializeTime;
+
+    xmlrpc_methodStatsAddCall(&methodP->stats, phaseTime, !!failed);
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A call xmlrpc_registry_process_call_async() is processing
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * registryP;
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_response_fn * responseFn;
+    void * responseContext;
+    struct xmlrpc_resultCache * cacheP;
+        /* Where the response belongs.  NULL if it doesn't get cached. */
+    xmlrpc_resultCacheKey cacheKey;
+        /* The call's key in 'cacheP'.  Meaningless if 'cacheP' is NULL. */
+} asyncCall;
+
+
+
+static callDoneFn respond;
+
+static void
+respond(void *             const context,
+        const xmlrpc_env * const faultP,
+        xmlrpc_value *     const resultP) {
+/*----------------------------------------------------------------------------
+   Finish processing a call, given how the method call ended.
+-----------------------------------------------------------------------------*/
+    asyncCall * const callP = context;
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * responseXmlP;
+    xmlrpc_timespec startTime;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_gettimeofday(&startTime);
+
+    makeResponse(&env, callP->registryP, faultP, resultP, &responseXmlP);
+
+    recordPhase(callP->registryP, callP->methodName, xmlrpc_phase_serialize,
+                startTime);
+
+    cacheResponse(callP->cacheP, &callP->cacheKey, faultP, &env,
+                  env.fault_occurred ? NULL : responseXmlP);
+
+    if (!faultP->fault_occurred)
+        xmlrpc_DECREF(resultP);
+
+    xmlrpc_strfree(callP->methodName);
+    xmlrpc_DECREF(callP->paramArrayP);
+
+    callP->responseFn(callP->responseContext, &env,
+                      env.fault_occurred ? NULL : responseXmlP);
+
+    free(callP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+processParsedCallAsync(asyncCall *       const callP,
+                       void *            const callInfo,
+                       xmlrpc_call_ctl * const ctlP) {
+/*----------------------------------------------------------------------------
+   Do everything xmlrpc_registry_process_call_async() does after parsing
+   the call, which is *callP.  We dispose of *callP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * cachedXmlP;
+
+    lookUpCachedResponse(callP->registryP, callP->methodName,
+                         callP->paramArrayP, &callP->cacheP,
+                         &callP->cacheKey, &cachedXmlP);
+
+    if (cachedXmlP) {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        callP->responseFn(callP->responseContext, &env, cachedXmlP);
+
+        xmlrpc_strfree(callP->methodName);
+        xmlrpc_DECREF(callP->paramArrayP);
+        free(callP);
+
+        xmlrpc_env_clean(&env);
+    } else
+        dispatchCallAsync(callP->registryP, callP->methodName,
+                          callP->paramArrayP, callInfo, ctlP,
+                          &respond, callP);
+}
+
+
+
+static void
+failNoMemory(xmlrpc_response_fn * const responseFn,
+             void *               const context) {
+
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_faultf(&env, "Unable to allocate memory for call");
+
+    responseFn(context, &env, NULL);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+void
+xmlrpc_registry_process_call_async(xmlrpc_registry *    const registryP,
+                                   const char *         const callXml,
+                                   size_t               const callXmlLen,
+                                   void *               const callInfo,
+                                   xmlrpc_call_ctl *    const ctlP,
+                                   xmlrpc_response_fn * const responseFn,
+                                   void *               const context) {
+/*----------------------------------------------------------------------------
+   Like xmlrpc_registry_process_call3(), except that instead of returning
+   the response XML, we call responseFn(context, ...) with it.  The
+   response function owns the response XML.
+
+   If the method is asynchronous, that may be after we return, in another
+   thread, so a server does not need to dedicate a thread to the call.
+   The call information and call control must remain valid until then.
+
+   If we can't make a response at all, we call the response function with
+   a fault and no response XML.
+-----------------------------------------------------------------------------*/
+    asyncCall * callP;
+
+    XMLRPC_ASSERT_PTR_OK(callXml);
+    
+    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+
+    MALLOCVAR(callP);
+
+    if (callP == NULL)
+        failNoMemory(responseFn, context);
+    else {
+        xmlrpc_env parseEnv;
+        xmlrpc_timespec startTime;
+
+        xmlrpc_env_init(&parseEnv);
+
+        callP->registryP       = registryP;
+        callP->responseFn      = responseFn;
+        callP->responseContext = context;
+
+        xmlrpc_gettimeofday(&startTime);
+
+        xmlrpc_parse_call(&parseEnv, callXml, callXmlLen, 
+                          &callP->methodName, &callP->paramArrayP);
+
+        if (parseEnv.fault_occurred) {
+            xmlrpc_env env;
+            xmlrpc_env fault;
+            xmlrpc_mem_block * responseXmlP;
+
+            xmlrpc_env_init(&env);
+            xmlrpc_env_init(&fault);
+
+            setParseFault(&fault, &parseEnv);
+
+            makeResponse(&env, registryP, &fault, NULL, &responseXmlP);
+
+            responseFn(context, &env,
+                       env.fault_occurred ? NULL : responseXmlP);
+
+            xmlrpc_env_clean(&fault);
+            xmlrpc_env_clean(&env);
+
+            free(callP);
+        } else {
+            recordPhase(registryP, callP->methodName, xmlrpc_phase_parse,
+                        startTime);
+
+            processParsedCallAsync(callP, callInfo, ctlP);
+        }
+
+        xmlrpc_env_clean(&parseEnv);
+    }
+}
+
+
+
+void
+xmlrpc_registry_process_parsed_call_async(
+    xmlrpc_registry *    const registryP,
+    const char *         const methodName,
+    xmlrpc_value *       const paramArrayP,
+    void *               const callInfo,
+    xmlrpc_call_ctl *    const ctlP,
+    double               const parseTime,
+    xmlrpc_response_fn * const responseFn,
+    void *               const context) {
+/*----------------------------------------------------------------------------
+   Like xmlrpc_registry_process_call_async(), but for a call the caller
+   has already parsed, in 'parseTime' seconds, as
+   xmlrpc_registry_process_parsed_call() is to
+   xmlrpc_registry_process_call3().
+-----------------------------------------------------------------------------*/
+    asyncCall * callP;
+
+    XMLRPC_ASSERT_PTR_OK(methodName);
+    XMLRPC_ASSERT_ARRAY_OK(paramArrayP);
+
+    MALLOCVAR(callP);
+
+    if (callP == NULL)
+        failNoMemory(responseFn, context);
+    else {
+        xmlrpc_methodInfo * methodP;
+
+        callP->registryP       = registryP;
+        callP->responseFn      = responseFn;
+        callP->responseContext = context;
+        callP->methodName      = xmlrpc_strdupsol(methodName);
+        callP->paramArrayP     = paramArrayP;
+
+        xmlrpc_INCREF(paramArrayP);
+
+        xmlrpc_methodListLookupByName(registryP->methodListP, methodName,
+                                      &methodP);
+
+        if (methodP)
+            xmlrpc_methodStatsRecordTime(&methodP->stats, xmlrpc_phase_parse,
+                                         parseTime);
+
+        processParsedCallAsync(callP, callInfo, ctlP);
+    }
+}
+
+
+
 xmlrpc_mem_block *
 xmlrpc_registry_process_call(xmlrpc_env *      const envP,
                              xmlrpc_registry * const registryP,
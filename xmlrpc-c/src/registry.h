@@ -10,6 +10,7 @@ xmlrpc_dispatchCall(struct _xmlrpc_env *     const envP,
                     const char *             const methodName, 
                     struct _xmlrpc_value *   const paramArrayP,
                     void *                   const callInfoP,
+                    xmlrpc_call_ctl *        const ctlP,
                     struct _xmlrpc_value **  const resultPP);
 
 #endif
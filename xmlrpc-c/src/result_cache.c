@@ -0,0 +1,751 @@
+/*=============================================================================
+                                result_cache
+===============================================================================
+  Caches of the responses to calls of pure methods.  See result_cache.h.
+
+  Contributed to the public domain.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "int.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/time_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+
+#include "result_cache.h"
+
+#define MIN_BUCKET_CT 16
+#define MAX_BUCKET_CT (1<<16)
+
+typedef struct cacheEntry {
+    struct cacheEntry * hashNextP;
+        /* Next entry in the same hash table bucket */
+    struct cacheEntry * newerP;
+    struct cacheEntry * olderP;
+        /* Neighbors in the list of entries in order of last use */
+    uint32_t hash;
+        /* Hash of the key */
+    size_t keySize;
+    size_t responseSize;
+    xmlrpc_timespec expiry;
+        /* When the entry becomes useless.  Meaningless if the cache has
+           no time to live.
+        */
+    /* The key bytes, then the response bytes, follow the structure in
+       the same memory block.
+    */
+} cacheEntry;
+
+struct xmlrpc_resultCache {
+    lock * lockP;
+        /* Protects everything below */
+    struct xmlrpc_method_cache_parms parms;
+    cacheEntry ** bucket;
+        /* Hash table of entries, with 'bucketCt' buckets */
+    unsigned int bucketCt;
+        /* A power of 2 */
+    cacheEntry * newestP;
+    cacheEntry * oldestP;
+        /* The entries in order of last use; the oldest is the first to
+           go when the cache is full.
+        */
+    struct xmlrpc_method_cache_stats stats;
+        /* Includes the current number of entries and their size */
+};
+
+
+
+static size_t
+entrySize(const cacheEntry * const entryP) {
+/*----------------------------------------------------------------------------
+   What the entry counts for against the cache's size limit
+-----------------------------------------------------------------------------*/
+    return sizeof(*entryP) + entryP->keySize + entryP->responseSize;
+}
+
+
+
+static const char *
+entryKey(const cacheEntry * const entryP) {
+
+    return (const char *)(entryP + 1);
+}
+
+
+
+static const char *
+entryResponse(const cacheEntry * const entryP) {
+
+    return entryKey(entryP) + entryP->keySize;
+}
+
+
+
+static unsigned int
+bucketCtForParms(const struct xmlrpc_method_cache_parms * const parmsP) {
+
+    unsigned int bucketCt;
+
+    for (bucketCt = MIN_BUCKET_CT;
+         bucketCt < parmsP->maxEntries && bucketCt < MAX_BUCKET_CT;
+         bucketCt *= 2);
+
+    return bucketCt;
+}
+
+
+
+static void
+createBuckets(xmlrpc_env *                            const envP,
+              struct xmlrpc_resultCache *             const cacheP,
+              const struct xmlrpc_method_cache_parms * const parmsP) {
+
+    unsigned int const bucketCt = bucketCtForParms(parmsP);
+
+    cacheEntry ** bucket;
+
+    MALLOCARRAY(bucket, bucketCt);
+
+    if (bucket == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for %u hash buckets",
+                      bucketCt);
+    else {
+        unsigned int i;
+
+        for (i = 0; i < bucketCt; ++i)
+            bucket[i] = NULL;
+
+        cacheP->bucket   = bucket;
+        cacheP->bucketCt = bucketCt;
+    }
+}
+
+
+
+static void
+initStats(struct xmlrpc_method_cache_stats * const statsP) {
+
+    statsP->hitCt     = 0;
+    statsP->missCt    = 0;
+    statsP->expiredCt = 0;
+    statsP->evictedCt = 0;
+    statsP->entryCt   = 0;
+    statsP->byteCt    = 0;
+}
+
+
+
+void
+xmlrpc_resultCacheCreate(xmlrpc_env *                            const envP,
+                         const struct xmlrpc_method_cache_parms * const parmsP,
+                         struct xmlrpc_resultCache **            const cachePP) {
+
+    struct xmlrpc_resultCache * cacheP;
+
+    MALLOCVAR(cacheP);
+
+    if (cacheP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for result cache");
+    else {
+        cacheP->lockP = xmlrpc_lock_create();
+
+        if (cacheP->lockP == NULL)
+            xmlrpc_faultf(envP, "Unable to create lock for result cache");
+        else {
+            createBuckets(envP, cacheP, parmsP);
+
+            if (!envP->fault_occurred) {
+                cacheP->parms   = *parmsP;
+                cacheP->newestP = NULL;
+                cacheP->oldestP = NULL;
+
+                initStats(&cacheP->stats);
+
+                *cachePP = cacheP;
+            } else
+                cacheP->lockP->destroy(cacheP->lockP);
+        }
+        if (envP->fault_occurred)
+            free(cacheP);
+    }
+}
+
+
+
+static void
+destroyEntries(struct xmlrpc_resultCache * const cacheP) {
+
+    cacheEntry * entryP;
+    cacheEntry * nextP;
+    unsigned int i;
+
+    for (entryP = cacheP->newestP; entryP; entryP = nextP) {
+        nextP = entryP->olderP;
+        free(entryP);
+    }
+    cacheP->newestP = NULL;
+    cacheP->oldestP = NULL;
+
+    for (i = 0; i < cacheP->bucketCt; ++i)
+        cacheP->bucket[i] = NULL;
+
+    cacheP->stats.entryCt = 0;
+    cacheP->stats.byteCt  = 0;
+}
+
+
+
+void
+xmlrpc_resultCacheDestroy(struct xmlrpc_resultCache * const cacheP) {
+
+    destroyEntries(cacheP);
+
+    free(cacheP->bucket);
+
+    cacheP->lockP->destroy(cacheP->lockP);
+
+    free(cacheP);
+}
+
+
+
+void
+xmlrpc_resultCacheSetParms(
+    struct xmlrpc_resultCache *              const cacheP,
+    const struct xmlrpc_method_cache_parms * const parmsP) {
+/*----------------------------------------------------------------------------
+   Change the cache's parameters.  This empties the cache and starts the
+   statistics over.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+
+    xmlrpc_env_init(&env);
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    destroyEntries(cacheP);
+
+    initStats(&cacheP->stats);
+
+    cacheP->parms = *parmsP;
+
+    if (bucketCtForParms(parmsP) != cacheP->bucketCt) {
+        cacheEntry ** const oldBucket = cacheP->bucket;
+
+        createBuckets(&env, cacheP, parmsP);
+
+        if (env.fault_occurred) {
+            /* We can live with the table we have */
+        } else
+            free(oldBucket);
+    }
+    cacheP->lockP->release(cacheP->lockP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+bool
+xmlrpc_resultCacheEnabled(struct xmlrpc_resultCache * const cacheP) {
+
+    return cacheP && cacheP->parms.maxEntries > 0;
+}
+
+
+
+/*----------------------------------------------------------------------------
+   Keys
+-----------------------------------------------------------------------------*/
+
+static void
+appendBytes(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const bytesP,
+            const void *       const data,
+            size_t             const size) {
+
+    XMLRPC_MEMBLOCK_APPEND(char, envP, bytesP, data, size);
+}
+
+
+
+static void
+appendSize(xmlrpc_env *       const envP,
+           xmlrpc_mem_block * const bytesP,
+           size_t             const size) {
+
+    appendBytes(envP, bytesP, &size, sizeof(size));
+}
+
+
+
+static void
+encodeValue(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const bytesP,
+            xmlrpc_value *     const valueP);
+
+
+
+static int
+compareMembers(const void * const aP,
+               const void * const bP) {
+
+    const _struct_member * const a = *(const _struct_member **)aP;
+    const _struct_member * const b = *(const _struct_member **)bP;
+
+    size_t const aSize = XMLRPC_MEMBLOCK_SIZE(char, &a->key->_block);
+    size_t const bSize = XMLRPC_MEMBLOCK_SIZE(char, &b->key->_block);
+
+    int const rc =
+        memcmp(XMLRPC_MEMBLOCK_CONTENTS(char, &a->key->_block),
+               XMLRPC_MEMBLOCK_CONTENTS(char, &b->key->_block),
+               MIN(aSize, bSize));
+
+    return rc != 0 ? rc : aSize < bSize ? -1 : aSize > bSize ? 1 : 0;
+}
+
+
+
+static void
+encodeStruct(xmlrpc_env *       const envP,
+             xmlrpc_mem_block * const bytesP,
+             xmlrpc_value *     const structP) {
+/*----------------------------------------------------------------------------
+   Encode the members in order of key, so that the order in which they
+   were added doesn't matter.
+-----------------------------------------------------------------------------*/
+    size_t const memberCt =
+        XMLRPC_MEMBLOCK_SIZE(_struct_member, &structP->_block);
+    _struct_member * const members =
+        XMLRPC_MEMBLOCK_CONTENTS(_struct_member, &structP->_block);
+
+    _struct_member ** sorted;
+
+    appendSize(envP, bytesP, memberCt);
+
+    MALLOCARRAY(sorted, MAX(memberCt, 1));
+
+    if (sorted == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory to sort %u "
+                      "struct members", (unsigned int)memberCt);
+    else {
+        unsigned int i;
+
+        for (i = 0; i < memberCt; ++i)
+            sorted[i] = &members[i];
+
+        qsort(sorted, memberCt, sizeof(sorted[0]), &compareMembers);
+
+        for (i = 0; i < memberCt && !envP->fault_occurred; ++i) {
+            encodeValue(envP, bytesP, sorted[i]->key);
+            if (!envP->fault_occurred)
+                encodeValue(envP, bytesP, sorted[i]->value);
+        }
+        free(sorted);
+    }
+}
+
+
+
+static void
+encodeValue(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const bytesP,
+            xmlrpc_value *     const valueP) {
+
+    unsigned char const type = (unsigned char)valueP->_type;
+
+    appendBytes(envP, bytesP, &type, sizeof(type));
+
+    if (!envP->fault_occurred) {
+        switch (valueP->_type) {
+        case XMLRPC_TYPE_INT:
+            appendBytes(envP, bytesP, &valueP->_value.i,
+                        sizeof(valueP->_value.i));
+            break;
+        case XMLRPC_TYPE_I8:
+            appendBytes(envP, bytesP, &valueP->_value.i8,
+                        sizeof(valueP->_value.i8));
+            break;
+        case XMLRPC_TYPE_BOOL: {
+            unsigned char const b = valueP->_value.b ? 1 : 0;
+            appendBytes(envP, bytesP, &b, sizeof(b));
+        } break;
+        case XMLRPC_TYPE_DOUBLE:
+            appendBytes(envP, bytesP, &valueP->_value.d,
+                        sizeof(valueP->_value.d));
+            break;
+        case XMLRPC_TYPE_DATETIME:
+            appendBytes(envP, bytesP, &valueP->_value.dt,
+                        sizeof(valueP->_value.dt));
+            break;
+        case XMLRPC_TYPE_STRING:
+        case XMLRPC_TYPE_BASE64: {
+            size_t const size = XMLRPC_MEMBLOCK_SIZE(char, &valueP->_block);
+            appendSize(envP, bytesP, size);
+            if (!envP->fault_occurred)
+                appendBytes(envP, bytesP,
+                            XMLRPC_MEMBLOCK_CONTENTS(char, &valueP->_block),
+                            size);
+        } break;
+        case XMLRPC_TYPE_ARRAY: {
+            size_t const itemCt =
+                XMLRPC_MEMBLOCK_SIZE(xmlrpc_value *, &valueP->_block);
+            xmlrpc_value ** const items =
+                XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, &valueP->_block);
+            unsigned int i;
+
+            appendSize(envP, bytesP, itemCt);
+
+            for (i = 0; i < itemCt && !envP->fault_occurred; ++i)
+                encodeValue(envP, bytesP, items[i]);
+        } break;
+        case XMLRPC_TYPE_STRUCT:
+            encodeStruct(envP, bytesP, valueP);
+            break;
+        case XMLRPC_TYPE_NIL:
+            break;
+        default:
+            xmlrpc_faultf(envP, "Parameter of type %u can't be part of "
+                          "a result cache key", valueP->_type);
+        }
+    }
+}
+
+
+
+static uint32_t
+hashBytes(const char * const bytes,
+          size_t       const size) {
+/*----------------------------------------------------------------------------
+   FNV-1a
+-----------------------------------------------------------------------------*/
+    uint32_t hash;
+    size_t i;
+
+    for (i = 0, hash = 2166136261U; i < size; ++i) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+
+
+void
+xmlrpc_resultCacheMakeKey(xmlrpc_env *            const envP,
+                          xmlrpc_value *          const paramArrayP,
+                          xmlrpc_dialect          const dialect,
+                          xmlrpc_resultCacheKey * const keyP) {
+/*----------------------------------------------------------------------------
+   Make the key for a call with parameters *paramArrayP whose response is
+   in dialect 'dialect'.
+-----------------------------------------------------------------------------*/
+    keyP->bytesP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+
+    if (!envP->fault_occurred) {
+        unsigned char const dialectByte = (unsigned char)dialect;
+
+        appendBytes(envP, keyP->bytesP, &dialectByte, sizeof(dialectByte));
+
+        if (!envP->fault_occurred)
+            encodeValue(envP, keyP->bytesP, paramArrayP);
+
+        if (envP->fault_occurred)
+            XMLRPC_MEMBLOCK_FREE(char, keyP->bytesP);
+        else
+            keyP->hash =
+                hashBytes(XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP),
+                          XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP));
+    }
+}
+
+
+
+void
+xmlrpc_resultCacheKeyClean(xmlrpc_resultCacheKey * const keyP) {
+
+    XMLRPC_MEMBLOCK_FREE(char, keyP->bytesP);
+}
+
+
+
+/*----------------------------------------------------------------------------
+   Entries
+-----------------------------------------------------------------------------*/
+
+static cacheEntry **
+bucketFor(struct xmlrpc_resultCache * const cacheP,
+          uint32_t                    const hash) {
+
+    return &cacheP->bucket[hash & (cacheP->bucketCt - 1)];
+}
+
+
+
+static cacheEntry **
+findEntry(struct xmlrpc_resultCache *   const cacheP,
+          const xmlrpc_resultCacheKey * const keyP) {
+/*----------------------------------------------------------------------------
+   Return the link in the hash chain that points to the entry for key
+   *keyP, or the null link at the end of the chain if there is none.
+-----------------------------------------------------------------------------*/
+    const char * const keyBytes = XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP);
+    size_t const keySize = XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP);
+
+    cacheEntry ** entryPP;
+
+    for (entryPP = bucketFor(cacheP, keyP->hash);
+         *entryPP &&
+             !((*entryPP)->hash == keyP->hash &&
+               (*entryPP)->keySize == keySize &&
+               memcmp(entryKey(*entryPP), keyBytes, keySize) == 0);
+         entryPP = &(*entryPP)->hashNextP);
+
+    return entryPP;
+}
+
+
+
+static void
+unlinkFromUseList(struct xmlrpc_resultCache * const cacheP,
+                  cacheEntry *                const entryP) {
+
+    if (entryP->newerP)
+        entryP->newerP->olderP = entryP->olderP;
+    else
+        cacheP->newestP = entryP->olderP;
+
+    if (entryP->olderP)
+        entryP->olderP->newerP = entryP->newerP;
+    else
+        cacheP->oldestP = entryP->newerP;
+}
+
+
+
+static void
+linkAsNewest(struct xmlrpc_resultCache * const cacheP,
+             cacheEntry *                const entryP) {
+
+    entryP->newerP = NULL;
+    entryP->olderP = cacheP->newestP;
+
+    if (cacheP->newestP)
+        cacheP->newestP->newerP = entryP;
+    else
+        cacheP->oldestP = entryP;
+
+    cacheP->newestP = entryP;
+}
+
+
+
+static void
+removeEntry(struct xmlrpc_resultCache * const cacheP,
+            cacheEntry **               const entryPP) {
+/*----------------------------------------------------------------------------
+   Remove the entry to which hash chain link *entryPP points.
+-----------------------------------------------------------------------------*/
+    cacheEntry * const entryP = *entryPP;
+
+    *entryPP = entryP->hashNextP;
+
+    unlinkFromUseList(cacheP, entryP);
+
+    --cacheP->stats.entryCt;
+    cacheP->stats.byteCt -= entrySize(entryP);
+
+    free(entryP);
+}
+
+
+
+static bool
+isExpired(const struct xmlrpc_resultCache * const cacheP,
+          const cacheEntry *                const entryP) {
+
+    bool retval;
+
+    if (cacheP->parms.ttlMs == 0)
+        retval = false;
+    else {
+        xmlrpc_timespec now;
+
+        xmlrpc_gettimeofday(&now);
+
+        retval = now.tv_sec > entryP->expiry.tv_sec ||
+            (now.tv_sec == entryP->expiry.tv_sec &&
+             now.tv_nsec >= entryP->expiry.tv_nsec);
+    }
+    return retval;
+}
+
+
+
+void
+xmlrpc_resultCacheLookup(xmlrpc_env *                  const envP,
+                         struct xmlrpc_resultCache *   const cacheP,
+                         const xmlrpc_resultCacheKey * const keyP,
+                         xmlrpc_mem_block **           const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Return as *responseXmlPP a copy of the cached response for key *keyP,
+   or NULL if there is none.
+-----------------------------------------------------------------------------*/
+    cacheEntry ** entryPP;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    entryPP = findEntry(cacheP, keyP);
+
+    if (*entryPP && isExpired(cacheP, *entryPP)) {
+        removeEntry(cacheP, entryPP);
+        ++cacheP->stats.expiredCt;
+    }
+    if (*entryPP) {
+        cacheEntry * const entryP = *entryPP;
+
+        xmlrpc_mem_block * const responseXmlP =
+            XMLRPC_MEMBLOCK_NEW(char, envP, entryP->responseSize);
+
+        if (!envP->fault_occurred) {
+            memcpy(XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                   entryResponse(entryP), entryP->responseSize);
+
+            unlinkFromUseList(cacheP, entryP);
+            linkAsNewest(cacheP, entryP);
+
+            ++cacheP->stats.hitCt;
+
+            *responseXmlPP = responseXmlP;
+        }
+    } else {
+        ++cacheP->stats.missCt;
+
+        *responseXmlPP = NULL;
+    }
+    cacheP->lockP->release(cacheP->lockP);
+}
+
+
+
+static bool
+isFull(const struct xmlrpc_resultCache * const cacheP,
+       size_t                            const newSize) {
+/*----------------------------------------------------------------------------
+   The cache has no room for a new entry of size 'newSize'
+-----------------------------------------------------------------------------*/
+    return cacheP->stats.entryCt >= cacheP->parms.maxEntries ||
+        (cacheP->parms.maxBytes > 0 &&
+         cacheP->stats.byteCt + newSize > cacheP->parms.maxBytes);
+}
+
+
+
+static void
+evictOldest(struct xmlrpc_resultCache * const cacheP) {
+
+    cacheEntry * const oldestP = cacheP->oldestP;
+
+    cacheEntry ** entryPP;
+
+    for (entryPP = bucketFor(cacheP, oldestP->hash);
+         *entryPP != oldestP;
+         entryPP = &(*entryPP)->hashNextP);
+
+    removeEntry(cacheP, entryPP);
+
+    ++cacheP->stats.evictedCt;
+}
+
+
+
+void
+xmlrpc_resultCacheStore(struct xmlrpc_resultCache *   const cacheP,
+                        const xmlrpc_resultCacheKey * const keyP,
+                        const xmlrpc_mem_block *      const responseXmlP) {
+/*----------------------------------------------------------------------------
+   Remember *responseXmlP as the response for key *keyP, making room by
+   discarding the least recently used responses.
+
+   If we can't, because of the size limit or lack of memory, don't.
+-----------------------------------------------------------------------------*/
+    size_t const keySize = XMLRPC_MEMBLOCK_SIZE(char, keyP->bytesP);
+    size_t const responseSize = XMLRPC_MEMBLOCK_SIZE(char, responseXmlP);
+    size_t const size = sizeof(cacheEntry) + keySize + responseSize;
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    if (cacheP->parms.maxEntries > 0 &&
+        (cacheP->parms.maxBytes == 0 || size <= cacheP->parms.maxBytes)) {
+
+        cacheEntry ** const entryPP = findEntry(cacheP, keyP);
+
+        cacheEntry * entryP;
+
+        /* Another thread may have stored the same call since we looked */
+        if (*entryPP)
+            removeEntry(cacheP, entryPP);
+
+        while (isFull(cacheP, size))
+            evictOldest(cacheP);
+
+        entryP = malloc(size);
+
+        if (entryP) {
+            cacheEntry ** const bucketP = bucketFor(cacheP, keyP->hash);
+
+            entryP->hash         = keyP->hash;
+            entryP->keySize      = keySize;
+            entryP->responseSize = responseSize;
+
+            memcpy((char *)entryKey(entryP),
+                   XMLRPC_MEMBLOCK_CONTENTS(char, keyP->bytesP), keySize);
+            memcpy((char *)entryResponse(entryP),
+                   XMLRPC_MEMBLOCK_CONTENTS(char, responseXmlP),
+                   responseSize);
+
+            if (cacheP->parms.ttlMs > 0) {
+                xmlrpc_gettimeofday(&entryP->expiry);
+
+                entryP->expiry.tv_sec  += cacheP->parms.ttlMs / 1000;
+                entryP->expiry.tv_nsec +=
+                    (cacheP->parms.ttlMs % 1000) * 1000000;
+                if (entryP->expiry.tv_nsec >= 1000000000) {
+                    ++entryP->expiry.tv_sec;
+                    entryP->expiry.tv_nsec -= 1000000000;
+                }
+            }
+            entryP->hashNextP = *bucketP;
+            *bucketP = entryP;
+
+            linkAsNewest(cacheP, entryP);
+
+            ++cacheP->stats.entryCt;
+            cacheP->stats.byteCt += size;
+        }
+    }
+    cacheP->lockP->release(cacheP->lockP);
+}
+
+
+
+void
+xmlrpc_resultCacheGetStats(struct xmlrpc_resultCache *        const cacheP,
+                           struct xmlrpc_method_cache_stats * const statsP) {
+
+    cacheP->lockP->acquire(cacheP->lockP);
+
+    *statsP = cacheP->stats;
+
+    cacheP->lockP->release(cacheP->lockP);
+}
@@ -0,0 +1,68 @@
+#ifndef RESULT_CACHE_H_INCLUDED
+#define RESULT_CACHE_H_INCLUDED
+
+#include "bool.h"
+#include "int.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/server.h"
+
+/* A result cache holds the responses to recent calls of one method, so the
+   registry can answer a call identical to one of them without executing
+   the method or serializing the result (see
+   xmlrpc_registry_set_method_cache()).
+*/
+
+struct xmlrpc_resultCache;
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   What identifies a call in a result cache: a canonical encoding of its
+   parameters.  Two parameter lists that are equal as XML-RPC values have
+   the same key, regardless of the order of struct members.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * bytesP;
+    uint32_t hash;
+} xmlrpc_resultCacheKey;
+
+void
+xmlrpc_resultCacheCreate(xmlrpc_env *                            const envP,
+                         const struct xmlrpc_method_cache_parms * const parmsP,
+                         struct xmlrpc_resultCache **            const cachePP);
+
+void
+xmlrpc_resultCacheDestroy(struct xmlrpc_resultCache * const cacheP);
+
+void
+xmlrpc_resultCacheSetParms(
+    struct xmlrpc_resultCache *              const cacheP,
+    const struct xmlrpc_method_cache_parms * const parmsP);
+
+bool
+xmlrpc_resultCacheEnabled(struct xmlrpc_resultCache * const cacheP);
+
+void
+xmlrpc_resultCacheMakeKey(xmlrpc_env *            const envP,
+                          xmlrpc_value *          const paramArrayP,
+                          xmlrpc_dialect          const dialect,
+                          xmlrpc_resultCacheKey * const keyP);
+
+void
+xmlrpc_resultCacheKeyClean(xmlrpc_resultCacheKey * const keyP);
+
+void
+xmlrpc_resultCacheLookup(xmlrpc_env *                  const envP,
+                         struct xmlrpc_resultCache *   const cacheP,
+                         const xmlrpc_resultCacheKey * const keyP,
+                         xmlrpc_mem_block **           const responseXmlPP);
+
+void
+xmlrpc_resultCacheStore(struct xmlrpc_resultCache *   const cacheP,
+                        const xmlrpc_resultCacheKey * const keyP,
+                        const xmlrpc_mem_block *      const responseXmlP);
+
+void
+xmlrpc_resultCacheGetStats(struct xmlrpc_resultCache *        const cacheP,
+                           struct xmlrpc_method_cache_stats * const statsP);
+
+#endif
@@ -6,8 +6,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bool.h"
+#include "mallocvar.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/condition.h"
+#include "xmlrpc-c/condition_platform.h"
+#include "xmlrpc-c/workpool_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "version.h"
@@ -24,6 +31,8 @@ struct systemMethodReg {
     const char *   const methodName;
     xmlrpc_method2 const methodFunction;
     const char *   const signatureString;
+    bool           const parallelSafe;
+        /* The method has no side effects (see xmlrpc_methodInfo) */
     const char *   const helpText;
 };
 
@@ -43,15 +52,28 @@ xmlrpc_registry_disable_introspection(xmlrpc_registry * const registryP) {
   system.multicall
 =========================================================================*/
 
-static void
-callOneMethod(xmlrpc_env *      const envP,
-              xmlrpc_registry * const registryP,
-              xmlrpc_value *    const rpcDescP,
-              void *            const callInfo,
-              xmlrpc_value **   const resultPP) {
-
+typedef struct {
+/*----------------------------------------------------------------------------
+   One of the calls in a system.multicall
+-----------------------------------------------------------------------------*/
     const char * methodName;
     xmlrpc_value * paramArrayP;
+    bool parallel;
+        /* The call may execute in a thread of the registry's multicall
+           pool, concurrently with other calls of the multicall.
+        */
+    xmlrpc_env fault;
+        /* How the call failed, if it did */
+    xmlrpc_value * resultValP;
+        /* The call's result, if it succeeded */
+} multicallEntry;
+
+
+
+static void
+parseOneCall(xmlrpc_env *     const envP,
+             xmlrpc_value *   const rpcDescP,
+             multicallEntry * const entryP) {
 
     XMLRPC_ASSERT_ENV_OK(envP);
 
@@ -63,40 +85,346 @@ callOneMethod(xmlrpc_env *      const envP,
             xmlrpc_value_type(rpcDescP));
     else {
         xmlrpc_decompose_value(envP, rpcDescP, "{s:s,s:A,*}",
-                               "methodName", &methodName,
-                               "params", &paramArrayP);
+                               "methodName", &entryP->methodName,
+                               "params", &entryP->paramArrayP);
         if (!envP->fault_occurred) {
             /* Watch out for a deep recursion attack. */
-            if (xmlrpc_streq(methodName, "system.multicall"))
+            if (xmlrpc_streq(entryP->methodName, "system.multicall"))
                 xmlrpc_env_set_fault_formatted(
                     envP,
                     XMLRPC_REQUEST_REFUSED_ERROR,
                     "Recursive system.multicall forbidden");
+
+            if (envP->fault_occurred) {
+                xmlrpc_DECREF(entryP->paramArrayP);
+                xmlrpc_strfree(entryP->methodName);
+            }
+        }
+    }
+}
+
+
+
+static void
+executeOneCall(xmlrpc_registry * const registryP,
+               multicallEntry *  const entryP,
+               void *            const callInfo) {
+
+    xmlrpc_env_init(&entryP->fault);
+
+    xmlrpc_dispatchCall(&entryP->fault, registryP, entryP->methodName,
+                        entryP->paramArrayP, callInfo, NULL,
+                        &entryP->resultValP);
+}
+
+
+
+static void
+addOneResult(xmlrpc_env *     const envP,
+             xmlrpc_value *   const resultsP,
+             multicallEntry * const entryP) {
+/*----------------------------------------------------------------------------
+   Append to *resultsP the multicall result for the executed call
+   *entryP, and release what the entry holds.
+
+   If *envP already indicates failure, just release.
+-----------------------------------------------------------------------------*/
+    if (!envP->fault_occurred) {
+        xmlrpc_value * resultP;
+
+        if (entryP->fault.fault_occurred) {
+            /* Method failed, so result is a fault structure */
+            resultP = 
+                xmlrpc_build_value(
+                    envP, "{s:i,s:s}",
+                    "faultCode", (xmlrpc_int32) entryP->fault.fault_code,
+                    "faultString", entryP->fault.fault_string);
+        } else
+            resultP = xmlrpc_build_value(envP, "(V)", entryP->resultValP);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_array_append_item(envP, resultsP, resultP);
+            xmlrpc_DECREF(resultP);
+        }
+    }
+    if (!entryP->fault.fault_occurred)
+        xmlrpc_DECREF(entryP->resultValP);
+    xmlrpc_env_clean(&entryP->fault);
+    xmlrpc_DECREF(entryP->paramArrayP);
+    xmlrpc_strfree(entryP->methodName);
+}
+
+
+
+static void
+callSequentially(xmlrpc_env *      const envP,
+                 xmlrpc_registry * const registryP,
+                 xmlrpc_value *    const methlistP,
+                 void *            const callInfo,
+                 xmlrpc_value *    const resultsP) {
+/*----------------------------------------------------------------------------
+   Execute the calls of a multicall one at a time, in order, adding their
+   results to *resultsP as we go.
+-----------------------------------------------------------------------------*/
+    unsigned int const methodCount = xmlrpc_array_size(envP, methlistP);
+
+    unsigned int i;
+
+    for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
+        xmlrpc_value * const methinfoP = 
+            xmlrpc_array_get_item(envP, methlistP, i);
+
+        multicallEntry entry;
+
+        XMLRPC_ASSERT_ENV_OK(envP);
+
+        parseOneCall(envP, methinfoP, &entry);
+
+        if (!envP->fault_occurred) {
+            executeOneCall(registryP, &entry, callInfo);
+
+            addOneResult(envP, resultsP, &entry);
+        }
+    }
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A system.multicall that is executing its parallel-safe calls in pool
+   threads.
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * registryP;
+    void * callInfo;
+    multicallEntry * entry;
+    unsigned int entryCt;
+    lock * lockP;
+        /* Protects everything below */
+    condition * runnerDoneP;
+        /* Signalled when a runner finishes */
+    unsigned int nextParallel;
+        /* Entries before this one that are parallel have been claimed
+           by a runner.
+        */
+    unsigned int runnerCt;
+        /* Runners submitted to the pool that have neither finished nor
+           been cancelled.
+        */
+} multicallContext;
+
+
+
+static void
+runParallelCalls(multicallContext * const contextP) {
+/*----------------------------------------------------------------------------
+   Execute unclaimed parallel calls of the multicall until there are
+   none left.
+-----------------------------------------------------------------------------*/
+    contextP->lockP->acquire(contextP->lockP);
+
+    while (contextP->nextParallel < contextP->entryCt) {
+        multicallEntry * const entryP =
+            &contextP->entry[contextP->nextParallel++];
+
+        if (entryP->parallel) {
+            contextP->lockP->release(contextP->lockP);
+
+            executeOneCall(contextP->registryP, entryP, contextP->callInfo);
+
+            contextP->lockP->acquire(contextP->lockP);
+        }
+    }
+    contextP->lockP->release(contextP->lockP);
+}
+
+
+
+static xmlrpc_workpoolFn runner;
+
+static void
+runner(void * const arg) {
+/*----------------------------------------------------------------------------
+   A pool job that helps execute a multicall's parallel calls.
+-----------------------------------------------------------------------------*/
+    multicallContext * const contextP = arg;
+
+    runParallelCalls(contextP);
+
+    contextP->lockP->acquire(contextP->lockP);
+
+    --contextP->runnerCt;
+
+    contextP->runnerDoneP->signal(contextP->runnerDoneP);
+
+    contextP->lockP->release(contextP->lockP);
+}
+
+
+
+static void
+executeInParallel(xmlrpc_registry *    const registryP,
+                  multicallContext *   const contextP,
+                  xmlrpc_workpoolJob * const job,
+                  unsigned int         const jobCt) {
+/*----------------------------------------------------------------------------
+   Execute every call of the multicall described by *contextP.  Use 'jobCt'
+   runners in the registry's multicall pool, plus this thread, for the
+   parallel ones.  This thread executes the others, one at a time in order.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    contextP->runnerCt = jobCt;
+
+    for (i = 0; i < jobCt; ++i)
+        xmlrpc_workpoolSubmit(registryP->multicallPoolP, &job[i],
+                              &runner, contextP);
+
+    for (i = 0; i < contextP->entryCt; ++i) {
+        if (!contextP->entry[i].parallel)
+            executeOneCall(registryP, &contextP->entry[i],
+                           contextP->callInfo);
+    }
+    runParallelCalls(contextP);
+
+    /* All the calls have been claimed now, so runners that haven't
+       started yet have nothing to do.
+    */
+    for (i = 0; i < jobCt; ++i) {
+        if (xmlrpc_workpoolCancel(registryP->multicallPoolP, &job[i])) {
+            contextP->lockP->acquire(contextP->lockP);
+            --contextP->runnerCt;
+            contextP->lockP->release(contextP->lockP);
+        }
+    }
+    contextP->lockP->acquire(contextP->lockP);
+
+    while (contextP->runnerCt > 0)
+        contextP->runnerDoneP->wait(contextP->runnerDoneP, contextP->lockP);
+
+    contextP->lockP->release(contextP->lockP);
+}
+
+
+
+static void
+parseAllCalls(xmlrpc_env *       const envP,
+              xmlrpc_value *     const methlistP,
+              multicallContext * const contextP,
+              unsigned int *     const parallelCtP) {
+
+    unsigned int i;
+
+    for (i = 0, *parallelCtP = 0;
+         i < contextP->entryCt && !envP->fault_occurred;
+         ++i) {
+
+        multicallEntry * const entryP = &contextP->entry[i];
+
+        xmlrpc_value * const methinfoP = 
+            xmlrpc_array_get_item(envP, methlistP, i);
+
+        XMLRPC_ASSERT_ENV_OK(envP);
+
+        parseOneCall(envP, methinfoP, entryP);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_methodInfo * methodP;
+
+            xmlrpc_methodListLookupByName(contextP->registryP->methodListP,
+                                          entryP->methodName, &methodP);
+
+            /* The default method is arbitrary user code, so we don't
+               know that it has no side effects.
+            */
+            entryP->parallel = methodP && methodP->parallelSafe;
+
+            if (entryP->parallel)
+                ++*parallelCtP;
+        }
+    }
+    if (envP->fault_occurred) {
+        unsigned int j;
+
+        for (j = 0; j < i - 1; ++j) {
+            xmlrpc_DECREF(contextP->entry[j].paramArrayP);
+            xmlrpc_strfree(contextP->entry[j].methodName);
+        }
+    }
+}
+
+
+
+static void
+callInParallel(xmlrpc_env *      const envP,
+               xmlrpc_registry * const registryP,
+               xmlrpc_value *    const methlistP,
+               void *            const callInfo,
+               xmlrpc_value *    const resultsP) {
+/*----------------------------------------------------------------------------
+   Execute the calls of a multicall, the parallel-safe ones concurrently
+   in the registry's multicall pool, and add their results to *resultsP in
+   the order of the calls.
+
+   The calls that aren't parallel-safe execute one at a time, in order,
+   in this thread.  We check every call before executing any, so a
+   malformed call means none execute.
+-----------------------------------------------------------------------------*/
+    multicallContext context;
+
+    context.registryP = registryP;
+    context.callInfo  = callInfo;
+    context.entryCt   = xmlrpc_array_size(envP, methlistP);
+
+    MALLOCARRAY(context.entry, context.entryCt);
+
+    if (context.entry == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for %u calls",
+                      context.entryCt);
+    else {
+        unsigned int parallelCt;
+
+        parseAllCalls(envP, methlistP, &context, &parallelCt);
+
+        if (!envP->fault_occurred) {
+            unsigned int const maxPerCall =
+                registryP->multicallMaxPerCall == 0 ?
+                parallelCt + 1 : registryP->multicallMaxPerCall;
+
+            /* This thread is one of the ones executing calls */
+            unsigned int const jobCt = MIN(parallelCt, maxPerCall - 1);
+
+            xmlrpc_workpoolJob * job;
+
+            MALLOCARRAY(job, MAX(jobCt, 1));
+
+            context.lockP       = xmlrpc_lock_create();
+            context.runnerDoneP = xmlrpc_condition_create();
+
+            context.nextParallel = 0;
+
+            if (job && context.lockP && context.runnerDoneP)
+                executeInParallel(registryP, &context, job, jobCt);
             else {
-                xmlrpc_env env;
-                xmlrpc_value * resultValP;
-
-                xmlrpc_env_init(&env);
-                xmlrpc_dispatchCall(&env, registryP, methodName, paramArrayP,
-                                    callInfo,
-                                    &resultValP);
-                if (env.fault_occurred) {
-                    /* Method failed, so result is a fault structure */
-                    *resultPP = 
-                        xmlrpc_build_value(
-                            envP, "{s:i,s:s}",
-                            "faultCode", (xmlrpc_int32) env.fault_code,
-                            "faultString", env.fault_string);
-                } else {
-                    *resultPP = xmlrpc_build_value(envP, "(V)", resultValP);
-
-                    xmlrpc_DECREF(resultValP);
-                }
-                xmlrpc_env_clean(&env);
+                /* We can still do it all in this thread */
+                unsigned int i;
+
+                for (i = 0; i < context.entryCt; ++i)
+                    executeOneCall(registryP, &context.entry[i], callInfo);
+            }
+            {
+                unsigned int i;
+
+                for (i = 0; i < context.entryCt; ++i)
+                    addOneResult(envP, resultsP, &context.entry[i]);
             }
-            xmlrpc_DECREF(paramArrayP);
-            xmlrpc_strfree(methodName);
+            if (context.runnerDoneP)
+                context.runnerDoneP->destroy(context.runnerDoneP);
+            if (context.lockP)
+                context.lockP->destroy(context.lockP);
+            free(job);
         }
+        free(context.entry);
     }
 }
 
@@ -161,26 +489,13 @@ system_multicall(xmlrpc_env *   const envP,
         /* Create an initially empty result list. */
         resultsP = xmlrpc_array_new(envP);
         if (!envP->fault_occurred) {
-            /* Loop over our input list, calling each method in turn. */
-            unsigned int const methodCount =
-                xmlrpc_array_size(envP, methlistP);
-            unsigned int i;
-            for (i = 0; i < methodCount && !envP->fault_occurred; ++i) {
-                xmlrpc_value * const methinfoP = 
-                    xmlrpc_array_get_item(envP, methlistP, i);
-            
-                xmlrpc_value * resultP;
-            
-                XMLRPC_ASSERT_ENV_OK(envP);
-            
-                callOneMethod(envP, registryP, methinfoP, callInfo, &resultP);
-            
-                if (!envP->fault_occurred) {
-                    /* Append this method result to our master array. */
-                    xmlrpc_array_append_item(envP, resultsP, resultP);
-                    xmlrpc_DECREF(resultP);
-                }
-            }
+            if (registryP->multicallPoolP)
+                callInParallel(envP, registryP, methlistP, callInfo,
+                               resultsP);
+            else
+                callSequentially(envP, registryP, methlistP, callInfo,
+                                 resultsP);
+
             if (envP->fault_occurred)
                 xmlrpc_DECREF(resultsP);
             xmlrpc_DECREF(methlistP);
@@ -195,6 +510,7 @@ static struct systemMethodReg const methodMulticall = {
     "system.multicall",
     &system_multicall,
     "A:A",
+    false,
     "Process an array of calls, and return an array of results.  Calls should "
     "be structs of the form {'methodName': string, 'params': array}. Each "
     "result will either be a single-item array containg the result value, or "
@@ -281,6 +597,7 @@ static struct systemMethodReg const methodListMethods = {
     "system.listMethods",
     &system_listMethods,
     "A:",
+    true,
     "Return an array of all available XML-RPC methods on this server.",
 };
 
@@ -339,6 +656,7 @@ static struct systemMethodReg const methodMethodExist = {
     "system.methodExist",
     &system_methodExist,
     "s:b",
+    true,
     "Tell whether a method by a specified name exists on this server",
 };
 
@@ -408,6 +726,7 @@ static struct systemMethodReg const methodMethodHelp = {
     "system.methodHelp",
     &system_methodHelp,
     "s:s",
+    true,
     "Given the name of a method, return a help string.",
 };
 
@@ -595,6 +914,7 @@ static struct systemMethodReg const methodMethodSignature = {
     "system.methodSignature",
     &system_methodSignature,
     "A:s",
+    true,
     "Given the name of a method, return an array of legal signatures. "
     "Each signature is an array of strings.  The first item of each signature "
     "is the return type, and any others items are parameter types.",
@@ -664,6 +984,7 @@ static struct systemMethodReg const methodShutdown = {
     "system.shutdown",
     &system_shutdown,
     "i:s",
+    false,
     "Shut down the server.  Return code is always zero.",
 };
 
@@ -726,6 +1047,7 @@ static struct systemMethodReg const methodCapabilities = {
     "system.capabilities",
     &system_capabilities,
     "S:",
+    true,
     "Return the capabilities of XML-RPC server.  This includes the "
     "version number of the XML-RPC For C/C++ software"
 };
@@ -792,12 +1114,182 @@ static struct systemMethodReg const methodGetCapabilities = {
     "system.getCapabilities",
     &system_getCapabilities,
     "S:",
+    true,
     "Return the list of standard capabilities of XML-RPC server.  "
     "See http://tech.groups.yahoo.com/group/xml-rpc/message/2897"
 };
 
 
 
+/*=========================================================================
+  system.stats
+=========================================================================*/
+
+static xmlrpc_value *
+latencyValue(xmlrpc_env *                        const envP,
+             const struct xmlrpc_latency_stats * const latencyP) {
+
+    return xmlrpc_build_value(envP, "{s:I,s:d,s:d,s:d,s:d,s:d}",
+                              "count", (xmlrpc_int64)latencyP->count,
+                              "total", latencyP->totalTime,
+                              "max",   latencyP->maxTime,
+                              "p50",   latencyP->p50Time,
+                              "p90",   latencyP->p90Time,
+                              "p99",   latencyP->p99Time);
+}
+
+
+
+static void
+buildMethodStats(xmlrpc_env *        const envP,
+                 xmlrpc_methodInfo * const methodP,
+                 xmlrpc_value **     const statsPP) {
+/*----------------------------------------------------------------------------
+   Make the XML-RPC struct that describes the statistics of method
+   *methodP.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_method_stats stats;
+    xmlrpc_value * parseP;
+
+    xmlrpc_methodStatsRead(&methodP->stats, &stats);
+
+    parseP = latencyValue(envP, &stats.parse);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_value * executeP;
+
+        executeP = latencyValue(envP, &stats.execute);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_value * serializeP;
+
+            serializeP = latencyValue(envP, &stats.serialize);
+
+            if (!envP->fault_occurred) {
+                *statsPP = xmlrpc_build_value(
+                    envP, "{s:I,s:I,s:i,s:V,s:V,s:V}",
+                    "calls",     (xmlrpc_int64)stats.callCt,
+                    "faults",    (xmlrpc_int64)stats.faultCt,
+                    "inFlight",  (xmlrpc_int32)stats.inFlightCt,
+                    "parse",     parseP,
+                    "execute",   executeP,
+                    "serialize", serializeP);
+
+                xmlrpc_DECREF(serializeP);
+            }
+            xmlrpc_DECREF(executeP);
+        }
+        xmlrpc_DECREF(parseP);
+    }
+}
+
+
+
+static void
+buildAllMethodStats(xmlrpc_env *      const envP,
+                    xmlrpc_registry * const registryP,
+                    xmlrpc_value **   const statsPP) {
+/*----------------------------------------------------------------------------
+   Make an XML-RPC struct with a member for each method in the registry,
+   whose value is that method's statistics.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * statsP;
+
+    statsP = xmlrpc_struct_new(envP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_methodNode * methodNodeP;
+
+        for (methodNodeP = registryP->methodListP->firstMethodP;
+             methodNodeP && !envP->fault_occurred;
+             methodNodeP = methodNodeP->nextP) {
+
+            xmlrpc_value * methodStatsP;
+
+            buildMethodStats(envP, methodNodeP->methodP, &methodStatsP);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_struct_set_value(envP, statsP,
+                                        methodNodeP->methodName,
+                                        methodStatsP);
+
+                xmlrpc_DECREF(methodStatsP);
+            }
+        }
+        if (envP->fault_occurred)
+            xmlrpc_DECREF(statsP);
+        else
+            *statsPP = statsP;
+    }
+}
+
+
+
+static xmlrpc_value *
+system_stats(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo,
+             void *         const callInfo ATTR_UNUSED) {
+
+    xmlrpc_registry * const registryP = serverInfo;
+
+    xmlrpc_value * retvalP;
+    unsigned int paramCount;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_VALUE_OK(paramArrayP);
+    XMLRPC_ASSERT_PTR_OK(serverInfo);
+
+    paramCount = xmlrpc_array_size(envP, paramArrayP);
+
+    if (!envP->fault_occurred) {
+        if (!registryP->introspectionEnabled)
+            xmlrpc_env_set_fault_formatted(
+                envP, XMLRPC_INTROSPECTION_DISABLED_ERROR,
+                "Introspection is disabled in this server "
+                "for security reasons");
+        else if (paramCount == 0)
+            buildAllMethodStats(envP, registryP, &retvalP);
+        else {
+            const char * methodName;
+
+            xmlrpc_decompose_value(envP, paramArrayP, "(s)", &methodName);
+
+            if (!envP->fault_occurred) {
+                xmlrpc_methodInfo * methodP;
+
+                xmlrpc_methodListLookupByName(registryP->methodListP,
+                                              methodName, &methodP);
+
+                if (!methodP)
+                    xmlrpc_env_set_fault_formatted(
+                        envP, XMLRPC_NO_SUCH_METHOD_ERROR,
+                        "Method '%s' does not exist", methodName);
+                else
+                    buildMethodStats(envP, methodP, &retvalP);
+
+                xmlrpc_strfree(methodName);
+            }
+        }
+    }
+    return retvalP;
+}
+
+
+
+static struct systemMethodReg const methodStats = {
+    "system.stats",
+    &system_stats,
+    "S:,S:s",
+    true,
+    "Return statistics on the calls of each method: number of calls and "
+    "faults, calls executing now, and the distribution of the time to "
+    "parse, execute, and serialize each call.  Given the name of a method, "
+    "return just that method's statistics."
+};
+
+
+
 /*============================================================================
   Installer of system methods
 ============================================================================*/
@@ -818,7 +1310,21 @@ registerSystemMethod(xmlrpc_env *           const envP,
     if (env.fault_occurred)
         xmlrpc_faultf(envP, "Failed to register '%s' system method.  %s",
                       methodReg.methodName, env.fault_string);
-    
+    else {
+        xmlrpc_methodInfo * methodP;
+
+        xmlrpc_methodListLookupByName(registryP->methodListP,
+                                      methodReg.methodName, &methodP);
+
+        /* A system method is part of the server, not work the server
+           does, so it doesn't take a share of the registry-wide
+           concurrency limit.  In particular, system.multicall mustn't,
+           because each of the calls it makes has to.
+        */
+        methodP->admission.exempt = true;
+
+        methodP->parallelSafe = methodReg.parallelSafe;
+    }
     xmlrpc_env_clean(&env);
 }
 
@@ -853,6 +1359,9 @@ xmlrpc_installSystemMethods(xmlrpc_env *      const envP,
 
     if (!envP->fault_occurred)
         registerSystemMethod(envP, registryP, methodGetCapabilities);
+
+    if (!envP->fault_occurred)
+        registerSystemMethod(envP, registryP, methodStats);
 }
 
 
@@ -16,11 +16,335 @@
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
 
+#include "plan_cache.h"
+
+
+/* THE BUILD PLAN
+
+   We execute xmlrpc_build_value() in two steps:
+
+   1) Compile the format string into a "build plan": a list of operations,
+      one per value the format string describes, in format string order.
+
+   2) Execute the plan, taking the variable arguments as we go.
+
+   The plan depends only on the format string, so one plan serves every
+   call with the same format string; see xmlrpc_build_plan_create().
+
+   An operation for an array is followed by the operations for its items.
+   An operation for a struct is followed by two operations per member:
+   the key and the value.
+*/
+
+struct buildOp {
+    char formatChar;
+        /* e.g. 'i', 's', 'A'.  '(' means array; '{' means struct */
+    bool hasLength;
+        /* The specifier is 's#' or 'w#' -- the length is an argument */
+    unsigned int childCt;
+        /* For '(', number of array items; for '{', number of struct
+           members.
+        */
+};
+
+struct xmlrpc_build_plan {
+/*----------------------------------------------------------------------------
+   A compiled format string.  Immutable once created, so any number of
+   threads may use it at once.
+-----------------------------------------------------------------------------*/
+    struct buildOp * op;
+    unsigned int opCt;
+    size_t formatLen;
+        /* How much of the format string the plan covers.  There may be
+           more after the specifier of the one value the plan builds.
+        */
+};
+
+
+
+static struct planCache * buildPlanCacheP;
+    /* Cache of plans for the format strings of xmlrpc_build_value() and
+       friends.  NULL if the program did not call xmlrpc_init(), in which
+       case we compile the format string on every call.
+    */
+
+
+
+static unsigned int
+addOp(xmlrpc_build_plan * const planP,
+      char                const formatChar) {
+
+    struct buildOp * const opP = &planP->op[planP->opCt];
+
+    opP->formatChar = formatChar;
+    opP->hasLength  = false;
+    opP->childCt    = 0;
+
+    return planP->opCt++;
+}
+
+
+
+static void
+compileValue(xmlrpc_env *        const envP,
+             const char **       const formatP,
+             xmlrpc_build_plan * const planP);
+
+
+
+static void
+compileArray(xmlrpc_env *        const envP,
+             const char **       const formatP,
+             char                const delimiter,
+             xmlrpc_build_plan * const planP,
+             unsigned int        const arrayOpIx) {
+
+    /* Add items to the array until we hit our delimiter. */
+    
+    while (**formatP != delimiter && !envP->fault_occurred) {
+        if (**formatP == '\0')
+            xmlrpc_env_set_fault(
+                envP, XMLRPC_INTERNAL_ERROR,
+                "format string ended before closing ')'.");
+        else {
+            compileValue(envP, formatP, planP);
+            ++planP->op[arrayOpIx].childCt;
+        }
+    }
+}
+
+
+
+static void
+compileStruct(xmlrpc_env *        const envP,
+              const char **       const formatP,
+              char                const delimiter,
+              xmlrpc_build_plan * const planP,
+              unsigned int        const structOpIx) {
+
+    while (**formatP != delimiter && !envP->fault_occurred) {
+        /* Get the key */
+        compileValue(envP, formatP, planP);
+
+        if (!envP->fault_occurred) {
+            if (**formatP != ':')
+                xmlrpc_env_set_fault(
+                    envP, XMLRPC_INTERNAL_ERROR,
+                    "format string does not have ':' after a "
+                    "structure member key.");
+            else {
+                /* Skip over colon that separates key from value */
+                (*formatP)++;
+            
+                /* Get the value */
+                compileValue(envP, formatP, planP);
+            }
+        }
+        if (!envP->fault_occurred) {
+            if (**formatP == ',')
+                (*formatP)++;  /* Skip over the comma */
+            else if (**formatP == delimiter) {
+                /* End of the line */
+            } else 
+                xmlrpc_env_set_fault(
+                    envP, XMLRPC_INTERNAL_ERROR,
+                    "format string does not have ',' or ')' after "
+                    "a structure member");
+                
+            ++planP->op[structOpIx].childCt;
+        }
+    }
+}
+
+
+
+static void
+compileValue(xmlrpc_env *        const envP,
+             const char **       const formatP,
+             xmlrpc_build_plan * const planP) {
+/*----------------------------------------------------------------------------
+   Add to *planP the operations to build the next value in the format
+   string.  *formatP points to the specifier for the next value in the
+   format string (i.e. to the type code character) and we move *formatP
+   past the whole specifier for that value.
+-----------------------------------------------------------------------------*/
+    char const formatChar = *(*formatP)++;
+
+    unsigned int const opIx = addOp(planP, formatChar);
+
+    switch (formatChar) {
+    case 'i':
+    case 'b':
+    case 'd':
+    case 't':
+    case '8':
+    case '6':
+    case 'n':
+    case 'I':
+    case 'p':
+    case 'A':
+    case 'S':
+    case 'V':
+        break;
+
+    case 's':
+        if (**formatP == '#') {
+            ++(*formatP);
+            planP->op[opIx].hasLength = true;
+        }
+        break;
+
+    case 'w':
+#if HAVE_UNICODE_WCHAR
+        if (**formatP == '#') {
+            ++(*formatP);
+            planP->op[opIx].hasLength = true;
+        }
+#else
+        xmlrpc_faultf(envP,
+                      "This XML-RPC For C/C++ library was built without "
+                      "Unicode wide character capability.  'w' isn't "
+                      "available.");
+#endif /* HAVE_UNICODE_WCHAR */
+        break;
+
+    case '(':
+        compileArray(envP, formatP, ')', planP, opIx);
+        if (!envP->fault_occurred) {
+            XMLRPC_ASSERT(**formatP == ')');
+            (*formatP)++;  /* Skip over closing parenthesis */
+        }
+        break;
+
+    case '{': 
+        compileStruct(envP, formatP, '}', planP, opIx);
+        if (!envP->fault_occurred) {
+            XMLRPC_ASSERT(**formatP == '}');
+            (*formatP)++;  /* Skip over closing brace */
+        }
+        break;
+
+    default: {
+        const char * const badCharacter = xmlrpc_makePrintableChar(formatChar);
+        xmlrpc_env_set_fault_formatted(
+            envP, XMLRPC_INTERNAL_ERROR,
+            "Unexpected character '%s' in format string", badCharacter);
+        xmlrpc_strfree(badCharacter);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_build_plan_create(xmlrpc_env *                const envP,
+                         const char *                const format,
+                         const xmlrpc_build_plan **  const planPP) {
+/*----------------------------------------------------------------------------
+   Compile the specifier of one value at the beginning of format string
+   'format' (as for xmlrpc_build_value_va()) into a plan for building
+   values, which Caller can use with xmlrpc_build_value_plan() over and over
+   without the cost of parsing the format string each time.
+
+   Like xmlrpc_build_value_va(), we ignore anything in 'format' after that
+   first specifier; xmlrpc_build_plan_tail() tells what it is.
+-----------------------------------------------------------------------------*/
+    xmlrpc_build_plan * planP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(format != NULL);
+
+    MALLOCVAR(planP);
+
+    if (planP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate space for a build plan");
+    else {
+        /* Every specifier character is at most one operation, so this
+           is enough:
+        */
+        MALLOCARRAY(planP->op, strlen(format) + 1);
+
+        if (planP->op == NULL)
+            xmlrpc_faultf(envP, "Could not allocate space for the "
+                          "operations of a build plan");
+        else {
+            const char * formatCursor;
+
+            planP->opCt = 0;
+            formatCursor = &format[0];
+
+            if (strlen(format) == 0)
+                xmlrpc_faultf(envP, "Format string is empty.");
+            else
+                compileValue(envP, &formatCursor, planP);
+
+            if (!envP->fault_occurred) {
+                planP->formatLen = formatCursor - &format[0];
+                *planPP = planP;
+            }
+            if (envP->fault_occurred)
+                free(planP->op);
+        }
+        if (envP->fault_occurred)
+            free(planP);
+    }
+}
+
+
+
+void
+xmlrpc_build_plan_destroy(const xmlrpc_build_plan * const planP) {
+
+    free(planP->op);
+    free((void*)planP);
+}
+
+
+
+const char *
+xmlrpc_build_plan_tail(const xmlrpc_build_plan * const planP,
+                       const char *              const format) {
+/*----------------------------------------------------------------------------
+   The part of format string 'format', from which Caller compiled *planP,
+   that is after the specifier of the value *planP builds.
+-----------------------------------------------------------------------------*/
+    return &format[planP->formatLen];
+}
+
+
+
+static void
+destroyPlan(const void * const planP) {
+/*----------------------------------------------------------------------------
+   This is a planCacheDestroyFn.
+-----------------------------------------------------------------------------*/
+    xmlrpc_build_plan_destroy(planP);
+}
+
+
+
+void
+xmlrpc_buildInit(xmlrpc_env * const envP) {
+
+    xmlrpc_planCacheCreate(envP, &destroyPlan, &buildPlanCacheP);
+}
+
+
+
+void
+xmlrpc_buildTerm(void) {
+
+    if (buildPlanCacheP) {
+        xmlrpc_planCacheDestroy(buildPlanCacheP);
+        buildPlanCacheP = NULL;
+    }
+}
+
 
 
 static void
 getString(xmlrpc_env *    const envP,
-          const char **   const formatP,
+          bool            const hasLength,
           va_listx *      const argsP,
           xmlrpc_value ** const valPP) {
 
@@ -28,10 +352,9 @@ getString(xmlrpc_env *    const envP,
     size_t len;
     
     str = (const char*) va_arg(argsP->v, char*);
-    if (*(*formatP) == '#') {
-        ++(*formatP);
+    if (hasLength)
         len = (size_t) va_arg(argsP->v, size_t);
-    } else
+    else
         len = strlen(str);
 
     *valPP = xmlrpc_string_new_lp(envP, len, str);
@@ -41,7 +364,7 @@ getString(xmlrpc_env *    const envP,
 
 static void
 getWideString(xmlrpc_env *    const envP ATTR_UNUSED,
-              const char **   const formatP ATTR_UNUSED,
+              bool            const hasLength ATTR_UNUSED,
               va_listx *      const argsP ATTR_UNUSED,
               xmlrpc_value ** const valPP ATTR_UNUSED) {
 
@@ -50,10 +373,9 @@ getWideString(xmlrpc_env *    const envP ATTR_UNUSED,
     size_t len;
     
     wcs = (wchar_t*) va_arg(argsP->v, wchar_t*);
-    if (**formatP == '#') {
-        (*formatP)++;
+    if (hasLength)
         len = (size_t) va_arg(argsP->v, size_t);
-    } else
+    else
         len = wcslen(wcs);
 
     *valPP = xmlrpc_string_w_new_lp(envP, len, wcs);
@@ -80,40 +402,32 @@ getBase64(xmlrpc_env *    const envP,
 
 
 static void
-getValue(xmlrpc_env *    const envP, 
-         const char**    const format, 
-         va_listx *      const argsP,
-         xmlrpc_value ** const valPP);
+getValue(xmlrpc_env *            const envP, 
+         const struct buildOp ** const opPP,
+         va_listx *              const argsP,
+         xmlrpc_value **         const valPP);
 
 
 
 static void
-getArray(xmlrpc_env *    const envP,
-         const char **   const formatP,
-         char            const delimiter,
-         va_listx *      const argsP,
-         xmlrpc_value ** const arrayPP) {
+getArray(xmlrpc_env *            const envP,
+         unsigned int            const itemCt,
+         const struct buildOp ** const opPP,
+         va_listx *              const argsP,
+         xmlrpc_value **         const arrayPP) {
 
     xmlrpc_value * arrayP;
+    unsigned int i;
 
     arrayP = xmlrpc_array_new(envP);
 
-    /* Add items to the array until we hit our delimiter. */
-    
-    while (**formatP != delimiter && !envP->fault_occurred) {
-        
+    for (i = 0; i < itemCt && !envP->fault_occurred; ++i) {
         xmlrpc_value * itemP;
         
-        if (**formatP == '\0')
-            xmlrpc_env_set_fault(
-                envP, XMLRPC_INTERNAL_ERROR,
-                "format string ended before closing ')'.");
-        else {
-            getValue(envP, formatP, argsP, &itemP);
-            if (!envP->fault_occurred) {
-                xmlrpc_array_append_item(envP, arrayP, itemP);
-                xmlrpc_DECREF(itemP);
-            }
+        getValue(envP, opPP, argsP, &itemP);
+        if (!envP->fault_occurred) {
+            xmlrpc_array_append_item(envP, arrayP, itemP);
+            xmlrpc_DECREF(itemP);
         }
     }
     if (envP->fault_occurred)
@@ -125,28 +439,19 @@ getArray(xmlrpc_env *    const envP,
 
 
 static void
-getStructMember(xmlrpc_env *    const envP,
-                const char **   const formatP,
-                va_listx *      const argsP,
-                xmlrpc_value ** const keyPP,
-                xmlrpc_value ** const valuePP) {
+getStructMember(xmlrpc_env *            const envP,
+                const struct buildOp ** const opPP,
+                va_listx *              const argsP,
+                xmlrpc_value **         const keyPP,
+                xmlrpc_value **         const valuePP) {
 
 
     /* Get the key */
-    getValue(envP, formatP, argsP, keyPP);
+    getValue(envP, opPP, argsP, keyPP);
     if (!envP->fault_occurred) {
-        if (**formatP != ':')
-            xmlrpc_env_set_fault(
-                envP, XMLRPC_INTERNAL_ERROR,
-                "format string does not have ':' after a "
-                "structure member key.");
-        else {
-            /* Skip over colon that separates key from value */
-            (*formatP)++;
-            
-            /* Get the value */
-            getValue(envP, formatP, argsP, valuePP);
-        }
+        /* Get the value */
+        getValue(envP, opPP, argsP, valuePP);
+
         if (envP->fault_occurred)
             xmlrpc_DECREF(*keyPP);
     }
@@ -155,36 +460,27 @@ getStructMember(xmlrpc_env *    const envP,
             
 
 static void
-getStruct(xmlrpc_env *    const envP,
-          const char **   const formatP,
-          char            const delimiter,
-          va_listx *      const argsP,
-          xmlrpc_value ** const structPP) {
+getStruct(xmlrpc_env *            const envP,
+          unsigned int            const mbrCt,
+          const struct buildOp ** const opPP,
+          va_listx *              const argsP,
+          xmlrpc_value **         const structPP) {
 
     xmlrpc_value * structP;
 
     structP = xmlrpc_struct_new(envP);
     if (!envP->fault_occurred) {
-        while (**formatP != delimiter && !envP->fault_occurred) {
+        unsigned int i;
+
+        for (i = 0; i < mbrCt && !envP->fault_occurred; ++i) {
             xmlrpc_value * keyP;
             xmlrpc_value * valueP;
             
-            getStructMember(envP, formatP, argsP, &keyP, &valueP);
+            getStructMember(envP, opPP, argsP, &keyP, &valueP);
             
             if (!envP->fault_occurred) {
-                if (**formatP == ',')
-                    (*formatP)++;  /* Skip over the comma */
-                else if (**formatP == delimiter) {
-                    /* End of the line */
-                } else 
-                    xmlrpc_env_set_fault(
-                        envP, XMLRPC_INTERNAL_ERROR,
-                        "format string does not have ',' or ')' after "
-                        "a structure member");
-                
-                if (!envP->fault_occurred)
-                    /* Add the new member to the struct. */
-                    xmlrpc_struct_set_value_v(envP, structP, keyP, valueP);
+                /* Add the new member to the struct. */
+                xmlrpc_struct_set_value_v(envP, structP, keyP, valueP);
                 
                 xmlrpc_DECREF(valueP);
                 xmlrpc_DECREF(keyP);
@@ -231,26 +527,26 @@ mkStructFromVal(xmlrpc_env *    const envP,
 
 
 static void
-getValue(xmlrpc_env *    const envP, 
-         const char**    const formatP,
-         va_listx *      const argsP,
-         xmlrpc_value ** const valPP) {
+getValue(xmlrpc_env *            const envP, 
+         const struct buildOp ** const opPP,
+         va_listx *              const argsP,
+         xmlrpc_value **         const valPP) {
 /*----------------------------------------------------------------------------
-   Get the next value from the list.  *formatP points to the specifier
-   for the next value in the format string (i.e. to the type code
-   character) and we move *formatP past the whole specifier for the
-   next value.  We read the required arguments from 'argsP'.  We return
-   the value as *valPP with a reference to it.
+   Get the next value from the list.  *opPP points to the build plan
+   operation for the next value and we move *opPP past all the operations
+   for it (for an array or struct, there are more for its contents).  We
+   read the required arguments from 'argsP'.  We return the value as *valPP
+   with a reference to it.
 
-   For example, if *formatP points to the "i" in the string "sis",
+   For example, if *opPP is for the "i" in the format string "sis",
    we read one argument from 'argsP' and return as *valP an integer whose
-   value is the argument we read.  We advance *formatP to point to the
-   last 's' and advance 'argsP' to point to the argument that belongs to
-   that 's'.
+   value is the argument we read.  We advance *opPP to the operation for
+   the last 's' and advance 'argsP' to point to the argument that belongs
+   to that 's'.
 -----------------------------------------------------------------------------*/
-    char const formatChar = *(*formatP)++;
+    const struct buildOp * const opP = (*opPP)++;
 
-    switch (formatChar) {
+    switch (opP->formatChar) {
     case 'i':
         *valPP = 
             xmlrpc_int_new(envP, (xmlrpc_int32) va_arg(argsP->v,
@@ -268,11 +564,11 @@ getValue(xmlrpc_env *    const envP,
         break;
 
     case 's':
-        getString(envP, formatP, argsP, valPP);
+        getString(envP, opP->hasLength, argsP, valPP);
         break;
 
     case 'w':
-        getWideString(envP, formatP, argsP, valPP);
+        getWideString(envP, opP->hasLength, argsP, valPP);
         break;
 
     case 't':
@@ -318,27 +614,69 @@ getValue(xmlrpc_env *    const envP,
         break;
 
     case '(':
-        getArray(envP, formatP, ')', argsP, valPP);
-        if (!envP->fault_occurred) {
-            XMLRPC_ASSERT(**formatP == ')');
-            (*formatP)++;  /* Skip over closing parenthesis */
-        }
+        getArray(envP, opP->childCt, opPP, argsP, valPP);
         break;
 
     case '{': 
-        getStruct(envP, formatP, '}', argsP, valPP);
-        if (!envP->fault_occurred) {
-            XMLRPC_ASSERT(**formatP == '}');
-            (*formatP)++;  /* Skip over closing brace */
-        }
+        getStruct(envP, opP->childCt, opPP, argsP, valPP);
         break;
 
-    default: {
-        const char * const badCharacter = xmlrpc_makePrintableChar(formatChar);
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_INTERNAL_ERROR,
-            "Unexpected character '%s' in format string", badCharacter);
-        xmlrpc_strfree(badCharacter);
+    default:
+        /* Every format character that is allowed in a build plan
+           operation is handled above.
+        */
+        XMLRPC_ASSERT(false);
+    }
+}
+
+
+
+static void
+buildValueWithPlan(xmlrpc_env *              const envP,
+                   const xmlrpc_build_plan * const planP,
+                   va_listx                  const args,
+                   xmlrpc_value **           const valPP) {
+
+    va_listx currentArgs;
+    const struct buildOp * opCursor;
+
+    currentArgs = args;
+    opCursor = &planP->op[0];
+
+    getValue(envP, &opCursor, &currentArgs, valPP);
+        
+    if (!envP->fault_occurred)
+        XMLRPC_ASSERT_VALUE_OK(*valPP);
+}
+
+
+
+static void
+getPlan(xmlrpc_env *               const envP,
+        const char *               const format,
+        const xmlrpc_build_plan ** const planPP,
+        bool *                     const mustDestroyP) {
+/*----------------------------------------------------------------------------
+   Get the plan for format string 'format', from the plan cache if we can.
+
+   Return *mustDestroyP true iff the plan isn't in the cache, so Caller
+   must destroy it when done with it.
+-----------------------------------------------------------------------------*/
+    const xmlrpc_build_plan * planP;
+
+    planP = buildPlanCacheP ?
+        xmlrpc_planCacheGet(buildPlanCacheP, format) : NULL;
+
+    if (planP) {
+        *planPP = planP;
+        *mustDestroyP = false;
+    } else {
+        xmlrpc_build_plan_create(envP, format, &planP);
+
+        if (!envP->fault_occurred) {
+            *planPP = planP;
+            *mustDestroyP = buildPlanCacheP ?
+                !xmlrpc_planCacheAdd(buildPlanCacheP, format, planP) : true;
         }
     }
 }
@@ -358,17 +696,23 @@ xmlrpc_build_value_va(xmlrpc_env *    const envP,
     if (strlen(format) == 0)
         xmlrpc_faultf(envP, "Format string is empty.");
     else {
-        va_listx currentArgs;
-        const char * formatCursor;
+        const xmlrpc_build_plan * planP;
+        bool mustDestroyPlan;
 
-        init_va_listx(&currentArgs, args);
-        formatCursor = &format[0];
-        getValue(envP, &formatCursor, &currentArgs, valPP);
-        
-        if (!envP->fault_occurred)
-            XMLRPC_ASSERT_VALUE_OK(*valPP);
-        
-        *tailP = formatCursor;
+        getPlan(envP, format, &planP, &mustDestroyPlan);
+
+        if (!envP->fault_occurred) {
+            va_listx argsx;
+
+            init_va_listx(&argsx, args);
+
+            buildValueWithPlan(envP, planP, argsx, valPP);
+
+            *tailP = xmlrpc_build_plan_tail(planP, format);
+
+            if (mustDestroyPlan)
+                xmlrpc_build_plan_destroy(planP);
+        }
     }
 }
 
@@ -403,6 +747,46 @@ xmlrpc_build_value(xmlrpc_env * const envP,
 }
 
 
+
+void
+xmlrpc_build_value_plan_va(xmlrpc_env *              const envP,
+                           const xmlrpc_build_plan * const planP,
+                           va_list                   const args,
+                           xmlrpc_value **           const valPP) {
+
+    va_listx argsx;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(planP);
+
+    init_va_listx(&argsx, args);
+
+    buildValueWithPlan(envP, planP, argsx, valPP);
+}
+
+
+
+xmlrpc_value *
+xmlrpc_build_value_plan(xmlrpc_env *              const envP,
+                        const xmlrpc_build_plan * const planP,
+                        ...) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_build_value(), but with the format string already
+   compiled into *planP by xmlrpc_build_plan_create().  Unlike
+   xmlrpc_build_value(), we don't care what is in the format string after
+   the specifier of the value.
+-----------------------------------------------------------------------------*/
+    va_list args;
+    xmlrpc_value * retval;
+
+    va_start(args, planP);
+    xmlrpc_build_value_plan_va(envP, planP, args, &retval);
+    va_end(args);
+
+    return retval;
+}
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 ** Copyright (C) 2001 by Eric Kidd. All rights reserved.
 **
@@ -387,7 +387,19 @@ clientCreate(
                           "client descriptor.");
         else {
             clientP->myTransport  = myTransport;
-            clientP->transportOps = *transportOpsP;
+            if (myTransport)
+                clientP->transportOps = *transportOpsP;
+            else {
+                /* The user's ops may be from before 'finish_until'
+                   existed, so they may not have that member or the ones
+                   after it.
+                */
+                memcpy(&clientP->transportOps, transportOpsP,
+                       offsetof(struct xmlrpc_client_transport_ops,
+                                finish_until));
+                clientP->transportOps.finish_until            = NULL;
+                clientP->transportOps.send_request_cancelable = NULL;
+            }
             clientP->transportP   = transportP;
             clientP->dialect      = dialect;
             clientP->progressFn   = progressFn;
@@ -1043,15 +1055,20 @@ progress(struct xmlrpc_call_info *    const callInfoP,
 
 
 
-void
-xmlrpc_client_start_rpc(xmlrpc_env *               const envP,
-                        struct xmlrpc_client *     const clientP,
-                        const xmlrpc_server_info * const serverInfoP,
-                        const char *               const methodName,
-                        xmlrpc_value *             const paramArrayP,
-                        xmlrpc_response_handler          completionFn,
-                        void *                     const userHandle) {
-    
+static void
+startRpc(xmlrpc_env *               const envP,
+         struct xmlrpc_client *     const clientP,
+         const xmlrpc_server_info * const serverInfoP,
+         const char *               const methodName,
+         xmlrpc_value *             const paramArrayP,
+         xmlrpc_response_handler          completionFn,
+         void *                     const userHandle,
+         const int *                const cancelP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_client_start_rpc(), except if 'cancelP' is non-null, the
+   transport abandons the RPC once *cancelP is nonzero -- if it can.  The
+   RPC then completes with a failure.
+-----------------------------------------------------------------------------*/
     struct xmlrpc_call_info * callInfoP;
 
     XMLRPC_ASSERT_ENV_OK(envP);
@@ -1076,11 +1093,18 @@ xmlrpc_client_start_rpc(xmlrpc_env *               const envP,
             XMLRPC_MEMBLOCK_CONTENTS(char, callInfoP->serialized_xml),
             XMLRPC_MEMBLOCK_SIZE(char, callInfoP->serialized_xml));
             
-        clientP->transportOps.send_request(
-            envP, clientP->transportP, serverInfoP,
-            callInfoP->serialized_xml,
-            &asynchComplete, clientP->progressFn ? &progress : NULL,
-            callInfoP);
+        if (cancelP && clientP->transportOps.send_request_cancelable)
+            clientP->transportOps.send_request_cancelable(
+                envP, clientP->transportP, serverInfoP,
+                callInfoP->serialized_xml,
+                &asynchComplete, clientP->progressFn ? &progress : NULL,
+                cancelP, callInfoP);
+        else
+            clientP->transportOps.send_request(
+                envP, clientP->transportP, serverInfoP,
+                callInfoP->serialized_xml,
+                &asynchComplete, clientP->progressFn ? &progress : NULL,
+                callInfoP);
     }    
     if (envP->fault_occurred) {
 
@@ -1097,6 +1121,21 @@ xmlrpc_client_start_rpc(xmlrpc_env *               const envP,
 
 
 
+void
+xmlrpc_client_start_rpc(xmlrpc_env *               const envP,
+                        struct xmlrpc_client *     const clientP,
+                        const xmlrpc_server_info * const serverInfoP,
+                        const char *               const methodName,
+                        xmlrpc_value *             const paramArrayP,
+                        xmlrpc_response_handler          completionFn,
+                        void *                     const userHandle) {
+
+    startRpc(envP, clientP, serverInfoP, methodName, paramArrayP,
+             completionFn, userHandle, NULL);
+}
+
+
+
 void
 xmlrpc_client_start_rpcf_server_va(
     xmlrpc_env *               const envP,
@@ -1195,6 +1234,514 @@ xmlrpc_client_start_rpcf(xmlrpc_env *    const envP,
 
 
 
+struct fanout {
+/*----------------------------------------------------------------------------
+   A set of RPCs of one method, to various servers, that
+   xmlrpc_client_fanout() started.
+-----------------------------------------------------------------------------*/
+    xmlrpc_response_handler * responseHandler;
+    void *                    userHandle;
+    unsigned int requiredCt;
+        /* The number of RPCs that must complete before
+           xmlrpc_client_fanout() returns
+        */
+    unsigned int completedCt;
+    unsigned int outstandingCt;
+        /* Number of RPCs started and not yet completed */
+    int done;
+        /* At least 'requiredCt' RPCs have completed.  An int because the
+           transport's finish_until watches it.
+        */
+    bool callerGone;
+        /* xmlrpc_client_fanout() has returned, so the last RPC to
+           complete destroys this object.
+        */
+};
+
+
+
+static void
+fanoutNoteCompletion(struct fanout * const fanoutP) {
+
+    ++fanoutP->completedCt;
+
+    if (fanoutP->completedCt >= fanoutP->requiredCt)
+        fanoutP->done = 1;
+}
+
+
+
+static xmlrpc_response_handler fanoutResponse;
+
+static void
+fanoutResponse(const char *   const serverUrl,
+               const char *   const methodName,
+               xmlrpc_value * const paramArrayP,
+               void *         const userHandle,
+               xmlrpc_env *   const faultP,
+               xmlrpc_value * const resultP) {
+/*----------------------------------------------------------------------------
+   The completion function for an RPC of a fan-out.
+-----------------------------------------------------------------------------*/
+    struct fanout * const fanoutP = userHandle;
+
+    assert(fanoutP->outstandingCt > 0);
+
+    --fanoutP->outstandingCt;
+
+    fanoutNoteCompletion(fanoutP);
+
+    fanoutP->responseHandler(serverUrl, methodName, paramArrayP,
+                             fanoutP->userHandle, faultP, resultP);
+
+    if (fanoutP->callerGone && fanoutP->outstandingCt == 0)
+        free(fanoutP);
+}
+
+
+
+static void
+finishUntil(xmlrpc_client * const clientP,
+            const int *     const doneP) {
+/*----------------------------------------------------------------------------
+   Run the client's event loop until *doneP is nonzero or there are no RPCs
+   left in progress.
+-----------------------------------------------------------------------------*/
+    if (clientP->transportOps.finish_until)
+        clientP->transportOps.finish_until(
+            clientP->transportP, timeout_no, 0, doneP);
+    else
+        clientP->transportOps.finish_asynch(
+            clientP->transportP, timeout_no, 0);
+}
+
+
+
+void
+xmlrpc_client_fanout(xmlrpc_env *                      const envP,
+                     xmlrpc_client *                   const clientP,
+                     const char *                      const methodName,
+                     const struct xmlrpc_fanout_call * const callArray,
+                     unsigned int                      const callCt,
+                     unsigned int                      const requiredCt,
+                     xmlrpc_response_handler                 responseHandler,
+                     void *                            const userHandle) {
+/*----------------------------------------------------------------------------
+   Start an RPC of method 'methodName' for each of the 'callCt' servers
+   and parameter lists in callArray[], all at once, and wait until
+   'requiredCt' of them have completed.  Zero means all of them.
+
+   We call 'responseHandler', with argument 'userHandle', for each RPC as
+   it completes, as xmlrpc_client_start_rpc() does.  An RPC we fail to
+   start counts as completing, with the failure.
+
+   The RPCs that haven't completed when we return keep going; the client's
+   event loop (e.g. xmlrpc_client_event_loop_finish()) completes them, and
+   calls 'responseHandler' for each, later.
+
+   Nothing but the event loop runs the RPCs, so they are in progress all at
+   once: there are no threads and no delays.  But if the transport can't
+   stop its event loop for just some RPCs, we wait for all of them.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(clientP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+
+    if (requiredCt > callCt)
+        xmlrpc_faultf(envP, "You asked to wait for %u RPCs, but "
+                      "there are only %u", requiredCt, callCt);
+    else if (callCt > 0) {
+        struct fanout * fanoutP;
+
+        MALLOCVAR(fanoutP);
+
+        if (fanoutP == NULL)
+            xmlrpc_faultf(envP, "Could not allocate memory for fan-out "
+                          "of %u RPCs", callCt);
+        else {
+            unsigned int i;
+
+            fanoutP->responseHandler = responseHandler;
+            fanoutP->userHandle      = userHandle;
+            fanoutP->requiredCt      = requiredCt > 0 ? requiredCt : callCt;
+            fanoutP->completedCt     = 0;
+            fanoutP->outstandingCt   = 0;
+            fanoutP->done            = 0;
+            fanoutP->callerGone      = false;
+
+            for (i = 0; i < callCt; ++i) {
+                const struct xmlrpc_fanout_call * const callP =
+                    &callArray[i];
+
+                xmlrpc_env env;
+
+                xmlrpc_env_init(&env);
+
+                ++fanoutP->outstandingCt;
+
+                xmlrpc_client_start_rpc(&env, clientP, callP->serverInfoP,
+                                        methodName, callP->paramArrayP,
+                                        &fanoutResponse, fanoutP);
+                if (env.fault_occurred) {
+                    --fanoutP->outstandingCt;
+
+                    fanoutNoteCompletion(fanoutP);
+
+                    responseHandler(callP->serverInfoP->serverUrl,
+                                    methodName, callP->paramArrayP,
+                                    userHandle, &env, NULL);
+                }
+                xmlrpc_env_clean(&env);
+            }
+            if (!fanoutP->done)
+                finishUntil(clientP, &fanoutP->done);
+
+            if (fanoutP->outstandingCt == 0)
+                free(fanoutP);
+            else
+                fanoutP->callerGone = true;
+        }
+    }
+}
+
+
+
+struct multirpc {
+/*----------------------------------------------------------------------------
+   The same RPC to various servers, which xmlrpc_client_multirpc() is
+   executing.
+-----------------------------------------------------------------------------*/
+    unsigned int requiredCt;
+        /* The number of RPCs that must succeed to satisfy the policy */
+    unsigned int succeededCt;
+    unsigned int outstandingCt;
+        /* Number of RPCs not yet completed */
+    struct xmlrpc_multirpc_reply * replyArray;
+        /* The replies, one per server.  We stop recording them once we
+           have given them to the user.
+        */
+    int decided;
+        /* The policy is satisfied, or can't be anymore.  An int because the
+           transport's finish_until watches it.
+        */
+    int cancel;
+        /* We don't want the RPCs still outstanding anymore.  An int because
+           the transport watches it.
+        */
+    bool callerGone;
+        /* xmlrpc_client_multirpc() has returned, so the last RPC to
+           complete destroys this.
+        */
+    struct multirpcCall * callArray;
+        /* The user handles of the RPCs; NULL if we couldn't allocate it */
+};
+
+struct multirpcCall {
+    /* The user handle of one of the RPCs of a multirpc */
+    struct multirpc * multirpcP;
+    unsigned int      serverIndex;
+};
+
+
+
+static void
+multirpcDestroy(struct multirpc * const multirpcP) {
+
+    if (multirpcP->callArray)
+        free(multirpcP->callArray);
+    free(multirpcP->replyArray);
+    free(multirpcP);
+}
+
+
+
+static unsigned int
+requiredSuccessCt(const struct xmlrpc_multirpc_policy * const policyP,
+                  unsigned int                          const serverCt) {
+
+    unsigned int retval;
+
+    switch (policyP->completion) {
+    case xmlrpc_multirpc_all:      retval = serverCt;         break;
+    case xmlrpc_multirpc_first:    retval = 1;                break;
+    case xmlrpc_multirpc_majority: retval = serverCt / 2 + 1; break;
+    case xmlrpc_multirpc_quorum:   retval = policyP->quorum;  break;
+    default:                       retval = 0;
+    }
+    return retval;
+}
+
+
+
+static void
+multirpcNoteReply(struct multirpc * const multirpcP,
+                  unsigned int      const serverIndex,
+                  xmlrpc_env *      const faultP,
+                  xmlrpc_value *    const resultP) {
+
+    struct xmlrpc_multirpc_reply * const replyP =
+        &multirpcP->replyArray[serverIndex];
+
+    replyP->arrived = true;
+
+    if (faultP->fault_occurred)
+        xmlrpc_env_set_fault(&replyP->fault,
+                             faultP->fault_code, faultP->fault_string);
+    else {
+        xmlrpc_INCREF(resultP);
+        replyP->resultP = resultP;
+        ++multirpcP->succeededCt;
+    }
+    if (multirpcP->succeededCt >= multirpcP->requiredCt ||
+        multirpcP->succeededCt + multirpcP->outstandingCt <
+        multirpcP->requiredCt)
+        multirpcP->decided = 1;
+}
+
+
+
+static xmlrpc_response_handler multirpcResponse;
+
+static void
+multirpcResponse(const char *   const serverUrl ATTR_UNUSED,
+                 const char *   const methodName ATTR_UNUSED,
+                 xmlrpc_value * const paramArrayP ATTR_UNUSED,
+                 void *         const userHandle,
+                 xmlrpc_env *   const faultP,
+                 xmlrpc_value * const resultP) {
+/*----------------------------------------------------------------------------
+   The completion function for an RPC of a multirpc.
+
+   If it is the last RPC of a multirpc that xmlrpc_client_multirpc() has
+   given up on and returned, we destroy the multirpc.
+-----------------------------------------------------------------------------*/
+    struct multirpcCall * const callP = userHandle;
+    struct multirpc * const multirpcP = callP->multirpcP;
+
+    assert(multirpcP->outstandingCt > 0);
+
+    --multirpcP->outstandingCt;
+
+    if (!multirpcP->cancel)
+        multirpcNoteReply(multirpcP, callP->serverIndex, faultP, resultP);
+
+    if (multirpcP->callerGone && multirpcP->outstandingCt == 0)
+        multirpcDestroy(multirpcP);
+}
+
+
+
+static void
+multirpcStart(xmlrpc_client *                    const clientP,
+              struct multirpc *                  const multirpcP,
+              struct multirpcCall *              const callArray,
+              const xmlrpc_server_info * const * const serverInfoArray,
+              unsigned int                       const serverCt,
+              const char *                       const methodName,
+              xmlrpc_value *                     const paramArrayP) {
+
+    unsigned int i;
+
+    for (i = 0; i < serverCt; ++i) {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        callArray[i].multirpcP   = multirpcP;
+        callArray[i].serverIndex = i;
+
+        startRpc(&env, clientP, serverInfoArray[i], methodName, paramArrayP,
+                 &multirpcResponse, &callArray[i], &multirpcP->cancel);
+
+        if (env.fault_occurred) {
+            --multirpcP->outstandingCt;
+            multirpcNoteReply(multirpcP, i, &env, NULL);
+        }
+        xmlrpc_env_clean(&env);
+    }
+}
+
+
+
+static void
+multirpcWait(xmlrpc_client * const clientP,
+             unsigned int    const timeout,
+             const int *     const doneP) {
+/*----------------------------------------------------------------------------
+   Run the client's event loop until *doneP is nonzero, there are no RPCs
+   left in progress, or 'timeout' milliseconds pass.  Zero means no limit.
+-----------------------------------------------------------------------------*/
+    xmlrpc_timeoutType const timeoutType =
+        timeout > 0 ? timeout_yes : timeout_no;
+
+    if (clientP->transportOps.finish_until)
+        clientP->transportOps.finish_until(
+            clientP->transportP, timeoutType, timeout, doneP);
+    else
+        clientP->transportOps.finish_asynch(
+            clientP->transportP, timeoutType, timeout);
+}
+
+
+
+static void
+multirpcExecute(xmlrpc_client *                       const clientP,
+                struct multirpc *                     const multirpcP,
+                const xmlrpc_server_info * const *    const serverInfoArray,
+                unsigned int                          const serverCt,
+                const char *                          const methodName,
+                xmlrpc_value *                        const paramArrayP,
+                const struct xmlrpc_multirpc_policy * const policyP,
+                xmlrpc_multirpc_handler                     handler,
+                void *                                const userHandle) {
+/*----------------------------------------------------------------------------
+   Do the multirpc *multirpcP as described for xmlrpc_client_multirpc().
+
+   We destroy *multirpcP, or leave it to the completion of its last RPC
+   to do that.
+-----------------------------------------------------------------------------*/
+    struct multirpcCall * callArray;
+    unsigned int i;
+
+    MALLOCARRAY(callArray, serverCt);
+
+    multirpcP->callArray = callArray;
+
+    for (i = 0; i < serverCt; ++i) {
+        struct xmlrpc_multirpc_reply * const replyP =
+            &multirpcP->replyArray[i];
+
+        replyP->serverUrl = serverInfoArray[i]->serverUrl;
+        replyP->arrived   = false;
+        replyP->resultP   = NULL;
+        xmlrpc_env_init(&replyP->fault);
+    }
+
+    if (callArray == NULL) {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+        xmlrpc_faultf(&env, "Could not allocate memory for %u RPCs",
+                      serverCt);
+        for (i = 0; i < serverCt; ++i) {
+            --multirpcP->outstandingCt;
+            multirpcNoteReply(multirpcP, i, &env, NULL);
+        }
+        xmlrpc_env_clean(&env);
+    } else
+        multirpcStart(clientP, multirpcP, callArray, serverInfoArray,
+                      serverCt, methodName, paramArrayP);
+
+    if (multirpcP->outstandingCt > 0 && !multirpcP->decided)
+        multirpcWait(clientP, policyP->timeout, &multirpcP->decided);
+
+    /* Whatever hasn't arrived by now is too late.  Cancelling makes the
+       rest complete (with failure) quickly, if the transport can cancel.
+    */
+    multirpcP->cancel = 1;
+
+    handler(methodName, paramArrayP, userHandle,
+            multirpcP->replyArray, serverCt,
+            multirpcP->succeededCt >= multirpcP->requiredCt);
+
+    for (i = 0; i < serverCt; ++i) {
+        struct xmlrpc_multirpc_reply * const replyP =
+            &multirpcP->replyArray[i];
+
+        if (replyP->resultP)
+            xmlrpc_DECREF(replyP->resultP);
+        xmlrpc_env_clean(&replyP->fault);
+    }
+    if (multirpcP->outstandingCt == 0)
+        multirpcDestroy(multirpcP);
+    else
+        multirpcP->callerGone = true;
+}
+
+
+
+void
+xmlrpc_client_multirpc(
+    xmlrpc_env *                          const envP,
+    xmlrpc_client *                       const clientP,
+    const xmlrpc_server_info * const *    const serverInfoArray,
+    unsigned int                          const serverCt,
+    const char *                          const methodName,
+    xmlrpc_value *                        const paramArrayP,
+    const struct xmlrpc_multirpc_policy * const policyP,
+    xmlrpc_multirpc_handler                     handler,
+    void *                                const userHandle) {
+/*----------------------------------------------------------------------------
+   Perform the same RPC on each of the 'serverCt' servers serverInfoArray[],
+   all at once, until *policyP is satisfied or can't be anymore, or its
+   timeout passes.  Then cancel the RPCs still in progress.
+
+   Call 'handler' once, before we return, with all the replies that
+   arrived by then, in server order, and whether the policy is satisfied.
+   The replies are ours; 'handler' must keep its own reference to any
+   result it wants after it returns.
+
+   Only successful RPCs count toward the policy.
+
+   We don't wait for the cancelled RPCs.  Like the RPCs
+   xmlrpc_client_fanout() leaves, they complete in the client's event loop
+   (e.g. xmlrpc_client_event_loop_finish()), which you must run before
+   destroying the client.  Cancelling makes them complete right away, if
+   the transport can abandon individual RPCs; otherwise, they run to the
+   end and we ignore their results.
+
+   Waiting for the policy takes a transport that can stop its event loop
+   for just some RPCs.  With another transport, we wait for all the RPCs,
+   and the client's other RPCs as well.
+-----------------------------------------------------------------------------*/
+    unsigned int requiredCt;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(clientP);
+    XMLRPC_ASSERT_PTR_OK(methodName);
+    XMLRPC_ASSERT_VALUE_OK(paramArrayP);
+    XMLRPC_ASSERT_PTR_OK(policyP);
+
+    requiredCt = requiredSuccessCt(policyP, serverCt);
+
+    if (serverCt == 0)
+        xmlrpc_faultf(envP, "There are no servers to call");
+    else if (requiredCt == 0 || requiredCt > serverCt)
+        xmlrpc_faultf(envP, "Completion policy requires %u successful "
+                      "RPCs, but there are %u servers", requiredCt, serverCt);
+    else {
+        struct multirpc * multirpcP;
+
+        MALLOCVAR(multirpcP);
+
+        if (multirpcP == NULL)
+            xmlrpc_faultf(envP, "Could not allocate memory for multirpc");
+        else {
+            MALLOCARRAY(multirpcP->replyArray, serverCt);
+
+            if (multirpcP->replyArray == NULL) {
+                xmlrpc_faultf(envP, "Could not allocate memory for %u "
+                              "replies", serverCt);
+                free(multirpcP);
+            } else {
+                multirpcP->requiredCt    = requiredCt;
+                multirpcP->succeededCt   = 0;
+                multirpcP->outstandingCt = serverCt;
+                    /* Until we start them */
+                multirpcP->decided       = 0;
+                multirpcP->cancel        = 0;
+                multirpcP->callerGone    = false;
+
+                multirpcExecute(clientP, multirpcP, serverInfoArray, serverCt,
+                                methodName, paramArrayP, policyP,
+                                handler, userHandle);
+            }
+        }
+    }
+}
+
+
+
 /*=========================================================================
    Miscellaneous
 =========================================================================*/
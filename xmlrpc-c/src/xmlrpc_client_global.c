@@ -1,5 +1,4 @@
 #include <stdarg.h>
-#include <pthread.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,6 +9,7 @@
 #include "xmlrpc_config.h"
 
 #include "bool.h"
+#include "mallocvar.h"
 
 #include <xmlrpc-c/base.h>
 #include <xmlrpc-c/client.h>
@@ -284,125 +284,69 @@ xmlrpc_client_call_server_asynch_params(
 
 
 
-/*===================================================================================================
-
-Starting from here, below is project 3
-
-=================================================================================================== */
-
-/*=========================================================================                                                                   
-  asynch_multiRPC_thread_routine()
-  each thread created in multirpc_globalclient_asynch() will run this function
-  and in this routine, each thread will call xmlrpc_client_start_rpcf()
-  =========================================================================*/
-static void * 
-asynch_multirpc_thread_routine(void * param){
-
-  asynch_thread_param_t * paramPtr = (asynch_thread_param_t *) param;
-
-  //getting the detail URL
-  char * serverUrl = paramPtr->multiServerInfo->serverUrlArray[paramPtr->requestID];
-
-  char * val1 = "Hello";
-  xmlrpc_int32 val2 = paramPtr->requestID+1;
-
-#ifdef DEBUG
-  printf("running thread %d now......\n", paramPtr->requestID+1);
-  printf("try to say %s to server %d \n", val1, val2);
-#endif
-
-  xmlrpc_client_start_rpcf(paramPtr->envP, 
-			   paramPtr->clientP, 
-			   serverUrl, 
-			   paramPtr->methodName, 
-			   *(paramPtr->responseHandler), 
-			   NULL, 
-			   "(si)", val1, val2);
-  //  die_if_fault_occurred(paramPtr->envP);
-
-  //pthread_exit(NULL);
-
-  return NULL;
-}
-
+/*=========================================================================
+   Fan-out to multiple servers
+=========================================================================*/
 
-/*============================================================================
- * MULTIRPC_GLOBALCLIENT_ASYNCH()
- * userData is NULL, requestsRequired is the number of servers, that is also
- * the number of threads need to create
- * in order to let each thread call xmlrpc_client_start_rpcf()
- * we need to set up the asynch_thread_param_t struct for each thread
- * all threads share the same client, which is the globalClientP
- ============================================================================== */
+void
+multirpc_globalclient_asynch(xmlrpc_env *                const envP,
+                             const multi_server_info_t * const multiServerInfoP,
+                             const char *                const methodName,
+                             xmlrpc_value *              const paramArrayP[],
+                             xmlrpc_response_handler           responseHandler,
+                             void *                      const userData,
+                             unsigned int                const requestsRequired) {
+/*----------------------------------------------------------------------------
+   Call method 'methodName' on every server in *multiServerInfoP at once,
+   with parameters paramArrayP[i] for server i, and wait until
+   'requestsRequired' of the RPCs have completed (zero means all of them).
+
+   We call 'responseHandler' for each RPC as it completes.  The ones that
+   haven't when we return complete in xmlrpc_client_event_loop_finish_asynch()
+   or the like.
+
+   This is xmlrpc_client_fanout() for the global client.
+-----------------------------------------------------------------------------*/
+  XMLRPC_ASSERT_ENV_OK(envP);
+  XMLRPC_ASSERT_PTR_OK(multiServerInfoP);
 
-void 
-multirpc_globalclient_asynch(multi_server_info_t *        multiServerInfo, 
-			     const char *           const methodName, 
-			     xmlrpc_response_handler responseHandler,
-			     int                          requestsRequired) {
- 
-  xmlrpc_env env;
-  xmlrpc_env_init(&env);
+  validateGlobalClientExists(envP);
 
-  // first validate the global clientP
-  validateGlobalClientExists(&env);
-  if(!env.fault_occurred){
-    // everything is all right, then next step
-    // then create thread_param_array, which stores the thread param info
-    asynch_thread_param_t * threadArray = malloc(sizeof(asynch_thread_param_t) * 
-						 requestsRequired);
-      
-    int counter;
-
-    for (counter = 0; counter < requestsRequired; ++counter){
-      // to create multiple threads
-      threadArray[counter].envP = &env;
-      threadArray[counter].clientP = globalClientP;
-      threadArray[counter].methodName = methodName;
-      threadArray[counter].responseHandler = responseHandler;
-      // using it to get detail server url info from multiServerInfo array
-      threadArray[counter].requestID = counter; // it is also the server ID
-      threadArray[counter].multiServerInfo = multiServerInfo;
-
-#ifdef DEBUG
-      printf("creating thread %d now.....\n", counter+1);
-#endif
-
-      pthread_create(&threadArray[counter].tid, NULL, asynch_multirpc_thread_routine, 
-		     &threadArray[counter]);
-      
-    }
+  if (!envP->fault_occurred) {
+    unsigned int const serverCt = multiServerInfoP->numberOfServer;
 
-#ifdef DEBUG
-    printf("finishing creating %d threads, now waiting.......\n", requestsRequired);
-#endif
+    struct xmlrpc_fanout_call * callArray;
 
-    sleep(2);
-       
-    int err;
-    // wait for threads over, join, without this, error shows up
-    for (counter = 0; counter < requestsRequired; ++counter){
+    MALLOCARRAY(callArray, serverCt);
 
-#ifdef DEBUG
-      printf("thread %ld is running pthread_join()\n", threadArray[counter].tid);
-#endif
+    if (callArray == NULL)
+      xmlrpc_faultf(envP, "Could not allocate memory for %u RPCs", serverCt);
+    else {
+      unsigned int createdCt;
 
-      err = pthread_join(threadArray[counter].tid, NULL);
-      if (!err){
-	printf("thread %ld terminates successfully\n", threadArray[counter].tid);
+      for (createdCt = 0;
+           createdCt < serverCt && !envP->fault_occurred;
+           ++createdCt) {
+        callArray[createdCt].serverInfoP =
+          xmlrpc_server_info_new(envP,
+                                 multiServerInfoP->serverUrlArray[createdCt]);
+        callArray[createdCt].paramArrayP = paramArrayP[createdCt];
+      }
+      if (envP->fault_occurred)
+        --createdCt;  /* The last one failed */
+      else
+        xmlrpc_client_fanout(envP, globalClientP, methodName,
+                             callArray, serverCt, requestsRequired,
+                             responseHandler, userData);
+
+      while (createdCt > 0) {
+        --createdCt;
+        xmlrpc_server_info_free(
+          (xmlrpc_server_info *)callArray[createdCt].serverInfoP);
       }
+      free(callArray);
     }
-
-    // make sure all the asynch rpc calls finish, which means all asynch rpc calls 
-    // should call response_handler
-    xmlrpc_client_event_loop_finish_asynch();
-  }
-  else{
-
-    printf("Something Wrong In Global Client\n");
   }
-
-  xmlrpc_env_clean(&env);
 }
 
 
@@ -501,3 +445,62 @@ xmlrpc_client_call_server_asynch(xmlrpc_server_info * const serverInfoP,
   xmlrpc_env_clean(&env);
 }
 
+
+
+void
+multirpc_globalclient(xmlrpc_env *                          const envP,
+                      const multi_server_info_t *           const multiServerInfoP,
+                      const char *                          const methodName,
+                      xmlrpc_value *                        const paramArrayP,
+                      const struct xmlrpc_multirpc_policy * const policyP,
+                      xmlrpc_multirpc_handler                     handler,
+                      void *                                const userData) {
+/*----------------------------------------------------------------------------
+   Call method 'methodName' with parameters *paramArrayP on every server in
+   *multiServerInfoP at once, until *policyP is satisfied (e.g. the first
+   server answers), then give up on the rest.  We call 'handler' once,
+   with all the replies.
+
+   This is xmlrpc_client_multirpc() for the global client.
+-----------------------------------------------------------------------------*/
+  XMLRPC_ASSERT_ENV_OK(envP);
+  XMLRPC_ASSERT_PTR_OK(multiServerInfoP);
+
+  validateGlobalClientExists(envP);
+
+  if (!envP->fault_occurred) {
+    unsigned int const serverCt = multiServerInfoP->numberOfServer;
+
+    const xmlrpc_server_info ** serverInfoArray;
+
+    MALLOCARRAY(serverInfoArray, serverCt);
+
+    if (serverInfoArray == NULL)
+      xmlrpc_faultf(envP, "Could not allocate memory for %u servers",
+                    serverCt);
+    else {
+      unsigned int createdCt;
+
+      for (createdCt = 0;
+           createdCt < serverCt && !envP->fault_occurred;
+           ++createdCt)
+        serverInfoArray[createdCt] =
+          xmlrpc_server_info_new(envP,
+                                 multiServerInfoP->serverUrlArray[createdCt]);
+
+      if (envP->fault_occurred)
+        --createdCt;  /* The last one failed */
+      else
+        xmlrpc_client_multirpc(envP, globalClientP, serverInfoArray, serverCt,
+                               methodName, paramArrayP, policyP,
+                               handler, userData);
+
+      while (createdCt > 0) {
+        --createdCt;
+        xmlrpc_server_info_free(
+          (xmlrpc_server_info *)serverInfoArray[createdCt]);
+      }
+      free(serverInfoArray);
+    }
+  }
+}
@@ -19,6 +19,8 @@
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
 
+#include "plan_cache.h"
+
 
 /* THE DECOMPOSITION TREE
 
@@ -31,10 +33,15 @@
       in which Caller wants it stored.
 
    The decomposition tree is composed of information from the format
-   string and the variable arguments that the format string describes.
-   Nothing in the tree is derived from the actual XML-RPC value being
-   decomposed, and the tree may in fact be invalid for the particular
-   XML-RPC value it's meant for.
+   string alone.  Nothing in the tree is derived from the actual XML-RPC
+   value being decomposed, and the tree may in fact be invalid for the
+   particular XML-RPC value it's meant for.  Nor does the tree contain the
+   variable arguments that the format string describes (where to store
+   things and the keys of struct members).  Those are in a separate
+   argument vector, and a tree node refers to its arguments by their
+   position in that vector.  That way, one tree (a "decomposition plan")
+   serves every call with the same format string; see
+   xmlrpc_decomp_plan_create().
 
    If the XML-RPC value is a simple value such as an integer, the
    decomposition tree is trivial -- it's a single node that says
@@ -52,65 +59,6 @@
    type.
 */
 
-struct integerDecomp {
-    xmlrpc_int32 * valueP;
-};
-
-struct boolDecomp {
-    xmlrpc_bool * valueP;
-};
-
-struct doubleDecomp {
-    double * valueP;
-};
-
-struct datetimeTDecomp {
-    time_t * valueP;
-};
-
-struct datetime8Decomp {
-    const char ** valueP;
-};
-
-struct stringDecomp {
-    const char ** valueP;
-    size_t * sizeP;
-        /* NULL means don't store a size */
-};
-
-struct wideStringDecomp {
-#if HAVE_UNICODE_WCHAR
-    const wchar_t ** valueP;
-#endif
-    size_t * sizeP;
-        /* NULL means don't store a size */
-};
-
-struct bitStringDecomp {
-    const unsigned char ** valueP;
-    size_t * sizeP;
-};
-
-struct cptrDecomp {
-    void ** valueP;
-};
-
-struct i8Decomp {
-    xmlrpc_int64 * valueP;
-};
-
-struct valueDecomp {
-    xmlrpc_value ** valueP;
-};
-
-struct arrayValDecomp {
-    xmlrpc_value ** valueP;
-};
-
-struct structValDecomp {
-    xmlrpc_value ** valueP;
-};
-
 struct arrayDecomp {
     unsigned int itemCnt;
     bool ignoreExcess;
@@ -123,8 +71,10 @@ struct arrayDecomp {
 };
 
 struct mbrDecomp {
-    const char * key;
-        /* The key for the member whose value client wants to extract */
+    unsigned int keyArgIndex;
+        /* Index in the argument vector of the key for the member whose
+           value client wants to extract
+        */
     struct decompTreeNode * decompTreeP;
         /* Instructions on how to decompose (extract) member's value */
 };
@@ -138,23 +88,18 @@ struct structDecomp {
 struct decompTreeNode {
     char formatSpecChar;
         /* e.g. 'i', 'b', '8', 'A'.  '(' means array; '{' means struct */
+    bool hasSize;
+        /* The specifier is 's#' or 'w#' -- Caller wants the size too */
+    unsigned int argIndex;
+        /* Index in the argument vector of the pointer to where the
+           decomposed value goes.  For 's#', 'w#', and '6', the pointer to
+           where its size goes is the next one.  Meaningless for '-', 'n',
+           '(', and '{', which have no arguments of their own.
+        */
     union {
     /*------------------------------------------------------------------------
       'formatSpecChar' selects among these members.
     -------------------------------------------------------------------------*/
-        struct integerDecomp    Tinteger;
-        struct boolDecomp       Tbool;
-        struct doubleDecomp     Tdouble;
-        struct datetimeTDecomp  TdatetimeT;
-        struct datetime8Decomp  Tdatetime8;
-        struct stringDecomp     Tstring;
-        struct wideStringDecomp TwideString;
-        struct bitStringDecomp  TbitString;
-        struct cptrDecomp       Tcptr;
-        struct i8Decomp         Ti8;
-        struct valueDecomp      Tvalue;
-        struct arrayValDecomp   TarrayVal;
-        struct structValDecomp  TstructVal;
         struct arrayDecomp      Tarray;
         struct structDecomp     Tstruct;
     } store;
@@ -163,38 +108,68 @@ struct decompTreeNode {
 
 
 
+struct xmlrpc_decomp_plan {
+/*----------------------------------------------------------------------------
+   A compiled format string.  Immutable once created, so any number of
+   threads may use it at once.
+-----------------------------------------------------------------------------*/
+    struct decompTreeNode * rootP;
+    unsigned int argCt;
+        /* Number of variable arguments the format string describes */
+    char * argType;
+        /* argType[i] is the type of variable argument i, for va_arg():
+           the specifier character of the value it is for, '#' for a
+           pointer to a size, or 'k' for a struct member key.
+        */
+};
+
+
+
+static struct planCache * decompPlanCacheP;
+    /* Cache of plans for the format strings of xmlrpc_decompose_value()
+       and friends.  NULL if the program did not call xmlrpc_init(), in
+       which case we compile the format string on every call.
+    */
+
+
+
 /* prototype for recursive calls */
 static void
-releaseDecomposition(const struct decompTreeNode * const decompRootP);
+releaseDecomposition(const struct decompTreeNode * const decompRootP,
+                     void *                const * const argv);
 
 
 static void
-releaseDecompArray(struct arrayDecomp const arrayDecomp) {
+releaseDecompArray(struct arrayDecomp const arrayDecomp,
+                   void *     const * const argv) {
 
     unsigned int i;
     for (i = 0; i < arrayDecomp.itemCnt; ++i) {
-        releaseDecomposition(arrayDecomp.itemArray[i]);
+        releaseDecomposition(arrayDecomp.itemArray[i], argv);
     }
 }
 
 
 
 static void
-releaseDecompStruct(struct structDecomp const structDecomp) {
+releaseDecompStruct(struct structDecomp const structDecomp,
+                    void *      const * const argv) {
 
     unsigned int i;
     for (i = 0; i < structDecomp.mbrCnt; ++i) {
-        releaseDecomposition(structDecomp.mbrArray[i].decompTreeP);
+        releaseDecomposition(structDecomp.mbrArray[i].decompTreeP, argv);
     }
 }
 
 
 
 static void
-releaseDecomposition(const struct decompTreeNode * const decompRootP) {
+releaseDecomposition(const struct decompTreeNode * const decompRootP,
+                     void *                const * const argv) {
 /*----------------------------------------------------------------------------
-   Assuming that Caller has decomposed something according to 'decompRootP',
-   release whatever resources the decomposed information occupies.
+   Assuming that Caller has decomposed something according to 'decompRootP'
+   and argument vector 'argv', release whatever resources the decomposed
+   information occupies.
 
    E.g. if it's  an XML-RPC string, Caller would have allocated memory
    for the C string that represents the decomposed value of XML-RPC string,
@@ -211,31 +186,27 @@ releaseDecomposition(const struct decompTreeNode * const decompRootP) {
         /* Nothing was allocated; nothing to release */
         break;
     case '8':
-        xmlrpc_strfree(*decompRootP->store.Tdatetime8.valueP);
-        break;
     case 's':
-        xmlrpc_strfree(*decompRootP->store.Tstring.valueP);
+        xmlrpc_strfree(*(const char **)argv[decompRootP->argIndex]);
         break;
     case 'w':
-        free((void*)*decompRootP->store.TwideString.valueP);
+#if HAVE_UNICODE_WCHAR
+        free((void*)*(const wchar_t **)argv[decompRootP->argIndex]);
+#endif
         break;
     case '6':
-        free((void*)*decompRootP->store.TbitString.valueP);
+        free((void*)*(const unsigned char **)argv[decompRootP->argIndex]);
         break;
     case 'V':
-        xmlrpc_DECREF(*decompRootP->store.Tvalue.valueP);
-        break;
     case 'A':
-        xmlrpc_DECREF(*decompRootP->store.TarrayVal.valueP);
-        break;
     case 'S':
-        xmlrpc_DECREF(*decompRootP->store.TstructVal.valueP);
+        xmlrpc_DECREF(*(xmlrpc_value **)argv[decompRootP->argIndex]);
         break;
     case '(':
-        releaseDecompArray(decompRootP->store.Tarray);
+        releaseDecompArray(decompRootP->store.Tarray, argv);
         break;
     case '{':
-        releaseDecompStruct(decompRootP->store.Tstruct);
+        releaseDecompStruct(decompRootP->store.Tstruct, argv);
         break;
     }
 }
@@ -248,7 +219,8 @@ static void
 decomposeValueWithTree(xmlrpc_env *                  const envP,
                        xmlrpc_value *                const valueP,
                        bool                          const oldstyleMemMgmt,
-                       const struct decompTreeNode * const decompRootP);
+                       const struct decompTreeNode * const decompRootP,
+                       void *                const * const argv);
 
 
 
@@ -281,6 +253,7 @@ static void
 parsearray(xmlrpc_env *         const envP,
            const xmlrpc_value * const arrayP,
            struct arrayDecomp   const arrayDecomp,
+           void *       const * const argv,
            bool                 const oldstyleMemMgmt) {
 
     validateArraySize(envP, arrayP, arrayDecomp);
@@ -297,7 +270,7 @@ parsearray(xmlrpc_env *         const envP,
             if (!envP->fault_occurred) {
                 XMLRPC_ASSERT(doneCnt < ARRAY_SIZE(arrayDecomp.itemArray));
                 decomposeValueWithTree(envP, itemP, oldstyleMemMgmt,
-                                       arrayDecomp.itemArray[doneCnt]);
+                                       arrayDecomp.itemArray[doneCnt], argv);
                 
                 if (!envP->fault_occurred)
                     ++doneCnt;
@@ -310,7 +283,7 @@ parsearray(xmlrpc_env *         const envP,
                 /* Release the items we completed before we failed. */
                 unsigned int i;
                 for (i = 0; i < doneCnt; ++i)
-                    releaseDecomposition(arrayDecomp.itemArray[i]);
+                    releaseDecomposition(arrayDecomp.itemArray[i], argv);
             }
         }
     }
@@ -322,6 +295,7 @@ static void
 parsestruct(xmlrpc_env *        const envP,
             xmlrpc_value *      const structP,
             struct structDecomp const structDecomp,
+            void *      const * const argv,
             bool                const oldstyleMemMgmt) {
 
     unsigned int doneCount;
@@ -329,7 +303,8 @@ parsestruct(xmlrpc_env *        const envP,
     doneCount = 0;  /* No members done yet */
 
     while (doneCount < structDecomp.mbrCnt && !envP->fault_occurred) {
-        const char * const key = structDecomp.mbrArray[doneCount].key;
+        const char * const key =
+            argv[structDecomp.mbrArray[doneCount].keyArgIndex];
 
         xmlrpc_value * valueP;
 
@@ -338,7 +313,7 @@ parsestruct(xmlrpc_env *        const envP,
         if (!envP->fault_occurred) {
             decomposeValueWithTree(
                 envP, valueP, oldstyleMemMgmt,
-                structDecomp.mbrArray[doneCount].decompTreeP);
+                structDecomp.mbrArray[doneCount].decompTreeP, argv);
 
             if (!envP->fault_occurred)
                 ++doneCount;
@@ -352,7 +327,8 @@ parsestruct(xmlrpc_env *        const envP,
             /* Release the items we completed before we failed. */
             unsigned int i;
             for (i = 0; i < doneCount; ++i)
-                releaseDecomposition(structDecomp.mbrArray[i].decompTreeP);
+                releaseDecomposition(structDecomp.mbrArray[i].decompTreeP,
+                                     argv);
         }
     }
 }
@@ -450,61 +426,59 @@ static void
 decomposeValueWithTree(xmlrpc_env *                  const envP,
                        xmlrpc_value *                const valueP,
                        bool                          const oldstyleMemMgmt,
-                       const struct decompTreeNode * const decompRootP) {
+                       const struct decompTreeNode * const decompRootP,
+                       void *                const * const argv) {
 /*----------------------------------------------------------------------------
    Decompose XML-RPC value *valueP, given the decomposition tree
    *decompRootP.  The decomposition tree tells what structure *valueP
-   is expected to have and where to put the various components of it
-   (e.g. it says "it's an array of 3 integers.  Put their values at
-   locations x, y, and z")
+   is expected to have and where in the argument vector 'argv' to find
+   where to put the various components of it (e.g. it says "it's an array
+   of 3 integers.  Put their values at the locations given by arguments
+   0, 1, and 2")
 -----------------------------------------------------------------------------*/
+    unsigned int const argIx = decompRootP->argIndex;
+
     switch (decompRootP->formatSpecChar) {
     case '-':
         /* There's nothing to validate or return */
         break;
     case 'i':
-        xmlrpc_read_int(envP, valueP, decompRootP->store.Tinteger.valueP);
+        xmlrpc_read_int(envP, valueP, argv[argIx]);
         break;
 
     case 'b':
-        xmlrpc_read_bool(envP, valueP, decompRootP->store.Tbool.valueP);
+        xmlrpc_read_bool(envP, valueP, argv[argIx]);
         break;
 
     case 'd':
-        xmlrpc_read_double(envP, valueP, decompRootP->store.Tdouble.valueP);
+        xmlrpc_read_double(envP, valueP, argv[argIx]);
         break;
 
     case 't':
-        xmlrpc_read_datetime_sec(envP, valueP,
-                                 decompRootP->store.TdatetimeT.valueP);
+        xmlrpc_read_datetime_sec(envP, valueP, argv[argIx]);
         break;
 
     case '8':
-        readDatetime8Str(envP, valueP, decompRootP->store.Tdatetime8.valueP,
-                         oldstyleMemMgmt);
+        readDatetime8Str(envP, valueP, argv[argIx], oldstyleMemMgmt);
         break;
 
     case 's':
-        if (decompRootP->store.Tstring.sizeP)
+        if (decompRootP->hasSize)
             readStringLp(envP, valueP,
-                         decompRootP->store.Tstring.sizeP,
-                         decompRootP->store.Tstring.valueP,
+                         argv[argIx + 1], argv[argIx],
                          oldstyleMemMgmt);
         else
-            readString(envP, valueP, decompRootP->store.Tstring.valueP,
-                       oldstyleMemMgmt);
+            readString(envP, valueP, argv[argIx], oldstyleMemMgmt);
         break;
 
     case 'w':
 #if HAVE_UNICODE_WCHAR
-        if (decompRootP->store.Tstring.sizeP)
+        if (decompRootP->hasSize)
             readStringWLp(envP, valueP,
-                          decompRootP->store.TwideString.sizeP,
-                          decompRootP->store.TwideString.valueP,
+                          argv[argIx + 1], argv[argIx],
                           oldstyleMemMgmt);
         else
-            readStringW(envP, valueP, decompRootP->store.TwideString.valueP,
-                        oldstyleMemMgmt);
+            readStringW(envP, valueP, argv[argIx], oldstyleMemMgmt);
 #else
         XMLRPC_ASSERT(false);
 #endif /* HAVE_UNICODE_WCHAR */
@@ -512,8 +486,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
         
     case '6':
         readBase64(envP, valueP,
-                   decompRootP->store.TbitString.sizeP,
-                   decompRootP->store.TbitString.valueP,
+                   argv[argIx + 1], argv[argIx],
                    oldstyleMemMgmt);
         break;
 
@@ -522,15 +495,15 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
         break;
 
     case 'I':
-        xmlrpc_read_i8(envP, valueP, decompRootP->store.Ti8.valueP);
+        xmlrpc_read_i8(envP, valueP, argv[argIx]);
         break;
 
     case 'p':
-        xmlrpc_read_cptr(envP, valueP, decompRootP->store.Tcptr.valueP);
+        xmlrpc_read_cptr(envP, valueP, argv[argIx]);
         break;
 
     case 'V':
-        *decompRootP->store.Tvalue.valueP = valueP;
+        *(xmlrpc_value **)argv[argIx] = valueP;
         if (!oldstyleMemMgmt)
             xmlrpc_INCREF(valueP);
         break;
@@ -542,7 +515,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 "%s, but the 'A' specifier requires type ARRAY",
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else {
-            *decompRootP->store.TarrayVal.valueP = valueP;
+            *(xmlrpc_value **)argv[argIx] = valueP;
             if (!oldstyleMemMgmt)
                 xmlrpc_INCREF(valueP);
         }
@@ -555,7 +528,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 "%s, but the 'S' specifier requires type STRUCT.",
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else {
-            *decompRootP->store.TstructVal.valueP = valueP;
+            *(xmlrpc_value **)argv[argIx] = valueP;
             if (!oldstyleMemMgmt)
                 xmlrpc_INCREF(valueP);
         }
@@ -568,7 +541,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 "%s, but the '(...)' specifier requires type ARRAY",
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else
-            parsearray(envP, valueP, decompRootP->store.Tarray,
+            parsearray(envP, valueP, decompRootP->store.Tarray, argv,
                        oldstyleMemMgmt);
         break;
 
@@ -579,7 +552,7 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
                 "%s, but the '{...}' specifier requires type STRUCT",
                 xmlrpc_type_name(xmlrpc_value_type(valueP)));
         else
-            parsestruct(envP, valueP, decompRootP->store.Tstruct,
+            parsestruct(envP, valueP, decompRootP->store.Tstruct, argv,
                         oldstyleMemMgmt);
         break;
 
@@ -592,31 +565,72 @@ decomposeValueWithTree(xmlrpc_env *                  const envP,
 }
 
 
+
+struct planBuilder {
+/*----------------------------------------------------------------------------
+   The state of the compilation of a format string into a decomposition
+   tree.
+-----------------------------------------------------------------------------*/
+    char * argType;
+        /* The types of the variable arguments we have found so far; see
+           'argType' in struct xmlrpc_decomp_plan.
+        */
+    unsigned int argCt;
+        /* Number of variable arguments we have found so far */
+};
+
+
+
+static unsigned int
+addArg(struct planBuilder * const builderP,
+       char                 const type) {
+/*----------------------------------------------------------------------------
+   Note that the format string describes another variable argument, of
+   type 'type'.  Return its index in the argument vector.
+-----------------------------------------------------------------------------*/
+    builderP->argType[builderP->argCt] = type;
+
+    return builderP->argCt++;
+}
+
+
+
 /* Forward declaration for recursive calls */
 
 static void 
 createDecompTreeNext(xmlrpc_env *             const envP,
                      const char **            const formatP,
-                     va_listx *               const argsP,
+                     struct planBuilder *     const builderP,
                      struct decompTreeNode ** const decompNodePP);
 
 
 
+static void
+buildSizedNode(const char **           const formatP,
+               struct planBuilder *    const builderP,
+               struct decompTreeNode * const decompNodeP) {
+/*----------------------------------------------------------------------------
+   Fill in the node for an 's' or 'w' specifier, which may have a '#'
+   after it to say Caller wants the size too.
+-----------------------------------------------------------------------------*/
+    decompNodeP->argIndex = addArg(builderP, decompNodeP->formatSpecChar);
+    if (**formatP == '#') {
+        decompNodeP->hasSize = true;
+        addArg(builderP, '#');
+        ++*formatP;
+    }
+}
+
+
+
 static void
 buildWideStringNode(xmlrpc_env *            const envP ATTR_UNUSED,
                     const char **           const formatP,
-                    va_listx *              const argsP,
+                    struct planBuilder *    const builderP,
                     struct decompTreeNode * const decompNodeP) {
 
 #if HAVE_UNICODE_WCHAR
-    decompNodeP->store.TwideString.valueP =
-        (const wchar_t**) va_arg(argsP->v, wchar_t**);
-    if (**formatP == '#') {
-        decompNodeP->store.TwideString.sizeP =
-            (size_t*) va_arg(argsP->v, size_t**);
-        (*formatP)++;
-    } else
-        decompNodeP->store.TwideString.sizeP = NULL;
+    buildSizedNode(formatP, builderP, decompNodeP);
 #else
     xmlrpc_faultf(envP,
                   "This XML-RPC For C/C++ library was built without Unicode "
@@ -681,7 +695,7 @@ static void
 buildArrayDecompBranch(xmlrpc_env *            const envP,
                        const char **           const formatP,
                        char                    const delim,
-                       va_listx *              const argsP,
+                       struct planBuilder *    const builderP,
                        struct decompTreeNode * const decompNodeP) {
 /*----------------------------------------------------------------------------
    Fill in the decomposition tree node *decompNodeP to cover an array
@@ -695,11 +709,10 @@ buildArrayDecompBranch(xmlrpc_env *            const envP,
    We create a node (and whole branch if required) to describe each array
    item.
 
-   The pointers to where those items are to be stored are given by
-   'argsP'.
+   The pointers to where those items are to be stored are variable
+   arguments; we add them to *builderP.
 
-   We advance *formatP to the delimiter character, and advance 'argsP'
-   past whatever arguments we use.
+   We advance *formatP to the delimiter character.
 -----------------------------------------------------------------------------*/
     unsigned int itemCnt;
         /* Number of array items in the branch so far */
@@ -716,7 +729,7 @@ buildArrayDecompBranch(xmlrpc_env *            const envP,
         else {
             struct decompTreeNode * itemNodeP;
             
-            createDecompTreeNext(envP, formatP, argsP, &itemNodeP);
+            createDecompTreeNext(envP, formatP, builderP, &itemNodeP);
                 
             if (!envP->fault_occurred)
                 decompNodeP->store.Tarray.itemArray[itemCnt++] = itemNodeP;
@@ -738,16 +751,16 @@ buildArrayDecompBranch(xmlrpc_env *            const envP,
 
 
 static void
-doStructValue(xmlrpc_env *       const envP,
-              const char **      const formatP,
-              va_listx *         const argsP,
-              struct mbrDecomp * const mbrP) {
+doStructValue(xmlrpc_env *         const envP,
+              const char **        const formatP,
+              struct planBuilder * const builderP,
+              struct mbrDecomp *   const mbrP) {
 
     struct decompTreeNode * valueNodeP;
 
-    mbrP->key = (const char*) va_arg(argsP->v, char*);
+    mbrP->keyArgIndex = addArg(builderP, 'k');
         
-    createDecompTreeNext(envP, formatP, argsP,  &valueNodeP);
+    createDecompTreeNext(envP, formatP, builderP, &valueNodeP);
         
     if (!envP->fault_occurred)
         mbrP->decompTreeP = valueNodeP;
@@ -819,7 +832,7 @@ static void
 buildStructDecompBranch(xmlrpc_env *            const envP,
                         const char **           const formatP,
                         char                    const delim,
-                        va_listx *              const argsP,
+                        struct planBuilder *    const builderP,
                         struct decompTreeNode * const decompNodeP) {
 /*----------------------------------------------------------------------------
    Fill in the decomposition tree node *decompNodeP to cover a struct
@@ -830,13 +843,11 @@ buildStructDecompBranch(xmlrpc_env *            const envP,
    We create a node (and whole branch if required) to describe each
    struct member value.
 
-   The pointers to where those values are to be stored are given by
-   'argsP'.
+   The pointers to where those values are to be stored are variable
+   arguments, and so are the names of the members to be extracted.  We add
+   them to *builderP.
 
-   The names of the members to be extracted are also given by 'argsP'.
-
-   We advance *formatP to the delimiter character, and advance 'argsP'
-   past whatever arguments we use.
+   We advance *formatP to the delimiter character.
 -----------------------------------------------------------------------------*/
     unsigned int memberCnt;
         /* Number of struct members in the branch so far */
@@ -867,7 +878,7 @@ buildStructDecompBranch(xmlrpc_env *            const envP,
                 if (!envP->fault_occurred) {
                     ++*formatP;
 
-                    doStructValue(envP, formatP, argsP, mbrP);
+                    doStructValue(envP, formatP, builderP, mbrP);
                     
                     if (!envP->fault_occurred)
                         ++memberCnt;
@@ -898,7 +909,7 @@ buildStructDecompBranch(xmlrpc_env *            const envP,
 static void 
 createDecompTreeNext(xmlrpc_env *             const envP,
                      const char **            const formatP,
-                     va_listx *               const argsP,
+                     struct planBuilder *     const builderP,
                      struct decompTreeNode ** const decompNodePP) {
 /*----------------------------------------------------------------------------
    Create a branch of a decomposition tree that applies to the first
@@ -917,8 +928,9 @@ createDecompTreeNext(xmlrpc_env *             const envP,
        and one for a boolean.
 
    The locations at which the components of that value are to be
-   stored (which is the main contents of the branch we create) are
-   given by 'argsP'.
+   stored are variable arguments.  We add them to *builderP, and the
+   branch we create refers to them by their position in the argument
+   vector.
 
    Return as *decompNodeP a pointer to the root node of the branch we
    generate.
@@ -932,94 +944,51 @@ createDecompTreeNext(xmlrpc_env *             const envP,
                       "tree node");
     else {
         decompNodeP->formatSpecChar = *(*formatP)++;
+        decompNodeP->hasSize = false;
+        decompNodeP->argIndex = 0;
         
         switch (decompNodeP->formatSpecChar) {
         case '-':
+        case 'n':
             /* There's nothing to store */
             break;
+
         case 'i':
-            decompNodeP->store.Tinteger.valueP =
-                (xmlrpc_int32*) va_arg(argsP->v, xmlrpc_int32*);
-            break;
-            
         case 'b':
-            decompNodeP->store.Tbool.valueP =
-                (xmlrpc_bool*) va_arg(argsP->v, xmlrpc_bool*);
-            break;
-            
         case 'd':
-            decompNodeP->store.Tdouble.valueP =
-                (double*) va_arg(argsP->v, double*);
-            break;
-            
         case 't':
-            decompNodeP->store.TdatetimeT.valueP =
-                va_arg(argsP->v, time_t*);
-            break;
-
         case '8':
-            decompNodeP->store.Tdatetime8.valueP =
-                (const char**) va_arg(argsP->v, char**);
+        case 'I':
+        case 'p':
+        case 'V':
+        case 'A':
+        case 'S':
+            decompNodeP->argIndex =
+                addArg(builderP, decompNodeP->formatSpecChar);
             break;
 
         case 's':
-            decompNodeP->store.Tstring.valueP = 
-                (const char**) va_arg(argsP->v, char**);
-            if (**formatP == '#') {
-                decompNodeP->store.Tstring.sizeP = 
-                    (size_t*) va_arg(argsP->v, size_t**);
-                ++*formatP;
-            } else
-                decompNodeP->store.Tstring.sizeP = NULL;
+            buildSizedNode(formatP, builderP, decompNodeP);
             break;
 
         case 'w':
-            buildWideStringNode(envP, formatP, argsP, decompNodeP);
+            buildWideStringNode(envP, formatP, builderP, decompNodeP);
             break;
         
         case '6':
-            decompNodeP->store.TbitString.valueP =
-                (const unsigned char**) va_arg(argsP->v, unsigned char**);
-            decompNodeP->store.TbitString.sizeP =
-                (size_t*) va_arg(argsP->v, size_t**);        
-            break;
-
-        case 'n':
-            /* There's no value to store */
-            break;
-
-        case 'I':
-            decompNodeP->store.Ti8.valueP =
-                (xmlrpc_int64 *) va_arg(argsP->v, xmlrpc_int64 *);
-            break;
-            
-        case 'p':
-            decompNodeP->store.Tcptr.valueP =
-                (void**) va_arg(argsP->v, void**);
-            break;
-
-        case 'V':
-            decompNodeP->store.Tvalue.valueP =
-                (xmlrpc_value**) va_arg(argsP->v, xmlrpc_value**);
-            break;
-
-        case 'A':
-            decompNodeP->store.TarrayVal.valueP =
-                (xmlrpc_value**) va_arg(argsP->v, xmlrpc_value**);
-            break;
-
-        case 'S':
-            decompNodeP->store.TstructVal.valueP =
-                (xmlrpc_value**) va_arg(argsP->v, xmlrpc_value**);
+            decompNodeP->argIndex = addArg(builderP, '6');
+            addArg(builderP, '#');
             break;
 
         case '(':
-            buildArrayDecompBranch(envP, formatP, ')', argsP, decompNodeP);
+            buildArrayDecompBranch(envP, formatP, ')', builderP,
+                                   decompNodeP);
             ++(*formatP);  /* skip past closing ')' */
             break;
 
         case '{':
-            buildStructDecompBranch(envP, formatP, '}', argsP, decompNodeP);
+            buildStructDecompBranch(envP, formatP, '}', builderP,
+                                    decompNodeP);
             ++(*formatP);  /* skip past closing '}' */
             break;
 
@@ -1039,16 +1008,14 @@ createDecompTreeNext(xmlrpc_env *             const envP,
 static void
 createDecompTree(xmlrpc_env *             const envP,
                  const char *             const format,
-                 va_listx                 const args,
+                 struct planBuilder *     const builderP,
                  struct decompTreeNode ** const decompRootPP) {
 
     const char * formatCursor;
     struct decompTreeNode * decompRootP;
-    va_listx currentArgs;
 
-    currentArgs = args;
     formatCursor = &format[0];
-    createDecompTreeNext(envP, &formatCursor, &currentArgs, &decompRootP);
+    createDecompTreeNext(envP, &formatCursor, builderP, &decompRootP);
     if (!envP->fault_occurred) {
         if (*formatCursor != '\0')
             xmlrpc_faultf(envP, "format string '%s' has garbage at the end: "
@@ -1064,6 +1031,203 @@ createDecompTree(xmlrpc_env *             const envP,
 
 
 
+void
+xmlrpc_decomp_plan_create(xmlrpc_env *                 const envP,
+                          const char *                 const format,
+                          const xmlrpc_decomp_plan **  const planPP) {
+/*----------------------------------------------------------------------------
+   Compile format string 'format' (as for xmlrpc_decompose_value()) into
+   a plan for decomposing values, which Caller can use with
+   xmlrpc_decompose_value_plan() over and over without the cost of
+   parsing the format string each time.
+-----------------------------------------------------------------------------*/
+    xmlrpc_decomp_plan * planP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(format != NULL);
+
+    MALLOCVAR(planP);
+
+    if (planP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate space for a decomposition "
+                      "plan");
+    else {
+        struct planBuilder builder;
+
+        /* Every specifier character stands for at most two arguments
+           ('6' is a byte string and its length), so this is enough:
+        */
+        MALLOCARRAY(builder.argType, strlen(format) * 2 + 1);
+
+        if (builder.argType == NULL)
+            xmlrpc_faultf(envP, "Could not allocate space for the "
+                          "argument types of a decomposition plan");
+        else {
+            builder.argCt = 0;
+
+            createDecompTree(envP, format, &builder, &planP->rootP);
+
+            if (!envP->fault_occurred) {
+                planP->argCt   = builder.argCt;
+                planP->argType = builder.argType;
+
+                *planPP = planP;
+            }
+            if (envP->fault_occurred)
+                free(builder.argType);
+        }
+        if (envP->fault_occurred)
+            free(planP);
+    }
+}
+
+
+
+void
+xmlrpc_decomp_plan_destroy(const xmlrpc_decomp_plan * const planP) {
+
+    destroyDecompTree(planP->rootP);
+    free(planP->argType);
+    free((void*)planP);
+}
+
+
+
+static void
+destroyPlan(const void * const planP) {
+/*----------------------------------------------------------------------------
+   This is a planCacheDestroyFn.
+-----------------------------------------------------------------------------*/
+    xmlrpc_decomp_plan_destroy(planP);
+}
+
+
+
+void
+xmlrpc_decomposeInit(xmlrpc_env * const envP) {
+
+    xmlrpc_planCacheCreate(envP, &destroyPlan, &decompPlanCacheP);
+}
+
+
+
+void
+xmlrpc_decomposeTerm(void) {
+
+    if (decompPlanCacheP) {
+        xmlrpc_planCacheDestroy(decompPlanCacheP);
+        decompPlanCacheP = NULL;
+    }
+}
+
+
+
+static void
+getPlan(xmlrpc_env *                const envP,
+        const char *                const format,
+        const xmlrpc_decomp_plan ** const planPP,
+        bool *                      const mustDestroyP) {
+/*----------------------------------------------------------------------------
+   Get the plan for format string 'format', from the plan cache if we can.
+
+   Return *mustDestroyP true iff the plan isn't in the cache, so Caller
+   must destroy it when done with it.
+-----------------------------------------------------------------------------*/
+    const xmlrpc_decomp_plan * planP;
+
+    planP = decompPlanCacheP ?
+        xmlrpc_planCacheGet(decompPlanCacheP, format) : NULL;
+
+    if (planP) {
+        *planPP = planP;
+        *mustDestroyP = false;
+    } else {
+        xmlrpc_decomp_plan_create(envP, format, &planP);
+
+        if (!envP->fault_occurred) {
+            *planPP = planP;
+            *mustDestroyP = decompPlanCacheP ?
+                !xmlrpc_planCacheAdd(decompPlanCacheP, format, planP) : true;
+        }
+    }
+}
+
+
+
+static void
+collectArgs(const xmlrpc_decomp_plan * const planP,
+            va_listx *                 const argsP,
+            void **                    const argv) {
+/*----------------------------------------------------------------------------
+   Fetch the variable arguments that plan *planP describes from 'argsP'
+   into the argument vector argv[].
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < planP->argCt; ++i) {
+        switch (planP->argType[i]) {
+        case 'i': argv[i] = va_arg(argsP->v, xmlrpc_int32 *);        break;
+        case 'b': argv[i] = va_arg(argsP->v, xmlrpc_bool *);         break;
+        case 'd': argv[i] = va_arg(argsP->v, double *);              break;
+        case 't': argv[i] = va_arg(argsP->v, time_t *);              break;
+        case '8': argv[i] = va_arg(argsP->v, char **);               break;
+        case 's': argv[i] = va_arg(argsP->v, char **);               break;
+#if HAVE_UNICODE_WCHAR
+        case 'w': argv[i] = va_arg(argsP->v, wchar_t **);            break;
+#endif
+        case '6': argv[i] = va_arg(argsP->v, unsigned char **);      break;
+        case '#': argv[i] = va_arg(argsP->v, size_t *);              break;
+        case 'I': argv[i] = va_arg(argsP->v, xmlrpc_int64 *);        break;
+        case 'p': argv[i] = va_arg(argsP->v, void **);               break;
+        case 'V':
+        case 'A':
+        case 'S': argv[i] = va_arg(argsP->v, xmlrpc_value **);       break;
+        case 'k': argv[i] = va_arg(argsP->v, char *);                break;
+        default:
+            XMLRPC_ASSERT(false);
+        }
+    }
+}
+
+
+
+static void
+decomposeValueWithPlan(xmlrpc_env *               const envP,
+                       xmlrpc_value *             const valueP,
+                       bool                       const oldstyleMemMgmt,
+                       const xmlrpc_decomp_plan * const planP,
+                       va_listx                   const args) {
+
+    void * argvBuf[32];
+        /* Argument vector, if it's small enough (it usually is) */
+    void ** argv;
+
+    if (planP->argCt <= ARRAY_SIZE(argvBuf))
+        argv = argvBuf;
+    else {
+        MALLOCARRAY(argv, planP->argCt);
+
+        if (argv == NULL)
+            xmlrpc_faultf(envP, "Could not allocate space for %u "
+                          "decomposition arguments", planP->argCt);
+    }
+    if (!envP->fault_occurred) {
+        va_listx currentArgs;
+
+        currentArgs = args;
+
+        collectArgs(planP, &currentArgs, argv);
+
+        decomposeValueWithTree(envP, valueP, oldstyleMemMgmt, planP->rootP,
+                               argv);
+
+        if (argv != argvBuf)
+            free(argv);
+    }
+}
+
+
+
 static void 
 decomposeValue(xmlrpc_env *   const envP,
                xmlrpc_value * const valueP,
@@ -1071,18 +1235,20 @@ decomposeValue(xmlrpc_env *   const envP,
                const char *   const format,
                va_listx       const args) {
 
-    struct decompTreeNode * decompRootP;
+    const xmlrpc_decomp_plan * planP;
+    bool mustDestroyPlan;
 
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT_VALUE_OK(valueP);
     XMLRPC_ASSERT(format != NULL);
 
-    createDecompTree(envP, format, args, &decompRootP);
+    getPlan(envP, format, &planP, &mustDestroyPlan);
 
     if (!envP->fault_occurred) {
-        decomposeValueWithTree(envP, valueP, oldstyleMemMgmt, decompRootP);
+        decomposeValueWithPlan(envP, valueP, oldstyleMemMgmt, planP, args);
 
-        destroyDecompTree(decompRootP);
+        if (mustDestroyPlan)
+            xmlrpc_decomp_plan_destroy(planP);
     }
 }
 
@@ -1119,6 +1285,44 @@ xmlrpc_decompose_value(xmlrpc_env *   const envP,
 
 
 
+void 
+xmlrpc_decompose_value_plan_va(xmlrpc_env *               const envP,
+                               xmlrpc_value *             const valueP,
+                               const xmlrpc_decomp_plan * const planP,
+                               va_list                    const args) {
+
+    bool const oldstyleMemMgtFalse = false;
+    va_listx argsx;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+    XMLRPC_ASSERT_PTR_OK(planP);
+
+    init_va_listx(&argsx, args);
+
+    decomposeValueWithPlan(envP, valueP, oldstyleMemMgtFalse, planP, argsx);
+}
+
+
+
+void 
+xmlrpc_decompose_value_plan(xmlrpc_env *               const envP,
+                            xmlrpc_value *             const valueP,
+                            const xmlrpc_decomp_plan * const planP,
+                            ...) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_decompose_value(), but with the format string already
+   compiled into *planP by xmlrpc_decomp_plan_create().
+-----------------------------------------------------------------------------*/
+    va_list args;
+
+    va_start(args, planP);
+    xmlrpc_decompose_value_plan_va(envP, valueP, planP, args);
+    va_end(args);
+}
+
+
+
 void 
 xmlrpc_parse_value_va(xmlrpc_env *   const envP,
                       xmlrpc_value * const valueP,
@@ -6,6 +6,7 @@
 #define WIN32_LEAN_AND_MEAN  /* required by xmlrpc-c/abyss.h */
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,6 +21,7 @@
 #  include <sys/wait.h>
 #  include <grp.h>
 #  include <sys/socket.h>
+#  include <sys/un.h>
 #  include <netinet/in.h>
 #endif
 
@@ -138,14 +140,35 @@ processXmlrpcCall(xmlrpc_env *        const envP,
 
     xmlrpc_registry * const registryP = arg;
 
-    xmlrpc_registry_process_call2(envP, registryP,
+    xmlrpc_registry_process_call3(envP, registryP,
                                   callXml, callXmlLen, abyssSessionP,
+                                  xmlrpc_server_abyss_call_ctl(abyssSessionP),
                                   responseXmlPP);
 
 }
 
 
 
+static xmlrpc_call_processor_async processXmlrpcCallAsync;
+
+static void
+processXmlrpcCallAsync(void *               const arg,
+                       const char *         const callXml,
+                       size_t               const callXmlLen,
+                       TSession *           const abyssSessionP,
+                       xmlrpc_call_ctl *    const callCtlP,
+                       xmlrpc_response_fn * const responseFn,
+                       void *               const responseContext) {
+
+    xmlrpc_registry * const registryP = arg;
+
+    xmlrpc_registry_process_call_async(registryP,
+                                       callXml, callXmlLen, abyssSessionP,
+                                       callCtlP, responseFn, responseContext);
+}
+
+
+
 static void
 setHandler(xmlrpc_env *              const envP,
            TServer *                 const srvP,
@@ -253,6 +276,17 @@ xmlrpc_server_abyss_set_handler3(
         else
             uriHandlerXmlrpcP->chunkResponse = false;
         
+        if (parmSize >= XMLRPC_AHPSIZE(call_timeout_ms))
+            uriHandlerXmlrpcP->callTimeoutMs = parmsP->call_timeout_ms;
+        else
+            uriHandlerXmlrpcP->callTimeoutMs = 0;
+
+        if (parmSize >= XMLRPC_AHPSIZE(xml_processor_async))
+            uriHandlerXmlrpcP->xmlProcessorAsync =
+                parmsP->xml_processor_async;
+        else
+            uriHandlerXmlrpcP->xmlProcessorAsync = NULL;
+
         interpretHttpAccessControl(parmsP, parmSize,
                                    &uriHandlerXmlrpcP->accessControl);
 
@@ -311,9 +345,15 @@ xmlrpc_server_abyss_set_handler(xmlrpc_env *      const envP,
     parms.xml_processor_arg = registryP;
     parms.xml_processor_max_stack = xmlrpc_registry_max_stackSize(registryP);
     parms.uri_path = uriPath;
+    parms.chunk_response = false;
+    parms.allow_origin = NULL;
+    parms.access_ctl_expires = false;
+    parms.access_ctl_max_age = 0;
+    parms.call_timeout_ms = 0;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
-    xmlrpc_server_abyss_set_handler3(envP, srvP,
-                                     &parms, XMLRPC_AHPSIZE(uri_path));
+    xmlrpc_server_abyss_set_handler3(
+        envP, srvP, &parms, XMLRPC_AHPSIZE(xml_processor_async));
 }
 
     
@@ -333,7 +373,8 @@ setHandlersRegistry(TServer *         const srvP,
                     bool              const chunkResponse,
                     const char *      const allowOrigin,
                     bool              const expires,
-                    unsigned int      const maxAge) {
+                    unsigned int      const maxAge,
+                    unsigned int      const callTimeoutMs) {
 
     xmlrpc_env env;
     xmlrpc_server_abyss_handler_parms parms;
@@ -348,9 +389,11 @@ setHandlersRegistry(TServer *         const srvP,
     parms.allow_origin = allowOrigin;
     parms.access_ctl_expires = expires;
     parms.access_ctl_max_age = maxAge;
+    parms.call_timeout_ms = callTimeoutMs;
+    parms.xml_processor_async = &processXmlrpcCallAsync;
 
     xmlrpc_server_abyss_set_handler3(
-        &env, srvP, &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &env, srvP, &parms, XMLRPC_AHPSIZE(xml_processor_async));
     
     if (env.fault_occurred)
         abort();
@@ -367,7 +410,7 @@ xmlrpc_server_abyss_set_handlers2(TServer *         const srvP,
                                   const char *      const uriPath,
                                   xmlrpc_registry * const registryP) {
 
-    setHandlersRegistry(srvP, uriPath, registryP, false, NULL, false, 0);
+    setHandlersRegistry(srvP, uriPath, registryP, false, NULL, false, 0, 0);
 }
 
 
@@ -376,7 +419,7 @@ void
 xmlrpc_server_abyss_set_handlers(TServer *         const srvP,
                                  xmlrpc_registry * const registryP) {
 
-    setHandlersRegistry(srvP, "/RPC2", registryP, false, NULL, false, 0);
+    setHandlersRegistry(srvP, "/RPC2", registryP, false, NULL, false, 0, 0);
 }
 
 
@@ -409,6 +452,8 @@ setAdditionalServerParms(const xmlrpc_server_abyss_parms * const parmsP,
         if (parmsP->max_conn_backlog != 0)
             ServerSetMaxConnBacklog(serverP, parmsP->max_conn_backlog);
     }
+    if (parmSize >= XMLRPC_APSIZE(worker_processes))
+        ServerSetWorkerProcesses(serverP, parmsP->worker_processes);
 }
 
 
@@ -516,13 +561,17 @@ extractServerCreateParms(
 
 static void
 chanSwitchCreateOsSocket(TOsSocket      const socketFd,
+                         bool           const useIoUring,
                          TChanSwitch ** const chanSwitchPP,
                          const char **  const errorP) {
 
 #ifdef _WIN32
     ChanSwitchWinCreateWinsock(socketFd, chanSwitchPP, errorP);
 #else
-    ChanSwitchUnixCreateFd(socketFd, chanSwitchPP, errorP);
+    if (useIoUring)
+        ChanSwitchUringCreateFd(socketFd, chanSwitchPP, errorP);
+    else
+        ChanSwitchUnixCreateFd(socketFd, chanSwitchPP, errorP);
 #endif
 
 }
@@ -532,11 +581,12 @@ chanSwitchCreateOsSocket(TOsSocket      const socketFd,
 static void
 createChanSwitchOsSocket(xmlrpc_env *   const envP,
                          TOsSocket      const socketFd,
+                         bool           const useIoUring,
                          TChanSwitch ** const chanSwitchPP) {
 
     const char * error;
 
-    chanSwitchCreateOsSocket(socketFd, chanSwitchPP, &error);
+    chanSwitchCreateOsSocket(socketFd, useIoUring, chanSwitchPP, &error);
 
     if (error) {
         xmlrpc_faultf(envP, "Unable to create Abyss channel switch out of "
@@ -551,6 +601,7 @@ static void
 chanSwitchCreateSockAddr(int                     const protocolFamily,
                          const struct sockaddr * const sockAddrP,
                          socklen_t               const sockAddrLen,
+                         bool                    const useIoUring,
                          TChanSwitch **          const chanSwitchPP,
                          const char **           const errorP) {
 
@@ -558,8 +609,12 @@ chanSwitchCreateSockAddr(int                     const protocolFamily,
     ChanSwitchWinCreate2(protocolFamily, sockAddrP, sockAddrLen, 
                           chanSwitchPP, errorP);
 #else
-    ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen, 
-                          chanSwitchPP, errorP);
+    if (useIoUring)
+        ChanSwitchUringCreate2(protocolFamily, sockAddrP, sockAddrLen,
+                               chanSwitchPP, errorP);
+    else
+        ChanSwitchUnixCreate2(protocolFamily, sockAddrP, sockAddrLen, 
+                              chanSwitchPP, errorP);
 #endif
 
 }
@@ -567,10 +622,11 @@ chanSwitchCreateSockAddr(int                     const protocolFamily,
 
 
 static void
-createChanSwitchSockAddr(xmlrpc_env *            const envP,
-                         const struct sockaddr * const sockAddrP,
-                         socklen_t               const sockAddrLen,
-                         TChanSwitch **          const chanSwitchPP) {
+createChanSwitchSockAddrInet(xmlrpc_env *            const envP,
+                             const struct sockaddr * const sockAddrP,
+                             socklen_t               const sockAddrLen,
+                             bool                    const useIoUring,
+                             TChanSwitch **          const chanSwitchPP) {
 
     int protocolFamily;
 
@@ -593,7 +649,7 @@ createChanSwitchSockAddr(xmlrpc_env *            const envP,
         const char * error;
 
         chanSwitchCreateSockAddr(protocolFamily, sockAddrP, sockAddrLen,
-                                 chanSwitchPP, &error);
+                                 useIoUring, chanSwitchPP, &error);
 
         if (error) {
             xmlrpc_faultf(envP, "Unable to create Abyss channel switch "
@@ -605,9 +661,78 @@ createChanSwitchSockAddr(xmlrpc_env *            const envP,
 
 
 
+#ifndef _WIN32
+static void
+createChanSwitchLocal(xmlrpc_env *               const envP,
+                      const struct sockaddr_un * const sockAddrP,
+                      socklen_t                  const sockAddrLen,
+                      TChanSwitch **             const chanSwitchPP) {
+/*----------------------------------------------------------------------------
+   Create a channel switch for the Unix domain socket address *sockAddrP.
+
+   We use the Abyss facility for named local sockets rather than just
+   binding the address so that a socket left behind by a previous server
+   does not get in the way and the channel switch removes the socket name
+   when it is done with it.
+-----------------------------------------------------------------------------*/
+    size_t const pathOffset = offsetof(struct sockaddr_un, sun_path);
+
+    if (sockAddrLen <= pathOffset || sockAddrP->sun_path[0] == '\0')
+        xmlrpc_faultf(envP, "Unix domain socket address has no "
+                      "file system name");
+    else {
+        size_t const maxPathLen = sizeof(sockAddrP->sun_path);
+        size_t const pathLen =
+            sockAddrLen - pathOffset < maxPathLen ?
+            sockAddrLen - pathOffset : maxPathLen;
+
+        char path[sizeof(sockAddrP->sun_path) + 1];
+        const char * error;
+
+        strncpy(path, sockAddrP->sun_path, pathLen);
+        path[pathLen] = '\0';
+
+        ChanSwitchUnixCreateLocal(path, chanSwitchPP, &error);
+
+        if (error) {
+            xmlrpc_faultf(envP, "Unable to create Abyss channel switch "
+                          "for Unix domain socket '%s'.  %s", path, error);
+            xmlrpc_strfree(error);
+        }
+    }
+}
+#endif
+
+
+
+static void
+createChanSwitchSockAddr(xmlrpc_env *            const envP,
+                         const struct sockaddr * const sockAddrP,
+                         socklen_t               const sockAddrLen,
+                         bool                    const useIoUring,
+                         TChanSwitch **          const chanSwitchPP) {
+/*----------------------------------------------------------------------------
+   'useIoUring' means to do the I/O through io_uring if the kernel has it.
+   It has no effect on a Unix domain socket.
+-----------------------------------------------------------------------------*/
+    assert(sockAddrP);
+
+#ifndef _WIN32
+    if (sockAddrP->sa_family == AF_UNIX)
+        createChanSwitchLocal(envP, (const struct sockaddr_un *)sockAddrP,
+                              sockAddrLen, chanSwitchPP);
+    else
+#endif
+        createChanSwitchSockAddrInet(envP, sockAddrP, sockAddrLen,
+                                     useIoUring, chanSwitchPP);
+}
+
+
+
 static void
 createChanSwitchIpv4Port(xmlrpc_env *          const envP,
                          unsigned int          const portNumber,
+                         bool                  const useIoUring,
                          TChanSwitch **        const chanSwitchPP) {
 
     struct sockaddr_in sockAddr;
@@ -618,7 +743,7 @@ createChanSwitchIpv4Port(xmlrpc_env *          const envP,
     sockAddr.sin_addr.s_addr = INADDR_ANY;
 
     chanSwitchCreateSockAddr(PF_INET, (const struct sockaddr *)&sockAddr,
-                             sizeof(sockAddr),
+                             sizeof(sockAddr), useIoUring,
                              chanSwitchPP, &error);
     
     if (error) {
@@ -654,16 +779,21 @@ createServerBare(xmlrpc_env *                      const envP,
                              &logFileName);
 
     if (!envP->fault_occurred) {
+        bool const useIoUring =
+            parmSize >= XMLRPC_APSIZE(use_io_uring) && parmsP->use_io_uring;
+
         TChanSwitch * chanSwitchP;
 
         if (socketBound)
-            createChanSwitchOsSocket(envP, socketFd, &chanSwitchP);
+            createChanSwitchOsSocket(envP, socketFd, useIoUring,
+                                     &chanSwitchP);
         else {
             if (sockAddrP)
                 createChanSwitchSockAddr(envP, sockAddrP, sockAddrLen,
-                                         &chanSwitchP);
+                                         useIoUring, &chanSwitchP);
             else
-                createChanSwitchIpv4Port(envP, portNumber, &chanSwitchP);
+                createChanSwitchIpv4Port(envP, portNumber, useIoUring,
+                                         &chanSwitchP);
         }
         if (!envP->fault_occurred) {
             const char * error;
@@ -752,6 +882,17 @@ maxAgeParm(const xmlrpc_server_abyss_parms * const parmsP,
 
 
 
+static unsigned int
+callTimeoutParm(const xmlrpc_server_abyss_parms * const parmsP,
+                unsigned int                      const parmSize) {
+
+    return
+        parmSize >= XMLRPC_APSIZE(call_timeout_ms) ?
+        parmsP->call_timeout_ms : 0;
+}    
+
+
+
 static void
 createServer(xmlrpc_env *                      const envP,
              const xmlrpc_server_abyss_parms * const parmsP,
@@ -771,7 +912,8 @@ createServer(xmlrpc_env *                      const envP,
                             chunkResponseParm(parmsP, parmSize),
                             allowOriginParm(parmsP, parmSize),
                             expiresParm(parmsP, parmSize),
-                            maxAgeParm(parmsP, parmSize));
+                            maxAgeParm(parmsP, parmSize),
+                            callTimeoutParm(parmsP, parmSize));
         
         ServerInit2(abyssServerP, &error);
 
@@ -1124,7 +1266,7 @@ oldHighLevelAbyssRun(xmlrpc_env *                      const envP,
         assert(parmSize >= XMLRPC_APSIZE(registryP));
     
         setHandlersRegistry(&server, "/RPC2", parmsP->registryP, false, NULL,
-                            false, 0);
+                            false, 0, 0);
         
         ServerInit(&server);
     
@@ -1248,7 +1390,7 @@ xmlrpc_server_abyss_init_registry(void) {
     xmlrpc_env_clean(&env);
 
     setHandlersRegistry(&globalSrv, "/RPC2", builtin_registryP, false, NULL,
-                        false, 0);
+                        false, 0, 0);
 }
 
 
@@ -7,14 +7,20 @@
 #include "unistdx.h"
 #include <stdio.h>
 #ifndef _WIN32
+#include <signal.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #endif
 #include <errno.h>
 #include <string.h>
 
 #include "xmlrpc_config.h"
 
+#include "bool.h"
 #include "int.h"
 #include "casprintf.h"
 #include "xmlrpc-c/base.h"
@@ -200,6 +206,593 @@ testChanSwitchSockAddr(void) {
 
 
 
+#ifndef _WIN32
+static bool
+isSocketFile(const char * const path) {
+
+    struct stat statBuf;
+    int rc;
+
+    rc = lstat(path, &statBuf);
+
+    return rc == 0 && S_ISSOCK(statBuf.st_mode);
+}
+
+
+
+static void
+leaveStaleSocket(const char * const path) {
+/*----------------------------------------------------------------------------
+   Make a Unix domain socket named 'path' and close it, as a server that
+   dies would, so the name remains in the file system.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_un name;
+    int fd;
+    int rc;
+
+    fd = socket(PF_UNIX, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+
+    memset(&name, 0, sizeof(name));
+    name.sun_family = AF_UNIX;
+    strcpy(name.sun_path, path);
+
+    rc = bind(fd, (struct sockaddr *)&name, sizeof(name));
+    TEST(rc == 0);
+
+    close(fd);
+}
+
+
+
+static void
+testChanSwitchLocal(void) {
+
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    TChanSwitch * chanSwitch2P;
+    const char * error;
+    char path[64];
+    char longPath[200];
+    FILE * fileP;
+
+    sprintf(path, "/tmp/xmlrpc_test_abyss.%u", (unsigned)getpid());
+    unlink(path);
+
+    ChanSwitchUnixCreateLocal(path, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+    TEST(isSocketFile(path));
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+    ServerFree(&server);
+
+    ChanSwitchDestroy(chanSwitchP);
+    TEST(!isSocketFile(path));
+
+    /* A socket left behind by a dead server does not get in the way */
+    leaveStaleSocket(path);
+    TEST(isSocketFile(path));
+
+    ChanSwitchUnixCreateLocal(path, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    /* Nor do we take over the socket of a live server */
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+    ServerInit2(&server, &error);
+    TEST_NULL_STRING(error);
+    ChanSwitchUnixCreateLocal(path, &chanSwitch2P, &error);
+    TEST(error != NULL);
+    TEST(strstr(error, "in use"));
+    strfree(error);
+    TEST(isSocketFile(path));
+
+    ServerFree(&server);
+    ChanSwitchDestroy(chanSwitchP);
+    TEST(!isSocketFile(path));
+
+    /* But we don't clobber a file that isn't a socket */
+    fileP = fopen(path, "w");
+    TEST(fileP != NULL);
+    fclose(fileP);
+
+    ChanSwitchUnixCreateLocal(path, &chanSwitchP, &error);
+    TEST(error != NULL);
+    TEST(strstr(error, "not a socket"));
+    strfree(error);
+    unlink(path);
+
+    memset(longPath, 'x', sizeof(longPath) - 1);
+    longPath[0] = '/';
+    longPath[sizeof(longPath) - 1] = '\0';
+
+    ChanSwitchUnixCreateLocal(longPath, &chanSwitchP, &error);
+    TEST(error != NULL);
+    TEST(strstr(error, "too long"));
+    strfree(error);
+}
+
+
+
+static void
+exerciseUringSwitch(void) {
+/*----------------------------------------------------------------------------
+   Serve an HTTP request over a loopback connection through an io_uring
+   channel switch and its channel.
+-----------------------------------------------------------------------------*/
+    const char * const request = "GET /nonexistent HTTP/1.0\r\n\r\n";
+
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    const char * error;
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    int listenFd, clientFd;
+    char response[4096];
+    size_t responseLen;
+    int rc;
+
+    listenFd = socket(PF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rc = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+    addrLen = sizeof(addr);
+    rc = getsockname(listenFd, (struct sockaddr *)&addr, &addrLen);
+    TEST(rc == 0);
+
+    ChanSwitchUringCreateFd(listenFd, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerInit2(&server, &error);
+    TEST_NULL_STRING(error);
+
+    /* The connection and request wait in the kernel until the server gets
+       to them, so we can do this all in one thread.
+    */
+    clientFd = socket(PF_INET, SOCK_STREAM, 0);
+    TEST(clientFd >= 0);
+    rc = connect(clientFd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+    rc = send(clientFd, request, strlen(request), 0);
+    TEST(rc == (int)strlen(request));
+
+    ServerRunOnce(&server);
+
+    for (responseLen = 0, rc = 1; rc > 0 && responseLen < sizeof(response); ) {
+        rc = recv(clientFd, &response[responseLen],
+                  sizeof(response) - responseLen, 0);
+        if (rc > 0)
+            responseLen += rc;
+    }
+    TEST(rc == 0);  /* Server closed the connection */
+    TEST(responseLen > 12);
+    TEST(strncmp(response, "HTTP/1.1 404", 12) == 0);
+
+    close(clientFd);
+
+    ServerFree(&server);
+
+    /* Destroying the switch with an accept outstanding */
+    ChanSwitchDestroy(chanSwitchP);
+    close(listenFd);
+}
+
+
+
+static void
+testChanSwitchUring(void) {
+
+    TChanSwitch * chanSwitchP;
+    const char * error;
+
+    ChanSwitchUringCreate(8080, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+    ChanSwitchDestroy(chanSwitchP);
+
+    exerciseUringSwitch();
+
+    /* Same thing with the epoll fallback */
+    setenv("ABYSS_DISABLE_IO_URING", "1", 1);
+
+    ChanSwitchUringCreate(8080, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+    TEST(!ChanSwitchUringUsesUring(chanSwitchP));
+    ChanSwitchDestroy(chanSwitchP);
+
+    exerciseUringSwitch();
+
+    unsetenv("ABYSS_DISABLE_IO_URING");
+}
+#endif
+
+
+
+#ifndef _WIN32
+static void
+doLoopbackRequest(TServer *                  const serverP,
+                  const struct sockaddr_in * const addrP,
+                  const char *               const request,
+                  char *                     const response,
+                  size_t                     const responseSize,
+                  size_t *                   const responseLenP) {
+/*----------------------------------------------------------------------------
+   Send HTTP/1.0 request 'request' to the server listening at *addrP and
+   have the server process it.  Return the complete response.
+-----------------------------------------------------------------------------*/
+    size_t responseLen;
+    int clientFd;
+    int rc;
+
+    clientFd = socket(PF_INET, SOCK_STREAM, 0);
+    TEST(clientFd >= 0);
+    rc = connect(clientFd, (const struct sockaddr *)addrP, sizeof(*addrP));
+    TEST(rc == 0);
+    rc = send(clientFd, request, strlen(request), 0);
+    TEST(rc == (int)strlen(request));
+
+    ServerRunOnce(serverP);
+
+    for (responseLen = 0, rc = 1; rc > 0 && responseLen < responseSize; ) {
+        rc = recv(clientFd, &response[responseLen],
+                  responseSize - responseLen, 0);
+        if (rc > 0)
+            responseLen += rc;
+    }
+    TEST(rc == 0);  /* Server closed the connection */
+
+    close(clientFd);
+
+    *responseLenP = responseLen;
+}
+
+
+
+static const char *
+responseBody(const char * const response,
+             size_t       const responseLen) {
+
+    const char * p;
+
+    for (p = response;
+         p + 4 <= response + responseLen && strncmp(p, "\r\n\r\n", 4) != 0;
+         ++p);
+
+    return p + 4 <= response + responseLen ? p + 4 : NULL;
+}
+
+
+
+static void
+testServeFile(void) {
+/*----------------------------------------------------------------------------
+   Serve a file with the built-in handler, both when it opens the file and
+   when it finds it in its file cache.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    const char * error;
+    const char * dirName;
+    const char * fileName;
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    char contents[10000];
+    static char response[16384];
+    size_t responseLen;
+    const char * body;
+    unsigned int i;
+    unsigned int pass;
+    FILE * fileP;
+    int listenFd;
+    int rc;
+
+    casprintf(&dirName, "/tmp/xmlrpc_test_abyss.%u", (unsigned)getpid());
+    rc = mkdir(dirName, 0700);
+    TEST(rc == 0);
+    casprintf(&fileName, "%s/test.txt", dirName);
+
+    /* Bigger than the handler's buffer, so it takes more than one read
+       where the channel can't send straight from the file.
+    */
+    for (i = 0; i < sizeof(contents); ++i)
+        contents[i] = 'a' + i % 26;
+    fileP = fopen(fileName, "w");
+    TEST(fileP != NULL);
+    TEST(fwrite(contents, 1, sizeof(contents), fileP) == sizeof(contents));
+    fclose(fileP);
+
+    listenFd = socket(PF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rc = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+    addrLen = sizeof(addr);
+    rc = getsockname(listenFd, (struct sockaddr *)&addr, &addrLen);
+    TEST(rc == 0);
+
+    ChanSwitchUnixCreateFd(listenFd, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerSetFilesPath(&server, dirName);
+
+    ServerInit2(&server, &error);
+    TEST_NULL_STRING(error);
+
+    /* First pass opens the file; second finds it in the cache */
+    for (pass = 0; pass < 2; ++pass) {
+        doLoopbackRequest(&server, &addr, "GET /test.txt HTTP/1.0\r\n\r\n",
+                          response, sizeof(response), &responseLen);
+        TEST(responseLen > 12);
+        TEST(strncmp(response, "HTTP/1.1 200", 12) == 0);
+        TEST(strstr(response, "Last-Modified: ") != NULL);
+        TEST(strstr(response, "text/plain") != NULL);
+        body = responseBody(response, responseLen);
+        TEST(body != NULL);
+        TEST(response + responseLen - body == sizeof(contents));
+        TEST(memcmp(body, contents, sizeof(contents)) == 0);
+    }
+
+    doLoopbackRequest(&server, &addr,
+                      "GET /test.txt HTTP/1.0\r\n"
+                      "Range: bytes=100-109\r\n\r\n",
+                      response, sizeof(response), &responseLen);
+    TEST(responseLen > 12);
+    TEST(strncmp(response, "HTTP/1.1 206", 12) == 0);
+    body = responseBody(response, responseLen);
+    TEST(body != NULL);
+    TEST(response + responseLen - body == 10);
+    TEST(memcmp(body, &contents[100], 10) == 0);
+
+    /* A cached file that has gone away */
+    unlink(fileName);
+    sleep(1);  /* Let the cache's trust in the file run out */
+    doLoopbackRequest(&server, &addr, "GET /test.txt HTTP/1.0\r\n\r\n",
+                      response, sizeof(response), &responseLen);
+    TEST(responseLen > 12);
+    TEST(strncmp(response, "HTTP/1.1 404", 12) == 0);
+
+    ServerFree(&server);
+    ChanSwitchDestroy(chanSwitchP);
+    close(listenFd);
+
+    rmdir(dirName);
+    strfree(fileName);
+    strfree(dirName);
+}
+
+
+
+static TServer * runningServerP;
+
+
+
+static void
+terminateRunningServer(int const signalClass ATTR_UNUSED) {
+
+    ServerTerminate(runningServerP);
+}
+
+
+
+static void
+testWorkerProcesses(void) {
+/*----------------------------------------------------------------------------
+   Run a server in worker processes.  A client process does a request,
+   then signals us to terminate the server.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    TServerStats stats;
+    const char * error;
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    struct sigaction sa, oldSa;
+    pid_t clientPid;
+    int listenFd;
+    int status;
+    int rc;
+
+    listenFd = socket(PF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rc = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+    addrLen = sizeof(addr);
+    rc = getsockname(listenFd, (struct sockaddr *)&addr, &addrLen);
+    TEST(rc == 0);
+
+    ChanSwitchUnixCreateFd(listenFd, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerSetWorkerProcesses(&server, 2);
+
+    ServerInit2(&server, &error);
+    TEST_NULL_STRING(error);
+
+    runningServerP = &server;
+    sa.sa_handler = &terminateRunningServer;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGUSR1, &sa, &oldSa);
+
+    fflush(stdout);  /* So the children don't write it again */
+
+    clientPid = fork();
+    TEST(clientPid >= 0);
+
+    if (clientPid == 0) {
+        char response[4096];
+        size_t responseLen;
+        const char * const request =
+            "GET /xmlrpc_test_no_such_file HTTP/1.0\r\n\r\n";
+        int clientFd;
+
+        clientFd = socket(PF_INET, SOCK_STREAM, 0);
+        rc = connect(clientFd, (const struct sockaddr *)&addr, sizeof(addr));
+        if (rc == 0)
+            rc = send(clientFd, request, strlen(request), 0);
+        for (responseLen = 0; rc > 0 && responseLen < sizeof(response); ) {
+            rc = recv(clientFd, &response[responseLen],
+                      sizeof(response) - responseLen, 0);
+            if (rc > 0)
+                responseLen += rc;
+        }
+        close(clientFd);
+
+        kill(getppid(), SIGUSR1);
+
+        _exit(responseLen > 12 &&
+              strncmp(response, "HTTP/1.1 404", 12) == 0 ? 0 : 1);
+    }
+
+    ServerRun(&server);
+
+    rc = waitpid(clientPid, &status, 0);
+    TEST(rc == clientPid);
+    TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    ServerGetStats(&server, &stats);
+    TEST(stats.connAcceptedCt == 1);
+    TEST(stats.connShedCt == 0);
+    TEST(stats.connInProgressCt == 0);
+
+    sigaction(SIGUSR1, &oldSa, NULL);
+
+    ServerFree(&server);
+    ChanSwitchDestroy(chanSwitchP);
+    close(listenFd);
+}
+
+
+static void
+testConnTimeouts(void) {
+/*----------------------------------------------------------------------------
+   Let a connection time out in the middle of a request, and another while
+   waiting for one.  A client process makes the connections, then signals
+   us to terminate the server.
+-----------------------------------------------------------------------------*/
+    TServer server;
+    TChanSwitch * chanSwitchP;
+    TServerStats stats;
+    const char * error;
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    struct sigaction sa, oldSa;
+    pid_t clientPid;
+    int listenFd;
+    int status;
+    int rc;
+
+    listenFd = socket(PF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rc = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+    addrLen = sizeof(addr);
+    rc = getsockname(listenFd, (struct sockaddr *)&addr, &addrLen);
+    TEST(rc == 0);
+
+    ChanSwitchUnixCreateFd(listenFd, &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerSetTimeout(&server, 2);
+    ServerSetKeepaliveTimeout(&server, 1);
+
+    ServerInit2(&server, &error);
+    TEST_NULL_STRING(error);
+
+    runningServerP = &server;
+    sa.sa_handler = &terminateRunningServer;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGUSR1, &sa, &oldSa);
+
+    fflush(stdout);  /* So the child doesn't write it again */
+
+    clientPid = fork();
+    TEST(clientPid >= 0);
+
+    if (clientPid == 0) {
+        const char * const partialRequest = "GET / HTTP/1.0\r\n";
+        char response[4096];
+        unsigned int i;
+        bool failed;
+
+        for (i = 0, failed = FALSE; i < 2 && !failed; ++i) {
+            int clientFd;
+
+            clientFd = socket(PF_INET, SOCK_STREAM, 0);
+            rc = connect(clientFd,
+                         (const struct sockaddr *)&addr, sizeof(addr));
+            if (rc == 0 && i == 0)
+                rc = send(clientFd, partialRequest,
+                          strlen(partialRequest), 0);
+            if (rc < 0)
+                failed = TRUE;
+            else {
+                /* Wait for the server to give up on us */
+                do
+                    rc = recv(clientFd, response, sizeof(response), 0);
+                while (rc > 0);
+            }
+            close(clientFd);
+        }
+        kill(getppid(), SIGUSR1);
+
+        _exit(failed ? 1 : 0);
+    }
+
+    ServerRun(&server);
+
+    rc = waitpid(clientPid, &status, 0);
+    TEST(rc == clientPid);
+    TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    ServerGetStats(&server, &stats);
+    TEST(stats.connAcceptedCt == 2);
+    TEST(stats.readTimeoutCt == 1);
+    TEST(stats.idleTimeoutCt == 1);
+    TEST(stats.writeTimeoutCt == 0);
+
+    sigaction(SIGUSR1, &oldSa, NULL);
+
+    ServerFree(&server);
+    ChanSwitchDestroy(chanSwitchP);
+    close(listenFd);
+}
+#endif
+
+
+
 static void
 testChanSwitch(void) {
 
@@ -229,6 +822,10 @@ testChanSwitch(void) {
     testChanSwitchSockAddr();
 
     testChanSwitchOsSocket();
+
+    testChanSwitchLocal();
+
+    testChanSwitchUring();
 #endif
 }
 
@@ -406,6 +1003,14 @@ test_abyss(void) {
 
     testServerCreate();
 
+#ifndef _WIN32
+    testServeFile();
+
+    testWorkerProcesses();
+
+    testConnTimeouts();
+#endif
+
     ChannelTerm();
     ChanSwitchTerm();
     AbyssTerm();
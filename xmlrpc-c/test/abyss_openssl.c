@@ -0,0 +1,340 @@
+/*=============================================================================
+                                 abyss_openssl
+===============================================================================
+  Test the OpenSSL channel switch of the Abyss web server.
+
+  This is in the test program only if the Abyss library has the OpenSSL
+  channel switch in it, i.e. you make with ENABLE_ABYSS_OPENSSL=yes.
+=============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+
+#include "xmlrpc_config.h"
+
+#include "bool.h"
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/abyss_opensslsock.h"
+
+#include "testtool.h"
+
+#include "abyss_openssl.h"
+
+
+
+static EVP_PKEY *
+makeKey(void) {
+
+    EVP_PKEY_CTX * const ctxP = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+
+    EVP_PKEY * keyP;
+
+    TEST(ctxP != NULL);
+
+    TEST(EVP_PKEY_keygen_init(ctxP) == 1);
+    TEST(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+             ctxP, NID_X9_62_prime256v1) == 1);
+
+    keyP = NULL;
+    TEST(EVP_PKEY_keygen(ctxP, &keyP) == 1);
+
+    EVP_PKEY_CTX_free(ctxP);
+
+    return keyP;
+}
+
+
+
+static X509 *
+makeCertificate(EVP_PKEY * const keyP) {
+/*----------------------------------------------------------------------------
+   A self-signed certificate for key *keyP.  Our client doesn't verify
+   it; the server just has to have one.
+-----------------------------------------------------------------------------*/
+    X509 * const certP = X509_new();
+
+    X509_NAME * nameP;
+
+    TEST(certP != NULL);
+
+    X509_set_version(certP, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(certP), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certP), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certP), 3600);
+    X509_set_pubkey(certP, keyP);
+
+    nameP = X509_get_subject_name(certP);
+    X509_NAME_add_entry_by_txt(nameP, "CN", MBSTRING_ASC,
+                               (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(certP, nameP);
+
+    TEST(X509_sign(certP, keyP, EVP_sha256()) > 0);
+
+    return certP;
+}
+
+
+
+static unsigned short
+unusedPort(void) {
+/*----------------------------------------------------------------------------
+   A TCP port number that nothing is using at the moment.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    int rc;
+
+    TEST(fd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = 0;
+
+    rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+
+    addrLen = sizeof(addr);
+    rc = getsockname(fd, (struct sockaddr *)&addr, &addrLen);
+    TEST(rc == 0);
+
+    close(fd);
+
+    return ntohs(addr.sin_port);
+}
+
+
+
+static void
+runSessionServer(TServer *     const serverP,
+                 TChanSwitch * const chanSwitchP,
+                 unsigned int  const connCt,
+                 unsigned int  const resumedCt) {
+/*----------------------------------------------------------------------------
+   Serve 'connCt' connections, one at a time, then exit with success
+   status if the switch's session statistics say all of them completed
+   the handshake and 'resumedCt' of them resumed an earlier session.
+
+   This runs in a child process; it never returns.
+-----------------------------------------------------------------------------*/
+    struct abyss_openssl_session_stats stats;
+    unsigned int i;
+
+    /* In case the test fails and the parent never connects: */
+    alarm(30);
+
+    for (i = 0; i < connCt; ++i)
+        ServerRunOnce(serverP);
+
+    ChanSwitchOpensslGetSessionStats(chanSwitchP, &stats);
+
+    _exit(stats.handshakes == connCt && stats.hits == resumedCt ? 0 : 1);
+}
+
+
+
+static void
+getPage(SSL_CTX *        const sslCtxP,
+        unsigned short   const port,
+        SSL_SESSION *    const sessionP,
+        SSL_SESSION **   const newSessionPP,
+        bool *           const resumedP) {
+/*----------------------------------------------------------------------------
+   Do an HTTP transaction over a new TLS connection to the server at
+   loopback port 'port'.  Offer to resume session *sessionP, unless
+   'sessionP' is NULL.
+
+   Return as *newSessionPP the session of the connection, with which we
+   might resume it later, and as *resumedP whether the server let us
+   resume *sessionP.
+-----------------------------------------------------------------------------*/
+    static char const request[] = "GET / HTTP/1.0\r\n\r\n";
+
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+    SSL * sslP;
+    char response[4096];
+    size_t responseLen;
+    int rc;
+
+    TEST(fd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(port);
+
+    rc = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+
+    sslP = SSL_new(sslCtxP);
+    TEST(sslP != NULL);
+
+    SSL_set_fd(sslP, fd);
+
+    if (sessionP)
+        SSL_set_session(sslP, sessionP);
+
+    TEST(SSL_connect(sslP) == 1);
+
+    TEST(SSL_write(sslP, request, strlen(request)) == (int)strlen(request));
+
+    /* We read to the end, which is also where a TLS 1.3 server's session
+       ticket is.
+    */
+    for (responseLen = 0, rc = 1; rc > 0; ) {
+        rc = SSL_read(sslP, &response[responseLen],
+                      sizeof(response) - 1 - responseLen);
+        if (rc > 0)
+            responseLen += rc;
+    }
+    response[responseLen] = '\0';
+
+    TEST(strncmp(response, "HTTP/1.", strlen("HTTP/1.")) == 0);
+
+    *resumedP     = SSL_session_reused(sslP);
+    *newSessionPP = SSL_get1_session(sslP);
+
+    TEST(*newSessionPP != NULL);
+
+    SSL_shutdown(sslP);
+    SSL_free(sslP);
+    close(fd);
+}
+
+
+
+static void
+testSessionResumption(unsigned int const cacheSize,
+                      bool         const tickets) {
+/*----------------------------------------------------------------------------
+   Connect to a server twice, the second time offering to resume the
+   session of the first, with the server keeping 'cacheSize' sessions
+   and issuing session tickets or not per 'tickets'.  It should let us
+   resume if it does either.
+-----------------------------------------------------------------------------*/
+    bool const mustResume = cacheSize > 0 || tickets;
+
+    EVP_PKEY * keyP;
+    X509 * certP;
+    SSL_CTX * serverCtxP;
+    SSL_CTX * clientCtxP;
+    struct abyss_openssl_session_parms sessParms;
+    unsigned short port;
+    TChanSwitch * chanSwitchP;
+    TServer server;
+    const char * error;
+    pid_t pid;
+    SSL_SESSION * firstSessionP;
+    SSL_SESSION * secondSessionP;
+    bool resumed;
+    int status;
+
+    keyP  = makeKey();
+    certP = makeCertificate(keyP);
+
+    serverCtxP = SSL_CTX_new(TLS_server_method());
+    TEST(serverCtxP != NULL);
+    TEST(SSL_CTX_use_certificate(serverCtxP, certP) == 1);
+    TEST(SSL_CTX_use_PrivateKey(serverCtxP, keyP) == 1);
+
+    sessParms.cacheSize = cacheSize;
+    sessParms.timeout   = 0;
+    sessParms.tickets   = tickets;
+
+    port = unusedPort();
+
+    ChanSwitchOpensslCreateCtx(port, serverCtxP, &sessParms,
+                               &chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    /* The switch listens before the server process exists, so our
+       connections don't race it.
+    */
+    ServerInit2(&server, &error);
+    TEST_NULL_STRING(error);
+
+    fflush(stdout);  /* Don't let the child inherit buffered output */
+
+    pid = fork();
+
+    TEST(pid >= 0);
+
+    if (pid == 0)
+        runSessionServer(&server, chanSwitchP, 2, mustResume ? 1 : 0);
+
+    ServerFree(&server);
+    ChanSwitchDestroy(chanSwitchP);
+
+    clientCtxP = SSL_CTX_new(TLS_client_method());
+    TEST(clientCtxP != NULL);
+
+    getPage(clientCtxP, port, NULL, &firstSessionP, &resumed);
+    TEST(!resumed);
+
+    getPage(clientCtxP, port, firstSessionP, &secondSessionP, &resumed);
+    TEST(resumed == mustResume);
+
+    waitpid(pid, &status, 0);
+    TEST(WIFEXITED(status));
+    TEST(WEXITSTATUS(status) == 0);
+
+    SSL_SESSION_free(secondSessionP);
+    SSL_SESSION_free(firstSessionP);
+    SSL_CTX_free(clientCtxP);
+    SSL_CTX_free(serverCtxP);
+    X509_free(certP);
+    EVP_PKEY_free(keyP);
+}
+
+
+
+void
+test_abyss_openssl(void) {
+
+    const char * error;
+
+    printf("Running Abyss OpenSSL tests...\n");
+
+    AbyssInit(&error);
+    TEST_NULL_STRING(error);
+
+    ChanSwitchInit(&error);
+    TEST_NULL_STRING(error);
+
+    ChannelInit(&error);
+    TEST_NULL_STRING(error);
+
+    testSessionResumption(100, false);  /* Resume from the session cache */
+
+    testSessionResumption(0, true);     /* Resume with a session ticket */
+
+    testSessionResumption(0, false);    /* Don't resume at all */
+
+    ChannelTerm();
+    ChanSwitchTerm();
+    AbyssTerm();
+
+    printf("\n");
+    printf("Abyss OpenSSL tests done.\n");
+}
@@ -0,0 +1,2 @@
+void
+test_abyss_openssl(void);
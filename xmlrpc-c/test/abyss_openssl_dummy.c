@@ -0,0 +1,14 @@
+#include <stdio.h>
+
+#include "abyss_openssl.h"
+
+
+
+void
+test_abyss_openssl(void) {
+
+    printf("Running dummy Abyss OpenSSL test.");
+
+    printf("\n");
+    printf("Abyss OpenSSL tests done.\n");
+}
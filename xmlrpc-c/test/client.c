@@ -2,13 +2,31 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
 
 #include "xmlrpc_config.h"
 #include "transport_config.h"
+#include "c_util.h"
 
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/sleep_int.h"
 #include "xmlrpc-c/client.h"
 #include "xmlrpc-c/transport.h"
+#ifndef _WIN32
+#include "xmlrpc-c/server.h"
+#include "xmlrpc-c/abyss.h"
+#include "xmlrpc-c/server_abyss.h"
+#endif
 
 #include "bool.h"
 #include "testtool.h"
@@ -145,6 +163,15 @@ testCreateCurlParms(void) {
     TEST_NO_FAULT(&env);
     xmlrpc_client_destroy(clientP);
 
+    curlTransportParms1.unix_socket_path  = "/tmp/xmlrpc.sock";
+
+    clientParms1.transportparm_size = XMLRPC_CXPSIZE(unix_socket_path);
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms1, XMLRPC_CPSIZE(transportparm_size),
+                         &clientP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_client_destroy(clientP);
+
     xmlrpc_env_clean(&env);
 #endif  /* MUST_BUILD_CURL_CLIENT */
 }
@@ -428,6 +455,750 @@ testInitCleanup(void) {
 
 
 
+static xmlrpc_response_handler countResponse;
+
+static void
+countResponse(const char *   const serverUrl,
+              const char *   const methodName,
+              xmlrpc_value * const paramArrayP ATTR_UNUSED,
+              void *         const userHandle,
+              xmlrpc_env *   const faultP,
+              xmlrpc_value * const resultP ATTR_UNUSED) {
+
+    unsigned int * const countP = userHandle;
+
+    TEST(serverUrl != NULL);
+    TEST(xmlrpc_streq(methodName, "nosuchmethod"));
+    TEST(faultP->fault_occurred);  /* Nobody listens on the port */
+
+    ++*countP;
+}
+
+
+
+static void
+testFanout(void) {
+
+    xmlrpc_env env;
+    xmlrpc_client * clientP;
+    xmlrpc_value * emptyArrayP;
+    xmlrpc_server_info * serverInfoP;
+    struct xmlrpc_fanout_call callArray[3];
+    unsigned int responseCt;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    emptyArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_create(&env, 0, "testprog", "1.0", NULL, 0, &clientP);
+    TEST_NO_FAULT(&env);
+
+    serverInfoP = xmlrpc_server_info_new(&env, "http://127.0.0.1:1/RPC2");
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < ARRAY_SIZE(callArray); ++i) {
+        callArray[i].serverInfoP = serverInfoP;
+        callArray[i].paramArrayP = emptyArrayP;
+    }
+
+    /* Wait for all */
+    responseCt = 0;
+    xmlrpc_client_fanout(&env, clientP, "nosuchmethod",
+                         callArray, ARRAY_SIZE(callArray), 0,
+                         &countResponse, &responseCt);
+    TEST_NO_FAULT(&env);
+    TEST(responseCt == ARRAY_SIZE(callArray));
+
+    /* Wait for one; the event loop completes the rest.  The refusals can
+       all come in one pass of the event loop, so we can't say how many we
+       have when we return; testFanoutServers() checks exact counts.
+    */
+    responseCt = 0;
+    xmlrpc_client_fanout(&env, clientP, "nosuchmethod",
+                         callArray, ARRAY_SIZE(callArray), 1,
+                         &countResponse, &responseCt);
+    TEST_NO_FAULT(&env);
+    TEST(responseCt >= 1);
+    xmlrpc_client_event_loop_finish(clientP);
+    TEST(responseCt == ARRAY_SIZE(callArray));
+
+    /* Nothing to do */
+    responseCt = 0;
+    xmlrpc_client_fanout(&env, clientP, "nosuchmethod",
+                         callArray, 0, 0,
+                         &countResponse, &responseCt);
+    TEST_NO_FAULT(&env);
+    TEST(responseCt == 0);
+
+    /* Fails because there aren't that many RPCs */
+    xmlrpc_client_fanout(&env, clientP, "nosuchmethod",
+                         callArray, ARRAY_SIZE(callArray), 4,
+                         &countResponse, &responseCt);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    TEST(responseCt == 0);
+
+    xmlrpc_server_info_free(serverInfoP);
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_DECREF(emptyArrayP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+#ifndef _WIN32
+
+struct multirpcOutcome {
+    unsigned int handlerCallCt;
+    bool         satisfied;
+    unsigned int arrivedCt;
+    bool         arrived[3];
+};
+
+
+
+static xmlrpc_multirpc_handler recordMultirpc;
+
+static void
+recordMultirpc(const char *                         const methodName,
+               xmlrpc_value *                       const paramArrayP,
+               void *                               const userHandle,
+               const struct xmlrpc_multirpc_reply * const replyArray,
+               unsigned int                         const serverCt,
+               xmlrpc_bool                          const satisfied) {
+
+    struct multirpcOutcome * const outcomeP = userHandle;
+
+    unsigned int i;
+
+    TEST(xmlrpc_streq(methodName, "nosuchmethod"));
+    TEST(paramArrayP != NULL);
+    TEST(serverCt <= ARRAY_SIZE(outcomeP->arrived));
+
+    ++outcomeP->handlerCallCt;
+    outcomeP->satisfied = satisfied;
+    outcomeP->arrivedCt = 0;
+
+    for (i = 0; i < serverCt; ++i) {
+        outcomeP->arrived[i] = replyArray[i].arrived;
+        if (replyArray[i].arrived) {
+            ++outcomeP->arrivedCt;
+            /* Nobody listens on the port */
+            TEST(replyArray[i].fault.fault_occurred);
+            TEST(replyArray[i].resultP == NULL);
+        }
+    }
+}
+
+
+
+static int
+makeSilentServer(unsigned short * const portP) {
+/*----------------------------------------------------------------------------
+   Make a socket that takes connections (they wait in its backlog) but
+   never answers anything.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    int rc;
+
+    TEST(fd >= 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port        = 0;
+
+    rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    TEST(rc == 0);
+    rc = listen(fd, 8);
+    TEST(rc == 0);
+
+    addrLen = sizeof(addr);
+    rc = getsockname(fd, (struct sockaddr *)&addr, &addrLen);
+    TEST(rc == 0);
+
+    *portP = ntohs(addr.sin_port);
+
+    return fd;
+}
+
+
+
+struct testServer {
+/*----------------------------------------------------------------------------
+   An XML-RPC server we run in a child process for a test.  Its method
+   test.whoami returns 'id', after 'delayMs' milliseconds.
+-----------------------------------------------------------------------------*/
+    int          id;
+    unsigned int delayMs;
+    pid_t        pid;
+    char         url[64];
+};
+
+
+
+static xmlrpc_value *
+whoAmI(xmlrpc_env *   const envP,
+       xmlrpc_value * const paramArrayP ATTR_UNUSED,
+       void *         const serverInfo) {
+
+    const struct testServer * const serverP = serverInfo;
+
+    xmlrpc_millisecond_sleep(serverP->delayMs);
+
+    return xmlrpc_int_new(envP, serverP->id);
+}
+
+
+
+static void
+runTestServer(struct testServer * const serverP,
+              int                 const listenFd) {
+/*----------------------------------------------------------------------------
+   Run the server *serverP on the listening socket 'listenFd' until
+   killed.  This runs in a child process; it never returns.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    TChanSwitch * chanSwitchP;
+    TServer server;
+    const char * error;
+
+    /* In case the test fails and the parent never gets around to killing
+       us:
+    */
+    alarm(30);
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+
+    xmlrpc_registry_add_method(&env, registryP, NULL, "test.whoami",
+                               &whoAmI, serverP);
+
+    ChanSwitchUnixCreateFd(listenFd, &chanSwitchP, &error);
+
+    if (error || env.fault_occurred)
+        _exit(1);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+
+    if (error)
+        _exit(1);
+
+    xmlrpc_server_abyss_set_handlers2(&server, "/RPC2", registryP);
+
+    ServerInit(&server);
+
+    ServerRun(&server);
+
+    _exit(0);
+}
+
+
+
+static void
+startTestServer(struct testServer * const serverP,
+                int                 const id,
+                unsigned int        const delayMs) {
+
+    unsigned short port;
+    int listenFd;
+
+    serverP->id      = id;
+    serverP->delayMs = delayMs;
+
+    /* The socket listens before the server process exists, so our RPCs
+       don't race the server's ServerInit().
+    */
+    listenFd = makeSilentServer(&port);
+
+    sprintf(serverP->url, "http://127.0.0.1:%u/RPC2", port);
+
+    fflush(stdout);  /* Don't let the child inherit buffered output */
+
+    serverP->pid = fork();
+
+    TEST(serverP->pid >= 0);
+
+    if (serverP->pid == 0)
+        runTestServer(serverP, listenFd);
+
+    close(listenFd);
+}
+
+
+
+static void
+stopTestServer(const struct testServer * const serverP) {
+
+    kill(serverP->pid, SIGKILL);
+    waitpid(serverP->pid, NULL, 0);
+}
+
+
+
+struct fanoutOutcome {
+    const struct testServer * serverArray;
+    unsigned int              serverCt;
+    unsigned int              responseCt;
+    int                       result[3];
+        /* The result from each server; -1 if it failed or hasn't
+           responded
+        */
+};
+
+
+
+static xmlrpc_response_handler recordResponse;
+
+static void
+recordResponse(const char *   const serverUrl,
+               const char *   const methodName,
+               xmlrpc_value * const paramArrayP ATTR_UNUSED,
+               void *         const userHandle,
+               xmlrpc_env *   const faultP,
+               xmlrpc_value * const resultP) {
+
+    struct fanoutOutcome * const outcomeP = userHandle;
+
+    unsigned int i;
+
+    TEST(xmlrpc_streq(methodName, "test.whoami"));
+
+    ++outcomeP->responseCt;
+
+    for (i = 0; i < outcomeP->serverCt; ++i) {
+        if (xmlrpc_streq(serverUrl, outcomeP->serverArray[i].url)) {
+            TEST(outcomeP->result[i] == -1);  /* Only one response */
+
+            if (!faultP->fault_occurred) {
+                xmlrpc_env env;
+
+                xmlrpc_env_init(&env);
+                xmlrpc_read_int(&env, resultP, &outcomeP->result[i]);
+                TEST_NO_FAULT(&env);
+                xmlrpc_env_clean(&env);
+            }
+        }
+    }
+}
+
+
+
+static void
+initFanoutOutcome(struct fanoutOutcome *    const outcomeP,
+                  const struct testServer * const serverArray,
+                  unsigned int              const serverCt) {
+
+    unsigned int i;
+
+    outcomeP->serverArray = serverArray;
+    outcomeP->serverCt    = serverCt;
+    outcomeP->responseCt  = 0;
+
+    for (i = 0; i < ARRAY_SIZE(outcomeP->result); ++i)
+        outcomeP->result[i] = -1;
+}
+
+
+
+static void
+testFanoutServers(void) {
+/*----------------------------------------------------------------------------
+   Fan an RPC out to three real servers, each of which answers with its
+   own identity.  The last one is slow.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_client * clientP;
+    xmlrpc_value * emptyArrayP;
+    struct testServer serverArray[3];
+    xmlrpc_server_info * serverInfoP[3];
+    struct xmlrpc_fanout_call callArray[3];
+    struct fanoutOutcome outcome;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    emptyArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_create(&env, 0, "testprog", "1.0", NULL, 0, &clientP);
+    TEST_NO_FAULT(&env);
+
+    startTestServer(&serverArray[0], 10, 0);
+    startTestServer(&serverArray[1], 11, 0);
+    startTestServer(&serverArray[2], 12, 1500);
+
+    for (i = 0; i < ARRAY_SIZE(callArray); ++i) {
+        serverInfoP[i] = xmlrpc_server_info_new(&env, serverArray[i].url);
+        TEST_NO_FAULT(&env);
+
+        callArray[i].serverInfoP = serverInfoP[i];
+        callArray[i].paramArrayP = emptyArrayP;
+    }
+
+    /* Wait for all */
+    initFanoutOutcome(&outcome, serverArray, ARRAY_SIZE(serverArray));
+    xmlrpc_client_fanout(&env, clientP, "test.whoami",
+                         callArray, ARRAY_SIZE(callArray), 0,
+                         &recordResponse, &outcome);
+    TEST_NO_FAULT(&env);
+    TEST(outcome.responseCt == 3);
+    TEST(outcome.result[0] == 10);
+    TEST(outcome.result[1] == 11);
+    TEST(outcome.result[2] == 12);
+
+    /* Wait for two; the slow server hasn't answered when we return */
+    initFanoutOutcome(&outcome, serverArray, ARRAY_SIZE(serverArray));
+    xmlrpc_client_fanout(&env, clientP, "test.whoami",
+                         callArray, ARRAY_SIZE(callArray), 2,
+                         &recordResponse, &outcome);
+    TEST_NO_FAULT(&env);
+    TEST(outcome.responseCt == 2);
+    TEST(outcome.result[0] == 10);
+    TEST(outcome.result[1] == 11);
+    TEST(outcome.result[2] == -1);
+
+    xmlrpc_client_event_loop_finish(clientP);
+    TEST(outcome.responseCt == 3);
+    TEST(outcome.result[2] == 12);
+
+    for (i = 0; i < ARRAY_SIZE(serverArray); ++i) {
+        xmlrpc_server_info_free(serverInfoP[i]);
+        stopTestServer(&serverArray[i]);
+    }
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_DECREF(emptyArrayP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testMultirpc(void) {
+
+    xmlrpc_env env;
+    xmlrpc_client * clientP;
+    xmlrpc_value * emptyArrayP;
+    xmlrpc_server_info * refusedServerP;
+    xmlrpc_server_info * silentServerP;
+    const xmlrpc_server_info * serverInfoArray[3];
+    struct xmlrpc_multirpc_policy policy;
+    struct multirpcOutcome outcome;
+    unsigned short silentPort;
+    int silentFd;
+    char silentUrl[64];
+    time_t startTime;
+
+    xmlrpc_env_init(&env);
+
+    emptyArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_create(&env, 0, "testprog", "1.0", NULL, 0, &clientP);
+    TEST_NO_FAULT(&env);
+
+    refusedServerP = xmlrpc_server_info_new(&env, "http://127.0.0.1:1/RPC2");
+    TEST_NO_FAULT(&env);
+
+    silentFd = makeSilentServer(&silentPort);
+    sprintf(silentUrl, "http://127.0.0.1:%u/RPC2", silentPort);
+    silentServerP = xmlrpc_server_info_new(&env, silentUrl);
+    TEST_NO_FAULT(&env);
+
+    /* Every RPC fails, so the first success never comes */
+    serverInfoArray[0] = refusedServerP;
+    serverInfoArray[1] = refusedServerP;
+    serverInfoArray[2] = refusedServerP;
+    policy.completion = xmlrpc_multirpc_first;
+    policy.timeout    = 0;
+    memset(&outcome, 0, sizeof(outcome));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 3, "nosuchmethod",
+                           emptyArrayP, &policy, &recordMultirpc, &outcome);
+    TEST_NO_FAULT(&env);
+    TEST(outcome.handlerCallCt == 1);
+    TEST(!outcome.satisfied);
+    TEST(outcome.arrivedCt == 3);
+
+    /* The deadline passes with no replies; we cancel the RPCs rather than
+       wait for the server, which never answers.
+    */
+    serverInfoArray[0] = silentServerP;
+    serverInfoArray[1] = silentServerP;
+    policy.completion = xmlrpc_multirpc_all;
+    policy.timeout    = 300;
+    memset(&outcome, 0, sizeof(outcome));
+    startTime = time(NULL);
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 2, "nosuchmethod",
+                           emptyArrayP, &policy, &recordMultirpc, &outcome);
+    TEST_NO_FAULT(&env);
+    TEST(outcome.handlerCallCt == 1);
+    TEST(!outcome.satisfied);
+    TEST(outcome.arrivedCt == 0);
+    TEST(time(NULL) - startTime < 10);
+
+    /* Once one of two fails, a majority can't succeed, so we don't wait
+       for the other.
+    */
+    serverInfoArray[0] = refusedServerP;
+    serverInfoArray[1] = silentServerP;
+    policy.completion = xmlrpc_multirpc_majority;
+    policy.timeout    = 0;
+    memset(&outcome, 0, sizeof(outcome));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 2, "nosuchmethod",
+                           emptyArrayP, &policy, &recordMultirpc, &outcome);
+    TEST_NO_FAULT(&env);
+    TEST(outcome.handlerCallCt == 1);
+    TEST(!outcome.satisfied);
+    TEST(outcome.arrived[0]);
+    TEST(!outcome.arrived[1]);
+
+    /* Fails because 2 servers can't make a quorum of 3 */
+    policy.completion = xmlrpc_multirpc_quorum;
+    policy.quorum     = 3;
+    memset(&outcome, 0, sizeof(outcome));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 2, "nosuchmethod",
+                           emptyArrayP, &policy, &recordMultirpc, &outcome);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    TEST(outcome.handlerCallCt == 0);
+
+    /* Fails because a quorum of none is meaningless */
+    policy.quorum = 0;
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 2, "nosuchmethod",
+                           emptyArrayP, &policy, &recordMultirpc, &outcome);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    TEST(outcome.handlerCallCt == 0);
+
+    /* Complete the RPCs we cancelled */
+    xmlrpc_client_event_loop_finish(clientP);
+
+    xmlrpc_server_info_free(silentServerP);
+    close(silentFd);
+    xmlrpc_server_info_free(refusedServerP);
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_DECREF(emptyArrayP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+struct multirpcResults {
+    unsigned int handlerCallCt;
+    bool         satisfied;
+    int          result[3];
+        /* The result from each server; -1 if it failed or didn't arrive */
+};
+
+
+
+static xmlrpc_multirpc_handler recordMultirpcResults;
+
+static void
+recordMultirpcResults(
+    const char *                         const methodName,
+    xmlrpc_value *                       const paramArrayP ATTR_UNUSED,
+    void *                               const userHandle,
+    const struct xmlrpc_multirpc_reply * const replyArray,
+    unsigned int                         const serverCt,
+    xmlrpc_bool                          const satisfied) {
+
+    struct multirpcResults * const resultsP = userHandle;
+
+    unsigned int i;
+
+    TEST(xmlrpc_streq(methodName, "test.whoami"));
+    TEST(serverCt <= ARRAY_SIZE(resultsP->result));
+
+    ++resultsP->handlerCallCt;
+    resultsP->satisfied = satisfied;
+
+    for (i = 0; i < serverCt; ++i) {
+        resultsP->result[i] = -1;
+
+        if (replyArray[i].arrived && !replyArray[i].fault.fault_occurred) {
+            xmlrpc_env env;
+
+            xmlrpc_env_init(&env);
+            xmlrpc_read_int(&env, replyArray[i].resultP,
+                            &resultsP->result[i]);
+            TEST_NO_FAULT(&env);
+            xmlrpc_env_clean(&env);
+        }
+    }
+}
+
+
+
+static void
+testMultirpcServers(void) {
+/*----------------------------------------------------------------------------
+   Do multirpcs on real servers, each of which answers with its own
+   identity.  One is so slow that we must give up on it, and return,
+   long before it answers.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_client * clientP;
+    xmlrpc_value * emptyArrayP;
+    struct testServer fast1, fast2, slow;
+    xmlrpc_server_info * fast1InfoP;
+    xmlrpc_server_info * fast2InfoP;
+    xmlrpc_server_info * slowInfoP;
+    const xmlrpc_server_info * serverInfoArray[3];
+    struct xmlrpc_multirpc_policy policy;
+    struct multirpcResults results;
+    time_t startTime;
+
+    xmlrpc_env_init(&env);
+
+    emptyArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_create(&env, 0, "testprog", "1.0", NULL, 0, &clientP);
+    TEST_NO_FAULT(&env);
+
+    startTestServer(&fast1, 20, 0);
+    startTestServer(&fast2, 21, 0);
+    startTestServer(&slow,  22, 10000);
+
+    fast1InfoP = xmlrpc_server_info_new(&env, fast1.url);
+    TEST_NO_FAULT(&env);
+    fast2InfoP = xmlrpc_server_info_new(&env, fast2.url);
+    TEST_NO_FAULT(&env);
+    slowInfoP = xmlrpc_server_info_new(&env, slow.url);
+    TEST_NO_FAULT(&env);
+
+    startTime = time(NULL);
+
+    /* The first success satisfies us */
+    serverInfoArray[0] = slowInfoP;
+    serverInfoArray[1] = fast1InfoP;
+    serverInfoArray[2] = slowInfoP;
+    policy.completion = xmlrpc_multirpc_first;
+    policy.timeout    = 0;
+    memset(&results, 0, sizeof(results));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 3, "test.whoami",
+                           emptyArrayP, &policy, &recordMultirpcResults,
+                           &results);
+    TEST_NO_FAULT(&env);
+    TEST(results.handlerCallCt == 1);
+    TEST(results.satisfied);
+    TEST(results.result[0] == -1);
+    TEST(results.result[1] == 20);
+    TEST(results.result[2] == -1);
+
+    /* Two of three is a majority */
+    serverInfoArray[0] = fast1InfoP;
+    serverInfoArray[1] = slowInfoP;
+    serverInfoArray[2] = fast2InfoP;
+    policy.completion = xmlrpc_multirpc_majority;
+    memset(&results, 0, sizeof(results));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 3, "test.whoami",
+                           emptyArrayP, &policy, &recordMultirpcResults,
+                           &results);
+    TEST_NO_FAULT(&env);
+    TEST(results.handlerCallCt == 1);
+    TEST(results.satisfied);
+    TEST(results.result[0] == 20);
+    TEST(results.result[1] == -1);
+    TEST(results.result[2] == 21);
+
+    /* A quorum of two */
+    serverInfoArray[0] = slowInfoP;
+    serverInfoArray[1] = fast2InfoP;
+    serverInfoArray[2] = fast1InfoP;
+    policy.completion = xmlrpc_multirpc_quorum;
+    policy.quorum     = 2;
+    memset(&results, 0, sizeof(results));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 3, "test.whoami",
+                           emptyArrayP, &policy, &recordMultirpcResults,
+                           &results);
+    TEST_NO_FAULT(&env);
+    TEST(results.handlerCallCt == 1);
+    TEST(results.satisfied);
+    TEST(results.result[0] == -1);
+    TEST(results.result[1] == 21);
+    TEST(results.result[2] == 20);
+
+    /* We returned from each without waiting for the slow server */
+    TEST(time(NULL) - startTime < 5);
+
+    /* All of them */
+    serverInfoArray[0] = fast2InfoP;
+    serverInfoArray[1] = fast1InfoP;
+    policy.completion = xmlrpc_multirpc_all;
+    memset(&results, 0, sizeof(results));
+    xmlrpc_client_multirpc(&env, clientP, serverInfoArray, 2, "test.whoami",
+                           emptyArrayP, &policy, &recordMultirpcResults,
+                           &results);
+    TEST_NO_FAULT(&env);
+    TEST(results.handlerCallCt == 1);
+    TEST(results.satisfied);
+    TEST(results.result[0] == 21);
+    TEST(results.result[1] == 20);
+
+    /* The RPCs we gave up on are still outstanding.  Completing them
+       destroys what's left of their multirpcs; the handlers don't run
+       again.
+    */
+    xmlrpc_client_event_loop_finish(clientP);
+
+    stopTestServer(&slow);
+
+    TEST(results.handlerCallCt == 1);
+
+    xmlrpc_server_info_free(slowInfoP);
+    xmlrpc_server_info_free(fast2InfoP);
+    xmlrpc_server_info_free(fast1InfoP);
+
+    stopTestServer(&fast2);
+    stopTestServer(&fast1);
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_DECREF(emptyArrayP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+}
+
+#endif  /* _WIN32 */
+
+
+
 static void
 testServerInfo(void) {
 
@@ -501,6 +1272,12 @@ test_client(void) {
     printf("\n");
     testServerInfo();
     testSynchCall();
+    testFanout();
+#ifndef _WIN32
+    testFanoutServers();
+    testMultirpc();
+    testMultirpcServers();
+#endif
 
     printf("\n");
     printf("Client tests done.\n");
@@ -261,6 +261,35 @@ public:
 
 
 
+class sampleAddAsyncMethod : public asyncMethod {
+/*----------------------------------------------------------------------------
+   An asynchronous method that completes the call before execute()
+   returns.  The C tests cover completion from another thread.
+-----------------------------------------------------------------------------*/
+public:
+    sampleAddAsyncMethod() {
+        this->_signature = "i:ii";
+        this->_help = "This method adds two integers together";
+    }
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            const callInfo *    const,
+            completion          const& completion) {
+        
+        int const addend(paramList.getInt(0));
+        int const adder(paramList.getInt(1));
+        
+        paramList.verifyEnd(2);
+        
+        if (addend + adder == 0)
+            completion.fail(fault("zero", fault::CODE_UNSPECIFIED));
+        else
+            completion.complete(value_int(addend + adder));
+    }
+};
+
+
+
 class testCallInfoMethod : public method2 {
 public:
     testCallInfoMethod() {
@@ -437,6 +466,207 @@ public:
 
 
 
+class throwingMethod : public method {
+public:
+    void
+    execute(xmlrpc_c::paramList const&,
+            value *             const) {
+
+        throwf("method broke");
+    }
+};
+
+
+
+class resultlessMethod : public method {
+public:
+    void
+    execute(xmlrpc_c::paramList const&,
+            value *             const) {}
+};
+
+
+
+class inFlightMethod : public method {
+/*----------------------------------------------------------------------------
+   A method that notes how many calls of it the registry's statistics say
+   are executing while it executes.
+-----------------------------------------------------------------------------*/
+public:
+    inFlightMethod(registry const& myRegistry) :
+        registryP(&myRegistry), inFlightCt(0) {}
+
+    void
+    execute(xmlrpc_c::paramList const&,
+            value *             const  retvalP) {
+
+        this->inFlightCt =
+            this->registryP->methodStats("test.inflight").inFlightCt;
+
+        *retvalP = value_int(0);
+    }
+
+    registry const * const registryP;
+    unsigned int inFlightCt;
+};
+
+
+
+static string
+callXmlFor(string const& methodName) {
+
+    return
+        xmlPrologue +
+        "<methodCall>\r\n"
+        "<methodName>" + methodName + "</methodName>\r\n"
+        "<params>\r\n"
+        "</params>\r\n"
+        "</methodCall>\r\n";
+}
+
+
+
+class nativeDispatchTestSuite : public testSuite {
+/*----------------------------------------------------------------------------
+   Test that calls the registry executes itself come out the same as
+   those it leaves to the C registry.
+-----------------------------------------------------------------------------*/
+public:
+    virtual string suiteName() {
+        return "nativeDispatchTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+        myRegistry.addMethod("test.throw", methodPtr(new throwingMethod));
+        myRegistry.addMethod("test.noresult", methodPtr(new resultlessMethod));
+
+        EXPECT_ERROR(  // duplicate name
+            myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+            );
+        EXPECT_ERROR(  // name of a system method
+            myRegistry.addMethod("system.listMethods",
+                                 methodPtr(new sampleAddMethod));
+            );
+
+        string nativeResponse[4];
+
+        myRegistry.processCall(sampleAddGoodCallXml, &nativeResponse[0]);
+        myRegistry.processCall(sampleAddBadCallXml,  &nativeResponse[1]);
+        myRegistry.processCall(callXmlFor("test.throw"), &nativeResponse[2]);
+        myRegistry.processCall(callXmlFor("test.noresult"),
+                               &nativeResponse[3]);
+
+        TEST(nativeResponse[0] == sampleAddGoodResponseXml);
+        TEST(nativeResponse[1] == sampleAddBadResponseXml);
+        TEST(nativeResponse[2].find("method broke") != string::npos);
+        TEST(nativeResponse[2].find("<fault>") != string::npos);
+        TEST(nativeResponse[3].find("failed to set the RPC result") !=
+             string::npos);
+
+        // A limit on all calls makes the C registry execute them
+        myRegistry.setMaxConcurrent(10);
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == nativeResponse[0]);
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response == nativeResponse[1]);
+            myRegistry.processCall(callXmlFor("test.throw"), &response);
+            TEST(response == nativeResponse[2]);
+            myRegistry.processCall(callXmlFor("test.noresult"), &response);
+            TEST(response == nativeResponse[3]);
+        }
+        myRegistry.setMaxConcurrent(0);
+
+        struct xmlrpc_method_stats const stats(
+            myRegistry.methodStats("sample.add"));
+
+        TEST(stats.callCt == 4);
+        TEST(stats.faultCt == 2);
+        TEST(stats.inFlightCt == 0);
+        TEST(stats.parse.count == 4);
+        TEST(stats.serialize.count == 4);
+
+        // A call we execute ourselves counts as in flight while it executes
+        inFlightMethod * const inFlightP(new inFlightMethod(myRegistry));
+        myRegistry.addMethod("test.inflight", methodPtr(inFlightP));
+        {
+            string response;
+            myRegistry.processCall(callXmlFor("test.inflight"), &response);
+            TEST(inFlightP->inFlightCt == 1);
+            TEST(myRegistry.methodStats("test.inflight").inFlightCt == 0);
+            TEST(myRegistry.methodStats("test.inflight").callCt == 1);
+        }
+        testEmptyXmlDocCall(myRegistry);
+    }
+};
+
+
+
+class callCtlTestSuite : public testSuite {
+/*----------------------------------------------------------------------------
+   Test that a cancelled call doesn't execute, whoever would execute it.
+-----------------------------------------------------------------------------*/
+public:
+    virtual string suiteName() {
+        return "callCtlTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+        string response;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        callInfo const noCtlInfo;
+
+        TEST(!noCtlInfo.cancelled());
+        TEST(!noCtlInfo.hasDeadline());
+        EXPECT_ERROR(noCtlInfo.timeLeft(););
+
+        xmlrpc_call_ctl ctl;
+
+        xmlrpc_call_ctl_init(&ctl, 60000);
+
+        callInfo const ctlInfo(&ctl);
+
+        TEST(!ctlInfo.cancelled());
+        TEST(ctlInfo.hasDeadline());
+        TEST(ctlInfo.timeLeft() > 0.0 && ctlInfo.timeLeft() <= 60.0);
+
+        myRegistry.processCall(sampleAddGoodCallXml, &ctlInfo, &response);
+        TEST(response == sampleAddGoodResponseXml);
+
+        xmlrpc_call_cancel(&ctl);
+        TEST(ctlInfo.cancelled());
+
+        myRegistry.processCall(sampleAddGoodCallXml, &ctlInfo, &response);
+        TEST(response.find("<fault>") != string::npos);
+        TEST(response.find("cancelled") != string::npos);
+
+        // Same from the C registry
+        myRegistry.setMaxConcurrent(10);
+        {
+            string cResponse;
+            myRegistry.processCall(sampleAddGoodCallXml, &ctlInfo,
+                                   &cResponse);
+            TEST(cResponse == response);
+        }
+        myRegistry.setMaxConcurrent(0);
+
+        struct xmlrpc_method_stats const stats(
+            myRegistry.methodStats("sample.add"));
+
+        TEST(stats.callCt == 3);
+        TEST(stats.faultCt == 2);
+    }
+};
+
+
+
 class dialectTestSuite : public testSuite {
 
 public:
@@ -471,6 +701,316 @@ public:
 
 
 
+class methodLimitsTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "methodLimitsTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+        string response;
+        struct xmlrpc_method_limits limits;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        limits.maxConcurrent  = 1;
+        limits.maxQueued      = 0;
+        limits.queueTimeoutMs = 0;
+        limits.priority       = xmlrpc_priority_high;
+
+        myRegistry.setMethodLimits("sample.add", limits);
+
+        myRegistry.setMaxConcurrent(10);
+
+        myRegistry.processCall(sampleAddGoodCallXml, &response);
+        TEST(response == sampleAddGoodResponseXml);
+
+        struct xmlrpc_method_queue_stats const stats(
+            myRegistry.methodQueueStats("sample.add"));
+
+        TEST(stats.runningCt == 0);
+        TEST(stats.admittedCt == 1);
+        TEST(stats.rejectedCt == 0);
+
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.setMethodLimits("nosuch", limits);
+            );
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.methodQueueStats("nosuch");
+            );
+    }
+};
+
+
+
+string const sampleAddMulticallXml(
+    xmlPrologue +
+    "<methodCall>\r\n"
+    "<methodName>system.multicall</methodName>\r\n"
+    "<params>\r\n"
+    "<param><value><array><data>\r\n"
+    "<value><struct>"
+    "<member><name>methodName</name><value>sample.add</value></member>"
+    "<member><name>params</name><value><array><data>"
+    "<value><i4>5</i4></value><value><i4>7</i4></value>"
+    "</data></array></value></member>"
+    "</struct></value>\r\n"
+    "<value><struct>"
+    "<member><name>methodName</name><value>sample.add</value></member>"
+    "<member><name>params</name><value><array><data>"
+    "<value><i4>5</i4></value>"
+    "</data></array></value></member>"
+    "</struct></value>\r\n"
+    "<value><struct>"
+    "<member><name>methodName</name><value>sample.add</value></member>"
+    "<member><name>params</name><value><array><data>"
+    "<value><i4>1</i4></value><value><i4>2</i4></value>"
+    "</data></array></value></member>"
+    "</struct></value>\r\n"
+    "</data></array></value></param>\r\n"
+    "</params>\r\n"
+    "</methodCall>\r\n"
+    );
+
+
+
+class parallelMulticallTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "parallelMulticallTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+        string sequentialResponse;
+        string parallelResponse;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        myRegistry.processCall(sampleAddMulticallXml, &sequentialResponse);
+
+        myRegistry.setMethodParallelSafe("sample.add", true);
+        myRegistry.setParallelMulticall(4, 2);
+
+        myRegistry.processCall(sampleAddMulticallXml, &parallelResponse);
+        TEST(parallelResponse == sequentialResponse);
+
+        myRegistry.setParallelMulticall(0, 0);
+
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.setMethodParallelSafe("nosuch", true);
+            );
+
+        myRegistry.setMethodCoalescing("sample.add", true);
+
+        myRegistry.processCall(sampleAddMulticallXml, &parallelResponse);
+        TEST(parallelResponse == sequentialResponse);
+
+        myRegistry.setMethodCoalescing("sample.add", false);
+
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.setMethodCoalescing("nosuch", true);
+            );
+    }
+};
+
+
+
+class methodCacheTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "methodCacheTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+        struct xmlrpc_method_cache_parms parms;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        parms.ttlMs      = 0;
+        parms.maxEntries = 10;
+        parms.maxBytes   = 0;
+
+        myRegistry.setMethodCache("sample.add", parms);
+
+        for (unsigned int i = 0; i < 2; ++i) {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        for (unsigned int i = 0; i < 2; ++i) {
+            string response;
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response == sampleAddBadResponseXml);
+        }
+        struct xmlrpc_method_cache_stats const stats(
+            myRegistry.methodCacheStats("sample.add"));
+
+        TEST(stats.hitCt == 1);
+        TEST(stats.missCt == 3);
+        TEST(stats.entryCt == 1);
+
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.setMethodCache("nosuch", parms);
+            );
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.methodCacheStats("nosuch");
+            );
+    }
+};
+
+
+
+class methodStatsTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "methodStatsTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        {
+            string response;
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response == sampleAddBadResponseXml);
+        }
+        struct xmlrpc_method_stats const stats(
+            myRegistry.methodStats("sample.add"));
+
+        TEST(stats.callCt == 2);
+        TEST(stats.faultCt == 1);
+        TEST(stats.inFlightCt == 0);
+        TEST(stats.parse.count == 2);
+        TEST(stats.execute.count == 2);
+        TEST(stats.serialize.count == 2);
+
+        {
+            string response;
+            myRegistry.processCall(
+                xmlPrologue +
+                "<methodCall>\r\n"
+                "<methodName>system.stats</methodName>\r\n"
+                "<params>\r\n"
+                "<param><value><string>sample.add</string></value></param>\r\n"
+                "</params>\r\n"
+                "</methodCall>\r\n",
+                &response);
+            TEST(response.find("<name>calls</name>") != string::npos);
+            TEST(response.find("<name>p99</name>") != string::npos);
+        }
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.methodStats("nosuch");
+            );
+    }
+};
+
+
+
+class signatureCheckTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "signatureCheckTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        myRegistry.setMethodCheckSignature("sample.add", true);
+
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        {
+            string response;
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response.find("takes 2 parameters") != string::npos);
+        }
+        EXPECT_ERROR(  // nonexistent method
+            myRegistry.setMethodCheckSignature("nosuch", true);
+            );
+    }
+};
+
+
+
+class asyncMethodTestSuite : public testSuite {
+
+public:
+    virtual string suiteName() {
+        return "asyncMethodTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        xmlrpc_c::registry myRegistry;
+        
+        myRegistry.addMethod("sample.add", 
+                             xmlrpc_c::methodPtr(new sampleAddAsyncMethod));
+        {
+            string response;
+            myRegistry.processCall(sampleAddGoodCallXml, &response);
+            TEST(response == sampleAddGoodResponseXml);
+        }
+        {
+            string response;
+            myRegistry.processCall(sampleAddBadCallXml, &response);
+            TEST(response == sampleAddBadResponseXml);
+        }
+        {
+            string response;
+            myRegistry.processCall(sampleAddMulticallXml, &response);
+            TEST(response.find("<i4>12</i4>") != string::npos);
+            TEST(response.find("<i4>3</i4>") != string::npos);
+            TEST(response.find("faultCode") != string::npos);
+        }
+        {
+            string const zeroCallXml(
+                xmlPrologue +
+                "<methodCall>\r\n"
+                "<methodName>sample.add</methodName>\r\n"
+                "<params>\r\n"
+                "<param><value><i4>0</i4></value></param>\r\n"
+                "<param><value><i4>0</i4></value></param>\r\n"
+                "</params>\r\n"
+                "</methodCall>\r\n"
+                );
+            string response;
+            myRegistry.processCall(zeroCallXml, &response);
+            TEST(response.find("faultString") != string::npos);
+            TEST(response.find("zero") != string::npos);
+        }
+        {
+            asyncMethod * const methodP(new sampleAddAsyncMethod);
+            methodPtr const methodHolder(methodP);
+            value result;
+
+            EXPECT_ERROR(  // can't call it synchronously
+                methodP->execute(paramList(), &result);
+                );
+        }
+    }
+};
+
+
+
 class testShutdown : public xmlrpc_c::registry::shutdown {
 /*----------------------------------------------------------------------------
    This class is logically local to
@@ -531,12 +1071,28 @@ registryTestSuite::runtests(unsigned int const indentation) {
 
     method2TestSuite().run(indentation+1);
 
+    nativeDispatchTestSuite().run(indentation+1);
+
+    callCtlTestSuite().run(indentation+1);
+
     registry myRegistry;
 
     myRegistry.disableIntrospection();
 
     dialectTestSuite().run(indentation+1);
 
+    methodLimitsTestSuite().run(indentation+1);
+
+    parallelMulticallTestSuite().run(indentation+1);
+
+    methodCacheTestSuite().run(indentation+1);
+
+    methodStatsTestSuite().run(indentation+1);
+
+    signatureCheckTestSuite().run(indentation+1);
+
+    asyncMethodTestSuite().run(indentation+1);
+
     registryShutdownTestSuite().run(indentation+1);
 
     TEST(myRegistry.maxStackSize() >= 256);
@@ -260,6 +260,13 @@ public:
                                     .sockAddrLen(sizeof(sockAddr)));
             );
         
+        EXPECT_ERROR(  // Both portNumber and unixSocketPath
+            serverAbyss abyssServer(serverAbyss::constrOpt()
+                                    .registryP(&myRegistry)
+                                    .portNumber(8080)
+                                    .unixSocketPath("/tmp/xmlrpc.sock"));
+            );
+        
         EXPECT_ERROR(  // sockAddrP but no sockAddrLen
             serverAbyss abyssServer(serverAbyss::constrOpt()
                                     .registryP(&myRegistry)
@@ -309,6 +316,21 @@ public:
                                     .sockAddrLen(sizeof(sockAddr))
                 );
         }
+#ifndef WIN32
+        {
+            serverAbyss abyssServer(serverAbyss::constrOpt()
+                                    .registryPtr(myRegistryP)
+                                    .unixSocketPath("/tmp/xmlrpc_test.sock")
+                );
+        }
+        {
+            serverAbyss abyssServer(serverAbyss::constrOpt()
+                                    .registryPtr(myRegistryP)
+                                    .portNumber(12345)
+                                    .useIoUring(true)
+                );
+        }
+#endif
         {
             // Test all the options
             serverAbyss abyssServer(serverAbyss::constrOpt()
@@ -327,6 +349,7 @@ public:
                                     .logFileName("/tmp/logfile")
                                     .serverOwnsSignals(false)
                                     .expectSigchld(true)
+                                    .workerProcesses(2)
                 );
     
         }
@@ -12,6 +12,7 @@
   #include <io.h>
 #else
   #include <unistd.h>
+  #include <signal.h>
   #include <sys/socket.h>
   #include <arpa/inet.h>
   #include <netinet/in.h>
@@ -144,6 +145,51 @@ public:
     }
 };
 
+class parkMethod : public asyncMethod {
+/*----------------------------------------------------------------------------
+   An asynchronous method that leaves the call for the test to complete
+   through 'completionP'.
+-----------------------------------------------------------------------------*/
+public:
+    parkMethod() : completionP(NULL) {}
+
+    ~parkMethod() {
+        delete(this->completionP);
+    }
+
+    void
+    execute(xmlrpc_c::paramList const& paramList,
+            const callInfo *    const,
+            completion          const& completion) {
+
+        paramList.verifyEnd(0);
+
+        delete(this->completionP);
+        this->completionP = new xmlrpc_c::completion(completion);
+    }
+
+    xmlrpc_c::completion * completionP;
+        // How to complete the parked call; NULL if none has been parked
+};
+
+string const parkCallXml(
+    xmlPrologue +
+    "<methodCall>\r\n"
+    "<methodName>test.park</methodName>\r\n"
+    "<params>\r\n"
+    "</params>\r\n"
+    "</methodCall>\r\n"
+    );
+
+string const parkResponseXml(
+    xmlPrologue +
+    "<methodResponse>\r\n"
+    "<params>\r\n"
+    "<param><value><i4>3</i4></value></param>\r\n"
+    "</params>\r\n"
+    "</methodResponse>\r\n"
+    );
+
 string const testCallInfoCallXml(
     xmlPrologue +
     "<methodCall>\r\n"
@@ -223,6 +269,9 @@ public:
     void
     hangup();
 
+    void
+    disconnect();
+
     void
     recvResp(string * const respBytesP) const;
 
@@ -313,6 +362,16 @@ client::hangup() {
 
 
 
+void
+client::disconnect() {
+
+    // Unlike hangup(), this leaves the server unable to send a response.
+
+    shutdown(this->clientFd, 2);  // Shutdown for transmission and reception
+}
+
+
+
 void
 client::recvResp(string * const packetBytesP) const {
 
@@ -568,6 +627,118 @@ testNoWaitCall(registry const& myRegistry) {
 
 
 
+static void
+testWriteFailure(registry const& myRegistry) {
+/*----------------------------------------------------------------------------
+   Here the client goes away before the server can respond to a call of
+   a synchronous method with runOnceNoWait().  The server should fail
+   that runOnceNoWait(), not the next one.
+-----------------------------------------------------------------------------*/
+    string const sampleAddCallStream(
+        packetStart + sampleAddCallXml + packetEnd);
+
+#if !MSVCRT
+    // Writing to the severed socket must fail, not kill us
+    struct sigaction ignoreAction;
+    struct sigaction oldPipeAction;
+
+    sigemptyset(&ignoreAction.sa_mask);
+    ignoreAction.sa_flags   = 0;
+    ignoreAction.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignoreAction, &oldPipeAction);
+#endif
+
+    client client;
+
+    serverPstreamConn server(serverPstreamConn::constrOpt()
+                             .registryP(&myRegistry)
+                             .socketFd(client.serverFd));
+
+    bool eof;
+    bool gotOne;
+
+    client.sendCall(sampleAddCallStream);
+    client.disconnect();
+
+    EXPECT_ERROR(
+        server.runOnceNoWait(&eof, &gotOne);
+        );
+
+    server.runOnceNoWait(&eof, &gotOne);  // The failure is already reported
+    TEST(eof);
+    TEST(!gotOne);
+
+#if !MSVCRT
+    sigaction(SIGPIPE, &oldPipeAction, NULL);
+#endif
+}
+
+
+
+static void
+testAsyncCall(registry   const& myRegistry,
+              parkMethod * const parkMethodP) {
+/*----------------------------------------------------------------------------
+   Here we call an asynchronous method with runOnceNoWait().  The server
+   should return while the call is pending, read no further calls until
+   the method completes it, then send the response.
+-----------------------------------------------------------------------------*/
+    string const parkCallStream(packetStart + parkCallXml + packetEnd);
+    string const parkResponseStream(packetStart + parkResponseXml + packetEnd);
+
+    string const sampleAddCallStream(
+        packetStart + sampleAddCallXml + packetEnd);
+    string const sampleAddResponseStream(
+        packetStart + sampleAddResponseXml + packetEnd);
+
+    client client;
+
+    serverPstreamConn server(serverPstreamConn::constrOpt()
+                             .registryP(&myRegistry)
+                             .socketFd(client.serverFd));
+
+    bool eof;
+    bool gotOne;
+    string response;
+
+    client.sendCall(parkCallStream);
+
+    server.runOnceNoWait(&eof, &gotOne);  // returns with the call pending
+    TEST(!eof);
+    TEST(gotOne);
+    TEST(parkMethodP->completionP != NULL);
+
+    EXPECT_ERROR(  // no response yet
+        client.recvResp(&response);
+        );
+
+    client.sendCall(sampleAddCallStream);
+
+    server.runOnceNoWait(&eof, &gotOne);  // doesn't read the second call
+    TEST(!eof);
+    TEST(!gotOne);
+
+    parkMethodP->completionP->complete(value_int(3));
+
+    client.recvResp(&response);
+    TEST(response == parkResponseStream);
+
+    server.runOnceNoWait(&eof, &gotOne);
+    TEST(!eof);
+    TEST(gotOne);
+
+    client.recvResp(&response);
+    TEST(response == sampleAddResponseStream);
+
+    client.hangup();
+
+    server.runOnce(&eof);
+
+    TEST(eof);
+}
+
+
+
 static void
 testMultiRpcRunNoRpc(registry const& myRegistry) {
 
@@ -652,6 +823,9 @@ public:
         myRegistry.addMethod("test.callinfo",
                              methodPtr(new testCallInfoMethod));
 
+        parkMethod * const parkMethodP(new parkMethod);
+        myRegistry.addMethod("test.park", methodPtr(parkMethodP));
+
         registryPtr myRegistryP(new registry);
 
         myRegistryP->addMethod("sample.add", methodPtr(new sampleAddMethod));
@@ -681,6 +855,10 @@ public:
 
         testNoWaitCall(myRegistry);
 
+        testWriteFailure(myRegistry);
+
+        testAsyncCall(myRegistry, parkMethodP);
+
         testMultiRpcRunNoRpc(myRegistry);
 
         testMultiRpcRunOneRpc(myRegistry);
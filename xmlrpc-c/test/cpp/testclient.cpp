@@ -357,6 +357,7 @@ public:
             .proxy_auth(XMLRPC_HTTPAUTH_BASIC)
             .proxy_userpwd("mypassword")
             .gssapi_delegation(true)
+            .unix_socket_path("/tmp/xmlrpc.sock")
             );            
 
         clientXmlTransport_curl transport5(
@@ -1,7 +1,9 @@
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "int.h"
+#include "bool.h"
 #include "casprintf.h"
 #include "girstring.h"
 
@@ -9,6 +11,10 @@
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+#include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/workpool_int.h"
 
 #include "testtool.h"
 #include "xml_data.h"
@@ -443,6 +449,7 @@ static const char * const expectedMethodName[] = {
     "system.shutdown",
     "system.capabilities",
     "system.getCapabilities",
+    "system.stats",
     "test.foo",
     "test.bar"
 };
@@ -479,12 +486,13 @@ test_system_listMethods(xmlrpc_registry * const registryP) {
 
     TEST(size == ARRAY_SIZE(expectedMethodName));
 
-    xmlrpc_decompose_value(&env, resultP, "(ssssssssss)",
+    xmlrpc_decompose_value(&env, resultP, "(sssssssssss)",
                            &methodName[0], &methodName[1],
                            &methodName[2], &methodName[3],
                            &methodName[4], &methodName[5],
                            &methodName[6], &methodName[7],
-                           &methodName[8], &methodName[9]);
+                           &methodName[8], &methodName[9],
+                           &methodName[10]);
 
     TEST_NO_FAULT(&env);
 
@@ -739,6 +747,87 @@ test_system_getCapabilities(xmlrpc_registry * const registryP) {
 
 
 
+static void
+test_system_stats(xmlrpc_registry * const registryP) {
+/*----------------------------------------------------------------------------
+   Test system.stats
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_value * resultP;
+    xmlrpc_value * argArrayP;
+    struct xmlrpc_method_stats stats;
+    xmlrpc_int64 callCt, faultCt, parseCt, executeCt, serializeCt;
+    xmlrpc_int32 inFlightCt;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running system.stats tests.");
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.foo", &stats);
+    TEST_NO_FAULT(&env);
+
+    argArrayP = xmlrpc_build_value(&env, "(s)", "test.foo");
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.stats", argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_decompose_value(&env, resultP,
+                           "{s:I,s:I,s:i,s:{s:I,*},s:{s:I,*},s:{s:I,*},*}",
+                           "calls", &callCt,
+                           "faults", &faultCt,
+                           "inFlight", &inFlightCt,
+                           "parse", "count", &parseCt,
+                           "execute", "count", &executeCt,
+                           "serialize", "count", &serializeCt);
+    TEST_NO_FAULT(&env);
+
+    TEST(callCt > 0);
+    TEST(callCt == (xmlrpc_int64)stats.callCt);
+    TEST(faultCt == (xmlrpc_int64)stats.faultCt);
+    TEST(inFlightCt == 0);
+    TEST(parseCt == (xmlrpc_int64)stats.parse.count);
+    TEST(executeCt == callCt);
+    TEST(serializeCt == (xmlrpc_int64)stats.serialize.count);
+
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    /* All methods; system.stats sees itself executing */
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.stats", argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_decompose_value(&env, resultP, "{s:{s:i,*},s:{s:I,*},*}",
+                           "system.stats", "inFlight", &inFlightCt,
+                           "test.bar", "calls", &callCt);
+    TEST_NO_FAULT(&env);
+    TEST(inFlightCt == 1);
+    TEST(callCt > 0);
+
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    argArrayP = xmlrpc_build_value(&env, "(s)", "test.nosuch");
+    TEST_NO_FAULT(&env);
+
+    doRpc(&env, registryP, "system.stats", argArrayP, NULL, &resultP);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.nosuch", &stats);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
 static void
 test_system_multicall(xmlrpc_registry * const registryP) {
 /*----------------------------------------------------------------------------
@@ -925,122 +1014,192 @@ testCall(xmlrpc_registry * const registryP) {
 
 
 
-static void
-testDefaultMethod(xmlrpc_registry * const registryP) {
-    
-    xmlrpc_env env;
-    xmlrpc_value * argArrayP;
-    xmlrpc_value * valueP;
-    xmlrpc_int32 i;
- 
-    xmlrpc_env_init(&env);
+static xmlrpc_value *
+test_reenter(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo,
+             void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Call the method named by the parameter (if any) through the registry
+   'serverInfo' while we're executing, and return the fault code of that
+   call (0 if it succeeds).
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * const registryP = serverInfo;
 
-    printf("  Running default method tests.");
+    const char * methodName;
+    xmlrpc_int32 faultCode;
 
-    /* Build an argument array for our calls. */
-    argArrayP = xmlrpc_build_value(&env, "(ii)",
-                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17); 
+    xmlrpc_decompose_value(envP, paramArrayP, "(s)", &methodName);
+    TEST_NO_FAULT(envP);
 
-    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
-                                       DEFAULT_SERVERINFO);
-    TEST_NO_FAULT(&env);
-    doRpc(&env, registryP, "test.nosuch", argArrayP, DEFAULT_CALLINFO,
-          &valueP);
-    TEST_NO_FAULT(&env);
-    TEST(valueP != NULL);
-    xmlrpc_decompose_value(&env, valueP, "i", &i);
-    xmlrpc_DECREF(valueP);
-    TEST_NO_FAULT(&env);
-    TEST(i == 84);
+    if (strlen(methodName) > 0) {
+        xmlrpc_env env;
+        xmlrpc_value * argArrayP;
+        xmlrpc_value * resultP;
 
-    /* Now try it with old method interface */
+        xmlrpc_env_init(&env);
 
-    doRpc(&env, registryP, "test.nosuch.old", argArrayP, NULL, &valueP);
+        argArrayP = xmlrpc_build_value(&env, "(s)", "");
+        TEST_NO_FAULT(&env);
+
+        doRpc(&env, registryP, methodName, argArrayP, NULL, &resultP);
+
+        faultCode = env.fault_occurred ? env.fault_code : 0;
+
+        if (!env.fault_occurred)
+            xmlrpc_DECREF(resultP);
+
+        xmlrpc_DECREF(argArrayP);
+        xmlrpc_env_clean(&env);
+    } else
+        faultCode = 0;
+
+    strfree(methodName);
+
+    return xmlrpc_build_value(envP, "i", faultCode);
+}
+
+
+
+static xmlrpc_int32
+reenter(xmlrpc_registry * const registryP,
+        const char *      const methodName,
+        const char *      const innerMethodName) {
+/*----------------------------------------------------------------------------
+   Call 'methodName', which is test_reenter, and have it call
+   'innerMethodName'.  Return the fault code of the inner call.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 faultCode;
+
+    xmlrpc_env_init(&env);
+
+    argArrayP = xmlrpc_build_value(&env, "(s)", innerMethodName);
     TEST_NO_FAULT(&env);
-    TEST(valueP != NULL);
-    xmlrpc_read_int(&env, valueP, &i);
+
+    doRpc(&env, registryP, methodName, argArrayP, NULL, &resultP);
     TEST_NO_FAULT(&env);
-    xmlrpc_DECREF(valueP);
-    TEST(i == 84);
 
-    /* Change the default method. */
-    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
-                                       BAR_SERVERINFO);
+    xmlrpc_read_int(&env, resultP, &faultCode);
     TEST_NO_FAULT(&env);
 
+    xmlrpc_DECREF(resultP);
     xmlrpc_DECREF(argArrayP);
-
     xmlrpc_env_clean(&env);
 
-    printf("\n");
+    return faultCode;
 }
 
 
 
 static void
-test_apache_dialect(void) {
-
-    char const expectedResp[] =
-        XML_PROLOGUE
-        "<methodResponse " XMLNS_APACHE ">\r\n"
-        "<params>\r\n"
-        "<param><value><array><data>\r\n"
-            "<value><ex:i8>8</ex:i8></value>\r\n"
-            "<value><ex:nil/></value>\r\n"
-        "</data></array></value></param>\r\n"
-        "</params>\r\n"
-        "</methodResponse>\r\n";
-
+testConcurrencyLimits(void) {
+/*----------------------------------------------------------------------------
+   A method calls through the registry while it is executing, so in a
+   single thread we can make a call find its method busy.
+-----------------------------------------------------------------------------*/
     xmlrpc_env env;
     xmlrpc_registry * registryP;
-    xmlrpc_value * argArrayP;
-    xmlrpc_mem_block * callP;
-    xmlrpc_mem_block * responseP;
+    struct xmlrpc_method_limits limits;
+    struct xmlrpc_method_queue_stats stats;
 
-    xmlrpc_env_init(&env);
+    printf("  Running concurrency limit tests.");
 
-    printf("  Running apache dialect tests.");
+    xmlrpc_env_init(&env);
 
     registryP = xmlrpc_registry_new(&env);
     TEST_NO_FAULT(&env);
 
-    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_i8);
+    xmlrpc_registry_add_method2(&env, registryP, "test.a", &test_reenter,
+                                NULL, NULL, registryP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.b", &test_reenter,
+                                NULL, NULL, registryP);
     TEST_NO_FAULT(&env);
 
-    xmlrpc_registry_set_dialect(&env, registryP, 100);
-    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    /* No limits */
+    TEST(reenter(registryP, "test.a", "test.a") == 0);
 
-    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_apache);
+    xmlrpc_registry_get_method_queue_stats(&env, registryP, "test.a",
+                                           &stats);
     TEST_NO_FAULT(&env);
-
-    xmlrpc_registry_add_method2(&env, registryP, "test_exttype",
-                                test_exttype, NULL, NULL, FOO_SERVERINFO);
+    TEST(stats.admittedCt == 0);
+
+    /* Fail fast */
+    limits.maxConcurrent  = 1;
+    limits.maxQueued      = 0;
+    limits.queueTimeoutMs = 0;
+    limits.priority       = xmlrpc_priority_low;
+    xmlrpc_registry_set_method_limits(&env, registryP, "test.a", &limits);
     TEST_NO_FAULT(&env);
 
-    argArrayP = xmlrpc_array_new(&env);
+    TEST(reenter(registryP, "test.a", "test.a") ==
+         XMLRPC_LIMIT_EXCEEDED_ERROR);
+    TEST(reenter(registryP, "test.a", "test.b") == 0);
+
+    xmlrpc_registry_get_method_queue_stats(&env, registryP, "test.a",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.runningCt == 0);
+    TEST(stats.queuedCt == 0);
+    TEST(stats.admittedCt == 2);
+    TEST(stats.waitedCt == 0);
+    TEST(stats.rejectedCt == 1);
+    TEST(stats.timedOutCt == 0);
+
+    /* Wait, but not long enough */
+    limits.maxQueued      = 1;
+    limits.queueTimeoutMs = 50;
+    xmlrpc_registry_set_method_limits(&env, registryP, "test.a", &limits);
     TEST_NO_FAULT(&env);
 
-    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST(reenter(registryP, "test.a", "test.a") == XMLRPC_TIMEOUT_ERROR);
+
+    xmlrpc_registry_get_method_queue_stats(&env, registryP, "test.a",
+                                           &stats);
     TEST_NO_FAULT(&env);
-    xmlrpc_serialize_call(&env, callP, "test_exttype", argArrayP);
+    TEST(stats.queuedCt == 0);
+    TEST(stats.admittedCt == 3);
+    TEST(stats.timedOutCt == 1);
+
+    /* Registry-wide limit.  test.b has no limits of its own, so its
+       calls wait indefinitely, but test.a's calls fail fast.  System
+       methods don't count.
+    */
+    limits.maxConcurrent  = 0;
+    limits.maxQueued      = 0;
+    limits.queueTimeoutMs = 0;
+    xmlrpc_registry_set_method_limits(&env, registryP, "test.a", &limits);
     TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_max_concurrent(registryP, 1);
 
-    xmlrpc_registry_process_call2(
-        &env, registryP,
-        xmlrpc_mem_block_contents(callP),
-        xmlrpc_mem_block_size(callP),
-        NULL, &responseP);
+    TEST(reenter(registryP, "test.b", "test.a") ==
+         XMLRPC_LIMIT_EXCEEDED_ERROR);
+    TEST(reenter(registryP, "test.b", "system.methodExist") == 0);
 
+    xmlrpc_registry_get_method_queue_stats(&env, registryP, "test.b",
+                                           &stats);
     TEST_NO_FAULT(&env);
+    TEST(stats.runningCt == 0);
+    TEST(stats.admittedCt == 2);
 
-    TEST(XMLRPC_MEMBLOCK_SIZE(char, responseP) == strlen(expectedResp));
-    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
-               expectedResp,
-               XMLRPC_MEMBLOCK_SIZE(char, responseP)));
+    xmlrpc_registry_set_max_concurrent(registryP, 0);
+
+    /* Invalid settings */
+    xmlrpc_registry_set_method_limits(&env, registryP, "test.nosuch",
+                                      &limits);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    limits.priority = (xmlrpc_priority) 99;
+    xmlrpc_registry_set_method_limits(&env, registryP, "test.a", &limits);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_registry_get_method_queue_stats(&env, registryP, "test.nosuch",
+                                           &stats);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
 
-    xmlrpc_DECREF(argArrayP);
-    xmlrpc_mem_block_free(callP);
-    xmlrpc_mem_block_free(responseP);
     xmlrpc_registry_free(registryP);
 
     xmlrpc_env_clean(&env);
@@ -1050,66 +1209,1906 @@ test_apache_dialect(void) {
 
 
 
-void
-test_method_registry(void) {
+typedef struct {
+    lock * lockP;
+    unsigned int callCt;
+} flightLog;
 
-    xmlrpc_env env, env2;
-    xmlrpc_value * valueP;
-    xmlrpc_registry * registryP;
-    xmlrpc_mem_block * responseP;
 
-    xmlrpc_env_init(&env);
 
-    testVersion();
+static xmlrpc_value *
+test_flight(xmlrpc_env *   const envP,
+            xmlrpc_value * const paramArrayP,
+            void *         const serverInfo,
+            void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Slowly return twice the argument; fail if it is negative.
+-----------------------------------------------------------------------------*/
+    flightLog * const logP = serverInfo;
 
-    printf("Running method registry tests.");
+    xmlrpc_int32 arg;
 
-    /* Create a new registry. */
-    registryP = xmlrpc_registry_new(&env);
-    TEST_NO_FAULT(&env);
-    TEST(registryP != NULL);
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &arg);
+    TEST_NO_FAULT(envP);
 
-    /* Add some test methods. */
-    xmlrpc_registry_add_method(&env, registryP, NULL, "test.foo",
-                               test_foo_type1, FOO_SERVERINFO);
+    logP->lockP->acquire(logP->lockP);
+    ++logP->callCt;
+    logP->lockP->release(logP->lockP);
+
+    xmlrpc_millisecond_sleep(200);
+
+    if (arg < 0) {
+        xmlrpc_env_set_fault(envP, 97, "Negative argument");
+        return NULL;
+    } else
+        return xmlrpc_build_value(envP, "i", arg * 2);
+}
+
+
+
+static void
+multicallFlight(xmlrpc_registry * const registryP,
+                xmlrpc_int32      const arg0,
+                xmlrpc_int32      const arg1,
+                xmlrpc_int32      const arg2,
+                xmlrpc_int32      const arg3) {
+/*----------------------------------------------------------------------------
+   Make four calls of test.flight at once, via a parallel system.multicall,
+   and check each result.
+-----------------------------------------------------------------------------*/
+    xmlrpc_int32 const args[] = {arg0, arg1, arg2, arg3};
+
+    xmlrpc_env env;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_value * resultsP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    paramArrayP = xmlrpc_build_value(
+        &env, "(({s:s,s:(i)}{s:s,s:(i)}{s:s,s:(i)}{s:s,s:(i)}))",
+        "methodName", "test.flight", "params", arg0,
+        "methodName", "test.flight", "params", arg1,
+        "methodName", "test.flight", "params", arg2,
+        "methodName", "test.flight", "params", arg3);
     TEST_NO_FAULT(&env);
-    xmlrpc_registry_add_method2(&env, registryP, "test.bar",
-                                test_bar, NULL, barHelp, BAR_SERVERINFO);
+
+    doRpc(&env, registryP, "system.multicall", paramArrayP, NULL, &resultsP);
     TEST_NO_FAULT(&env);
 
-    printf("\n");
-    testCall(registryP);
+    for (i = 0; i < ARRAY_SIZE(args); ++i) {
+        xmlrpc_value * itemP;
 
-    test_system_multicall(registryP);
+        xmlrpc_array_read_item(&env, resultsP, i, &itemP);
+        TEST_NO_FAULT(&env);
 
-    xmlrpc_env_init(&env2);
-    xmlrpc_registry_process_call2(&env, registryP,
-                                  expat_error_data,
-                                  strlen(expat_error_data),
-                                  NULL,
-                                  &responseP);
-    TEST_NO_FAULT(&env);
-    TEST(responseP != NULL);
-    valueP = xmlrpc_parse_response(&env2, xmlrpc_mem_block_contents(responseP),
-                                  xmlrpc_mem_block_size(responseP));
-    TEST(valueP == NULL);
-    TEST_FAULT(&env2, XMLRPC_PARSE_ERROR);
-    xmlrpc_mem_block_free(responseP);
-    xmlrpc_env_clean(&env2);
+        if (args[i] < 0) {
+            xmlrpc_int32 faultCode;
+
+            xmlrpc_decompose_value(&env, itemP, "{s:i,*}",
+                                   "faultCode", &faultCode);
+            TEST_NO_FAULT(&env);
+            TEST(faultCode == 97);
+        } else {
+            xmlrpc_int32 result;
+
+            xmlrpc_decompose_value(&env, itemP, "(i)", &result);
+            TEST_NO_FAULT(&env);
+            TEST(result == args[i] * 2);
+        }
+        xmlrpc_DECREF(itemP);
+    }
+    xmlrpc_DECREF(resultsP);
+    xmlrpc_DECREF(paramArrayP);
 
-    printf("\n");
+    xmlrpc_env_clean(&env);
+}
 
-    testDefaultMethod(registryP);
 
-    test_system_listMethods(registryP);
 
-    test_system_methodExist(registryP);
+typedef struct {
+/*----------------------------------------------------------------------------
+   A call of test.flight that a pool thread makes
+-----------------------------------------------------------------------------*/
+    xmlrpc_workpoolJob job;
+    xmlrpc_registry * registryP;
+    xmlrpc_int32 arg;
+    unsigned int deadlineMs;
+        /* The call's deadline; zero means none */
+    xmlrpc_int32 faultCode;
+        /* Fault code of the call; zero if it succeeded */
+    xmlrpc_int32 result;
+} flightCall;
 
-    test_system_methodHelp(registryP);
 
-    test_system_capabilities(registryP);
 
-    test_system_getCapabilities(registryP);
+static xmlrpc_workpoolFn makeFlightCall;
+
+static void
+makeFlightCall(void * const arg) {
+
+    flightCall * const callP = arg;
+
+    xmlrpc_env env;
+    xmlrpc_env env2;
+    xmlrpc_call_ctl ctl;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * xmlP;
+    xmlrpc_mem_block * responseP;
+    xmlrpc_value * resultP;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_call_ctl_init(&ctl, callP->deadlineMs);
+
+    argArrayP = xmlrpc_build_value(&env, "(i)", callP->arg);
+    TEST_NO_FAULT(&env);
+
+    xmlP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, xmlP, "test.flight", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_process_call3(&env, callP->registryP,
+                                  xmlrpc_mem_block_contents(xmlP),
+                                  xmlrpc_mem_block_size(xmlP),
+                                  NULL, &ctl, &responseP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_env_init(&env2);
+
+    resultP = xmlrpc_parse_response(&env2,
+                                    xmlrpc_mem_block_contents(responseP),
+                                    xmlrpc_mem_block_size(responseP));
+
+    if (env2.fault_occurred)
+        callP->faultCode = env2.fault_code;
+    else {
+        callP->faultCode = 0;
+        xmlrpc_read_int(&env, resultP, &callP->result);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(resultP);
+    }
+    xmlrpc_env_clean(&env2);
+    xmlrpc_mem_block_free(responseP);
+    xmlrpc_mem_block_free(xmlP);
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testCoalescingAbandoned(xmlrpc_registry * const registryP,
+                        flightLog *       const logP) {
+/*----------------------------------------------------------------------------
+   Test that when the executing call fails for reasons of its own -- here,
+   its deadline passes while it waits for admission -- the calls waiting
+   for it don't share that fault; one of them executes instead.
+
+   test.flight must be coalescing, and take one call at a time.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    struct xmlrpc_workpool * poolP;
+    flightCall calls[4];
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_workpoolCreate(&env, ARRAY_SIZE(calls), &poolP);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < ARRAY_SIZE(calls); ++i) {
+        calls[i].registryP  = registryP;
+        calls[i].arg        = 5;
+        calls[i].deadlineMs = 0;
+    }
+    calls[0].arg        = 7;   /* Occupies the method for 200 ms */
+    calls[1].deadlineMs = 50;  /* Leads, but gives up waiting for admission */
+
+    logP->callCt = 0;
+
+    for (i = 0; i < ARRAY_SIZE(calls); ++i) {
+        xmlrpc_workpoolSubmit(poolP, &calls[i].job, &makeFlightCall,
+                              &calls[i]);
+        xmlrpc_millisecond_sleep(10);
+    }
+    xmlrpc_workpoolDestroy(poolP);
+
+    TEST(calls[0].faultCode == 0);
+    TEST(calls[0].result == 14);
+    TEST(calls[1].faultCode == XMLRPC_TIMEOUT_ERROR);
+    TEST(calls[2].faultCode == 0);
+    TEST(calls[2].result == 10);
+    TEST(calls[3].faultCode == 0);
+    TEST(calls[3].result == 10);
+
+    /* The blocker, and one execution for the two waiters */
+    TEST(logP->callCt == 2);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testCoalescing(void) {
+/*----------------------------------------------------------------------------
+   Test identical concurrent calls sharing one execution.  We get the
+   calls to be concurrent by making them in a parallel system.multicall.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    flightLog log;
+
+    printf("  Running call coalescing tests.");
+
+    xmlrpc_env_init(&env);
+
+    log.lockP = xmlrpc_lock_create();
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.flight", &test_flight,
+                                NULL, NULL, &log);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_method_parallel_safe(&env, registryP, "test.flight",
+                                             true);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_parallel_multicall(&env, registryP, 4, 0);
+    TEST_NO_FAULT(&env);
+
+    /* Without coalescing, each call executes */
+    log.callCt = 0;
+    multicallFlight(registryP, 5, 5, 5, 5);
+    TEST(log.callCt == 4);
+
+    xmlrpc_registry_set_method_coalescing(&env, registryP, "test.flight",
+                                          true);
+    TEST_NO_FAULT(&env);
+
+    /* Identical calls share one execution */
+    log.callCt = 0;
+    multicallFlight(registryP, 5, 5, 5, 5);
+    TEST(log.callCt == 1);
+
+    /* Including its fault */
+    log.callCt = 0;
+    multicallFlight(registryP, -1, -1, -1, -1);
+    TEST(log.callCt == 1);
+
+    /* Different calls don't share */
+    log.callCt = 0;
+    multicallFlight(registryP, 1, 2, 1, -2);
+    TEST(log.callCt == 3);
+
+    {
+        struct xmlrpc_method_limits limits;
+
+        limits.maxConcurrent  = 1;
+        limits.maxQueued      = 4;
+        limits.queueTimeoutMs = 0;
+        limits.priority       = xmlrpc_priority_normal;
+        xmlrpc_registry_set_method_limits(&env, registryP, "test.flight",
+                                          &limits);
+        TEST_NO_FAULT(&env);
+
+        testCoalescingAbandoned(registryP, &log);
+
+        limits.maxConcurrent = 0;
+        xmlrpc_registry_set_method_limits(&env, registryP, "test.flight",
+                                          &limits);
+        TEST_NO_FAULT(&env);
+    }
+
+    xmlrpc_registry_set_method_coalescing(&env, registryP, "test.flight",
+                                          false);
+    TEST_NO_FAULT(&env);
+
+    log.callCt = 0;
+    multicallFlight(registryP, 5, 5, 5, 5);
+    TEST(log.callCt == 4);
+
+    xmlrpc_registry_set_method_coalescing(&env, registryP, "test.nosuch",
+                                          true);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_registry_free(registryP);
+
+    log.lockP->destroy(log.lockP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   What the methods of the parallel multicall test have seen
+-----------------------------------------------------------------------------*/
+    lock * lockP;
+    unsigned int runningCt;
+        /* Calls of test.slow executing now */
+    unsigned int maxRunningCt;
+        /* Most calls of test.slow that have executed at once */
+    xmlrpc_int32 seqLog[10];
+        /* Arguments of the calls of test.seq, in the order they executed */
+    unsigned int seqLogCt;
+} parallelLog;
+
+
+
+static xmlrpc_value *
+test_slow(xmlrpc_env *   const envP,
+          xmlrpc_value * const paramArrayP,
+          void *         const serverInfo,
+          void *         const callInfo ATTR_UNUSED) {
+
+    parallelLog * const logP = serverInfo;
+
+    xmlrpc_int32 arg;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &arg);
+    TEST_NO_FAULT(envP);
+
+    logP->lockP->acquire(logP->lockP);
+    ++logP->runningCt;
+    if (logP->runningCt > logP->maxRunningCt)
+        logP->maxRunningCt = logP->runningCt;
+    logP->lockP->release(logP->lockP);
+
+    xmlrpc_millisecond_sleep(50);
+
+    logP->lockP->acquire(logP->lockP);
+    --logP->runningCt;
+    logP->lockP->release(logP->lockP);
+
+    return xmlrpc_build_value(envP, "i", arg);
+}
+
+
+
+static xmlrpc_value *
+test_seq(xmlrpc_env *   const envP,
+         xmlrpc_value * const paramArrayP,
+         void *         const serverInfo,
+         void *         const callInfo ATTR_UNUSED) {
+
+    parallelLog * const logP = serverInfo;
+
+    xmlrpc_int32 arg;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &arg);
+    TEST_NO_FAULT(envP);
+
+    xmlrpc_millisecond_sleep(10);
+
+    logP->lockP->acquire(logP->lockP);
+    TEST(logP->seqLogCt < ARRAY_SIZE(logP->seqLog));
+    logP->seqLog[logP->seqLogCt++] = arg;
+    logP->lockP->release(logP->lockP);
+
+    return xmlrpc_build_value(envP, "i", arg);
+}
+
+
+
+static void
+testParallelMulticall(xmlrpc_registry * const mainRegistryP) {
+/*----------------------------------------------------------------------------
+   Test system.multicall executing parallel-safe calls in a pool.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * multiP;
+    xmlrpc_value * resultsP;
+    parallelLog log;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    /* The ordinary multicall tests give the same results in parallel */
+    xmlrpc_registry_set_parallel_multicall(&env, mainRegistryP, 4, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_method_parallel_safe(&env, mainRegistryP,
+                                             "test.foo", true);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_method_parallel_safe(&env, mainRegistryP,
+                                             "test.bar", true);
+    TEST_NO_FAULT(&env);
+
+    test_system_multicall(mainRegistryP);
+
+    xmlrpc_registry_set_method_parallel_safe(&env, mainRegistryP,
+                                             "test.nosuch", true);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_registry_set_parallel_multicall(&env, mainRegistryP, 0, 0);
+    TEST_NO_FAULT(&env);
+
+    printf("  Running parallel multicall tests.");
+
+    log.lockP        = xmlrpc_lock_create();
+    log.runningCt    = 0;
+    log.maxRunningCt = 0;
+    log.seqLogCt     = 0;
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.slow", &test_slow,
+                                NULL, NULL, &log);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.seq", &test_seq,
+                                NULL, NULL, &log);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_method_parallel_safe(&env, registryP, "test.slow",
+                                             true);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_set_parallel_multicall(&env, registryP, 8, 3);
+    TEST_NO_FAULT(&env);
+
+    /* Calls 0, 3, 6, and 9 are of test.seq; the rest of test.slow */
+    multiP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+    for (i = 0; i < 10; ++i) {
+        xmlrpc_value * const callP =
+            xmlrpc_build_value(&env, "{s:s,s:(i)}",
+                               "methodName",
+                               i % 3 == 0 ? "test.seq" : "test.slow",
+                               "params", (xmlrpc_int32)i);
+        TEST_NO_FAULT(&env);
+        xmlrpc_array_append_item(&env, multiP, callP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(callP);
+    }
+    {
+        xmlrpc_value * const paramArrayP =
+            xmlrpc_build_value(&env, "(A)", multiP);
+        TEST_NO_FAULT(&env);
+
+        doRpc(&env, registryP, "system.multicall", paramArrayP, NULL,
+              &resultsP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_DECREF(paramArrayP);
+    }
+    TEST(xmlrpc_array_size(&env, resultsP) == 10);
+    for (i = 0; i < 10; ++i) {
+        xmlrpc_value * itemP;
+        xmlrpc_int32 result;
+
+        xmlrpc_array_read_item(&env, resultsP, i, &itemP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_decompose_value(&env, itemP, "(i)", &result);
+        TEST_NO_FAULT(&env);
+        TEST(result == (xmlrpc_int32)i);
+        xmlrpc_DECREF(itemP);
+    }
+    xmlrpc_DECREF(resultsP);
+
+    TEST(log.seqLogCt == 4);
+    TEST(log.seqLog[0] == 0);
+    TEST(log.seqLog[1] == 3);
+    TEST(log.seqLog[2] == 6);
+    TEST(log.seqLog[3] == 9);
+
+    TEST(log.runningCt == 0);
+    TEST(log.maxRunningCt > 1);
+    TEST(log.maxRunningCt <= 3);
+
+    /* A malformed call means none execute */
+    log.seqLogCt = 0;
+    {
+        xmlrpc_value * const badCallP = xmlrpc_int_new(&env, 7);
+        xmlrpc_value * paramArrayP;
+
+        xmlrpc_array_append_item(&env, multiP, badCallP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(badCallP);
+
+        paramArrayP = xmlrpc_build_value(&env, "(A)", multiP);
+        TEST_NO_FAULT(&env);
+
+        doRpc(&env, registryP, "system.multicall", paramArrayP, NULL,
+              &resultsP);
+        TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+
+        xmlrpc_DECREF(paramArrayP);
+    }
+    TEST(log.seqLogCt == 0);
+
+    xmlrpc_DECREF(multiP);
+
+    xmlrpc_registry_free(registryP);
+
+    log.lockP->destroy(log.lockP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A call of test.async that a pool thread completes
+-----------------------------------------------------------------------------*/
+    xmlrpc_workpoolJob job;
+    xmlrpc_int32 arg;
+    xmlrpc_call_completion * completionP;
+} deferredCall;
+
+
+
+static xmlrpc_workpoolFn completeDeferred;
+
+static void
+completeDeferred(void * const arg) {
+
+    deferredCall * const callP = arg;
+
+    xmlrpc_millisecond_sleep(20);
+
+    if (callP->arg < 0)
+        xmlrpc_call_fail(callP->completionP, 99, "Negative argument");
+    else {
+        xmlrpc_env env;
+
+        xmlrpc_env_init(&env);
+
+        xmlrpc_call_complete(callP->completionP,
+                             xmlrpc_int_new(&env, callP->arg + 1));
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_env_clean(&env);
+    }
+    free(callP);
+}
+
+
+
+static void
+test_async(xmlrpc_value *           const paramArrayP,
+           void *                   const serverInfo,
+           void *                   const callInfo ATTR_UNUSED,
+           xmlrpc_call_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   Return the argument plus one.  Complete the call right away if the
+   argument is zero; otherwise, later in a thread of pool *serverInfo.
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_workpool * const poolP = serverInfo;
+
+    xmlrpc_env env;
+    xmlrpc_int32 arg;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_decompose_value(&env, paramArrayP, "(i)", &arg);
+    TEST_NO_FAULT(&env);
+
+    if (arg == 0)
+        xmlrpc_call_complete(completionP, xmlrpc_int_new(&env, 1));
+    else {
+        deferredCall * const callP = malloc(sizeof(*callP));
+
+        TEST(callP != NULL);
+
+        callP->arg         = arg;
+        callP->completionP = completionP;
+
+        xmlrpc_workpoolSubmit(poolP, &callP->job, &completeDeferred, callP);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static xmlrpc_int32
+callAsync(xmlrpc_env *      const envP,
+          xmlrpc_registry * const registryP,
+          xmlrpc_int32      const arg) {
+
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 result;
+
+    argArrayP = xmlrpc_build_value(envP, "(i)", arg);
+    TEST_NO_FAULT(envP);
+
+    doRpc(envP, registryP, "test.async", argArrayP, NULL, &resultP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_read_int(envP, resultP, &result);
+        TEST_NO_FAULT(envP);
+        xmlrpc_DECREF(resultP);
+    } else
+        result = 0;
+
+    xmlrpc_DECREF(argArrayP);
+
+    return result;
+}
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   What xmlrpc_registry_process_call_async() reported to asyncResponse()
+-----------------------------------------------------------------------------*/
+    lock * lockP;
+    bool responded;
+    xmlrpc_value * resultP;
+    xmlrpc_env fault;
+        /* The fault in the response, if it is a fault response */
+} asyncResponseLog;
+
+
+
+static xmlrpc_response_fn asyncResponse;
+
+static void
+asyncResponse(void *             const context,
+              const xmlrpc_env * const faultP,
+              xmlrpc_mem_block * const responseXmlP) {
+
+    asyncResponseLog * const logP = context;
+
+    TEST_NO_FAULT(faultP);
+    TEST(responseXmlP != NULL);
+
+    logP->lockP->acquire(logP->lockP);
+
+    logP->resultP =
+        xmlrpc_parse_response(&logP->fault,
+                              xmlrpc_mem_block_contents(responseXmlP),
+                              xmlrpc_mem_block_size(responseXmlP));
+    logP->responded = true;
+
+    logP->lockP->release(logP->lockP);
+
+    xmlrpc_mem_block_free(responseXmlP);
+}
+
+
+
+static void
+processAsync(xmlrpc_registry *  const registryP,
+             const char *       const callXml,
+             size_t             const callXmlLen,
+             xmlrpc_call_ctl *  const ctlP,
+             asyncResponseLog * const logP) {
+/*----------------------------------------------------------------------------
+   Process a call with xmlrpc_registry_process_call_async() and wait for
+   the response.
+-----------------------------------------------------------------------------*/
+    bool responded;
+    unsigned int waitedMs;
+
+    logP->responded = false;
+    xmlrpc_env_init(&logP->fault);
+
+    xmlrpc_registry_process_call_async(registryP, callXml, callXmlLen, NULL,
+                                       ctlP, &asyncResponse, logP);
+
+    for (responded = false, waitedMs = 0; !responded && waitedMs < 5000;
+         waitedMs += 10) {
+        logP->lockP->acquire(logP->lockP);
+        responded = logP->responded;
+        logP->lockP->release(logP->lockP);
+
+        if (!responded)
+            xmlrpc_millisecond_sleep(10);
+    }
+    TEST(responded);
+}
+
+
+
+static void
+testAsyncMethods(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_workpool * poolP;
+    struct xmlrpc_async_method_info info;
+    asyncResponseLog log;
+
+    printf("  Running asynchronous method tests.");
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_workpoolCreate(&env, 2, &poolP);
+    TEST_NO_FAULT(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    info.methodName      = "test.async";
+    info.methodFunction  = &test_async;
+    info.serverInfo      = poolP;
+    info.stackSize       = 0;
+    info.signatureString = "i:i";
+    info.help            = NULL;
+
+    xmlrpc_registry_add_async_method(&env, registryP, &info);
+    TEST_NO_FAULT(&env);
+
+    /* The synchronous interface waits for the call to complete */
+    TEST(callAsync(&env, registryP, 0) == 1);
+    TEST_NO_FAULT(&env);
+    TEST(callAsync(&env, registryP, 5) == 6);
+    TEST_NO_FAULT(&env);
+    callAsync(&env, registryP, -1);
+    TEST_FAULT(&env, 99);
+
+    /* So does system.multicall */
+    {
+        xmlrpc_value * multiP;
+        xmlrpc_value * resultsP;
+        xmlrpc_int32 r1, r2, faultCode;
+        const char * faultString;
+
+        multiP = xmlrpc_build_value(&env,
+                                    "(({s:s,s:(i)}{s:s,s:(i)}{s:s,s:(i)}))",
+                                    "methodName", "test.async",
+                                    "params", (xmlrpc_int32)7,
+                                    "methodName", "test.async",
+                                    "params", (xmlrpc_int32)-1,
+                                    "methodName", "test.async",
+                                    "params", (xmlrpc_int32)0);
+        TEST_NO_FAULT(&env);
+
+        doRpc(&env, registryP, "system.multicall", multiP, NULL, &resultsP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_decompose_value(&env, resultsP, "((i){s:i,s:s,*}(i))",
+                               &r1, "faultCode", &faultCode,
+                               "faultString", &faultString, &r2);
+        TEST_NO_FAULT(&env);
+        TEST(r1 == 8);
+        TEST(faultCode == 99);
+        TEST(r2 == 1);
+
+        strfree(faultString);
+        xmlrpc_DECREF(resultsP);
+        xmlrpc_DECREF(multiP);
+    }
+
+    /* The asynchronous interface */
+    log.lockP = xmlrpc_lock_create();
+    {
+        xmlrpc_value * argArrayP;
+        xmlrpc_mem_block * callP;
+        xmlrpc_int32 result;
+
+        argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32)41);
+        TEST_NO_FAULT(&env);
+        callP = xmlrpc_mem_block_new(&env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_call(&env, callP, "test.async", argArrayP);
+        TEST_NO_FAULT(&env);
+
+        processAsync(registryP, xmlrpc_mem_block_contents(callP),
+                     xmlrpc_mem_block_size(callP), NULL, &log);
+        TEST_NO_FAULT(&log.fault);
+        xmlrpc_read_int(&env, log.resultP, &result);
+        TEST_NO_FAULT(&env);
+        TEST(result == 42);
+        xmlrpc_DECREF(log.resultP);
+
+        /* A call its caller has given up on doesn't get executed */
+        {
+            xmlrpc_call_ctl ctl;
+
+            xmlrpc_call_ctl_init(&ctl, 0);
+            xmlrpc_call_cancel(&ctl);
+
+            processAsync(registryP, xmlrpc_mem_block_contents(callP),
+                         xmlrpc_mem_block_size(callP), &ctl, &log);
+            TEST_FAULT(&log.fault, XMLRPC_TIMEOUT_ERROR);
+        }
+
+        xmlrpc_mem_block_free(callP);
+        xmlrpc_DECREF(argArrayP);
+    }
+    /* A synchronous method through the asynchronous interface */
+    {
+        xmlrpc_value * argArrayP;
+        xmlrpc_mem_block * callP;
+        xmlrpc_bool exists;
+
+        argArrayP = xmlrpc_build_value(&env, "(s)", "test.async");
+        TEST_NO_FAULT(&env);
+        callP = xmlrpc_mem_block_new(&env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_call(&env, callP, "system.methodExist", argArrayP);
+        TEST_NO_FAULT(&env);
+
+        processAsync(registryP, xmlrpc_mem_block_contents(callP),
+                     xmlrpc_mem_block_size(callP), NULL, &log);
+        TEST_NO_FAULT(&log.fault);
+        xmlrpc_read_bool(&env, log.resultP, &exists);
+        TEST_NO_FAULT(&env);
+        TEST(exists);
+        xmlrpc_DECREF(log.resultP);
+
+        xmlrpc_mem_block_free(callP);
+        xmlrpc_DECREF(argArrayP);
+    }
+    /* Call XML that isn't XML-RPC */
+    processAsync(registryP, expat_error_data, strlen(expat_error_data), NULL,
+                 &log);
+    TEST_FAULT(&log.fault, XMLRPC_PARSE_ERROR);
+
+    log.lockP->destroy(log.lockP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_workpoolDestroy(poolP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static xmlrpc_value *
+test_counted(xmlrpc_env *   const envP,
+             xmlrpc_value * const paramArrayP,
+             void *         const serverInfo,
+             void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Return the parameters, and count the calls in *serverInfo.  No
+   parameters is a failure.
+-----------------------------------------------------------------------------*/
+    unsigned int * const callCtP = serverInfo;
+
+    ++*callCtP;
+
+    if (xmlrpc_array_size(envP, paramArrayP) == 0) {
+        xmlrpc_env_set_fault(envP, 98, "No parameters");
+        return NULL;
+    } else {
+        xmlrpc_INCREF(paramArrayP);
+        return paramArrayP;
+    }
+}
+
+
+
+static xmlrpc_mem_block *
+processCall(xmlrpc_registry * const registryP,
+            const char *      const methodName,
+            const char *      const format,
+            ...) {
+/*----------------------------------------------------------------------------
+   Process a call of 'methodName' with the parameters 'format' and the
+   arguments after it describe.  Return the response XML.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    const char * suffix;
+    xmlrpc_mem_block * callP;
+    xmlrpc_mem_block * responseP;
+    va_list args;
+
+    xmlrpc_env_init(&env);
+
+    va_start(args, format);
+    xmlrpc_build_value_va(&env, format, args, &argArrayP, &suffix);
+    va_end(args);
+    TEST_NO_FAULT(&env);
+
+    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, methodName, argArrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_process_call2(&env, registryP,
+                                  xmlrpc_mem_block_contents(callP),
+                                  xmlrpc_mem_block_size(callP),
+                                  NULL, &responseP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_mem_block_free(callP);
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+
+    return responseP;
+}
+
+
+
+static bool
+sameResponse(xmlrpc_mem_block * const response1P,
+             xmlrpc_mem_block * const response2P) {
+
+    bool const same =
+        xmlrpc_mem_block_size(response1P) ==
+        xmlrpc_mem_block_size(response2P) &&
+        memcmp(xmlrpc_mem_block_contents(response1P),
+               xmlrpc_mem_block_contents(response2P),
+               xmlrpc_mem_block_size(response1P)) == 0;
+
+    xmlrpc_mem_block_free(response1P);
+    xmlrpc_mem_block_free(response2P);
+
+    return same;
+}
+
+
+
+static void
+testResultCache(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_cache_parms parms;
+    struct xmlrpc_method_cache_stats stats;
+    unsigned int callCt;
+
+    printf("  Running result cache tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.counted",
+                                &test_counted, NULL, NULL, &callCt);
+    TEST_NO_FAULT(&env);
+
+    parms.ttlMs      = 0;
+    parms.maxEntries = 2;
+    parms.maxBytes   = 0;
+
+    xmlrpc_registry_set_method_cache(&env, registryP, "test.nosuchmethod",
+                                     &parms);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_registry_get_method_cache_stats(&env, registryP, "test.counted",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.hitCt == 0 && stats.missCt == 0 && stats.entryCt == 0);
+
+    /* Without a cache, every call executes */
+    callCt = 0;
+    TEST(sameResponse(processCall(registryP, "test.counted", "(i)", 1),
+                      processCall(registryP, "test.counted", "(i)", 1)));
+    TEST(callCt == 2);
+
+    xmlrpc_registry_set_method_cache(&env, registryP, "test.counted",
+                                     &parms);
+    TEST_NO_FAULT(&env);
+
+    /* The same parameters get the same response, without executing */
+    callCt = 0;
+    TEST(sameResponse(processCall(registryP, "test.counted", "(is)", 1, "a"),
+                      processCall(registryP, "test.counted", "(is)", 1, "a")));
+    TEST(callCt == 1);
+
+    /* Different parameters don't */
+    xmlrpc_mem_block_free(
+        processCall(registryP, "test.counted", "(is)", 1, "b"));
+    TEST(callCt == 2);
+
+    /* Nor do failures */
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "()"));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "()"));
+    TEST(callCt == 4);
+
+    xmlrpc_registry_get_method_cache_stats(&env, registryP, "test.counted",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.hitCt == 1);
+    TEST(stats.missCt == 4);
+    TEST(stats.entryCt == 2);
+    TEST(stats.evictedCt == 0);
+    TEST(stats.byteCt > 0);
+
+    /* The order of struct members doesn't matter */
+    callCt = 0;
+    xmlrpc_mem_block_free(
+        processCall(registryP, "test.counted", "({s:i,s:i,s:i})",
+                    "x", 1, "y", 2, "xy", 3));
+    xmlrpc_mem_block_free(
+        processCall(registryP, "test.counted", "({s:i,s:i,s:i})",
+                    "xy", 3, "y", 2, "x", 1));
+    TEST(callCt == 1);
+    xmlrpc_mem_block_free(
+        processCall(registryP, "test.counted", "({s:i,s:i,s:i})",
+                    "xy", 3, "y", 2, "x", 4));
+    TEST(callCt == 2);
+
+    /* The least recently used response goes when the cache is full */
+    parms.maxEntries = 2;
+    xmlrpc_registry_set_method_cache(&env, registryP, "test.counted",
+                                     &parms);
+    TEST_NO_FAULT(&env);
+
+    callCt = 0;
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 2));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 3));
+    TEST(callCt == 3);
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    TEST(callCt == 3);
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 2));
+    TEST(callCt == 4);
+
+    xmlrpc_registry_get_method_cache_stats(&env, registryP, "test.counted",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.entryCt == 2);
+    TEST(stats.evictedCt == 2);
+
+    /* A response too big for the cache doesn't go in it */
+    parms.maxBytes = 16;
+    xmlrpc_registry_set_method_cache(&env, registryP, "test.counted",
+                                     &parms);
+    TEST_NO_FAULT(&env);
+
+    callCt = 0;
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    TEST(callCt == 2);
+
+    /* Responses expire */
+    parms.ttlMs    = 50;
+    parms.maxBytes = 0;
+    xmlrpc_registry_set_method_cache(&env, registryP, "test.counted",
+                                     &parms);
+    TEST_NO_FAULT(&env);
+
+    callCt = 0;
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    TEST(callCt == 1);
+    xmlrpc_millisecond_sleep(80);
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    TEST(callCt == 2);
+
+    xmlrpc_registry_get_method_cache_stats(&env, registryP, "test.counted",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.expiredCt == 1);
+    TEST(stats.entryCt == 1);
+
+    /* The asynchronous interface uses the same cache */
+    {
+        asyncResponseLog log;
+        xmlrpc_value * argArrayP;
+        xmlrpc_mem_block * callP;
+        xmlrpc_int32 result;
+
+        log.lockP = xmlrpc_lock_create();
+
+        argArrayP = xmlrpc_build_value(&env, "(i)", (xmlrpc_int32)1);
+        TEST_NO_FAULT(&env);
+        callP = xmlrpc_mem_block_new(&env, 0);
+        TEST_NO_FAULT(&env);
+        xmlrpc_serialize_call(&env, callP, "test.counted", argArrayP);
+        TEST_NO_FAULT(&env);
+
+        processAsync(registryP, xmlrpc_mem_block_contents(callP),
+                     xmlrpc_mem_block_size(callP), NULL, &log);
+        TEST_NO_FAULT(&log.fault);
+        xmlrpc_decompose_value(&env, log.resultP, "(i)", &result);
+        TEST_NO_FAULT(&env);
+        TEST(result == 1);
+        TEST(callCt == 2);
+        xmlrpc_DECREF(log.resultP);
+
+        xmlrpc_mem_block_free(callP);
+        xmlrpc_DECREF(argArrayP);
+
+        log.lockP->destroy(log.lockP);
+    }
+
+    /* No entries means no caching */
+    parms.maxEntries = 0;
+    xmlrpc_registry_set_method_cache(&env, registryP, "test.counted",
+                                     &parms);
+    TEST_NO_FAULT(&env);
+
+    callCt = 0;
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    TEST(callCt == 2);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+callWithParams(xmlrpc_env *      const envP,
+               xmlrpc_registry * const registryP,
+               const char *      const methodName,
+               const char *      const format,
+               ...) {
+/*----------------------------------------------------------------------------
+   Call 'methodName' with the parameters 'format' and the arguments after
+   it describe, and return the fault, if any, as *envP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    const char * suffix;
+    va_list args;
+
+    xmlrpc_env_init(&env);
+
+    va_start(args, format);
+    xmlrpc_build_value_va(&env, format, args, &argArrayP, &suffix);
+    va_end(args);
+    TEST_NO_FAULT(&env);
+
+    doRpc(envP, registryP, methodName, argArrayP, NULL, &resultP);
+
+    if (!envP->fault_occurred)
+        xmlrpc_DECREF(resultP);
+
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testSignatureCheck(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    unsigned int callCt;
+
+    printf("  Running signature check tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.sigs", &test_counted,
+                                "A:ii,A:s", NULL, &callCt);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.sig", &test_counted,
+                                "A:iS", NULL, &callCt);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.nosig", &test_counted,
+                                "?", NULL, &callCt);
+    TEST_NO_FAULT(&env);
+
+    /* Without checking, the method gets whatever the call has */
+    callCt = 0;
+    callWithParams(&env, registryP, "test.sigs", "(d)", 1.5);
+    TEST_NO_FAULT(&env);
+    TEST(callCt == 1);
+
+    xmlrpc_registry_set_method_check_signature(&env, registryP, "test.sigs",
+                                               true);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_method_check_signature(&env, registryP, "test.sig",
+                                               true);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_set_method_check_signature(&env, registryP, "test.nosig",
+                                               true);
+    TEST_NO_FAULT(&env);
+
+    callCt = 0;
+    callWithParams(&env, registryP, "test.sigs", "(ii)", 1, 2);
+    TEST_NO_FAULT(&env);
+    callWithParams(&env, registryP, "test.sigs", "(s)", "a");
+    TEST_NO_FAULT(&env);
+    TEST(callCt == 2);
+
+    callWithParams(&env, registryP, "test.sigs", "(d)", 1.5);
+    TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+    callWithParams(&env, registryP, "test.sigs", "(is)", 1, "a");
+    TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+    callWithParams(&env, registryP, "test.sigs", "()");
+    TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+    TEST(callCt == 2);
+
+    /* With one signature, the fault says what is wrong */
+    callWithParams(&env, registryP, "test.sig", "(i{s:i})", 1, "a", 2);
+    TEST_NO_FAULT(&env);
+    TEST(callCt == 3);
+
+    callWithParams(&env, registryP, "test.sig", "(ii)", 1, 2);
+    TEST(env.fault_occurred);
+    TEST(strstr(env.fault_string, "Parameter 1") != NULL);
+    TEST(strstr(env.fault_string, "struct") != NULL);
+    TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+    callWithParams(&env, registryP, "test.sig", "(i)", 1);
+    TEST_FAULT(&env, XMLRPC_INDEX_ERROR);
+    callWithParams(&env, registryP, "test.sig", "(i{}i)", 1, 2);
+    TEST_FAULT(&env, XMLRPC_INDEX_ERROR);
+    TEST(callCt == 3);
+
+    /* No signatures means anything goes */
+    callWithParams(&env, registryP, "test.nosig", "(d)", 1.5);
+    TEST_NO_FAULT(&env);
+    TEST(callCt == 4);
+
+    xmlrpc_registry_set_method_check_signature(&env, registryP,
+                                               "test.nosuch", true);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testMethodStats(void) {
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    struct xmlrpc_method_stats stats;
+    unsigned int callCt;
+    flightLog log;
+
+    printf("  Running method statistics tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.counted",
+                                &test_counted, NULL, NULL, &callCt);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.counted",
+                                     &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.callCt == 0);
+    TEST(stats.execute.count == 0);
+    TEST(stats.execute.p99Time == 0.0);
+
+    callCt = 0;
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 1));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 2));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "(i)", 3));
+    xmlrpc_mem_block_free(processCall(registryP, "test.counted", "()"));
+    TEST(callCt == 4);
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.counted",
+                                     &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.callCt == 4);
+    TEST(stats.faultCt == 1);
+    TEST(stats.inFlightCt == 0);
+    TEST(stats.parse.count == 4);
+    TEST(stats.execute.count == 4);
+    TEST(stats.serialize.count == 4);
+    TEST(stats.execute.p50Time <= stats.execute.p90Time);
+    TEST(stats.execute.p90Time <= stats.execute.p99Time);
+    TEST(stats.execute.p99Time <= stats.execute.maxTime);
+    TEST(stats.execute.maxTime <= stats.execute.totalTime);
+
+    /* Calls someone else parsed or executed */
+    {
+        struct xmlrpc_call_times times;
+        struct xmlrpc_methodInfo * methodP;
+        xmlrpc_value * paramArrayP;
+        xmlrpc_mem_block * responseP;
+
+        times.parseTime     = 0.001;
+        times.executeTime   = 0.5;
+        times.serializeTime = 0.002;
+
+        xmlrpc_registry_find_method(&env, registryP, "test.counted",
+                                    &methodP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_registry_native_call_begin(methodP);
+
+        xmlrpc_registry_get_method_stats(&env, registryP, "test.counted",
+                                         &stats);
+        TEST_NO_FAULT(&env);
+        TEST(stats.inFlightCt == 1);
+
+        xmlrpc_registry_native_call_end(methodP, &times, true);
+
+        xmlrpc_registry_find_method(&env, registryP, "nosuch", &methodP);
+        TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+        paramArrayP = xmlrpc_build_value(&env, "(i)", 4);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_registry_process_parsed_call(&env, registryP, "test.counted",
+                                            paramArrayP, NULL, NULL, 0.25,
+                                            &responseP);
+        TEST_NO_FAULT(&env);
+        TEST(callCt == 5);
+        xmlrpc_mem_block_free(responseP);
+        xmlrpc_DECREF(paramArrayP);
+
+        xmlrpc_registry_get_method_stats(&env, registryP, "test.counted",
+                                         &stats);
+        TEST_NO_FAULT(&env);
+        TEST(stats.callCt == 6);
+        TEST(stats.faultCt == 2);
+        TEST(stats.inFlightCt == 0);
+        TEST(stats.parse.count == 6);
+        TEST(stats.parse.maxTime >= 0.25);
+        TEST(stats.execute.maxTime >= 0.5);
+        TEST(stats.serialize.count == 6);
+    }
+    /* A call of known duration */
+    log.lockP  = xmlrpc_lock_create();
+    log.callCt = 0;
+
+    xmlrpc_registry_add_method2(&env, registryP, "test.flight", &test_flight,
+                                NULL, NULL, &log);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_mem_block_free(processCall(registryP, "test.flight", "(i)", 1));
+
+    xmlrpc_registry_get_method_stats(&env, registryP, "test.flight",
+                                     &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.callCt == 1);
+    TEST(stats.execute.maxTime >= 0.19);
+    TEST(stats.execute.p50Time == stats.execute.maxTime);
+    TEST(stats.execute.totalTime == stats.execute.maxTime);
+
+    xmlrpc_registry_free(registryP);
+
+    log.lockP->destroy(log.lockP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static xmlrpc_int32
+ctlCall(xmlrpc_registry * const registryP,
+        const char *      const methodName,
+        xmlrpc_call_ctl * const ctlP) {
+/*----------------------------------------------------------------------------
+   Call 'methodName' with a null string parameter, under call control *ctlP.
+   Return the fault code of the call (0 if it succeeds).
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_env env2;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+    xmlrpc_mem_block * responseP;
+    xmlrpc_value * resultP;
+    xmlrpc_int32 faultCode;
+
+    xmlrpc_env_init(&env);
+
+    argArrayP = xmlrpc_build_value(&env, "(s)", "");
+    TEST_NO_FAULT(&env);
+
+    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, methodName, argArrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_process_call3(&env, registryP,
+                                  xmlrpc_mem_block_contents(callP),
+                                  xmlrpc_mem_block_size(callP),
+                                  NULL, ctlP, &responseP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_env_init(&env2);
+
+    resultP = xmlrpc_parse_response(&env2,
+                                    xmlrpc_mem_block_contents(responseP),
+                                    xmlrpc_mem_block_size(responseP));
+
+    faultCode = env2.fault_occurred ? env2.fault_code : 0;
+
+    if (!env2.fault_occurred)
+        xmlrpc_DECREF(resultP);
+
+    xmlrpc_env_clean(&env2);
+    xmlrpc_mem_block_free(responseP);
+    xmlrpc_mem_block_free(callP);
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_env_clean(&env);
+
+    return faultCode;
+}
+
+
+
+static xmlrpc_value *
+test_reenterDeadline(xmlrpc_env *   const envP,
+                     xmlrpc_value * const paramArrayP,
+                     void *         const serverInfo,
+                     void *         const callInfo ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Like test_reenter, but the inner call has a 50 millisecond deadline.
+-----------------------------------------------------------------------------*/
+    xmlrpc_registry * const registryP = serverInfo;
+
+    const char * methodName;
+    xmlrpc_int32 faultCode;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(s)", &methodName);
+    TEST_NO_FAULT(envP);
+
+    if (strlen(methodName) > 0) {
+        xmlrpc_call_ctl ctl;
+
+        xmlrpc_call_ctl_init(&ctl, 50);
+
+        faultCode = ctlCall(registryP, methodName, &ctl);
+
+        TEST(xmlrpc_call_cancelled(&ctl) == (faultCode != 0));
+    } else
+        faultCode = 0;
+
+    strfree(methodName);
+
+    return xmlrpc_build_value(envP, "i", faultCode);
+}
+
+
+
+static xmlrpc_bool
+peerGoneYes(void * const context) {
+
+    unsigned int * const askedCtP = context;
+
+    ++*askedCtP;
+
+    return true;
+}
+
+
+
+static void
+testCallCtl(void) {
+/*----------------------------------------------------------------------------
+   Test deadlines and cancellation of calls (xmlrpc_call_ctl).
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_call_ctl ctl;
+    struct xmlrpc_method_limits limits;
+    struct xmlrpc_method_queue_stats stats;
+    unsigned int callCt;
+    unsigned int askedCt;
+
+    printf("  Running call control tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    callCt = 0;
+    xmlrpc_registry_add_method2(&env, registryP, "test.counted",
+                                &test_counted, NULL, NULL, &callCt);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.d",
+                                &test_reenterDeadline, NULL, NULL, registryP);
+    TEST_NO_FAULT(&env);
+
+    /* No control at all, and control without a deadline */
+    TEST(!xmlrpc_call_cancelled(NULL));
+    TEST(ctlCall(registryP, "test.counted", NULL) == 0);
+    TEST(callCt == 1);
+
+    xmlrpc_call_ctl_init(&ctl, 0);
+    TEST(!xmlrpc_call_cancelled(&ctl));
+    TEST(ctlCall(registryP, "test.counted", &ctl) == 0);
+    TEST(callCt == 2);
+
+    /* Cancelled: the method doesn't execute */
+    xmlrpc_call_cancel(&ctl);
+    TEST(xmlrpc_call_cancelled(&ctl));
+    TEST(ctlCall(registryP, "test.counted", &ctl) == XMLRPC_TIMEOUT_ERROR);
+    TEST(callCt == 2);
+
+    /* Deadline passed */
+    xmlrpc_call_ctl_init(&ctl, 20);
+    TEST(xmlrpc_call_time_left(&ctl) > 0.0);
+    TEST(xmlrpc_call_time_left(&ctl) <= 0.02);
+    TEST(!xmlrpc_call_cancelled(&ctl));
+    xmlrpc_millisecond_sleep(30);
+    TEST(xmlrpc_call_time_left(&ctl) == 0.0);
+    TEST(ctlCall(registryP, "test.counted", &ctl) == XMLRPC_TIMEOUT_ERROR);
+    TEST(callCt == 2);
+
+    /* Caller gone */
+    askedCt = 0;
+    xmlrpc_call_ctl_init(&ctl, 0);
+    ctl.peerGone        = &peerGoneYes;
+    ctl.peerGoneContext = &askedCt;
+    TEST(ctlCall(registryP, "test.counted", &ctl) == XMLRPC_TIMEOUT_ERROR);
+    TEST(callCt == 2);
+    TEST(askedCt == 1);
+    TEST(xmlrpc_call_cancelled(&ctl));
+    TEST(askedCt == 1);  /* Cancellation is sticky */
+
+    /* A call waiting for admission gives up at its deadline, though the
+       method would have it wait forever.
+    */
+    limits.maxConcurrent  = 1;
+    limits.maxQueued      = 1;
+    limits.queueTimeoutMs = 0;
+    limits.priority       = xmlrpc_priority_normal;
+    xmlrpc_registry_set_method_limits(&env, registryP, "test.d", &limits);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_call_ctl_init(&ctl, 0);
+    TEST(ctlCall(registryP, "test.d", &ctl) == 0);
+
+    {
+        xmlrpc_value * argArrayP;
+        xmlrpc_value * resultP;
+        xmlrpc_int32 faultCode;
+
+        argArrayP = xmlrpc_build_value(&env, "(s)", "test.d");
+        TEST_NO_FAULT(&env);
+
+        doRpc(&env, registryP, "test.d", argArrayP, NULL, &resultP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_read_int(&env, resultP, &faultCode);
+        TEST_NO_FAULT(&env);
+        TEST(faultCode == XMLRPC_TIMEOUT_ERROR);
+
+        xmlrpc_DECREF(resultP);
+        xmlrpc_DECREF(argArrayP);
+    }
+    xmlrpc_registry_get_method_queue_stats(&env, registryP, "test.d",
+                                           &stats);
+    TEST_NO_FAULT(&env);
+    TEST(stats.runningCt == 0);
+    TEST(stats.queuedCt == 0);
+    TEST(stats.timedOutCt == 1);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static xmlrpc_value *
+test_many(xmlrpc_env *   const envP,
+          xmlrpc_value * const paramArrayP ATTR_UNUSED,
+          void *         const serverInfo,
+          void *         const callInfo ATTR_UNUSED) {
+
+    return xmlrpc_build_value(envP, "i", (xmlrpc_int32)(size_t)serverInfo);
+}
+
+
+
+static void
+testManyMethods(void) {
+/*----------------------------------------------------------------------------
+   Register enough methods that the registry's hash table has to grow,
+   then make sure it still finds each one and lists them in the order we
+   added them.
+-----------------------------------------------------------------------------*/
+    unsigned int const methodCt = 1000;
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    unsigned int i;
+    unsigned int firstIndex;
+    unsigned int listSize;
+
+    printf("  Running many methods tests.");
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < methodCt; ++i) {
+        const char * methodName;
+
+        casprintf(&methodName, "test.many.%u", i);
+
+        xmlrpc_registry_add_method2(&env, registryP, methodName, &test_many,
+                                    NULL, NULL, (void *)(size_t)i);
+        TEST_NO_FAULT(&env);
+
+        strfree(methodName);
+    }
+    xmlrpc_registry_add_method2(&env, registryP, "test.many.7", &test_many,
+                                NULL, NULL, NULL);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < methodCt; i += 97) {
+        const char * methodName;
+        xmlrpc_int32 result;
+
+        casprintf(&methodName, "test.many.%u", i);
+
+        doRpc(&env, registryP, methodName, argArrayP, NULL, &resultP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_int(&env, resultP, &result);
+        TEST_NO_FAULT(&env);
+        TEST(result == (xmlrpc_int32)i);
+        xmlrpc_DECREF(resultP);
+
+        strfree(methodName);
+    }
+    doRpc(&env, registryP, "test.many.1000", argArrayP, NULL, &resultP);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    doRpc(&env, registryP, "system.listMethods", argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+
+    listSize = xmlrpc_array_size(&env, resultP);
+    TEST_NO_FAULT(&env);
+    TEST(listSize > methodCt);
+
+    /* The system methods come first, because they were added first */
+    firstIndex = listSize - methodCt;
+
+    for (i = 0; i < methodCt; ++i) {
+        xmlrpc_value * itemP;
+        const char * listedName;
+        const char * methodName;
+
+        xmlrpc_array_read_item(&env, resultP, firstIndex + i, &itemP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_string(&env, itemP, &listedName);
+        TEST_NO_FAULT(&env);
+
+        casprintf(&methodName, "test.many.%u", i);
+        TEST(streq(listedName, methodName));
+
+        strfree(methodName);
+        strfree(listedName);
+        xmlrpc_DECREF(itemP);
+    }
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+testDefaultMethod(xmlrpc_registry * const registryP) {
+    
+    xmlrpc_env env;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * valueP;
+    xmlrpc_int32 i;
+ 
+    xmlrpc_env_init(&env);
+
+    printf("  Running default method tests.");
+
+    /* Build an argument array for our calls. */
+    argArrayP = xmlrpc_build_value(&env, "(ii)",
+                                   (xmlrpc_int32) 25, (xmlrpc_int32) 17); 
+
+    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
+                                       DEFAULT_SERVERINFO);
+    TEST_NO_FAULT(&env);
+    doRpc(&env, registryP, "test.nosuch", argArrayP, DEFAULT_CALLINFO,
+          &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(valueP != NULL);
+    xmlrpc_decompose_value(&env, valueP, "i", &i);
+    xmlrpc_DECREF(valueP);
+    TEST_NO_FAULT(&env);
+    TEST(i == 84);
+
+    /* Now try it with old method interface */
+
+    doRpc(&env, registryP, "test.nosuch.old", argArrayP, NULL, &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(valueP != NULL);
+    xmlrpc_read_int(&env, valueP, &i);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(valueP);
+    TEST(i == 84);
+
+    /* Change the default method. */
+    xmlrpc_registry_set_default_method(&env, registryP, &test_default,
+                                       BAR_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+static void
+test_apache_dialect(void) {
+
+    char const expectedResp[] =
+        XML_PROLOGUE
+        "<methodResponse " XMLNS_APACHE ">\r\n"
+        "<params>\r\n"
+        "<param><value><array><data>\r\n"
+            "<value><ex:i8>8</ex:i8></value>\r\n"
+            "<value><ex:nil/></value>\r\n"
+        "</data></array></value></param>\r\n"
+        "</params>\r\n"
+        "</methodResponse>\r\n";
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_mem_block * callP;
+    xmlrpc_mem_block * responseP;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running apache dialect tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_i8);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_set_dialect(&env, registryP, 100);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_registry_set_dialect(&env, registryP, xmlrpc_dialect_apache);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_add_method2(&env, registryP, "test_exttype",
+                                test_exttype, NULL, NULL, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    argArrayP = xmlrpc_array_new(&env);
+    TEST_NO_FAULT(&env);
+
+    callP = xmlrpc_mem_block_new(&env, 0);
+    TEST_NO_FAULT(&env);
+    xmlrpc_serialize_call(&env, callP, "test_exttype", argArrayP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_registry_process_call2(
+        &env, registryP,
+        xmlrpc_mem_block_contents(callP),
+        xmlrpc_mem_block_size(callP),
+        NULL, &responseP);
+
+    TEST_NO_FAULT(&env);
+
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, responseP) == strlen(expectedResp));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+               expectedResp,
+               XMLRPC_MEMBLOCK_SIZE(char, responseP)));
+
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_mem_block_free(callP);
+    xmlrpc_mem_block_free(responseP);
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
+void
+test_method_registry(void) {
+
+    xmlrpc_env env, env2;
+    xmlrpc_value * valueP;
+    xmlrpc_registry * registryP;
+    xmlrpc_mem_block * responseP;
+
+    xmlrpc_env_init(&env);
+
+    testVersion();
+
+    printf("Running method registry tests.");
+
+    /* Create a new registry. */
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+    TEST(registryP != NULL);
+
+    /* Add some test methods. */
+    xmlrpc_registry_add_method(&env, registryP, NULL, "test.foo",
+                               test_foo_type1, FOO_SERVERINFO);
+    TEST_NO_FAULT(&env);
+    xmlrpc_registry_add_method2(&env, registryP, "test.bar",
+                                test_bar, NULL, barHelp, BAR_SERVERINFO);
+    TEST_NO_FAULT(&env);
+
+    printf("\n");
+    testCall(registryP);
+
+    test_system_multicall(registryP);
+
+    testParallelMulticall(registryP);
+
+    xmlrpc_env_init(&env2);
+    xmlrpc_registry_process_call2(&env, registryP,
+                                  expat_error_data,
+                                  strlen(expat_error_data),
+                                  NULL,
+                                  &responseP);
+    TEST_NO_FAULT(&env);
+    TEST(responseP != NULL);
+    valueP = xmlrpc_parse_response(&env2, xmlrpc_mem_block_contents(responseP),
+                                  xmlrpc_mem_block_size(responseP));
+    TEST(valueP == NULL);
+    TEST_FAULT(&env2, XMLRPC_PARSE_ERROR);
+    xmlrpc_mem_block_free(responseP);
+    xmlrpc_env_clean(&env2);
+
+    printf("\n");
+
+    testDefaultMethod(registryP);
+
+    testConcurrencyLimits();
+
+    testCoalescing();
+
+    testAsyncMethods();
+
+    testResultCache();
+
+    testMethodStats();
+
+    testCallCtl();
+
+    testSignatureCheck();
+
+    testManyMethods();
+
+    test_system_listMethods(registryP);
+
+    test_system_methodExist(registryP);
+
+    test_system_methodHelp(registryP);
+
+    test_system_capabilities(registryP);
+
+    test_system_getCapabilities(registryP);
+
+    test_system_stats(registryP);
 
     test_signature();
 
@@ -3,6 +3,7 @@
 
 #include "xmlrpc_config.h"
 
+#include "c_util.h"
 #include "girstring.h"
 #include "casprintf.h"
 #include "xmlrpc-c/base.h"
@@ -586,6 +587,97 @@ testParseXmlValue(void) {
 
 
 
+static void
+testParseDatetime(void) {
+/*----------------------------------------------------------------------------
+   Test every form of <dateTime.iso8601> content we recognize, and some
+   near misses we don't.  The expected results are those of the original
+   regular expression parser.
+-----------------------------------------------------------------------------*/
+    static struct {
+        const char * text;
+        bool valid;
+        unsigned int Y, M, D, h, m, s, u;
+    } const cases[] = {
+        { "19980717T14:08:55",          true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T140855",            true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "1998-07-17T14:08:55",        true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "1998-0717t14:0855",          true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:55.123456",   true,  1998, 7, 17, 14, 8, 55,
+                                                                   123456 },
+        { "19980717T14:08:55.34",       true,  1998, 7, 17, 14, 8, 55,
+                                                                   340000 },
+        { "19980717T14:08:55.1234567",  true,  1998, 7, 17, 14, 8, 55,
+                                                                   123456 },
+        { "19980717T14:08:55.",         true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:555",         true,  1998, 7, 17, 14, 8, 55,
+                                                                   500000 },
+        { "19980717T14:08:55Z",         true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:55z",         true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:55+05",       true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:55-0530",     true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:55+",         true,  1998, 7, 17, 14, 8, 55, 0 },
+        { "19980717T14:08:55+5",        false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:55+12345",    false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:55.5Z",       false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:55Z.5",       false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:55.12a",      false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:55 ",         false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717 14:08:55",          false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14::08:55",         false, 0, 0, 0, 0, 0, 0, 0 },
+        { "1998--07-17T14:08:55",       false, 0, 0, 0, 0, 0, 0, 0 },
+        { "199807-7T14:08:55",          false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:5",           false, 0, 0, 0, 0, 0, 0, 0 },
+        { "199807T14:08:55",            false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717",                   false, 0, 0, 0, 0, 0, 0, 0 },
+        { "",                           false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19981317T14:08:55",          false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980732T14:08:55",          false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T24:08:55",          false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:60:55",          false, 0, 0, 0, 0, 0, 0, 0 },
+        { "19980717T14:08:60",          false, 0, 0, 0, 0, 0, 0, 0 },
+    };
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(cases); ++i) {
+        xmlrpc_env env;
+        xmlrpc_value * valueP;
+        const char * xml;
+
+        xmlrpc_env_init(&env);
+
+        casprintf(&xml, "<value><dateTime.iso8601>%s</dateTime.iso8601>"
+                  "</value>", cases[i].text);
+
+        xmlrpc_parse_value_xml(&env, xml, strlen(xml), &valueP);
+
+        if (cases[i].valid) {
+            xmlrpc_datetime dt;
+
+            TEST_NO_FAULT(&env);
+
+            xmlrpc_read_datetime(&env, valueP, &dt);
+            TEST_NO_FAULT(&env);
+
+            TEST(dt.Y == cases[i].Y);
+            TEST(dt.M == cases[i].M);
+            TEST(dt.D == cases[i].D);
+            TEST(dt.h == cases[i].h);
+            TEST(dt.m == cases[i].m);
+            TEST(dt.s == cases[i].s);
+            TEST(dt.u == cases[i].u);
+
+            xmlrpc_DECREF(valueP);
+        } else
+            TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+        strfree(xml);
+        xmlrpc_env_clean(&env);
+    }
+}
+
+
+
 void
 test_parse_xml(void) {
 
@@ -598,6 +690,7 @@ test_parse_xml(void) {
     testParseBadResponse();
     testParseXmlCall();
     testParseXmlValue();
+    testParseDatetime();
     printf("\n");
     printf("XML parsing tests done.\n");
 }
@@ -2,10 +2,20 @@
 
 #include "unistdx.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#endif
 #include "bool.h"
 
 #include "xmlrpc_config.h"
 
+#include "casprintf.h"
 #include "girstring.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
@@ -245,6 +255,583 @@ testObject(void) {
 
 
 
+#ifndef _WIN32
+
+#define PIPELINE_DEPTH 100
+
+static xmlrpc_value *
+sampleAdd(xmlrpc_env *   const envP,
+          xmlrpc_value * const paramArrayP,
+          void *         const serverInfo ATTR_UNUSED) {
+
+    xmlrpc_int32 x, y;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(ii)", &x, &y);
+
+    if (envP->fault_occurred)
+        return NULL;
+    else
+        return xmlrpc_build_value(envP, "i", x + y);
+}
+
+
+
+static xmlrpc_call_completion * parkedCallP;
+    /* The call test.park left for test.release to complete.  The client
+       calls test.release only after the server has set this.
+    */
+
+
+
+static void
+testPark(xmlrpc_value *           const paramArrayP ATTR_UNUSED,
+         void *                   const serverInfo ATTR_UNUSED,
+         void *                   const callInfo ATTR_UNUSED,
+         xmlrpc_call_completion * const completionP) {
+/*----------------------------------------------------------------------------
+   An asynchronous method that leaves the call for test.release to
+   complete.
+-----------------------------------------------------------------------------*/
+    parkedCallP = completionP;
+}
+
+
+
+static xmlrpc_value *
+testRelease(xmlrpc_env *   const envP,
+            xmlrpc_value * const paramArrayP ATTR_UNUSED,
+            void *         const serverInfo ATTR_UNUSED) {
+
+    xmlrpc_value * retval;
+
+    if (parkedCallP) {
+        /* xmlrpc_call_complete() takes over our reference */
+        xmlrpc_call_complete(parkedCallP, xmlrpc_int_new(envP, 3));
+        parkedCallP = NULL;
+
+        retval = xmlrpc_int_new(envP, 1);
+    } else {
+        xmlrpc_faultf(envP, "No call is parked");
+        retval = NULL;
+    }
+    return retval;
+}
+
+
+
+static int
+createListeningSocket(uint16_t * const portNumberP) {
+/*----------------------------------------------------------------------------
+   Create a TCP socket listening on an ephemeral loopback port; return
+   the port number as *portNumberP.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in name;
+    socklen_t nameLen;
+    int rc;
+
+    TEST(fd >= 0);
+
+    name.sin_family = AF_INET;
+    name.sin_port   = htons(0);
+    name.sin_addr   = test_ipAddrFromDecimal(127, 0, 0, 1);
+
+    rc = bind(fd, (struct sockaddr *)&name, sizeof(name));
+    TEST(rc == 0);
+
+    /* We listen here, before the server process exists, so the client can
+       connect without racing the server's ServerInit().
+    */
+    rc = listen(fd, 5);
+    TEST(rc == 0);
+
+    nameLen = sizeof(name);
+    rc = getsockname(fd, (struct sockaddr *)&name, &nameLen);
+    TEST(rc == 0);
+
+    *portNumberP = ntohs(name.sin_port);
+
+    return fd;
+}
+
+
+
+static void
+runTestServer(int          const listenFd,
+              unsigned int const shedThreshold,
+              unsigned int const maxConn) {
+/*----------------------------------------------------------------------------
+   Run an XML-RPC server on the listening socket 'listenFd' until killed.
+   This runs in a child process; it never returns.
+
+   The server refuses connections beyond 'shedThreshold' in progress (zero
+   means no limit).  It serves at most 'maxConn' at once (zero means the
+   Abyss default).
+-----------------------------------------------------------------------------*/
+    struct xmlrpc_async_method_info parkInfo;
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    TChanSwitch * chanSwitchP;
+    TServer server;
+    const char * error;
+
+    /* In case the test fails and the parent never gets around to killing
+       us:
+    */
+    alarm(30);
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_server_abyss_global_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+
+    xmlrpc_registry_add_method(&env, registryP, NULL, "sample.add",
+                               &sampleAdd, NULL);
+
+    xmlrpc_registry_add_method(&env, registryP, NULL, "test.release",
+                               &testRelease, NULL);
+
+    memset(&parkInfo, 0, sizeof(parkInfo));
+    parkInfo.methodName     = "test.park";
+    parkInfo.methodFunction = &testPark;
+
+    xmlrpc_registry_add_async_method(&env, registryP, &parkInfo);
+
+    ChanSwitchUnixCreateFd(listenFd, &chanSwitchP, &error);
+
+    if (error || env.fault_occurred)
+        _exit(1);
+
+    ServerCreateSwitch(&server, chanSwitchP, &error);
+
+    if (error)
+        _exit(1);
+
+    xmlrpc_server_abyss_set_handlers2(&server, "/RPC2", registryP);
+
+    ServerSetKeepaliveTimeout(&server, 5);
+    ServerSetKeepaliveMaxConn(&server, PIPELINE_DEPTH);
+    ServerSetShedThreshold(&server, shedThreshold);
+    ServerSetShedRetryAfter(&server, 7);
+    ServerSetMaxConn(&server, maxConn);
+
+    ServerInit(&server);
+
+    ServerRun(&server);
+
+    _exit(0);
+}
+
+
+
+static void
+sendPipelinedCalls(int          const fd,
+                   unsigned int const callCt) {
+/*----------------------------------------------------------------------------
+   Send 'callCt' sample.add calls on connected socket 'fd', all in a single
+   write, so they arrive at the server together.  Call N adds N to itself.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_block * requestsP;
+    unsigned int i;
+    size_t bytesSent;
+
+    xmlrpc_env_init(&env);
+
+    requestsP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+
+    for (i = 0; i < callCt && !env.fault_occurred; ++i) {
+        const char * body;
+        const char * request;
+
+        casprintf(&body,
+                  "<?xml version=\"1.0\"?>\r\n"
+                  "<methodCall><methodName>sample.add</methodName>"
+                  "<params>"
+                  "<param><value><i4>%u</i4></value></param>"
+                  "<param><value><i4>%u</i4></value></param>"
+                  "</params></methodCall>\r\n",
+                  i, i);
+
+        casprintf(&request,
+                  "POST /RPC2 HTTP/1.1\r\n"
+                  "Host: localhost\r\n"
+                  "Content-Type: text/xml\r\n"
+                  "Content-Length: %u\r\n"
+                  "\r\n"
+                  "%s",
+                  (unsigned)strlen(body), body);
+
+        XMLRPC_MEMBLOCK_APPEND(char, &env, requestsP,
+                               request, strlen(request));
+
+        strfree(request);
+        strfree(body);
+    }
+
+    for (bytesSent = 0;
+         !env.fault_occurred &&
+             bytesSent < XMLRPC_MEMBLOCK_SIZE(char, requestsP);
+        ) {
+        ssize_t const rc =
+            write(fd, XMLRPC_MEMBLOCK_CONTENTS(char, requestsP) + bytesSent,
+                  XMLRPC_MEMBLOCK_SIZE(char, requestsP) - bytesSent);
+        if (rc <= 0)
+            break;
+        bytesSent += rc;
+    }
+    XMLRPC_MEMBLOCK_FREE(char, requestsP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+sendNoParamCall(int          const fd,
+                const char * const methodName) {
+/*----------------------------------------------------------------------------
+   Send a call of method 'methodName', with no parameters, on connected
+   socket 'fd'.
+-----------------------------------------------------------------------------*/
+    const char * body;
+    const char * request;
+    size_t bytesSent;
+
+    casprintf(&body,
+              "<?xml version=\"1.0\"?>\r\n"
+              "<methodCall><methodName>%s</methodName>"
+              "<params></params></methodCall>\r\n",
+              methodName);
+
+    casprintf(&request,
+              "POST /RPC2 HTTP/1.1\r\n"
+              "Host: localhost\r\n"
+              "Content-Type: text/xml\r\n"
+              "Content-Length: %u\r\n"
+              "\r\n"
+              "%s",
+              (unsigned)strlen(body), body);
+
+    for (bytesSent = 0; bytesSent < strlen(request); ) {
+        ssize_t const rc =
+            write(fd, &request[bytesSent], strlen(request) - bytesSent);
+        if (rc <= 0)
+            break;
+        bytesSent += rc;
+    }
+    strfree(request);
+    strfree(body);
+}
+
+
+
+static void
+readUntilEof(int      const fd,
+             char **  const dataP,
+             size_t * const dataLenP) {
+
+    size_t allocSize;
+    size_t dataLen;
+    char * data;
+    bool eof;
+
+    allocSize = 4096;
+    data = malloc(allocSize);
+    dataLen = 0;
+
+    for (eof = false; !eof; ) {
+        ssize_t rc;
+
+        if (allocSize - dataLen < 1024) {
+            allocSize *= 2;
+            data = realloc(data, allocSize);
+            if (data == NULL)
+                abort();
+        }
+        rc = read(fd, &data[dataLen], allocSize - dataLen - 1);
+
+        if (rc <= 0)
+            eof = true;
+        else
+            dataLen += rc;
+    }
+    data[dataLen] = '\0';
+
+    *dataP    = data;
+    *dataLenP = dataLen;
+}
+
+
+
+static int
+connectToTestServer(uint16_t const portNumber) {
+/*----------------------------------------------------------------------------
+   Return a socket connected to the server at loopback port 'portNumber',
+   or -1 if we can't connect.
+-----------------------------------------------------------------------------*/
+    int const fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in serverAddr;
+    int rc;
+    int retval;
+
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port   = htons(portNumber);
+    serverAddr.sin_addr   = test_ipAddrFromDecimal(127, 0, 0, 1);
+
+    rc = connect(fd, (struct sockaddr *)&serverAddr, sizeof(serverAddr));
+
+    if (rc != 0) {
+        close(fd);
+        retval = -1;
+    } else
+        retval = fd;
+
+    return retval;
+}
+
+
+
+static void
+runPipelineClient(uint16_t const portNumber,
+                  char **  const responsesP,
+                  size_t * const responsesLenP) {
+/*----------------------------------------------------------------------------
+   Connect to the server at 'portNumber', send PIPELINE_DEPTH calls back to
+   back, and return everything the server sends until it closes the
+   connection.
+
+   We don't run any tests here, because a failed test aborts the program
+   and the parent must stay alive to kill the server process.
+-----------------------------------------------------------------------------*/
+    int const fd = connectToTestServer(portNumber);
+
+    if (fd >= 0) {
+        sendPipelinedCalls(fd, PIPELINE_DEPTH);
+
+        shutdown(fd, SHUT_WR);
+
+        readUntilEof(fd, responsesP, responsesLenP);
+        close(fd);
+    } else
+        *responsesP = NULL;
+}
+
+
+
+static void
+testPipelining(void) {
+/*----------------------------------------------------------------------------
+   Send PIPELINE_DEPTH calls back to back on one connection, then read the
+   responses.  The server must answer every one of them, in order, and
+   close the connection after the last because that is the keepalive
+   maximum.
+-----------------------------------------------------------------------------*/
+    uint16_t portNumber;
+    int const listenFd = createListeningSocket(&portNumber);
+
+    pid_t pid;
+
+    fflush(stdout);  /* Don't let the child inherit buffered output */
+
+    pid = fork();
+
+    TEST(pid >= 0);
+
+    if (pid == 0)
+        runTestServer(listenFd, 0, 0);
+    else {
+        char * responses;
+        size_t responsesLen;
+
+        close(listenFd);
+
+        runPipelineClient(portNumber, &responses, &responsesLen);
+
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        TEST(responses != NULL);
+
+        if (responses) {
+            const char * cursor;
+            unsigned int okCt;
+            unsigned int i;
+
+            for (cursor = responses, okCt = 0;
+                 (cursor = strstr(cursor, "HTTP/1.1 200 OK"));
+                 ++cursor)
+                ++okCt;
+
+            TEST(okCt == PIPELINE_DEPTH);
+
+            /* Responses must be in request order */
+            for (i = 0, cursor = responses;
+                 i < PIPELINE_DEPTH && cursor;
+                 ++i) {
+                cursor = strstr(cursor, "<i4>");
+                TEST(cursor != NULL);
+                if (cursor) {
+                    cursor += strlen("<i4>");
+                    TEST((unsigned)atoi(cursor) == 2 * i);
+                }
+            }
+            /* The last response announces the end of the connection */
+            TEST(strstr(responses, "Connection: close") != NULL);
+
+            free(responses);
+        }
+    }
+}
+
+
+
+static void
+testShedding(void) {
+/*----------------------------------------------------------------------------
+   With a shedding threshold of one connection, hold one connection open
+   and make a call on a second one.  The server must refuse the second with
+   a 503 response that says when to retry.
+-----------------------------------------------------------------------------*/
+    uint16_t portNumber;
+    int const listenFd = createListeningSocket(&portNumber);
+
+    pid_t pid;
+
+    fflush(stdout);  /* Don't let the child inherit buffered output */
+
+    pid = fork();
+
+    TEST(pid >= 0);
+
+    if (pid == 0)
+        runTestServer(listenFd, 1, 0);
+    else {
+        int idleFd, callFd;
+        char * response;
+
+        close(listenFd);
+
+        /* This connection occupies the server's only slot; we never send
+           anything on it.
+        */
+        idleFd = connectToTestServer(portNumber);
+
+        callFd = connectToTestServer(portNumber);
+
+        if (callFd >= 0) {
+            size_t responseLen;
+
+            sendPipelinedCalls(callFd, 1);
+            readUntilEof(callFd, &response, &responseLen);
+            close(callFd);
+        } else
+            response = NULL;
+
+        if (idleFd >= 0)
+            close(idleFd);
+
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        TEST(idleFd >= 0);
+        TEST(response != NULL);
+
+        if (response) {
+            TEST(memeq(response, "HTTP/1.1 503 ", 13));
+            TEST(strstr(response, "Retry-After: 7\r\n") != NULL);
+            TEST(strstr(response, "<methodResponse>") == NULL);
+
+            free(response);
+        }
+    }
+}
+
+
+
+static void
+testDeferredResponse(void) {
+/*----------------------------------------------------------------------------
+   With a server that serves only one connection at a time, call an
+   asynchronous method that doesn't complete the call, then complete it
+   with a call on a second connection.  The server can serve the second
+   connection only if it released the first one's thread while the call
+   was pending.  Then both calls must get their responses.
+-----------------------------------------------------------------------------*/
+    uint16_t portNumber;
+    int const listenFd = createListeningSocket(&portNumber);
+
+    pid_t pid;
+
+    fflush(stdout);  /* Don't let the child inherit buffered output */
+
+    pid = fork();
+
+    TEST(pid >= 0);
+
+    if (pid == 0)
+        runTestServer(listenFd, 0, 1);
+    else {
+        int parkFd, releaseFd;
+        char * parkResponse;
+        char * releaseResponse;
+        size_t responseLen;
+
+        close(listenFd);
+
+        parkFd = connectToTestServer(portNumber);
+
+        if (parkFd >= 0)
+            sendNoParamCall(parkFd, "test.park");
+
+        releaseFd = connectToTestServer(portNumber);
+
+        /* The server's alarm ends these reads if it never serves us */
+
+        if (releaseFd >= 0) {
+            sendNoParamCall(releaseFd, "test.release");
+            shutdown(releaseFd, SHUT_WR);
+            readUntilEof(releaseFd, &releaseResponse, &responseLen);
+            close(releaseFd);
+        } else
+            releaseResponse = NULL;
+
+        if (parkFd >= 0) {
+            shutdown(parkFd, SHUT_WR);
+            readUntilEof(parkFd, &parkResponse, &responseLen);
+            close(parkFd);
+        } else
+            parkResponse = NULL;
+
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        TEST(releaseResponse != NULL);
+        TEST(parkResponse != NULL);
+
+        if (releaseResponse) {
+            TEST(memeq(releaseResponse, "HTTP/1.1 200 ", 13));
+            TEST(strstr(releaseResponse, "<i4>1</i4>") != NULL);
+
+            free(releaseResponse);
+        }
+        if (parkResponse) {
+            TEST(memeq(parkResponse, "HTTP/1.1 200 ", 13));
+            TEST(strstr(parkResponse, "<i4>3</i4>") != NULL);
+            TEST(strstr(parkResponse, "Connection: close") != NULL);
+
+            free(parkResponse);
+        }
+    }
+}
+
+#endif  /* _WIN32 */
+
+
+
 void
 test_server_abyss(void) {
 
@@ -269,6 +856,14 @@ test_server_abyss(void) {
 
     testObject();
 
+#ifndef _WIN32
+    testPipelining();
+
+    testShedding();
+
+    testDeferredResponse();
+#endif
+
     printf("\n");
     printf("Abyss XML-RPC server tests done.\n");
 }
@@ -28,6 +28,7 @@
 #include "xml_data.h"
 #include "client.h"
 #include "abyss.h"
+#include "abyss_openssl.h"
 #include "server_abyss.h"
 #include "method_registry.h"
 
@@ -761,6 +762,7 @@ main(int     argc,
         printf("\n");
         test_server_cgi_maybe();
         test_abyss();
+        test_abyss_openssl();
         test_server_abyss();
 
         test_utf8_coding();
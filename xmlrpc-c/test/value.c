@@ -1406,6 +1406,85 @@ test_value_parse_value(void) {
 
 
 
+static void
+test_value_plan(void) {
+
+    xmlrpc_env env;
+    const xmlrpc_build_plan * buildPlanP;
+    const xmlrpc_decomp_plan * decompPlanP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_build_plan_create(&env, "{s:i,s:(is#)}", &buildPlanP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_decomp_plan_create(&env, "{s:i,s:(is#),*}", &decompPlanP);
+    TEST_NO_FAULT(&env);
+
+    /* Each plan serves any number of calls */
+
+    for (i = 0; i < 3; ++i) {
+        xmlrpc_value * valueP;
+        xmlrpc_int32 a, b;
+        const char * str;
+        size_t len;
+
+        valueP = xmlrpc_build_value_plan(&env, buildPlanP,
+                                         "a", (xmlrpc_int32)i,
+                                         "b", (xmlrpc_int32)i+10,
+                                         "x\0y", (size_t)3);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_decompose_value_plan(&env, valueP, decompPlanP,
+                                    "a", &a, "b", &b, &str, &len);
+        TEST_NO_FAULT(&env);
+        TEST(a == (xmlrpc_int32)i);
+        TEST(b == (xmlrpc_int32)i+10);
+        TEST(len == 3);
+        TEST(memeq(str, "x\0y", 3));
+        free((void*)str);
+
+        /* The same format strings, through the plan cache */
+        xmlrpc_decompose_value(&env, valueP, "{s:i,s:(is#),*}",
+                               "a", &a, "b", &b, &str, &len);
+        TEST_NO_FAULT(&env);
+        TEST(a == (xmlrpc_int32)i);
+        TEST(len == 3);
+        free((void*)str);
+
+        /* Failure after a member has been decomposed */
+        xmlrpc_decompose_value_plan(&env, valueP, decompPlanP,
+                                    "b", &a, "a", &b, &str, &len);
+        TEST_FAULT(&env, XMLRPC_TYPE_ERROR);
+
+        xmlrpc_DECREF(valueP);
+    }
+    xmlrpc_decomp_plan_destroy(decompPlanP);
+    xmlrpc_build_plan_destroy(buildPlanP);
+
+    xmlrpc_build_plan_create(&env, "(i)s", &buildPlanP);
+    TEST_NO_FAULT(&env);
+    TEST(streq(xmlrpc_build_plan_tail(buildPlanP, "(i)s"), "s"));
+    xmlrpc_build_plan_destroy(buildPlanP);
+
+    xmlrpc_build_plan_create(&env, "(i", &buildPlanP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_build_plan_create(&env, "", &buildPlanP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_decomp_plan_create(&env, "{s:i}", &decompPlanP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_decomp_plan_create(&env, "ii", &decompPlanP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 static void
 test_struct_get_element(xmlrpc_value * const structP,
                         xmlrpc_value * const fooValueP,
@@ -1874,6 +1953,7 @@ test_value(void) {
     test_value_missing_struct_delim();
     test_value_invalid_struct();
     test_value_parse_value();
+    test_value_plan();
     test_struct();
 
     printf("\n");